@@ -84,19 +84,45 @@ const DebugLevel = DEBUGLVL_TERSE;
 #endif
 
 #define FOURCC_YUY2         mmioFOURCC('Y', 'U', 'Y', '2')
+#define FOURCC_P010         mmioFOURCC('P', '0', '1', '0')
 //
 // CAPTURE_PIN_DATA_RANGE_COUNT:
 //
 // The number of ranges supported on the capture pin.
 //
-#define CAPTURE_PIN_DATA_RANGE_COUNT 1 // 2
+#define CAPTURE_PIN_DATA_RANGE_COUNT 3 // 4
 
 //
 // CAPTURE_FILTER_PIN_COUNT:
 //
 // The number of pins on the capture filter.
 //
-#define CAPTURE_FILTER_PIN_COUNT 1
+#define CAPTURE_FILTER_PIN_COUNT 3
+
+//
+// CAPTURE_PIN_ID / STILL_PIN_ID / PREVIEW_PIN_ID:
+//
+// The pin factory IDs of the video capture, still and preview pins, their
+// indices in CaptureFilterPinDescriptors.  STILL_PIN_ID is the StreamIndex
+// of the video control trigger.
+//
+#define CAPTURE_PIN_ID 0
+#define STILL_PIN_ID 1
+#define PREVIEW_PIN_ID 2
+
+//
+// PREVIEW_PIN_DATA_RANGE_COUNT:
+//
+// The number of ranges supported on the preview pin.
+//
+#define PREVIEW_PIN_DATA_RANGE_COUNT 4
+
+//
+// PREVIEW_PIN_INSTANCES:
+//
+// The number of preview pins that may be open at once.
+//
+#define PREVIEW_PIN_INSTANCES 2
 
 //
 // CAPTURE_FILTER_CATEGORIES_COUNT:
@@ -153,6 +179,27 @@ const
 PKSDATARANGE
 CapturePinDataRanges [CAPTURE_PIN_DATA_RANGE_COUNT];
 
+//
+// still.cpp externs:
+//
+extern
+const
+KSPIN_DISPATCH
+StillPinDispatch;
+
+//
+// preview.cpp externs:
+//
+extern
+const
+KSPIN_DISPATCH
+PreviewPinDispatch;
+
+extern
+const
+PKSDATARANGE
+PreviewPinDataRanges [PREVIEW_PIN_DATA_RANGE_COUNT];
+
 /*************************************************
 
     Enums / Typedefs
@@ -196,7 +243,8 @@ public:
 //
 // This is a capture sink interface.  The device level calls back the
 // CompleteMappings method passing the number of completed mappings for
-// the capture pin.  This method is called during the device DPC.
+// the capture pin, or in copy capture mode the FrameReady method.  These
+// methods are called during the device DPC.
 //
 class ICaptureSink {
 
@@ -208,6 +256,11 @@ public:
         IN ULONG NumMappings
         ) = 0;
 
+    virtual
+    void
+    FrameReady (
+        ) = 0;
+
 };
 
 
@@ -217,6 +270,27 @@ public:
     Global Functions
 
 *************************************************/
+
+//
+// QueryPerformanceTime():
+//
+// Read the performance counter scaled to 100ns units.  This is the time
+// base producers stamp frames with (QueryPerformanceCounter in user mode).
+// The division is split so the scaling can't overflow on long uptimes.
+//
+inline
+LONGLONG
+QueryPerformanceTime (
+    )
+{
+    LARGE_INTEGER Frequency;
+    LARGE_INTEGER Counter = KeQueryPerformanceCounter (&Frequency);
+
+    return (Counter.QuadPart / Frequency.QuadPart) * 10000000 +
+        ((Counter.QuadPart % Frequency.QuadPart) * 10000000) /
+            Frequency.QuadPart;
+}
+
 #ifndef _NEW_DELETE_OPERATORS_
 #define _NEW_DELETE_OPERATORS_
 
@@ -360,10 +434,24 @@ void __cdecl operator delete[]
 
 *************************************************/
 
+#include "pixfmt.h"
 #include "image.h"
+#include "tsmap.h"
+#include "drops.h"
+#include "watchdog.h"
+#include "frc.h"
+#include "delay.h"
+#include "convert.h"
+#include "scale.h"
+#include "probe.h"
+#include "framepool.h"
+#include "trace.h"
+#include "pts.h"
 #include "hwsim.h"
 #include "device.h"
 #include "filter.h"
 #include "capture.h"
+#include "still.h"
+#include "preview.h"
 #include <uuids.h>
 #endif //_avshws_h_
\ No newline at end of file
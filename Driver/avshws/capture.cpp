@@ -341,6 +341,10 @@ Return Value:
 
     PAGED_CODE();
 
+    if (m_Device -> IsCopyMode ()) {
+        return ProcessCopy ();
+    }
+
     NTSTATUS Status = STATUS_SUCCESS;
     PKSSTREAM_POINTER Leading;
 
@@ -409,6 +413,10 @@ Return Value:
                     reinterpret_cast <PUCHAR> (
                         ClonePointer -> StreamHeader -> Data
                         );
+
+                SPContext -> ProducerTimeValid = FALSE;
+                SPContext -> Generation = 0;
+                SPContext -> Tick = 0;
             }
 
         } else {
@@ -529,6 +537,113 @@ Return Value:
 
 /*************************************************/
 
+
+NTSTATUS
+CCapturePin::
+ProcessCopy (
+    )
+
+/*++
+
+Routine Description:
+
+    Processing in copy capture mode.  There is a frame to deliver once per
+    tick, and the tick kicks processing (FrameReady).  The frame is copied
+    into the buffer at the leading edge, the buffer is stamped and the
+    leading edge advanced, which completes it: the pin holds no clones and
+    programs no scatter / gather entries.  A buffer too small for the
+    frame is completed empty, so it doesn't hold up the queue.  If there
+    is no buffer when the frame is ready, the queue kicks processing again
+    as soon as one is queued; if the next tick comes first, the frame is
+    dropped.  If there is a buffer but no frame, processing pends until
+    the tick readies one.
+
+Arguments:
+
+    None
+
+Return Value:
+
+    STATUS_PENDING if no frame was ready for the buffer at the leading
+    edge, so that processing waits for the next tick
+
+--*/
+
+{
+
+    PAGED_CODE();
+
+    NTSTATUS Status = STATUS_SUCCESS;
+
+    PKSSTREAM_POINTER Leading = KsPinGetLeadingEdgeStreamPointer (
+        m_Pin,
+        KSSTREAM_POINTER_STATE_LOCKED
+        );
+
+    while (Leading) {
+
+        //
+        // If no data is present in the Leading edge stream pointer, just
+        // move on to the next frame
+        //
+        if (NULL == Leading -> StreamHeader -> Data) {
+            Status = KsStreamPointerAdvance (Leading);
+        } else {
+
+            STREAM_POINTER_CONTEXT Context;
+
+            //
+            // No frame is ready.  Pend rather than be called straight back
+            // to poll for one: the tick kicks processing when it readies
+            // the next (FrameReady).
+            //
+            if (!m_Device -> DeliverFrame (Leading -> StreamHeader, &Context)) {
+                Status = STATUS_PENDING;
+                break;
+            }
+
+            //
+            // A buffer too small for the frame comes back empty, as in
+            // mapped mode, and isn't stamped.
+            //
+            if (Leading -> StreamHeader -> DataUsed) {
+                COMPLETION_BATCH Batch;
+                BeginBatch (&Batch, 1);
+
+                StampFrame (Leading -> StreamHeader, &Context, &Batch, 0);
+            }
+
+            m_Device -> GetTrace () -> Record (
+                AvshwsTraceCloneDelete,
+                Context.Generation,
+                m_FrameNumber,
+                Leading -> StreamHeader -> DataUsed
+                );
+
+            Status = KsStreamPointerAdvance (Leading);
+
+        }
+
+        //
+        // If we run off the end of the queue, Status will be
+        // STATUS_DEVICE_NOT_READY and the leading edge is no longer locked.
+        //
+        if (!NT_SUCCESS (Status)) {
+            Leading = NULL;
+        }
+
+    }
+
+    if (Leading) {
+        KsStreamPointerUnlock (Leading, FALSE);
+    }
+
+    return Status == STATUS_PENDING ? STATUS_PENDING : STATUS_SUCCESS;
+
+}
+
+/*************************************************/
+
 
 NTSTATUS
 CCapturePin::
@@ -568,6 +683,16 @@ Return Value:
         NextClone = KsStreamPointerGetNextClone (Clone);
 
         Clone -> StreamHeader -> DataUsed = 0;
+
+        m_Device -> GetTrace () -> Record (
+            AvshwsTraceCloneDelete,
+            reinterpret_cast <PSTREAM_POINTER_CONTEXT> (
+                Clone -> Context
+                ) -> Generation,
+            0,
+            0
+            );
+
         KsStreamPointerDelete (Clone);
 
         Clone = NextClone;
@@ -739,7 +864,6 @@ Return Value:
             }
 
             m_FrameNumber   = 0;
-            m_DroppedFrames = 0;
             break;
 
         case KSSTATE_PAUSE:
@@ -760,6 +884,15 @@ Return Value:
             break;
 
         case KSSTATE_RUN:
+            //
+            // Schedule derived timestamps are anchored to the clock again
+            // whenever the pin starts running.
+            //
+            m_ScheduleTimestamps =
+                m_Device -> GetTimestampMode () == AvshwsTimestampSchedule;
+
+            PtsReset (&m_Schedule, m_VideoInfoHeader -> AvgTimePerFrame);
+
             //
             // Start the hardware simulation or unpause it depending on
             // whether we're initially running or we've paused and restarted.
@@ -934,6 +1067,28 @@ Return Value:
 
         }
 
+        //
+        // P010 is planar: its size isn't biBitCount per pixel rounded up
+        // to DWORD rows as KS_DIBSIZE computes it, and 4:2:0 needs an even
+        // width and height.
+        //
+        ULONG P010Size = 0;
+
+        if (callerDataRange->VideoInfoHeader.bmiHeader.biCompression ==
+            FOURCC_P010) {
+
+            P010Size = ConvertFrameSize (
+                AvshwsFormatP010,
+                (ULONG)callerDataRange->VideoInfoHeader.bmiHeader.biWidth,
+                (ULONG)abs (callerDataRange->VideoInfoHeader.bmiHeader.biHeight)
+                );
+
+            if (P010Size == 0) {
+                return STATUS_NO_MATCH;
+            }
+
+        }
+
         DataFormatSize = 
             sizeof (KSDATAFORMAT) + 
             KS_SIZE_VIDEOHEADER (&callerDataRange->VideoInfoHeader);
@@ -999,6 +1154,7 @@ Return Value:
         //
         FormatVideoInfoHeader->VideoInfoHeader.bmiHeader.biSizeImage =
             FormatVideoInfoHeader->DataFormat.SampleSize = 
+            P010Size ? P010Size :
             KS_DIBSIZE (FormatVideoInfoHeader->VideoInfoHeader.bmiHeader);
 
         //
@@ -1197,7 +1353,10 @@ Return Value:
                 VIRange -> VideoInfoHeader.bmiHeader.biHeight) ||
 
             (ConnectionFormat -> VideoInfoHeader.bmiHeader.biCompression !=
-                VIRange -> VideoInfoHeader.bmiHeader.biCompression) 
+                VIRange -> VideoInfoHeader.bmiHeader.biCompression) ||
+
+            (ConnectionFormat -> VideoInfoHeader.bmiHeader.biBitCount !=
+                VIRange -> VideoInfoHeader.bmiHeader.biBitCount)
 
             ) {
 
@@ -1208,7 +1367,7 @@ Return Value:
             //
             // Compute the minimum size of our buffers to validate against.
             // The image synthesis routines synthesize |biHeight| rows of
-            // biWidth pixels in either RGB24 or UYVY.  In order to ensure
+            // biWidth pixels in either RGB24, RGB32, UYVY or P010.  In order to ensure
             // safe synthesis into the buffer, we need to know how large an
             // image this will produce.
             //
@@ -1231,8 +1390,9 @@ Return Value:
             }
 
             //
-            // We only support KS_BI_RGB (24) and KS_BI_YUV422 (16), so
-            // this is valid for those formats.
+            // We only support KS_BI_RGB (24, 32), KS_BI_YUV422 (16) and
+            // P010 (24, three bytes per pixel over its two planes), so this
+            // is valid for those formats.
             //
             else if (!MultiplyCheckOverflow (
                 ImageSize,
@@ -1307,6 +1467,240 @@ Return Value:
 #pragma code_seg()
 #endif // ALLOC_PRAGMA
 
+void
+CCapturePin::
+BeginBatch (
+    OUT PCOMPLETION_BATCH Batch,
+    IN ULONG Count
+    )
+
+/*++
+
+Routine Description:
+
+    Read the clock, the performance counter and the drop count once for a
+    batch of buffers completed together, such as the burst of a DPC that
+    catches up after a delay.  The clock and the performance counter are
+    read back to back, so the offset between the two domains carries no
+    DPC or queueing delay.  Timestamps from the schedule need neither but
+    every few frames.
+
+Arguments:
+
+    Batch -
+        Receives the readings
+
+    Count -
+        The number of buffers in the batch
+
+Return Value:
+
+    None
+
+--*/
+
+{
+
+    Batch -> ClockValid = m_Clock &&
+        (!m_ScheduleTimestamps || PtsNeedsClock (&m_Schedule));
+    Batch -> ClockTime = Batch -> ClockValid ? m_Clock -> GetTime () : 0;
+    Batch -> PerformanceTime =
+        m_ScheduleTimestamps ? 0 : QueryPerformanceTime ();
+    Batch -> DropCount = (LONGLONG)m_Device -> GetDroppedFrameCount ();
+    Batch -> Count = Count;
+
+}
+
+/*************************************************/
+
+
+void
+CCapturePin::
+StampFrame (
+    IN PKSSTREAM_HEADER StreamHeader,
+    IN PSTREAM_POINTER_CONTEXT Context,
+    IN PCOMPLETION_BATCH Batch,
+    IN ULONG Index
+    )
+
+/*++
+
+Routine Description:
+
+    Set anything required in the stream header of a filled buffer which
+    has not yet been set.  If we have a clock, we can timestamp the
+    sample.  Called at DPC in mapped capture mode and from processing in
+    copy capture mode.
+
+Arguments:
+
+    StreamHeader -
+        The stream header of the filled buffer
+
+    Context -
+        The capture instant of the frame in the buffer
+
+    Batch -
+        The readings of the batch the buffer is completed in
+
+    Index -
+        The position of the buffer in the batch, oldest first
+
+Return Value:
+
+    None
+
+--*/
+
+{
+
+    StreamHeader -> Duration =
+        m_VideoInfoHeader -> AvgTimePerFrame;
+
+    StreamHeader -> PresentationTime.Numerator =
+        StreamHeader -> PresentationTime.Denominator = 1;
+
+    //
+    // If a clock has been assigned, timestamp the packets with the
+    // time shown on the clock.
+    //
+    if (m_Clock) {
+
+        LONGLONG ClockTime = Batch -> ClockTime;
+
+        //
+        // The buffers of a batch were filled a frame period apart, the
+        // newest just now.
+        //
+        LONGLONG ScheduleTime = TsBatchTime (
+            ClockTime,
+            Batch -> Count,
+            Index,
+            m_VideoInfoHeader -> AvgTimePerFrame
+            );
+
+        //
+        // From the schedule, the time follows from the tick that filled
+        // the buffer; the clock only anchors and corrects it.  Otherwise,
+        // if the producer stamped the frame, translate its capture
+        // instant into the graph clock domain, or else place the older
+        // buffers of a batch on the frame schedule.
+        //
+        if (m_ScheduleTimestamps) {
+
+            ClockTime = PtsStamp (
+                &m_Schedule,
+                Context -> Tick,
+                Batch -> ClockValid,
+                ScheduleTime
+                );
+
+        } else if (Context -> ProducerTimeValid) {
+
+            ClockTime = TsMapProducerTime (
+                ClockTime,
+                Batch -> PerformanceTime,
+                Context -> ProducerTime
+                );
+
+        } else {
+
+            ClockTime = ScheduleTime;
+
+        }
+
+        //
+        // Keep the stream strictly monotonic in case the producer's
+        // stamps go backwards or a frame is delivered twice.
+        //
+        ClockTime = TsKeepMonotonic (
+            m_FrameNumber == 0,
+            m_PresentationTime,
+            ClockTime
+            );
+
+        m_PresentationTime = ClockTime;
+
+        StreamHeader -> PresentationTime.Time = ClockTime;
+
+        StreamHeader -> OptionsFlags =
+            KSSTREAM_HEADER_OPTIONSF_TIMEVALID |
+            KSSTREAM_HEADER_OPTIONSF_DURATIONVALID;
+
+    } else {
+        //
+        // If there is no clock, don't time stamp the packets.
+        //
+        StreamHeader -> PresentationTime.Time = 0;
+    }
+
+    //
+    // Increment the frame number.  This is the total count of frames which
+    // have attempted capture.
+    //
+    m_FrameNumber++;
+
+    //
+    // Double check the Stream Header size.  AVStream makes no guarantee
+    // that because StreamHeaderSize is set to a specific size that you
+    // will get that size.  If the proper data type handlers are not
+    // installed, the stream header will be of default size.
+    //
+    if (StreamHeader -> Size >= sizeof (KSSTREAM_HEADER) +
+        sizeof (KS_FRAME_INFO)) {
+
+        PKS_FRAME_INFO FrameInfo = reinterpret_cast <PKS_FRAME_INFO> (
+            StreamHeader + 1
+            );
+
+        FrameInfo -> ExtendedHeaderSize = sizeof (KS_FRAME_INFO);
+        FrameInfo -> dwFrameFlags       = KS_VIDEO_FLAG_FRAME;
+        FrameInfo -> PictureNumber      = (LONGLONG)m_FrameNumber;
+
+        //
+        // Frames the hardware could not deliver because not enough
+        // buffer was queued.  Producer stalls repeat a frame rather
+        // than drop one and are only reported in the statistics.
+        //
+        FrameInfo -> DropCount = Batch -> DropCount;
+    }
+
+}
+
+/*************************************************/
+
+
+void
+CCapturePin::
+FrameReady (
+    )
+
+/*++
+
+Routine Description:
+
+    Called at DPC in copy capture mode when the hardware has a frame ready.
+    Processing copies it into the buffer at the leading edge.
+
+Arguments:
+
+    None
+
+Return Value:
+
+    None
+
+--*/
+
+{
+
+    KsPinAttemptProcessing (m_Pin, TRUE);
+
+}
+
+/*************************************************/
+
+
 void
 CCapturePin::
 CompleteMappings (
@@ -1334,118 +1728,83 @@ Return Value:
 
 {
 
-    ULONG MappingsRemaining = NumMappings;
+    m_Device -> GetTrace () -> Record (
+        AvshwsTraceSgComplete,
+        0,
+        NumMappings,
+        0
+        );
 
     //
-    // Walk through the clones list and delete clones whose time has come.
-    // The list is guaranteed to be kept in the order they were cloned.
+    // Find the clones whose time has come.  The list is guaranteed to be
+    // kept in the order they were cloned, so they are the first Completed
+    // clones: those whose mappings have all completed.
     //
+    ULONG Completed = 0;
     PKSSTREAM_POINTER Clone = KsPinGetFirstCloneStreamPointer (m_Pin);
 
-    while (MappingsRemaining && Clone) {
+    while (Completed < NumMappings && Clone &&
+        Clone -> StreamHeader -> DataUsed >= Clone -> OffsetOut.Remaining) {
 
-        PKSSTREAM_POINTER NextClone = KsStreamPointerGetNextClone (Clone);
-
-        // 
-        // If we have completed all remaining mappings in this clone, it
-        // is an indication that the clone is ready to be deleted and the
-        // buffer released.  Set anything required in the stream header which
-        // has not yet been set.  If we have a clock, we can timestamp the
-        // sample.
-        //
-        if (Clone -> StreamHeader -> DataUsed >= Clone -> OffsetOut.Remaining) {
-            Clone -> StreamHeader -> Duration =
-                m_VideoInfoHeader -> AvgTimePerFrame;
-
-            Clone -> StreamHeader -> PresentationTime.Numerator =
-                Clone -> StreamHeader -> PresentationTime.Denominator = 1;
-
-            //
-            // If a clock has been assigned, timestamp the packets with the
-            // time shown on the clock. 
-            //
-            if (m_Clock) {
+        Completed++;
+        Clone = KsStreamPointerGetNextClone (Clone);
 
-                LONGLONG ClockTime = m_Clock -> GetTime ();
+    }
 
-                Clone -> StreamHeader -> PresentationTime.Time = ClockTime;
+    //
+    // If only part of the mappings in the next clone have been completed,
+    // update the pointers.  Since we're guaranteed this won't advance
+    // to a new frame by the check above, it won't fail.
+    //
+    if (Completed < NumMappings && Clone) {
+        (void)KsStreamPointerAdvanceOffsets (
+            Clone,
+            0,
+            Clone -> StreamHeader -> DataUsed,
+            FALSE
+            );
+    }
 
-                Clone -> StreamHeader -> OptionsFlags =
-                    KSSTREAM_HEADER_OPTIONSF_TIMEVALID |
-                    KSSTREAM_HEADER_OPTIONSF_DURATIONVALID;
+    //
+    // A DPC that runs late catches up with several completions at once.
+    // Read the clock and the drop count once for all of them, then finish
+    // the stream headers and let the buffers go.  We've already updated
+    // DataUsed above.
+    //
+    if (Completed) {
 
-            } else {
-	      //
-	      // If there is no clock, don't time stamp the packets.
-	      //
-	      Clone -> StreamHeader -> PresentationTime.Time = 0;
-	      
-            }
+        COMPLETION_BATCH Batch;
+        BeginBatch (&Batch, Completed);
 
-            //
-            // Increment the frame number.  This is the total count of frames which
-            // have attempted capture.
-            //
-            m_FrameNumber++;
+        Clone = KsPinGetFirstCloneStreamPointer (m_Pin);
 
-            //
-            // Double check the Stream Header size.  AVStream makes no guarantee
-            // that because StreamHeaderSize is set to a specific size that you
-            // will get that size.  If the proper data type handlers are not 
-            // installed, the stream header will be of default size.
-            //
-            if ( Clone -> StreamHeader -> Size >= sizeof (KSSTREAM_HEADER) +
-                sizeof (KS_FRAME_INFO)) {
+        for (ULONG Index = 0; Index < Completed; Index++) {
 
-                PKS_FRAME_INFO FrameInfo = reinterpret_cast <PKS_FRAME_INFO> (
-                    Clone -> StreamHeader + 1
-                    );
-    
-                FrameInfo -> ExtendedHeaderSize = sizeof (KS_FRAME_INFO);
-                FrameInfo -> dwFrameFlags       = KS_VIDEO_FLAG_FRAME;
-                FrameInfo -> PictureNumber      = (LONGLONG)m_FrameNumber;
+            PKSSTREAM_POINTER NextClone = KsStreamPointerGetNextClone (Clone);
 
-                // I don't really have a way to tell if the device has dropped a frame 
-                // or was not able to send a frame on time.
-                FrameInfo -> DropCount = (LONGLONG)m_DroppedFrames;
-            }
+            PSTREAM_POINTER_CONTEXT SPContext =
+                reinterpret_cast <PSTREAM_POINTER_CONTEXT> (Clone -> Context);
 
+            StampFrame (Clone -> StreamHeader, SPContext, &Batch, Index);
 
-            //
-            // If all of the mappings in this clone have been completed,
-            // delete the clone.  We've already updated DataUsed above.
-            //
+            m_Device -> GetTrace () -> Record (
+                AvshwsTraceCloneDelete,
+                SPContext -> Generation,
+                m_FrameNumber,
+                Clone -> StreamHeader -> DataUsed
+                );
 
-            MappingsRemaining--;
             KsStreamPointerDelete (Clone);
 
-        } else {
-            //
-            // If only part of the mappings in this clone have been completed,
-            // update the pointers.  Since we're guaranteed this won't advance
-            // to a new frame by the check above, it won't fail.
-            //
-            (void)KsStreamPointerAdvanceOffsets (
-                Clone,
-                0,
-                Clone -> StreamHeader -> DataUsed,
-                FALSE
-                );
-
-            MappingsRemaining = 0;
+            Clone = NextClone;
 
         }
 
-        //
-        // Go to the next clone.
-        //
-        Clone = NextClone;
-
     }
 
     //
     // If we've used all the mappings in hardware and pended, we can kick
-    // processing to happen again if we've completed mappings.
+    // processing to happen again, once for the whole batch.
     //
     if (m_PendIo) {
         m_PendIo = TRUE;
@@ -1540,6 +1899,170 @@ FormatRGB24Bpp_Capture = {
     }
 }; 
 
+//
+// FormatRGB32Bpp_Capture:
+//
+// This is the data range description of the RGB32 capture format we support.
+// Consumers that work on 32 bit pixels can take frames without expanding
+// them from 24 bits.
+//
+const 
+KS_DATARANGE_VIDEO 
+FormatRGB32Bpp_Capture = {
+
+    //
+    // KSDATARANGE
+    //
+    {   
+        sizeof (KS_DATARANGE_VIDEO),                // FormatSize
+        0,                                          // Flags
+        D_X * D_Y * 4,                              // SampleSize
+        0,                                          // Reserved
+
+        STATICGUIDOF (KSDATAFORMAT_TYPE_VIDEO),     // aka. MEDIATYPE_Video
+        0xe436eb7e, 0x524f, 0x11ce, 0x9f, 0x53, 0x00, 0x20, 
+            0xaf, 0x0b, 0xa7, 0x70,                 // aka. MEDIASUBTYPE_RGB32,
+        STATICGUIDOF (KSDATAFORMAT_SPECIFIER_VIDEOINFO) // aka. FORMAT_VideoInfo
+    },
+
+    TRUE,               // BOOL,  bFixedSizeSamples (all samples same size?)
+    FALSE,              // BOOL,  bTemporalCompression (all I frames?)
+    0,                  // Reserved (was StreamDescriptionFlags)
+    0,                  // Reserved (was MemoryAllocationFlags   
+                        //           (KS_VIDEO_ALLOC_*))
+    //
+    // _KS_VIDEO_STREAM_CONFIG_CAPS  
+    //
+    {
+        STATICGUIDOF( KSDATAFORMAT_SPECIFIER_VIDEOINFO ), // GUID
+        KS_AnalogVideo_None,                            // AnalogVideoStandard
+        D_X,D_Y,        // InputSize, (the inherent size of the incoming signal
+                        //             with every digitized pixel unique)
+        D_X,D_Y,        // MinCroppingSize, smallest rcSrc cropping rect allowed
+        D_X,D_Y,        // MaxCroppingSize, largest  rcSrc cropping rect allowed
+        8,              // CropGranularityX, granularity of cropping size
+        1,              // CropGranularityY
+        8,              // CropAlignX, alignment of cropping rect 
+        1,              // CropAlignY;
+        D_X, D_Y,       // MinOutputSize, smallest bitmap stream can produce
+        D_X, D_Y,       // MaxOutputSize, largest  bitmap stream can produce
+        8,              // OutputGranularityX, granularity of output bitmap size
+        1,              // OutputGranularityY;
+        0,              // StretchTapsX  (0 no stretch, 1 pix dup, 2 interp...)
+        0,              // StretchTapsY
+        0,              // ShrinkTapsX 
+        0,              // ShrinkTapsY 
+        333667,         // MinFrameInterval, 100 nS units
+        640000000,      // MaxFrameInterval, 100 nS units
+        8 * 4 * 30 * D_X * D_Y,  // MinBitsPerSecond;
+        8 * 4 * 30 * D_X * D_Y   // MaxBitsPerSecond;
+    }, 
+        
+    //
+    // KS_VIDEOINFOHEADER (default format)
+    //
+    {
+        0,0,0,0,                            // RECT  rcSource; 
+        0,0,0,0,                            // RECT  rcTarget; 
+        D_X * D_Y * 4 * 8 * 30,             // DWORD dwBitRate;
+        0L,                                 // DWORD dwBitErrorRate; 
+        333667,                             // REFERENCE_TIME  AvgTimePerFrame;   
+        sizeof (KS_BITMAPINFOHEADER),       // DWORD biSize;
+        D_X,                                // LONG  biWidth;
+        D_Y,                                // LONG  biHeight;
+        1,                                  // WORD  biPlanes;
+        32,                                 // WORD  biBitCount;
+        KS_BI_RGB,                          // DWORD biCompression;
+        D_X * D_Y * 4,                      // DWORD biSizeImage;
+        0,                                  // LONG  biXPelsPerMeter;
+        0,                                  // LONG  biYPelsPerMeter;
+        0,                                  // DWORD biClrUsed;
+        0                                   // DWORD biClrImportant;
+    }
+}; 
+
+//
+// FormatP010_Capture:
+//
+// This is the data range description of the P010 capture format we support:
+// 10 bit 4:2:0 for consumers of high bit depth video.  P010 is three bytes
+// per pixel over its two planes, which is what biBitCount says.
+//
+const 
+KS_DATARANGE_VIDEO 
+FormatP010_Capture = {
+
+    //
+    // KSDATARANGE
+    //
+    {   
+        sizeof (KS_DATARANGE_VIDEO),                // FormatSize
+        0,                                          // Flags
+        D_X * D_Y * 3,                              // SampleSize
+        0,                                          // Reserved
+
+        STATICGUIDOF (KSDATAFORMAT_TYPE_VIDEO),     // aka. MEDIATYPE_Video
+        0x30313050, 0x0000, 0x0010, 0x80, 0x00, 0x00, 0xaa, 
+            0x00, 0x38, 0x9b, 0x71,                 // aka. MEDIASUBTYPE_P010
+        STATICGUIDOF (KSDATAFORMAT_SPECIFIER_VIDEOINFO) // aka. FORMAT_VideoInfo
+    },
+
+    TRUE,               // BOOL,  bFixedSizeSamples (all samples same size?)
+    FALSE,              // BOOL,  bTemporalCompression (all I frames?)
+    0,                  // Reserved (was StreamDescriptionFlags)
+    0,                  // Reserved (was MemoryAllocationFlags   
+                        //           (KS_VIDEO_ALLOC_*))
+    //
+    // _KS_VIDEO_STREAM_CONFIG_CAPS  
+    //
+    {
+        STATICGUIDOF( KSDATAFORMAT_SPECIFIER_VIDEOINFO ), // GUID
+        KS_AnalogVideo_None,                            // AnalogVideoStandard
+        D_X,D_Y,        // InputSize, (the inherent size of the incoming signal
+                        //             with every digitized pixel unique)
+        D_X,D_Y,        // MinCroppingSize, smallest rcSrc cropping rect allowed
+        D_X,D_Y,        // MaxCroppingSize, largest  rcSrc cropping rect allowed
+        8,              // CropGranularityX, granularity of cropping size
+        1,              // CropGranularityY
+        8,              // CropAlignX, alignment of cropping rect 
+        1,              // CropAlignY;
+        D_X, D_Y,       // MinOutputSize, smallest bitmap stream can produce
+        D_X, D_Y,       // MaxOutputSize, largest  bitmap stream can produce
+        8,              // OutputGranularityX, granularity of output bitmap size
+        1,              // OutputGranularityY;
+        0,              // StretchTapsX  (0 no stretch, 1 pix dup, 2 interp...)
+        0,              // StretchTapsY
+        0,              // ShrinkTapsX 
+        0,              // ShrinkTapsY 
+        333667,         // MinFrameInterval, 100 nS units
+        640000000,      // MaxFrameInterval, 100 nS units
+        8 * 3 * 30 * D_X * D_Y,  // MinBitsPerSecond;
+        8 * 3 * 30 * D_X * D_Y   // MaxBitsPerSecond;
+    }, 
+        
+    //
+    // KS_VIDEOINFOHEADER (default format)
+    //
+    {
+        0,0,0,0,                            // RECT  rcSource; 
+        0,0,0,0,                            // RECT  rcTarget; 
+        D_X * D_Y * 3 * 8 * 30,             // DWORD dwBitRate;
+        0L,                                 // DWORD dwBitErrorRate; 
+        333667,                             // REFERENCE_TIME  AvgTimePerFrame;   
+        sizeof (KS_BITMAPINFOHEADER),       // DWORD biSize;
+        D_X,                                // LONG  biWidth;
+        D_Y,                                // LONG  biHeight;
+        1,                                  // WORD  biPlanes;
+        24,                                 // WORD  biBitCount;
+        FOURCC_P010,                        // DWORD biCompression;
+        D_X * D_Y * 3,                      // DWORD biSizeImage;
+        0,                                  // LONG  biXPelsPerMeter;
+        0,                                  // LONG  biYPelsPerMeter;
+        0,                                  // DWORD biClrUsed;
+        0                                   // DWORD biClrImportant;
+    }
+}; 
+
 //
 // FormatYUY2_Capture:
 //
@@ -1662,11 +2185,14 @@ DECLARE_SIMPLE_FRAMING_EX (
 // CapturePinDataRanges:
 //
 // This is the list of data ranges supported on the capture pin.  We support
-// two: one RGB24, and one YUY2.
+// three: RGB24, RGB32 and P010.  RGB24 stays first so that clients which
+// take the first range keep getting it.
 //
 const 
 PKSDATARANGE 
 CapturePinDataRanges [CAPTURE_PIN_DATA_RANGE_COUNT] = {
     //(PKSDATARANGE) &FormatYUY2_Capture,
-    (PKSDATARANGE) &FormatRGB24Bpp_Capture
+    (PKSDATARANGE) &FormatRGB24Bpp_Capture,
+    (PKSDATARANGE) &FormatRGB32Bpp_Capture,
+    (PKSDATARANGE) &FormatP010_Capture
     };
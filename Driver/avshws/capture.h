@@ -20,6 +20,9 @@
         Cloning would not be necessary with this technique.  It would be 
         similiar to the way "AVSSamp" works, but it would be pin-centric.
 
+        The copy capture mode (AvshwsCaptureCopy) works that way, with the
+        synthesis buffer standing in for the common buffer.
+
     History:
 
         created 3/8/2001
@@ -34,12 +37,49 @@
 // size as the scatter/gather mappings in order to fake scatter / gather
 // bus-master DMA.
 //
+// The hardware simulation also records the producer timestamp of the frame
+// it filled the clone with so that CompleteMappings can stamp the buffer
+// with the capture instant rather than the completion time.  In copy
+// capture mode there are no clones; the same record is kept on the stack
+// for the buffer at the leading edge.
+//
 typedef struct _STREAM_POINTER_CONTEXT {
-    
+
     PUCHAR BufferVirtual;
 
+    BOOLEAN ProducerTimeValid;
+    LONGLONG ProducerTime;
+
+    //
+    // The injected frame the clone was filled with, for the event trace.
+    //
+    ULONG Generation;
+
+    //
+    // The tick that filled the clone, for schedule derived timestamps.
+    //
+    ULONG Tick;
+
 } STREAM_POINTER_CONTEXT, *PSTREAM_POINTER_CONTEXT;
 
+//
+// COMPLETION_BATCH:
+//
+// What is read once for all the buffers completed together: the clock and
+// the performance counter (read back to back), the drop count, and how many
+// buffers there are.  With schedule derived timestamps the clock is only
+// read when the schedule needs it (ClockValid).
+//
+typedef struct _COMPLETION_BATCH {
+
+    BOOLEAN ClockValid;
+    LONGLONG ClockTime;
+    LONGLONG PerformanceTime;
+    LONGLONG DropCount;
+    ULONG Count;
+
+} COMPLETION_BATCH, *PCOMPLETION_BATCH;
+
 //
 // CCapturePin:
 //
@@ -110,7 +150,14 @@ private:
     LONGLONG m_PresentationTime;
 
     LONGLONG m_FrameNumber;
-    LONGLONG m_DroppedFrames;
+
+    //
+    // Whether buffers are timestamped from the frame schedule rather than
+    // the clock (AvshwsTimestampSchedule), latched when the pin starts
+    // running, and the schedule, anchored again every time it does.
+    //
+    BOOLEAN m_ScheduleTimestamps;
+    PTS_SCHEDULE m_Schedule;
 
     //
     // CleanupReferences():
@@ -147,6 +194,43 @@ private:
     NTSTATUS
     Process (
         );
+
+    //
+    // ProcessCopy():
+    //
+    // The processing of copy capture mode: copy the frame the hardware
+    // readied into the buffer at the leading edge and advance.  Pends if
+    // no frame is ready; the tick kicks processing again.
+    //
+    NTSTATUS
+    ProcessCopy (
+        );
+
+    //
+    // BeginBatch():
+    //
+    // Read what the stamping of Count buffers completed together needs.
+    //
+    void
+    BeginBatch (
+        OUT PCOMPLETION_BATCH Batch,
+        IN ULONG Count
+        );
+
+    //
+    // StampFrame():
+    //
+    // Set the duration, timestamp and frame info of a filled buffer, the
+    // Index'th (oldest first) of Batch.  Context holds the capture instant
+    // of the frame in it.
+    //
+    void
+    StampFrame (
+        IN PKSSTREAM_HEADER StreamHeader,
+        IN PSTREAM_POINTER_CONTEXT Context,
+        IN PCOMPLETION_BATCH Batch,
+        IN ULONG Index
+        );
     //
     // CaptureVideoInfoHeader():
     //
@@ -210,6 +294,17 @@ public:
         IN ULONG NumMappings
         );
 
+    //
+    // ICaptureSink::FrameReady()
+    //
+    // The notification of copy capture mode: the hardware has a frame
+    // ready for the next buffer.  Kicks processing.
+    //
+    virtual
+    void
+    FrameReady (
+        );
+
     /*************************************************
 
         Dispatch Routines
@@ -0,0 +1,2260 @@
+/**************************************************************************
+
+    AVStream Simulated Hardware Sample
+
+    File:
+
+        convert.cpp
+
+    Abstract:
+
+        Pixel format conversion of injected frames.  See convert.h.
+
+        Conversion runs at the producer's property call and touches only
+        nonpaged frame buffers.  This entire file is in locked segments.
+
+    History:
+
+        created 10/18/2026
+
+**************************************************************************/
+
+#include "portable.h"
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__x86_64__)
+#define CONVERT_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+//
+// CONVERT_ROW:
+//
+// Convert one row of Width pixels.  Planes are the input rows the output
+// row is made from: the row of a packed format, or the Y, U and V (or Y
+// and UV) rows of a planar one.
+//
+// The row converters are templates on an output store class (see
+// RGB24_STORE and RGB32_STORE below), which writes pixels computed as
+// B, G, R, X in the output format.
+//
+typedef void
+(*CONVERT_ROW) (
+    IN const UCHAR * const *Planes,
+    OUT PUCHAR Destination,
+    IN ULONG Width
+    );
+
+//
+// CONVERT_ROW_PAIR:
+//
+// Convert two rows of Width pixels to P010, which has one row of chroma
+// for each pair of luma rows.  Upper and Lower are the input rows of each
+// output row, as for CONVERT_ROW.
+//
+typedef void
+(*CONVERT_ROW_PAIR) (
+    IN const UCHAR * const *Upper,
+    IN const UCHAR * const *Lower,
+    OUT PUSHORT LumaUpper,
+    OUT PUSHORT LumaLower,
+    OUT PUSHORT Chroma,
+    IN ULONG Width
+    );
+
+//
+// CONVERT_CHUNK:
+//
+// RGB input is converted to P010 through 12 bit B, G, R, X components (see
+// RGB24_INPUT and the others below), in chunks of this many pixels so the
+// intermediate rows fit on the stack.
+//
+#define CONVERT_CHUNK 64
+
+//
+// P010 weights of 12 bit full range components, derived from BT601 at
+// compile time:
+//
+//     Y  = 64 + (Weights . BGR) >> 15                     (one pixel)
+//     Cb = 512 + (Weights . BGR) >> 17, likewise Cr        (sum of 2x2)
+//
+// The chroma weights sum to 0 so that grey has neutral chroma exactly.
+//
+static constexpr LONG
+P010Weight (
+    IN LONGLONG Numerator,
+    IN LONGLONG Denominator
+    )
+{
+    return (LONG)BT601::RoundDivide (Numerator, Denominator);
+}
+
+static constexpr LONG P010_Y_R = P010Weight ((876LL * BT601::Kr) << 15, 4095LL * 10000);
+static constexpr LONG P010_Y_G = P010Weight ((876LL * BT601::Kg) << 15, 4095LL * 10000);
+static constexpr LONG P010_Y_B = P010Weight ((876LL * BT601::Kb) << 15, 4095LL * 10000);
+
+static constexpr LONG P010_CB_B = P010Weight (896LL << 16, 4 * 4095);
+static constexpr LONG P010_CB_R = -P010Weight (
+    (896LL * BT601::Kr) << 16,
+    4LL * 4095 * (10000 - BT601::Kb)
+    );
+static constexpr LONG P010_CB_G = -(P010_CB_B + P010_CB_R);
+
+static constexpr LONG P010_CR_R = P010_CB_B;
+static constexpr LONG P010_CR_B = -P010Weight (
+    (896LL * BT601::Kb) << 16,
+    4LL * 4095 * (10000 - BT601::Kr)
+    );
+static constexpr LONG P010_CR_G = -(P010_CR_R + P010_CR_B);
+
+static_assert (
+    64 + ((4095 * (P010_Y_R + P010_Y_G + P010_Y_B) + (1 << 14)) >> 15) == 940,
+    "P010 white is 940"
+    );
+
+/**************************************************************************
+
+    LOCKED CODE
+
+**************************************************************************/
+
+#ifdef ALLOC_PRAGMA
+#pragma code_seg()
+#endif // ALLOC_PRAGMA
+
+
+//
+// YuvToBgr():
+//
+// Convert one BT.601 limited range pixel to B, G, R.  The coefficients
+// are fixed point with 6 fractional bits (luma with 7) and the arithmetic
+// is the same as the SSE2 version, so both give identical results.
+//
+static FORCEINLINE
+void
+YuvToBgr (
+    IN LONG Y,
+    IN LONG U,
+    IN LONG V,
+    OUT PUCHAR Pixel
+    )
+{
+    if (Y < 16) {
+        Y = 16;
+    }
+
+    LONG Luma = (((Y - 16) * 149) >> 1) + 32;
+
+    U -= 128;
+    V -= 128;
+
+    LONG B = (Luma + 129 * U) >> 6;
+    LONG G = (Luma - 25 * U - 52 * V) >> 6;
+    LONG R = (Luma + 102 * V) >> 6;
+
+    Pixel [0] = (UCHAR)(B < 0 ? 0 : B > 255 ? 255 : B);
+    Pixel [1] = (UCHAR)(G < 0 ? 0 : G > 255 ? 255 : G);
+    Pixel [2] = (UCHAR)(R < 0 ? 0 : R > 255 ? 255 : R);
+}
+
+//
+// Scale16To8():
+// Scale16To12():
+// Widen8To12():
+// Sample10To8():
+//
+// Rescale full range components, rounded to nearest, and reduce a P010
+// sample to 8 bits.
+//
+static FORCEINLINE
+UCHAR
+Scale16To8 (
+    IN ULONG Value
+    )
+{
+    ULONG Rounded = Value + 128 > 0xFFFF ? 0xFFFF : Value + 128;
+    return (UCHAR)((Rounded - (Rounded >> 8)) >> 8);
+}
+
+static FORCEINLINE
+USHORT
+Scale16To12 (
+    IN ULONG Value
+    )
+{
+    return (USHORT)((Value + 8 > 0xFFFF ? 0xFFFF : Value + 8) >> 4);
+}
+
+static FORCEINLINE
+USHORT
+Widen8To12 (
+    IN ULONG Value
+    )
+{
+    return (USHORT)((Value << 4) | (Value >> 4));
+}
+
+static FORCEINLINE
+UCHAR
+Sample10To8 (
+    IN ULONG Value
+    )
+{
+    return (UCHAR)((Value + 128 > 0xFFFF ? 0xFFFF : Value + 128) >> 8);
+}
+
+#ifdef CONVERT_USE_SSE2
+
+//
+// Scale16To8x8():
+// Scale16To12x8():
+// Widen8To12x8():
+// Sample10To8x8():
+//
+// The same for 8 16 bit lanes.  The saturating add is what the scalar
+// versions clamp for.
+//
+static FORCEINLINE
+__m128i
+Scale16To8x8 (
+    IN __m128i Values
+    )
+{
+    __m128i Rounded = _mm_adds_epu16 (Values, _mm_set1_epi16 (128));
+    return _mm_srli_epi16 (
+        _mm_sub_epi16 (Rounded, _mm_srli_epi16 (Rounded, 8)),
+        8
+        );
+}
+
+static FORCEINLINE
+__m128i
+Scale16To12x8 (
+    IN __m128i Values
+    )
+{
+    return _mm_srli_epi16 (_mm_adds_epu16 (Values, _mm_set1_epi16 (8)), 4);
+}
+
+static FORCEINLINE
+__m128i
+Widen8To12x8 (
+    IN __m128i Values
+    )
+{
+    return _mm_or_si128 (_mm_slli_epi16 (Values, 4), _mm_srli_epi16 (Values, 4));
+}
+
+static FORCEINLINE
+__m128i
+Sample10To8x8 (
+    IN __m128i Values
+    )
+{
+    return _mm_srli_epi16 (_mm_adds_epu16 (Values, _mm_set1_epi16 (128)), 8);
+}
+
+//
+// PackBgrx():
+//
+// Pack 4 B, G, R, X pixels into their first 12 bytes as B, G, R.  The
+// last 4 bytes are zero.
+//
+static FORCEINLINE
+__m128i
+PackBgrx (
+    IN __m128i Pixels
+    )
+{
+    const __m128i Even = _mm_set_epi32 (0, 0x00FFFFFF, 0, 0x00FFFFFF);
+    const __m128i Odd = _mm_set_epi32 (0x0000FFFF, 0xFF000000, 0x0000FFFF, 0xFF000000);
+    const __m128i LowHalf = _mm_set_epi32 (0, 0, -1, -1);
+
+    //
+    // Close the gap within each half, then between the halves.
+    //
+    __m128i Halves = _mm_or_si128 (
+        _mm_and_si128 (Pixels, Even),
+        _mm_and_si128 (_mm_srli_epi64 (Pixels, 8), Odd)
+        );
+
+    return _mm_or_si128 (
+        _mm_and_si128 (Halves, LowHalf),
+        _mm_srli_si128 (_mm_andnot_si128 (LowHalf, Halves), 2)
+        );
+}
+
+//
+// StoreBgr8():
+//
+// Store 8 pixels packed by PackBgrx as 24 bytes, without touching the
+// bytes after them.
+//
+static FORCEINLINE
+void
+StoreBgr8 (
+    OUT PUCHAR Destination,
+    IN __m128i Low,
+    IN __m128i High
+    )
+{
+    ULONG Tail = (ULONG)_mm_cvtsi128_si32 (_mm_srli_si128 (High, 8));
+
+    _mm_storeu_si128 ((__m128i *)Destination, Low);
+    _mm_storel_epi64 ((__m128i *)(Destination + 12), High);
+    RtlCopyMemory (Destination + 20, &Tail, sizeof (Tail));
+}
+
+//
+// SwapRedBlue():
+//
+// R, G, B, A to B, G, R, A for 4 pixels.
+//
+static FORCEINLINE
+__m128i
+SwapRedBlue (
+    IN __m128i Pixels
+    )
+{
+    const __m128i RedBlue = _mm_set1_epi32 (0x00FF00FF);
+
+    __m128i Swapped = _mm_and_si128 (Pixels, RedBlue);
+    Swapped = _mm_shufflelo_epi16 (Swapped, _MM_SHUFFLE (2, 3, 0, 1));
+    Swapped = _mm_shufflehi_epi16 (Swapped, _MM_SHUFFLE (2, 3, 0, 1));
+
+    return _mm_or_si128 (_mm_andnot_si128 (RedBlue, Pixels), Swapped);
+}
+
+//
+// ExpandBgr4():
+//
+// Expand the first 12 bytes of Pixels, 4 B, G, R pixels, to B, G, R, X
+// with X opaque.  Each pixel moves up by its index in bytes.
+//
+static FORCEINLINE
+__m128i
+ExpandBgr4 (
+    IN __m128i Pixels
+    )
+{
+    const __m128i Pixel0 = _mm_set_epi32 (0, 0, 0, 0x00FFFFFF);
+    const __m128i Pixel1 = _mm_set_epi32 (0, 0, 0x00FFFFFF, 0);
+    const __m128i Pixel2 = _mm_set_epi32 (0, 0x00FFFFFF, 0, 0);
+    const __m128i Pixel3 = _mm_set_epi32 (0x00FFFFFF, 0, 0, 0);
+    const __m128i Alpha = _mm_set1_epi32 ((int)0xFF000000);
+
+    return _mm_or_si128 (
+        _mm_or_si128 (
+            _mm_or_si128 (
+                _mm_and_si128 (Pixels, Pixel0),
+                _mm_and_si128 (_mm_slli_si128 (Pixels, 1), Pixel1)
+                ),
+            _mm_or_si128 (
+                _mm_and_si128 (_mm_slli_si128 (Pixels, 2), Pixel2),
+                _mm_and_si128 (_mm_slli_si128 (Pixels, 3), Pixel3)
+                )
+            ),
+        Alpha
+        );
+}
+
+//
+// YuvToBgrx8():
+//
+// Convert 8 pixels given as 16 bit Y, U and V lanes (one U and V per
+// pixel) to B, G, R, X with X opaque, 4 pixels in each of Low and High.
+//
+static FORCEINLINE
+void
+YuvToBgrx8 (
+    IN __m128i Y,
+    IN __m128i U,
+    IN __m128i V,
+    OUT __m128i *Low,
+    OUT __m128i *High
+    )
+{
+    const __m128i Zero = _mm_setzero_si128 ();
+    const __m128i Sixteen = _mm_set1_epi16 (16);
+    const __m128i Bias = _mm_set1_epi16 (128);
+
+    //
+    // (Y - 16) * 149 needs 16 unsigned bits, hence the logical shift.
+    //
+    Y = _mm_sub_epi16 (_mm_max_epi16 (Y, Sixteen), Sixteen);
+    Y = _mm_srli_epi16 (_mm_mullo_epi16 (Y, _mm_set1_epi16 (149)), 1);
+    Y = _mm_add_epi16 (Y, _mm_set1_epi16 (32));
+
+    U = _mm_sub_epi16 (U, Bias);
+    V = _mm_sub_epi16 (V, Bias);
+
+    //
+    // Only blue can leave 16 bits, and only far above 255, so saturating
+    // there is the same as clamping afterwards.
+    //
+    __m128i B = _mm_srai_epi16 (
+        _mm_adds_epi16 (Y, _mm_mullo_epi16 (U, _mm_set1_epi16 (129))),
+        6
+        );
+
+    __m128i G = _mm_srai_epi16 (
+        _mm_subs_epi16 (
+            Y,
+            _mm_add_epi16 (
+                _mm_mullo_epi16 (U, _mm_set1_epi16 (25)),
+                _mm_mullo_epi16 (V, _mm_set1_epi16 (52))
+                )
+            ),
+        6
+        );
+
+    __m128i R = _mm_srai_epi16 (
+        _mm_adds_epi16 (Y, _mm_mullo_epi16 (V, _mm_set1_epi16 (102))),
+        6
+        );
+
+    __m128i BG = _mm_unpacklo_epi8 (
+        _mm_packus_epi16 (B, Zero),
+        _mm_packus_epi16 (G, Zero)
+        );
+    __m128i RX = _mm_unpacklo_epi8 (
+        _mm_packus_epi16 (R, Zero),
+        _mm_set1_epi8 ((char)0xFF)
+        );
+
+    *Low = _mm_unpacklo_epi16 (BG, RX);
+    *High = _mm_unpackhi_epi16 (BG, RX);
+}
+
+#endif // CONVERT_USE_SSE2
+
+//
+// RGB24_STORE:
+//
+// Writes converted pixels as RGB24.
+//
+struct RGB24_STORE {
+
+    static constexpr ULONG BytesPerPixel = 3;
+
+    //
+    // Complete():
+    //
+    // Finish a pixel whose B, G and R have been written.
+    //
+    static FORCEINLINE
+    void
+    Complete (
+        IN PUCHAR
+        )
+    {
+    }
+
+#ifdef CONVERT_USE_SSE2
+    //
+    // Store8():
+    //
+    // Write 8 B, G, R, X pixels, 4 in each of Low and High.
+    //
+    static FORCEINLINE
+    void
+    Store8 (
+        OUT PUCHAR Destination,
+        IN __m128i Low,
+        IN __m128i High
+        )
+    {
+        StoreBgr8 (Destination, PackBgrx (Low), PackBgrx (High));
+    }
+#endif // CONVERT_USE_SSE2
+
+};
+
+//
+// RGB32_STORE:
+//
+// Writes converted pixels as RGB32 (B, G, R, X) with X set to opaque
+// alpha, so that consumers treating the format as ARGB32 see an opaque
+// image.
+//
+struct RGB32_STORE {
+
+    static constexpr ULONG BytesPerPixel = 4;
+
+    static FORCEINLINE
+    void
+    Complete (
+        IN PUCHAR Pixel
+        )
+    {
+        Pixel [3] = 0xFF;
+    }
+
+#ifdef CONVERT_USE_SSE2
+    static FORCEINLINE
+    void
+    Store8 (
+        OUT PUCHAR Destination,
+        IN __m128i Low,
+        IN __m128i High
+        )
+    {
+        const __m128i Alpha = _mm_set1_epi32 ((int)0xFF000000);
+
+        _mm_storeu_si128 ((__m128i *)Destination, _mm_or_si128 (Low, Alpha));
+        _mm_storeu_si128 (
+            (__m128i *)(Destination + 16),
+            _mm_or_si128 (High, Alpha)
+            );
+    }
+#endif // CONVERT_USE_SSE2
+
+};
+
+/*************************************************/
+
+
+template <class Store>
+static
+void
+BgraRow (
+    IN const UCHAR * const *Planes,
+    OUT PUCHAR Destination,
+    IN ULONG Width
+    )
+{
+    const UCHAR *Source = Planes [0];
+    ULONG x = 0;
+
+#ifdef CONVERT_USE_SSE2
+    for (; x + 8 <= Width; x += 8) {
+        Store::Store8 (
+            Destination + x * Store::BytesPerPixel,
+            _mm_loadu_si128 ((const __m128i *)(Source + x * 4)),
+            _mm_loadu_si128 ((const __m128i *)(Source + x * 4 + 16))
+            );
+    }
+#endif // CONVERT_USE_SSE2
+
+    for (; x < Width; x++) {
+        PUCHAR Pixel = Destination + x * Store::BytesPerPixel;
+        Pixel [0] = Source [x * 4];
+        Pixel [1] = Source [x * 4 + 1];
+        Pixel [2] = Source [x * 4 + 2];
+        Store::Complete (Pixel);
+    }
+}
+
+/*************************************************/
+
+
+template <class Store>
+static
+void
+RgbaRow (
+    IN const UCHAR * const *Planes,
+    OUT PUCHAR Destination,
+    IN ULONG Width
+    )
+{
+    const UCHAR *Source = Planes [0];
+    ULONG x = 0;
+
+#ifdef CONVERT_USE_SSE2
+    for (; x + 8 <= Width; x += 8) {
+        Store::Store8 (
+            Destination + x * Store::BytesPerPixel,
+            SwapRedBlue (_mm_loadu_si128 ((const __m128i *)(Source + x * 4))),
+            SwapRedBlue (_mm_loadu_si128 ((const __m128i *)(Source + x * 4 + 16)))
+            );
+    }
+#endif // CONVERT_USE_SSE2
+
+    for (; x < Width; x++) {
+        PUCHAR Pixel = Destination + x * Store::BytesPerPixel;
+        Pixel [0] = Source [x * 4 + 2];
+        Pixel [1] = Source [x * 4 + 1];
+        Pixel [2] = Source [x * 4];
+        Store::Complete (Pixel);
+    }
+}
+
+/*************************************************/
+
+
+static
+void
+Rgb24ToRgb32Row (
+    IN const UCHAR * const *Planes,
+    OUT PUCHAR Destination,
+    IN ULONG Width
+    )
+{
+    const UCHAR *Source = Planes [0];
+    ULONG x = 0;
+
+#ifdef CONVERT_USE_SSE2
+    //
+    // 16 pixels are exactly 3 loads.  Line the 4 groups of 4 pixels up at
+    // the start of a register and expand each.
+    //
+    for (; x + 16 <= Width; x += 16) {
+
+        const UCHAR *Group = Source + x * 3;
+        __m128i *Target = (__m128i *)(Destination + x * 4);
+
+        __m128i A = _mm_loadu_si128 ((const __m128i *)Group);
+        __m128i B = _mm_loadu_si128 ((const __m128i *)(Group + 16));
+        __m128i C = _mm_loadu_si128 ((const __m128i *)(Group + 32));
+
+        _mm_storeu_si128 (Target, ExpandBgr4 (A));
+        _mm_storeu_si128 (
+            Target + 1,
+            ExpandBgr4 (_mm_or_si128 (_mm_srli_si128 (A, 12), _mm_slli_si128 (B, 4)))
+            );
+        _mm_storeu_si128 (
+            Target + 2,
+            ExpandBgr4 (_mm_or_si128 (_mm_srli_si128 (B, 8), _mm_slli_si128 (C, 8)))
+            );
+        _mm_storeu_si128 (Target + 3, ExpandBgr4 (_mm_srli_si128 (C, 4)));
+
+    }
+#endif // CONVERT_USE_SSE2
+
+    for (; x < Width; x++) {
+        Destination [x * 4] = Source [x * 3];
+        Destination [x * 4 + 1] = Source [x * 3 + 1];
+        Destination [x * 4 + 2] = Source [x * 3 + 2];
+        Destination [x * 4 + 3] = 0xFF;
+    }
+}
+
+/*************************************************/
+
+
+template <class Store>
+static
+void
+Nv12Row (
+    IN const UCHAR * const *Planes,
+    OUT PUCHAR Destination,
+    IN ULONG Width
+    )
+{
+    const UCHAR *Luma = Planes [0];
+    const UCHAR *Chroma = Planes [1];
+    ULONG x = 0;
+
+#ifdef CONVERT_USE_SSE2
+    const __m128i Zero = _mm_setzero_si128 ();
+
+    for (; x + 8 <= Width; x += 8) {
+
+        __m128i Low, High;
+
+        //
+        // 4 U, V pairs: U0 V0 U1 V1 ... as 16 bit lanes.
+        //
+        __m128i UV = _mm_unpacklo_epi8 (
+            _mm_loadl_epi64 ((const __m128i *)(Chroma + x)),
+            Zero
+            );
+
+        YuvToBgrx8 (
+            _mm_unpacklo_epi8 (_mm_loadl_epi64 ((const __m128i *)(Luma + x)), Zero),
+            _mm_shufflehi_epi16 (
+                _mm_shufflelo_epi16 (UV, _MM_SHUFFLE (2, 2, 0, 0)),
+                _MM_SHUFFLE (2, 2, 0, 0)
+                ),
+            _mm_shufflehi_epi16 (
+                _mm_shufflelo_epi16 (UV, _MM_SHUFFLE (3, 3, 1, 1)),
+                _MM_SHUFFLE (3, 3, 1, 1)
+                ),
+            &Low,
+            &High
+            );
+
+        Store::Store8 (Destination + x * Store::BytesPerPixel, Low, High);
+
+    }
+#endif // CONVERT_USE_SSE2
+
+    for (; x < Width; x++) {
+        PUCHAR Pixel = Destination + x * Store::BytesPerPixel;
+        YuvToBgr (Luma [x], Chroma [x & ~1], Chroma [(x & ~1) + 1], Pixel);
+        Store::Complete (Pixel);
+    }
+}
+
+/*************************************************/
+
+
+template <class Store>
+static
+void
+I420Row (
+    IN const UCHAR * const *Planes,
+    OUT PUCHAR Destination,
+    IN ULONG Width
+    )
+{
+    const UCHAR *Luma = Planes [0];
+    const UCHAR *ChromaU = Planes [1];
+    const UCHAR *ChromaV = Planes [2];
+    ULONG x = 0;
+
+#ifdef CONVERT_USE_SSE2
+    const __m128i Zero = _mm_setzero_si128 ();
+
+    for (; x + 8 <= Width; x += 8) {
+
+        __m128i Low, High;
+        ULONG U4, V4;
+        RtlCopyMemory (&U4, ChromaU + x / 2, sizeof (U4));
+        RtlCopyMemory (&V4, ChromaV + x / 2, sizeof (V4));
+
+        __m128i U = _mm_unpacklo_epi8 (_mm_cvtsi32_si128 ((int)U4), Zero);
+        __m128i V = _mm_unpacklo_epi8 (_mm_cvtsi32_si128 ((int)V4), Zero);
+
+        YuvToBgrx8 (
+            _mm_unpacklo_epi8 (_mm_loadl_epi64 ((const __m128i *)(Luma + x)), Zero),
+            _mm_unpacklo_epi16 (U, U),
+            _mm_unpacklo_epi16 (V, V),
+            &Low,
+            &High
+            );
+
+        Store::Store8 (Destination + x * Store::BytesPerPixel, Low, High);
+
+    }
+#endif // CONVERT_USE_SSE2
+
+    for (; x < Width; x++) {
+        PUCHAR Pixel = Destination + x * Store::BytesPerPixel;
+        YuvToBgr (Luma [x], ChromaU [x / 2], ChromaV [x / 2], Pixel);
+        Store::Complete (Pixel);
+    }
+}
+
+/*************************************************/
+
+
+template <class Store>
+static
+void
+Yuy2Row (
+    IN const UCHAR * const *Planes,
+    OUT PUCHAR Destination,
+    IN ULONG Width
+    )
+{
+    const UCHAR *Source = Planes [0];
+    ULONG x = 0;
+
+#ifdef CONVERT_USE_SSE2
+    const __m128i LumaMask = _mm_set1_epi16 (0x00FF);
+
+    for (; x + 8 <= Width; x += 8) {
+
+        __m128i Low, High;
+        __m128i Pixels = _mm_loadu_si128 ((const __m128i *)(Source + x * 2));
+        __m128i UV = _mm_srli_epi16 (Pixels, 8);
+
+        YuvToBgrx8 (
+            _mm_and_si128 (Pixels, LumaMask),
+            _mm_shufflehi_epi16 (
+                _mm_shufflelo_epi16 (UV, _MM_SHUFFLE (2, 2, 0, 0)),
+                _MM_SHUFFLE (2, 2, 0, 0)
+                ),
+            _mm_shufflehi_epi16 (
+                _mm_shufflelo_epi16 (UV, _MM_SHUFFLE (3, 3, 1, 1)),
+                _MM_SHUFFLE (3, 3, 1, 1)
+                ),
+            &Low,
+            &High
+            );
+
+        Store::Store8 (Destination + x * Store::BytesPerPixel, Low, High);
+
+    }
+#endif // CONVERT_USE_SSE2
+
+    for (; x < Width; x++) {
+        const UCHAR *Pair = Source + (x & ~1) * 2;
+        PUCHAR Pixel = Destination + x * Store::BytesPerPixel;
+        YuvToBgr (Source [x * 2], Pair [1], Pair [3], Pixel);
+        Store::Complete (Pixel);
+    }
+}
+
+/*************************************************/
+
+
+template <class Store>
+static
+void
+Rgb48Row (
+    IN const UCHAR * const *Planes,
+    OUT PUCHAR Destination,
+    IN ULONG Width
+    )
+{
+    const USHORT *Source = (const USHORT *)Planes [0];
+    ULONG x = 0;
+
+#ifdef CONVERT_USE_SSE2
+    //
+    // 8 pixels are 3 loads.  Narrowed, they are 24 bytes of R, G, B which
+    // are expanded and swapped like RGB24 and RGBA.
+    //
+    for (; x + 8 <= Width; x += 8) {
+
+        const __m128i *Group = (const __m128i *)(Source + x * 3);
+
+        __m128i Low = _mm_packus_epi16 (
+            Scale16To8x8 (_mm_loadu_si128 (Group)),
+            Scale16To8x8 (_mm_loadu_si128 (Group + 1))
+            );
+        __m128i High = _mm_packus_epi16 (
+            Scale16To8x8 (_mm_loadu_si128 (Group + 2)),
+            _mm_setzero_si128 ()
+            );
+
+        Store::Store8 (
+            Destination + x * Store::BytesPerPixel,
+            SwapRedBlue (ExpandBgr4 (Low)),
+            SwapRedBlue (ExpandBgr4 (
+                _mm_or_si128 (_mm_srli_si128 (Low, 12), _mm_slli_si128 (High, 4))
+                ))
+            );
+
+    }
+#endif // CONVERT_USE_SSE2
+
+    for (; x < Width; x++) {
+        PUCHAR Pixel = Destination + x * Store::BytesPerPixel;
+        Pixel [0] = Scale16To8 (Source [x * 3 + 2]);
+        Pixel [1] = Scale16To8 (Source [x * 3 + 1]);
+        Pixel [2] = Scale16To8 (Source [x * 3]);
+        Store::Complete (Pixel);
+    }
+}
+
+/*************************************************/
+
+
+template <class Store>
+static
+void
+Rgba64Row (
+    IN const UCHAR * const *Planes,
+    OUT PUCHAR Destination,
+    IN ULONG Width
+    )
+{
+    const USHORT *Source = (const USHORT *)Planes [0];
+    ULONG x = 0;
+
+#ifdef CONVERT_USE_SSE2
+    for (; x + 8 <= Width; x += 8) {
+
+        const __m128i *Group = (const __m128i *)(Source + x * 4);
+
+        Store::Store8 (
+            Destination + x * Store::BytesPerPixel,
+            SwapRedBlue (_mm_packus_epi16 (
+                Scale16To8x8 (_mm_loadu_si128 (Group)),
+                Scale16To8x8 (_mm_loadu_si128 (Group + 1))
+                )),
+            SwapRedBlue (_mm_packus_epi16 (
+                Scale16To8x8 (_mm_loadu_si128 (Group + 2)),
+                Scale16To8x8 (_mm_loadu_si128 (Group + 3))
+                ))
+            );
+
+    }
+#endif // CONVERT_USE_SSE2
+
+    for (; x < Width; x++) {
+        PUCHAR Pixel = Destination + x * Store::BytesPerPixel;
+        Pixel [0] = Scale16To8 (Source [x * 4 + 2]);
+        Pixel [1] = Scale16To8 (Source [x * 4 + 1]);
+        Pixel [2] = Scale16To8 (Source [x * 4]);
+        Store::Complete (Pixel);
+    }
+}
+
+/*************************************************/
+
+
+template <class Store>
+static
+void
+P010Row (
+    IN const UCHAR * const *Planes,
+    OUT PUCHAR Destination,
+    IN ULONG Width
+    )
+{
+    const USHORT *Luma = (const USHORT *)Planes [0];
+    const USHORT *Chroma = (const USHORT *)Planes [1];
+    ULONG x = 0;
+
+#ifdef CONVERT_USE_SSE2
+    for (; x + 8 <= Width; x += 8) {
+
+        __m128i Low, High;
+
+        //
+        // 4 U, V pairs: U0 V0 U1 V1 ... as 16 bit lanes.
+        //
+        __m128i UV = Sample10To8x8 (
+            _mm_loadu_si128 ((const __m128i *)(Chroma + x))
+            );
+
+        YuvToBgrx8 (
+            Sample10To8x8 (_mm_loadu_si128 ((const __m128i *)(Luma + x))),
+            _mm_shufflehi_epi16 (
+                _mm_shufflelo_epi16 (UV, _MM_SHUFFLE (2, 2, 0, 0)),
+                _MM_SHUFFLE (2, 2, 0, 0)
+                ),
+            _mm_shufflehi_epi16 (
+                _mm_shufflelo_epi16 (UV, _MM_SHUFFLE (3, 3, 1, 1)),
+                _MM_SHUFFLE (3, 3, 1, 1)
+                ),
+            &Low,
+            &High
+            );
+
+        Store::Store8 (Destination + x * Store::BytesPerPixel, Low, High);
+
+    }
+#endif // CONVERT_USE_SSE2
+
+    for (; x < Width; x++) {
+        PUCHAR Pixel = Destination + x * Store::BytesPerPixel;
+        YuvToBgr (
+            Sample10To8 (Luma [x]),
+            Sample10To8 (Chroma [x & ~1]),
+            Sample10To8 (Chroma [(x & ~1) + 1]),
+            Pixel
+            );
+        Store::Complete (Pixel);
+    }
+}
+
+/*************************************************/
+
+
+//
+// RGB24_INPUT:
+// BGRA_INPUT:
+// RGBA_INPUT:
+// RGB48_INPUT:
+// RGBA64_INPUT:
+//
+// Unpack Count pixels of an RGB input format to 12 bit B, G, R, X
+// components (X is undefined), the intermediate form of RGB to P010
+// conversion.
+//
+struct RGB24_INPUT {
+
+    static constexpr ULONG InputBytes = 3;
+
+    static
+    void
+    Unpack (
+        IN const UCHAR *Source,
+        OUT PUSHORT Target,
+        IN ULONG Count
+        )
+    {
+        ULONG x = 0;
+
+#ifdef CONVERT_USE_SSE2
+        const __m128i Zero = _mm_setzero_si128 ();
+
+        for (; x + 16 <= Count; x += 16) {
+
+            const UCHAR *Group = Source + x * 3;
+            __m128i *Output = (__m128i *)(Target + x * 4);
+
+            __m128i A = _mm_loadu_si128 ((const __m128i *)Group);
+            __m128i B = _mm_loadu_si128 ((const __m128i *)(Group + 16));
+            __m128i C = _mm_loadu_si128 ((const __m128i *)(Group + 32));
+
+            __m128i Pixels [4] = {
+                ExpandBgr4 (A),
+                ExpandBgr4 (_mm_or_si128 (_mm_srli_si128 (A, 12), _mm_slli_si128 (B, 4))),
+                ExpandBgr4 (_mm_or_si128 (_mm_srli_si128 (B, 8), _mm_slli_si128 (C, 8))),
+                ExpandBgr4 (_mm_srli_si128 (C, 4))
+            };
+
+            for (ULONG i = 0; i < 4; i++) {
+                _mm_storeu_si128 (
+                    Output + i * 2,
+                    Widen8To12x8 (_mm_unpacklo_epi8 (Pixels [i], Zero))
+                    );
+                _mm_storeu_si128 (
+                    Output + i * 2 + 1,
+                    Widen8To12x8 (_mm_unpackhi_epi8 (Pixels [i], Zero))
+                    );
+            }
+
+        }
+#endif // CONVERT_USE_SSE2
+
+        for (; x < Count; x++) {
+            Target [x * 4] = Widen8To12 (Source [x * 3]);
+            Target [x * 4 + 1] = Widen8To12 (Source [x * 3 + 1]);
+            Target [x * 4 + 2] = Widen8To12 (Source [x * 3 + 2]);
+        }
+    }
+
+};
+
+struct BGRA_INPUT {
+
+    static constexpr ULONG InputBytes = 4;
+
+    static
+    void
+    Unpack (
+        IN const UCHAR *Source,
+        OUT PUSHORT Target,
+        IN ULONG Count
+        )
+    {
+        ULONG x = 0;
+
+#ifdef CONVERT_USE_SSE2
+        const __m128i Zero = _mm_setzero_si128 ();
+
+        for (; x + 4 <= Count; x += 4) {
+            __m128i Pixels = _mm_loadu_si128 ((const __m128i *)(Source + x * 4));
+            __m128i *Output = (__m128i *)(Target + x * 4);
+
+            _mm_storeu_si128 (Output, Widen8To12x8 (_mm_unpacklo_epi8 (Pixels, Zero)));
+            _mm_storeu_si128 (Output + 1, Widen8To12x8 (_mm_unpackhi_epi8 (Pixels, Zero)));
+        }
+#endif // CONVERT_USE_SSE2
+
+        for (; x < Count; x++) {
+            Target [x * 4] = Widen8To12 (Source [x * 4]);
+            Target [x * 4 + 1] = Widen8To12 (Source [x * 4 + 1]);
+            Target [x * 4 + 2] = Widen8To12 (Source [x * 4 + 2]);
+        }
+    }
+
+};
+
+struct RGBA_INPUT {
+
+    static constexpr ULONG InputBytes = 4;
+
+    static
+    void
+    Unpack (
+        IN const UCHAR *Source,
+        OUT PUSHORT Target,
+        IN ULONG Count
+        )
+    {
+        ULONG x = 0;
+
+#ifdef CONVERT_USE_SSE2
+        const __m128i Zero = _mm_setzero_si128 ();
+
+        for (; x + 4 <= Count; x += 4) {
+            __m128i Pixels = SwapRedBlue (
+                _mm_loadu_si128 ((const __m128i *)(Source + x * 4))
+                );
+            __m128i *Output = (__m128i *)(Target + x * 4);
+
+            _mm_storeu_si128 (Output, Widen8To12x8 (_mm_unpacklo_epi8 (Pixels, Zero)));
+            _mm_storeu_si128 (Output + 1, Widen8To12x8 (_mm_unpackhi_epi8 (Pixels, Zero)));
+        }
+#endif // CONVERT_USE_SSE2
+
+        for (; x < Count; x++) {
+            Target [x * 4] = Widen8To12 (Source [x * 4 + 2]);
+            Target [x * 4 + 1] = Widen8To12 (Source [x * 4 + 1]);
+            Target [x * 4 + 2] = Widen8To12 (Source [x * 4]);
+        }
+    }
+
+};
+
+struct RGB48_INPUT {
+
+    static constexpr ULONG InputBytes = 6;
+
+    //
+    // Regrouping 3 component pixels of 16 bit lanes costs more than it
+    // saves in SSE2, so this one is scalar.
+    //
+    static
+    void
+    Unpack (
+        IN const UCHAR *Source,
+        OUT PUSHORT Target,
+        IN ULONG Count
+        )
+    {
+        const USHORT *Components = (const USHORT *)Source;
+
+        for (ULONG x = 0; x < Count; x++) {
+            Target [x * 4] = Scale16To12 (Components [x * 3 + 2]);
+            Target [x * 4 + 1] = Scale16To12 (Components [x * 3 + 1]);
+            Target [x * 4 + 2] = Scale16To12 (Components [x * 3]);
+        }
+    }
+
+};
+
+struct RGBA64_INPUT {
+
+    static constexpr ULONG InputBytes = 8;
+
+    static
+    void
+    Unpack (
+        IN const UCHAR *Source,
+        OUT PUSHORT Target,
+        IN ULONG Count
+        )
+    {
+        const USHORT *Components = (const USHORT *)Source;
+        ULONG x = 0;
+
+#ifdef CONVERT_USE_SSE2
+        for (; x + 2 <= Count; x += 2) {
+
+            __m128i Pixels = _mm_loadu_si128 ((const __m128i *)(Components + x * 4));
+
+            Pixels = _mm_shufflelo_epi16 (Pixels, _MM_SHUFFLE (3, 0, 1, 2));
+            Pixels = _mm_shufflehi_epi16 (Pixels, _MM_SHUFFLE (3, 0, 1, 2));
+
+            _mm_storeu_si128 ((__m128i *)(Target + x * 4), Scale16To12x8 (Pixels));
+
+        }
+#endif // CONVERT_USE_SSE2
+
+        for (; x < Count; x++) {
+            Target [x * 4] = Scale16To12 (Components [x * 4 + 2]);
+            Target [x * 4 + 1] = Scale16To12 (Components [x * 4 + 1]);
+            Target [x * 4 + 2] = Scale16To12 (Components [x * 4]);
+        }
+    }
+
+};
+
+/*************************************************/
+
+
+//
+// P010Luma():
+//
+// The P010 luma sample of one 12 bit B, G, R, X pixel.
+//
+static FORCEINLINE
+USHORT
+P010Luma (
+    IN const USHORT *Pixel
+    )
+{
+    LONG Y = 64 + ((P010_Y_B * Pixel [0] + P010_Y_G * Pixel [1] +
+        P010_Y_R * Pixel [2] + (1 << 14)) >> 15);
+
+    return (USHORT)(Y << 6);
+}
+
+#ifdef CONVERT_USE_SSE2
+
+//
+// Sum4():
+//
+// Gather 4 32 bit dot products from the pairs of partial sums which
+// _mm_madd_epi16 leaves for 2 pixels in each of First and Second.
+//
+static FORCEINLINE
+__m128i
+Sum4 (
+    IN __m128i First,
+    IN __m128i Second
+    )
+{
+    __m128 A = _mm_castsi128_ps (First);
+    __m128 B = _mm_castsi128_ps (Second);
+
+    return _mm_add_epi32 (
+        _mm_castps_si128 (_mm_shuffle_ps (A, B, _MM_SHUFFLE (2, 0, 2, 0))),
+        _mm_castps_si128 (_mm_shuffle_ps (A, B, _MM_SHUFFLE (3, 1, 3, 1)))
+        );
+}
+
+//
+// P010Luma4():
+//
+// 10 bit luma of 4 12 bit B, G, R, X pixels, 2 in each of First and
+// Second, as 32 bit lanes.
+//
+static FORCEINLINE
+__m128i
+P010Luma4 (
+    IN __m128i First,
+    IN __m128i Second
+    )
+{
+    const __m128i Weights = _mm_set_epi16 (
+        0, (SHORT)P010_Y_R, (SHORT)P010_Y_G, (SHORT)P010_Y_B,
+        0, (SHORT)P010_Y_R, (SHORT)P010_Y_G, (SHORT)P010_Y_B
+        );
+
+    __m128i Sum = Sum4 (
+        _mm_madd_epi16 (First, Weights),
+        _mm_madd_epi16 (Second, Weights)
+        );
+
+    return _mm_add_epi32 (
+        _mm_srai_epi32 (_mm_add_epi32 (Sum, _mm_set1_epi32 (1 << 14)), 15),
+        _mm_set1_epi32 (64)
+        );
+}
+
+#endif // CONVERT_USE_SSE2
+
+static
+void
+Rgb12ToP010 (
+    IN const USHORT *Upper,
+    IN const USHORT *Lower,
+    OUT PUSHORT LumaUpper,
+    OUT PUSHORT LumaLower,
+    OUT PUSHORT Chroma,
+    IN ULONG Count
+    )
+
+/*++
+
+Routine Description:
+
+    Convert two rows of an even number of 12 bit B, G, R, X pixels to two
+    rows of P010 luma and their row of chroma, which is computed from the
+    sum of each 2x2 block.  The SSE2 path does the same integer arithmetic
+    as the scalar one.
+
+Arguments:
+
+    Upper, Lower -
+        The input rows
+
+    LumaUpper, LumaLower -
+        The luma rows to write
+
+    Chroma -
+        The chroma row to write
+
+    Count -
+        The number of pixels in each row, even
+
+Return Value:
+
+    None
+
+--*/
+
+{
+    ULONG x = 0;
+
+#ifdef CONVERT_USE_SSE2
+    const __m128i CbWeights = _mm_set_epi16 (
+        0, (SHORT)P010_CB_R, (SHORT)P010_CB_G, (SHORT)P010_CB_B,
+        0, (SHORT)P010_CB_R, (SHORT)P010_CB_G, (SHORT)P010_CB_B
+        );
+    const __m128i CrWeights = _mm_set_epi16 (
+        0, (SHORT)P010_CR_R, (SHORT)P010_CR_G, (SHORT)P010_CR_B,
+        0, (SHORT)P010_CR_R, (SHORT)P010_CR_G, (SHORT)P010_CR_B
+        );
+
+    for (; x + 4 <= Count; x += 4) {
+
+        __m128i UpperA = _mm_loadu_si128 ((const __m128i *)(Upper + x * 4));
+        __m128i UpperB = _mm_loadu_si128 ((const __m128i *)(Upper + x * 4 + 8));
+        __m128i LowerA = _mm_loadu_si128 ((const __m128i *)(Lower + x * 4));
+        __m128i LowerB = _mm_loadu_si128 ((const __m128i *)(Lower + x * 4 + 8));
+
+        __m128i Y = _mm_slli_epi16 (
+            _mm_packs_epi32 (
+                P010Luma4 (UpperA, UpperB),
+                P010Luma4 (LowerA, LowerB)
+                ),
+            6
+            );
+
+        _mm_storel_epi64 ((__m128i *)(LumaUpper + x), Y);
+        _mm_storel_epi64 ((__m128i *)(LumaLower + x), _mm_srli_si128 (Y, 8));
+
+        //
+        // Sum each 2x2 block: the two rows, then the two pixels of each
+        // row.  4 12 bit components still fit a signed 16 bit lane.
+        //
+        __m128i BlockA = _mm_add_epi16 (UpperA, LowerA);
+        __m128i BlockB = _mm_add_epi16 (UpperB, LowerB);
+
+        __m128i Blocks = _mm_unpacklo_epi64 (
+            _mm_add_epi16 (BlockA, _mm_srli_si128 (BlockA, 8)),
+            _mm_add_epi16 (BlockB, _mm_srli_si128 (BlockB, 8))
+            );
+
+        //
+        // Cb0 Cb1 Cr0 Cr1, reordered to Cb0 Cr0 Cb1 Cr1.
+        //
+        __m128i UV = _mm_shuffle_epi32 (
+            Sum4 (
+                _mm_madd_epi16 (Blocks, CbWeights),
+                _mm_madd_epi16 (Blocks, CrWeights)
+                ),
+            _MM_SHUFFLE (3, 1, 2, 0)
+            );
+
+        UV = _mm_add_epi32 (
+            _mm_srai_epi32 (_mm_add_epi32 (UV, _mm_set1_epi32 (1 << 16)), 17),
+            _mm_set1_epi32 (512)
+            );
+
+        _mm_storel_epi64 (
+            (__m128i *)(Chroma + x),
+            _mm_slli_epi16 (_mm_packs_epi32 (UV, UV), 6)
+            );
+
+    }
+#endif // CONVERT_USE_SSE2
+
+    for (; x < Count; x += 2) {
+
+        LONG Sum [3] = {0, 0, 0};
+
+        for (ULONG i = x; i < x + 2; i++) {
+
+            LumaUpper [i] = P010Luma (Upper + i * 4);
+            LumaLower [i] = P010Luma (Lower + i * 4);
+
+            for (ULONG c = 0; c < 3; c++) {
+                Sum [c] += Upper [i * 4 + c] + Lower [i * 4 + c];
+            }
+
+        }
+
+        LONG Cb = 512 + ((P010_CB_B * Sum [0] + P010_CB_G * Sum [1] +
+            P010_CB_R * Sum [2] + (1 << 16)) >> 17);
+        LONG Cr = 512 + ((P010_CR_B * Sum [0] + P010_CR_G * Sum [1] +
+            P010_CR_R * Sum [2] + (1 << 16)) >> 17);
+
+        Chroma [x] = (USHORT)(Cb << 6);
+        Chroma [x + 1] = (USHORT)(Cr << 6);
+
+    }
+}
+
+/*************************************************/
+
+
+template <class Input>
+static
+void
+RgbToP010Rows (
+    IN const UCHAR * const *Upper,
+    IN const UCHAR * const *Lower,
+    OUT PUSHORT LumaUpper,
+    OUT PUSHORT LumaLower,
+    OUT PUSHORT Chroma,
+    IN ULONG Width
+    )
+{
+    USHORT UpperRgb [CONVERT_CHUNK * 4];
+    USHORT LowerRgb [CONVERT_CHUNK * 4];
+
+    for (ULONG x = 0; x < Width; x += CONVERT_CHUNK) {
+
+        ULONG Count = Width - x < CONVERT_CHUNK ? Width - x : CONVERT_CHUNK;
+
+        Input::Unpack (Upper [0] + x * Input::InputBytes, UpperRgb, Count);
+        Input::Unpack (Lower [0] + x * Input::InputBytes, LowerRgb, Count);
+
+        Rgb12ToP010 (
+            UpperRgb,
+            LowerRgb,
+            LumaUpper + x,
+            LumaLower + x,
+            Chroma + x,
+            Count
+            );
+
+    }
+}
+
+/*************************************************/
+
+
+//
+// Widen8To16Row():
+//
+// Write Count 8 bit limited range samples as P010 samples.  8 to 10 bits
+// is a multiplication by 4, so the sample just moves to the high byte.
+//
+static
+void
+Widen8To16Row (
+    IN const UCHAR *Source,
+    OUT PUSHORT Target,
+    IN ULONG Count
+    )
+{
+    ULONG x = 0;
+
+#ifdef CONVERT_USE_SSE2
+    const __m128i Zero = _mm_setzero_si128 ();
+
+    for (; x + 16 <= Count; x += 16) {
+        __m128i Samples = _mm_loadu_si128 ((const __m128i *)(Source + x));
+
+        _mm_storeu_si128 ((__m128i *)(Target + x), _mm_unpacklo_epi8 (Zero, Samples));
+        _mm_storeu_si128 ((__m128i *)(Target + x + 8), _mm_unpackhi_epi8 (Zero, Samples));
+    }
+#endif // CONVERT_USE_SSE2
+
+    for (; x < Count; x++) {
+        Target [x] = (USHORT)(Source [x] << 8);
+    }
+}
+
+/*************************************************/
+
+
+static
+void
+Nv12ToP010Rows (
+    IN const UCHAR * const *Upper,
+    IN const UCHAR * const *Lower,
+    OUT PUSHORT LumaUpper,
+    OUT PUSHORT LumaLower,
+    OUT PUSHORT Chroma,
+    IN ULONG Width
+    )
+{
+    Widen8To16Row (Upper [0], LumaUpper, Width);
+    Widen8To16Row (Lower [0], LumaLower, Width);
+    Widen8To16Row (Upper [1], Chroma, Width);
+}
+
+/*************************************************/
+
+
+static
+void
+I420ToP010Rows (
+    IN const UCHAR * const *Upper,
+    IN const UCHAR * const *Lower,
+    OUT PUSHORT LumaUpper,
+    OUT PUSHORT LumaLower,
+    OUT PUSHORT Chroma,
+    IN ULONG Width
+    )
+{
+    const UCHAR *ChromaU = Upper [1];
+    const UCHAR *ChromaV = Upper [2];
+    ULONG x = 0;
+
+    Widen8To16Row (Upper [0], LumaUpper, Width);
+    Widen8To16Row (Lower [0], LumaLower, Width);
+
+#ifdef CONVERT_USE_SSE2
+    const __m128i Zero = _mm_setzero_si128 ();
+
+    for (; x + 16 <= Width; x += 16) {
+
+        __m128i UV = _mm_unpacklo_epi8 (
+            _mm_loadl_epi64 ((const __m128i *)(ChromaU + x / 2)),
+            _mm_loadl_epi64 ((const __m128i *)(ChromaV + x / 2))
+            );
+
+        _mm_storeu_si128 ((__m128i *)(Chroma + x), _mm_unpacklo_epi8 (Zero, UV));
+        _mm_storeu_si128 ((__m128i *)(Chroma + x + 8), _mm_unpackhi_epi8 (Zero, UV));
+
+    }
+#endif // CONVERT_USE_SSE2
+
+    for (; x < Width; x += 2) {
+        Chroma [x] = (USHORT)(ChromaU [x / 2] << 8);
+        Chroma [x + 1] = (USHORT)(ChromaV [x / 2] << 8);
+    }
+}
+
+/*************************************************/
+
+
+static
+void
+Yuy2ToP010Rows (
+    IN const UCHAR * const *Upper,
+    IN const UCHAR * const *Lower,
+    OUT PUSHORT LumaUpper,
+    OUT PUSHORT LumaLower,
+    OUT PUSHORT Chroma,
+    IN ULONG Width
+    )
+
+/*++
+
+Routine Description:
+
+    YUY2 has chroma on every row; each P010 chroma sample is the average
+    of the two rows, which keeps its ninth bit: ((a + b) / 2) * 4 << 6.
+
+--*/
+
+{
+    const UCHAR *SourceUpper = Upper [0];
+    const UCHAR *SourceLower = Lower [0];
+    ULONG x = 0;
+
+#ifdef CONVERT_USE_SSE2
+    for (; x + 8 <= Width; x += 8) {
+
+        __m128i PixelsUpper = _mm_loadu_si128 ((const __m128i *)(SourceUpper + x * 2));
+        __m128i PixelsLower = _mm_loadu_si128 ((const __m128i *)(SourceLower + x * 2));
+
+        _mm_storeu_si128 ((__m128i *)(LumaUpper + x), _mm_slli_epi16 (PixelsUpper, 8));
+        _mm_storeu_si128 ((__m128i *)(LumaLower + x), _mm_slli_epi16 (PixelsLower, 8));
+
+        _mm_storeu_si128 (
+            (__m128i *)(Chroma + x),
+            _mm_slli_epi16 (
+                _mm_add_epi16 (
+                    _mm_srli_epi16 (PixelsUpper, 8),
+                    _mm_srli_epi16 (PixelsLower, 8)
+                    ),
+                7
+                )
+            );
+
+    }
+#endif // CONVERT_USE_SSE2
+
+    for (; x < Width; x++) {
+        LumaUpper [x] = (USHORT)(SourceUpper [x * 2] << 8);
+        LumaLower [x] = (USHORT)(SourceLower [x * 2] << 8);
+        Chroma [x] = (USHORT)((SourceUpper [x * 2 + 1] + SourceLower [x * 2 + 1]) << 7);
+    }
+}
+
+/*************************************************/
+
+
+//
+// Narrow16To8Row():
+//
+// Write Count P010 samples as 8 bit samples, rounded, for NV12 output.
+//
+static
+void
+Narrow16To8Row (
+    IN const USHORT *Source,
+    OUT PUCHAR Target,
+    IN ULONG Count
+    )
+{
+    ULONG x = 0;
+
+#ifdef CONVERT_USE_SSE2
+    for (; x + 16 <= Count; x += 16) {
+        _mm_storeu_si128 (
+            (__m128i *)(Target + x),
+            _mm_packus_epi16 (
+                Sample10To8x8 (_mm_loadu_si128 ((const __m128i *)(Source + x))),
+                Sample10To8x8 (_mm_loadu_si128 ((const __m128i *)(Source + x + 8)))
+                )
+            );
+    }
+#endif // CONVERT_USE_SSE2
+
+    for (; x < Count; x++) {
+        Target [x] = Sample10To8 (Source [x]);
+    }
+}
+
+//
+// Row converters to RGB24, by input format.  RGB24 itself is copied.
+//
+static const CONVERT_ROW g_ToRgb24 [AvshwsFormatCount] = {
+    NULL,                       // AvshwsFormatRgb24
+    BgraRow <RGB24_STORE>,      // AvshwsFormatBgra
+    RgbaRow <RGB24_STORE>,      // AvshwsFormatRgba
+    Nv12Row <RGB24_STORE>,      // AvshwsFormatNv12
+    I420Row <RGB24_STORE>,      // AvshwsFormatI420
+    Yuy2Row <RGB24_STORE>,      // AvshwsFormatYuy2
+    Rgb48Row <RGB24_STORE>,     // AvshwsFormatRgb48
+    Rgba64Row <RGB24_STORE>,    // AvshwsFormatRgba64
+    P010Row <RGB24_STORE>       // AvshwsFormatP010
+};
+
+//
+// g_ToRgb32:
+//
+// Row converters to RGB32 (AvshwsFormatBgra), by input format.  BGRA
+// itself is copied, alpha included.
+//
+static const CONVERT_ROW g_ToRgb32 [AvshwsFormatCount] = {
+    Rgb24ToRgb32Row,            // AvshwsFormatRgb24
+    NULL,                       // AvshwsFormatBgra
+    RgbaRow <RGB32_STORE>,      // AvshwsFormatRgba
+    Nv12Row <RGB32_STORE>,      // AvshwsFormatNv12
+    I420Row <RGB32_STORE>,      // AvshwsFormatI420
+    Yuy2Row <RGB32_STORE>,      // AvshwsFormatYuy2
+    Rgb48Row <RGB32_STORE>,     // AvshwsFormatRgb48
+    Rgba64Row <RGB32_STORE>,    // AvshwsFormatRgba64
+    P010Row <RGB32_STORE>       // AvshwsFormatP010
+};
+
+//
+// g_ToP010:
+//
+// Row pair converters to P010, by input format.  P010 itself is copied.
+//
+static const CONVERT_ROW_PAIR g_ToP010 [AvshwsFormatCount] = {
+    RgbToP010Rows <RGB24_INPUT>,    // AvshwsFormatRgb24
+    RgbToP010Rows <BGRA_INPUT>,     // AvshwsFormatBgra
+    RgbToP010Rows <RGBA_INPUT>,     // AvshwsFormatRgba
+    Nv12ToP010Rows,                 // AvshwsFormatNv12
+    I420ToP010Rows,                 // AvshwsFormatI420
+    Yuy2ToP010Rows,                 // AvshwsFormatYuy2
+    RgbToP010Rows <RGB48_INPUT>,    // AvshwsFormatRgb48
+    RgbToP010Rows <RGBA64_INPUT>,   // AvshwsFormatRgba64
+    NULL                            // AvshwsFormatP010
+};
+
+/*************************************************/
+
+
+ULONG
+ConvertFrameSize (
+    IN ULONG Format,
+    IN ULONG Width,
+    IN ULONG Height
+    )
+
+/*++
+
+Routine Description:
+
+    Compute the size of a frame in a pixel format, tightly packed.
+
+Arguments:
+
+    Format -
+        The AVSHWS_PIXEL_FORMAT of the frame
+
+    Width -
+        The width of the frame in pixels
+
+    Height -
+        The height of the frame in pixels
+
+Return Value:
+
+    The size in bytes, or 0 if the format is unknown or the size is invalid
+    for it.
+
+--*/
+
+{
+
+    ULONGLONG Pixels = (ULONGLONG)Width * Height;
+    ULONGLONG Size;
+
+    switch (Format) {
+
+        case AvshwsFormatRgb24:
+            Size = Pixels * 3;
+            break;
+
+        case AvshwsFormatBgra:
+        case AvshwsFormatRgba:
+            Size = Pixels * 4;
+            break;
+
+        case AvshwsFormatNv12:
+        case AvshwsFormatI420:
+            if ((Width | Height) & 1) {
+                return 0;
+            }
+            Size = Pixels * 3 / 2;
+            break;
+
+        case AvshwsFormatYuy2:
+            if (Width & 1) {
+                return 0;
+            }
+            Size = Pixels * 2;
+            break;
+
+        case AvshwsFormatRgb48:
+            Size = Pixels * 6;
+            break;
+
+        case AvshwsFormatRgba64:
+            Size = Pixels * 8;
+            break;
+
+        case AvshwsFormatP010:
+            if ((Width | Height) & 1) {
+                return 0;
+            }
+            Size = Pixels * 3;
+            break;
+
+        default:
+            return 0;
+
+    }
+
+    return Size > MAXULONG ? 0 : (ULONG)Size;
+
+}
+
+/*************************************************/
+
+
+ULONG
+ConvertLineBytes (
+    IN ULONG Format,
+    IN ULONG Width
+    )
+
+/*++
+
+Routine Description:
+
+    Compute the size of one tightly packed row of the first plane of a
+    frame: the whole row of a packed format, the luma row of a planar one.
+
+Arguments:
+
+    Format -
+        The AVSHWS_PIXEL_FORMAT of the frame
+
+    Width -
+        The width of the frame in pixels
+
+Return Value:
+
+    The size in bytes, or 0 if the format is unknown.
+
+--*/
+
+{
+
+    switch (Format) {
+
+        case AvshwsFormatRgb24:
+            return Width * 3;
+
+        case AvshwsFormatBgra:
+        case AvshwsFormatRgba:
+            return Width * 4;
+
+        case AvshwsFormatNv12:
+        case AvshwsFormatI420:
+            return Width;
+
+        case AvshwsFormatYuy2:
+        case AvshwsFormatP010:
+            return Width * 2;
+
+        case AvshwsFormatRgb48:
+            return Width * 6;
+
+        case AvshwsFormatRgba64:
+            return Width * 8;
+
+        default:
+            return 0;
+
+    }
+
+}
+
+/*************************************************/
+
+
+void
+ConvertFillBlack (
+    IN ULONG Format,
+    OUT PUCHAR Destination,
+    IN ULONG Width,
+    IN ULONG Height
+    )
+
+/*++
+
+Routine Description:
+
+    Fill a tightly packed frame with black.  Black is zero only in the RGB
+    formats without alpha; RGB32 gets opaque alpha and the YUV formats
+    limited range black with neutral chroma.
+
+Arguments:
+
+    Format -
+        The AVSHWS_PIXEL_FORMAT of the frame
+
+    Destination -
+        The frame
+
+    Width -
+        The width of the frame in pixels
+
+    Height -
+        The height of the frame in pixels
+
+Return Value:
+
+    None
+
+--*/
+
+{
+
+    ULONG Size = ConvertFrameSize (Format, Width, Height);
+    ULONG LumaSize = Width * Height;
+
+    switch (Format) {
+
+        case AvshwsFormatBgra:
+        case AvshwsFormatRgba:
+            for (ULONG i = 0; i < LumaSize; i++) {
+                ((PULONG)Destination) [i] = 0xFF000000;
+            }
+            break;
+
+        case AvshwsFormatNv12:
+        case AvshwsFormatI420:
+            RtlFillMemory (Destination, LumaSize, 16);
+            RtlFillMemory (Destination + LumaSize, Size - LumaSize, 128);
+            break;
+
+        case AvshwsFormatYuy2:
+            for (ULONG i = 0; i < Size; i += 2) {
+                Destination [i] = 16;
+                Destination [i + 1] = 128;
+            }
+            break;
+
+        case AvshwsFormatRgba64:
+            for (ULONG i = 0; i < LumaSize; i++) {
+                ((PULONGLONG)Destination) [i] = 0xFFFF000000000000ULL;
+            }
+            break;
+
+        case AvshwsFormatP010:
+            for (ULONG i = 0; i < LumaSize; i++) {
+                ((PUSHORT)Destination) [i] = 64 << 6;
+            }
+            for (ULONG i = LumaSize; i < Size / 2; i++) {
+                ((PUSHORT)Destination) [i] = 512 << 6;
+            }
+            break;
+
+        default:
+            RtlZeroMemory (Destination, Size);
+            break;
+
+    }
+
+}
+
+/*************************************************/
+
+
+//
+// GetInputPlanes():
+//
+// Find the rows of the planes of tightly packed input row y.
+//
+static
+void
+GetInputPlanes (
+    IN ULONG Format,
+    IN const UCHAR *Source,
+    IN ULONG Width,
+    IN ULONG Height,
+    IN ULONG y,
+    OUT const UCHAR **Planes
+    )
+{
+
+    ULONG LumaSize = Width * Height;
+
+    switch (Format) {
+
+        case AvshwsFormatNv12:
+            Planes [0] = Source + y * Width;
+            Planes [1] = Source + LumaSize + (y / 2) * Width;
+            break;
+
+        case AvshwsFormatI420:
+            Planes [0] = Source + y * Width;
+            Planes [1] = Source + LumaSize + (y / 2) * (Width / 2);
+            Planes [2] = Planes [1] + LumaSize / 4;
+            break;
+
+        case AvshwsFormatP010:
+            Planes [0] = Source + y * Width * 2;
+            Planes [1] = Source + LumaSize * 2 + (y / 2) * Width * 2;
+            break;
+
+        default:
+            Planes [0] = Source + y * ConvertLineBytes (Format, Width);
+            break;
+
+    }
+
+}
+
+/*************************************************/
+
+
+static
+BOOLEAN
+ConvertFrameToP010 (
+    IN ULONG InputFormat,
+    IN const UCHAR *Source,
+    OUT PUCHAR Destination,
+    IN LONG Stride,
+    IN ULONG Width,
+    IN ULONG Height
+    )
+
+/*++
+
+Routine Description:
+
+    Convert a frame to P010 two rows at a time, since each pair of luma
+    rows shares a row of chroma.  The chroma plane follows the luma plane
+    with the same stride, so P010 can only be produced top-down.
+
+Arguments:
+
+    See ConvertFrame.
+
+Return Value:
+
+    TRUE if the frame was converted, FALSE if the frame size or stride
+    isn't valid for P010.
+
+--*/
+
+{
+
+    if (ConvertFrameSize (AvshwsFormatP010, Width, Height) == 0 ||
+        Stride <= 0) {
+        return FALSE;
+    }
+
+    PUCHAR ChromaPlane = Destination + (SIZE_T)Stride * Height;
+    const UCHAR *Upper [3] = {NULL, NULL, NULL};
+    const UCHAR *Lower [3] = {NULL, NULL, NULL};
+
+    for (ULONG y = 0; y < Height; y += 2) {
+
+        PUCHAR Line = Destination + (SIZE_T)Stride * y;
+        PUCHAR ChromaLine = ChromaPlane + (SIZE_T)Stride * (y / 2);
+
+        GetInputPlanes (InputFormat, Source, Width, Height, y, Upper);
+        GetInputPlanes (InputFormat, Source, Width, Height, y + 1, Lower);
+
+        if (InputFormat == AvshwsFormatP010) {
+            RtlCopyMemory (Line, Upper [0], Width * 2);
+            RtlCopyMemory (Line + Stride, Lower [0], Width * 2);
+            RtlCopyMemory (ChromaLine, Upper [1], Width * 2);
+        } else {
+            g_ToP010 [InputFormat] (
+                Upper,
+                Lower,
+                (PUSHORT)Line,
+                (PUSHORT)(Line + Stride),
+                (PUSHORT)ChromaLine,
+                Width
+                );
+        }
+
+    }
+
+    return TRUE;
+
+}
+
+/*************************************************/
+
+
+//
+// OffsetInputPlanes():
+//
+// Advance the plane rows found by GetInputPlanes to pixel x, which is
+// even.
+//
+static
+void
+OffsetInputPlanes (
+    IN ULONG Format,
+    IN const UCHAR * const *Planes,
+    IN ULONG x,
+    OUT const UCHAR **Offset
+    )
+{
+
+    switch (Format) {
+
+        case AvshwsFormatNv12:
+            Offset [0] = Planes [0] + x;
+            Offset [1] = Planes [1] + x;
+            break;
+
+        case AvshwsFormatI420:
+            Offset [0] = Planes [0] + x;
+            Offset [1] = Planes [1] + x / 2;
+            Offset [2] = Planes [2] + x / 2;
+            break;
+
+        case AvshwsFormatP010:
+            Offset [0] = Planes [0] + x * 2;
+            Offset [1] = Planes [1] + x * 2;
+            break;
+
+        default:
+            Offset [0] = Planes [0] + ConvertLineBytes (Format, x);
+            break;
+
+    }
+
+}
+
+/*************************************************/
+
+
+static
+BOOLEAN
+ConvertFrameToNv12 (
+    IN ULONG InputFormat,
+    IN const UCHAR *Source,
+    OUT PUCHAR Destination,
+    IN LONG Stride,
+    IN ULONG Width,
+    IN ULONG Height
+    )
+
+/*++
+
+Routine Description:
+
+    Convert a frame to NV12 two rows at a time.  The rows are converted to
+    P010 by the row pair converters, in chunks which fit on the stack, and
+    narrowed to 8 bits.  P010 input is narrowed directly and NV12 copied.
+    Like P010, NV12 can only be produced top-down.
+
+Arguments:
+
+    See ConvertFrame.
+
+Return Value:
+
+    TRUE if the frame was converted, FALSE if the frame size or stride
+    isn't valid for NV12.
+
+--*/
+
+{
+
+    if (ConvertFrameSize (AvshwsFormatNv12, Width, Height) == 0 ||
+        Stride <= 0) {
+        return FALSE;
+    }
+
+    USHORT LumaUpper [CONVERT_CHUNK];
+    USHORT LumaLower [CONVERT_CHUNK];
+    USHORT Chroma [CONVERT_CHUNK];
+
+    PUCHAR ChromaPlane = Destination + (SIZE_T)Stride * Height;
+    const UCHAR *Upper [3] = {NULL, NULL, NULL};
+    const UCHAR *Lower [3] = {NULL, NULL, NULL};
+    const UCHAR *UpperChunk [3] = {NULL, NULL, NULL};
+    const UCHAR *LowerChunk [3] = {NULL, NULL, NULL};
+
+    for (ULONG y = 0; y < Height; y += 2) {
+
+        PUCHAR Line = Destination + (SIZE_T)Stride * y;
+        PUCHAR ChromaLine = ChromaPlane + (SIZE_T)Stride * (y / 2);
+
+        GetInputPlanes (InputFormat, Source, Width, Height, y, Upper);
+        GetInputPlanes (InputFormat, Source, Width, Height, y + 1, Lower);
+
+        if (InputFormat == AvshwsFormatNv12) {
+            RtlCopyMemory (Line, Upper [0], Width);
+            RtlCopyMemory (Line + Stride, Lower [0], Width);
+            RtlCopyMemory (ChromaLine, Upper [1], Width);
+            continue;
+        }
+
+        if (InputFormat == AvshwsFormatP010) {
+            Narrow16To8Row ((const USHORT *)Upper [0], Line, Width);
+            Narrow16To8Row ((const USHORT *)Lower [0], Line + Stride, Width);
+            Narrow16To8Row ((const USHORT *)Upper [1], ChromaLine, Width);
+            continue;
+        }
+
+        for (ULONG x = 0; x < Width; x += CONVERT_CHUNK) {
+
+            ULONG Count = Width - x < CONVERT_CHUNK ? Width - x : CONVERT_CHUNK;
+
+            OffsetInputPlanes (InputFormat, Upper, x, UpperChunk);
+            OffsetInputPlanes (InputFormat, Lower, x, LowerChunk);
+
+            g_ToP010 [InputFormat] (
+                UpperChunk,
+                LowerChunk,
+                LumaUpper,
+                LumaLower,
+                Chroma,
+                Count
+                );
+
+            Narrow16To8Row (LumaUpper, Line + x, Count);
+            Narrow16To8Row (LumaLower, Line + Stride + x, Count);
+            Narrow16To8Row (Chroma, ChromaLine + x, Count);
+
+        }
+
+    }
+
+    return TRUE;
+
+}
+
+/*************************************************/
+
+
+BOOLEAN
+ConvertFrame (
+    IN ULONG InputFormat,
+    IN const UCHAR *Source,
+    IN ULONG OutputFormat,
+    OUT PUCHAR Destination,
+    IN LONG Stride,
+    IN ULONG Width,
+    IN ULONG Height
+    )
+
+/*++
+
+Routine Description:
+
+    Convert a frame row by row.  Each output row is produced from the
+    input rows it depends on by the row converter for the format pair.
+
+Arguments:
+
+    InputFormat -
+        The AVSHWS_PIXEL_FORMAT of Source
+
+    Source -
+        The input frame, tightly packed and top-down
+
+    OutputFormat -
+        The AVSHWS_PIXEL_FORMAT to produce
+
+    Destination -
+        The top row of the output frame as displayed
+
+    Stride -
+        Signed byte distance between displayed output rows
+
+    Width -
+        The width of the frame in pixels
+
+    Height -
+        The height of the frame in pixels
+
+Return Value:
+
+    TRUE if the frame was converted, FALSE if the conversion isn't
+    supported.
+
+--*/
+
+{
+
+    if (ConvertFrameSize (InputFormat, Width, Height) == 0) {
+        return FALSE;
+    }
+
+    //
+    // The capture pin delivers RGB24, RGB32 or P010.  NV12 is the compact
+    // staging format (see AVSHWS_STAGING).
+    //
+    CONVERT_ROW ConvertRow;
+
+    switch (OutputFormat) {
+
+        case AvshwsFormatRgb24:
+            ConvertRow = g_ToRgb24 [InputFormat];
+            break;
+
+        case AvshwsFormatBgra:
+            ConvertRow = g_ToRgb32 [InputFormat];
+            break;
+
+        case AvshwsFormatP010:
+            return ConvertFrameToP010 (
+                InputFormat,
+                Source,
+                Destination,
+                Stride,
+                Width,
+                Height
+                );
+
+        case AvshwsFormatNv12:
+            return ConvertFrameToNv12 (
+                InputFormat,
+                Source,
+                Destination,
+                Stride,
+                Width,
+                Height
+                );
+
+        default:
+            return FALSE;
+
+    }
+
+    ULONG RowBytes = ConvertLineBytes (InputFormat, Width);
+    const UCHAR *Planes [3] = {NULL, NULL, NULL};
+
+    for (ULONG y = 0; y < Height; y++) {
+
+        PUCHAR Line = Destination + (LONG)y * Stride;
+
+        GetInputPlanes (InputFormat, Source, Width, Height, y, Planes);
+
+        if (InputFormat == OutputFormat) {
+            RtlCopyMemory (Line, Planes [0], RowBytes);
+        } else {
+            ConvertRow (Planes, Line, Width);
+        }
+
+    }
+
+    return TRUE;
+
+}
@@ -0,0 +1,90 @@
+/**************************************************************************
+
+    AVStream Simulated Hardware Sample
+
+    File:
+
+        convert.h
+
+    Abstract:
+
+        Pixel format conversion of injected frames.  The producer may
+        inject any AVSHWS_PIXEL_FORMAT; each frame is converted once, as
+        it is written into the frame history, to the format the capture
+        pin negotiated.  When both formats are the same the frame is
+        copied row by row.
+
+        With NV12 staging (see AVSHWS_STAGING) frames are converted to
+        NV12 as they are stored instead, and from NV12 to the negotiated
+        format as they are delivered.
+
+        The YUV formats are BT.601 limited range.  4:2:0 chroma is shared
+        by each pair of rows and 4:2:2 chroma by each pair of pixels.
+
+        Like frc.h, nothing in here touches the kernel; it builds on the
+        host through portable.h (see Tests/ConvertTest).
+
+    History:
+
+        created 10/18/2026
+
+**************************************************************************/
+
+//
+// ConvertFrameSize():
+//
+// The size in bytes of a tightly packed Width x Height frame in Format, or
+// 0 if the format is unknown or the size is invalid for it.
+//
+ULONG
+ConvertFrameSize (
+    IN ULONG Format,
+    IN ULONG Width,
+    IN ULONG Height
+    );
+
+//
+// ConvertLineBytes():
+//
+// The size in bytes of one row of the first plane of a tightly packed
+// frame in Format, or 0 if the format is unknown.
+//
+ULONG
+ConvertLineBytes (
+    IN ULONG Format,
+    IN ULONG Width
+    );
+
+//
+// ConvertFillBlack():
+//
+// Fill a tightly packed Width x Height frame in Format with black.
+//
+void
+ConvertFillBlack (
+    IN ULONG Format,
+    OUT PUCHAR Destination,
+    IN ULONG Width,
+    IN ULONG Height
+    );
+
+//
+// ConvertFrame():
+//
+// Convert a Width x Height frame from InputFormat to OutputFormat.  Input
+// is tightly packed and top-down (see AVSHWS_PIXEL_FORMAT).  Destination
+// points at the top row as displayed and Stride is the signed distance in
+// bytes from one displayed row to the next (negative for bottom-up DIBs).
+// P010 and NV12 output must be top-down; the chroma plane follows the luma
+// plane with the same stride.  Returns FALSE if the conversion isn't supported.
+//
+BOOLEAN
+ConvertFrame (
+    IN ULONG InputFormat,
+    IN const UCHAR *Source,
+    IN ULONG OutputFormat,
+    OUT PUCHAR Destination,
+    IN LONG Stride,
+    IN ULONG Width,
+    IN ULONG Height
+    );
@@ -45,11 +45,351 @@ DECLARE_PROPERTY_SET_HANDLER( name )
 
 // {CB043957-7B35-456E-9B61-5513930F4D8E}
 #define STATIC_PROPSETID_VIDCAP_CUSTOMCONTROL 0xcb043957, 0x7b35, 0x456e, 0x9b, 0x61, 0x55, 0x13, 0x93, 0xf, 0x4d, 0x8e
+// Host builds (see portable.h) only use the layouts below.
+#ifndef AVSHWS_HOST
 DEFINE_GUIDSTRUCT("CB043957-7B35-456E-9B61-5513930F4D8E", PROPSETID_VIDCAP_CUSTOMCONTROL);
 #define PROPSETID_VIDCAP_CUSTOMCONTROL DEFINE_GUIDNAMED(PROPSETID_VIDCAP_CUSTOMCONTROL )
+#endif
 
 
 enum
 {
-	KSPROPERTY_CUSTOMCONTROL_DUMMY
-};
\ No newline at end of file
+	KSPROPERTY_CUSTOMCONTROL_DUMMY,
+	KSPROPERTY_CUSTOMCONTROL_FRAME,
+	KSPROPERTY_CUSTOMCONTROL_FRC_MODE,
+	KSPROPERTY_CUSTOMCONTROL_STATISTICS,
+	KSPROPERTY_CUSTOMCONTROL_LATENCY_PROBE,
+	KSPROPERTY_CUSTOMCONTROL_STAGING,
+	KSPROPERTY_CUSTOMCONTROL_SLATE,
+	KSPROPERTY_CUSTOMCONTROL_NO_SIGNAL_TIMEOUT,
+	KSPROPERTY_CUSTOMCONTROL_TRACE,
+	KSPROPERTY_CUSTOMCONTROL_CAPTURE_MODE,
+	KSPROPERTY_CUSTOMCONTROL_TIMESTAMP_MODE,
+	KSPROPERTY_CUSTOMCONTROL_OUTPUT_DELAY
+};
+
+//
+// AVSHWS_PIXEL_FORMAT:
+//
+// The layout of pixels set through KSPROPERTY_CUSTOMCONTROL_FRAME.  Frames
+// are top-down and tightly packed; the planes of NV12 and P010 (Y, then
+// interleaved U and V) and I420 (Y, U, V) follow each other.  Widths and
+// heights of the YUV formats must be even.  The 16 bit formats are little
+// endian; P010 holds 10 bit samples in the high bits.  The driver converts
+// frames to the negotiated output format.
+//
+typedef enum {
+
+	AvshwsFormatRgb24 = 0,		// B, G, R
+	AvshwsFormatBgra,			// B, G, R, A (GDI+ 32bpp ARGB, RGB32)
+	AvshwsFormatRgba,			// R, G, B, A
+	AvshwsFormatNv12,			// BT.601 limited range
+	AvshwsFormatI420,			// BT.601 limited range
+	AvshwsFormatYuy2,			// BT.601 limited range
+	AvshwsFormatRgb48,			// R, G, B, 16 bits each
+	AvshwsFormatRgba64,			// R, G, B, A, 16 bits each
+	AvshwsFormatP010,			// BT.601 limited range, 10 bits
+
+	AvshwsFormatCount
+
+} AVSHWS_PIXEL_FORMAT;
+
+//
+// AVSHWS_STAGING:
+//
+// How injected frames are kept until they are delivered, set through
+// KSPROPERTY_CUSTOMCONTROL_STAGING.  It takes effect at the next stream
+// start.
+//
+//     AvshwsStagingNative - in the negotiated output format; delivery is a
+//                           copy
+//     AvshwsStagingNv12   - as NV12: half the memory of RGB24 and P010,
+//                           3/8 of RGB32.  Delivery converts to the output
+//                           format, and the output has NV12's 8 bit 4:2:0
+//                           detail.
+//
+typedef enum {
+
+	AvshwsStagingNative = 0,
+	AvshwsStagingNv12,
+
+	AvshwsStagingCount
+
+} AVSHWS_STAGING;
+
+//
+// AVSHWS_CAPTURE_MODE:
+//
+// How frames get into the consumer's buffers, set through
+// KSPROPERTY_CUSTOMCONTROL_CAPTURE_MODE.  It takes effect at the next
+// stream start.
+//
+//     AvshwsCaptureMapped - each queued buffer is cloned and programmed into
+//                           the simulated scatter / gather table; the tick
+//                           fills it and the clone is completed afterwards
+//     AvshwsCaptureCopy   - the tick only readies a frame and kicks
+//                           processing, which copies it into the buffer at
+//                           the leading edge and advances.  No clones and
+//                           no scatter / gather entries, as with a common
+//                           buffer DMA device
+//
+typedef enum {
+
+	AvshwsCaptureMapped = 0,
+	AvshwsCaptureCopy,
+
+	AvshwsCaptureModeCount
+
+} AVSHWS_CAPTURE_MODE;
+
+//
+// AVSHWS_TIMESTAMP_MODE:
+//
+// How delivered frames are timestamped when the graph has a clock, set
+// through KSPROPERTY_CUSTOMCONTROL_TIMESTAMP_MODE.  It takes effect when the
+// stream next starts running.
+//
+//     AvshwsTimestampClock    - the producer's capture timestamp mapped
+//                               into the clock domain, or the clock time
+//                               the buffer is completed at
+//     AvshwsTimestampSchedule - the clock time the stream started running
+//                               at plus the frame period for every tick
+//                               since, kept in step with the clock by
+//                               small periodic corrections.  Evenly spaced,
+//                               without DPC latency, and reads the clock
+//                               only every few frames; ignores producer
+//                               timestamps
+//
+typedef enum {
+
+	AvshwsTimestampClock = 0,
+	AvshwsTimestampSchedule,
+
+	AvshwsTimestampModeCount
+
+} AVSHWS_TIMESTAMP_MODE;
+
+//
+// AVSHWS_OUTPUT_DELAY:
+//
+// KSPROPERTY_CUSTOMCONTROL_OUTPUT_DELAY.  Every injected frame is held
+// Delay milliseconds (at most AVSHWS_OUTPUT_DELAY_MAX) before the stream
+// may output it, to line the video up with audio that takes longer to
+// process.  Delayed frames come out as if they had been captured Delay
+// later, timestamps included.
+//
+// The waiting frames are kept in a ring in the staging format (see
+// AVSHWS_STAGING: NV12 staging holds them in half the memory of RGB24)
+// of at most MemoryBudget kilobytes, sized when the stream starts for
+// producers injecting at up to 60 fps (or faster, if one has been seen).
+// The delay is limited to what that ring holds at the rate the producer
+// is measured to inject at, so a faster one gets a shorter delay rather
+// than a frozen output.  A new Delay is applied
+// to a running stream gradually, by 1/8 of a frame period per frame, so
+// the output runs briefly fast or slow rather than freezing or skipping.
+// A stream started without a delay has no ring, and a delay set then
+// applies from the next start, as does a new MemoryBudget.
+//
+// Set Delay and MemoryBudget.  Get also returns
+//
+//     CurrentDelay - the delay applied now, in milliseconds
+//     Depth        - the number of frames the running stream's ring holds,
+//                    zero if it has none
+//
+#define AVSHWS_OUTPUT_DELAY_MAX 2000
+
+#define AVSHWS_OUTPUT_DELAY_BUDGET_DEFAULT (64 * 1024)
+
+typedef struct _AVSHWS_OUTPUT_DELAY {
+
+	ULONG Size;
+	ULONG Delay;
+	ULONG MemoryBudget;
+	ULONG CurrentDelay;
+	ULONG Depth;
+
+} AVSHWS_OUTPUT_DELAY, *PAVSHWS_OUTPUT_DELAY;
+
+//
+// AVSHWS_FRAME_HEADER:
+//
+// Optional header which precedes the pixel data set through
+// KSPROPERTY_CUSTOMCONTROL_FRAME.  Timestamp is the producer's capture
+// instant in 100ns units of the performance counter (the same time base
+// as QueryPerformanceCounter in user mode).  The driver maps it into the
+// graph clock domain when the frame is delivered.  Metadata is an opaque
+// per-frame block which travels with the frame.  Format is an
+// AVSHWS_PIXEL_FORMAT.
+//
+#define AVSHWS_FRAME_METADATA_MAX 64
+
+#define AVSHWS_FRAME_FLAG_TIMESTAMP_VALID 0x00000001
+
+typedef struct _AVSHWS_FRAME_HEADER {
+
+	ULONG Size;
+	ULONG Flags;
+	LONGLONG Timestamp;
+	ULONG MetadataLength;
+	UCHAR Metadata [AVSHWS_FRAME_METADATA_MAX];
+	ULONG Format;
+
+} AVSHWS_FRAME_HEADER, *PAVSHWS_FRAME_HEADER;
+
+//
+// AVSHWS_SLATE_HEADER:
+//
+// Prefixes the image set through KSPROPERTY_CUSTOMCONTROL_SLATE.  The
+// image follows in Format, laid out like an injected frame (see
+// AVSHWS_PIXEL_FORMAT).  A stream of Width x Height starts with the slate
+// when there is no earlier frame of that size to start it with.  Setting
+// a header with no image clears the slate.
+//
+typedef struct _AVSHWS_SLATE_HEADER {
+
+	ULONG Size;
+	ULONG Format;
+	ULONG Width;
+	ULONG Height;
+
+} AVSHWS_SLATE_HEADER, *PAVSHWS_SLATE_HEADER;
+
+//
+// KSPROPERTY_CUSTOMCONTROL_NO_SIGNAL_TIMEOUT:
+//
+// A ULONG in milliseconds.  When no frame has been injected for that long
+// the producer is considered gone and the stream shows a "no signal" slate
+// until the next frame arrives.  Zero (the default) turns the watchdog off.
+// The slate is rendered when a stream starts with a timeout set, so turning
+// the watchdog on takes effect at the next stream start.
+//
+
+//
+// AVSHWS_STATISTICS:
+//
+// Returned by KSPROPERTY_CUSTOMCONTROL_STATISTICS.  All counts and times
+// are since the stream was last started, except FrameBufferAllocations.
+//
+//     FramesDelivered    - frames written to a consumer buffer
+//     DropNoBuffer       - ticks with no consumer buffer queued (consumer
+//                          starvation).  In copy capture mode, frames
+//                          replaced by the next tick before a buffer took
+//                          them
+//     DropPartialMapping - ticks where the queued buffers did not cover a
+//                          whole frame
+//     ProducerStalled    - ticks at which no new frame had been injected
+//                          since the previous tick (the output repeats)
+//     FramesSuperseded   - injected frames replaced before ever being output
+//     StartTime          - time the driver took to start the stream, in
+//                          100ns units
+//     TimeToFirstFrame   - time from the start of the stream to the first
+//                          delivered frame, in 100ns units; zero until then
+//     FrameBufferAllocations - stream starts, since the device started, which
+//                          had to allocate frame buffers rather than reuse
+//                          the pooled ones
+//     NoSignalSwitches   - times the stream switched to the no signal slate
+//                          (see KSPROPERTY_CUSTOMCONTROL_NO_SIGNAL_TIMEOUT)
+//     NoSignal           - nonzero while the no signal slate is delivered
+//
+// DropNoBuffer + DropPartialMapping is the DropCount reported in
+// KS_FRAME_INFO: those are the output frames the consumer missed.
+//
+typedef struct _AVSHWS_STATISTICS {
+
+	ULONG Size;
+	ULONG FramesDelivered;
+	ULONG DropNoBuffer;
+	ULONG DropPartialMapping;
+	ULONG ProducerStalled;
+	ULONG FramesSuperseded;
+	ULONG StartTime;
+	ULONG TimeToFirstFrame;
+	ULONG FrameBufferAllocations;
+	ULONG NoSignalSwitches;
+	ULONG NoSignal;
+
+} AVSHWS_STATISTICS, *PAVSHWS_STATISTICS;
+
+//
+// AVSHWS_TRACE_EVENT:
+//
+// The events of the frame path recorded while tracing is on (see
+// KSPROPERTY_CUSTOMCONTROL_TRACE).  Generation is the sequence number the
+// injected frame was published with, or zero for events not about one.
+//
+//     AvshwsTraceSetDataEnter - a frame is injected.  Arg1 is its
+//                               AVSHWS_PIXEL_FORMAT, Arg2 its size
+//     AvshwsTraceSetDataExit  - the frame is published as Generation, or
+//                               dropped (Generation zero).  Arg1 is the time
+//                               spent in SetData in 100ns units, Arg2 is 1
+//                               if the frame went into the delay line
+//                               (Generation zero too)
+//     AvshwsTraceDpc          - the simulated interrupt fires.  Arg1 is the
+//                               tick, Arg2 the bytes of buffer queued
+//     AvshwsTraceSgProgram    - a consumer buffer is queued.  Arg1 is its
+//                               size, Arg2 the bytes queued now
+//     AvshwsTraceSgFill       - the frame Generation is written to consumer
+//                               buffers (Arg1 is its size), or the tick is
+//                               dropped (Arg1 zero).  Generation is zero for
+//                               frames no producer injected.  Arg2 is the
+//                               number of buffers written.  In copy capture
+//                               mode it is recorded when the pin copies the
+//                               frame, or drops the one it replaces
+//     AvshwsTraceSgComplete   - the capture pin is told Arg1 buffers were
+//                               written
+//     AvshwsTraceCloneDelete  - a consumer buffer holding the frame
+//                               Generation is released (in copy capture
+//                               mode, the leading edge advances past it).
+//                               Arg1 is the picture number, Arg2 the
+//                               bytes used (zero for a buffer flushed at
+//                               stop)
+//
+typedef enum {
+
+	AvshwsTraceSetDataEnter = 1,
+	AvshwsTraceSetDataExit,
+	AvshwsTraceDpc,
+	AvshwsTraceSgProgram,
+	AvshwsTraceSgFill,
+	AvshwsTraceSgComplete,
+	AvshwsTraceCloneDelete,
+
+	AvshwsTraceEventCount
+
+} AVSHWS_TRACE_EVENT;
+
+//
+// AVSHWS_TRACE_RECORD:
+//
+// One traced event.  Timestamp is in 100ns units of the performance
+// counter, like AVSHWS_FRAME_HEADER.
+//
+typedef struct _AVSHWS_TRACE_RECORD {
+
+	LONGLONG Timestamp;
+	USHORT Event;
+	USHORT Processor;
+	ULONG Generation;
+	ULONG Arg1;
+	ULONG Arg2;
+
+} AVSHWS_TRACE_RECORD, *PAVSHWS_TRACE_RECORD;
+
+//
+// AVSHWS_TRACE_DUMP:
+//
+// KSPROPERTY_CUSTOMCONTROL_TRACE.  Setting a ULONG turns tracing on
+// (nonzero, which clears the trace) or off.  Getting it returns this
+// header followed by RecordCount records, each processor's oldest first;
+// RecordsAvailable is how many there are in all, so a caller can size its
+// buffer with a first get of the header alone.
+//
+typedef struct _AVSHWS_TRACE_DUMP {
+
+	ULONG Size;
+	ULONG Enabled;
+	ULONG Processors;
+	ULONG RecordsAvailable;
+	ULONG RecordCount;
+
+} AVSHWS_TRACE_DUMP, *PAVSHWS_TRACE_DUMP;
\ No newline at end of file
@@ -0,0 +1,558 @@
+/**************************************************************************
+
+    AVStream Simulated Hardware Sample
+
+    File:
+
+        delay.cpp
+
+    Abstract:
+
+        The output delay line.  See delay.h.
+
+        Frames are released at DPC, so this entire file is in locked
+        segments.
+
+    History:
+
+        created 10/18/2026
+
+**************************************************************************/
+
+#include "portable.h"
+
+/**************************************************************************
+
+    LOCKED CODE
+
+**************************************************************************/
+
+#ifdef ALLOC_PRAGMA
+#pragma code_seg()
+#endif // ALLOC_PRAGMA
+
+
+LONGLONG
+CDelayLine::
+SpanFor (
+    IN ULONG Depth,
+    IN LONGLONG InputPeriod,
+    IN LONGLONG OutputPeriod
+    )
+
+/*++
+
+Routine Description:
+
+    Find the longest delay a ring covers.  One slot is being written; the
+    others hold the frames waiting, each until the first tick at least the
+    delay after it, up to an output period late.
+
+Arguments:
+
+    Depth -
+        The number of slots
+
+    InputPeriod -
+        The time between injected frames
+
+    OutputPeriod -
+        The time between ticks
+
+Return Value:
+
+    The longest delay, zero if the ring can't delay at all
+
+--*/
+
+{
+
+    if (Depth <= 1) {
+        return 0;
+    }
+
+    LONGLONG Span = (LONGLONG)(Depth - 1) * InputPeriod - OutputPeriod;
+
+    return Span > 0 ? Span : 0;
+
+}
+
+/*************************************************/
+
+
+ULONG
+CDelayLine::
+DepthFor (
+    IN LONGLONG Delay,
+    IN LONGLONG InputPeriod,
+    IN LONGLONG OutputPeriod,
+    IN ULONG BudgetFrames
+    )
+
+/*++
+
+Routine Description:
+
+    Size a ring for a delay.  A frame waits Delay and up to an output
+    period more for the tick that takes it, during which another frame
+    arrives every input period; one more slot is being written.  One slot
+    is spare for frames arriving unevenly, so a ring sized for a delay
+    covers it with a slot to spare, and the span measured at the inject
+    period only falls short of it if the producer is faster than sized
+    for.
+
+Arguments:
+
+    Delay -
+        The delay wanted
+
+    InputPeriod -
+        The shortest time between injected frames to size for
+
+    OutputPeriod -
+        The time between ticks
+
+    BudgetFrames -
+        The number of frames the memory budget holds
+
+Return Value:
+
+    The number of slots, or zero for no ring
+
+--*/
+
+{
+
+    if (Delay <= 0 || InputPeriod <= 0 || OutputPeriod < 0) {
+        return 0;
+    }
+
+    LONGLONG Waiting = (Delay + OutputPeriod + InputPeriod - 1) / InputPeriod;
+    ULONG Depth = DELAY_RING_DEPTH;
+
+    if (Waiting + 2 < DELAY_RING_DEPTH) {
+        Depth = (ULONG)Waiting + 2;
+    }
+
+    if (Depth > BudgetFrames) {
+        Depth = BudgetFrames;
+    }
+
+    return Depth < 3 ? 0 : Depth;
+
+}
+
+/*************************************************/
+
+
+void
+CDelayLine::
+Reset (
+    IN ULONG Depth,
+    IN LONGLONG Delay,
+    IN LONGLONG InputPeriod,
+    IN LONGLONG OutputPeriod
+    )
+
+/*++
+
+Routine Description:
+
+    Forget every frame and start over with Depth slots.  A stream starts
+    with the whole delay: there is no output yet to keep smooth.  The
+    inject period measured so far is kept, but the new stream's producer
+    may run at another rate, so the span starts from InputPeriod.
+
+Arguments:
+
+    Depth -
+        The number of slots to use, zero for no ring
+
+    Delay -
+        The delay to apply
+
+    InputPeriod -
+        The time between injected frames the ring was sized for
+
+    OutputPeriod -
+        The time between ticks
+
+Return Value:
+
+    None
+
+--*/
+
+{
+
+    for (ULONG Slot = 0; Slot < DELAY_RING_DEPTH; Slot++) {
+        m_Slots [Slot].Valid = FALSE;
+        m_Slots [Slot].Writing = FALSE;
+        m_Slots [Slot].Reading = FALSE;
+    }
+
+    m_Depth = Depth;
+    m_Sequence = 0;
+
+    m_OutputPeriod = OutputPeriod;
+    m_InputPeriod = InputPeriod;
+    m_Published = FALSE;
+
+    SetTargetDelay (Delay);
+
+    m_Delay = m_TargetDelay;
+
+}
+
+/*************************************************/
+
+
+void
+CDelayLine::
+SetTargetDelay (
+    IN LONGLONG Delay
+    )
+
+/*++
+
+Routine Description:
+
+    Request a delay.  It is clipped to what the ring can hold; a longer
+    one needs a larger ring, which the next stream start sizes.
+
+Arguments:
+
+    Delay -
+        The delay wanted
+
+Return Value:
+
+    None
+
+--*/
+
+{
+
+    m_RequestedDelay = Delay < 0 ? 0 : Delay;
+
+    ClipTarget ();
+
+}
+
+/*************************************************/
+
+
+void
+CDelayLine::
+ClipTarget (
+    )
+
+/*++
+
+Routine Description:
+
+    Limit the target delay to the span of the ring at the inject period,
+    which moves as the period is measured.
+
+Arguments:
+
+    None
+
+Return Value:
+
+    None
+
+--*/
+
+{
+
+    LONGLONG Span = SpanFor (m_Depth, m_InputPeriod, m_OutputPeriod);
+
+    m_TargetDelay = m_RequestedDelay > Span ? Span : m_RequestedDelay;
+
+}
+
+/*************************************************/
+
+
+void
+CDelayLine::
+Slew (
+    IN LONGLONG MaxStep
+    )
+
+/*++
+
+Routine Description:
+
+    Move the applied delay one step toward the requested one.  Stepping
+    by a fraction of a frame period spreads a change over many frames:
+    a longer delay holds each frame a little longer than the last, a
+    shorter one releases them a little early, and no frame is repeated or
+    skipped to get there.
+
+    A delay beyond the span of the ring is cut at once instead: the
+    producer injects faster than the ring was sized for, and waiting
+    frames would otherwise be overwritten before they are due.
+
+Arguments:
+
+    MaxStep -
+        The largest change to make
+
+Return Value:
+
+    None
+
+--*/
+
+{
+
+    ClipTarget ();
+
+    if (m_Delay > SpanFor (m_Depth, m_InputPeriod, m_OutputPeriod)) {
+        m_Delay = m_TargetDelay;
+        return;
+    }
+
+    LONGLONG Error = m_TargetDelay - m_Delay;
+
+    if (Error > MaxStep) {
+        Error = MaxStep;
+    } else if (Error < -MaxStep) {
+        Error = -MaxStep;
+    }
+
+    m_Delay += Error;
+
+}
+
+/*************************************************/
+
+
+ULONG
+CDelayLine::
+AcquireWriteSlot (
+    OUT PBOOLEAN Overrun
+    )
+
+/*++
+
+Routine Description:
+
+    Pick the slot the next injected frame is written to.  Empty slots are
+    used first, then the one holding the oldest frame.  Slots being read
+    or already being written are skipped.
+
+Arguments:
+
+    Overrun -
+        Set to TRUE if the slot held a frame which was still waiting
+
+Return Value:
+
+    The slot index, or DELAY_RING_DEPTH if every slot is busy.
+
+--*/
+
+{
+
+    ULONG Best = DELAY_RING_DEPTH;
+
+    *Overrun = FALSE;
+
+    for (ULONG Slot = 0; Slot < m_Depth; Slot++) {
+
+        PDELAY_SLOT Candidate = &m_Slots [Slot];
+
+        if (Candidate -> Reading || Candidate -> Writing ||
+            !Candidate -> Buffer) {
+            continue;
+        }
+
+        if (!Candidate -> Valid) {
+            Best = Slot;
+            break;
+        }
+
+        if (Best == DELAY_RING_DEPTH ||
+            (LONG)(Candidate -> Sequence - m_Slots [Best].Sequence) < 0) {
+            Best = Slot;
+        }
+
+    }
+
+    if (Best != DELAY_RING_DEPTH) {
+        *Overrun = m_Slots [Best].Valid;
+        m_Slots [Best].Writing = TRUE;
+        m_Slots [Best].Valid = FALSE;
+    }
+
+    return Best;
+
+}
+
+/*************************************************/
+
+
+void
+CDelayLine::
+Publish (
+    IN ULONG Slot,
+    IN LONGLONG Time,
+    IN const AVSHWS_FRAME_HEADER *Header OPTIONAL
+    )
+
+/*++
+
+Routine Description:
+
+    Queue a written slot to wait out the delay.
+
+Arguments:
+
+    Slot -
+        The slot returned by AcquireWriteSlot
+
+    Time -
+        The capture time of the frame
+
+    Header -
+        The producer header of the frame, if any
+
+Return Value:
+
+    None
+
+--*/
+
+{
+
+    PDELAY_SLOT Target = &m_Slots [Slot];
+
+    if (Header) {
+        Target -> Header = *Header;
+    } else {
+        Target -> Header.Flags = 0;
+        Target -> Header.MetadataLength = 0;
+    }
+
+    //
+    // Measure the inject period.  The first interval measured is taken
+    // whole, later ones are averaged in.
+    //
+    LONGLONG Interval = Time - m_LastPublishTime;
+
+    if (m_Published && Interval > 0 && Interval <= DELAY_PERIOD_MAX) {
+
+        if (m_MeasuredPeriod == 0) {
+            m_MeasuredPeriod = Interval;
+        } else {
+            m_MeasuredPeriod +=
+                (Interval - m_MeasuredPeriod) / DELAY_PERIOD_WEIGHT;
+        }
+
+        m_InputPeriod = m_MeasuredPeriod;
+
+    }
+
+    m_Published = TRUE;
+    m_LastPublishTime = Time;
+
+    Target -> Time = Time;
+    Target -> Sequence = ++m_Sequence;
+    Target -> Writing = FALSE;
+    Target -> Valid = TRUE;
+
+}
+
+/*************************************************/
+
+
+ULONG
+CDelayLine::
+TakeDue (
+    IN LONGLONG Now
+    )
+
+/*++
+
+Routine Description:
+
+    Hold the oldest waiting frame for reading if it is due.  Only the
+    oldest is considered, so frames come out in order even if the
+    producer's timestamps don't increase.
+
+Arguments:
+
+    Now -
+        The current time, in the time base of the frame times
+
+Return Value:
+
+    The slot of the due frame, or DELAY_RING_DEPTH if none is due
+
+--*/
+
+{
+
+    ULONG Oldest = DELAY_RING_DEPTH;
+
+    for (ULONG Slot = 0; Slot < m_Depth; Slot++) {
+
+        PDELAY_SLOT Candidate = &m_Slots [Slot];
+
+        if (!Candidate -> Valid || Candidate -> Reading) {
+            continue;
+        }
+
+        if (Oldest == DELAY_RING_DEPTH ||
+            (LONG)(Candidate -> Sequence - m_Slots [Oldest].Sequence) < 0) {
+            Oldest = Slot;
+        }
+
+    }
+
+    if (Oldest == DELAY_RING_DEPTH ||
+        m_Slots [Oldest].Time + m_Delay > Now) {
+        return DELAY_RING_DEPTH;
+    }
+
+    m_Slots [Oldest].Reading = TRUE;
+
+    return Oldest;
+
+}
+
+/*************************************************/
+
+
+void
+CDelayLine::
+Release (
+    IN ULONG Slot
+    )
+
+/*++
+
+Routine Description:
+
+    Empty a slot whose frame was taken by TakeDue.
+
+Arguments:
+
+    Slot -
+        The slot returned by TakeDue
+
+Return Value:
+
+    None
+
+--*/
+
+{
+
+    m_Slots [Slot].Reading = FALSE;
+    m_Slots [Slot].Valid = FALSE;
+
+}
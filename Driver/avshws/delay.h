@@ -0,0 +1,363 @@
+/**************************************************************************
+
+    AVStream Simulated Hardware Sample
+
+    File:
+
+        delay.h
+
+    Abstract:
+
+        The output delay line.  With an output delay set, injected frames
+        wait in a ring of timestamped frames, in the staging format, until
+        they are Delay old; only then are they published into the frame
+        history, as if they had just been captured.  This delays the
+        stream by a fixed time without touching frame rate conversion or
+        delivery.
+
+        The applied delay follows the requested one gradually (see Slew),
+        so changing it while streaming briefly speeds the output up or
+        slows it down rather than freezing or skipping frames.
+
+        The ring is sized for the rate frames are injected at, not the
+        stream's frame rate: a producer injecting faster than the stream
+        outputs fills more slots per delay.  The inject period is measured
+        as frames are published, and the delay is limited to what the ring
+        holds at it, so a producer faster than the ring was sized for gets
+        a shorter delay rather than a frozen output.
+
+        Like frc.h, nothing in here touches the kernel: the ring only
+        tracks slot state and the caller provides the frame buffers and
+        serializes access.  It runs on a fake clock on the host (see
+        Tests/DelayTest).
+
+    History:
+
+        created 10/18/2026
+
+**************************************************************************/
+
+//
+// DELAY_RING_DEPTH:
+//
+// The most frames the ring can hold, whatever the memory budget.
+//
+#define DELAY_RING_DEPTH 64
+
+//
+// DELAY_INPUT_PERIOD_MIN:
+//
+// The shortest inject period a ring is sized for unless a shorter one has
+// been measured: producers up to 60 fps.
+//
+#define DELAY_INPUT_PERIOD_MIN 166667
+
+//
+// DELAY_PERIOD_WEIGHT:
+//
+// The measured inject period moves 1/DELAY_PERIOD_WEIGHT of the way to
+// each new interval.  Intervals over DELAY_PERIOD_MAX (a stall, or a
+// producer timestamp jump) are not measured.
+//
+#define DELAY_PERIOD_WEIGHT 8
+#define DELAY_PERIOD_MAX 10000000
+
+//
+// DELAY_SLEW_DIVISOR:
+//
+// A change of delay is applied by at most 1/DELAY_SLEW_DIVISOR of a frame
+// period per tick, so the output runs at most that much fast or slow
+// while it catches up.
+//
+#define DELAY_SLEW_DIVISOR 8
+
+//
+// DELAY_SLOT:
+//
+// A single entry of the ring.
+//
+typedef struct _DELAY_SLOT {
+
+    PUCHAR Buffer;
+    LONGLONG Time;
+    ULONG Sequence;
+    BOOLEAN Writing;
+    BOOLEAN Reading;
+    BOOLEAN Valid;
+    AVSHWS_FRAME_HEADER Header;
+
+} DELAY_SLOT, *PDELAY_SLOT;
+
+/*************************************************
+
+    CDelayLine
+
+    The ring of frames waiting out the output delay.  The caller must
+    serialize all calls (the hardware simulation uses its frame lock).
+    Buffer contents are accessed outside the lock: a slot handed out by
+    AcquireWriteSlot is never due, and a due slot is never handed out for
+    writing until it is released.  Times are in 100ns units.
+
+*************************************************/
+
+class CDelayLine {
+
+private:
+
+    DELAY_SLOT m_Slots [DELAY_RING_DEPTH];
+
+    //
+    // The number of slots in use, each with a buffer attached.  Zero means
+    // there is no ring and frames aren't delayed.
+    //
+    ULONG m_Depth;
+
+    //
+    // Sequence number of the most recently published frame.
+    //
+    ULONG m_Sequence;
+
+    //
+    // The delay applied now, the delay requested, and the requested delay
+    // limited to the span of the ring.
+    //
+    LONGLONG m_Delay;
+    LONGLONG m_RequestedDelay;
+    LONGLONG m_TargetDelay;
+
+    //
+    // The period of the stream's ticks, which take due frames, and the
+    // period frames are injected at: assumed at Reset, then measured.  The
+    // measurement is kept across Reset for sizing the next ring; zero
+    // until there is one.
+    //
+    LONGLONG m_OutputPeriod;
+    LONGLONG m_InputPeriod;
+    LONGLONG m_MeasuredPeriod;
+    BOOLEAN m_Published;
+    LONGLONG m_LastPublishTime;
+
+    //
+    // ClipTarget():
+    //
+    // Limit the requested delay to the span of the ring at the inject
+    // period.
+    //
+    void
+    ClipTarget (
+        );
+
+public:
+
+    //
+    // DepthFor():
+    //
+    // The number of slots needed to delay frames injected every InputPeriod
+    // by Delay, when they are taken by ticks every OutputPeriod, at most
+    // what BudgetFrames frames of memory allow and never more than
+    // DELAY_RING_DEPTH.  Zero if no delay is wanted or fewer than three
+    // frames fit.
+    //
+    static
+    ULONG
+    DepthFor (
+        IN LONGLONG Delay,
+        IN LONGLONG InputPeriod,
+        IN LONGLONG OutputPeriod,
+        IN ULONG BudgetFrames
+        );
+
+    //
+    // SpanFor():
+    //
+    // The longest delay a ring of Depth slots gives frames injected every
+    // InputPeriod and taken by ticks every OutputPeriod.
+    //
+    static
+    LONGLONG
+    SpanFor (
+        IN ULONG Depth,
+        IN LONGLONG InputPeriod,
+        IN LONGLONG OutputPeriod
+        );
+
+    //
+    // SetBuffer():
+    //
+    // Attach the frame buffer for a slot.
+    //
+    void
+    SetBuffer (
+        IN ULONG Slot,
+        IN PUCHAR Buffer
+        )
+    {
+        m_Slots [Slot].Buffer = Buffer;
+    }
+
+    PUCHAR
+    GetBuffer (
+        IN ULONG Slot
+        )
+    {
+        return m_Slots [Slot].Buffer;
+    }
+
+    const AVSHWS_FRAME_HEADER *
+    GetHeader (
+        IN ULONG Slot
+        )
+    {
+        return &m_Slots [Slot].Header;
+    }
+
+    LONGLONG
+    GetTime (
+        IN ULONG Slot
+        )
+    {
+        return m_Slots [Slot].Time;
+    }
+
+    //
+    // Reset():
+    //
+    // Forget all frames and use the first Depth slots, whose buffers must
+    // be attached.  Frames are taken every OutputPeriod and assumed to be
+    // injected every InputPeriod until measured.  The delay is applied at
+    // once, up to the span of the ring.
+    //
+    void
+    Reset (
+        IN ULONG Depth,
+        IN LONGLONG Delay,
+        IN LONGLONG InputPeriod,
+        IN LONGLONG OutputPeriod
+        );
+
+    ULONG
+    GetDepth (
+        )
+    {
+        return m_Depth;
+    }
+
+    //
+    // SetTargetDelay():
+    //
+    // Request a new delay, limited to the span of the ring.  Slew moves the
+    // applied delay to it.
+    //
+    void
+    SetTargetDelay (
+        IN LONGLONG Delay
+        );
+
+    LONGLONG
+    GetDelay (
+        )
+    {
+        return m_Delay;
+    }
+
+    //
+    // GetInputPeriod():
+    //
+    // The inject period the delay is limited by: measured, or as assumed
+    // at Reset until frames have been published.
+    //
+    LONGLONG
+    GetInputPeriod (
+        )
+    {
+        return m_InputPeriod;
+    }
+
+    //
+    // GetMeasuredPeriod():
+    //
+    // The inject period measured over this and earlier streams, zero if
+    // none has been.
+    //
+    LONGLONG
+    GetMeasuredPeriod (
+        )
+    {
+        return m_MeasuredPeriod;
+    }
+
+    //
+    // Slew():
+    //
+    // Move the applied delay toward the requested one by at most MaxStep,
+    // at once down to the span of the ring if the inject period measured
+    // has shrunk it.  Called once per tick.
+    //
+    void
+    Slew (
+        IN LONGLONG MaxStep
+        );
+
+    //
+    // AcquireWriteSlot():
+    //
+    // Find an empty slot, or else the one holding the oldest frame which
+    // isn't being read, and mark it as being written.  Returns
+    // DELAY_RING_DEPTH if no slot is available.  Overrun is set if this
+    // discards a waiting frame: frames arrive faster than the ring can
+    // delay them.
+    //
+    ULONG
+    AcquireWriteSlot (
+        OUT PBOOLEAN Overrun
+        );
+
+    //
+    // Publish():
+    //
+    // Complete a write started with AcquireWriteSlot.  Time is the frame's
+    // capture time, which measures the inject period; Header may be NULL.
+    //
+    void
+    Publish (
+        IN ULONG Slot,
+        IN LONGLONG Time,
+        IN const AVSHWS_FRAME_HEADER *Header OPTIONAL
+        );
+
+    //
+    // Abandon():
+    //
+    // Give up a write started with AcquireWriteSlot without publishing.
+    //
+    void
+    Abandon (
+        IN ULONG Slot
+        )
+    {
+        m_Slots [Slot].Writing = FALSE;
+    }
+
+    //
+    // TakeDue():
+    //
+    // If the oldest waiting frame has been delayed long enough at Now,
+    // hold it for reading and return its slot.  Frames come out in the
+    // order they were published.  Returns DELAY_RING_DEPTH if none is due.
+    //
+    ULONG
+    TakeDue (
+        IN LONGLONG Now
+        );
+
+    //
+    // Release():
+    //
+    // Empty a slot returned by TakeDue once its frame has been read.
+    //
+    void
+    Release (
+        IN ULONG Slot
+        );
+
+};
@@ -486,6 +486,19 @@ Return Value:
                     m_VideoInfoHeader -> bmiHeader.biHeight >= 0
                     );
     
+        } else
+        if (m_VideoInfoHeader -> bmiHeader.biBitCount == 32 &&
+            m_VideoInfoHeader -> bmiHeader.biCompression == KS_BI_RGB) {
+
+            //
+            // RGB32 is RGB24 with a fourth, unused byte per pixel, and
+            // can be in either orientation too.
+            //
+            m_ImageSynth = new (NonPagedPoolNx, 'BysI')
+                CRGB32Synthesizer (
+                    m_VideoInfoHeader -> bmiHeader.biHeight >= 0
+                    );
+
         } else
         if (m_VideoInfoHeader -> bmiHeader.biBitCount == 16 &&
            (m_VideoInfoHeader -> bmiHeader.biCompression == FOURCC_YUY2)) {
@@ -495,10 +508,20 @@ Return Value:
             //
             m_ImageSynth = new(NonPagedPoolNx, 'YysI') CYUVSynthesizer;
     
+        } else
+        if (m_VideoInfoHeader -> bmiHeader.biBitCount == 24 &&
+            m_VideoInfoHeader -> bmiHeader.biCompression == FOURCC_P010) {
+
+            //
+            // P010 is planar and always top-down.
+            //
+            m_ImageSynth = new (NonPagedPoolNx, 'PysI') CP010Synthesizer;
+
         }
         else
             //
-            // We don't synthesize anything but RGB 24 and UYVY.
+            // We don't synthesize anything but RGB 24, RGB 32, UYVY and
+            // P010.
             //
             Status = STATUS_INVALID_PARAMETER;
     
@@ -776,6 +799,97 @@ Return Value:
 #pragma code_seg()
 #endif // ALLOC_PRAGMA
 
+void
+CCaptureDevice::
+AddPreviewPin (
+    IN CPreviewPin *PreviewPin
+    )
+
+/*++
+
+Routine Description:
+
+    Have a running preview pin kicked at every tick.  There is a place
+    for every preview pin instance the filter allows.  Takes the preview
+    lock, so it isn't pageable.
+
+Arguments:
+
+    PreviewPin -
+        The preview pin
+
+Return Value:
+
+    None
+
+--*/
+
+{
+
+    KIRQL Irql;
+
+    KeAcquireSpinLock (&m_PreviewLock, &Irql);
+
+    for (ULONG i = 0; i < PREVIEW_PIN_INSTANCES; i++) {
+
+        if (m_PreviewPins [i] == NULL) {
+            m_PreviewPins [i] = PreviewPin;
+            break;
+        }
+
+    }
+
+    KeReleaseSpinLock (&m_PreviewLock, Irql);
+
+}
+
+/*************************************************/
+
+
+void
+CCaptureDevice::
+RemovePreviewPin (
+    IN CPreviewPin *PreviewPin
+    )
+
+/*++
+
+Routine Description:
+
+    Stop kicking a preview pin.  Once this returns, the tick won't touch
+    the pin again.  Takes the preview lock, so it isn't pageable.
+
+Arguments:
+
+    PreviewPin -
+        The preview pin
+
+Return Value:
+
+    None
+
+--*/
+
+{
+
+    KIRQL Irql;
+
+    KeAcquireSpinLock (&m_PreviewLock, &Irql);
+
+    for (ULONG i = 0; i < PREVIEW_PIN_INSTANCES; i++) {
+
+        if (m_PreviewPins [i] == PreviewPin) {
+            m_PreviewPins [i] = NULL;
+        }
+
+    }
+
+    KeReleaseSpinLock (&m_PreviewLock, Irql);
+
+}
+
+/*************************************************/
+
 
 ULONG
 CCaptureDevice::
@@ -836,6 +950,31 @@ Return Value:
 
     m_InterruptTime++;
 
+    //
+    // The preview pins are paced by the capture ticks: each running one
+    // fills a buffer from the newest frame in its own processing.
+    //
+    KeAcquireSpinLockAtDpcLevel (&m_PreviewLock);
+
+    for (ULONG i = 0; i < PREVIEW_PIN_INSTANCES; i++) {
+
+        if (m_PreviewPins [i]) {
+            m_PreviewPins [i] -> Tick ();
+        }
+
+    }
+
+    KeReleaseSpinLockFromDpcLevel (&m_PreviewLock);
+
+    //
+    // In copy capture mode there are no mappings to complete: the capture
+    // pin copies the frame the tick readied into its next buffer.
+    //
+    if (m_HardwareSimulation -> IsCopyMode ()) {
+        m_CaptureSink -> FrameReady ();
+        return;
+    }
+
     //
     // Realistically, we'd do some hardware manipulation here and then queue
     // a DPC.  Since this is fake hardware, we do what's necessary here.  This
@@ -972,7 +1111,7 @@ Return Value:
             );
 }
 
-void CCaptureDevice::SetData(PVOID data, ULONG dataLength)
+void CCaptureDevice::SetData(PVOID data, ULONG dataLength, const AVSHWS_FRAME_HEADER *Header)
 {
-	m_HardwareSimulation->SetData(data, dataLength);
+	m_HardwareSimulation->SetData(data, dataLength, Header);
 }
@@ -20,6 +20,8 @@
 
 **************************************************************************/
 
+class CPreviewPin;
+
 class CCaptureDevice :
     public IHardwareSink {
 
@@ -80,6 +82,18 @@ private:
     //
     PKS_VIDEOINFOHEADER m_VideoInfoHeader;
 
+    //
+    // How the capture pin timestamps frames from its next run on.
+    //
+    AVSHWS_TIMESTAMP_MODE m_TimestampMode;
+
+    //
+    // The running preview pins, kicked at every tick.  Guarded by
+    // m_PreviewLock.
+    //
+    KSPIN_LOCK m_PreviewLock;
+    CPreviewPin *m_PreviewPins [PREVIEW_PIN_INSTANCES];
+
     //
     // Cleanup():
     //
@@ -132,6 +146,7 @@ public:
         ) :
         m_Device (Device)
     {
+        KeInitializeSpinLock (&m_PreviewLock);
     }
 
     //
@@ -268,6 +283,21 @@ public:
         IN ULONG MappingsCount
         );
 
+    //
+    // AddPreviewPin() / RemovePreviewPin():
+    //
+    // Start or stop kicking a running preview pin at every tick.
+    //
+    void
+    AddPreviewPin (
+        IN CPreviewPin *PreviewPin
+        );
+
+    void
+    RemovePreviewPin (
+        IN CPreviewPin *PreviewPin
+        );
+
     //
     // QueryInterruptTime():
     //
@@ -313,7 +343,202 @@ public:
 	//
 	// SetData();
 	//
-	// Sets the virtual frame buffer of the device.
+	// Sets the virtual frame buffer of the device.  Header optionally
+	// carries the producer timestamp and per-frame metadata.
+	//
+	void SetData(PVOID data, ULONG dataLength, const AVSHWS_FRAME_HEADER *Header = NULL);
+
+	//
+	// GetDeliveredFrameHeader():
+	//
+	// Returns the producer header of the most recently delivered frame.
+	//
+	void GetDeliveredFrameHeader(PAVSHWS_FRAME_HEADER Header)
+	{
+		m_HardwareSimulation->GetDeliveredFrameHeader(Header);
+	}
+
+	//
+	// SetFrcMode() / GetFrcMode():
+	//
+	// Select how injected frames are converted to the output frame rate.
+	//
+	void SetFrcMode(FRC_MODE Mode)
+	{
+		m_HardwareSimulation->SetFrcMode(Mode);
+	}
+
+	FRC_MODE GetFrcMode()
+	{
+		return m_HardwareSimulation->GetFrcMode();
+	}
+
+	//
+	// GetStatistics():
+	//
+	// Returns the frame delivery and drop counters.
+	//
+	void GetStatistics(PAVSHWS_STATISTICS Statistics)
+	{
+		m_HardwareSimulation->GetStatistics(Statistics);
+	}
+
+	//
+	// SetProbeEnabled() / GetProbeEnabled():
+	//
+	// Turn latency probe stamping of injected frames on or off.
+	//
+	void SetProbeEnabled(BOOLEAN Enabled)
+	{
+		m_HardwareSimulation->SetProbeEnabled(Enabled);
+	}
+
+	BOOLEAN GetProbeEnabled()
+	{
+		return m_HardwareSimulation->GetProbeEnabled();
+	}
+
+	//
+	// SetStaging() / GetStaging():
+	//
+	// Select how injected frames are staged from the next stream start on.
+	//
+	void SetStaging(AVSHWS_STAGING Staging)
+	{
+		m_HardwareSimulation->SetStaging(Staging);
+	}
+
+	AVSHWS_STAGING GetStaging()
+	{
+		return m_HardwareSimulation->GetStaging();
+	}
+
+	//
+	// SetSlate():
+	//
+	// Set or clear the image streams start with when there is no earlier
+	// frame of their size.
+	//
+	NTSTATUS SetSlate(ULONG Format, ULONG Width, ULONG Height, const UCHAR *Data, ULONG DataLength)
+	{
+		return m_HardwareSimulation->SetSlate(Format, Width, Height, Data, DataLength);
+	}
+
+	//
+	// SetCaptureMode() / GetCaptureMode():
 	//
-	void SetData(PVOID data, ULONG dataLength);
+	// Select how frames get into the consumer's buffers from the next
+	// stream start on.
+	//
+	void SetCaptureMode(AVSHWS_CAPTURE_MODE Mode)
+	{
+		m_HardwareSimulation->SetCaptureMode(Mode);
+	}
+
+	AVSHWS_CAPTURE_MODE GetCaptureMode()
+	{
+		return m_HardwareSimulation->GetCaptureMode();
+	}
+
+	//
+	// IsCopyMode():
+	//
+	// Whether the running stream is in copy capture mode.
+	//
+	BOOLEAN IsCopyMode()
+	{
+		return m_HardwareSimulation->IsCopyMode();
+	}
+
+	//
+	// DeliverFrame():
+	//
+	// In copy capture mode, copy the frame the last tick readied into the
+	// buffer of StreamHeader, or leave it empty if it is too small for
+	// the frame.  Returns FALSE if there is no frame.
+	//
+	BOOLEAN DeliverFrame(PKSSTREAM_HEADER StreamHeader, struct _STREAM_POINTER_CONTEXT *Context)
+	{
+		return m_HardwareSimulation->DeliverFrame(StreamHeader, Context);
+	}
+
+	//
+	// DeliverStill():
+	//
+	// Copy the newest injected frame into the buffer of StreamHeader for
+	// the still pin.  Returns FALSE if there is none in its format and size.
+	//
+	BOOLEAN DeliverStill(PKSSTREAM_HEADER StreamHeader, ULONG Format, ULONG Width, ULONG Height, struct _STREAM_POINTER_CONTEXT *Context)
+	{
+		return m_HardwareSimulation->DeliverStill(StreamHeader, Format, Width, Height, Context);
+	}
+
+	//
+	// DeliverPreview():
+	//
+	// Write the newest injected frame, downscaled, into the buffer of
+	// StreamHeader for a preview pin.  Returns FALSE if there is none.
+	//
+	BOOLEAN DeliverPreview(PKSSTREAM_HEADER StreamHeader, ULONG Format, ULONG Width, ULONG Height, struct _STREAM_POINTER_CONTEXT *Context)
+	{
+		return m_HardwareSimulation->DeliverPreview(StreamHeader, Format, Width, Height, Context);
+	}
+
+	//
+	// SetTimestampMode() / GetTimestampMode():
+	//
+	// Select how the capture pin timestamps frames when it next starts
+	// running.
+	//
+	void SetTimestampMode(AVSHWS_TIMESTAMP_MODE Mode)
+	{
+		m_TimestampMode = Mode;
+	}
+
+	AVSHWS_TIMESTAMP_MODE GetTimestampMode()
+	{
+		return m_TimestampMode;
+	}
+
+	//
+	// GetTrace():
+	//
+	// The event trace of the frame path.
+	//
+	CEventTrace *GetTrace()
+	{
+		return m_HardwareSimulation->GetTrace();
+	}
+
+	//
+	// SetNoSignalTimeout() / GetNoSignalTimeout():
+	//
+	// The time without an injected frame, in milliseconds, after which the
+	// stream shows the no signal slate.  Zero turns the watchdog off.
+	//
+	void SetNoSignalTimeout(ULONG Timeout)
+	{
+		m_HardwareSimulation->SetNoSignalTimeout(Timeout);
+	}
+
+	ULONG GetNoSignalTimeout()
+	{
+		return m_HardwareSimulation->GetNoSignalTimeout();
+	}
+
+	//
+	// SetOutputDelay() / GetOutputDelay():
+	//
+	// The output delay in milliseconds and the memory budget of the delay
+	// line in kilobytes.
+	//
+	void SetOutputDelay(ULONG Delay, ULONG Budget)
+	{
+		m_HardwareSimulation->SetOutputDelay(Delay, Budget);
+	}
+
+	void GetOutputDelay(PAVSHWS_OUTPUT_DELAY OutputDelay)
+	{
+		m_HardwareSimulation->GetOutputDelay(OutputDelay);
+	}
 };
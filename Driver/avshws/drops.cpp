@@ -0,0 +1,218 @@
+/**************************************************************************
+
+    AVStream Simulated Hardware Sample
+
+    File:
+
+        drops.cpp
+
+    Abstract:
+
+        Frame accounting.  See drops.h.
+
+        This entire file is called at DPC and must be in locked segments.
+
+    History:
+
+        created 10/18/2026
+
+**************************************************************************/
+
+#include "portable.h"
+
+/**************************************************************************
+
+    LOCKED CODE
+
+**************************************************************************/
+
+#ifdef ALLOC_PRAGMA
+#pragma code_seg()
+#endif // ALLOC_PRAGMA
+
+
+void
+CDropCounters::
+Reset (
+    )
+
+/*++
+
+Routine Description:
+
+    Zero the counters.
+
+Arguments:
+
+    None
+
+Return Value:
+
+    None
+
+--*/
+
+{
+
+    m_FramesDelivered = 0;
+    RtlZeroMemory ((PVOID)m_DropCounts, sizeof (m_DropCounts));
+    m_TickSequence = 0;
+
+}
+
+/*************************************************/
+
+
+void
+CDropCounters::
+Tick (
+    IN ULONG Sequence
+    )
+
+/*++
+
+Routine Description:
+
+    Count a producer stall if no frame was published since the previous
+    tick.  Before the first frame there is nothing to repeat.
+
+Arguments:
+
+    Sequence -
+        The sequence number of the newest published frame, zero if none
+
+Return Value:
+
+    None
+
+--*/
+
+{
+
+    if (Sequence && Sequence == m_TickSequence) {
+        Drop (DropProducerStalled);
+    }
+
+    m_TickSequence = Sequence;
+
+}
+
+/*************************************************/
+
+
+BOOLEAN
+CDropCounters::
+Fill (
+    IN BOOLEAN Filled,
+    IN BOOLEAN BuffersQueued
+    )
+
+/*++
+
+Routine Description:
+
+    Count a delivered frame, or classify a missed one as starvation (no
+    buffer queued) or a queue too short for a frame.
+
+Arguments:
+
+    Filled -
+        Whether a whole frame was written
+
+    BuffersQueued -
+        Whether any buffer was queued, if the frame wasn't written
+
+Return Value:
+
+    TRUE if this was the first frame delivered
+
+--*/
+
+{
+
+    if (!Filled) {
+        Drop (BuffersQueued ? DropPartialMapping : DropNoBuffer);
+        return FALSE;
+    }
+
+    return InterlockedIncrement (&m_FramesDelivered) == 1;
+
+}
+
+/*************************************************/
+
+
+void
+CDropCounters::
+Store (
+    IN BOOLEAN Superseded,
+    IN BOOLEAN Stored
+    )
+
+/*++
+
+Routine Description:
+
+    Count a producer frame lost to storing a new one: either an older
+    frame is replaced before it was ever output, or there is no room for
+    the new one.
+
+Arguments:
+
+    Superseded -
+        Whether the slot taken held a frame never output
+
+    Stored -
+        Whether a slot was found
+
+Return Value:
+
+    None
+
+--*/
+
+{
+
+    if (Superseded || !Stored) {
+        Drop (DropSuperseded);
+    }
+
+}
+
+/*************************************************/
+
+
+void
+CDropCounters::
+GetStatistics (
+    OUT PAVSHWS_STATISTICS Statistics
+    )
+
+/*++
+
+Routine Description:
+
+    Snapshot the counters.  Each is read atomically; the set is not a
+    consistent snapshot across counters, which is fine for monitoring.
+
+Arguments:
+
+    Statistics -
+        Receives the counts
+
+Return Value:
+
+    None
+
+--*/
+
+{
+
+    Statistics -> FramesDelivered = (ULONG)m_FramesDelivered;
+    Statistics -> DropNoBuffer = (ULONG)m_DropCounts [DropNoBuffer];
+    Statistics -> DropPartialMapping =
+        (ULONG)m_DropCounts [DropPartialMapping];
+    Statistics -> ProducerStalled = (ULONG)m_DropCounts [DropProducerStalled];
+    Statistics -> FramesSuperseded = (ULONG)m_DropCounts [DropSuperseded];
+
+}
@@ -0,0 +1,168 @@
+/**************************************************************************
+
+    AVStream Simulated Hardware Sample
+
+    File:
+
+        drops.h
+
+    Abstract:
+
+        Frame accounting.  The hardware simulation reports every outcome
+        of the frame path here: each tick's attempt to fill a consumer
+        buffer, each tick's view of the producer and each injected frame
+        stored.  The counters classify the frames lost (see
+        AVSHWS_STATISTICS) and are bumped with interlocked operations, so
+        the DPC path never takes a lock for them.
+
+        Nothing in here touches the kernel besides the interlocked
+        operations, which portable.h provides on the host.
+
+    History:
+
+        created 10/18/2026
+
+**************************************************************************/
+
+//
+// DROP_REASON:
+//
+// Why a frame was not delivered.  See AVSHWS_STATISTICS for the meaning of
+// each reason.
+//
+typedef enum _DROP_REASON {
+
+    DropNoBuffer = 0,
+    DropPartialMapping,
+    DropProducerStalled,
+    DropSuperseded,
+
+    DropReasonCount
+
+} DROP_REASON;
+
+/*************************************************
+
+    CDropCounters
+
+    The frame accounting of a stream.  The counters are read without a
+    lock by GetStatistics.  Tick must be serialized (it is only called
+    from the tick); everything else may be called from anywhere.
+
+*************************************************/
+
+class CDropCounters {
+
+private:
+
+    volatile LONG m_FramesDelivered;
+    volatile LONG m_DropCounts [DropReasonCount];
+
+    //
+    // The history sequence seen at the previous tick.  If it hasn't moved,
+    // the producer stalled for that tick.
+    //
+    ULONG m_TickSequence;
+
+public:
+
+    //
+    // Reset():
+    //
+    // Zero the counters for a new stream.
+    //
+    void
+    Reset (
+        );
+
+    //
+    // Drop():
+    //
+    // Count a frame lost for Reason.
+    //
+    void
+    Drop (
+        IN DROP_REASON Reason
+        )
+    {
+        InterlockedIncrement (&m_DropCounts [Reason]);
+    }
+
+    //
+    // Tick():
+    //
+    // Account for a tick at which Sequence is the newest published frame.
+    // Once the producer has started, a tick without a new frame repeats a
+    // frame: the producer stalled.
+    //
+    void
+    Tick (
+        IN ULONG Sequence
+        );
+
+    //
+    // Fill():
+    //
+    // Account for an attempt to write a frame into consumer buffers.
+    // Filled is whether a whole frame was written; if not, BuffersQueued
+    // tells buffers too small for the frame from no buffer at all.
+    // Returns TRUE if this is the first frame delivered since Reset.
+    //
+    BOOLEAN
+    Fill (
+        IN BOOLEAN Filled,
+        IN BOOLEAN BuffersQueued
+        );
+
+    //
+    // Store():
+    //
+    // Account for storing an injected frame in the history or the delay
+    // line.  Superseded is whether it replaced a frame never output, and
+    // Stored whether there was a slot for it at all.
+    //
+    void
+    Store (
+        IN BOOLEAN Superseded,
+        IN BOOLEAN Stored
+        );
+
+    //
+    // GetDropCount():
+    //
+    // The output frames the consumer missed, reported as DropCount in
+    // KS_FRAME_INFO.
+    //
+    LONG
+    GetDropCount (
+        )
+    {
+        return m_DropCounts [DropNoBuffer] + m_DropCounts [DropPartialMapping];
+    }
+
+    LONG
+    GetCount (
+        IN DROP_REASON Reason
+        )
+    {
+        return m_DropCounts [Reason];
+    }
+
+    LONG
+    GetFramesDelivered (
+        )
+    {
+        return m_FramesDelivered;
+    }
+
+    //
+    // GetStatistics():
+    //
+    // Fill in the delivered and dropped frame counts of Statistics.
+    //
+    void
+    GetStatistics (
+        OUT PAVSHWS_STATISTICS Statistics
+        );
+
+};
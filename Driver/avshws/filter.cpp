@@ -145,6 +145,635 @@ SetData(
 	return STATUS_SUCCESS;
 }
 
+//  Get KSPROPERTY_CUSTOMCONTROL_FRAME.
+//  Returns the producer header of the most recently delivered frame.
+NTSTATUS
+CCaptureFilter::
+GetFrame(
+	_In_ PIRP Irp,
+	_In_ PKSIDENTIFIER Request,
+	_Inout_ PVOID Data
+)
+{
+	PAGED_CODE();
+
+	CCaptureFilter* filter = reinterpret_cast<CCaptureFilter*>(KsGetFilterFromIrp(Irp)->Context);
+
+	PIO_STACK_LOCATION pIrpStack = IoGetCurrentIrpStackLocation(Irp);
+	ULONG bufferLength = pIrpStack->Parameters.DeviceIoControl.OutputBufferLength;
+
+	if (bufferLength == 0) {
+		Irp->IoStatus.Information = sizeof(AVSHWS_FRAME_HEADER);
+		return STATUS_BUFFER_OVERFLOW;
+	}
+
+	if (bufferLength < sizeof(AVSHWS_FRAME_HEADER) || Data == NULL) {
+		return STATUS_BUFFER_TOO_SMALL;
+	}
+
+	CCaptureDevice* device = CCaptureDevice::Recast(KsFilterGetDevice(filter->m_Filter));
+	device->GetDeliveredFrameHeader(reinterpret_cast<PAVSHWS_FRAME_HEADER>(Data));
+
+	Irp->IoStatus.Information = sizeof(AVSHWS_FRAME_HEADER);
+
+	return STATUS_SUCCESS;
+}
+
+//  Set KSPROPERTY_CUSTOMCONTROL_FRAME.
+//  The buffer is an AVSHWS_FRAME_HEADER immediately followed by the pixels.
+NTSTATUS
+CCaptureFilter::
+SetFrame(
+	_In_ PIRP Irp,
+	_In_ PKSIDENTIFIER Request,
+	_Inout_ PVOID Data
+)
+{
+	PAGED_CODE();
+
+	CCaptureFilter* filter = reinterpret_cast<CCaptureFilter*>(KsGetFilterFromIrp(Irp)->Context);
+
+	PIO_STACK_LOCATION pIrpStack = IoGetCurrentIrpStackLocation(Irp);
+	ULONG bufferLength = pIrpStack->Parameters.DeviceIoControl.OutputBufferLength;
+
+	if (bufferLength < sizeof(AVSHWS_FRAME_HEADER) || Data == NULL) {
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	PAVSHWS_FRAME_HEADER header = reinterpret_cast<PAVSHWS_FRAME_HEADER>(Data);
+
+	if (header->Size != sizeof(AVSHWS_FRAME_HEADER) ||
+		header->MetadataLength > AVSHWS_FRAME_METADATA_MAX ||
+		header->Format >= AvshwsFormatCount) {
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	CCaptureDevice* device = CCaptureDevice::Recast(KsFilterGetDevice(filter->m_Filter));
+	device->SetData(header + 1, bufferLength - sizeof(AVSHWS_FRAME_HEADER), header);
+
+	return STATUS_SUCCESS;
+}
+
+//  Get KSPROPERTY_CUSTOMCONTROL_FRC_MODE.
+NTSTATUS
+CCaptureFilter::
+GetFrcMode(
+	_In_ PIRP Irp,
+	_In_ PKSIDENTIFIER Request,
+	_Inout_ PVOID Data
+)
+{
+	PAGED_CODE();
+
+	CCaptureFilter* filter = reinterpret_cast<CCaptureFilter*>(KsGetFilterFromIrp(Irp)->Context);
+
+	CCaptureDevice* device = CCaptureDevice::Recast(KsFilterGetDevice(filter->m_Filter));
+	*reinterpret_cast<PULONG>(Data) = (ULONG)device->GetFrcMode();
+
+	Irp->IoStatus.Information = sizeof(ULONG);
+
+	return STATUS_SUCCESS;
+}
+
+//  Set KSPROPERTY_CUSTOMCONTROL_FRC_MODE.
+//  Takes effect at the next output frame.
+NTSTATUS
+CCaptureFilter::
+SetFrcMode(
+	_In_ PIRP Irp,
+	_In_ PKSIDENTIFIER Request,
+	_Inout_ PVOID Data
+)
+{
+	PAGED_CODE();
+
+	CCaptureFilter* filter = reinterpret_cast<CCaptureFilter*>(KsGetFilterFromIrp(Irp)->Context);
+
+	ULONG mode = *reinterpret_cast<PULONG>(Data);
+
+	if (mode >= FrcModeMax) {
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	CCaptureDevice* device = CCaptureDevice::Recast(KsFilterGetDevice(filter->m_Filter));
+	device->SetFrcMode((FRC_MODE)mode);
+
+	return STATUS_SUCCESS;
+}
+
+//  Get KSPROPERTY_CUSTOMCONTROL_STATISTICS.
+NTSTATUS
+CCaptureFilter::
+GetStatistics(
+	_In_ PIRP Irp,
+	_In_ PKSIDENTIFIER Request,
+	_Inout_ PVOID Data
+)
+{
+	PAGED_CODE();
+
+	CCaptureFilter* filter = reinterpret_cast<CCaptureFilter*>(KsGetFilterFromIrp(Irp)->Context);
+
+	PIO_STACK_LOCATION pIrpStack = IoGetCurrentIrpStackLocation(Irp);
+	ULONG bufferLength = pIrpStack->Parameters.DeviceIoControl.OutputBufferLength;
+
+	if (bufferLength == 0) {
+		Irp->IoStatus.Information = sizeof(AVSHWS_STATISTICS);
+		return STATUS_BUFFER_OVERFLOW;
+	}
+
+	if (bufferLength < sizeof(AVSHWS_STATISTICS) || Data == NULL) {
+		return STATUS_BUFFER_TOO_SMALL;
+	}
+
+	CCaptureDevice* device = CCaptureDevice::Recast(KsFilterGetDevice(filter->m_Filter));
+	device->GetStatistics(reinterpret_cast<PAVSHWS_STATISTICS>(Data));
+
+	Irp->IoStatus.Information = sizeof(AVSHWS_STATISTICS);
+
+	return STATUS_SUCCESS;
+}
+
+//  Get KSPROPERTY_CUSTOMCONTROL_LATENCY_PROBE.
+NTSTATUS
+CCaptureFilter::
+GetLatencyProbe(
+	_In_ PIRP Irp,
+	_In_ PKSIDENTIFIER Request,
+	_Inout_ PVOID Data
+)
+{
+	PAGED_CODE();
+
+	CCaptureFilter* filter = reinterpret_cast<CCaptureFilter*>(KsGetFilterFromIrp(Irp)->Context);
+
+	CCaptureDevice* device = CCaptureDevice::Recast(KsFilterGetDevice(filter->m_Filter));
+	*reinterpret_cast<PULONG>(Data) = device->GetProbeEnabled() ? 1 : 0;
+
+	Irp->IoStatus.Information = sizeof(ULONG);
+
+	return STATUS_SUCCESS;
+}
+
+//  Set KSPROPERTY_CUSTOMCONTROL_LATENCY_PROBE.
+//  Non-zero stamps every frame injected from now on with a probe code.
+NTSTATUS
+CCaptureFilter::
+SetLatencyProbe(
+	_In_ PIRP Irp,
+	_In_ PKSIDENTIFIER Request,
+	_Inout_ PVOID Data
+)
+{
+	PAGED_CODE();
+
+	CCaptureFilter* filter = reinterpret_cast<CCaptureFilter*>(KsGetFilterFromIrp(Irp)->Context);
+
+	CCaptureDevice* device = CCaptureDevice::Recast(KsFilterGetDevice(filter->m_Filter));
+	device->SetProbeEnabled(*reinterpret_cast<PULONG>(Data) != 0);
+
+	return STATUS_SUCCESS;
+}
+
+//  Get KSPROPERTY_CUSTOMCONTROL_STAGING.
+NTSTATUS
+CCaptureFilter::
+GetStaging(
+	_In_ PIRP Irp,
+	_In_ PKSIDENTIFIER Request,
+	_Inout_ PVOID Data
+)
+{
+	PAGED_CODE();
+
+	CCaptureFilter* filter = reinterpret_cast<CCaptureFilter*>(KsGetFilterFromIrp(Irp)->Context);
+
+	CCaptureDevice* device = CCaptureDevice::Recast(KsFilterGetDevice(filter->m_Filter));
+	*reinterpret_cast<PULONG>(Data) = (ULONG)device->GetStaging();
+
+	Irp->IoStatus.Information = sizeof(ULONG);
+
+	return STATUS_SUCCESS;
+}
+
+//  Set KSPROPERTY_CUSTOMCONTROL_STAGING.
+//  Takes effect at the next stream start.
+NTSTATUS
+CCaptureFilter::
+SetStaging(
+	_In_ PIRP Irp,
+	_In_ PKSIDENTIFIER Request,
+	_Inout_ PVOID Data
+)
+{
+	PAGED_CODE();
+
+	CCaptureFilter* filter = reinterpret_cast<CCaptureFilter*>(KsGetFilterFromIrp(Irp)->Context);
+
+	ULONG staging = *reinterpret_cast<PULONG>(Data);
+
+	if (staging >= AvshwsStagingCount) {
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	CCaptureDevice* device = CCaptureDevice::Recast(KsFilterGetDevice(filter->m_Filter));
+	device->SetStaging((AVSHWS_STAGING)staging);
+
+	return STATUS_SUCCESS;
+}
+
+//  Get KSPROPERTY_CUSTOMCONTROL_NO_SIGNAL_TIMEOUT.
+NTSTATUS
+CCaptureFilter::
+GetNoSignalTimeout(
+	_In_ PIRP Irp,
+	_In_ PKSIDENTIFIER Request,
+	_Inout_ PVOID Data
+)
+{
+	PAGED_CODE();
+
+	CCaptureFilter* filter = reinterpret_cast<CCaptureFilter*>(KsGetFilterFromIrp(Irp)->Context);
+
+	CCaptureDevice* device = CCaptureDevice::Recast(KsFilterGetDevice(filter->m_Filter));
+	*reinterpret_cast<PULONG>(Data) = device->GetNoSignalTimeout();
+
+	Irp->IoStatus.Information = sizeof(ULONG);
+
+	return STATUS_SUCCESS;
+}
+
+//  Set KSPROPERTY_CUSTOMCONTROL_NO_SIGNAL_TIMEOUT.
+//  Turning the watchdog on takes effect at the next stream start.
+NTSTATUS
+CCaptureFilter::
+SetNoSignalTimeout(
+	_In_ PIRP Irp,
+	_In_ PKSIDENTIFIER Request,
+	_Inout_ PVOID Data
+)
+{
+	PAGED_CODE();
+
+	CCaptureFilter* filter = reinterpret_cast<CCaptureFilter*>(KsGetFilterFromIrp(Irp)->Context);
+
+	CCaptureDevice* device = CCaptureDevice::Recast(KsFilterGetDevice(filter->m_Filter));
+	device->SetNoSignalTimeout(*reinterpret_cast<PULONG>(Data));
+
+	return STATUS_SUCCESS;
+}
+
+//  Get KSPROPERTY_CUSTOMCONTROL_TRACE.
+//  AVSHWS_TRACE_DUMP followed by as many records as fit.
+NTSTATUS
+CCaptureFilter::
+GetTrace(
+	_In_ PIRP Irp,
+	_In_ PKSIDENTIFIER Request,
+	_Inout_ PVOID Data
+)
+{
+	PAGED_CODE();
+
+	CCaptureFilter* filter = reinterpret_cast<CCaptureFilter*>(KsGetFilterFromIrp(Irp)->Context);
+
+	PIO_STACK_LOCATION pIrpStack = IoGetCurrentIrpStackLocation(Irp);
+	ULONG bufferLength = pIrpStack->Parameters.DeviceIoControl.OutputBufferLength;
+
+	if (bufferLength < sizeof(AVSHWS_TRACE_DUMP) || Data == NULL) {
+		return STATUS_BUFFER_TOO_SMALL;
+	}
+
+	CCaptureDevice* device = CCaptureDevice::Recast(KsFilterGetDevice(filter->m_Filter));
+
+	Irp->IoStatus.Information = device->GetTrace()->Dump(
+		reinterpret_cast<PAVSHWS_TRACE_DUMP>(Data),
+		bufferLength);
+
+	return STATUS_SUCCESS;
+}
+
+//  Set KSPROPERTY_CUSTOMCONTROL_TRACE.
+//  Nonzero clears the trace and turns it on, zero turns it off.
+NTSTATUS
+CCaptureFilter::
+SetTrace(
+	_In_ PIRP Irp,
+	_In_ PKSIDENTIFIER Request,
+	_Inout_ PVOID Data
+)
+{
+	PAGED_CODE();
+
+	CCaptureFilter* filter = reinterpret_cast<CCaptureFilter*>(KsGetFilterFromIrp(Irp)->Context);
+
+	CCaptureDevice* device = CCaptureDevice::Recast(KsFilterGetDevice(filter->m_Filter));
+
+	return device->GetTrace()->Enable(*reinterpret_cast<PULONG>(Data) != 0);
+}
+
+//  Set KSPROPERTY_CUSTOMCONTROL_SLATE.
+//  AVSHWS_SLATE_HEADER followed by the image; a zero size clears the slate.
+NTSTATUS
+CCaptureFilter::
+SetSlate(
+	_In_ PIRP Irp,
+	_In_ PKSIDENTIFIER Request,
+	_Inout_ PVOID Data
+)
+{
+	PAGED_CODE();
+
+	CCaptureFilter* filter = reinterpret_cast<CCaptureFilter*>(KsGetFilterFromIrp(Irp)->Context);
+
+	PIO_STACK_LOCATION pIrpStack = IoGetCurrentIrpStackLocation(Irp);
+	ULONG bufferLength = pIrpStack->Parameters.DeviceIoControl.OutputBufferLength;
+
+	if (bufferLength < sizeof(AVSHWS_SLATE_HEADER) || Data == NULL) {
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	PAVSHWS_SLATE_HEADER header = reinterpret_cast<PAVSHWS_SLATE_HEADER>(Data);
+
+	if (header->Size != sizeof(AVSHWS_SLATE_HEADER) ||
+		header->Format >= AvshwsFormatCount) {
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	CCaptureDevice* device = CCaptureDevice::Recast(KsFilterGetDevice(filter->m_Filter));
+
+	return device->SetSlate(
+		header->Format,
+		header->Width,
+		header->Height,
+		reinterpret_cast<const UCHAR*>(header + 1),
+		bufferLength - sizeof(AVSHWS_SLATE_HEADER));
+}
+
+//  Get KSPROPERTY_CUSTOMCONTROL_CAPTURE_MODE.
+NTSTATUS
+CCaptureFilter::
+GetCaptureMode(
+	_In_ PIRP Irp,
+	_In_ PKSIDENTIFIER Request,
+	_Inout_ PVOID Data
+)
+{
+	PAGED_CODE();
+
+	CCaptureFilter* filter = reinterpret_cast<CCaptureFilter*>(KsGetFilterFromIrp(Irp)->Context);
+
+	CCaptureDevice* device = CCaptureDevice::Recast(KsFilterGetDevice(filter->m_Filter));
+	*reinterpret_cast<PULONG>(Data) = (ULONG)device->GetCaptureMode();
+
+	Irp->IoStatus.Information = sizeof(ULONG);
+
+	return STATUS_SUCCESS;
+}
+
+//  Set KSPROPERTY_CUSTOMCONTROL_CAPTURE_MODE.
+//  Takes effect at the next stream start.
+NTSTATUS
+CCaptureFilter::
+SetCaptureMode(
+	_In_ PIRP Irp,
+	_In_ PKSIDENTIFIER Request,
+	_Inout_ PVOID Data
+)
+{
+	PAGED_CODE();
+
+	CCaptureFilter* filter = reinterpret_cast<CCaptureFilter*>(KsGetFilterFromIrp(Irp)->Context);
+
+	ULONG mode = *reinterpret_cast<PULONG>(Data);
+
+	if (mode >= AvshwsCaptureModeCount) {
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	CCaptureDevice* device = CCaptureDevice::Recast(KsFilterGetDevice(filter->m_Filter));
+	device->SetCaptureMode((AVSHWS_CAPTURE_MODE)mode);
+
+	return STATUS_SUCCESS;
+}
+
+//  Get KSPROPERTY_CUSTOMCONTROL_TIMESTAMP_MODE.
+NTSTATUS
+CCaptureFilter::
+GetTimestampMode(
+	_In_ PIRP Irp,
+	_In_ PKSIDENTIFIER Request,
+	_Inout_ PVOID Data
+)
+{
+	PAGED_CODE();
+
+	CCaptureFilter* filter = reinterpret_cast<CCaptureFilter*>(KsGetFilterFromIrp(Irp)->Context);
+
+	CCaptureDevice* device = CCaptureDevice::Recast(KsFilterGetDevice(filter->m_Filter));
+	*reinterpret_cast<PULONG>(Data) = (ULONG)device->GetTimestampMode();
+
+	Irp->IoStatus.Information = sizeof(ULONG);
+
+	return STATUS_SUCCESS;
+}
+
+//  Set KSPROPERTY_CUSTOMCONTROL_TIMESTAMP_MODE.
+//  Takes effect when the stream next starts running.
+NTSTATUS
+CCaptureFilter::
+SetTimestampMode(
+	_In_ PIRP Irp,
+	_In_ PKSIDENTIFIER Request,
+	_Inout_ PVOID Data
+)
+{
+	PAGED_CODE();
+
+	CCaptureFilter* filter = reinterpret_cast<CCaptureFilter*>(KsGetFilterFromIrp(Irp)->Context);
+
+	ULONG mode = *reinterpret_cast<PULONG>(Data);
+
+	if (mode >= AvshwsTimestampModeCount) {
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	CCaptureDevice* device = CCaptureDevice::Recast(KsFilterGetDevice(filter->m_Filter));
+	device->SetTimestampMode((AVSHWS_TIMESTAMP_MODE)mode);
+
+	return STATUS_SUCCESS;
+}
+
+//  Get KSPROPERTY_CUSTOMCONTROL_OUTPUT_DELAY.
+NTSTATUS
+CCaptureFilter::
+GetOutputDelay(
+	_In_ PIRP Irp,
+	_In_ PKSIDENTIFIER Request,
+	_Inout_ PVOID Data
+)
+{
+	PAGED_CODE();
+
+	CCaptureFilter* filter = reinterpret_cast<CCaptureFilter*>(KsGetFilterFromIrp(Irp)->Context);
+
+	PIO_STACK_LOCATION pIrpStack = IoGetCurrentIrpStackLocation(Irp);
+	ULONG bufferLength = pIrpStack->Parameters.DeviceIoControl.OutputBufferLength;
+
+	if (bufferLength == 0) {
+		Irp->IoStatus.Information = sizeof(AVSHWS_OUTPUT_DELAY);
+		return STATUS_BUFFER_OVERFLOW;
+	}
+
+	if (bufferLength < sizeof(AVSHWS_OUTPUT_DELAY) || Data == NULL) {
+		return STATUS_BUFFER_TOO_SMALL;
+	}
+
+	CCaptureDevice* device = CCaptureDevice::Recast(KsFilterGetDevice(filter->m_Filter));
+	device->GetOutputDelay(reinterpret_cast<PAVSHWS_OUTPUT_DELAY>(Data));
+
+	Irp->IoStatus.Information = sizeof(AVSHWS_OUTPUT_DELAY);
+
+	return STATUS_SUCCESS;
+}
+
+//  Set KSPROPERTY_CUSTOMCONTROL_OUTPUT_DELAY.
+//  Only Delay and MemoryBudget are read; a zero budget is the default.
+NTSTATUS
+CCaptureFilter::
+SetOutputDelay(
+	_In_ PIRP Irp,
+	_In_ PKSIDENTIFIER Request,
+	_Inout_ PVOID Data
+)
+{
+	PAGED_CODE();
+
+	CCaptureFilter* filter = reinterpret_cast<CCaptureFilter*>(KsGetFilterFromIrp(Irp)->Context);
+
+	PIO_STACK_LOCATION pIrpStack = IoGetCurrentIrpStackLocation(Irp);
+	ULONG bufferLength = pIrpStack->Parameters.DeviceIoControl.OutputBufferLength;
+
+	if (bufferLength < sizeof(AVSHWS_OUTPUT_DELAY) || Data == NULL) {
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	PAVSHWS_OUTPUT_DELAY outputDelay = reinterpret_cast<PAVSHWS_OUTPUT_DELAY>(Data);
+
+	if (outputDelay->Size != sizeof(AVSHWS_OUTPUT_DELAY) ||
+		outputDelay->Delay > AVSHWS_OUTPUT_DELAY_MAX) {
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	CCaptureDevice* device = CCaptureDevice::Recast(KsFilterGetDevice(filter->m_Filter));
+	device->SetOutputDelay(
+		outputDelay->Delay,
+		outputDelay->MemoryBudget ? outputDelay->MemoryBudget : AVSHWS_OUTPUT_DELAY_BUDGET_DEFAULT);
+
+	return STATUS_SUCCESS;
+}
+
+//  Get KSPROPERTY_VIDEOCONTROL_CAPS.
+//  Only the still pin can be triggered.
+NTSTATUS
+CCaptureFilter::
+GetVideoControlCaps(
+	_In_ PIRP Irp,
+	_In_ PKSIDENTIFIER Request,
+	_Inout_ PVOID Data
+)
+{
+	PAGED_CODE();
+
+	ULONG streamIndex = reinterpret_cast<PKSPROPERTY_VIDEOCONTROL_CAPS_S>(Request)->StreamIndex;
+
+	if (streamIndex >= CAPTURE_FILTER_PIN_COUNT) {
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	PKSPROPERTY_VIDEOCONTROL_CAPS_S caps = reinterpret_cast<PKSPROPERTY_VIDEOCONTROL_CAPS_S>(Data);
+	caps->StreamIndex = streamIndex;
+	caps->VideoControlCaps = streamIndex == STILL_PIN_ID ? KS_VideoControlFlag_Trigger : 0;
+
+	Irp->IoStatus.Information = sizeof(KSPROPERTY_VIDEOCONTROL_CAPS_S);
+
+	return STATUS_SUCCESS;
+}
+
+//  Get KSPROPERTY_VIDEOCONTROL_MODE.
+//  The trigger is a one shot, so no mode is ever set.
+NTSTATUS
+CCaptureFilter::
+GetVideoControlMode(
+	_In_ PIRP Irp,
+	_In_ PKSIDENTIFIER Request,
+	_Inout_ PVOID Data
+)
+{
+	PAGED_CODE();
+
+	ULONG streamIndex = reinterpret_cast<PKSPROPERTY_VIDEOCONTROL_MODE_S>(Request)->StreamIndex;
+
+	if (streamIndex >= CAPTURE_FILTER_PIN_COUNT) {
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	PKSPROPERTY_VIDEOCONTROL_MODE_S mode = reinterpret_cast<PKSPROPERTY_VIDEOCONTROL_MODE_S>(Data);
+	mode->StreamIndex = streamIndex;
+	mode->Mode = 0;
+
+	Irp->IoStatus.Information = sizeof(KSPROPERTY_VIDEOCONTROL_MODE_S);
+
+	return STATUS_SUCCESS;
+}
+
+//  Set KSPROPERTY_VIDEOCONTROL_MODE.
+//  KS_VideoControlFlag_Trigger on the still pin takes a still of the newest
+//  injected frame.
+NTSTATUS
+CCaptureFilter::
+SetVideoControlMode(
+	_In_ PIRP Irp,
+	_In_ PKSIDENTIFIER Request,
+	_Inout_ PVOID Data
+)
+{
+	PAGED_CODE();
+
+	PKSFILTER ksFilter = KsGetFilterFromIrp(Irp);
+
+	PKSPROPERTY_VIDEOCONTROL_MODE_S mode = reinterpret_cast<PKSPROPERTY_VIDEOCONTROL_MODE_S>(Data);
+
+	if (mode->StreamIndex >= CAPTURE_FILTER_PIN_COUNT) {
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	if ((mode->Mode & KS_VideoControlFlag_Trigger) == 0) {
+		return STATUS_SUCCESS;
+	}
+
+	if (mode->StreamIndex != STILL_PIN_ID) {
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	//
+	// The control mutex keeps the still pin from closing under us.
+	//
+	NTSTATUS status = STATUS_INVALID_DEVICE_STATE;
+
+	KsFilterAcquireControl(ksFilter);
+
+	PKSPIN pin = KsFilterGetFirstChildPin(ksFilter, STILL_PIN_ID);
+	if (pin) {
+		reinterpret_cast<CStillPin*>(pin->Context)->Trigger();
+		status = STATUS_SUCCESS;
+	}
+
+	KsFilterReleaseControl(ksFilter);
+
+	return status;
+}
+
 /**************************************************************************
 
 	PROPERTY TABLE STUFF
@@ -164,12 +793,177 @@ DEFINE_KSPROPERTY_TABLE(CustomPropertyTable)
 		(PKSPROPERTY)NULL,							//Relations
 		(PFNKSHANDLER)NULL,							//SupportHandler
 		(ULONG)0									//SerializedSize
+	},
+	{
+		KSPROPERTY_CUSTOMCONTROL_FRAME,				//PropertyId
+		(PFNKSHANDLER)&CCaptureFilter::GetFrame,	//GetPropertyHandler
+		(ULONG)sizeof(KSPROPERTY),					//MinProperty
+		(ULONG)0,								//MinData
+		(PFNKSHANDLER)&CCaptureFilter::SetFrame,	//SetPropertyHandler
+		(PKSPROPERTY_VALUES)NULL,					//Values
+		0,											//RelationsCount
+		(PKSPROPERTY)NULL,							//Relations
+		(PFNKSHANDLER)NULL,							//SupportHandler
+		(ULONG)0									//SerializedSize
+	},
+	{
+		KSPROPERTY_CUSTOMCONTROL_FRC_MODE,			//PropertyId
+		(PFNKSHANDLER)&CCaptureFilter::GetFrcMode,	//GetPropertyHandler
+		(ULONG)sizeof(KSPROPERTY),					//MinProperty
+		(ULONG)sizeof(ULONG),						//MinData
+		(PFNKSHANDLER)&CCaptureFilter::SetFrcMode,	//SetPropertyHandler
+		(PKSPROPERTY_VALUES)NULL,					//Values
+		0,											//RelationsCount
+		(PKSPROPERTY)NULL,							//Relations
+		(PFNKSHANDLER)NULL,							//SupportHandler
+		(ULONG)0									//SerializedSize
+	},
+	{
+		KSPROPERTY_CUSTOMCONTROL_STATISTICS,		//PropertyId
+		(PFNKSHANDLER)&CCaptureFilter::GetStatistics,	//GetPropertyHandler
+		(ULONG)sizeof(KSPROPERTY),					//MinProperty
+		(ULONG)0,								//MinData
+		(PFNKSHANDLER)NULL,							//SetPropertyHandler
+		(PKSPROPERTY_VALUES)NULL,					//Values
+		0,											//RelationsCount
+		(PKSPROPERTY)NULL,							//Relations
+		(PFNKSHANDLER)NULL,							//SupportHandler
+		(ULONG)0									//SerializedSize
+	},
+	{
+		KSPROPERTY_CUSTOMCONTROL_LATENCY_PROBE,		//PropertyId
+		(PFNKSHANDLER)&CCaptureFilter::GetLatencyProbe,	//GetPropertyHandler
+		(ULONG)sizeof(KSPROPERTY),					//MinProperty
+		(ULONG)sizeof(ULONG),						//MinData
+		(PFNKSHANDLER)&CCaptureFilter::SetLatencyProbe,	//SetPropertyHandler
+		(PKSPROPERTY_VALUES)NULL,					//Values
+		0,											//RelationsCount
+		(PKSPROPERTY)NULL,							//Relations
+		(PFNKSHANDLER)NULL,							//SupportHandler
+		(ULONG)0									//SerializedSize
+	},
+	{
+		KSPROPERTY_CUSTOMCONTROL_STAGING,			//PropertyId
+		(PFNKSHANDLER)&CCaptureFilter::GetStaging,	//GetPropertyHandler
+		(ULONG)sizeof(KSPROPERTY),					//MinProperty
+		(ULONG)sizeof(ULONG),						//MinData
+		(PFNKSHANDLER)&CCaptureFilter::SetStaging,	//SetPropertyHandler
+		(PKSPROPERTY_VALUES)NULL,					//Values
+		0,											//RelationsCount
+		(PKSPROPERTY)NULL,							//Relations
+		(PFNKSHANDLER)NULL,							//SupportHandler
+		(ULONG)0									//SerializedSize
+	},
+	{
+		KSPROPERTY_CUSTOMCONTROL_SLATE,				//PropertyId
+		(PFNKSHANDLER)NULL,							//GetPropertyHandler
+		(ULONG)sizeof(KSPROPERTY),					//MinProperty
+		(ULONG)sizeof(AVSHWS_SLATE_HEADER),			//MinData
+		(PFNKSHANDLER)&CCaptureFilter::SetSlate,	//SetPropertyHandler
+		(PKSPROPERTY_VALUES)NULL,					//Values
+		0,											//RelationsCount
+		(PKSPROPERTY)NULL,							//Relations
+		(PFNKSHANDLER)NULL,							//SupportHandler
+		(ULONG)0									//SerializedSize
+	},
+	{
+		KSPROPERTY_CUSTOMCONTROL_NO_SIGNAL_TIMEOUT,	//PropertyId
+		(PFNKSHANDLER)&CCaptureFilter::GetNoSignalTimeout,	//GetPropertyHandler
+		(ULONG)sizeof(KSPROPERTY),					//MinProperty
+		(ULONG)sizeof(ULONG),						//MinData
+		(PFNKSHANDLER)&CCaptureFilter::SetNoSignalTimeout,	//SetPropertyHandler
+		(PKSPROPERTY_VALUES)NULL,					//Values
+		0,											//RelationsCount
+		(PKSPROPERTY)NULL,							//Relations
+		(PFNKSHANDLER)NULL,							//SupportHandler
+		(ULONG)0									//SerializedSize
+	},
+	{
+		KSPROPERTY_CUSTOMCONTROL_TRACE,				//PropertyId
+		(PFNKSHANDLER)&CCaptureFilter::GetTrace,	//GetPropertyHandler
+		(ULONG)sizeof(KSPROPERTY),					//MinProperty
+		(ULONG)sizeof(ULONG),						//MinData
+		(PFNKSHANDLER)&CCaptureFilter::SetTrace,	//SetPropertyHandler
+		(PKSPROPERTY_VALUES)NULL,					//Values
+		0,											//RelationsCount
+		(PKSPROPERTY)NULL,							//Relations
+		(PFNKSHANDLER)NULL,							//SupportHandler
+		(ULONG)0									//SerializedSize
+	},
+	{
+		KSPROPERTY_CUSTOMCONTROL_CAPTURE_MODE,		//PropertyId
+		(PFNKSHANDLER)&CCaptureFilter::GetCaptureMode,	//GetPropertyHandler
+		(ULONG)sizeof(KSPROPERTY),					//MinProperty
+		(ULONG)sizeof(ULONG),						//MinData
+		(PFNKSHANDLER)&CCaptureFilter::SetCaptureMode,	//SetPropertyHandler
+		(PKSPROPERTY_VALUES)NULL,					//Values
+		0,											//RelationsCount
+		(PKSPROPERTY)NULL,							//Relations
+		(PFNKSHANDLER)NULL,							//SupportHandler
+		(ULONG)0									//SerializedSize
+	},
+	{
+		KSPROPERTY_CUSTOMCONTROL_TIMESTAMP_MODE,	//PropertyId
+		(PFNKSHANDLER)&CCaptureFilter::GetTimestampMode,	//GetPropertyHandler
+		(ULONG)sizeof(KSPROPERTY),					//MinProperty
+		(ULONG)sizeof(ULONG),						//MinData
+		(PFNKSHANDLER)&CCaptureFilter::SetTimestampMode,	//SetPropertyHandler
+		(PKSPROPERTY_VALUES)NULL,					//Values
+		0,											//RelationsCount
+		(PKSPROPERTY)NULL,							//Relations
+		(PFNKSHANDLER)NULL,							//SupportHandler
+		(ULONG)0									//SerializedSize
+	},
+	{
+		KSPROPERTY_CUSTOMCONTROL_OUTPUT_DELAY,		//PropertyId
+		(PFNKSHANDLER)&CCaptureFilter::GetOutputDelay,	//GetPropertyHandler
+		(ULONG)sizeof(KSPROPERTY),					//MinProperty
+		(ULONG)0,								//MinData
+		(PFNKSHANDLER)&CCaptureFilter::SetOutputDelay,	//SetPropertyHandler
+		(PKSPROPERTY_VALUES)NULL,					//Values
+		0,											//RelationsCount
+		(PKSPROPERTY)NULL,							//Relations
+		(PFNKSHANDLER)NULL,							//SupportHandler
+		(ULONG)0									//SerializedSize
+	}
+};
+
+//
+// The video control property set, for the still pin's trigger.  The
+// requests carry the pin factory ID as StreamIndex.
+//
+DEFINE_KSPROPERTY_TABLE(VideoControlPropertyTable)
+{
+	{
+		KSPROPERTY_VIDEOCONTROL_CAPS,				//PropertyId
+		(PFNKSHANDLER)&CCaptureFilter::GetVideoControlCaps,	//GetPropertyHandler
+		(ULONG)sizeof(KSPROPERTY_VIDEOCONTROL_CAPS_S),	//MinProperty
+		(ULONG)sizeof(KSPROPERTY_VIDEOCONTROL_CAPS_S),	//MinData
+		(PFNKSHANDLER)NULL,							//SetPropertyHandler
+		(PKSPROPERTY_VALUES)NULL,					//Values
+		0,											//RelationsCount
+		(PKSPROPERTY)NULL,							//Relations
+		(PFNKSHANDLER)NULL,							//SupportHandler
+		(ULONG)0									//SerializedSize
+	},
+	{
+		KSPROPERTY_VIDEOCONTROL_MODE,				//PropertyId
+		(PFNKSHANDLER)&CCaptureFilter::GetVideoControlMode,	//GetPropertyHandler
+		(ULONG)sizeof(KSPROPERTY_VIDEOCONTROL_MODE_S),	//MinProperty
+		(ULONG)sizeof(KSPROPERTY_VIDEOCONTROL_MODE_S),	//MinData
+		(PFNKSHANDLER)&CCaptureFilter::SetVideoControlMode,	//SetPropertyHandler
+		(PKSPROPERTY_VALUES)NULL,					//Values
+		0,											//RelationsCount
+		(PKSPROPERTY)NULL,							//Relations
+		(PFNKSHANDLER)NULL,							//SupportHandler
+		(ULONG)0									//SerializedSize
 	}
 };
 
 DEFINE_KSPROPERTY_SET_TABLE(PropertySetTable)
 {
-	DEFINE_STD_PROPERTY_SET(PROPSETID_VIDCAP_CUSTOMCONTROL, CustomPropertyTable)
+	DEFINE_STD_PROPERTY_SET(PROPSETID_VIDCAP_CUSTOMCONTROL, CustomPropertyTable),
+	DEFINE_STD_PROPERTY_SET(PROPSETID_VIDCAP_VIDEOCONTROL, VideoControlPropertyTable)
 };
 
 
@@ -187,6 +981,8 @@ DEFINE_KSAUTOMATION_TABLE(AvsFilterAutomationTable)
 **************************************************************************/
 
 GUID g_PINNAME_VIDEO_CAPTURE = {STATIC_PINNAME_VIDEO_CAPTURE};
+GUID g_PINNAME_VIDEO_STILL = {STATIC_PINNAME_VIDEO_STILL};
+GUID g_PINNAME_VIDEO_PREVIEW = {STATIC_PINNAME_VIDEO_PREVIEW};
 
 //
 // CaptureFilterCategories:
@@ -234,6 +1030,58 @@ CaptureFilterPinDescriptors [CAPTURE_FILTER_PIN_COUNT] = {
         &CapturePinAllocatorFraming,        // Allocator Framing
         reinterpret_cast <PFNKSINTERSECTHANDLEREX> 
             (CCapturePin::IntersectHandler)
+    },
+    //
+    // Video Still Pin.  It has the capture pin's ranges and is optional.
+    //
+    {
+        &StillPinDispatch,
+        NULL,
+        {
+            0,                              // Interfaces (NULL, 0 == default)
+            NULL,
+            0,                              // Mediums (NULL, 0 == default)
+            NULL,
+            SIZEOF_ARRAY(CapturePinDataRanges),// Range Count
+            CapturePinDataRanges,           // Ranges
+            KSPIN_DATAFLOW_OUT,             // Dataflow
+            KSPIN_COMMUNICATION_BOTH,       // Communication
+            &PIN_CATEGORY_STILL,            // Category
+            &g_PINNAME_VIDEO_STILL,         // Name
+            0                               // Reserved
+        },
+        KSPIN_FLAG_PROCESS_IN_RUN_STATE_ONLY,// Pin Flags
+        1,                                  // Instances Possible
+        0,                                  // Instances Necessary
+        &CapturePinAllocatorFraming,        // Allocator Framing
+        reinterpret_cast <PFNKSINTERSECTHANDLEREX>
+            (CCapturePin::IntersectHandler)
+    },
+    //
+    // Video Preview Pin.  It has smaller ranges of its own and is optional.
+    //
+    {
+        &PreviewPinDispatch,
+        NULL,
+        {
+            0,                              // Interfaces (NULL, 0 == default)
+            NULL,
+            0,                              // Mediums (NULL, 0 == default)
+            NULL,
+            SIZEOF_ARRAY(PreviewPinDataRanges),// Range Count
+            PreviewPinDataRanges,           // Ranges
+            KSPIN_DATAFLOW_OUT,             // Dataflow
+            KSPIN_COMMUNICATION_BOTH,       // Communication
+            &PIN_CATEGORY_PREVIEW,          // Category
+            &g_PINNAME_VIDEO_PREVIEW,       // Name
+            0                               // Reserved
+        },
+        KSPIN_FLAG_PROCESS_IN_RUN_STATE_ONLY,// Pin Flags
+        PREVIEW_PIN_INSTANCES,              // Instances Possible
+        0,                                  // Instances Necessary
+        &CapturePinAllocatorFraming,        // Allocator Framing
+        reinterpret_cast <PFNKSINTERSECTHANDLEREX>
+            (CCapturePin::IntersectHandler)
     }
 };
 
@@ -258,7 +1106,7 @@ CaptureFilterDispatch = {
 // CaptureFilterDescription:
 //
 // The descriptor for the capture filter.  We don't specify any topology
-// since there's only one pin on the filter.  Realistically, there would
+// since there are only the output pins on the filter.  Realistically, there would
 // be some topological relationships here because there would be input 
 // pins from crossbars and the like.
 //
@@ -87,6 +87,46 @@ public:
 	//  Example of adding a new, custom property.
 	DECLARE_PROPERTY_HANDLERS(Data)
 
+	//  Frame with producer header (AVSHWS_FRAME_HEADER + pixels).
+	DECLARE_PROPERTY_HANDLERS(Frame)
+
+	//  Frame rate conversion mode (FRC_MODE as a ULONG).
+	DECLARE_PROPERTY_HANDLERS(FrcMode)
+
+	//  Frame delivery and drop counters (AVSHWS_STATISTICS), read only.
+	DECLARE_PROPERTY_GET_HANDLER(Statistics)
+
+	//  Latency probe stamping on / off (ULONG).
+	DECLARE_PROPERTY_HANDLERS(LatencyProbe)
+
+	//  Frame staging (AVSHWS_STAGING as a ULONG).
+	DECLARE_PROPERTY_HANDLERS(Staging)
+
+	//  Slate a stream starts with (AVSHWS_SLATE_HEADER + image), write only.
+	DECLARE_PROPERTY_SET_HANDLER(Slate)
+
+	//  Producer stall watchdog timeout in milliseconds (ULONG), 0 is off.
+	DECLARE_PROPERTY_HANDLERS(NoSignalTimeout)
+
+	//  Event trace on / off (ULONG), dump (AVSHWS_TRACE_DUMP + records).
+	DECLARE_PROPERTY_HANDLERS(Trace)
+
+	//  Capture mode (AVSHWS_CAPTURE_MODE as a ULONG).
+	DECLARE_PROPERTY_HANDLERS(CaptureMode)
+
+	//  Timestamp mode (AVSHWS_TIMESTAMP_MODE as a ULONG).
+	DECLARE_PROPERTY_HANDLERS(TimestampMode)
+
+	//  Output delay and delay line budget (AVSHWS_OUTPUT_DELAY).
+	DECLARE_PROPERTY_HANDLERS(OutputDelay)
+
+	//  Video control capabilities of a pin (KSPROPERTY_VIDEOCONTROL_CAPS_S).
+	DECLARE_PROPERTY_GET_HANDLER(VideoControlCaps)
+
+	//  Video control mode of a pin (KSPROPERTY_VIDEOCONTROL_MODE_S); setting
+	//  KS_VideoControlFlag_Trigger on the still pin takes a still.
+	DECLARE_PROPERTY_HANDLERS(VideoControlMode)
+
 };
 
 
@@ -0,0 +1,435 @@
+/**************************************************************************
+
+    AVStream Simulated Hardware Sample
+
+    File:
+
+        framepool.cpp
+
+    Abstract:
+
+        The frame buffer pool.  See framepool.h.
+
+    History:
+
+        created 10/18/2026
+
+**************************************************************************/
+
+#include "portable.h"
+
+KDEFERRED_ROUTINE FramePoolTrim;
+
+/**************************************************************************
+
+    PAGEABLE CODE
+
+**************************************************************************/
+
+#ifdef ALLOC_PRAGMA
+#pragma code_seg("PAGE")
+#endif // ALLOC_PRAGMA
+
+
+CFramePool::
+CFramePool (
+    ) :
+    m_BufferSize (0),
+    m_InUse (FALSE),
+    m_LowMemory (NULL),
+    m_LowMemoryHandle (NULL),
+    m_Allocations (0)
+
+/*++
+
+Routine Description:
+
+    Construct an empty frame buffer pool and open the low memory condition
+    event the idle pool is trimmed on.
+
+Arguments:
+
+    None
+
+Return Value:
+
+    None
+
+--*/
+
+{
+
+    PAGED_CODE();
+
+    RtlZeroMemory (m_Buffers, sizeof (m_Buffers));
+
+    KeInitializeSpinLock (&m_Lock);
+    KeInitializeTimer (&m_TrimTimer);
+    KeInitializeDpc (&m_TrimDpc, FramePoolTrim, this);
+
+    UNICODE_STRING Name;
+    RtlInitUnicodeString (&Name, L"\\KernelObjects\\LowMemoryCondition");
+
+    m_LowMemory = IoCreateNotificationEvent (&Name, &m_LowMemoryHandle);
+
+}
+
+/*************************************************/
+
+
+CFramePool::
+~CFramePool (
+    )
+
+/*++
+
+Routine Description:
+
+    Stop the trim check and free the pooled buffers.  No run may hold them.
+
+Arguments:
+
+    None
+
+Return Value:
+
+    None
+
+--*/
+
+{
+
+    PAGED_CODE();
+
+    KeCancelTimer (&m_TrimTimer);
+    KeFlushQueuedDpcs ();
+
+    FreeBuffers (m_Buffers);
+
+    if (m_LowMemoryHandle) {
+        ZwClose (m_LowMemoryHandle);
+    }
+
+}
+
+/**************************************************************************
+
+    LOCKED CODE
+
+**************************************************************************/
+
+#ifdef ALLOC_PRAGMA
+#pragma code_seg()
+#endif // ALLOC_PRAGMA
+
+
+NTSTATUS
+CFramePool::
+Acquire (
+    IN ULONG Size,
+    OUT PUCHAR *Buffers
+    )
+
+/*++
+
+Routine Description:
+
+    Hand out the pooled buffers if they hold at least Size bytes.
+    Otherwise replace them with FRAME_POOL_DEPTH buffers of Size bytes.
+
+    Called at PASSIVE_LEVEL, but takes the pool lock, so it isn't pageable.
+
+Arguments:
+
+    Size -
+        The size each buffer must have
+
+    Buffers -
+        Receives FRAME_POOL_DEPTH buffers
+
+Return Value:
+
+    Success / Failure.  On failure the pool is empty.
+
+--*/
+
+{
+
+    PUCHAR Old [FRAME_POOL_DEPTH];
+    KIRQL Irql;
+
+    KeAcquireSpinLock (&m_Lock, &Irql);
+
+    NT_ASSERT (!m_InUse);
+
+    KeCancelTimer (&m_TrimTimer);
+    m_InUse = TRUE;
+
+    if (m_Buffers [0] && Size <= m_BufferSize) {
+
+        RtlCopyMemory (Buffers, m_Buffers, sizeof (m_Buffers));
+        KeReleaseSpinLock (&m_Lock, Irql);
+
+        return STATUS_SUCCESS;
+
+    }
+
+    DetachBuffers (Old);
+
+    KeReleaseSpinLock (&m_Lock, Irql);
+
+    FreeBuffers (Old);
+
+    PUCHAR New [FRAME_POOL_DEPTH] = { NULL };
+    NTSTATUS Status = STATUS_SUCCESS;
+
+    for (ULONG i = 0; NT_SUCCESS (Status) && i < FRAME_POOL_DEPTH; i++) {
+
+        New [i] = reinterpret_cast <PUCHAR> (
+            ExAllocatePoolWithTag (
+                NonPagedPoolNx,
+                Size,
+                AVSHWS_POOLTAG
+                )
+            );
+
+        if (!New [i]) {
+            Status = STATUS_INSUFFICIENT_RESOURCES;
+        }
+
+    }
+
+    if (!NT_SUCCESS (Status)) {
+
+        FreeBuffers (New);
+
+        KeAcquireSpinLock (&m_Lock, &Irql);
+        m_InUse = FALSE;
+        KeReleaseSpinLock (&m_Lock, Irql);
+
+        return Status;
+
+    }
+
+    KeAcquireSpinLock (&m_Lock, &Irql);
+    RtlCopyMemory (m_Buffers, New, sizeof (m_Buffers));
+    m_BufferSize = Size;
+    KeReleaseSpinLock (&m_Lock, Irql);
+
+    InterlockedIncrement (&m_Allocations);
+
+    RtlCopyMemory (Buffers, New, sizeof (New));
+
+    return STATUS_SUCCESS;
+
+}
+
+/*************************************************/
+
+
+void
+FramePoolTrim (
+    IN PKDPC Dpc,
+    IN PVOID DeferredContext,
+    IN PVOID SystemArg1,
+    IN PVOID SystemArg2
+    )
+
+/*++
+
+Routine Description:
+
+    The periodic trim check of an idle pool.
+
+--*/
+
+{
+
+    UNREFERENCED_PARAMETER (Dpc);
+    UNREFERENCED_PARAMETER (SystemArg1);
+    UNREFERENCED_PARAMETER (SystemArg2);
+
+    reinterpret_cast <CFramePool *> (DeferredContext) -> Trim (FALSE);
+
+}
+
+/*************************************************/
+
+
+void
+CFramePool::
+Release (
+    )
+
+/*++
+
+Routine Description:
+
+    Give the buffers back to the pool.  They are kept for the next run and
+    checked for trimming periodically until then.
+
+Arguments:
+
+    None
+
+Return Value:
+
+    None
+
+--*/
+
+{
+
+    KIRQL Irql;
+
+    KeAcquireSpinLock (&m_Lock, &Irql);
+
+    m_InUse = FALSE;
+
+    if (m_Buffers [0] && m_LowMemory) {
+
+        LARGE_INTEGER DueTime;
+        DueTime.QuadPart = -10000LL * FRAME_POOL_TRIM_PERIOD;
+
+        KeSetTimerEx (
+            &m_TrimTimer,
+            DueTime,
+            FRAME_POOL_TRIM_PERIOD,
+            &m_TrimDpc
+            );
+
+    }
+
+    KeReleaseSpinLock (&m_Lock, Irql);
+
+    //
+    // If memory is already low, don't wait for the first check.
+    //
+    Trim (FALSE);
+
+}
+
+/*************************************************/
+
+
+void
+CFramePool::
+Trim (
+    IN BOOLEAN Force
+    )
+
+/*++
+
+Routine Description:
+
+    Free the pooled buffers if no run holds them and either Force is set
+    or the low memory condition is signaled.
+
+Arguments:
+
+    Force -
+        Free the idle buffers regardless of memory pressure
+
+Return Value:
+
+    None
+
+--*/
+
+{
+
+    PUCHAR Old [FRAME_POOL_DEPTH];
+    KIRQL Irql;
+
+    KeAcquireSpinLock (&m_Lock, &Irql);
+
+    if (m_InUse || !m_Buffers [0] ||
+        !(Force || (m_LowMemory && KeReadStateEvent (m_LowMemory)))) {
+
+        KeReleaseSpinLock (&m_Lock, Irql);
+        return;
+
+    }
+
+    KeCancelTimer (&m_TrimTimer);
+    DetachBuffers (Old);
+
+    KeReleaseSpinLock (&m_Lock, Irql);
+
+    FreeBuffers (Old);
+
+}
+
+/*************************************************/
+
+
+void
+CFramePool::
+DetachBuffers (
+    OUT PUCHAR *Buffers
+    )
+
+/*++
+
+Routine Description:
+
+    Move the pooled buffers to Buffers and empty the pool.  The caller
+    holds the pool lock.
+
+Arguments:
+
+    Buffers -
+        Receives FRAME_POOL_DEPTH buffers, NULL where there were none
+
+Return Value:
+
+    None
+
+--*/
+
+{
+
+    RtlCopyMemory (Buffers, m_Buffers, sizeof (m_Buffers));
+    RtlZeroMemory (m_Buffers, sizeof (m_Buffers));
+    m_BufferSize = 0;
+
+}
+
+/*************************************************/
+
+
+void
+CFramePool::
+FreeBuffers (
+    IN PUCHAR *Buffers
+    )
+
+/*++
+
+Routine Description:
+
+    Free FRAME_POOL_DEPTH buffers, skipping NULL entries.
+
+Arguments:
+
+    Buffers -
+        The buffers to free
+
+Return Value:
+
+    None
+
+--*/
+
+{
+
+    for (ULONG i = 0; i < FRAME_POOL_DEPTH; i++) {
+
+        if (Buffers [i]) {
+            ExFreePool (Buffers [i]);
+            Buffers [i] = NULL;
+        }
+
+    }
+
+}
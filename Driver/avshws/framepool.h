@@ -0,0 +1,171 @@
+/**************************************************************************
+
+    AVStream Simulated Hardware Sample
+
+    File:
+
+        framepool.h
+
+    Abstract:
+
+        The frame buffer pool.  A stream runs on FRAME_POOL_DEPTH frame
+        buffers (the synthesis buffer and the frame history).  The pool
+        hands the same buffers to every run as long as they are large
+        enough for the staged frame, so stopping and restarting the stream,
+        or switching to a smaller format, doesn't allocate.
+
+        Buffers returned by a stopped stream are kept until memory runs
+        low: while the pool is idle it polls the kernel's low memory
+        condition and frees the buffers once it is signaled.
+
+        Host builds get the pool over the kernel stand-ins of portable.h
+        (see Tests/StartTest).
+
+    History:
+
+        created 10/18/2026
+
+**************************************************************************/
+
+//
+// FRAME_POOL_DEPTH:
+//
+// The number of frame buffers a run takes: the synthesis buffer and one
+// for each slot of the frame history.
+//
+#define FRAME_POOL_DEPTH (1 + FRC_HISTORY_DEPTH)
+
+//
+// FRAME_POOL_TRIM_PERIOD:
+//
+// How often an idle pool checks for memory pressure, in milliseconds.
+//
+#define FRAME_POOL_TRIM_PERIOD 1000
+
+/*************************************************
+
+    CFramePool
+
+    One run at a time may hold the buffers (Acquire ... Release).  Acquire
+    must be called at PASSIVE_LEVEL; Release and Trim may be called at or
+    below DISPATCH_LEVEL.
+
+*************************************************/
+
+class CFramePool {
+
+private:
+
+    //
+    // The pooled buffers, each m_BufferSize bytes, and whether a run holds
+    // them.  Guarded by m_Lock.
+    //
+    KSPIN_LOCK m_Lock;
+    PUCHAR m_Buffers [FRAME_POOL_DEPTH];
+    ULONG m_BufferSize;
+    BOOLEAN m_InUse;
+
+    //
+    // The kernel's \KernelObjects\LowMemoryCondition event, or NULL if it
+    // couldn't be opened (the buffers are then only freed with the pool).
+    //
+    PKEVENT m_LowMemory;
+    HANDLE m_LowMemoryHandle;
+
+    //
+    // The periodic trim check, armed while the pool is idle and holds
+    // buffers.
+    //
+    KTIMER m_TrimTimer;
+    KDPC m_TrimDpc;
+
+    //
+    // The number of times Acquire had to allocate.
+    //
+    volatile LONG m_Allocations;
+
+    //
+    // DetachBuffers():
+    //
+    // Move the pooled buffers to Buffers and empty the pool.  The caller
+    // holds m_Lock and frees the buffers after dropping it.
+    //
+    void
+    DetachBuffers (
+        OUT PUCHAR *Buffers
+        );
+
+    //
+    // FreeBuffers():
+    //
+    // Free FRAME_POOL_DEPTH buffers, skipping NULL entries.
+    //
+    static
+    void
+    FreeBuffers (
+        IN PUCHAR *Buffers
+        );
+
+public:
+
+    //
+    // CFramePool():
+    //
+    // Construct an empty pool.  Called at PASSIVE_LEVEL.
+    //
+    CFramePool (
+        );
+
+    //
+    // ~CFramePool():
+    //
+    // Stop the trim check and free the buffers.  Called at PASSIVE_LEVEL.
+    //
+    ~CFramePool (
+        );
+
+    //
+    // Acquire():
+    //
+    // Get FRAME_POOL_DEPTH buffers of at least Size bytes into Buffers,
+    // reusing the pooled ones if they are large enough.
+    //
+    NTSTATUS
+    Acquire (
+        IN ULONG Size,
+        OUT PUCHAR *Buffers
+        );
+
+    //
+    // Release():
+    //
+    // Give the buffers back to the pool.  They are kept for the next run.
+    //
+    void
+    Release (
+        );
+
+    //
+    // Trim():
+    //
+    // Free the buffers if no run holds them and memory is low (or Force
+    // is set).
+    //
+    void
+    Trim (
+        IN BOOLEAN Force
+        );
+
+    //
+    // GetAllocations():
+    //
+    // The number of times Acquire had to allocate buffers.
+    //
+    ULONG
+    GetAllocations (
+        )
+    {
+        return (ULONG)m_Allocations;
+    }
+
+};
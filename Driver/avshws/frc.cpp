@@ -0,0 +1,642 @@
+/**************************************************************************
+
+    AVStream Simulated Hardware Sample
+
+    File:
+
+        frc.cpp
+
+    Abstract:
+
+        Frame rate conversion.  See frc.h.
+
+        This entire file is called at DPC and must be in locked segments.
+
+        SSE2 is used on x64 only.  The x64 kernel preserves the legacy XMM
+        state for us; on x86 and ARM the scalar loop is used instead of
+        saving extended processor state on every tick.
+
+    History:
+
+        created 10/18/2026
+
+**************************************************************************/
+
+#include "portable.h"
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__x86_64__)
+#define FRC_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+/**************************************************************************
+
+    LOCKED CODE
+
+**************************************************************************/
+
+#ifdef ALLOC_PRAGMA
+#pragma code_seg()
+#endif // ALLOC_PRAGMA
+
+
+void
+CFrameHistory::
+Reset (
+    )
+
+/*++
+
+Routine Description:
+
+    Forget every published frame.  Attached buffers are kept.
+
+Arguments:
+
+    None
+
+Return Value:
+
+    None
+
+--*/
+
+{
+
+    for (ULONG Slot = 0; Slot < FRC_HISTORY_DEPTH; Slot++) {
+        m_Slots [Slot].Valid = FALSE;
+        m_Slots [Slot].Writing = FALSE;
+        m_Slots [Slot].Selected = FALSE;
+        m_Slots [Slot].Readers = 0;
+    }
+
+    m_Sequence = 0;
+
+}
+
+/*************************************************/
+
+
+ULONG
+CFrameHistory::
+AcquireWriteSlot (
+    OUT PBOOLEAN Superseded
+    )
+
+/*++
+
+Routine Description:
+
+    Pick the slot the next injected frame is written to.  Empty slots are
+    used first, then the one holding the oldest frame.  Slots being read
+    or already being written are skipped.
+
+Arguments:
+
+    Superseded -
+        Set to TRUE if the slot held a frame which was never selected
+
+Return Value:
+
+    The slot index, or FRC_HISTORY_DEPTH if every slot is busy.
+
+--*/
+
+{
+
+    ULONG Best = FRC_HISTORY_DEPTH;
+
+    *Superseded = FALSE;
+
+    for (ULONG Slot = 0; Slot < FRC_HISTORY_DEPTH; Slot++) {
+
+        PFRC_SLOT Candidate = &m_Slots [Slot];
+
+        if (Candidate -> Readers || Candidate -> Writing ||
+            !Candidate -> Buffer) {
+            continue;
+        }
+
+        if (!Candidate -> Valid) {
+            Best = Slot;
+            break;
+        }
+
+        if (Best == FRC_HISTORY_DEPTH ||
+            (LONG)(Candidate -> Sequence - m_Slots [Best].Sequence) < 0) {
+            Best = Slot;
+        }
+
+    }
+
+    if (Best != FRC_HISTORY_DEPTH) {
+        *Superseded = m_Slots [Best].Valid && !m_Slots [Best].Selected;
+        m_Slots [Best].Writing = TRUE;
+        m_Slots [Best].Valid = FALSE;
+    }
+
+    return Best;
+
+}
+
+/*************************************************/
+
+
+void
+CFrameHistory::
+Publish (
+    IN ULONG Slot,
+    IN LONGLONG Time,
+    IN const AVSHWS_FRAME_HEADER *Header OPTIONAL
+    )
+
+/*++
+
+Routine Description:
+
+    Make a written slot available for selection.
+
+Arguments:
+
+    Slot -
+        The slot returned by AcquireWriteSlot
+
+    Time -
+        The capture time of the frame
+
+    Header -
+        The producer header of the frame, if any
+
+Return Value:
+
+    None
+
+--*/
+
+{
+
+    PFRC_SLOT Target = &m_Slots [Slot];
+
+    if (Header) {
+        Target -> Header = *Header;
+    } else {
+        Target -> Header.Flags = 0;
+        Target -> Header.MetadataLength = 0;
+    }
+
+    Target -> Time = Time;
+    Target -> Sequence = ++m_Sequence;
+    Target -> Writing = FALSE;
+    Target -> Selected = FALSE;
+    Target -> Valid = TRUE;
+
+}
+
+/*************************************************/
+
+
+BOOLEAN
+CFrameHistory::
+Select (
+    IN FRC_MODE Mode,
+    IN LONGLONG OutputTime,
+    OUT PFRC_SELECTION Selection
+    )
+
+/*++
+
+Routine Description:
+
+    Choose what to output at OutputTime.
+
+Arguments:
+
+    Mode -
+        The conversion mode
+
+    OutputTime -
+        The instant the output frame represents, in the same time base as
+        the published frame times
+
+    Selection -
+        Receives the chosen slot(s) and blend weight
+
+Return Value:
+
+    TRUE if a frame was selected, FALSE if the history is empty
+
+--*/
+
+{
+
+    ULONG Newest = FRC_HISTORY_DEPTH;
+    ULONG Nearest = FRC_HISTORY_DEPTH;
+    ULONG Earlier = FRC_HISTORY_DEPTH;
+    ULONG Later = FRC_HISTORY_DEPTH;
+    ULONGLONG NearestDistance = 0;
+
+    for (ULONG Slot = 0; Slot < FRC_HISTORY_DEPTH; Slot++) {
+
+        PFRC_SLOT Candidate = &m_Slots [Slot];
+
+        if (!Candidate -> Valid) {
+            continue;
+        }
+
+        if (Newest == FRC_HISTORY_DEPTH ||
+            (LONG)(Candidate -> Sequence - m_Slots [Newest].Sequence) > 0) {
+            Newest = Slot;
+        }
+
+        LONGLONG Delta = Candidate -> Time - OutputTime;
+        ULONGLONG Distance = (ULONGLONG)(Delta < 0 ? -Delta : Delta);
+
+        //
+        // Prefer the later frame on a tie; it is the fresher picture.
+        //
+        if (Nearest == FRC_HISTORY_DEPTH ||
+            Distance < NearestDistance ||
+            (Distance == NearestDistance &&
+                Candidate -> Time > m_Slots [Nearest].Time)) {
+            Nearest = Slot;
+            NearestDistance = Distance;
+        }
+
+        if (Delta <= 0) {
+            if (Earlier == FRC_HISTORY_DEPTH ||
+                Candidate -> Time > m_Slots [Earlier].Time) {
+                Earlier = Slot;
+            }
+        } else {
+            if (Later == FRC_HISTORY_DEPTH ||
+                Candidate -> Time < m_Slots [Later].Time) {
+                Later = Slot;
+            }
+        }
+
+    }
+
+    if (Newest == FRC_HISTORY_DEPTH) {
+        return FALSE;
+    }
+
+    Selection -> Weight = 0;
+
+    switch (Mode) {
+
+        case FrcModeNearest:
+            Selection -> Earlier = Selection -> Later = Nearest;
+            Selection -> Time = m_Slots [Nearest].Time;
+            break;
+
+        case FrcModeBlend:
+            if (Earlier != FRC_HISTORY_DEPTH && Later != FRC_HISTORY_DEPTH) {
+
+                LONGLONG Span = m_Slots [Later].Time - m_Slots [Earlier].Time;
+
+                Selection -> Earlier = Earlier;
+                Selection -> Later = Later;
+                Selection -> Weight = (ULONG)(
+                    ((OutputTime - m_Slots [Earlier].Time) * FRC_BLEND_ONE +
+                        (Span >> 1)) / Span
+                    );
+                Selection -> Time = OutputTime;
+
+                //
+                // A weight which rounds to either end is just that frame.
+                //
+                if (Selection -> Weight >= FRC_BLEND_ONE) {
+                    Selection -> Earlier = Later;
+                    Selection -> Weight = 0;
+                    Selection -> Time = m_Slots [Later].Time;
+                } else if (Selection -> Weight == 0) {
+                    Selection -> Later = Earlier;
+                    Selection -> Time = m_Slots [Earlier].Time;
+                }
+
+            } else {
+                //
+                // Nothing on one side of the output time: hold the closest
+                // frame we have rather than extrapolating.
+                //
+                Selection -> Earlier = Selection -> Later = Nearest;
+                Selection -> Time = m_Slots [Nearest].Time;
+            }
+            break;
+
+        default:
+            Selection -> Earlier = Selection -> Later = Newest;
+            Selection -> Time = m_Slots [Newest].Time;
+            break;
+
+    }
+
+    m_Slots [Selection -> Earlier].Readers++;
+    m_Slots [Selection -> Earlier].Selected = TRUE;
+    if (Selection -> Later != Selection -> Earlier) {
+        m_Slots [Selection -> Later].Readers++;
+        m_Slots [Selection -> Later].Selected = TRUE;
+    }
+
+    return TRUE;
+
+}
+
+/*************************************************/
+
+
+BOOLEAN
+CFrameHistory::
+HoldNewest (
+    OUT PFRC_SELECTION Selection
+    )
+
+/*++
+
+Routine Description:
+
+    Hold the newest frame for reading.  Unlike Select, the slot is not
+    marked selected: a still taken from a frame doesn't keep it from
+    counting as superseded if the stream never outputs it.
+
+Arguments:
+
+    Selection -
+        Receives the slot, as a selection of one frame
+
+Return Value:
+
+    TRUE if a frame is held, FALSE if the history is empty
+
+--*/
+
+{
+
+    ULONG Newest = FRC_HISTORY_DEPTH;
+
+    for (ULONG Slot = 0; Slot < FRC_HISTORY_DEPTH; Slot++) {
+
+        if (m_Slots [Slot].Valid &&
+            (Newest == FRC_HISTORY_DEPTH ||
+                (LONG)(m_Slots [Slot].Sequence -
+                    m_Slots [Newest].Sequence) > 0)) {
+            Newest = Slot;
+        }
+
+    }
+
+    if (Newest == FRC_HISTORY_DEPTH) {
+        return FALSE;
+    }
+
+    Selection -> Earlier = Selection -> Later = Newest;
+    Selection -> Weight = 0;
+    Selection -> Time = m_Slots [Newest].Time;
+
+    m_Slots [Newest].Readers++;
+
+    return TRUE;
+
+}
+
+/*************************************************/
+
+
+void
+CFrameHistory::
+Release (
+    IN PFRC_SELECTION Selection
+    )
+
+/*++
+
+Routine Description:
+
+    Drop the read holds taken by Select or HoldNewest.
+
+Arguments:
+
+    Selection -
+        The selection returned by Select or HoldNewest
+
+Return Value:
+
+    None
+
+--*/
+
+{
+
+    m_Slots [Selection -> Earlier].Readers--;
+    if (Selection -> Later != Selection -> Earlier) {
+        m_Slots [Selection -> Later].Readers--;
+    }
+
+}
+
+/*************************************************/
+
+
+void
+FrcBlend (
+    OUT PUCHAR Dest,
+    IN const UCHAR *Earlier,
+    IN const UCHAR *Later,
+    IN ULONG Length,
+    IN ULONG Weight
+    )
+
+/*++
+
+Routine Description:
+
+    Blend two frames.  This is a straight per-byte weighted average, which
+    is correct for any 8 bit per component packed format we deliver.
+
+Arguments:
+
+    Dest -
+        The output buffer
+
+    Earlier -
+        The frame before the output time
+
+    Later -
+        The frame after the output time
+
+    Length -
+        The number of bytes to blend
+
+    Weight -
+        The weight of Later, 0 to FRC_BLEND_ONE
+
+Return Value:
+
+    None
+
+--*/
+
+{
+
+    ULONG InverseWeight = FRC_BLEND_ONE - Weight;
+    ULONG i = 0;
+
+#ifdef FRC_USE_SSE2
+
+    const __m128i Zero = _mm_setzero_si128 ();
+    const __m128i WeightA = _mm_set1_epi16 ((SHORT)InverseWeight);
+    const __m128i WeightB = _mm_set1_epi16 ((SHORT)Weight);
+    const __m128i Round = _mm_set1_epi16 (FRC_BLEND_ONE / 2);
+
+    //
+    // 8 bit * 9 bit weights summing to 256 fit 16 bit lanes exactly.
+    //
+    for (; i + 16 <= Length; i += 16) {
+
+        __m128i A = _mm_loadu_si128 ((const __m128i *)(Earlier + i));
+        __m128i B = _mm_loadu_si128 ((const __m128i *)(Later + i));
+
+        __m128i Lo = _mm_add_epi16 (
+            _mm_add_epi16 (
+                _mm_mullo_epi16 (_mm_unpacklo_epi8 (A, Zero), WeightA),
+                _mm_mullo_epi16 (_mm_unpacklo_epi8 (B, Zero), WeightB)
+                ),
+            Round
+            );
+
+        __m128i Hi = _mm_add_epi16 (
+            _mm_add_epi16 (
+                _mm_mullo_epi16 (_mm_unpackhi_epi8 (A, Zero), WeightA),
+                _mm_mullo_epi16 (_mm_unpackhi_epi8 (B, Zero), WeightB)
+                ),
+            Round
+            );
+
+        _mm_storeu_si128 (
+            (__m128i *)(Dest + i),
+            _mm_packus_epi16 (_mm_srli_epi16 (Lo, 8), _mm_srli_epi16 (Hi, 8))
+            );
+
+    }
+
+#endif // FRC_USE_SSE2
+
+    for (; i < Length; i++) {
+        Dest [i] = (UCHAR)(
+            (Earlier [i] * InverseWeight + Later [i] * Weight +
+                FRC_BLEND_ONE / 2) >> 8
+            );
+    }
+
+}
+
+/*************************************************/
+
+
+void
+FrcBlend16 (
+    OUT PUSHORT Dest,
+    IN const USHORT *Earlier,
+    IN const USHORT *Later,
+    IN ULONG Count,
+    IN ULONG Weight
+    )
+
+/*++
+
+Routine Description:
+
+    Blend two frames of 16 bit samples, such as P010.  The same weighted
+    average as FrcBlend, per sample instead of per byte.
+
+Arguments:
+
+    Dest -
+        The output buffer
+
+    Earlier -
+        The frame before the output time
+
+    Later -
+        The frame after the output time
+
+    Count -
+        The number of samples to blend
+
+    Weight -
+        The weight of Later, 0 to FRC_BLEND_ONE
+
+Return Value:
+
+    None
+
+--*/
+
+{
+
+    ULONG InverseWeight = FRC_BLEND_ONE - Weight;
+    ULONG i = 0;
+
+#ifdef FRC_USE_SSE2
+
+    const __m128i WeightA = _mm_set1_epi16 ((SHORT)InverseWeight);
+    const __m128i WeightB = _mm_set1_epi16 ((SHORT)Weight);
+    const __m128i Round = _mm_set1_epi32 (FRC_BLEND_ONE / 2);
+    const __m128i Bias32 = _mm_set1_epi32 (0x8000);
+    const __m128i Bias16 = _mm_set1_epi16 ((SHORT)0x8000);
+
+    //
+    // 16 bit * 9 bit products need 32 bit lanes; they are assembled from
+    // the low and high halves of the 16 bit multiplies.  SSE2 has no
+    // unsigned 32 to 16 bit pack, so the results are biased into signed
+    // range for _mm_packs_epi32 and back.
+    //
+    for (; i + 8 <= Count; i += 8) {
+
+        __m128i A = _mm_loadu_si128 ((const __m128i *)(Earlier + i));
+        __m128i B = _mm_loadu_si128 ((const __m128i *)(Later + i));
+
+        __m128i LowA = _mm_mullo_epi16 (A, WeightA);
+        __m128i HighA = _mm_mulhi_epu16 (A, WeightA);
+        __m128i LowB = _mm_mullo_epi16 (B, WeightB);
+        __m128i HighB = _mm_mulhi_epu16 (B, WeightB);
+
+        __m128i Lo = _mm_add_epi32 (
+            _mm_add_epi32 (
+                _mm_unpacklo_epi16 (LowA, HighA),
+                _mm_unpacklo_epi16 (LowB, HighB)
+                ),
+            Round
+            );
+
+        __m128i Hi = _mm_add_epi32 (
+            _mm_add_epi32 (
+                _mm_unpackhi_epi16 (LowA, HighA),
+                _mm_unpackhi_epi16 (LowB, HighB)
+                ),
+            Round
+            );
+
+        _mm_storeu_si128 (
+            (__m128i *)(Dest + i),
+            _mm_add_epi16 (
+                _mm_packs_epi32 (
+                    _mm_sub_epi32 (_mm_srli_epi32 (Lo, 8), Bias32),
+                    _mm_sub_epi32 (_mm_srli_epi32 (Hi, 8), Bias32)
+                    ),
+                Bias16
+                )
+            );
+
+    }
+
+#endif // FRC_USE_SSE2
+
+    for (; i < Count; i++) {
+        Dest [i] = (USHORT)(
+            (Earlier [i] * InverseWeight + Later [i] * Weight +
+                FRC_BLEND_ONE / 2) >> 8
+            );
+    }
+
+}
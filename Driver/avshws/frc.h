@@ -0,0 +1,292 @@
+/**************************************************************************
+
+    AVStream Simulated Hardware Sample
+
+    File:
+
+        frc.h
+
+    Abstract:
+
+        Frame rate conversion.  The hardware simulation keeps a short,
+        timestamped history of injected frames.  At each output tick the
+        converter picks the frame nearest to the output time or blends the
+        two frames that straddle it.
+
+        Nothing in here touches the kernel: the history only tracks slot
+        state and the caller provides the frame buffers and serializes
+        access.  frc.cpp includes portable.h, so the selection and blending
+        logic builds and is tested outside of the driver (Tests/FrcTest).
+
+    History:
+
+        created 10/18/2026
+
+**************************************************************************/
+
+//
+// FRC_HISTORY_DEPTH:
+//
+// The number of injected frames kept in the history.  Blending reads two
+// slots at DPC while the producer writes a third, so this must be at
+// least three.
+//
+#define FRC_HISTORY_DEPTH 3
+
+//
+// FRC_BLEND_ONE:
+//
+// Blend weights are fixed point with this as 1.0.
+//
+#define FRC_BLEND_ONE 256
+
+//
+// FRC_MODE:
+//
+// How the output frame is chosen from the history.
+//
+//     FrcModeLatest  - the most recently injected frame (no conversion).
+//                      The default
+//     FrcModeNearest - the frame whose timestamp is nearest the output time
+//     FrcModeBlend   - a weighted average of the frames either side of the
+//                      output time
+//
+// The output time of the other two modes is a frame period before the
+// tick, so that a later frame is there to pick or blend with; opting into
+// them costs a frame period of latency.
+//
+typedef enum {
+
+    FrcModeLatest = 0,
+    FrcModeNearest,
+    FrcModeBlend,
+
+    FrcModeMax
+
+} FRC_MODE;
+
+//
+// FRC_SLOT:
+//
+// A single entry of the frame history.
+//
+typedef struct _FRC_SLOT {
+
+    PUCHAR Buffer;
+    LONGLONG Time;
+    ULONG Sequence;
+    ULONG Readers;
+    BOOLEAN Writing;
+    BOOLEAN Valid;
+    BOOLEAN Selected;
+    AVSHWS_FRAME_HEADER Header;
+
+} FRC_SLOT, *PFRC_SLOT;
+
+//
+// FRC_SELECTION:
+//
+// The outcome of a selection.  If Weight is zero, only Earlier is used.
+// Otherwise the output is Earlier * (FRC_BLEND_ONE - Weight) + Later * Weight.
+// Both slots are held for reading until CFrameHistory::Release.
+//
+typedef struct _FRC_SELECTION {
+
+    ULONG Earlier;
+    ULONG Later;
+    ULONG Weight;
+    LONGLONG Time;
+
+} FRC_SELECTION, *PFRC_SELECTION;
+
+/*************************************************
+
+    CFrameHistory
+
+    The timestamped history of injected frames.  The caller must serialize
+    all calls (the hardware simulation uses its frame lock).  Buffer
+    contents are accessed outside the lock: a slot handed out by
+    AcquireWriteSlot is never selected, and a selected slot is never handed
+    out for writing until it is released.
+
+*************************************************/
+
+class CFrameHistory {
+
+private:
+
+    FRC_SLOT m_Slots [FRC_HISTORY_DEPTH];
+
+    //
+    // Sequence number of the most recently published frame.  Zero means
+    // nothing has been published yet.
+    //
+    ULONG m_Sequence;
+
+public:
+
+    //
+    // SetBuffer():
+    //
+    // Attach the frame buffer for a slot.  Called when the simulation
+    // (re)allocates its frame storage.
+    //
+    void
+    SetBuffer (
+        IN ULONG Slot,
+        IN PUCHAR Buffer
+        )
+    {
+        m_Slots [Slot].Buffer = Buffer;
+    }
+
+    PUCHAR
+    GetBuffer (
+        IN ULONG Slot
+        )
+    {
+        return m_Slots [Slot].Buffer;
+    }
+
+    ULONG
+    GetSlotSequence (
+        IN ULONG Slot
+        )
+    {
+        return m_Slots [Slot].Sequence;
+    }
+
+    const AVSHWS_FRAME_HEADER *
+    GetHeader (
+        IN ULONG Slot
+        )
+    {
+        return &m_Slots [Slot].Header;
+    }
+
+    //
+    // Reset():
+    //
+    // Forget all published frames.  Buffers stay attached.
+    //
+    void
+    Reset (
+        );
+
+    //
+    // GetSequence():
+    //
+    // The sequence number of the most recently published frame, zero if
+    // nothing has been published.  Changes whenever a frame is published.
+    //
+    ULONG
+    GetSequence (
+        )
+    {
+        return m_Sequence;
+    }
+
+    //
+    // AcquireWriteSlot():
+    //
+    // Find the oldest slot which is not being read and mark it as being
+    // written.  Returns FRC_HISTORY_DEPTH if no slot is available.
+    // Superseded is set if this discards a frame which was never selected.
+    //
+    ULONG
+    AcquireWriteSlot (
+        OUT PBOOLEAN Superseded
+        );
+
+    //
+    // Publish():
+    //
+    // Complete a write started with AcquireWriteSlot.  Time is the frame's
+    // capture time; Header may be NULL.
+    //
+    void
+    Publish (
+        IN ULONG Slot,
+        IN LONGLONG Time,
+        IN const AVSHWS_FRAME_HEADER *Header OPTIONAL
+        );
+
+    //
+    // Abandon():
+    //
+    // Give up a write started with AcquireWriteSlot without publishing.
+    //
+    void
+    Abandon (
+        IN ULONG Slot
+        )
+    {
+        m_Slots [Slot].Writing = FALSE;
+    }
+
+    //
+    // Select():
+    //
+    // Choose the frame(s) for an output at OutputTime according to Mode and
+    // hold them for reading.  Returns FALSE if nothing has been published.
+    //
+    BOOLEAN
+    Select (
+        IN FRC_MODE Mode,
+        IN LONGLONG OutputTime,
+        OUT PFRC_SELECTION Selection
+        );
+
+    //
+    // HoldNewest():
+    //
+    // Hold the most recently published frame for reading without counting
+    // it as output, for a still.  Returns FALSE if nothing has been
+    // published.  The hold is dropped by Release.
+    //
+    BOOLEAN
+    HoldNewest (
+        OUT PFRC_SELECTION Selection
+        );
+
+    //
+    // Release():
+    //
+    // Drop the read holds taken by Select or HoldNewest.
+    //
+    void
+    Release (
+        IN PFRC_SELECTION Selection
+        );
+
+};
+
+//
+// FrcBlend():
+//
+// Weighted average of two buffers of Length bytes:
+//     Dest = (Earlier * (FRC_BLEND_ONE - Weight) + Later * Weight) / FRC_BLEND_ONE
+// rounded to nearest.  Vectorized where the target allows it.
+//
+void
+FrcBlend (
+    OUT PUCHAR Dest,
+    IN const UCHAR *Earlier,
+    IN const UCHAR *Later,
+    IN ULONG Length,
+    IN ULONG Weight
+    );
+
+//
+// FrcBlend16():
+//
+// FrcBlend of Count 16 bit samples, for the P010 history.
+//
+void
+FrcBlend16 (
+    OUT PUSHORT Dest,
+    IN const USHORT *Earlier,
+    IN const USHORT *Later,
+    IN ULONG Count,
+    IN ULONG Weight
+    );
@@ -63,7 +63,9 @@ CHardwareSimulation (
     IN IHardwareSink *HardwareSink
     ) :
     m_HardwareSink (HardwareSink),
-    m_ScatterGatherMappingsMax (SCATTER_GATHER_MAPPINGS_MAX)
+    m_ScatterGatherMappingsMax (SCATTER_GATHER_MAPPINGS_MAX),
+    m_FrcMode (FrcModeLatest),
+    m_DelayBudget (AVSHWS_OUTPUT_DELAY_BUDGET_DEFAULT)
 
 /*++
 
@@ -103,9 +105,31 @@ Return Value:
         FALSE
         );
 
+    KeInitializeEvent (
+        &m_CopyEvent,
+        NotificationEvent,
+        TRUE
+        );
+
     KeInitializeTimer (&m_IsrTimer);
 
     KeInitializeSpinLock (&m_ListLock);
+    KeInitializeSpinLock (&m_FrameLock);
+    ExInitializeFastMutex (&m_HeldLock);
+
+    //
+    // Initialize the entry lookaside.  It is kept for the life of the
+    // simulation rather than rebuilt on every run.
+    //
+    ExInitializeNPagedLookasideList (
+        &m_ScatterGatherLookaside,
+        NULL,
+        NULL,
+        POOL_NX_ALLOCATION,
+        sizeof (SCATTER_GATHER_ENTRY),
+        'nEGS',
+        0
+        );
 
 }
 
@@ -202,84 +226,102 @@ Return Value:
 
     NTSTATUS Status = STATUS_SUCCESS;
 
+    m_StartPerformanceTime = QueryPerformanceTime ();
+    m_StartDuration = 0;
+    m_TimeToFirstFrame = 0;
+
     m_ImageSynth = ImageSynth;
     m_TimePerFrame = TimePerFrame;
     m_ImageSize = ImageSize;
     m_Height = Height;
     m_Width = Width;
+    m_PixelFormat = ImageSynth -> GetPixelFormat ();
+    m_LineBytes = ConvertLineBytes (m_PixelFormat, Width);
+    m_Lines = ConvertFrameSize (m_PixelFormat, Width, Height) / m_LineBytes;
+
+    m_StagingFormat = m_PixelFormat;
+    m_StagingSize = m_ImageSize;
+
+    if (m_Staging == AvshwsStagingNv12 &&
+        ConvertFrameSize (AvshwsFormatNv12, Width, Height) != 0) {
+
+        m_StagingFormat = AvshwsFormatNv12;
+        m_StagingSize = ConvertFrameSize (AvshwsFormatNv12, Width, Height);
+
+    }
 
     InitializeListHead (&m_ScatterGatherMappings);
     m_NumMappingsCompleted = 0;
     m_ScatterGatherMappingsQueued = 0;
-    m_NumFramesSkipped = 0;
+    m_Drops.Reset ();
+    m_Watchdog.Start (m_StartPerformanceTime);
     m_InterruptTime = 0;
 
+    m_RunCaptureMode = m_CaptureMode;
+    m_FramePending = FALSE;
+    m_PendingNoSignal = FALSE;
+    m_FrameCopying = FALSE;
+    m_ReadyDeferred = FALSE;
+
+    RtlZeroMemory (&m_SynthesisHeader, sizeof (m_SynthesisHeader));
+    RtlZeroMemory (&m_DeliveredHeader, sizeof (m_DeliveredHeader));
+    m_SynthesisGeneration = 0;
+
     KeQuerySystemTime (&m_StartTime);
 
     //
-    // Allocate a scratch buffer for the synthesizer.
+    // Get the synthesis buffer and the frame history from the pool, which
+    // keeps them from the previous run if they are large enough.  The
+    // synthesis buffer starts with the held frame for this size, so the
+    // consumer sees a real picture from the first tick; without one it
+    // stays black until the producer injects the first frame.
     //
-    m_SynthesisBuffer = reinterpret_cast <PUCHAR> (
-        ExAllocatePoolWithTag (
-            NonPagedPoolNx,
-            m_ImageSize,
-            AVSHWS_POOLTAG
-            )
-        );
+    m_History.Reset ();
 
-    if (!m_SynthesisBuffer) {
-        Status = STATUS_INSUFFICIENT_RESOURCES;
-    }
+    Status = AllocateFrameBuffers (m_StagingSize);
 
-	//
-	// Allocate a temporary frame buffer;
-	//
-	m_TemporaryBuffer = reinterpret_cast <PUCHAR> (
-		ExAllocatePoolWithTag(
-			NonPagedPoolNx,
-			m_ImageSize,
-			AVSHWS_POOLTAG
-			)
-		);
+    if (NT_SUCCESS (Status)) {
+        AllocateDelayRing ();
+    }
 
-	if (!m_TemporaryBuffer) {
-		Status = STATUS_INSUFFICIENT_RESOURCES;
-	}
+    if (NT_SUCCESS (Status) && !StageHeldFrame ()) {
+        ConvertFillBlack (
+            m_StagingFormat,
+            m_SynthesisBuffer,
+            m_Width,
+            m_Height
+            );
+    }
 
-	RtlZeroMemory(m_TemporaryBuffer, m_ImageSize);
-	
     //
     // If everything is ok, start issuing interrupts.
     //
     if (NT_SUCCESS (Status)) {
 
-        //
-        // Initialize the entry lookaside.
-        //
-        ExInitializeNPagedLookasideList (
-            &m_ScatterGatherLookaside,
-            NULL,
-            NULL,
-            POOL_NX_ALLOCATION,
-            sizeof (SCATTER_GATHER_ENTRY),
-            'nEGS',
-            0
-            );
-
         //
         // Set up the synthesizer with the width, height, and scratch buffer.
+        // With the watchdog on, it first draws the no signal slate.
         //
         m_ImageSynth -> SetImageSize (m_Width, m_Height);
-        m_ImageSynth -> SetBuffer (m_SynthesisBuffer);
+
+        RenderNoSignal ();
+
+        m_ImageSynth -> SetBuffer (
+            m_StagingFormat == m_PixelFormat ? m_SynthesisBuffer : NULL
+            );
 
         LARGE_INTEGER NextTime;
         NextTime.QuadPart = m_StartTime.QuadPart + m_TimePerFrame;
 
         m_HardwareState = HardwareRunning;
+        m_FirstTickPending = TRUE;
         KeSetTimer (&m_IsrTimer, NextTime, &m_IsrFakeDpc);
 
     }
 
+    m_StartDuration =
+        (ULONG)(QueryPerformanceTime () - m_StartPerformanceTime);
+
     return Status;
         
 }
@@ -289,33 +331,26 @@ Return Value:
 
 NTSTATUS
 CHardwareSimulation::
-Pause (
-    BOOLEAN Pausing
+AllocateFrameBuffers (
+    IN ULONG Size
     )
 
 /*++
 
 Routine Description:
 
-    Pause the hardware simulation...  When the hardware simulation is told
-    to pause, it stops issuing interrupts, etc...  but it does not reset
-    the counters 
+    Take the synthesis buffer and the frame history buffers from the frame
+    pool.  The pool hands out the buffers of the previous run if they are
+    large enough; otherwise it replaces them by buffers of Size bytes.
 
 Arguments:
 
-    Pausing -
-        Indicates whether the hardware is pausing or not. 
-
-        TRUE -
-            Pause the hardware
-
-        FALSE -
-            Unpause the hardware from a previous pause
-
+    Size -
+        The size of a staged frame
 
 Return Value:
 
-    Success / Failure
+    Success / Failure.  On failure no buffers are held.
 
 --*/
 
@@ -323,71 +358,38 @@ Return Value:
 
     PAGED_CODE();
 
-    if (Pausing && m_HardwareState == HardwareRunning) {
-        //
-        // If we were running, stop completing mappings, etc...
-        //
-        m_StopHardware = TRUE;
-    
-        KeWaitForSingleObject (
-            &m_HardwareEvent,
-            Suspended,
-            KernelMode,
-            FALSE,
-            NULL
-            );
-
-        NT_ASSERT (m_StopHardware == FALSE);
-
-        m_HardwareState = HardwarePaused; 
-
-    } else if (!Pausing && m_HardwareState == HardwarePaused) {
-
-        //
-        // For unpausing the hardware, we need to compute the relative time
-        // and restart interrupts.
-        //
-        LARGE_INTEGER UnpauseTime;
+    PUCHAR Buffers [FRAME_POOL_DEPTH];
 
-        KeQuerySystemTime (&UnpauseTime);
-        m_InterruptTime = (ULONG) (
-            (UnpauseTime.QuadPart - m_StartTime.QuadPart) /
-            m_TimePerFrame
-            );
+    NTSTATUS Status = m_FramePool.Acquire (Size, Buffers);
 
-        UnpauseTime.QuadPart = m_StartTime.QuadPart +
-            (m_InterruptTime + 1) * m_TimePerFrame;
+    if (!NT_SUCCESS (Status)) {
+        return Status;
+    }
 
-        m_HardwareState = HardwareRunning;
-        KeSetTimer (&m_IsrTimer, UnpauseTime, &m_IsrFakeDpc);
+    m_SynthesisBuffer = Buffers [0];
 
+    for (ULONG Slot = 0; Slot < FRC_HISTORY_DEPTH; Slot++) {
+        m_History.SetBuffer (Slot, Buffers [1 + Slot]);
     }
 
     return STATUS_SUCCESS;
 
 }
 
-/**************************************************************************
-
-    LOCKED CODE
+/*************************************************/
 
-**************************************************************************/
 
-#ifdef ALLOC_PRAGMA
-#pragma code_seg()
-#endif // ALLOC_PRAGMA
-
-NTSTATUS
+void
 CHardwareSimulation::
-Stop (
+FreeDelayBuffers (
     )
 
 /*++
 
 Routine Description:
 
-    Stop the hardware simulation....  Wait until the hardware simulation
-    has successfully stopped and then return.
+    Free the buffers of the output delay line and detach them from the
+    ring.  The hardware must not be running.
 
 Arguments:
 
@@ -395,355 +397,2343 @@ Arguments:
 
 Return Value:
 
-    Success / Failure
+    None
 
 --*/
 
 {
-    KIRQL Irql;
-    //
-    // If the hardware is told to stop while it's running, we need to
-    // halt the interrupts first.  If we're already paused, this has
-    // already been done.
-    //
-    if (m_HardwareState == HardwareRunning) {
-    
-        m_StopHardware = TRUE;
-    
-        KeWaitForSingleObject (
-            &m_HardwareEvent,
-            Suspended,
-            KernelMode,
-            FALSE,
-            NULL
-            );
-    
-        NT_ASSERT (m_StopHardware == FALSE);
-
-    }
 
-    m_HardwareState = HardwareStopped;
-
-    //
-    // The image synthesizer may still be around.  Just for safety's
-    // sake, NULL out the image synthesis buffer and toast it.
-    //
-    m_ImageSynth -> SetBuffer (NULL);
+    PAGED_CODE();
 
-    if (m_SynthesisBuffer) {
-        ExFreePool (m_SynthesisBuffer);
-        m_SynthesisBuffer = NULL;
+    for (ULONG Slot = 0; Slot < DELAY_RING_DEPTH; Slot++) {
+        m_DelayLine.SetBuffer (Slot, NULL);
     }
 
-	if (m_TemporaryBuffer) {
-		ExFreePool(m_TemporaryBuffer);
-		m_TemporaryBuffer = NULL;
-	}
+    m_DelayLine.Reset (0, 0, m_TimePerFrame, m_TimePerFrame);
 
-    //
-    // Protect the S/G list
-    //
-    KeAcquireSpinLock (&m_ListLock, &Irql);
-    // 
-    // Free S/G buffer 
-    // 
-    // 
-    while (m_ScatterGatherMappingsQueued > 0) {
-        LIST_ENTRY *listEntry = RemoveHeadList (&m_ScatterGatherMappings);
-        m_ScatterGatherMappingsQueued--;
-        PSCATTER_GATHER_ENTRY SGEntry =
-            reinterpret_cast <PSCATTER_GATHER_ENTRY> (
-                CONTAINING_RECORD (
-                    listEntry,
-                    SCATTER_GATHER_ENTRY,
-                    ListEntry
-                    )
-                );
-        // 
-        // Release the scatter / gather entry back to our lookaside. 
-        // 
-        ExFreeToNPagedLookasideList (
-            &m_ScatterGatherLookaside,
-            reinterpret_cast <PVOID> (SGEntry)
-            );
-    } 
+    while (m_DelayBufferCount) {
+        m_DelayBufferCount--;
+        ExFreePool (m_DelayBuffers [m_DelayBufferCount]);
+        m_DelayBuffers [m_DelayBufferCount] = NULL;
+    }
 
-    m_NumMappingsCompleted = 0;
-    m_ScatterGatherBytesQueued = 0;
-    //
-    // Delete the scatter / gather lookaside for this run.
-    //
-    ExDeleteNPagedLookasideList (&m_ScatterGatherLookaside);
+    m_DelayBufferSize = 0;
 
-    KeReleaseSpinLock (&m_ListLock, Irql);
+}
 
-    return STATUS_SUCCESS;
+/*************************************************/
 
-}
 
-
-ULONG
+NTSTATUS
 CHardwareSimulation::
-ReadNumberOfMappingsCompleted (
+HoldFrame (
+    IN PHELD_FRAME Held,
+    IN ULONG Format,
+    IN const UCHAR *TopRow,
+    IN LONG Stride,
+    IN ULONG Width,
+    IN ULONG Height
     )
 
 /*++
 
 Routine Description:
 
-    Read the number of scatter / gather mappings which have been
-    completed (TOTAL NUMBER) since the last reset of the simulated
-    hardware
+    Keep a copy of a frame to start a later stream with.  The copy is
+    tightly packed and top-down whatever the layout of the source, so
+    that it can be converted like an injected frame.  Held frames are
+    only accessed at PASSIVE_LEVEL and live in paged pool.
 
 Arguments:
 
-    None
+    Held -
+        The held frame to replace
+
+    Format -
+        The AVSHWS_PIXEL_FORMAT of the frame
+
+    TopRow -
+        The displayed top row of the frame
+
+    Stride -
+        The signed distance in bytes from one displayed row to the next.
+        Only single plane frames may have a stride other than their row
+        size.
+
+    Width -
+        The frame width
+
+    Height -
+        The frame height
 
 Return Value:
 
-    Total number of completed mappings.
+    Success / Failure
 
 --*/
 
 {
 
-    //
-    // Don't care if this is being updated this moment in the DPC...  I only
-    // need a number to return which isn't too great (too small is ok).
-    // In real hardware, this wouldn't be done this way anyway.
-    //
-    return m_NumMappingsCompleted;
+    PAGED_CODE();
+
+    ULONG Size = ConvertFrameSize (Format, Width, Height);
+    ULONG LineBytes = ConvertLineBytes (Format, Width);
+
+    if (Size == 0) {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    NTSTATUS Status = STATUS_SUCCESS;
+
+    ExAcquireFastMutex (&m_HeldLock);
+
+    if (Held -> BufferSize < Size) {
+
+        if (Held -> Buffer) {
+            ExFreePool (Held -> Buffer);
+        }
+
+        Held -> Buffer = reinterpret_cast <PUCHAR> (
+            ExAllocatePoolWithTag (
+                PagedPool,
+                Size,
+                AVSHWS_POOLTAG
+                )
+            );
+
+        Held -> BufferSize = Held -> Buffer ? Size : 0;
+
+    }
+
+    if (Held -> Buffer) {
+
+        if (Stride == (LONG)LineBytes) {
+            RtlCopyMemory (Held -> Buffer, TopRow, Size);
+        } else {
+            for (ULONG y = 0; y < Size / LineBytes; y++) {
+                RtlCopyMemory (
+                    Held -> Buffer + LineBytes * y,
+                    TopRow + (LONG_PTR)Stride * y,
+                    LineBytes
+                    );
+            }
+        }
+
+        Held -> Format = Format;
+        Held -> Width = Width;
+        Held -> Height = Height;
+        Held -> Valid = TRUE;
+
+    } else {
+
+        Held -> Valid = FALSE;
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+
+    }
+
+    ExReleaseFastMutex (&m_HeldLock);
+
+    return Status;
 
 }
 
 /*************************************************/
 
-
-ULONG
+
+BOOLEAN
 CHardwareSimulation::
-ProgramScatterGatherMappings (
-    IN PKSSTREAM_POINTER Clone,
-    IN PUCHAR *Buffer,
-    IN PKSMAPPING Mappings,
-    IN ULONG MappingsCount,
-    IN ULONG MappingStride
+StageHeldFrame (
     )
 
 /*++
 
 Routine Description:
 
-    Program the scatter gather mapping list.  This shoves a bunch of 
-    entries on a list for access during the fake interrupt.  Note that
-    we have physical addresses here only for simulation.  We really
-    access via the virtual address....  although we chunk it into multiple
-    buffers to more realistically simulate S/G
+    Convert the frame a new stream starts with into the synthesis buffer:
+    the last frame of the previous stream, or injected since, if it has the
+    stream's size, otherwise the slate if it has.
 
 Arguments:
 
-    Buffer -
-        The virtual address of the buffer mapped by the mapping list 
-
-    Mappings -
-        The KSMAPPINGS array corresponding to the buffer
-
-    MappingsCount -
-        The number of mappings in the mappings array
-
-    MappingStride -
-        The mapping stride used in initialization of AVStream DMA
+    None
 
 Return Value:
 
-    Number of mappings actually inserted.
+    TRUE if the synthesis buffer was filled, FALSE if there is no held
+    frame of the stream's size.
 
 --*/
 
 {
 
-    KIRQL Irql;
+    PAGED_CODE();
 
-    ULONG MappingsInserted = 0;
+    BOOLEAN Staged = FALSE;
+    PHELD_FRAME Held = NULL;
 
-    //
-    // Protect our S/G list with a spinlock.
-    //
-    KeAcquireSpinLock (&m_ListLock, &Irql);
+    ExAcquireFastMutex (&m_HeldLock);
+
+    if (m_LastFrame.Valid &&
+        m_LastFrame.Width == m_Width && m_LastFrame.Height == m_Height) {
+        Held = &m_LastFrame;
+    } else if (m_Slate.Valid &&
+        m_Slate.Width == m_Width && m_Slate.Height == m_Height) {
+        Held = &m_Slate;
+    }
+
+    if (Held) {
+
+        PUCHAR TopRow;
+        LONG Stride;
+
+        GetStagingLayout (m_SynthesisBuffer, &TopRow, &Stride);
+
+        Staged = ConvertFrame (
+            Held -> Format,
+            Held -> Buffer,
+            m_StagingFormat,
+            TopRow,
+            Stride,
+            m_Width,
+            m_Height
+            );
+
+    }
+
+    ExReleaseFastMutex (&m_HeldLock);
+
+    return Staged;
+
+}
+
+/*************************************************/
+
+
+void
+CHardwareSimulation::
+RenderNoSignal (
+    )
+
+/*++
+
+Routine Description:
+
+    Draw the no signal slate, color bars with a caption, for the stream
+    being started.  Drawing a whole frame with the synthesizer is too slow
+    to do at every tick, so it is drawn once here and only drawn again when
+    a stream starts with another format or size.  The slate is in the
+    delivered layout of the output format whatever the staging, so a tick
+    delivers it by plain copy.
+
+    The synthesizer must have the stream's image size.
+
+Arguments:
+
+    None
+
+Return Value:
+
+    None
+
+--*/
+
+{
+
+    PAGED_CODE();
+
+    if (m_Watchdog.GetTimeout () == 0) {
+        m_NoSignalReady = FALSE;
+        return;
+    }
+
+    if (m_NoSignalBuffer &&
+        m_NoSignalFormat == m_PixelFormat &&
+        m_NoSignalWidth == m_Width &&
+        m_NoSignalHeight == m_Height) {
+        m_NoSignalReady = TRUE;
+        return;
+    }
+
+    m_NoSignalReady = FALSE;
+
+    if (m_NoSignalBufferSize < m_ImageSize) {
+
+        if (m_NoSignalBuffer) {
+            ExFreePool (m_NoSignalBuffer);
+        }
+
+        m_NoSignalBuffer = reinterpret_cast <PUCHAR> (
+            ExAllocatePoolWithTag (
+                NonPagedPoolNx,
+                m_ImageSize,
+                AVSHWS_POOLTAG
+                )
+            );
+
+        m_NoSignalBufferSize = m_NoSignalBuffer ? m_ImageSize : 0;
+
+    }
+
+    if (!m_NoSignalBuffer) {
+        return;
+    }
+
+    //
+    // The synthesizer only draws the luma plane of P010; start from black
+    // so that the chroma plane is neutral.
+    //
+    CHAR Caption [] = "NO SIGNAL";
+    ULONG Scaling = m_Width / 160;
+
+    ConvertFillBlack (m_PixelFormat, m_NoSignalBuffer, m_Width, m_Height);
+
+    m_ImageSynth -> SetBuffer (m_NoSignalBuffer);
+    m_ImageSynth -> SynthesizeBars ();
+    m_ImageSynth -> OverlayText (
+        POSITION_CENTER,
+        POSITION_CENTER,
+        Scaling ? Scaling : 1,
+        Caption,
+        BLACK,
+        WHITE
+        );
+    m_ImageSynth -> SetBuffer (NULL);
+
+    m_NoSignalFormat = m_PixelFormat;
+    m_NoSignalWidth = m_Width;
+    m_NoSignalHeight = m_Height;
+    m_NoSignalReady = TRUE;
+
+}
+
+/*************************************************/
+
+
+NTSTATUS
+CHardwareSimulation::
+SetSlate (
+    IN ULONG Format,
+    IN ULONG Width,
+    IN ULONG Height,
+    IN const UCHAR *Data,
+    IN ULONG DataLength
+    )
+
+/*++
+
+Routine Description:
+
+    Set the slate: the image a stream of its size starts with when there
+    is no earlier frame to start it with.
+
+Arguments:
+
+    Format -
+        The AVSHWS_PIXEL_FORMAT of the image
+
+    Width -
+        The image width, or zero to clear the slate
+
+    Height -
+        The image height, or zero to clear the slate
+
+    Data -
+        The image, tightly packed and top-down
+
+    DataLength -
+        The size of Data in bytes
+
+Return Value:
+
+    Success / Failure
+
+--*/
+
+{
+
+    PAGED_CODE();
+
+    if (Width == 0 || Height == 0) {
+
+        ExAcquireFastMutex (&m_HeldLock);
+        m_Slate.Valid = FALSE;
+        ExReleaseFastMutex (&m_HeldLock);
+
+        return STATUS_SUCCESS;
+
+    }
+
+    ULONG Size = ConvertFrameSize (Format, Width, Height);
+
+    if (Size == 0 || DataLength < Size) {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    return HoldFrame (
+        &m_Slate,
+        Format,
+        Data,
+        (LONG)ConvertLineBytes (Format, Width),
+        Width,
+        Height
+        );
+
+}
+
+/*************************************************/
+
+
+BOOLEAN
+CHardwareSimulation::
+DeliverStill (
+    IN PKSSTREAM_HEADER StreamHeader,
+    IN ULONG Format,
+    IN ULONG Width,
+    IN ULONG Height,
+    OUT PSTREAM_POINTER_CONTEXT Context
+    )
+
+/*++
+
+Routine Description:
+
+    Copy the newest injected frame into a still buffer.  The frame is
+    written straight from its frame history slot, which is held for
+    reading meanwhile so the producer writes its next frames elsewhere:
+    there is no staging buffer and the ticks aren't involved, so the
+    stream's pacing is untouched.  Injected frames have the stream's size,
+    so the still must have the stream's format and size.
+
+    Stop takes the held frame lock before giving the history back to the
+    pool, which waits out a copy in progress.  The frame lock is only
+    taken in HoldNewestFrame and ReleaseHeldFrame, which aren't pageable.
+
+Arguments:
+
+    StreamHeader -
+        The stream header of the still buffer.  DataUsed is set if a
+        frame is written.
+
+    Format -
+        The AVSHWS_PIXEL_FORMAT of the still pin
+
+    Width -
+        The width of the still pin's format
+
+    Height -
+        The height of the still pin's format
+
+    Context -
+        Receives the capture instant and the generation of the frame
+
+Return Value:
+
+    Whether a frame was written.  There is none unless the stream runs in
+    the same format and size and the producer has injected a frame since
+    it started.
+
+--*/
+
+{
+
+    PAGED_CODE();
+
+    BOOLEAN Delivered = FALSE;
+    FRC_SELECTION Selection;
+
+    ExAcquireFastMutex (&m_HeldLock);
+
+    if (m_HardwareState != HardwareStopped && m_SynthesisBuffer &&
+        Format == m_PixelFormat && Width == m_Width && Height == m_Height &&
+        StreamHeader -> FrameExtent >= m_ImageSize &&
+        HoldNewestFrame (&Selection, Context)) {
+
+        WriteFrame (
+            reinterpret_cast <PUCHAR> (StreamHeader -> Data),
+            StreamHeader,
+            m_History.GetBuffer (Selection.Earlier)
+            );
+
+        StreamHeader -> DataUsed = m_ImageSize;
+
+        ReleaseHeldFrame (&Selection);
+
+        Delivered = TRUE;
+
+    }
+
+    ExReleaseFastMutex (&m_HeldLock);
+
+    return Delivered;
+
+}
+
+/*************************************************/
+
+
+PPREVIEW_FRAME
+CHardwareSimulation::
+GetPreviewFrame (
+    IN ULONG Width,
+    IN ULONG Height
+    )
+
+/*++
+
+Routine Description:
+
+    Find the scaled frame kept for a preview size.  If there is none, the
+    next entry in turn is taken over for it, growing its buffers if they
+    are too small.  Called with m_HeldLock held.
+
+Arguments:
+
+    Width -
+        The width of the preview
+
+    Height -
+        The height of the preview
+
+Return Value:
+
+    The scaled frame for the size, or NULL if its buffers can't be allocated
+
+--*/
+
+{
+
+    PAGED_CODE();
+
+    for (ULONG i = 0; i < PREVIEW_FRAME_COUNT; i++) {
+
+        PPREVIEW_FRAME Preview = &m_PreviewFrames [i];
+
+        if (Preview -> Buffer && Preview -> Format == m_StagingFormat &&
+            Preview -> Width == Width && Preview -> Height == Height) {
+            return Preview;
+        }
+
+    }
+
+    PPREVIEW_FRAME Preview = &m_PreviewFrames [m_NextPreviewFrame];
+    m_NextPreviewFrame = (m_NextPreviewFrame + 1) % PREVIEW_FRAME_COUNT;
+
+    ULONG Size = ConvertFrameSize (m_StagingFormat, Width, Height);
+    ULONG OldSize = Preview -> Buffer ?
+        ConvertFrameSize (Preview -> Format, Preview -> Width,
+            Preview -> Height) : 0;
+
+    Preview -> Valid = FALSE;
+
+    if (OldSize < Size) {
+
+        if (Preview -> Buffer) {
+            ExFreePool (Preview -> Buffer);
+        }
+
+        Preview -> Buffer = reinterpret_cast <PUCHAR> (
+            ExAllocatePoolWithTag (
+                PagedPool,
+                Size,
+                AVSHWS_POOLTAG
+                )
+            );
+
+    }
+
+    if (Preview -> Accumulator && Preview -> Width < Width) {
+        ExFreePool (Preview -> Accumulator);
+        Preview -> Accumulator = NULL;
+    }
+
+    if (!Preview -> Accumulator) {
+        Preview -> Accumulator = reinterpret_cast <PULONG> (
+            ExAllocatePoolWithTag (
+                PagedPool,
+                SCALE_ACCUMULATOR_COUNT (Width) * sizeof (ULONG),
+                AVSHWS_POOLTAG
+                )
+            );
+    }
+
+    if (!Preview -> Buffer || !Preview -> Accumulator) {
+
+        if (Preview -> Buffer) {
+            ExFreePool (Preview -> Buffer);
+            Preview -> Buffer = NULL;
+        }
+
+        return NULL;
+
+    }
+
+    Preview -> Format = m_StagingFormat;
+    Preview -> Width = Width;
+    Preview -> Height = Height;
+
+    return Preview;
+
+}
+
+/*************************************************/
+
+
+BOOLEAN
+CHardwareSimulation::
+DeliverPreview (
+    IN PKSSTREAM_HEADER StreamHeader,
+    IN ULONG Format,
+    IN ULONG Width,
+    IN ULONG Height,
+    OUT PSTREAM_POINTER_CONTEXT Context
+    )
+
+/*++
+
+Routine Description:
+
+    Write the newest injected frame into a preview buffer, downscaled.
+    The frame is scaled once per injected frame and preview size, straight
+    from its frame history slot (held for reading meanwhile, as for a
+    still), and every preview pin of that size is served from the scaled
+    frame until a newer one is injected.  The scaled frame is then copied,
+    or converted from the staging format, into the buffer.
+
+    Previews are of the injected frames as they are: frame rate
+    conversion and the no signal slate are the capture pin's.  As for a
+    still, the frame lock is only taken in the non-paged HoldNewestFrame
+    and ReleaseHeldFrame.
+
+Arguments:
+
+    StreamHeader -
+        The stream header of the preview buffer.  DataUsed is set if a
+        frame is written.
+
+    Format -
+        The AVSHWS_PIXEL_FORMAT of the preview pin, RGB24 or BGRA
+
+    Width -
+        The width of the preview pin's format
+
+    Height -
+        The height of the preview pin's format
+
+    Context -
+        Receives the capture instant and the generation of the frame
+
+Return Value:
+
+    Whether a frame was written.  There is none unless the stream runs at
+    least as large as the preview and the producer has injected a frame
+    since it started.
+
+--*/
+
+{
+
+    PAGED_CODE();
+
+    BOOLEAN Delivered = FALSE;
+    ULONG Size = ConvertFrameSize (Format, Width, Height);
+    FRC_SELECTION Selection;
+
+    ExAcquireFastMutex (&m_HeldLock);
+
+    PPREVIEW_FRAME Preview = NULL;
+
+    if (m_HardwareState != HardwareStopped && m_SynthesisBuffer &&
+        (Format == AvshwsFormatRgb24 || Format == AvshwsFormatBgra) &&
+        Size != 0 && Width <= m_Width && Height <= m_Height &&
+        StreamHeader -> FrameExtent >= Size) {
+
+        Preview = GetPreviewFrame (Width, Height);
+
+    }
+
+    if (Preview) {
+
+        BOOLEAN Held = HoldNewestFrame (&Selection, Context);
+
+        if (Held) {
+
+            ULONG Sequence = Context -> Generation;
+
+            if (!Preview -> Valid || Preview -> Sequence != Sequence) {
+
+                Preview -> Valid = ScaleFrame (
+                    m_StagingFormat,
+                    m_History.GetBuffer (Selection.Earlier),
+                    m_Width,
+                    m_Height,
+                    Preview -> Buffer,
+                    Width,
+                    Height,
+                    Preview -> Accumulator
+                    );
+
+                Preview -> Sequence = Sequence;
+
+            }
+
+            ReleaseHeldFrame (&Selection);
+
+        }
+
+        if (Held && Preview -> Valid) {
+
+            PUCHAR Destination =
+                reinterpret_cast <PUCHAR> (StreamHeader -> Data);
+            LONG LineBytes = (LONG)ConvertLineBytes (Format, Width);
+            LONG Stride = LineBytes;
+
+            if (StreamHeader -> Size >=
+                sizeof (KSSTREAM_HEADER) + sizeof (KS_FRAME_INFO)) {
+
+                PKS_FRAME_INFO FrameInfo =
+                    reinterpret_cast <PKS_FRAME_INFO> (StreamHeader + 1);
+
+                if (FrameInfo -> lSurfacePitch != 0) {
+                    Stride = abs (FrameInfo -> lSurfacePitch);
+                }
+
+            }
+
+            if (m_StagingFormat == Format) {
+
+                PUCHAR Source = Preview -> Buffer;
+
+                for (ULONG y = 0; y < Height; y++) {
+                    RtlCopyMemory (
+                        Destination + (ULONG)Stride * y,
+                        Source,
+                        LineBytes
+                        );
+                    Source += LineBytes;
+                }
+
+            } else {
+
+                //
+                // As in WriteFrame: RGB is staged bottom-up like the
+                // buffer, so its rows go across in order; NV12 and P010
+                // are staged top-down and land in the bottom-up buffer
+                // from its last row.
+                //
+                PUCHAR TopRow = Destination;
+                LONG RowStride = Stride;
+
+                if (m_StagingFormat == AvshwsFormatNv12 ||
+                    m_StagingFormat == AvshwsFormatP010) {
+                    TopRow += (ULONG)Stride * (Height - 1);
+                    RowStride = -Stride;
+                }
+
+                ConvertFrame (
+                    m_StagingFormat,
+                    Preview -> Buffer,
+                    Format,
+                    TopRow,
+                    RowStride,
+                    Width,
+                    Height
+                    );
+
+            }
+
+            StreamHeader -> DataUsed = Size;
+
+            Delivered = TRUE;
+
+        }
+
+    }
+
+    ExReleaseFastMutex (&m_HeldLock);
+
+    return Delivered;
+
+}
+
+/*************************************************/
+
+
+NTSTATUS
+CHardwareSimulation::
+Pause (
+    BOOLEAN Pausing
+    )
+
+/*++
+
+Routine Description:
+
+    Pause the hardware simulation...  When the hardware simulation is told
+    to pause, it stops issuing interrupts, etc...  but it does not reset
+    the counters 
+
+Arguments:
+
+    Pausing -
+        Indicates whether the hardware is pausing or not. 
+
+        TRUE -
+            Pause the hardware
+
+        FALSE -
+            Unpause the hardware from a previous pause
+
+
+Return Value:
+
+    Success / Failure
+
+--*/
+
+{
+
+    PAGED_CODE();
+
+    if (Pausing && m_HardwareState == HardwareRunning) {
+        //
+        // If we were running, stop completing mappings, etc...
+        //
+        m_StopHardware = TRUE;
+    
+        KeWaitForSingleObject (
+            &m_HardwareEvent,
+            Suspended,
+            KernelMode,
+            FALSE,
+            NULL
+            );
+
+        NT_ASSERT (m_StopHardware == FALSE);
+
+        m_FirstTickPending = FALSE;
+        m_HardwareState = HardwarePaused; 
+
+    } else if (!Pausing && m_HardwareState == HardwarePaused) {
+
+        //
+        // For unpausing the hardware, we need to compute the relative time
+        // and restart interrupts.
+        //
+        LARGE_INTEGER UnpauseTime;
+
+        KeQuerySystemTime (&UnpauseTime);
+        m_InterruptTime = (ULONG) (
+            (UnpauseTime.QuadPart - m_StartTime.QuadPart) /
+            m_TimePerFrame
+            );
+
+        UnpauseTime.QuadPart = m_StartTime.QuadPart +
+            (m_InterruptTime + 1) * m_TimePerFrame;
+
+        m_HardwareState = HardwareRunning;
+        KeSetTimer (&m_IsrTimer, UnpauseTime, &m_IsrFakeDpc);
+
+    }
+
+    return STATUS_SUCCESS;
+
+}
+
+/**************************************************************************
+
+    LOCKED CODE
+
+**************************************************************************/
+
+#ifdef ALLOC_PRAGMA
+#pragma code_seg()
+#endif // ALLOC_PRAGMA
+
+NTSTATUS
+CHardwareSimulation::
+Stop (
+    )
+
+/*++
+
+Routine Description:
+
+    Stop the hardware simulation....  Wait until the hardware simulation
+    has successfully stopped and then return.
+
+Arguments:
+
+    None
+
+Return Value:
+
+    Success / Failure
+
+--*/
+
+{
+    KIRQL Irql;
+    //
+    // If the hardware is told to stop while it's running, we need to
+    // halt the interrupts first.  If we're already paused, this has
+    // already been done.
+    //
+    if (m_HardwareState == HardwareRunning) {
+    
+        m_StopHardware = TRUE;
+    
+        KeWaitForSingleObject (
+            &m_HardwareEvent,
+            Suspended,
+            KernelMode,
+            FALSE,
+            NULL
+            );
+    
+        NT_ASSERT (m_StopHardware == FALSE);
+
+    }
+
+    m_HardwareState = HardwareStopped;
+
+    //
+    // A frame left for the capture pin goes with the buffers, and so does
+    // a tick deferred behind a copy.  Wait out a copy still in progress:
+    // it reads the synthesis buffer outside the list lock.
+    //
+    KeAcquireSpinLock (&m_ListLock, &Irql);
+    m_FramePending = FALSE;
+    m_ReadyDeferred = FALSE;
+    KeReleaseSpinLock (&m_ListLock, Irql);
+
+    KeWaitForSingleObject (
+        &m_CopyEvent,
+        Executive,
+        KernelMode,
+        FALSE,
+        NULL
+        );
+
+    //
+    // The image synthesizer may still be around.  Just for safety's
+    // sake, NULL out the image synthesis buffer and toast it.
+    //
+    m_ImageSynth -> SetBuffer (NULL);
+
+    //
+    // If the producer published anything, keep the frame the consumer saw
+    // last to start the next stream with.
+    //
+    if (m_SynthesisBuffer && m_History.GetSequence ()) {
+
+        PUCHAR TopRow;
+        LONG Stride;
+
+        GetStagingLayout (m_SynthesisBuffer, &TopRow, &Stride);
+
+        HoldFrame (
+            &m_LastFrame,
+            m_StagingFormat,
+            TopRow,
+            Stride,
+            m_Width,
+            m_Height
+            );
+
+    }
+
+    //
+    // Hand the frame buffers back to the pool, which keeps them for the
+    // next run.  Taking the held frame lock waits out a still or preview
+    // frame being copied from the history.  The scaled preview frames are
+    // of this stream's frames, so they go too.
+    //
+    ExAcquireFastMutex (&m_HeldLock);
+
+    FreeFrameBuffers ();
+
+    for (ULONG i = 0; i < PREVIEW_FRAME_COUNT; i++) {
+        m_PreviewFrames [i].Valid = FALSE;
+    }
+
+    ExReleaseFastMutex (&m_HeldLock);
+
+    //
+    // Protect the S/G list
+    //
+    KeAcquireSpinLock (&m_ListLock, &Irql);
+    // 
+    // Free S/G buffer 
+    // 
+    // 
+    while (m_ScatterGatherMappingsQueued > 0) {
+        LIST_ENTRY *listEntry = RemoveHeadList (&m_ScatterGatherMappings);
+        m_ScatterGatherMappingsQueued--;
+        PSCATTER_GATHER_ENTRY SGEntry =
+            reinterpret_cast <PSCATTER_GATHER_ENTRY> (
+                CONTAINING_RECORD (
+                    listEntry,
+                    SCATTER_GATHER_ENTRY,
+                    ListEntry
+                    )
+                );
+        // 
+        // Release the scatter / gather entry back to our lookaside. 
+        // 
+        ExFreeToNPagedLookasideList (
+            &m_ScatterGatherLookaside,
+            reinterpret_cast <PVOID> (SGEntry)
+            );
+    } 
+
+    m_NumMappingsCompleted = 0;
+    m_ScatterGatherBytesQueued = 0;
+
+    KeReleaseSpinLock (&m_ListLock, Irql);
+
+    return STATUS_SUCCESS;
+
+}
+
+
+ULONG
+CHardwareSimulation::
+ReadNumberOfMappingsCompleted (
+    )
+
+/*++
+
+Routine Description:
+
+    Read the number of scatter / gather mappings which have been
+    completed (TOTAL NUMBER) since the last reset of the simulated
+    hardware
+
+Arguments:
+
+    None
+
+Return Value:
+
+    Total number of completed mappings.
+
+--*/
+
+{
+
+    //
+    // Don't care if this is being updated this moment in the DPC...  I only
+    // need a number to return which isn't too great (too small is ok).
+    // In real hardware, this wouldn't be done this way anyway.
+    //
+    return m_NumMappingsCompleted;
+
+}
+
+/*************************************************/
+
+
+ULONG
+CHardwareSimulation::
+ProgramScatterGatherMappings (
+    IN PKSSTREAM_POINTER Clone,
+    IN PUCHAR *Buffer,
+    IN PKSMAPPING Mappings,
+    IN ULONG MappingsCount,
+    IN ULONG MappingStride
+    )
+
+/*++
+
+Routine Description:
+
+    Program the scatter gather mapping list.  This shoves a bunch of 
+    entries on a list for access during the fake interrupt.  Note that
+    we have physical addresses here only for simulation.  We really
+    access via the virtual address....  although we chunk it into multiple
+    buffers to more realistically simulate S/G
+
+Arguments:
+
+    Buffer -
+        The virtual address of the buffer mapped by the mapping list 
+
+    Mappings -
+        The KSMAPPINGS array corresponding to the buffer
+
+    MappingsCount -
+        The number of mappings in the mappings array
+
+    MappingStride -
+        The mapping stride used in initialization of AVStream DMA
+
+Return Value:
+
+    Number of mappings actually inserted.
+
+--*/
+
+{
+
+    KIRQL Irql;
+
+    ULONG MappingsInserted = 0;
+
+    //
+    // Protect our S/G list with a spinlock.
+    //
+    KeAcquireSpinLock (&m_ListLock, &Irql);
+
+    //
+    // Loop through the scatter / gather list and break the buffer up into
+    // chunks equal to the scatter / gather mappings.  Stuff the virtual
+    // addresses of these chunks on a list somewhere.  We update the buffer
+    // pointer the caller passes as a more convenient way of doing this.
+    //
+    // If I could just remap physical in the list to virtual easily here,
+    // I wouldn't need to do it.
+    //
+    do
+    {
+        PSCATTER_GATHER_ENTRY Entry =
+            reinterpret_cast <PSCATTER_GATHER_ENTRY> (
+                ExAllocateFromNPagedLookasideList (
+                    &m_ScatterGatherLookaside
+                    )
+                );
+
+        if (!Entry) {
+            break;
+        }
+        Entry -> Virtual    = *Buffer;
+        Entry -> ByteCount  = MappingsCount;
+        Entry -> CloneEntry = Clone;
+
+        //
+        // Move forward a specific number of bytes in chunking this into
+        // mapping sized va buffers.
+        //
+        *Buffer += MappingsCount;
+        Mappings = reinterpret_cast <PKSMAPPING> (
+            (reinterpret_cast <PUCHAR> (Mappings) + MappingStride)
+            );
+
+        InsertTailList (&m_ScatterGatherMappings, &(Entry -> ListEntry));
+        MappingsInserted = MappingsCount;
+        m_ScatterGatherMappingsQueued++;
+        m_ScatterGatherBytesQueued += MappingsCount;
+
+        m_Trace.Record (
+            AvshwsTraceSgProgram,
+            0,
+            MappingsCount,
+            m_ScatterGatherBytesQueued
+            );
+
+        //
+        // Don't make the consumer wait a frame period for the first frame.
+        //
+        if (m_FirstTickPending &&
+            m_ScatterGatherBytesQueued >= m_ImageSize) {
+            StartFirstTick ();
+        }
+
+   }
+    while(FALSE);
+
+    KeReleaseSpinLock (&m_ListLock, Irql);
+
+    return MappingsInserted;
+
+}
+
+/*************************************************/
+
+
+NTSTATUS
+CHardwareSimulation::
+FillScatterGatherBuffers (
+    )
+
+/*++
+
+Routine Description:
+
+    The hardware has synthesized a buffer in scratch space and we're to
+    fill scatter / gather buffers.
+
+Arguments:
+
+    None
+
+Return Value:
+
+    Success / Failure
+
+--*/
+
+{
+
+    //
+    // We're using this list lock to protect our scatter / gather lists instead
+    // of some hardware mechanism / KeSynchronizeExecution / whatever.
+    //
+    KeAcquireSpinLockAtDpcLevel (&m_ListLock);
+
+    //
+    // While the producer is gone the no signal slate is delivered instead,
+    // which is already in the output format.
+    //
+    BOOLEAN NoSignal = m_Watchdog.IsNoSignal ();
+
+    ULONG BufferRemaining = m_ImageSize;
+    ULONG Generation = NoSignal ? 0 : m_SynthesisGeneration;
+    ULONG Written = 0;
+
+    //
+    // For simplification, if there aren't enough scatter / gather buffers
+    // queued, we don't partially fill the ones that are available.  We just
+    // skip the frame and consider it starvation.
+    //
+    // This could be enforced by only programming scatter / gather mappings
+    // for a buffer if all of them fit in the table also...
+    //
+    while (BufferRemaining &&
+        m_ScatterGatherMappingsQueued > 0 &&
+        m_ScatterGatherBytesQueued >= BufferRemaining) {
+
+        LIST_ENTRY *listEntry = RemoveHeadList (&m_ScatterGatherMappings);
+        m_ScatterGatherMappingsQueued--;
+
+        PSCATTER_GATHER_ENTRY SGEntry =  
+            reinterpret_cast <PSCATTER_GATHER_ENTRY> (
+                CONTAINING_RECORD (
+                    listEntry,
+                    SCATTER_GATHER_ENTRY,
+                    ListEntry
+                    )
+                );
+
+        //
+        // Since we're software, we'll be accessing this by virtual address...
+        //
+        WriteFrame (
+            SGEntry -> Virtual,
+            SGEntry -> CloneEntry -> StreamHeader,
+            NoSignal ? m_NoSignalBuffer : m_SynthesisBuffer
+            );
+
+        BufferRemaining -= m_LineBytes * m_Lines;
+
+        //
+        // Tag the clone with the capture instant of the frame it now holds
+        // so that the completion can timestamp it.
+        //
+        PSTREAM_POINTER_CONTEXT SPContext =
+            reinterpret_cast <PSTREAM_POINTER_CONTEXT> (
+                SGEntry -> CloneEntry -> Context
+                );
+
+        SPContext -> ProducerTimeValid = !NoSignal &&
+            (m_SynthesisHeader.Flags & AVSHWS_FRAME_FLAG_TIMESTAMP_VALID) != 0;
+        SPContext -> ProducerTime = m_SynthesisHeader.Timestamp;
+        SPContext -> Generation = Generation;
+        SPContext -> Tick = m_InterruptTime;
+
+        Written++;
+        m_NumMappingsCompleted++;
+        m_ScatterGatherBytesQueued -= SGEntry -> ByteCount;
+
+        //
+        // Release the scatter / gather entry back to our lookaside.
+        //
+        ExFreeToNPagedLookasideList (
+            &m_ScatterGatherLookaside,
+            reinterpret_cast <PVOID> (SGEntry)
+            );
+
+    }
+    
+    //
+    // The loop either takes a whole frame or nothing.  If nothing was taken,
+    // tell starvation (nothing queued) from a queue too short for a frame.
+    //
+    if (m_Drops.Fill (
+            BufferRemaining == 0,
+            m_ScatterGatherMappingsQueued != 0
+            )) {
+        m_TimeToFirstFrame =
+            (ULONG)(QueryPerformanceTime () - m_StartPerformanceTime);
+    }
+
+    m_Trace.Record (
+        AvshwsTraceSgFill,
+        Generation,
+        BufferRemaining ? 0 : m_ImageSize,
+        Written
+        );
+
+    KeReleaseSpinLockFromDpcLevel (&m_ListLock);
+
+    if (!BufferRemaining && !NoSignal) {
+        KeAcquireSpinLockAtDpcLevel (&m_FrameLock);
+        m_DeliveredHeader = m_SynthesisHeader;
+        KeReleaseSpinLockFromDpcLevel (&m_FrameLock);
+    }
+
+    if (BufferRemaining) return STATUS_INSUFFICIENT_RESOURCES;
+    else return STATUS_SUCCESS;
+    
+}
+
+/*************************************************/
+
+
+void
+CHardwareSimulation::
+WriteFrame (
+    IN PUCHAR Destination,
+    IN PKSSTREAM_HEADER StreamHeader,
+    IN PUCHAR Source
+    )
+
+/*++
+
+Routine Description:
+
+    Write a frame into a consumer buffer: copied row by row if it is
+    staged in the output format (or is the no signal slate), otherwise
+    converted from the staging format on the way.  Rows are spaced by the
+    surface pitch of the buffer if it has one.
+
+Arguments:
+
+    Destination -
+        The start of the consumer buffer
+
+    StreamHeader -
+        The stream header of the consumer buffer
+
+    Source -
+        The frame: the synthesis buffer, a frame history buffer or the no
+        signal slate
+
+Return Value:
+
+    None
+
+--*/
+
+{
+
+    PUCHAR Buffer = Source;
+    BOOLEAN NoSignal = Source == m_NoSignalBuffer;
+
+    LONG Width = m_LineBytes;
+
+    LONG Stride = Width;
+    if(StreamHeader->Size >= sizeof(KSSTREAM_HEADER)+sizeof(KS_FRAME_INFO))
+    {
+        PKS_FRAME_INFO FrameInfo = reinterpret_cast <PKS_FRAME_INFO> (StreamHeader+1);
+        if(FrameInfo->lSurfacePitch != 0)
+        {
+            Stride = FrameInfo->lSurfacePitch;
+            if(FrameInfo->lSurfacePitch < 0)
+            {
+                Stride = -Stride;
+            }
+        }
+    }
+
+    if (NoSignal || m_StagingFormat == m_PixelFormat)
+    {
+        for(ULONG y = 0; y < m_Lines; y++)
+        {
+            RtlCopyMemory((Destination+(ULONG)Stride*y), Buffer, Width);
+            Buffer += Width;
+        }
+    }
+    else
+    {
+        //
+        // Expand the staged frame straight into the buffer, laid out
+        // as the copy above would have: RGB bottom-up, P010 top-down.
+        //
+        PUCHAR TopRow = Destination;
+        LONG RowStride = Stride;
+
+        if (m_PixelFormat != AvshwsFormatP010)
+        {
+            TopRow += (ULONG)Stride * (m_Height - 1);
+            RowStride = -Stride;
+        }
+
+        ConvertFrame(
+            m_StagingFormat,
+            Source,
+            m_PixelFormat,
+            TopRow,
+            RowStride,
+            m_Width,
+            m_Height
+            );
+    }
+
+}
+
+/*************************************************/
+
+
+void
+CHardwareSimulation::
+StartFirstTick (
+    )
+
+/*++
+
+Routine Description:
+
+    Run the first tick now and schedule the rest from here, rather than
+    make the consumer wait a frame period for its first frame.  If the
+    timer can't be cancelled, the tick is already on its way.  Called with
+    the list lock held.
+
+Arguments:
+
+    None
+
+Return Value:
+
+    None
+
+--*/
+
+{
+
+    m_FirstTickPending = FALSE;
+
+    if (m_InterruptTime == 0 && KeCancelTimer (&m_IsrTimer)) {
+
+        LARGE_INTEGER Now;
+        KeQuerySystemTime (&Now);
+
+        m_StartTime.QuadPart = Now.QuadPart - m_TimePerFrame;
+        KeInsertQueueDpc (&m_IsrFakeDpc, NULL, NULL);
+
+    }
+
+}
+
+/*************************************************/
+
+
+void
+CHardwareSimulation::
+ReadyFrame (
+    )
+
+/*++
+
+Routine Description:
+
+    The tick of copy capture mode.  Produce the frame for this tick in the
+    synthesis buffer and leave it for the capture pin to copy out.  While
+    the pin is copying the previous frame out of the synthesis buffer, the
+    frame is readied when the copy is done instead (see DeliverFrame).
+
+Arguments:
+
+    None
+
+Return Value:
+
+    None
+
+--*/
+
+{
+
+    KeAcquireSpinLockAtDpcLevel (&m_ListLock);
+
+    if (m_FrameCopying) {
+
+        //
+        // A tick deferred already had no buffer to go to by now.
+        //
+        if (m_ReadyDeferred) {
+            m_Drops.Drop (DropNoBuffer);
+        }
+
+        m_ReadyDeferred = TRUE;
+
+    } else {
+
+        PrepareFrame ();
+
+    }
+
+    KeReleaseSpinLockFromDpcLevel (&m_ListLock);
+
+}
+
+/*************************************************/
+
+
+void
+CHardwareSimulation::
+PrepareFrame (
+    )
+
+/*++
+
+Routine Description:
+
+    Produce the synthesis buffer for the tick and mark it ready for the
+    capture pin.  If the pin never took the previous frame, no buffer was
+    there for it.  Called with the list lock held and no copy in progress.
+
+Arguments:
+
+    None
+
+Return Value:
+
+    None
+
+--*/
+
+{
+
+    if (m_FramePending) {
+
+        m_Drops.Drop (DropNoBuffer);
+
+        m_Trace.Record (
+            AvshwsTraceSgFill,
+            m_PendingNoSignal ? 0 : m_SynthesisGeneration,
+            0,
+            0
+            );
+
+    }
+
+    ConvertFrameRate ();
+
+    m_FramePending = TRUE;
+    m_PendingNoSignal = m_Watchdog.IsNoSignal ();
+    m_PendingTick = m_InterruptTime;
+
+}
+
+/*************************************************/
+
+
+BOOLEAN
+CHardwareSimulation::
+DeliverFrame (
+    IN PKSSTREAM_HEADER StreamHeader,
+    OUT PSTREAM_POINTER_CONTEXT Context
+    )
+
+/*++
+
+Routine Description:
+
+    Copy the frame readied by the last tick into a consumer buffer, for
+    copy capture mode.  This is the processing side of a common buffer
+    device: the data goes straight from the synthesis buffer into the
+    buffer at the leading edge, with no scatter / gather entries.  If no
+    frame is ready because the stream has just started, the first tick is
+    brought forward now that there is a buffer for it.
+
+    The frame is claimed under the list lock and copied outside it, so a
+    whole frame isn't copied at DISPATCH_LEVEL with the tick locked out.
+    A tick that comes during the copy leaves the synthesis buffer alone
+    and has its frame readied once the copy is done.
+
+Arguments:
+
+    StreamHeader -
+        The stream header of the buffer at the leading edge.  DataUsed is
+        set to the frame size if a frame is written, and to zero if the
+        buffer is too small for one.
+
+    Context -
+        Receives the capture instant and the generation of the frame
+
+Return Value:
+
+    Whether the buffer is done with: a frame was written into it, or it
+    is too small for one and is to be completed empty.  FALSE if no frame
+    is ready.
+
+--*/
+
+{
+
+    KIRQL Irql;
+
+    KeAcquireSpinLock (&m_ListLock, &Irql);
+
+    if (!m_FramePending) {
+
+        if (m_FirstTickPending) {
+            StartFirstTick ();
+        }
+
+        KeReleaseSpinLock (&m_ListLock, Irql);
+        return FALSE;
+
+    }
+
+    BOOLEAN NoSignal = m_PendingNoSignal;
+    ULONG Generation = NoSignal ? 0 : m_SynthesisGeneration;
+
+    m_FramePending = FALSE;
 
     //
-    // Loop through the scatter / gather list and break the buffer up into
-    // chunks equal to the scatter / gather mappings.  Stuff the virtual
-    // addresses of these chunks on a list somewhere.  We update the buffer
-    // pointer the caller passes as a more convenient way of doing this.
+    // As in mapped mode, a buffer too small for the frame doesn't get part
+    // of it.  It is completed empty so the queue moves on to the next one.
+    //
+    if (StreamHeader -> FrameExtent < m_ImageSize) {
+
+        m_Drops.Drop (DropPartialMapping);
+        m_Trace.Record (AvshwsTraceSgFill, Generation, 0, 0);
+
+        Context -> ProducerTimeValid = FALSE;
+        Context -> ProducerTime = 0;
+        Context -> Generation = Generation;
+        Context -> Tick = m_PendingTick;
+
+        KeReleaseSpinLock (&m_ListLock, Irql);
+
+        StreamHeader -> DataUsed = 0;
+
+        return TRUE;
+
+    }
+
+    //
+    // Claim the frame.  Until the copy is done the tick doesn't rewrite the
+    // synthesis buffer or its header, and Stop waits on the copy event.
+    //
+    m_FrameCopying = TRUE;
+    KeClearEvent (&m_CopyEvent);
+
+    Context -> ProducerTimeValid = !NoSignal &&
+        (m_SynthesisHeader.Flags & AVSHWS_FRAME_FLAG_TIMESTAMP_VALID) != 0;
+    Context -> ProducerTime = m_SynthesisHeader.Timestamp;
+    Context -> Generation = Generation;
+    Context -> Tick = m_PendingTick;
+
+    KeReleaseSpinLock (&m_ListLock, Irql);
+
+    WriteFrame (
+        reinterpret_cast <PUCHAR> (StreamHeader -> Data),
+        StreamHeader,
+        NoSignal ? m_NoSignalBuffer : m_SynthesisBuffer
+        );
+
+    StreamHeader -> DataUsed = m_ImageSize;
+
+    KeAcquireSpinLock (&m_ListLock, &Irql);
+
+    if (m_Drops.Fill (TRUE, TRUE)) {
+        m_TimeToFirstFrame =
+            (ULONG)(QueryPerformanceTime () - m_StartPerformanceTime);
+    }
+
+    m_Trace.Record (AvshwsTraceSgFill, Generation, m_ImageSize, 1);
+
+    if (!NoSignal) {
+        KeAcquireSpinLockAtDpcLevel (&m_FrameLock);
+        m_DeliveredHeader = m_SynthesisHeader;
+        KeReleaseSpinLockFromDpcLevel (&m_FrameLock);
+    }
+
+    m_FrameCopying = FALSE;
+
+    if (m_ReadyDeferred) {
+        m_ReadyDeferred = FALSE;
+        PrepareFrame ();
+    }
+
+    KeSetEvent (&m_CopyEvent, IO_NO_INCREMENT, FALSE);
+
+    KeReleaseSpinLock (&m_ListLock, Irql);
+
+    return TRUE;
+
+}
+
+/*************************************************/
+
+
+void
+CHardwareSimulation::
+FakeHardware (
+    )
+
+/*++
+
+Routine Description:
+
+    Simulate an interrupt and what the hardware would have done in the
+    time since the previous interrupt.
+
+Arguments:
+
+    None
+
+Return Value:
+
+    None
+
+--*/
+
+{
+
+    m_InterruptTime++;
+
+    m_Trace.Record (
+        AvshwsTraceDpc,
+        0,
+        m_InterruptTime,
+        m_ScatterGatherBytesQueued
+        );
+
+	if (m_HardwareState == HardwareRunning)
+	{
+		if (IsCopyMode())
+		{
+			ReadyFrame();
+		}
+		else
+		{
+			ConvertFrameRate();
+
+			FillScatterGatherBuffers();
+		}
+	}
+
+    //
+    // Issue an interrupt to our hardware sink.  This is a "fake" interrupt.
+    // It will occur at DISPATCH_LEVEL.
     //
-    // If I could just remap physical in the list to virtual easily here,
-    // I wouldn't need to do it.
+    m_HardwareSink -> Interrupt ();
+
     //
-    do
-    {
-        PSCATTER_GATHER_ENTRY Entry =
-            reinterpret_cast <PSCATTER_GATHER_ENTRY> (
-                ExAllocateFromNPagedLookasideList (
-                    &m_ScatterGatherLookaside
-                    )
-                );
+    // Reschedule the timer if the hardware isn't being stopped.
+    //
+    if (!m_StopHardware) {
+
+        //
+        // Reschedule the timer for the next interrupt time.
+        //
+        LARGE_INTEGER NextTime;
+        NextTime.QuadPart = m_StartTime.QuadPart + 
+            (m_TimePerFrame * (m_InterruptTime + 1));
+
+        KeSetTimer (&m_IsrTimer, NextTime, &m_IsrFakeDpc);
+        
+    } else {
+        //
+        // If someone is waiting on the hardware to stop, raise the stop
+        // event and clear the flag.
+        //
+        m_StopHardware = FALSE;
+        KeSetEvent (&m_HardwareEvent, IO_NO_INCREMENT, FALSE);
+    }
+
+}
+
+
+void CHardwareSimulation::SetData(PVOID data, ULONG dataLength, const AVSHWS_FRAME_HEADER *Header)
+{
+	ULONG Format = Header ? Header->Format : AvshwsFormatRgb24;
+	ULONG InputSize = ConvertFrameSize(Format, m_Width, m_Height);
+
+	if (InputSize == 0 || dataLength < InputSize)
+	{
+		return;
+	}
+
+	//
+	// Between streams, keep the frame to start the next stream of the
+	// same size with.
+	//
+	if (m_HardwareState == HardwareStopped)
+	{
+		HoldFrame(&m_LastFrame, Format, (const UCHAR *)data, (LONG)ConvertLineBytes(Format, m_Width), m_Width, m_Height);
+		return;
+	}
+
+	if (m_HardwareState != HardwareRunning) 
+	{
+		return;
+	}
+
+	LONGLONG InjectTime = QueryPerformanceTime();
+
+	m_Trace.Record(AvshwsTraceSetDataEnter, 0, Format, dataLength);
+
+	//
+	// Without a producer timestamp, the frame is considered captured when
+	// it arrives.
+	//
+	LONGLONG Time;
+	if (Header && (Header->Flags & AVSHWS_FRAME_FLAG_TIMESTAMP_VALID))
+	{
+		Time = Header->Timestamp;
+	}
+	else
+	{
+		Time = InjectTime;
+	}
+
+	//
+	// With an output delay the frame goes into the delay line, which
+	// hands it on to the history once it is due.
+	//
+	BOOLEAN Delayed = m_DelayLine.GetDepth() != 0;
+	ULONG NoSlot = Delayed ? DELAY_RING_DEPTH : FRC_HISTORY_DEPTH;
+
+	KIRQL Irql;
+	BOOLEAN Superseded;
+	KeAcquireSpinLock(&m_FrameLock, &Irql);
+	ULONG Slot = Delayed ?
+		m_DelayLine.AcquireWriteSlot(&Superseded) :
+		m_History.AcquireWriteSlot(&Superseded);
+	KeReleaseSpinLock(&m_FrameLock, Irql);
+
+	m_Drops.Store(Superseded, Slot != NoSlot);
+
+	if (Slot == NoSlot)
+	{
+		if (m_Trace.IsEnabled())
+		{
+			m_Trace.Record(AvshwsTraceSetDataExit, 0, (ULONG)(QueryPerformanceTime() - InjectTime), 0);
+		}
+
+		return;
+	}
+
+	ULONG BytesPerPixel = ConvertLineBytes(m_StagingFormat, 1);
+
+	//
+	// Convert the frame into the slot in the staging format: the format
+	// the capture pin delivers, or NV12.  A frame already in that format
+	// is just copied.
+	//
+	PUCHAR TopRow;
+	LONG Stride;
+	GetStagingLayout(
+		Delayed ? m_DelayLine.GetBuffer(Slot) : m_History.GetBuffer(Slot),
+		&TopRow,
+		&Stride
+		);
+
+	ConvertFrame(
+		Format,
+		(const UCHAR *)data,
+		m_StagingFormat,
+		TopRow,
+		Stride,
+		m_Width,
+		m_Height
+		);
+
+	//
+	// For P010 and NV12 the code is stamped into the luma plane.
+	//
+	if (m_ProbeEnabled && m_Width >= PROBE_CODE_WIDTH && m_Height >= PROBE_CODE_HEIGHT)
+	{
+		PROBE_CODE Code;
+		Code.FrameId = (ULONG)InterlockedIncrement(&m_ProbeFrameId);
+		Code.Timestamp = InjectTime;
+
+		ProbeStamp(TopRow, Stride, BytesPerPixel, &Code);
+	}
+
+	//
+	// Publish the slot (and its header) only after the pixels are in, so
+	// the DPC never pairs a timestamp with the wrong frame.
+	//
+	ULONG Generation = 0;
+	KeAcquireSpinLock(&m_FrameLock, &Irql);
+	if (Delayed)
+	{
+		m_DelayLine.Publish(Slot, Time, Header);
+	}
+	else
+	{
+		m_History.Publish(Slot, Time, Header);
+		Generation = m_History.GetSequence();
+	}
+	m_Watchdog.Inject(InjectTime);
+	KeReleaseSpinLock(&m_FrameLock, Irql);
+
+	if (m_Trace.IsEnabled())
+	{
+		m_Trace.Record(AvshwsTraceSetDataExit, Generation, (ULONG)(QueryPerformanceTime() - InjectTime), Delayed);
+	}
+}
+
+/*************************************************/
+
+
+void
+CHardwareSimulation::
+AllocateDelayRing (
+    )
+
+/*++
+
+Routine Description:
+
+    Size the output delay line for the stream being started: enough
+    frames for the requested delay at the rate frames are injected, as
+    far as the memory budget allows.  That is the rate measured on earlier
+    streams if it was faster than DELAY_INPUT_PERIOD_MIN or the stream's
+    frame rate, whichever is faster, since the producer may inject faster
+    than the stream outputs.  Buffers of an earlier stream are reused if
+    they have the staged frame size; surplus ones are freed.  If memory
+    runs short the ring is shorter, which shortens the delay it can give.
+    Attaching the ring takes the frame lock, so it isn't pageable.
+
+Arguments:
+
+    None
+
+Return Value:
+
+    None
+
+--*/
+
+{
+
+    LONGLONG Delay = (LONGLONG)m_OutputDelay * 10000;
+    ULONG BudgetFrames = (ULONG)(
+        ((ULONGLONG)m_DelayBudget * 1024) / m_StagingSize
+        );
+
+    LONGLONG InputPeriod = m_TimePerFrame < DELAY_INPUT_PERIOD_MIN ?
+        m_TimePerFrame : DELAY_INPUT_PERIOD_MIN;
+    LONGLONG Measured = m_DelayLine.GetMeasuredPeriod ();
+
+    if (Measured && Measured < InputPeriod) {
+        InputPeriod = Measured;
+    }
+
+    ULONG Depth = CDelayLine::DepthFor (
+        Delay,
+        InputPeriod,
+        m_TimePerFrame,
+        BudgetFrames
+        );
+
+    if (m_DelayBufferSize != m_StagingSize) {
+        FreeDelayBuffers ();
+    }
+
+    while (m_DelayBufferCount > Depth) {
+        m_DelayBufferCount--;
+        ExFreePool (m_DelayBuffers [m_DelayBufferCount]);
+        m_DelayBuffers [m_DelayBufferCount] = NULL;
+    }
+
+    while (m_DelayBufferCount < Depth) {
+
+        PUCHAR Buffer = reinterpret_cast <PUCHAR> (
+            ExAllocatePoolWithTag (
+                NonPagedPoolNx,
+                m_StagingSize,
+                AVSHWS_POOLTAG
+                )
+            );
+
+        if (!Buffer) {
+            break;
+        }
+
+        m_DelayBuffers [m_DelayBufferCount++] = Buffer;
+
+    }
+
+    m_DelayBufferSize = m_DelayBufferCount ? m_StagingSize : 0;
+
+    if (Depth > m_DelayBufferCount) {
+        Depth = m_DelayBufferCount < 3 ? 0 : m_DelayBufferCount;
+    }
+
+    KIRQL Irql;
+
+    KeAcquireSpinLock (&m_FrameLock, &Irql);
+
+    for (ULONG Slot = 0; Slot < DELAY_RING_DEPTH; Slot++) {
+        m_DelayLine.SetBuffer (Slot, Slot < Depth ? m_DelayBuffers [Slot] : NULL);
+    }
+
+    m_DelayLine.Reset (Depth, Delay, InputPeriod, m_TimePerFrame);
+
+    KeReleaseSpinLock (&m_FrameLock, Irql);
+
+}
+
+/*************************************************/
+
+
+void
+CHardwareSimulation::
+SetOutputDelay (
+    IN ULONG Delay,
+    IN ULONG Budget
+    )
+
+/*++
+
+Routine Description:
+
+    Set the output delay and the memory budget of the delay line.  A
+    running stream starts slewing to the new delay, as far as its ring
+    covers it; the budget sizes the ring at the next Start.  Takes the
+    frame lock, so it isn't pageable.
+
+Arguments:
+
+    Delay -
+        The delay in milliseconds
+
+    Budget -
+        The memory budget in kilobytes
+
+Return Value:
+
+    None
+
+--*/
+
+{
+
+    KIRQL Irql;
+
+    m_OutputDelay = Delay;
+    m_DelayBudget = Budget;
+
+    KeAcquireSpinLock (&m_FrameLock, &Irql);
+    m_DelayLine.SetTargetDelay ((LONGLONG)Delay * 10000);
+    KeReleaseSpinLock (&m_FrameLock, Irql);
+
+}
+
+/*************************************************/
+
+
+void
+CHardwareSimulation::
+GetOutputDelay (
+    OUT PAVSHWS_OUTPUT_DELAY OutputDelay
+    )
+
+/*++
+
+Routine Description:
+
+    Report the output delay settings and the state of the delay line.
+    Takes the frame lock, so it isn't pageable.
+
+Arguments:
+
+    OutputDelay -
+        Receives the settings, the delay applied now and the depth of the
+        running stream's ring
+
+Return Value:
+
+    None
+
+--*/
+
+{
+
+    KIRQL Irql;
+
+    OutputDelay -> Size = sizeof (AVSHWS_OUTPUT_DELAY);
+    OutputDelay -> Delay = m_OutputDelay;
+    OutputDelay -> MemoryBudget = m_DelayBudget;
+    OutputDelay -> CurrentDelay = 0;
+    OutputDelay -> Depth = 0;
+
+    KeAcquireSpinLock (&m_FrameLock, &Irql);
+
+    if (m_HardwareState != HardwareStopped) {
+        OutputDelay -> CurrentDelay =
+            (ULONG)(m_DelayLine.GetDelay () / 10000);
+        OutputDelay -> Depth = m_DelayLine.GetDepth ();
+    }
+
+    KeReleaseSpinLock (&m_FrameLock, Irql);
+
+}
+
+/*************************************************/
+
+
+void
+CHardwareSimulation::
+GetDeliveredFrameHeader (
+    OUT PAVSHWS_FRAME_HEADER Header
+    )
+{
+    KIRQL Irql;
+
+    KeAcquireSpinLock (&m_FrameLock, &Irql);
+    *Header = m_DeliveredHeader;
+    KeReleaseSpinLock (&m_FrameLock, Irql);
+}
+
+/*************************************************/
+
+
+BOOLEAN
+CHardwareSimulation::
+HoldNewestFrame (
+    OUT PFRC_SELECTION Selection,
+    OUT PSTREAM_POINTER_CONTEXT Context
+    )
+
+/*++
+
+Routine Description:
+
+    Hold the newest injected frame in the frame history for reading, so
+    the producer writes its next frames elsewhere, and tag Context with
+    its capture instant and generation.  Takes the frame lock, so it
+    isn't pageable.
+
+Arguments:
+
+    Selection -
+        Receives the held slot, for ReleaseHeldFrame
+
+    Context -
+        Receives the capture instant and the generation of the frame
+
+Return Value:
+
+    Whether a frame is held.  There is none until the producer injects a
+    frame after the stream starts.
+
+--*/
+
+{
+
+    KIRQL Irql;
+
+    KeAcquireSpinLock (&m_FrameLock, &Irql);
+
+    BOOLEAN Held = m_History.HoldNewest (Selection);
+
+    if (Held) {
+
+        const AVSHWS_FRAME_HEADER *Header =
+            m_History.GetHeader (Selection -> Earlier);
+
+        Context -> ProducerTimeValid =
+            (Header -> Flags & AVSHWS_FRAME_FLAG_TIMESTAMP_VALID) != 0;
+        Context -> ProducerTime = Header -> Timestamp;
+        Context -> Generation =
+            m_History.GetSlotSequence (Selection -> Earlier);
+        Context -> Tick = m_InterruptTime;
+
+    }
 
-        if (!Entry) {
-            break;
-        }
-        Entry -> Virtual    = *Buffer;
-        Entry -> ByteCount  = MappingsCount;
-        Entry -> CloneEntry = Clone;
+    KeReleaseSpinLock (&m_FrameLock, Irql);
 
-        //
-        // Move forward a specific number of bytes in chunking this into
-        // mapping sized va buffers.
-        //
-        *Buffer += MappingsCount;
-        Mappings = reinterpret_cast <PKSMAPPING> (
-            (reinterpret_cast <PUCHAR> (Mappings) + MappingStride)
-            );
+    return Held;
 
-        InsertTailList (&m_ScatterGatherMappings, &(Entry -> ListEntry));
-        MappingsInserted = MappingsCount;
-        m_ScatterGatherMappingsQueued++;
-        m_ScatterGatherBytesQueued += MappingsCount;
+}
 
-   }
-    while(FALSE);
+/*************************************************/
 
-    KeReleaseSpinLock (&m_ListLock, Irql);
 
-    return MappingsInserted;
+void
+CHardwareSimulation::
+ReleaseHeldFrame (
+    IN PFRC_SELECTION Selection
+    )
+
+/*++
+
+Routine Description:
+
+    Give back a frame held with HoldNewestFrame.  Takes the frame lock, so
+    it isn't pageable.
+
+Arguments:
+
+    Selection -
+        The held slot
+
+Return Value:
+
+    None
+
+--*/
+
+{
+
+    KIRQL Irql;
+
+    KeAcquireSpinLock (&m_FrameLock, &Irql);
+    m_History.Release (Selection);
+    KeReleaseSpinLock (&m_FrameLock, Irql);
 
 }
 
 /*************************************************/
 
-
-NTSTATUS
+
+void
 CHardwareSimulation::
-FillScatterGatherBuffers (
+GetStatistics (
+    OUT PAVSHWS_STATISTICS Statistics
     )
 
 /*++
 
 Routine Description:
 
-    The hardware has synthesized a buffer in scratch space and we're to
-    fill scatter / gather buffers.
+    Snapshot the frame accounting counters.  Each counter is read
+    atomically; the set is not a consistent snapshot across counters,
+    which is fine for monitoring.
 
 Arguments:
 
+    Statistics -
+        Receives the counters
+
+Return Value:
+
     None
 
+--*/
+
+{
+
+    Statistics -> Size = sizeof (AVSHWS_STATISTICS);
+    m_Drops.GetStatistics (Statistics);
+    Statistics -> StartTime = m_StartDuration;
+    Statistics -> TimeToFirstFrame = m_TimeToFirstFrame;
+    Statistics -> FrameBufferAllocations = m_FramePool.GetAllocations ();
+    Statistics -> NoSignalSwitches = m_Watchdog.GetSwitches ();
+    Statistics -> NoSignal = m_Watchdog.IsNoSignal ();
+
+}
+
+/*************************************************/
+
+
+void
+CHardwareSimulation::
+ReleaseDelayedFrames (
+    IN LONGLONG Now
+    )
+
+/*++
+
+Routine Description:
+
+    Move the frames of the delay line that are due into the frame
+    history, as if they had been captured the current delay later, and
+    slew the delay a step toward its target.  Called at the tick before
+    the history is selected from.
+
+Arguments:
+
+    Now -
+        The tick time
+
 Return Value:
 
-    Success / Failure
+    None
 
 --*/
 
 {
 
-    //
-    // We're using this list lock to protect our scatter / gather lists instead
-    // of some hardware mechanism / KeSynchronizeExecution / whatever.
-    //
-    KeAcquireSpinLockAtDpcLevel (&m_ListLock);
+    if (m_DelayLine.GetDepth () == 0) {
+        return;
+    }
 
-    PUCHAR Buffer = reinterpret_cast <PUCHAR> (m_SynthesisBuffer);
-    ULONG BufferRemaining = m_ImageSize;
+    KeAcquireSpinLockAtDpcLevel (&m_FrameLock);
 
-    //
-    // For simplification, if there aren't enough scatter / gather buffers
-    // queued, we don't partially fill the ones that are available.  We just
-    // skip the frame and consider it starvation.
-    //
-    // This could be enforced by only programming scatter / gather mappings
-    // for a buffer if all of them fit in the table also...
-    //
-    while (BufferRemaining &&
-        m_ScatterGatherMappingsQueued > 0 &&
-        m_ScatterGatherBytesQueued >= BufferRemaining) {
+    m_DelayLine.Slew (m_TimePerFrame / DELAY_SLEW_DIVISOR);
 
-        LIST_ENTRY *listEntry = RemoveHeadList (&m_ScatterGatherMappings);
-        m_ScatterGatherMappingsQueued--;
+    for (;;) {
 
-        PSCATTER_GATHER_ENTRY SGEntry =  
-            reinterpret_cast <PSCATTER_GATHER_ENTRY> (
-                CONTAINING_RECORD (
-                    listEntry,
-                    SCATTER_GATHER_ENTRY,
-                    ListEntry
-                    )
+        ULONG From = m_DelayLine.TakeDue (Now);
+
+        if (From == DELAY_RING_DEPTH) {
+            break;
+        }
+
+        BOOLEAN Superseded;
+        ULONG To = m_History.AcquireWriteSlot (&Superseded);
+
+        m_Drops.Store (Superseded, To != FRC_HISTORY_DEPTH);
+
+        if (To != FRC_HISTORY_DEPTH) {
+
+            //
+            // Both slots are claimed, so the copy can run unlocked.
+            //
+            KeReleaseSpinLockFromDpcLevel (&m_FrameLock);
+
+            RtlCopyMemory (
+                m_History.GetBuffer (To),
+                m_DelayLine.GetBuffer (From),
+                m_StagingSize
                 );
 
-        //
-        // Since we're software, we'll be accessing this by virtual address...
-        //
-        ULONG BytesToCopy = 
-            (BufferRemaining < SGEntry -> ByteCount) ?
-            BufferRemaining :
-            SGEntry -> ByteCount;
+            KeAcquireSpinLockAtDpcLevel (&m_FrameLock);
 
-        LONG Width = m_Width*(m_ImageSynth->GetBytesPerPixel());
+            LONGLONG Delay = m_DelayLine.GetDelay ();
+            AVSHWS_FRAME_HEADER Header = *m_DelayLine.GetHeader (From);
 
-        LONG Stride = Width;
-        if(SGEntry->CloneEntry->StreamHeader->Size >= sizeof(KSSTREAM_HEADER)+sizeof(KS_FRAME_INFO))
-        {
-            PKS_FRAME_INFO FrameInfo = reinterpret_cast <PKS_FRAME_INFO> (SGEntry->CloneEntry->StreamHeader+1);
-            if(FrameInfo->lSurfacePitch != 0)
-            {
-                Stride = FrameInfo->lSurfacePitch;
-                if(FrameInfo->lSurfacePitch < 0)
-                {
-                    Stride = -Stride;
-                }
+            if (Header.Flags & AVSHWS_FRAME_FLAG_TIMESTAMP_VALID) {
+                Header.Timestamp += Delay;
             }
-        }
 
-        for(ULONG y = 0; y < m_Height; y++)
-        {
-            RtlCopyMemory((SGEntry->Virtual+(ULONG)Stride*y), Buffer, Width);
-            Buffer += Width;
-            BytesToCopy -= Width;
-            BufferRemaining -= Width;
-        }
+            m_History.Publish (To, m_DelayLine.GetTime (From) + Delay, &Header);
 
-        m_NumMappingsCompleted++;
-        m_ScatterGatherBytesQueued -= SGEntry -> ByteCount;
+        }
 
-        //
-        // Release the scatter / gather entry back to our lookaside.
-        //
-        ExFreeToNPagedLookasideList (
-            &m_ScatterGatherLookaside,
-            reinterpret_cast <PVOID> (SGEntry)
-            );
+        m_DelayLine.Release (From);
 
     }
-    
-    KeReleaseSpinLockFromDpcLevel (&m_ListLock);
 
-    if (BufferRemaining) return STATUS_INSUFFICIENT_RESOURCES;
-    else return STATUS_SUCCESS;
-    
+    KeReleaseSpinLockFromDpcLevel (&m_FrameLock);
+
 }
 
 /*************************************************/
 
-
+
 void
 CHardwareSimulation::
-FakeHardware (
+ConvertFrameRate (
     )
 
 /*++
 
 Routine Description:
 
-    Simulate an interrupt and what the hardware would have done in the
-    time since the previous interrupt.
+    Produce the synthesis buffer for this tick from the frame history.
+    The output time lags the tick by one frame period so that, for
+    producers running at a different rate, there is normally a frame on
+    either side of it to pick from or blend.
 
 Arguments:
 
@@ -757,71 +2747,173 @@ Return Value:
 
 {
 
-    m_InterruptTime++;
+    FRC_SELECTION Selection;
+    LONGLONG Now = QueryPerformanceTime ();
+    LONGLONG OutputTime = Now - m_TimePerFrame;
 
-	if (m_HardwareState == HardwareRunning)
-	{
-		RtlCopyMemory(m_SynthesisBuffer, m_TemporaryBuffer, m_ImageSize);
+    ReleaseDelayedFrames (Now);
 
-		if (!NT_SUCCESS(FillScatterGatherBuffers())) {
-			InterlockedIncrement(PLONG(&m_NumFramesSkipped));
-		}
-	}
+    KeAcquireSpinLockAtDpcLevel (&m_FrameLock);
 
     //
-    // Issue an interrupt to our hardware sink.  This is a "fake" interrupt.
-    // It will occur at DISPATCH_LEVEL.
+    // The watchdog: with no frame injected for the timeout, the producer
+    // is taken to be gone and the no signal slate is delivered until it
+    // injects again.  There is nothing new in the history to select then.
     //
-    m_HardwareSink -> Interrupt ();
+    ULONG Sequence = m_History.GetSequence ();
+    BOOLEAN NoSignal = m_Watchdog.Check (Now, m_NoSignalReady);
+    BOOLEAN Selected = !NoSignal &&
+        m_History.Select (m_FrcMode, OutputTime, &Selection);
+
+    KeReleaseSpinLockFromDpcLevel (&m_FrameLock);
+
+    m_Drops.Tick (Sequence);
 
     //
-    // Reschedule the timer if the hardware isn't being stopped.
+    // Nothing injected yet, or no signal: keep what is in the synthesis
+    // buffer.
     //
-    if (!m_StopHardware) {
-
-        //
-        // Reschedule the timer for the next interrupt time.
-        //
-        LARGE_INTEGER NextTime;
-        NextTime.QuadPart = m_StartTime.QuadPart + 
-            (m_TimePerFrame * (m_InterruptTime + 1));
+    if (!Selected) {
+        return;
+    }
 
-        KeSetTimer (&m_IsrTimer, NextTime, &m_IsrFakeDpc);
-        
+    if (Selection.Weight && m_StagingFormat == AvshwsFormatP010) {
+        FrcBlend16 (
+            (PUSHORT)m_SynthesisBuffer,
+            (const USHORT *)m_History.GetBuffer (Selection.Earlier),
+            (const USHORT *)m_History.GetBuffer (Selection.Later),
+            m_StagingSize / sizeof (USHORT),
+            Selection.Weight
+            );
+    } else if (Selection.Weight) {
+        FrcBlend (
+            m_SynthesisBuffer,
+            m_History.GetBuffer (Selection.Earlier),
+            m_History.GetBuffer (Selection.Later),
+            m_StagingSize,
+            Selection.Weight
+            );
     } else {
-        //
-        // If someone is waiting on the hardware to stop, raise the stop
-        // event and clear the flag.
-        //
-        m_StopHardware = FALSE;
-        KeSetEvent (&m_HardwareEvent, IO_NO_INCREMENT, FALSE);
+        RtlCopyMemory (
+            m_SynthesisBuffer,
+            m_History.GetBuffer (Selection.Earlier),
+            m_StagingSize
+            );
+    }
+
+    KeAcquireSpinLockAtDpcLevel (&m_FrameLock);
+
+    m_SynthesisHeader = *m_History.GetHeader (Selection.Earlier);
+    m_SynthesisGeneration = m_History.GetSlotSequence (Selection.Earlier);
+
+    //
+    // A blended frame represents the output time itself.  Only claim a
+    // producer timestamp if both sources had one.
+    //
+    if (Selection.Weight) {
+        if ((m_History.GetHeader (Selection.Later) -> Flags &
+                AVSHWS_FRAME_FLAG_TIMESTAMP_VALID) == 0) {
+            m_SynthesisHeader.Flags &= ~AVSHWS_FRAME_FLAG_TIMESTAMP_VALID;
+        }
+        m_SynthesisHeader.Timestamp = Selection.Time;
+    }
+
+    m_History.Release (&Selection);
+
+    KeReleaseSpinLockFromDpcLevel (&m_FrameLock);
+
+}
+
+/*************************************************/
+
+
+void
+CHardwareSimulation::
+GetStagingLayout (
+    IN PUCHAR Buffer,
+    OUT PUCHAR *TopRow,
+    OUT PLONG Stride
+    )
+
+/*++
+
+Routine Description:
+
+    Find the displayed top row and the row stride of a staged frame.
+    RGB24 and RGB32 are bottom-up DIBs, so the displayed top row is the
+    last one; P010 and NV12 are top-down.
+
+Arguments:
+
+    Buffer -
+        The synthesis buffer or a frame history buffer
+
+    TopRow -
+        Receives the displayed top row
+
+    Stride -
+        Receives the signed distance in bytes from one displayed row to
+        the next
+
+Return Value:
+
+    None
+
+--*/
+
+{
+
+    ULONG RowBytes = ConvertLineBytes (m_StagingFormat, m_Width);
+
+    *TopRow = Buffer;
+    *Stride = (LONG)RowBytes;
+
+    if (m_StagingFormat != AvshwsFormatP010 &&
+        m_StagingFormat != AvshwsFormatNv12) {
+        *TopRow = Buffer + RowBytes * (m_Height - 1);
+        *Stride = -*Stride;
     }
 
 }
 
+/*************************************************/
+
+
+void
+CHardwareSimulation::
+FreeFrameBuffers (
+    )
+
+/*++
+
+Routine Description:
+
+    Give the synthesis buffer and the frame history buffers back to the
+    frame pool.  The hardware must not be running.
+
+Arguments:
+
+    None
+
+Return Value:
+
+    None
+
+--*/
 
-void CHardwareSimulation::SetData(PVOID data, ULONG dataLength)
 {
-	if (m_HardwareState != HardwareRunning) 
-	{
-		return;
-	}
 
-	if (m_TemporaryBuffer == NULL)
-	{
-		return;
-	}
+    if (!m_SynthesisBuffer) {
+        return;
+    }
 
-	if (dataLength < m_Width * m_Height * 3)
-	{
-		return;
-	}
+    m_SynthesisBuffer = NULL;
 
-	for (ULONG y = 0; y < m_Height; y++)
-	{
-		PUCHAR buffer = m_TemporaryBuffer + ((m_Width * 3) * (m_Height - 1 - y));
-		PUCHAR dataLine = (PUCHAR)(data) + ((m_Width * 3) * y);
+    for (ULONG Slot = 0; Slot < FRC_HISTORY_DEPTH; Slot++) {
+        m_History.SetBuffer (Slot, NULL);
+    }
+
+    m_History.Reset ();
+    m_FramePool.Release ();
 
-		RtlCopyMemory(buffer, dataLine, m_Width * 3);
-	}
 }
@@ -51,6 +51,52 @@ typedef struct _SCATTER_GATHER_ENTRY {
 
 } SCATTER_GATHER_ENTRY, *PSCATTER_GATHER_ENTRY;
 
+//
+// HELD_FRAME:
+//
+// A frame kept at device scope, between streams, to start the next stream
+// with.  The pixels are a tightly packed, top-down Width x Height frame in
+// Format, like an injected frame.  The buffer only grows.
+//
+typedef struct _HELD_FRAME {
+
+    PUCHAR Buffer;
+    ULONG BufferSize;
+    ULONG Format;
+    ULONG Width;
+    ULONG Height;
+    BOOLEAN Valid;
+
+} HELD_FRAME, *PHELD_FRAME;
+
+//
+// PREVIEW_FRAME_COUNT:
+//
+// The number of preview sizes scaled frames are kept for at a time.
+//
+#define PREVIEW_FRAME_COUNT 2
+
+//
+// PREVIEW_FRAME:
+//
+// The newest injected frame downscaled for the preview pins, one per
+// preview size, so that every pin of that size shares one scale of each
+// frame.  The pixels are a tightly packed Width x Height frame in the
+// staging format, in the row order of the history it was scaled from.
+// Sequence is the history sequence of the frame it was scaled from.
+//
+typedef struct _PREVIEW_FRAME {
+
+    PUCHAR Buffer;
+    PULONG Accumulator;
+    ULONG Format;
+    ULONG Width;
+    ULONG Height;
+    ULONG Sequence;
+    BOOLEAN Valid;
+
+} PREVIEW_FRAME, *PPREVIEW_FRAME;
+
 //
 // CHardwareSimulation:
 //
@@ -76,10 +122,51 @@ private:
     //
     PUCHAR m_SynthesisBuffer;
 
-	//
-	// A temporary frame buffer;
-	//
-	PUCHAR m_TemporaryBuffer;
+    //
+    // The history of injected frames.  SetData writes each frame into a
+    // slot of the history; at every tick the frame rate converter picks
+    // (or blends) the slot(s) nearest the output time into the synthesis
+    // buffer.  Slot state is guarded by m_FrameLock; the pixels are copied
+    // outside of it (see CFrameHistory).
+    //
+    KSPIN_LOCK m_FrameLock;
+    CFrameHistory m_History;
+    FRC_MODE m_FrcMode;
+
+    //
+    // The output delay line, which injected frames wait in before they are
+    // published into the history (see delay.h), and its buffers.  The ring
+    // is sized at Start for the requested delay (m_OutputDelay, in
+    // milliseconds) within the memory budget (m_DelayBudget, in kilobytes).
+    // Its buffers are kept for the next stream if they are large enough.
+    // Slot state is guarded by m_FrameLock.
+    //
+    CDelayLine m_DelayLine;
+    PUCHAR m_DelayBuffers [DELAY_RING_DEPTH];
+    ULONG m_DelayBufferCount;
+    ULONG m_DelayBufferSize;
+    ULONG m_OutputDelay;
+    ULONG m_DelayBudget;
+
+    //
+    // Latency probe (see probe.h).  When enabled, SetData stamps every
+    // injected frame with the next frame ID and its inject time.
+    //
+    BOOLEAN m_ProbeEnabled;
+    volatile LONG m_ProbeFrameId;
+
+    //
+    // The producer header (timestamp, metadata) of the frame currently in
+    // the synthesis buffer and of the last frame actually delivered.
+    //
+    AVSHWS_FRAME_HEADER m_SynthesisHeader;
+    AVSHWS_FRAME_HEADER m_DeliveredHeader;
+
+    //
+    // The sequence number of the injected frame in the synthesis buffer,
+    // zero if none.  Only used for tracing.
+    //
+    ULONG m_SynthesisGeneration;
 
     //
     // Key information regarding the frames we generate.
@@ -89,6 +176,104 @@ private:
     ULONG m_Height;
     ULONG m_ImageSize;
 
+    //
+    // The AVSHWS_PIXEL_FORMAT of the synthesis buffer and of the frame
+    // history, taken from the synthesizer.  Injected frames are converted
+    // to it once, in SetData.
+    //
+    ULONG m_PixelFormat;
+
+    //
+    // The output frame as rows: the bytes in one row and the number of rows,
+    // counting the chroma rows of a planar format (P010).
+    //
+    ULONG m_LineBytes;
+    ULONG m_Lines;
+
+    //
+    // The format frames are staged in, in the synthesis buffer and the frame
+    // history, and the size of a staged frame.  This is m_PixelFormat unless
+    // NV12 staging was requested (m_Staging), in which case the staged frame
+    // is converted to m_PixelFormat as it is delivered.
+    //
+    AVSHWS_STAGING m_Staging;
+    ULONG m_StagingFormat;
+    ULONG m_StagingSize;
+
+    //
+    // The pool the synthesis buffer and the history come from.  The
+    // simulation lives as long as the device, so the buffers are kept
+    // across Stop and format changes and restarts don't allocate (see
+    // framepool.h).
+    //
+    CFramePool m_FramePool;
+
+    //
+    // The frames a stream starts with instead of black: the last frame of
+    // the previous stream (or the last one injected since it stopped) and
+    // the slate set by the producer.  Only touched at PASSIVE_LEVEL, under
+    // m_HeldLock.  Stills are copied out of the frame history under it too.
+    //
+    FAST_MUTEX m_HeldLock;
+    HELD_FRAME m_LastFrame;
+    HELD_FRAME m_Slate;
+
+    //
+    // The scaled frames of the preview pins, also under m_HeldLock.  They
+    // are invalidated when the stream stops and the buffers are reused for
+    // the next stream of the same preview size.
+    //
+    PREVIEW_FRAME m_PreviewFrames [PREVIEW_FRAME_COUNT];
+    ULONG m_NextPreviewFrame;
+
+    //
+    // Set by Start until the first tick.  The first tick is brought forward
+    // to the moment the consumer has queued a whole frame.
+    //
+    BOOLEAN m_FirstTickPending;
+
+    //
+    // The capture mode requested for the next stream and the one the
+    // current stream runs in.  In copy mode the ticks don't touch the
+    // scatter / gather table: each one leaves a frame ready in the
+    // synthesis buffer (m_FramePending, guarded by m_ListLock like the
+    // table) for the capture pin to copy out with DeliverFrame.  Whether
+    // the no signal slate was chosen for it is kept in m_PendingNoSignal,
+    // the tick that readied it in m_PendingTick.
+    //
+    AVSHWS_CAPTURE_MODE m_CaptureMode;
+    AVSHWS_CAPTURE_MODE m_RunCaptureMode;
+    BOOLEAN m_FramePending;
+    BOOLEAN m_PendingNoSignal;
+    ULONG m_PendingTick;
+
+    //
+    // Set, under m_ListLock, while DeliverFrame copies the ready frame out
+    // of the synthesis buffer outside the lock.  A tick during the copy
+    // sets m_ReadyDeferred instead of rewriting the buffer, and the copy
+    // readies its frame when done.  m_CopyEvent is signaled while no copy
+    // is in progress, for Stop to wait on.
+    //
+    BOOLEAN m_FrameCopying;
+    BOOLEAN m_ReadyDeferred;
+    KEVENT m_CopyEvent;
+
+    //
+    // The producer stall watchdog (see watchdog.h).  While it says the
+    // producer is gone the ticks deliver the no signal slate instead of the
+    // synthesis buffer.  The slate is drawn by the synthesizer in the
+    // delivered layout of m_PixelFormat, so it is delivered by plain copy,
+    // and is only drawn again when a stream starts with another format or
+    // size.  The watchdog is fed and checked under m_FrameLock.
+    //
+    CStallWatchdog m_Watchdog;
+    PUCHAR m_NoSignalBuffer;
+    ULONG m_NoSignalBufferSize;
+    ULONG m_NoSignalFormat;
+    ULONG m_NoSignalWidth;
+    ULONG m_NoSignalHeight;
+    BOOLEAN m_NoSignalReady;
+
     //
     // Scatter gather mappings for the simulated hardware.
     //模拟硬件的分散-聚集映射。
@@ -136,9 +321,20 @@ private:
     ULONG m_ScatterGatherBytesQueued;
 
     //
-    // Number of frames skipped due to lack of scatter / gather mappings.
+    // Frame accounting (see drops.h).  The counters are bumped with
+    // interlocked operations on the DPC path and read without a lock by
+    // GetStatistics.
+    //
+    CDropCounters m_Drops;
+
+    //
+    // Restart timing: the performance time Start was entered at, the time
+    // Start took and the time from then to the first delivered frame
+    // (zero until there is one), in 100ns units.
     //
-    ULONG m_NumFramesSkipped;
+    LONGLONG m_StartPerformanceTime;
+    ULONG m_StartDuration;
+    ULONG m_TimeToFirstFrame;
 
     //
     // The "Interrupt Time".  Number of "fake" interrupts that have occurred
@@ -164,6 +360,11 @@ private:
     //
     IHardwareSink *m_HardwareSink;
 
+    //
+    // The event trace of the frame path (see trace.h).
+    //
+    CEventTrace m_Trace;
+
     //
     // FillScatterGatherBuffers():
     //
@@ -174,12 +375,233 @@ private:
     FillScatterGatherBuffers (
         );
 
+    //
+    // ReadyFrame():
+    //
+    // The copy mode counterpart of ConvertFrameRate and
+    // FillScatterGatherBuffers: produce the synthesis buffer and mark it
+    // ready for the capture pin.
+    //
+    void
+    ReadyFrame (
+        );
+
+    //
+    // PrepareFrame():
+    //
+    // The body of ReadyFrame, also run by DeliverFrame for a tick deferred
+    // behind a copy.  Called with m_ListLock held.
+    //
+    void
+    PrepareFrame (
+        );
+
+    //
+    // WriteFrame():
+    //
+    // Write the frame in Source (the synthesis buffer, a frame history
+    // buffer or the no signal slate) into a consumer buffer at Destination,
+    // laid out by the KS_FRAME_INFO of StreamHeader.
+    //
+    void
+    WriteFrame (
+        IN PUCHAR Destination,
+        IN PKSSTREAM_HEADER StreamHeader,
+        IN PUCHAR Source
+        );
+
+    //
+    // StartFirstTick():
+    //
+    // Run the first tick now rather than a frame period after Start, once
+    // the consumer has a whole frame of buffer queued.  Called with
+    // m_ListLock held.
+    //
+    void
+    StartFirstTick (
+        );
+
+    //
+    // ConvertFrameRate():
+    //
+    // Called at every tick to produce the synthesis buffer from the frame
+    // history according to the frame rate conversion mode.
+    //
+    void
+    ConvertFrameRate (
+        );
+
+    //
+    // ReleaseDelayedFrames():
+    //
+    // Called at every tick to publish the frames which have waited out the
+    // output delay into the frame history.
+    //
+    void
+    ReleaseDelayedFrames (
+        IN LONGLONG Now
+        );
+
+    //
+    // AllocateDelayRing():
+    //
+    // Size the output delay line for the stream being started and attach
+    // its buffers.  Without a delay, or without the memory for one, the
+    // stream runs with no ring.
+    //
+    void
+    AllocateDelayRing (
+        );
+
+    //
+    // FreeDelayBuffers():
+    //
+    // Free the buffers of the output delay line.  The hardware must not be
+    // running.
+    //
+    void
+    FreeDelayBuffers (
+        );
+
+    //
+    // AllocateFrameBuffers():
+    //
+    // Take the synthesis buffer and the frame history buffers, of at least
+    // Size bytes, from the frame pool.
+    //
+    NTSTATUS
+    AllocateFrameBuffers (
+        IN ULONG Size
+        );
+
+    //
+    // GetStagingLayout():
+    //
+    // The displayed top row and the signed row stride of a staged frame in
+    // Buffer: RGB is bottom-up, P010 and NV12 are top-down.
+    //
+    void
+    GetStagingLayout (
+        IN PUCHAR Buffer,
+        OUT PUCHAR *TopRow,
+        OUT PLONG Stride
+        );
+
+    //
+    // HoldFrame():
+    //
+    // Copy a Width x Height frame in Format, whose displayed top row is at
+    // TopRow and whose rows are Stride bytes apart, into Held.
+    //
+    NTSTATUS
+    HoldFrame (
+        IN PHELD_FRAME Held,
+        IN ULONG Format,
+        IN const UCHAR *TopRow,
+        IN LONG Stride,
+        IN ULONG Width,
+        IN ULONG Height
+        );
+
+    //
+    // StageHeldFrame():
+    //
+    // Convert the held frame a new stream starts with into the synthesis
+    // buffer.  Returns FALSE if there is none for the stream's size.
+    //
+    BOOLEAN
+    StageHeldFrame (
+        );
+
+    //
+    // RenderNoSignal():
+    //
+    // Draw the no signal slate for the stream being started, unless the
+    // one drawn for an earlier stream has its format and size.
+    //
+    void
+    RenderNoSignal (
+        );
+
+    //
+    // FreeFrameBuffers():
+    //
+    // Give the synthesis buffer and the frame history buffers back to the
+    // frame pool.
+    //
+    void
+    FreeFrameBuffers (
+        );
+
+    //
+    // HoldNewestFrame():
+    //
+    // Hold the newest injected frame in the frame history for reading and
+    // tag Context with its capture instant and generation.  Returns FALSE
+    // if the producer hasn't injected one since the stream started.
+    //
+    BOOLEAN
+    HoldNewestFrame (
+        OUT PFRC_SELECTION Selection,
+        OUT struct _STREAM_POINTER_CONTEXT *Context
+        );
+
+    //
+    // ReleaseHeldFrame():
+    //
+    // Give back a frame held with HoldNewestFrame.
+    //
+    void
+    ReleaseHeldFrame (
+        IN PFRC_SELECTION Selection
+        );
+
+    //
+    // GetPreviewFrame():
+    //
+    // Find the scaled frame kept for a preview size, or set one up for it.
+    // Called with m_HeldLock held.  Returns NULL if out of memory.
+    //
+    PPREVIEW_FRAME
+    GetPreviewFrame (
+        IN ULONG Width,
+        IN ULONG Height
+        );
+
 public:
 
+    //
+    // GetSkippedFrameCount():
+    //
+    // The number of output frames the consumer missed: ticks without enough
+    // scatter / gather mappings queued to take a whole frame.
+    //
     LONG GetSkippedFrameCount()
     {
-        return InterlockedExchange((LONG*)&this->m_NumFramesSkipped, this->m_NumFramesSkipped);
+        return m_Drops.GetDropCount ();
     }
+
+    //
+    // GetTrace():
+    //
+    // The event trace of the frame path.
+    //
+    CEventTrace *
+    GetTrace (
+        )
+    {
+        return &m_Trace;
+    }
+
+    //
+    // GetStatistics():
+    //
+    // Snapshot the frame accounting counters.
+    //
+    void
+    GetStatistics (
+        OUT PAVSHWS_STATISTICS Statistics
+        );
     //
     // CHardwareSimulation():
     //
@@ -198,6 +620,33 @@ public:
     ~CHardwareSimulation (
         )
     {
+        FreeFrameBuffers ();
+        FreeDelayBuffers ();
+        ExDeleteNPagedLookasideList (&m_ScatterGatherLookaside);
+
+        if (m_LastFrame.Buffer) {
+            ExFreePool (m_LastFrame.Buffer);
+        }
+
+        if (m_Slate.Buffer) {
+            ExFreePool (m_Slate.Buffer);
+        }
+
+        if (m_NoSignalBuffer) {
+            ExFreePool (m_NoSignalBuffer);
+        }
+
+        for (ULONG i = 0; i < PREVIEW_FRAME_COUNT; i++) {
+
+            if (m_PreviewFrames [i].Buffer) {
+                ExFreePool (m_PreviewFrames [i].Buffer);
+            }
+
+            if (m_PreviewFrames [i].Accumulator) {
+                ExFreePool (m_PreviewFrames [i].Accumulator);
+            }
+
+        }
     }
 
     //
@@ -283,6 +732,54 @@ public:
         IN ULONG MappingStride
         );
 
+    //
+    // DeliverFrame():
+    //
+    // In copy mode, copy the ready frame into the buffer of StreamHeader
+    // and tag Context with its capture instant and tick.  A buffer too
+    // small for the frame is left with DataUsed zero.  Returns TRUE if the
+    // buffer is done with either way, FALSE if no frame is ready.
+    //
+    BOOLEAN
+    DeliverFrame (
+        IN PKSSTREAM_HEADER StreamHeader,
+        OUT struct _STREAM_POINTER_CONTEXT *Context
+        );
+
+    //
+    // DeliverStill():
+    //
+    // Copy the newest injected frame into the buffer of StreamHeader for
+    // the still pin, whose format is Format, Width x Height, and tag
+    // Context with its capture instant.  Returns FALSE if there is none
+    // in that format and size.
+    //
+    BOOLEAN
+    DeliverStill (
+        IN PKSSTREAM_HEADER StreamHeader,
+        IN ULONG Format,
+        IN ULONG Width,
+        IN ULONG Height,
+        OUT struct _STREAM_POINTER_CONTEXT *Context
+        );
+
+    //
+    // DeliverPreview():
+    //
+    // Write the newest injected frame, downscaled to Width x Height and in
+    // Format (RGB24 or BGRA), into the buffer of StreamHeader for a preview
+    // pin and tag Context with its capture instant.  Returns FALSE if there
+    // is none.
+    //
+    BOOLEAN
+    DeliverPreview (
+        IN PKSSTREAM_HEADER StreamHeader,
+        IN ULONG Format,
+        IN ULONG Width,
+        IN ULONG Height,
+        OUT struct _STREAM_POINTER_CONTEXT *Context
+        );
+
     //
     // Initialize():
     //
@@ -308,8 +805,171 @@ public:
 	//
 	// SetData();
 	//
-	// Sets the virtual frame buffer of the simulation.
+	// Sets the virtual frame buffer of the simulation.  Header is optional
+	// and carries the producer timestamp and metadata for the frame.
 	//
-	void SetData(PVOID data, ULONG dataLength);
+	void SetData(PVOID data, ULONG dataLength, const AVSHWS_FRAME_HEADER *Header = NULL);
+
+    //
+    // SetSlate():
+    //
+    // Set the image streams of Width x Height start with when there is no
+    // earlier frame to start them with, or clear it (Width or Height zero).
+    //
+    NTSTATUS
+    SetSlate (
+        IN ULONG Format,
+        IN ULONG Width,
+        IN ULONG Height,
+        IN const UCHAR *Data,
+        IN ULONG DataLength
+        );
+
+    //
+    // GetDeliveredFrameHeader():
+    //
+    // Copy out the producer header of the most recently delivered frame.
+    //
+    void
+    GetDeliveredFrameHeader (
+        OUT PAVSHWS_FRAME_HEADER Header
+        );
+
+    //
+    // SetFrcMode():
+    //
+    // Select how injected frames are converted to the output frame rate.
+    //
+    void
+    SetFrcMode (
+        IN FRC_MODE Mode
+        )
+    {
+        m_FrcMode = Mode;
+    }
+
+    FRC_MODE
+    GetFrcMode (
+        )
+    {
+        return m_FrcMode;
+    }
+
+    //
+    // SetStaging():
+    //
+    // Select how injected frames are staged from the next Start on.
+    //
+    void
+    SetStaging (
+        IN AVSHWS_STAGING Staging
+        )
+    {
+        m_Staging = Staging;
+    }
+
+    AVSHWS_STAGING
+    GetStaging (
+        )
+    {
+        return m_Staging;
+    }
+
+    //
+    // SetCaptureMode():
+    //
+    // Select how frames are delivered from the next Start on.
+    //
+    void
+    SetCaptureMode (
+        IN AVSHWS_CAPTURE_MODE Mode
+        )
+    {
+        m_CaptureMode = Mode;
+    }
+
+    AVSHWS_CAPTURE_MODE
+    GetCaptureMode (
+        )
+    {
+        return m_CaptureMode;
+    }
+
+    //
+    // SetOutputDelay():
+    //
+    // Set the output delay in milliseconds, applied gradually to a running
+    // stream within what its ring holds, and the memory budget of the ring
+    // in kilobytes, which sizes the ring from the next Start on.
+    //
+    void
+    SetOutputDelay (
+        IN ULONG Delay,
+        IN ULONG Budget
+        );
+
+    //
+    // GetOutputDelay():
+    //
+    // Report the output delay settings, the delay applied now and the
+    // depth of the running stream's ring.
+    //
+    void
+    GetOutputDelay (
+        OUT PAVSHWS_OUTPUT_DELAY OutputDelay
+        );
+
+    //
+    // IsCopyMode():
+    //
+    // Whether the current stream runs in copy capture mode.
+    //
+    BOOLEAN
+    IsCopyMode (
+        )
+    {
+        return m_RunCaptureMode == AvshwsCaptureCopy;
+    }
+
+    //
+    // SetNoSignalTimeout():
+    //
+    // Set the time without an injected frame after which the stream shows
+    // the no signal slate, in milliseconds, or zero to never show it.
+    //
+    void
+    SetNoSignalTimeout (
+        IN ULONG Timeout
+        )
+    {
+        m_Watchdog.SetTimeout (Timeout);
+    }
+
+    ULONG
+    GetNoSignalTimeout (
+        )
+    {
+        return m_Watchdog.GetTimeout ();
+    }
+
+    //
+    // SetProbeEnabled():
+    //
+    // Turn latency probe stamping of injected frames on or off.
+    //
+    void
+    SetProbeEnabled (
+        IN BOOLEAN Enabled
+        )
+    {
+        m_ProbeEnabled = Enabled;
+    }
+
+    BOOLEAN
+    GetProbeEnabled (
+        )
+    {
+        return m_ProbeEnabled;
+    }
 };
 
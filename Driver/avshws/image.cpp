@@ -23,7 +23,7 @@
 
 **************************************************************************/
 
-#include "avshws.h"
+#include "portable.h"
 
 /**************************************************************************
 
@@ -296,36 +296,133 @@ UCHAR g_FontData [256][8] = {
     {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}
 };
 
+//
+// GLYPH_RUNS:
+//
+// The foreground runs of one font row: Count runs of Length[i] pixels
+// starting Start[i] pixels from the left of the glyph.  A font row is a
+// byte, so there are never more than 4.  At a scaling of n, each run is
+// simply n times as long and starts n times as far in.
+//
+typedef struct _GLYPH_RUNS {
+
+    UCHAR Count;
+    UCHAR Start [4];
+    UCHAR Length [4];
+
+} GLYPH_RUNS, *PGLYPH_RUNS;
+
+//
+// GLYPH_RUN_TABLE:
+//
+// The runs of every possible font row, indexed by the font row byte.  The
+// table is generated by the compiler.
+//
+struct GLYPH_RUN_TABLE {
+
+    GLYPH_RUNS Runs [256];
+
+    constexpr
+    GLYPH_RUN_TABLE (
+        ) :
+        Runs ()
+    {
+        for (ULONG Bits = 0; Bits < 256; Bits++) {
+
+            GLYPH_RUNS &Entry = Runs [Bits];
+            ULONG Count = 0;
+            ULONG x = 0;
+
+            for (ULONG i = 0; i < 4; i++) {
+                Entry.Start [i] = 0;
+                Entry.Length [i] = 0;
+            }
+
+            while (x < 8) {
+
+                if (!(Bits & (0x80 >> x))) {
+                    x++;
+                    continue;
+                }
+
+                ULONG Start = x;
+                while (x < 8 && (Bits & (0x80 >> x))) {
+                    x++;
+                }
+
+                Entry.Start [Count] = (UCHAR)Start;
+                Entry.Length [Count] = (UCHAR)(x - Start);
+                Count++;
+
+            }
+
+            Entry.Count = (UCHAR)Count;
+
+        }
+    }
+
+};
+
+static constexpr GLYPH_RUN_TABLE g_GlyphRuns;
+
+//
+// CHARACTER_SEPARATION:
+//
+// The number of empty pixel columns after each character.  See
+// OverlayText().
+//
+#ifndef NO_CHARACTER_SEPARATION
+    #define CHARACTER_SEPARATION 1
+#else // NO_CHARACTER_SEPARATION
+    #define CHARACTER_SEPARATION 0
+#endif // NO_CHARACTER_SEPARATION
+
 //
 // Standard definition of EIA-189-A color bars.  The actual color definitions
-// are either in CRGB24Synthesizer or CYUVSynthesizer.
+// are generated for each format from g_ColorRgb (see image.h).
 //
 const COLOR g_ColorBars[] = 
     {WHITE, YELLOW, CYAN, GREEN, MAGENTA, RED, BLUE, BLACK};
 
-const UCHAR CRGB24Synthesizer::Colors [MAX_COLOR][3] = {
-    {0, 0, 0},          // BLACK
-    {255, 255, 255},    // WHITE
-    {0, 255, 255},      // YELLOW
-    {255, 255, 0},      // CYAN
-    {0, 255, 0},        // GREEN
-    {255, 0, 255},      // MAGENTA
-    {0, 0, 255},        // RED
-    {255, 0, 0},        // BLUE
-    {128, 128, 128}     // GREY
-};
-
-const UCHAR CYUVSynthesizer::Colors [MAX_COLOR][3] = {
-    {128, 16, 128},     // BLACK
-    {128, 235, 128},    // WHITE
-    {16, 211, 146},     // YELLOW
-    {166, 170, 16},     // CYAN
-    {54, 145, 34},      // GREEN
-    {202, 106, 222},    // MAGENTA
-    {90, 81, 240},      // RED
-    {240, 41, 109},     // BLUE
-    {128, 125, 128},    // GREY
-};
+//
+// The generated tables must keep the levels of the formats: limited range
+// black and white for YUY2, and full scale primaries at the chroma limits.
+//
+static_assert (
+    COLOR_TABLE <RGB24_FORMAT> ().Macropixel [RED][2] == 255 &&
+    COLOR_TABLE <RGB24_FORMAT> ().Macropixel [RED][0] == 0,
+    "RGB24 is stored blue, green, red"
+    );
+
+static_assert (
+    COLOR_TABLE <RGB32_FORMAT> ().Macropixel [RED][2] == 255 &&
+    COLOR_TABLE <RGB32_FORMAT> ().Macropixel [BLACK][3] == 255,
+    "RGB32 is stored blue, green, red, opaque alpha"
+    );
+
+static_assert (
+    COLOR_TABLE <YUY2_FORMAT> ().Macropixel [BLACK][0] == 16 &&
+    COLOR_TABLE <YUY2_FORMAT> ().Macropixel [WHITE][0] == 235 &&
+    COLOR_TABLE <YUY2_FORMAT> ().Macropixel [WHITE][1] == 128 &&
+    COLOR_TABLE <YUY2_FORMAT> ().Macropixel [WHITE][3] == 128,
+    "YUY2 black and white are 16 and 235 with neutral chroma"
+    );
+
+static_assert (
+    COLOR_TABLE <YUY2_FORMAT> ().Macropixel [BLUE][1] == 240 &&
+    COLOR_TABLE <YUY2_FORMAT> ().Macropixel [YELLOW][1] == 16 &&
+    COLOR_TABLE <YUY2_FORMAT> ().Macropixel [RED][3] == 240 &&
+    COLOR_TABLE <YUY2_FORMAT> ().Macropixel [CYAN][3] == 16,
+    "YUY2 chroma spans 16 to 240"
+    );
+
+static_assert (
+    COLOR_TABLE <P010_FORMAT> ().Macropixel [BLACK][0] == 0x00 &&
+    COLOR_TABLE <P010_FORMAT> ().Macropixel [BLACK][1] == 0x10 &&
+    COLOR_TABLE <P010_FORMAT> ().Macropixel [WHITE][0] == 0x00 &&
+    COLOR_TABLE <P010_FORMAT> ().Macropixel [WHITE][1] == 0xEB,
+    "P010 black and white are 64 and 940 in the high bits"
+    );
 
 /**************************************************************************
 
@@ -361,7 +458,6 @@ Return Value:
 --*/
 
 {
-    const COLOR *CurColor = g_ColorBars;
     ULONG ColorCount = SIZEOF_ARRAY (g_ColorBars);
 
     //
@@ -415,6 +511,11 @@ Routine Description:
     if the overlay does not fit.  The image buffer used is the set
     synthesis buffer.
 
+    An opaque overlay is rendered into the text overlay cache, reusing
+    whatever characters are unchanged since the last call, and copied onto
+    the image a row at a time.  A transparent overlay is drawn straight
+    onto the image, one run of foreground pixels at a time.
+
 Arguments:
 
     LocX -
@@ -498,115 +599,364 @@ Return Value:
     }
 
     //
-    // Determine the amount of space available on the synthesis buffer.
-    // We will clip anything that finds itself outside the synthesis buffer.
+    // Determine the amount of the overlay which lands on the synthesis
+    // buffer.  We will clip anything that finds itself outside it.
     //
     ULONG SpaceX = m_Width - LocX;
     ULONG SpaceY = m_Height - LocY;
 
-    //
-    // Set the default cursor position.
-    //
-    GetImageLocation (LocX, LocY);
+    if (SpaceX > LenX) SpaceX = LenX;
+    if (SpaceY > LenY) SpaceY = LenY;
+
+    if (!SpaceX) {
+        return;
+    }
 
     //
-    // Overlay a background color row.
+    // Line 0 and line LenY - 1 of the overlay are the background border.
+    // Each glyph row in between is repeated Scaling times.
     //
-    if (BgColor != TRANSPARENT && SpaceY) {
-        for (ULONG x = 0; x < LenX && x < SpaceX; x++) {
-            PutPixel (BgColor);
+    if (BgColor != TRANSPARENT &&
+        UpdateTextCache (LocX, Scaling, Text, StrLen, LenX, BgColor, FgColor)) {
+
+        PUCHAR Border = m_TextCache.Buffer + 8 * m_TextCache.RowBytes;
+        ULONG CopyBytes = GetPixelOffset (LocX + SpaceX) - GetPixelOffset (LocX);
+
+        for (ULONG y = 0; y < SpaceY; y++) {
+
+            PUCHAR Source = Border;
+            if (y != 0 && y != LenY - 1) {
+                Source = m_TextCache.Buffer +
+                    ((y - 1) / Scaling) * m_TextCache.RowBytes;
+            }
+
+            RtlCopyMemory (GetImageLocation (LocX, LocY + y), Source, CopyBytes);
+
         }
+
+        return;
+
     }
-    LocY++;
-    if (SpaceY) SpaceY--;
 
-    //
-    // Loop across each row of the image.
-    //
-    for (ULONG row = 0; row < 8 && SpaceY; row++) {
-        //
-        // Generate a line.
-        //
-        GetImageLocation (LocX, LocY++);
+    for (ULONG y = 0; y < SpaceY; y++) {
+
+        PUCHAR Line = GetImageLocation (LocX, LocY + y);
 
-        PUCHAR ImageStart = m_Cursor;
+        if (BgColor != TRANSPARENT) {
+            FillSpan (Line, LocX, SpaceX, BgColor);
+        }
 
-        ULONG CurSpaceX = SpaceX;
-        if (CurSpaceX) {
-            PutPixel (BgColor);
-            CurSpaceX--;
+        if (y != 0 && y != LenY - 1) {
+            DrawTextRow (
+                Line,
+                LocX,
+                SpaceX,
+                (y - 1) / Scaling,
+                Text,
+                0,
+                StrLen,
+                Scaling,
+                FgColor
+                );
         }
 
+    }
+
+}
+
+/*************************************************/
+
+
+void
+CImageSynthesizer::
+DrawTextRow (
+    IN PUCHAR RowStart,
+    IN ULONG LocX,
+    IN ULONG ClipX,
+    IN ULONG Row,
+    IN LPSTR Text,
+    IN ULONG FirstChar,
+    IN ULONG CharCount,
+    IN ULONG Scaling,
+    IN COLOR FgColor
+    )
+
+/*++
+
+Routine Description:
+
+    Draw the foreground of one glyph row of a run of characters as spans
+    of FgColor, using the precomputed runs of each font row.
+
+Arguments:
+
+    RowStart -
+        Where overlay column LocX of the row lies.  This may be in the
+        synthesis buffer or the text overlay cache.
+
+    LocX -
+        The image column the overlay begins at
+
+    ClipX -
+        The number of overlay columns which may be drawn
+
+    Row -
+        The glyph row (0 - 7) to draw
+
+    Text -
+        The overlay string
+
+    FirstChar -
+        The index in Text of the first character to draw
+
+    CharCount -
+        The number of characters to draw
+
+    Scaling -
+        The overlay scaling
+
+    FgColor -
+        The foreground color
+
+Return Value:
+
+    None
+
+--*/
+
+{
+
+    ULONG CellWidth = (Scaling << 3) + CHARACTER_SEPARATION;
+    ULONG RowOffset = GetPixelOffset (LocX);
+
+    for (ULONG i = FirstChar; i < FirstChar + CharCount; i++) {
+
         //
-        // Generate the row'th row of the overlay.
+        // Skip the left border column.
         //
-        CurChar = Text;
-        while (CurChar && *CurChar) {
-            
-            UCHAR CharBase = g_FontData [*CurChar++][row];
-            for (ULONG mask = 0x80; mask && CurSpaceX; mask >>= 1) {
-                for (ULONG scale = 0; scale < Scaling && CurSpaceX; scale++) {
-                    if (CharBase & mask) {
-                        PutPixel (FgColor);
-                    } else {
-                        PutPixel (BgColor);
-                    }
-                    CurSpaceX--;
-                }
+        ULONG CharX = 1 + i * CellWidth;
+        if (CharX >= ClipX) {
+            break;
+        }
+
+        const GLYPH_RUNS *Runs =
+            &g_GlyphRuns.Runs [g_FontData [(UCHAR)Text [i]][Row]];
+
+        for (ULONG Run = 0; Run < Runs -> Count; Run++) {
+
+            ULONG x = CharX + Runs -> Start [Run] * Scaling;
+            if (x >= ClipX) {
+                break;
             }
 
-            // 
-            // Separate each character by one space.  Account for the border
-            // space at the end by placing the separator after the last 
-            // character also.
-            //
-            #ifndef NO_CHARACTER_SEPARATION
-                if (CurSpaceX) {
-                    PutPixel (BgColor);
-                    CurSpaceX--;
-                }
-            #endif // NO_CHARACTER_SEPARATION
+            ULONG Count = Runs -> Length [Run] * Scaling;
+            if (Count > ClipX - x) {
+                Count = ClipX - x;
+            }
+
+            FillSpan (
+                RowStart + GetPixelOffset (LocX + x) - RowOffset,
+                LocX + x,
+                Count,
+                FgColor
+                );
 
         }
 
-        //
-        // If there is no separation character defined, account for the
-        // border.
-        // 
-        #ifdef NO_CHARACTER_SEPARATION
-            if (CurSpaceX) {
-                PutPixel (BgColor);
-                CurSpaceX--;
+    }
+
+}
+
+/*************************************************/
+
+
+BOOLEAN
+CImageSynthesizer::
+UpdateTextCache (
+    IN ULONG LocX,
+    IN ULONG Scaling,
+    IN LPSTR Text,
+    IN ULONG Length,
+    IN ULONG LenX,
+    IN COLOR BgColor,
+    IN COLOR FgColor
+    )
+
+/*++
+
+Routine Description:
+
+    Bring the text overlay cache up to date with an opaque overlay.  If
+    the overlay has the same position, scaling, colors and length as the
+    cached one, only the characters which differ are rendered again.
+    Otherwise the whole overlay is rendered.
+
+Arguments:
+
+    LocX -
+        The image column the overlay begins at
+
+    Scaling -
+        The overlay scaling
+
+    Text -
+        The overlay string
+
+    Length -
+        The number of characters in Text
+
+    LenX -
+        The width of the overlay in pixels, border included
+
+    BgColor -
+        The background color.  This may not be TRANSPARENT.
+
+    FgColor -
+        The foreground color
+
+Return Value:
+
+    TRUE if the cache holds the overlay, FALSE if it can't be cached.
+
+--*/
+
+{
+
+    NT_ASSERT (BgColor != TRANSPARENT);
+
+    if (Length > TEXT_CACHE_MAX_LENGTH || Scaling == 0) {
+        return FALSE;
+    }
+
+    ULONG RowOffset = GetPixelOffset (LocX);
+    ULONG RowBytes = GetPixelOffset (LocX + LenX) - RowOffset;
+    ULONG Size = RowBytes * 9;
+
+    if (Size > TEXT_CACHE_MAX_SIZE) {
+        return FALSE;
+    }
+
+    if (m_TextCache.Valid &&
+        m_TextCache.LocX == LocX &&
+        m_TextCache.Scaling == Scaling &&
+        m_TextCache.BgColor == BgColor &&
+        m_TextCache.FgColor == FgColor &&
+        m_TextCache.Length == Length) {
+
+        ULONG CellWidth = (Scaling << 3) + CHARACTER_SEPARATION;
+
+        for (ULONG i = 0; i < Length; i++) {
+
+            if (Text [i] == m_TextCache.Text [i]) {
+                continue;
             }
-        #endif // NO_CHARACTER_SEPARATION
-            
 
-        PUCHAR ImageEnd = m_Cursor;
-        //
-        // Copy the line downward scale times.
-        //
-        for (ULONG scale = 1; scale < Scaling && SpaceY; scale++) {
-            GetImageLocation (LocX, LocY++);
-            RtlCopyMemory (m_Cursor, ImageStart, ImageEnd - ImageStart);
-            SpaceY--;
+            //
+            // Clear the glyph cell and draw the new character over it.
+            // The separator column never changes.
+            //
+            ULONG CharX = 1 + i * CellWidth;
+
+            for (ULONG Row = 0; Row < 8; Row++) {
+
+                PUCHAR RowStart = m_TextCache.Buffer + Row * RowBytes;
+
+                FillSpan (
+                    RowStart + GetPixelOffset (LocX + CharX) - RowOffset,
+                    LocX + CharX,
+                    Scaling << 3,
+                    BgColor
+                    );
+
+                DrawTextRow (
+                    RowStart,
+                    LocX,
+                    LenX,
+                    Row,
+                    Text,
+                    i,
+                    1,
+                    Scaling,
+                    FgColor
+                    );
+
+            }
+
+            m_TextCache.Text [i] = Text [i];
+
         }
 
+        return TRUE;
+
     }
 
     //
-    // Add the bottom section of the overlay.
+    // Render the whole overlay, growing the buffer if needed.
     //
-    GetImageLocation (LocX, LocY);
-    if (BgColor != TRANSPARENT && SpaceY) {
-        for (ULONG x = 0; x < LenX && x < SpaceX; x++) {
-            PutPixel (BgColor);
+    m_TextCache.Valid = FALSE;
+
+    if (Size > m_TextCache.BufferSize) {
+
+        if (m_TextCache.Buffer) {
+            ExFreePool (m_TextCache.Buffer);
+        }
+
+        m_TextCache.BufferSize = 0;
+        m_TextCache.Buffer = reinterpret_cast <PUCHAR> (
+            ExAllocatePoolWithTag (
+                NonPagedPoolNx,
+                Size,
+                AVSHWS_POOLTAG
+                )
+            );
+
+        if (!m_TextCache.Buffer) {
+            return FALSE;
+        }
+
+        m_TextCache.BufferSize = Size;
+
+    }
+
+    for (ULONG Row = 0; Row < 9; Row++) {
+
+        PUCHAR RowStart = m_TextCache.Buffer + Row * RowBytes;
+
+        FillSpan (RowStart, LocX, LenX, BgColor);
+
+        if (Row < 8) {
+            DrawTextRow (
+                RowStart,
+                LocX,
+                LenX,
+                Row,
+                Text,
+                0,
+                Length,
+                Scaling,
+                FgColor
+                );
         }
+
     }
 
+    RtlCopyMemory (m_TextCache.Text, Text, Length);
+
+    m_TextCache.RowBytes = RowBytes;
+    m_TextCache.LocX = LocX;
+    m_TextCache.Scaling = Scaling;
+    m_TextCache.BgColor = BgColor;
+    m_TextCache.FgColor = FgColor;
+    m_TextCache.Length = Length;
+    m_TextCache.Valid = TRUE;
+
+    return TRUE;
+
 }
 
 
 void CImageSynthesizer::CopyBuffer(PVOID data, ULONG dataLength)
 {
-
+	UNREFERENCED_PARAMETER(data);
+	UNREFERENCED_PARAMETER(dataLength);
 }
\ No newline at end of file
@@ -11,7 +11,7 @@
     Abstract:
 
         The image synthesis and overlay header.  These objects provide image
-        synthesis (pixel, color-bar, etc...) onto RGB24 and UYVY buffers as
+        synthesis (pixel, color-bar, etc...) onto RGB24, RGB32 and UYVY buffers as
         well as software string overlay into these buffers.
 
     History:
@@ -48,6 +48,54 @@ typedef enum {
 
 } COLOR;
 
+//
+// g_FontData:
+//
+// The 8x8 bitmapped font of the text overlay, one byte per glyph row, most
+// significant bit leftmost.
+//
+extern UCHAR g_FontData [256][8];
+
+//
+// g_ColorRgb:
+//
+// The definition of each COLOR.  The color tables of every format are
+// generated from this.
+//
+constexpr PIXEL_RGB g_ColorRgb [MAX_COLOR] = {
+    {0, 0, 0},          // BLACK
+    {255, 255, 255},    // WHITE
+    {255, 255, 0},      // YELLOW
+    {0, 255, 255},      // CYAN
+    {0, 255, 0},        // GREEN
+    {255, 0, 255},      // MAGENTA
+    {255, 0, 0},        // RED
+    {0, 0, 255},        // BLUE
+    {128, 128, 128}     // GREY
+};
+
+//
+// COLOR_TABLE:
+//
+// One macropixel of each COLOR in Format, generated by the compiler.
+//
+template <class Format>
+struct COLOR_TABLE {
+
+    UCHAR Macropixel [MAX_COLOR][Format::MacropixelBytes];
+
+    constexpr
+    COLOR_TABLE (
+        ) :
+        Macropixel ()
+    {
+        for (ULONG Color = 0; Color < MAX_COLOR; Color++) {
+            Format::Pack (g_ColorRgb [Color], Macropixel [Color]);
+        }
+    }
+
+};
+
 //
 // POSITION_CENTER:
 //
@@ -56,6 +104,40 @@ typedef enum {
 //
 #define POSITION_CENTER ((ULONG)-1)
 
+//
+// TEXT_CACHE_MAX_LENGTH:
+// TEXT_CACHE_MAX_SIZE:
+//
+// Limits of the text overlay cache.  Longer strings and larger renderings
+// are drawn straight onto the image instead.
+//
+#define TEXT_CACHE_MAX_LENGTH 64
+#define TEXT_CACHE_MAX_SIZE (64 * 1024)
+
+//
+// TEXT_OVERLAY_CACHE:
+//
+// An opaque text overlay rendered once for the text and parameters it was
+// last drawn with.  Buffer holds RowBytes long rows, rendered as they are
+// laid out in the image starting at column LocX: the 8 glyph rows followed
+// by the background border row.
+//
+typedef struct _TEXT_OVERLAY_CACHE {
+
+    PUCHAR Buffer;
+    ULONG BufferSize;
+    ULONG RowBytes;
+
+    BOOLEAN Valid;
+    ULONG LocX;
+    ULONG Scaling;
+    COLOR BgColor;
+    COLOR FgColor;
+    ULONG Length;
+    CHAR Text [TEXT_CACHE_MAX_LENGTH];
+
+} TEXT_OVERLAY_CACHE, *PTEXT_OVERLAY_CACHE;
+
 /*************************************************
 
     CImageSynthesizer
@@ -89,6 +171,48 @@ protected:
     //
     PUCHAR m_Cursor;
 
+    //
+    // The last opaque text overlay.  See OverlayText().
+    //
+    TEXT_OVERLAY_CACHE m_TextCache;
+
+    //
+    // DrawTextRow():
+    //
+    // Draw the foreground of glyph row Row of CharCount characters of Text
+    // starting at FirstChar.  RowStart is where overlay column LocX of the
+    // row lies and nothing at or beyond ClipX pixels from LocX is touched.
+    //
+    void
+    DrawTextRow (
+        IN PUCHAR RowStart,
+        IN ULONG LocX,
+        IN ULONG ClipX,
+        IN ULONG Row,
+        IN LPSTR Text,
+        IN ULONG FirstChar,
+        IN ULONG CharCount,
+        IN ULONG Scaling,
+        IN COLOR FgColor
+        );
+
+    //
+    // UpdateTextCache():
+    //
+    // Bring the text overlay cache up to date with an opaque overlay.
+    // Returns FALSE if the overlay can't be cached.
+    //
+    BOOLEAN
+    UpdateTextCache (
+        IN ULONG LocX,
+        IN ULONG Scaling,
+        IN LPSTR Text,
+        IN ULONG Length,
+        IN ULONG LenX,
+        IN COLOR BgColor,
+        IN COLOR FgColor
+        );
+
 public:
 
     //
@@ -122,6 +246,41 @@ public:
 
     virtual long
     GetBytesPerPixel() = 0;
+
+    //
+    // GetPixelFormat():
+    //
+    // Get the AVSHWS_PIXEL_FORMAT of the synthesized image, which is the
+    // format injected frames are converted to.
+    //
+    virtual ULONG
+    GetPixelFormat (
+        ) = 0;
+
+    //
+    // GetPixelOffset():
+    //
+    // Get the byte offset of column LocX from the start of a row.
+    //
+    virtual ULONG
+    GetPixelOffset (
+        ULONG LocX
+        ) = 0;
+
+    //
+    // FillSpan():
+    //
+    // Place Count pixels of Color starting at column LocX, the first byte
+    // of which is at Location.  Location need not be in the synthesis
+    // buffer; only the column is used to find the pixel layout.
+    //
+    virtual void
+    FillSpan (
+        PUCHAR Location,
+        ULONG LocX,
+        ULONG Count,
+        COLOR Color
+        ) = 0;
         
 
     //
@@ -177,7 +336,9 @@ public:
     //
     // OverlayText():
     //
-    // Overlay a text string onto the image.
+    // Overlay a text string onto the image.  Opaque overlays are cached, so
+    // redrawing a string which changed in a few characters (a clock, say)
+    // renders only those characters and copies the rest.
     //
     void
     OverlayText (
@@ -198,6 +359,7 @@ public:
         m_Height (0),
         m_SynthesisBuffer (NULL)
     {
+        RtlZeroMemory (&m_TextCache, sizeof (m_TextCache));
     }
 
     //
@@ -211,6 +373,7 @@ public:
         m_Height (Height),
         m_SynthesisBuffer (NULL)
     {
+        RtlZeroMemory (&m_TextCache, sizeof (m_TextCache));
     }
 
     //
@@ -220,6 +383,9 @@ public:
     ~CImageSynthesizer (
         )
     {
+        if (m_TextCache.Buffer) {
+            ExFreePool (m_TextCache.Buffer);
+        }
     }
 
 
@@ -229,20 +395,57 @@ public:
 
 /*************************************************
 
-    CRGB24Synthesizer
+    TFormatSynthesizer
 
-    Image synthesizer for RGB24 format.
+    Image synthesizer for any format described by pixel format traits
+    (see pixfmt.h).  Every pixel operation is specialized for the format
+    at compile time.
 
 *************************************************/
 
-class CRGB24Synthesizer : public CImageSynthesizer {
+template <class Format>
+class TFormatSynthesizer : public CImageSynthesizer {
 
-private:
+protected:
 
-    const static UCHAR Colors [MAX_COLOR][3];
+    static constexpr COLOR_TABLE <Format> Colors = COLOR_TABLE <Format> ();
 
+    //
+    // Whether line 0 of the image is at the end of the buffer (bottom-up).
+    //
     BOOLEAN m_FlipVertical;
 
+    //
+    // The pixel of the macropixel the default cursor is at.
+    //
+    ULONG m_Phase;
+
+    //
+    // WritePixel():
+    //
+    // Place pixel Phase of a macropixel of Color at Location and move
+    // past it.
+    //
+    static void
+    WritePixel (
+        PUCHAR *Location,
+        ULONG Phase,
+        COLOR Color
+        )
+    {
+        ULONG Start = Format::PixelOffset (Phase);
+        ULONG End = Format::PixelOffset (Phase + 1);
+
+        if (Color != TRANSPARENT) {
+            const UCHAR *Source = Colors.Macropixel [(ULONG)Color];
+            for (ULONG i = Start; i < End; i++) {
+                *(*Location)++ = Source [i];
+            }
+        } else {
+            *Location += End - Start;
+        }
+    }
+
 public:
 
     //
@@ -257,13 +460,11 @@ public:
         COLOR Color
         )
     {
-        if (Color != TRANSPARENT) {
-            *(*ImageLocation)++ = Colors [(ULONG)Color][0];
-            *(*ImageLocation)++ = Colors [(ULONG)Color][1];
-            *(*ImageLocation)++ = Colors [(ULONG)Color][2];
-        } else {
-            *ImageLocation += 3;
-        }
+        WritePixel (
+            ImageLocation,
+            Format::PixelPhase (*ImageLocation - m_SynthesisBuffer),
+            Color
+            );
     }
 
     //
@@ -277,19 +478,64 @@ public:
         COLOR Color
         )
     {
-        if (Color != TRANSPARENT) {
-            *m_Cursor++ = Colors [(ULONG)Color][0];
-            *m_Cursor++ = Colors [(ULONG)Color][1];
-            *m_Cursor++ = Colors [(ULONG)Color][2];
-        } else {
-            m_Cursor += 3;
-        }
+        WritePixel (&m_Cursor, m_Phase, Color);
+        m_Phase = (m_Phase + 1) % Format::PixelsPerMacropixel;
     }
 
     virtual long
     GetBytesPerPixel () 
     {
-        return 3;
+        return Format::BytesPerPixel;
+    }
+
+    virtual ULONG
+    GetPixelFormat (
+        )
+    {
+        return Format::PixelFormat;
+    }
+
+    virtual ULONG
+    GetPixelOffset (
+        ULONG LocX
+        )
+    {
+        return (LocX / Format::PixelsPerMacropixel) * Format::MacropixelBytes +
+            Format::PixelOffset (LocX % Format::PixelsPerMacropixel);
+    }
+
+    virtual void
+    FillSpan (
+        PUCHAR Location,
+        ULONG LocX,
+        ULONG Count,
+        COLOR Color
+        )
+    {
+        NT_ASSERT (Color != TRANSPARENT);
+
+        const UCHAR *Source = Colors.Macropixel [(ULONG)Color];
+        ULONG Phase = LocX % Format::PixelsPerMacropixel;
+
+        //
+        // Finish the macropixel the span starts in, then write whole
+        // macropixels and finally the start of the one it ends in.
+        //
+        for (; Phase && Count; Count--) {
+            WritePixel (&Location, Phase, Color);
+            Phase = (Phase + 1) % Format::PixelsPerMacropixel;
+        }
+
+        for (; Count >= Format::PixelsPerMacropixel;
+            Count -= Format::PixelsPerMacropixel) {
+            for (ULONG i = 0; i < Format::MacropixelBytes; i++) {
+                *Location++ = Source [i];
+            }
+        }
+
+        for (; Count; Count--) {
+            WritePixel (&Location, Phase++, Color);
+        }
     }
 
     virtual PUCHAR
@@ -298,38 +544,40 @@ public:
         ULONG LocY
         )
     {
-        if (m_FlipVertical) {
-            return (m_Cursor = 
-                (m_SynthesisBuffer + 3 * 
-                    (LocX + (m_Height - 1 - LocY) * m_Width))
-                );
-        } else {
-            return (m_Cursor =
-                (m_SynthesisBuffer + 3 * (LocX + LocY * m_Width))
-                );
-        }
+        ULONG Line = m_FlipVertical ? (m_Height - 1 - LocY) : LocY;
+
+        m_Phase = LocX % Format::PixelsPerMacropixel;
+
+        return (m_Cursor =
+            (m_SynthesisBuffer +
+                Line * (m_Width / Format::PixelsPerMacropixel) *
+                    Format::MacropixelBytes +
+                GetPixelOffset (LocX))
+            );
     }
 
     //
     // DEFAULT CONSTRUCTOR:
     //
-    CRGB24Synthesizer (
+    TFormatSynthesizer (
         BOOLEAN FlipVertical
         ) :
-        m_FlipVertical (FlipVertical)
+        m_FlipVertical (FlipVertical),
+        m_Phase (0)
     {
     }
 
     //
     // CONSTRUCTOR:
     //
-    CRGB24Synthesizer (
+    TFormatSynthesizer (
         BOOLEAN FlipVertical,
         ULONG Width,
         ULONG Height
         ) :
         CImageSynthesizer (Width, Height),
-        m_FlipVertical (FlipVertical)
+        m_FlipVertical (FlipVertical),
+        m_Phase (0)
     {
     }
 
@@ -337,145 +585,156 @@ public:
     // DESTRUCTOR:
     //
     virtual
-    ~CRGB24Synthesizer (
+    ~TFormatSynthesizer (
         )
     {
     }
 
 };
 
+template <class Format>
+constexpr COLOR_TABLE <Format> TFormatSynthesizer <Format>::Colors;
+
 /*************************************************
 
-    CYUVSynthesizer
+    CRGB24Synthesizer
 
-    Image synthesizer for YUV format.
+    Image synthesizer for RGB24 format.  RGB24 images may be bottom-up.
 
 *************************************************/
 
-class CYUVSynthesizer : public CImageSynthesizer {
-
-private:
-
-    const static UCHAR Colors [MAX_COLOR][3];
-
-    BOOLEAN m_Parity;
+class CRGB24Synthesizer : public TFormatSynthesizer <RGB24_FORMAT> {
 
 public:
 
     //
-    // PutPixel():
+    // DEFAULT CONSTRUCTOR:
     //
-    // Place a pixel at a specific cursor location.  *ImageLocation must
-    // reside within the synthesis buffer.
+    CRGB24Synthesizer (
+        BOOLEAN FlipVertical
+        ) :
+        TFormatSynthesizer (FlipVertical)
+    {
+    }
+
     //
-    virtual void
-    PutPixel (
-        PUCHAR *ImageLocation,
-        COLOR Color
-        )
+    // CONSTRUCTOR:
+    //
+    CRGB24Synthesizer (
+        BOOLEAN FlipVertical,
+        ULONG Width,
+        ULONG Height
+        ) :
+        TFormatSynthesizer (FlipVertical, Width, Height)
     {
+    }
 
-        BOOLEAN Parity = (((*ImageLocation - m_SynthesisBuffer) & 0x2) != 0);
+};
 
-#if DBG
-        //
-        // Check that the current pixel points to a valid start pixel
-        // in the UYVY buffer.
-        //
-        BOOLEAN Odd = (((*ImageLocation - m_SynthesisBuffer) & 0x1) != 0);
-        NT_ASSERT ((m_Parity && Odd) || (!m_Parity && !Odd));
-#endif // DBG
+/*************************************************
 
-        if (Color != TRANSPARENT) {
-            if (Parity) {
-                *(*ImageLocation)++ = Colors [(ULONG)Color][2];
-            } else {
-                *(*ImageLocation)++ = Colors [(ULONG)Color][1];
-                *(*ImageLocation)++ = Colors [(ULONG)Color][0];
-                *(*ImageLocation)++ = Colors [(ULONG)Color][1];
-            }
-        } else {
-            *ImageLocation += (Parity ? 1 : 3);
-        }
+    CRGB32Synthesizer
 
-    }
+    Image synthesizer for RGB32 format.  Like RGB24, RGB32 images may be
+    bottom-up.
+
+*************************************************/
+
+class CRGB32Synthesizer : public TFormatSynthesizer <RGB32_FORMAT> {
+
+public:
 
     //
-    // PutPixel():
-    //
-    // Place a pixel at the default cursor location.  The cursor location
-    // must be set via GetImageLocation(x, y).
+    // DEFAULT CONSTRUCTOR:
     //
-    virtual void
-    PutPixel (
-        COLOR Color
-        )
+    CRGB32Synthesizer (
+        BOOLEAN FlipVertical
+        ) :
+        TFormatSynthesizer (FlipVertical)
+    {
+    }
 
+    //
+    // CONSTRUCTOR:
+    //
+    CRGB32Synthesizer (
+        BOOLEAN FlipVertical,
+        ULONG Width,
+        ULONG Height
+        ) :
+        TFormatSynthesizer (FlipVertical, Width, Height)
     {
+    }
 
-        if (Color != TRANSPARENT) {
-            if (m_Parity) {
-                *m_Cursor++ = Colors [(ULONG)Color][2];
-            } else {
-                *m_Cursor++ = Colors [(ULONG)Color][1];
-                *m_Cursor++ = Colors [(ULONG)Color][0];
-                *m_Cursor++ = Colors [(ULONG)Color][1];
-            }
-        } else {
-            m_Cursor += (m_Parity ? 1 : 3);
-        }
+};
 
-        m_Parity = !m_Parity;
+/*************************************************
 
-    }
+    CP010Synthesizer
 
-    virtual long
-    GetBytesPerPixel () 
-    {
-        return 2;
-    }
+    Image synthesizer for P010 format.  Only the luma plane is drawn; the
+    chroma plane which follows it is left as it is (neutral, see
+    ConvertFillBlack), so synthesized P010 images are greyscale.  P010
+    images are always top-down.
 
-    virtual PUCHAR
-    GetImageLocation (
-        ULONG LocX,
-        ULONG LocY
-        )
-    {
-    
-        m_Cursor = m_SynthesisBuffer + ((LocX + LocY * m_Width) << 1);
-        if (m_Parity = ((LocX & 1) != 0)) 
-            m_Cursor++;
+*************************************************/
 
-        return m_Cursor;
-    }
+class CP010Synthesizer : public TFormatSynthesizer <P010_FORMAT> {
+
+public:
 
     //
     // DEFAULT CONSTRUCTOR:
     //
-    CYUVSynthesizer (
-        ) 
+    CP010Synthesizer (
+        ) :
+        TFormatSynthesizer (FALSE)
     {
     }
 
     //
     // CONSTRUCTOR:
     //
-    CYUVSynthesizer (
+    CP010Synthesizer (
         ULONG Width,
         ULONG Height
         ) :
-        CImageSynthesizer (Width, Height)
+        TFormatSynthesizer (FALSE, Width, Height)
     {
     }
 
+};
+
+/*************************************************
+
+    CYUVSynthesizer
+
+    Image synthesizer for YUY2 format.
+
+*************************************************/
+
+class CYUVSynthesizer : public TFormatSynthesizer <YUY2_FORMAT> {
+
+public:
+
     //
-    // DESTRUCTOR:
+    // DEFAULT CONSTRUCTOR:
     //
-    virtual
-    ~CYUVSynthesizer (
-        )
+    CYUVSynthesizer (
+        ) :
+        TFormatSynthesizer (FALSE)
     {
     }
 
-};
+    //
+    // CONSTRUCTOR:
+    //
+    CYUVSynthesizer (
+        ULONG Width,
+        ULONG Height
+        ) :
+        TFormatSynthesizer (FALSE, Width, Height)
+    {
+    }
 
+};
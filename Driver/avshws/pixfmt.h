@@ -0,0 +1,295 @@
+/**************************************************************************
+
+    AVStream Simulated Hardware Sample
+
+    File:
+
+        pixfmt.h
+
+    Abstract:
+
+        Pixel format traits.  Each format the synthesizers produce is
+        described by a traits structure with the following compile time
+        properties:
+
+            PixelFormat             the AVSHWS_PIXEL_FORMAT of the layout
+            PixelsPerMacropixel     pixels which share one group of bytes
+            MacropixelBytes         bytes in that group
+            BytesPerPixel           average bytes per pixel
+            PixelOffset (Phase)     the first byte of pixel Phase of a
+                                    macropixel; PixelOffset of
+                                    PixelsPerMacropixel is MacropixelBytes
+            PixelPhase (Offset)     the pixel of a macropixel whose first
+                                    byte is Offset bytes into the image
+            Pack (Color, Bytes)     a macropixel of one color, converted
+                                    and laid out in the format's order
+
+        The color tables of the image synthesizers are generated from one
+        RGB definition through Pack at compile time (see image.h).
+
+        Nothing in here is evaluated at run time except the offsets.
+
+    History:
+
+        created 10/18/2026
+
+**************************************************************************/
+
+//
+// PIXEL_RGB:
+//
+// An 8 bit per component, full range RGB color.
+//
+typedef struct _PIXEL_RGB {
+
+    UCHAR Red;
+    UCHAR Green;
+    UCHAR Blue;
+
+} PIXEL_RGB, *PPIXEL_RGB;
+
+//
+// BT601:
+//
+// ITU-R BT.601 conversion from full range RGB to limited range YCbCr
+// (Y 16 - 235, Cb and Cr 16 - 240 at 8 bits; the levels scale with the
+// bit depth, to 64 - 940 and 64 - 960 at 10 bits).  The coefficients are
+// in units of 1/10000 and results are rounded to nearest.
+//
+struct BT601 {
+
+    static constexpr LONG Kr = 2990;
+    static constexpr LONG Kb = 1140;
+    static constexpr LONG Kg = 10000 - Kr - Kb;
+
+    static constexpr LONGLONG
+    RoundDivide (
+        LONGLONG Numerator,
+        LONGLONG Denominator
+        )
+    {
+        return Numerator >= 0 ?
+            (Numerator + Denominator / 2) / Denominator :
+            -((-Numerator + Denominator / 2) / Denominator);
+    }
+
+    static constexpr LONG
+    Luma (
+        PIXEL_RGB Color
+        )
+    {
+        return Kr * Color.Red + Kg * Color.Green + Kb * Color.Blue;
+    }
+
+    static constexpr USHORT
+    Y (
+        PIXEL_RGB Color,
+        ULONG Bits = 8
+        )
+    {
+        return (USHORT)((16 << (Bits - 8)) + RoundDivide (
+            (LONGLONG)(219 << (Bits - 8)) * Luma (Color),
+            255 * 10000
+            ));
+    }
+
+    static constexpr USHORT
+    Cb (
+        PIXEL_RGB Color,
+        ULONG Bits = 8
+        )
+    {
+        return (USHORT)((128 << (Bits - 8)) + RoundDivide (
+            (LONGLONG)(112 << (Bits - 8)) * (Color.Blue * 10000 - Luma (Color)),
+            255 * (10000 - Kb)
+            ));
+    }
+
+    static constexpr USHORT
+    Cr (
+        PIXEL_RGB Color,
+        ULONG Bits = 8
+        )
+    {
+        return (USHORT)((128 << (Bits - 8)) + RoundDivide (
+            (LONGLONG)(112 << (Bits - 8)) * (Color.Red * 10000 - Luma (Color)),
+            255 * (10000 - Kr)
+            ));
+    }
+
+};
+
+//
+// RGB24_FORMAT:
+//
+// KS_BI_RGB, 24 bits per pixel: blue, green, red.
+//
+struct RGB24_FORMAT {
+
+    static constexpr ULONG PixelFormat = AvshwsFormatRgb24;
+    static constexpr ULONG PixelsPerMacropixel = 1;
+    static constexpr ULONG MacropixelBytes = 3;
+    static constexpr ULONG BytesPerPixel = 3;
+
+    static constexpr ULONG
+    PixelOffset (
+        ULONG Phase
+        )
+    {
+        return Phase * 3;
+    }
+
+    static constexpr ULONG
+    PixelPhase (
+        ULONG_PTR
+        )
+    {
+        return 0;
+    }
+
+    static constexpr void
+    Pack (
+        PIXEL_RGB Color,
+        UCHAR *Bytes
+        )
+    {
+        Bytes [0] = Color.Blue;
+        Bytes [1] = Color.Green;
+        Bytes [2] = Color.Red;
+    }
+
+};
+
+//
+// RGB32_FORMAT:
+//
+// KS_BI_RGB, 32 bits per pixel: blue, green, red and an unused byte,
+// which is written as opaque alpha for consumers that treat the format
+// as ARGB32.  The same layout as AvshwsFormatBgra.
+//
+struct RGB32_FORMAT {
+
+    static constexpr ULONG PixelFormat = AvshwsFormatBgra;
+    static constexpr ULONG PixelsPerMacropixel = 1;
+    static constexpr ULONG MacropixelBytes = 4;
+    static constexpr ULONG BytesPerPixel = 4;
+
+    static constexpr ULONG
+    PixelOffset (
+        ULONG Phase
+        )
+    {
+        return Phase * 4;
+    }
+
+    static constexpr ULONG
+    PixelPhase (
+        ULONG_PTR
+        )
+    {
+        return 0;
+    }
+
+    static constexpr void
+    Pack (
+        PIXEL_RGB Color,
+        UCHAR *Bytes
+        )
+    {
+        Bytes [0] = Color.Blue;
+        Bytes [1] = Color.Green;
+        Bytes [2] = Color.Red;
+        Bytes [3] = 0xFF;
+    }
+
+};
+
+//
+// YUY2_FORMAT:
+//
+// YUY2: Y0, U, Y1, V for each pair of pixels, BT.601 limited range.
+//
+// A pixel pair has one chroma sample, so a pair is written as a unit by
+// its even pixel (Y0, U and Y1) and completed by its odd pixel (V).  A
+// lone odd pixel therefore only changes the chroma of its pair.
+//
+struct YUY2_FORMAT {
+
+    static constexpr ULONG PixelFormat = AvshwsFormatYuy2;
+    static constexpr ULONG PixelsPerMacropixel = 2;
+    static constexpr ULONG MacropixelBytes = 4;
+    static constexpr ULONG BytesPerPixel = 2;
+
+    static constexpr ULONG
+    PixelOffset (
+        ULONG Phase
+        )
+    {
+        return Phase == 0 ? 0 : Phase == 1 ? 3 : 4;
+    }
+
+    static constexpr ULONG
+    PixelPhase (
+        ULONG_PTR Offset
+        )
+    {
+        return (Offset & 2) ? 1 : 0;
+    }
+
+    static constexpr void
+    Pack (
+        PIXEL_RGB Color,
+        UCHAR *Bytes
+        )
+    {
+        Bytes [0] = (UCHAR)BT601::Y (Color);
+        Bytes [1] = (UCHAR)BT601::Cb (Color);
+        Bytes [2] = (UCHAR)BT601::Y (Color);
+        Bytes [3] = (UCHAR)BT601::Cr (Color);
+    }
+
+};
+
+//
+// P010_FORMAT:
+//
+// The luma plane of P010: 16 bit little endian samples holding BT.601
+// limited range 10 bit luma in their high bits.  P010 is planar 4:2:0;
+// the plane of interleaved Cb, Cr samples of the same form follows the
+// luma plane with the same stride.  Only the luma plane is described
+// here, see CP010Synthesizer.
+//
+struct P010_FORMAT {
+
+    static constexpr ULONG PixelFormat = AvshwsFormatP010;
+    static constexpr ULONG PixelsPerMacropixel = 1;
+    static constexpr ULONG MacropixelBytes = 2;
+    static constexpr ULONG BytesPerPixel = 2;
+
+    static constexpr ULONG
+    PixelOffset (
+        ULONG Phase
+        )
+    {
+        return Phase * 2;
+    }
+
+    static constexpr ULONG
+    PixelPhase (
+        ULONG_PTR
+        )
+    {
+        return 0;
+    }
+
+    static constexpr void
+    Pack (
+        PIXEL_RGB Color,
+        UCHAR *Bytes
+        )
+    {
+        Bytes [0] = (UCHAR)(BT601::Y (Color, 10) << 6);
+        Bytes [1] = (UCHAR)(BT601::Y (Color, 10) >> 2);
+    }
+
+};
@@ -0,0 +1,329 @@
+/**************************************************************************
+
+    AVStream Simulated Hardware Sample
+
+    File:
+
+        portable.h
+
+    Abstract:
+
+        The header of the modules which don't touch the kernel (timestamp
+        mapping, frame rate conversion, ...).  They include this instead of
+        avshws.h.  In the driver it is avshws.h.  Host builds define
+        AVSHWS_HOST and get the few base types and runtime routines those
+        modules use from the C runtime instead of the WDK, so the modules
+        and their tests build and run on any platform (see Tests/).  The
+        few kernel objects the frame pool needs are stood in for too.
+
+    History:
+
+        created 10/18/2026
+
+**************************************************************************/
+
+#ifndef _portable_h_
+#define _portable_h_
+
+#ifndef AVSHWS_HOST
+
+#include "avshws.h"
+
+#else // AVSHWS_HOST
+
+/*************************************************
+
+    Standard Includes
+
+*************************************************/
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*************************************************
+
+    Base Types
+
+*************************************************/
+
+#define IN
+#define OUT
+#define OPTIONAL
+#define _In_
+
+#ifdef _MSC_VER
+#define FORCEINLINE __forceinline
+#else
+#define FORCEINLINE inline __attribute__ ((always_inline))
+#endif
+
+#ifndef TRUE
+#define TRUE 1
+#define FALSE 0
+#endif
+
+typedef void VOID, *PVOID;
+typedef char CHAR, *PCHAR, *LPSTR;
+typedef uint8_t UCHAR, *PUCHAR;
+typedef int16_t SHORT, *PSHORT;
+typedef uint16_t USHORT, *PUSHORT;
+typedef int32_t LONG, *PLONG;
+typedef uint32_t ULONG, *PULONG;
+typedef int64_t LONGLONG, *PLONGLONG;
+typedef uint64_t ULONGLONG, *PULONGLONG;
+typedef UCHAR BOOLEAN, *PBOOLEAN;
+typedef uintptr_t ULONG_PTR;
+typedef size_t SIZE_T;
+
+#define MAXULONG 0xFFFFFFFFUL
+
+#define RtlCopyMemory(Destination, Source, Length) \
+    memcpy ((Destination), (Source), (Length))
+#define RtlFillMemory(Destination, Length, Fill) \
+    memset ((Destination), (Fill), (Length))
+#define RtlZeroMemory(Destination, Length) \
+    memset ((Destination), 0, (Length))
+
+#define SIZEOF_ARRAY(Array) (sizeof (Array) / sizeof ((Array) [0]))
+
+#define NT_ASSERT(Expression) assert (Expression)
+#define UNREFERENCED_PARAMETER(P) ((void)(P))
+#define PAGED_CODE()
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define InterlockedIncrement(Addend) \
+    _InterlockedIncrement ((volatile long *)(Addend))
+#define InterlockedExchange(Target, Value) \
+    _InterlockedExchange ((volatile long *)(Target), (Value))
+#else
+#define InterlockedIncrement(Addend) \
+    __atomic_add_fetch ((Addend), 1, __ATOMIC_SEQ_CST)
+#define InterlockedExchange(Target, Value) \
+    __atomic_exchange_n ((Target), (Value), __ATOMIC_SEQ_CST)
+#endif
+
+/*************************************************
+
+    Kernel Stand-ins
+
+    The little of the kernel the frame pool (framepool.h) and the text
+    overlay cache use.  Spin locks are real; the timer and its DPC never
+    fire, so a test calls what the DPC would.  The low memory condition
+    is an event a test signals with HostSetLowMemory.
+
+*************************************************/
+
+typedef LONG NTSTATUS;
+typedef PVOID HANDLE;
+typedef UCHAR KIRQL;
+
+#define STATUS_SUCCESS ((NTSTATUS)0x00000000L)
+#define STATUS_PENDING ((NTSTATUS)0x00000103L)
+#define STATUS_INSUFFICIENT_RESOURCES ((NTSTATUS)0xC000009AL)
+#define NT_SUCCESS(Status) ((NTSTATUS)(Status) >= 0)
+
+typedef union _LARGE_INTEGER {
+    LONGLONG QuadPart;
+} LARGE_INTEGER;
+
+#define NonPagedPoolNx 0
+#define AVSHWS_POOLTAG 0x68535641UL        // 'hSVA'
+
+//
+// Non-paged pool is resident, so the pages are touched as they would be
+// when the kernel maps them.
+//
+inline PVOID
+ExAllocatePoolWithTag (
+    ULONG PoolType,
+    SIZE_T NumberOfBytes,
+    ULONG Tag
+    )
+{
+    UNREFERENCED_PARAMETER (PoolType);
+    UNREFERENCED_PARAMETER (Tag);
+
+    PVOID P = malloc (NumberOfBytes);
+    if (P) {
+        memset (P, 0xCD, NumberOfBytes);
+    }
+    return P;
+}
+
+#define ExFreePool(P) free (P)
+
+typedef volatile LONG KSPIN_LOCK, *PKSPIN_LOCK;
+
+inline void
+KeInitializeSpinLock (
+    PKSPIN_LOCK SpinLock
+    )
+{
+    *SpinLock = 0;
+}
+
+inline void
+KeAcquireSpinLock (
+    PKSPIN_LOCK SpinLock,
+    KIRQL *OldIrql
+    )
+{
+    *OldIrql = 0;
+    while (InterlockedExchange (SpinLock, 1)) {
+    }
+}
+
+inline void
+KeReleaseSpinLock (
+    PKSPIN_LOCK SpinLock,
+    KIRQL NewIrql
+    )
+{
+    UNREFERENCED_PARAMETER (NewIrql);
+    InterlockedExchange (SpinLock, 0);
+}
+
+typedef struct _KDPC {
+    PVOID DeferredContext;
+} KDPC, *PKDPC;
+
+typedef void KDEFERRED_ROUTINE (PKDPC, PVOID, PVOID, PVOID);
+
+typedef struct _KTIMER {
+    BOOLEAN Set;
+} KTIMER, *PKTIMER;
+
+inline void
+KeInitializeDpc (
+    PKDPC Dpc,
+    KDEFERRED_ROUTINE *DeferredRoutine,
+    PVOID DeferredContext
+    )
+{
+    UNREFERENCED_PARAMETER (DeferredRoutine);
+    Dpc->DeferredContext = DeferredContext;
+}
+
+inline void
+KeInitializeTimer (
+    PKTIMER Timer
+    )
+{
+    Timer->Set = FALSE;
+}
+
+inline BOOLEAN
+KeSetTimerEx (
+    PKTIMER Timer,
+    LARGE_INTEGER DueTime,
+    LONG Period,
+    PKDPC Dpc
+    )
+{
+    UNREFERENCED_PARAMETER (DueTime);
+    UNREFERENCED_PARAMETER (Period);
+    UNREFERENCED_PARAMETER (Dpc);
+
+    BOOLEAN WasSet = Timer->Set;
+    Timer->Set = TRUE;
+    return WasSet;
+}
+
+inline BOOLEAN
+KeCancelTimer (
+    PKTIMER Timer
+    )
+{
+    BOOLEAN WasSet = Timer->Set;
+    Timer->Set = FALSE;
+    return WasSet;
+}
+
+#define KeFlushQueuedDpcs()
+
+typedef struct _KEVENT {
+    volatile LONG State;
+} KEVENT, *PKEVENT;
+
+typedef struct _UNICODE_STRING {
+    const wchar_t *Buffer;
+} UNICODE_STRING, *PUNICODE_STRING;
+
+inline void
+RtlInitUnicodeString (
+    PUNICODE_STRING DestinationString,
+    const wchar_t *SourceString
+    )
+{
+    DestinationString->Buffer = SourceString;
+}
+
+//
+// HostLowMemoryCondition():
+//
+// The one \KernelObjects\LowMemoryCondition event of the process.
+//
+inline PKEVENT
+HostLowMemoryCondition (
+    )
+{
+    static KEVENT Event = { 0 };
+    return &Event;
+}
+
+inline void
+HostSetLowMemory (
+    BOOLEAN Low
+    )
+{
+    InterlockedExchange (&HostLowMemoryCondition () -> State, (LONG)Low);
+}
+
+inline PKEVENT
+IoCreateNotificationEvent (
+    PUNICODE_STRING EventName,
+    HANDLE *EventHandle
+    )
+{
+    UNREFERENCED_PARAMETER (EventName);
+    *EventHandle = HostLowMemoryCondition ();
+    return HostLowMemoryCondition ();
+}
+
+inline LONG
+KeReadStateEvent (
+    PKEVENT Event
+    )
+{
+    return Event -> State;
+}
+
+#define ZwClose(Handle) UNREFERENCED_PARAMETER (Handle)
+
+/*************************************************
+
+    Internal Includes
+
+*************************************************/
+
+#include "customprops.h"
+#include "pixfmt.h"
+#include "image.h"
+#include "tsmap.h"
+#include "drops.h"
+#include "watchdog.h"
+#include "frc.h"
+#include "delay.h"
+#include "convert.h"
+#include "scale.h"
+#include "probe.h"
+#include "framepool.h"
+#include "pts.h"
+
+#endif // AVSHWS_HOST
+
+#endif // _portable_h_
@@ -0,0 +1,993 @@
+/**************************************************************************
+
+    AVStream Simulated Hardware Sample
+
+    File:
+
+        preview.cpp
+
+    Abstract:
+
+        This file contains source for the preview pin on the capture filter.
+        See preview.h.
+
+    History:
+
+        created 10/18/2026
+
+**************************************************************************/
+
+#include "avshws.h"
+
+//
+// The size of the signal, which is the capture pin's size (see capture.cpp),
+// and the preview sizes scaled down from it.
+//
+#define DSIGNAL_X 1280
+#define DSIGNAL_Y 720
+#define DPREVIEW_X 640
+#define DPREVIEW_Y 360
+#define DPREVIEWS_X 320
+#define DPREVIEWS_Y 180
+
+/**************************************************************************
+
+    PAGEABLE CODE
+
+**************************************************************************/
+
+#ifdef ALLOC_PRAGMA
+#pragma code_seg("PAGE")
+#endif // ALLOC_PRAGMA
+
+
+CPreviewPin::
+CPreviewPin (
+    IN PKSPIN Pin
+    ) :
+    m_Pin (Pin)
+
+/*++
+
+Routine Description:
+
+    Construct a new preview pin.
+
+Arguments:
+
+    Pin -
+        The AVStream pin object corresponding to the preview pin
+
+Return Value:
+
+    None
+
+--*/
+
+{
+
+    PAGED_CODE();
+
+    PKSDEVICE Device = KsPinGetDevice (Pin);
+
+    m_Device = reinterpret_cast <CCaptureDevice *> (Device -> Context);
+
+}
+
+/*************************************************/
+
+
+NTSTATUS
+CPreviewPin::
+DispatchCreate (
+    IN PKSPIN Pin,
+    IN PIRP Irp
+    )
+
+/*++
+
+Routine Description:
+
+    Create a new preview pin.  This is the creation dispatch for the video
+    preview pin.
+
+Arguments:
+
+    Pin -
+        The pin being created
+
+    Irp -
+        The creation Irp
+
+Return Value:
+
+    Success / Failure
+
+--*/
+
+{
+
+    PAGED_CODE();
+
+    NTSTATUS Status = STATUS_SUCCESS;
+
+    CPreviewPin *PreviewPin = new (NonPagedPoolNx, 'niPP') CPreviewPin (Pin);
+
+    if (!PreviewPin) {
+
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+
+    } else {
+
+        Status = KsAddItemToObjectBag (
+            Pin -> Bag,
+            reinterpret_cast <PVOID> (PreviewPin),
+            reinterpret_cast <PFNKSFREE> (CPreviewPin::Cleanup)
+            );
+
+        if (!NT_SUCCESS (Status)) {
+            delete PreviewPin;
+        } else {
+            Pin -> Context = reinterpret_cast <PVOID> (PreviewPin);
+        }
+
+    }
+
+    //
+    // As on the capture pin, the framing is only known now that there is
+    // a connection format: one frame of biSizeImage.
+    //
+    if (NT_SUCCESS (Status)) {
+
+        PreviewPin -> CaptureFormat ();
+
+        Status = KsEdit (
+            Pin,
+            &Pin -> Descriptor,
+            AVSHWS_POOLTAG);
+
+        if (NT_SUCCESS (Status)) {
+
+            Status = KsEdit (
+                Pin,
+                &Pin -> Descriptor -> AllocatorFraming,
+                AVSHWS_POOLTAG);
+
+            if (NT_SUCCESS (Status)) {
+
+                PKSALLOCATOR_FRAMING_EX Framing =
+                    const_cast <PKSALLOCATOR_FRAMING_EX> (
+                        Pin -> Descriptor -> AllocatorFraming
+                        );
+
+                ULONG ImageSize = (reinterpret_cast
+                    <PKS_DATAFORMAT_VIDEOINFOHEADER> (
+                        Pin -> ConnectionFormat
+                        )) -> VideoInfoHeader.bmiHeader.biSizeImage;
+
+                Framing -> FramingItem [0].Frames = 2;
+
+                Framing -> FramingItem [0].PhysicalRange.MinFrameSize =
+                    Framing -> FramingItem [0].PhysicalRange.MaxFrameSize =
+                    Framing -> FramingItem [0].FramingRange.Range.MinFrameSize =
+                    Framing -> FramingItem [0].FramingRange.Range.MaxFrameSize =
+                    ImageSize;
+
+                Framing -> FramingItem [0].PhysicalRange.Stepping =
+                    Framing -> FramingItem [0].FramingRange.Range.Stepping =
+                    0;
+
+            }
+
+        }
+
+    }
+
+    if (NT_SUCCESS (Status)) {
+        //
+        // Preview frames carry the same extended header (KS_FRAME_INFO) as
+        // the video capture packets.
+        //
+        Pin -> StreamHeaderSize = sizeof (KSSTREAM_HEADER) +
+            sizeof (KS_FRAME_INFO);
+    }
+
+    return Status;
+
+}
+
+/*************************************************/
+
+
+void
+CPreviewPin::
+CaptureFormat (
+    )
+
+/*++
+
+Routine Description:
+
+    Take the preview size and format out of the connection format.  The
+    format was validated by DispatchSetFormat.
+
+Arguments:
+
+    None
+
+Return Value:
+
+    None
+
+--*/
+
+{
+
+    PAGED_CODE();
+
+    PKS_VIDEOINFOHEADER VideoInfoHeader =
+        &((reinterpret_cast <PKS_DATAFORMAT_VIDEOINFOHEADER>
+            (m_Pin -> ConnectionFormat)) ->
+            VideoInfoHeader);
+
+    //
+    // The preview ranges are all RGB: 24 or 32 bits.
+    //
+    if (VideoInfoHeader -> bmiHeader.biBitCount == 32) {
+        m_PixelFormat = AvshwsFormatBgra;
+    } else {
+        m_PixelFormat = AvshwsFormatRgb24;
+    }
+
+    m_Width = (ULONG)VideoInfoHeader -> bmiHeader.biWidth;
+    m_Height = (ULONG)abs (VideoInfoHeader -> bmiHeader.biHeight);
+    m_TimePerFrame = VideoInfoHeader -> AvgTimePerFrame;
+
+}
+
+/*************************************************/
+
+
+NTSTATUS
+CPreviewPin::
+DispatchSetFormat (
+    IN PKSPIN Pin,
+    IN PKSDATAFORMAT OldFormat OPTIONAL,
+    IN PKSMULTIPLE_ITEM OldAttributeList OPTIONAL,
+    IN const KSDATARANGE *DataRange,
+    IN const KSATTRIBUTE_LIST *AttributeRange OPTIONAL
+    )
+
+/*++
+
+Routine Description:
+
+    This is the set data format dispatch for the preview pin.  The capture
+    pin's handler checks a format against whichever of our ranges it
+    matched, so it validates preview formats too (as an initial format; it
+    must not touch the pin's context).  A format change is only accepted
+    when stopped.
+
+Arguments:
+
+    Pin -
+        The pin this format is being set on.  The format itself will be in
+        Pin -> ConnectionFormat.
+
+    OldFormat -
+        The previous format used on this pin, NULL for the initial format
+
+    OldAttributeList -
+        The old attribute list for the prior format
+
+    DataRange -
+        The range out of our list of data ranges the format matched
+
+    AttributeRange -
+        The attribute range
+
+Return Value:
+
+    Success / Failure
+
+--*/
+
+{
+
+    PAGED_CODE();
+
+    NTSTATUS Status = CCapturePin::DispatchSetFormat (
+        Pin,
+        NULL,
+        OldAttributeList,
+        DataRange,
+        AttributeRange
+        );
+
+    if (NT_SUCCESS (Status) && OldFormat) {
+
+        if (Pin -> DeviceState == KSSTATE_STOP) {
+            (reinterpret_cast <CPreviewPin *> (Pin -> Context)) ->
+                CaptureFormat ();
+        } else {
+            Status = STATUS_INVALID_DEVICE_STATE;
+        }
+
+    }
+
+    return Status;
+
+}
+
+/*************************************************/
+
+
+NTSTATUS
+CPreviewPin::
+SetState (
+    IN KSSTATE ToState,
+    IN KSSTATE FromState
+    )
+
+/*++
+
+Routine Description:
+
+    The state transition handler for the preview pin.  The preview pin
+    holds no hardware resources: it needs the clock, which is assigned
+    while stopped, and is ticked by the device while it runs.
+
+Arguments:
+
+    ToState -
+        The state we're transitioning to
+
+    FromState -
+        The state we're transitioning away from
+
+Return Value:
+
+    Success / Failure
+
+--*/
+
+{
+
+    PAGED_CODE();
+
+    switch (ToState) {
+
+        case KSSTATE_STOP:
+
+            if (m_Clock) {
+                m_Clock -> Release ();
+                m_Clock = NULL;
+            }
+
+            InterlockedExchange (&m_TickPending, 0);
+
+            m_FrameNumber = 0;
+            m_DropCount = 0;
+            break;
+
+        case KSSTATE_ACQUIRE:
+
+            if (FromState == KSSTATE_STOP) {
+
+                if (!NT_SUCCESS (
+                    KsPinGetReferenceClockInterface (
+                        m_Pin,
+                        &m_Clock
+                        )
+                    )) {
+
+                    m_Clock = NULL;
+
+                }
+
+            }
+            break;
+
+        case KSSTATE_PAUSE:
+
+            if (FromState == KSSTATE_RUN) {
+                m_Device -> RemovePreviewPin (this);
+            }
+            break;
+
+        case KSSTATE_RUN:
+
+            m_Device -> AddPreviewPin (this);
+            break;
+
+    }
+
+    return STATUS_SUCCESS;
+
+}
+
+/*************************************************/
+
+
+NTSTATUS
+CPreviewPin::
+Process (
+    )
+
+/*++
+
+Routine Description:
+
+    Fill the buffer at the leading edge for the last tick, with the newest
+    injected frame scaled down by the hardware simulation, and advance the
+    leading edge to complete it.  A tick with no buffer queued, or with no
+    frame to fill it with (the capture pin isn't streaming, or nothing was
+    injected yet), is skipped.
+
+Arguments:
+
+    None
+
+Return Value:
+
+    STATUS_PENDING if there was no tick, so that processing waits for the
+    next one
+
+--*/
+
+{
+
+    PAGED_CODE();
+
+    NTSTATUS Status = STATUS_SUCCESS;
+
+    if (InterlockedExchange (&m_TickPending, 0) == 0) {
+        return STATUS_PENDING;
+    }
+
+    PKSSTREAM_POINTER Leading = KsPinGetLeadingEdgeStreamPointer (
+        m_Pin,
+        KSSTREAM_POINTER_STATE_LOCKED
+        );
+
+    while (Leading && NULL == Leading -> StreamHeader -> Data) {
+
+        Status = KsStreamPointerAdvance (Leading);
+
+        //
+        // If we run off the end of the queue, Status will be
+        // STATUS_DEVICE_NOT_READY and the leading edge is no longer locked.
+        //
+        if (!NT_SUCCESS (Status)) {
+            Leading = NULL;
+        }
+
+    }
+
+    if (!Leading) {
+
+        m_DropCount++;
+
+    } else {
+
+        STREAM_POINTER_CONTEXT Context;
+
+        if (m_Device -> DeliverPreview (
+                Leading -> StreamHeader,
+                m_PixelFormat,
+                m_Width,
+                m_Height,
+                &Context
+                )) {
+
+            StampFrame (Leading -> StreamHeader, &Context);
+
+            Status = KsStreamPointerAdvance (Leading);
+
+            if (!NT_SUCCESS (Status)) {
+                Leading = NULL;
+            }
+
+        }
+
+        if (Leading) {
+            KsStreamPointerUnlock (Leading, FALSE);
+        }
+
+    }
+
+    return STATUS_SUCCESS;
+
+}
+
+/*************************************************/
+
+
+void
+CPreviewPin::
+StampFrame (
+    IN PKSSTREAM_HEADER StreamHeader,
+    IN PSTREAM_POINTER_CONTEXT Context
+    )
+
+/*++
+
+Routine Description:
+
+    Set the duration, timestamp and frame info of a preview frame.  With a
+    clock, the frame is stamped with its capture instant if the producer
+    stamped it, else with the time it is delivered.
+
+Arguments:
+
+    StreamHeader -
+        The stream header of the filled buffer
+
+    Context -
+        The capture instant of the frame in the buffer
+
+Return Value:
+
+    None
+
+--*/
+
+{
+
+    PAGED_CODE();
+
+    StreamHeader -> Duration = m_TimePerFrame;
+
+    StreamHeader -> PresentationTime.Numerator =
+        StreamHeader -> PresentationTime.Denominator = 1;
+
+    if (m_Clock) {
+
+        LONGLONG ClockTime = m_Clock -> GetTime ();
+
+        if (Context -> ProducerTimeValid) {
+
+            LONGLONG Age = QueryPerformanceTime () - Context -> ProducerTime;
+
+            if (Age > 0) {
+                ClockTime -= Age;
+            }
+
+        }
+
+        if (m_FrameNumber && ClockTime <= m_PresentationTime) {
+            ClockTime = m_PresentationTime + 1;
+        }
+
+        m_PresentationTime = ClockTime;
+
+        StreamHeader -> PresentationTime.Time = ClockTime;
+
+        StreamHeader -> OptionsFlags =
+            KSSTREAM_HEADER_OPTIONSF_TIMEVALID |
+            KSSTREAM_HEADER_OPTIONSF_DURATIONVALID;
+
+    } else {
+        StreamHeader -> PresentationTime.Time = 0;
+    }
+
+    m_FrameNumber++;
+
+    if (StreamHeader -> Size >= sizeof (KSSTREAM_HEADER) +
+        sizeof (KS_FRAME_INFO)) {
+
+        PKS_FRAME_INFO FrameInfo = reinterpret_cast <PKS_FRAME_INFO> (
+            StreamHeader + 1
+            );
+
+        FrameInfo -> ExtendedHeaderSize = sizeof (KS_FRAME_INFO);
+        FrameInfo -> dwFrameFlags       = KS_VIDEO_FLAG_FRAME;
+        FrameInfo -> PictureNumber      = (LONGLONG)m_FrameNumber;
+        FrameInfo -> DropCount          = m_DropCount;
+    }
+
+}
+
+/**************************************************************************
+
+    LOCKED CODE
+
+**************************************************************************/
+
+#ifdef ALLOC_PRAGMA
+#pragma code_seg()
+#endif // ALLOC_PRAGMA
+
+
+void
+CPreviewPin::
+Tick (
+    )
+
+/*++
+
+Routine Description:
+
+    Note a capture tick and kick processing to fill a buffer for it.
+    Called by the device at dispatch level.
+
+Arguments:
+
+    None
+
+Return Value:
+
+    None
+
+--*/
+
+{
+
+    InterlockedExchange (&m_TickPending, 1);
+
+    KsPinAttemptProcessing (m_Pin, TRUE);
+
+}
+
+/**************************************************************************
+
+    DISPATCH AND DESCRIPTOR LAYOUT
+
+**************************************************************************/
+
+//
+// FormatRGB24Bpp_Preview:
+//
+// The RGB24 preview format at half the capture width and height.
+//
+const 
+KS_DATARANGE_VIDEO 
+FormatRGB24Bpp_Preview = {
+
+    //
+    // KSDATARANGE
+    //
+    {   
+        sizeof (KS_DATARANGE_VIDEO),                // FormatSize
+        0,                                          // Flags
+        DPREVIEW_X * DPREVIEW_Y * 3,                // SampleSize
+        0,                                          // Reserved
+
+        STATICGUIDOF (KSDATAFORMAT_TYPE_VIDEO),     // aka. MEDIATYPE_Video
+        0xe436eb7d, 0x524f, 0x11ce, 0x9f, 0x53, 0x00, 0x20, 
+            0xaf, 0x0b, 0xa7, 0x70,                 // aka. MEDIASUBTYPE_RGB24,
+        STATICGUIDOF (KSDATAFORMAT_SPECIFIER_VIDEOINFO) // aka. FORMAT_VideoInfo
+    },
+
+    TRUE,               // BOOL,  bFixedSizeSamples (all samples same size?)
+    FALSE,              // BOOL,  bTemporalCompression (all I frames?)
+    0,                  // Reserved (was StreamDescriptionFlags)
+    0,                  // Reserved (was MemoryAllocationFlags   
+                        //           (KS_VIDEO_ALLOC_*))
+    //
+    // _KS_VIDEO_STREAM_CONFIG_CAPS  
+    //
+    {
+        STATICGUIDOF( KSDATAFORMAT_SPECIFIER_VIDEOINFO ), // GUID
+        KS_AnalogVideo_None,                            // AnalogVideoStandard
+        DSIGNAL_X, DSIGNAL_Y, // InputSize, (the inherent size of the incoming signal
+                        //             with every digitized pixel unique)
+        DSIGNAL_X, DSIGNAL_Y, // MinCroppingSize, smallest rcSrc cropping rect allowed
+        DSIGNAL_X, DSIGNAL_Y, // MaxCroppingSize, largest  rcSrc cropping rect allowed
+        8,              // CropGranularityX, granularity of cropping size
+        1,              // CropGranularityY
+        8,              // CropAlignX, alignment of cropping rect 
+        1,              // CropAlignY;
+        DPREVIEW_X, DPREVIEW_Y, // MinOutputSize, smallest bitmap stream can produce
+        DPREVIEW_X, DPREVIEW_Y, // MaxOutputSize, largest  bitmap stream can produce
+        8,              // OutputGranularityX, granularity of output bitmap size
+        1,              // OutputGranularityY;
+        0,              // StretchTapsX  (0 no stretch, 1 pix dup, 2 interp...)
+        0,              // StretchTapsY
+        2,              // ShrinkTapsX 
+        2,              // ShrinkTapsY 
+        333667,         // MinFrameInterval, 100 nS units
+        640000000,      // MaxFrameInterval, 100 nS units
+        8 * 3 * 30 * DPREVIEW_X * DPREVIEW_Y, // MinBitsPerSecond;
+        8 * 3 * 30 * DPREVIEW_X * DPREVIEW_Y // MaxBitsPerSecond;
+    }, 
+        
+    //
+    // KS_VIDEOINFOHEADER (default format)
+    //
+    {
+        0,0,0,0,                            // RECT  rcSource; 
+        0,0,0,0,                            // RECT  rcTarget; 
+        DPREVIEW_X * DPREVIEW_Y * 3 * 8 * 30, // DWORD dwBitRate;
+        0L,                                 // DWORD dwBitErrorRate; 
+        333667,                             // REFERENCE_TIME  AvgTimePerFrame;   
+        sizeof (KS_BITMAPINFOHEADER),       // DWORD biSize;
+        DPREVIEW_X,                         // LONG  biWidth;
+        DPREVIEW_Y,                         // LONG  biHeight;
+        1,                                  // WORD  biPlanes;
+        24,                                 // WORD  biBitCount;
+        KS_BI_RGB,                          // DWORD biCompression;
+        DPREVIEW_X * DPREVIEW_Y * 3,        // DWORD biSizeImage;
+        0,                                  // LONG  biXPelsPerMeter;
+        0,                                  // LONG  biYPelsPerMeter;
+        0,                                  // DWORD biClrUsed;
+        0                                   // DWORD biClrImportant;
+    }
+}; 
+
+//
+// FormatRGB32Bpp_Preview:
+//
+// The RGB32 preview format at half the capture width and height.
+//
+const 
+KS_DATARANGE_VIDEO 
+FormatRGB32Bpp_Preview = {
+
+    //
+    // KSDATARANGE
+    //
+    {   
+        sizeof (KS_DATARANGE_VIDEO),                // FormatSize
+        0,                                          // Flags
+        DPREVIEW_X * DPREVIEW_Y * 4,                // SampleSize
+        0,                                          // Reserved
+
+        STATICGUIDOF (KSDATAFORMAT_TYPE_VIDEO),     // aka. MEDIATYPE_Video
+        0xe436eb7e, 0x524f, 0x11ce, 0x9f, 0x53, 0x00, 0x20, 
+            0xaf, 0x0b, 0xa7, 0x70,                 // aka. MEDIASUBTYPE_RGB32,
+        STATICGUIDOF (KSDATAFORMAT_SPECIFIER_VIDEOINFO) // aka. FORMAT_VideoInfo
+    },
+
+    TRUE,               // BOOL,  bFixedSizeSamples (all samples same size?)
+    FALSE,              // BOOL,  bTemporalCompression (all I frames?)
+    0,                  // Reserved (was StreamDescriptionFlags)
+    0,                  // Reserved (was MemoryAllocationFlags   
+                        //           (KS_VIDEO_ALLOC_*))
+    //
+    // _KS_VIDEO_STREAM_CONFIG_CAPS  
+    //
+    {
+        STATICGUIDOF( KSDATAFORMAT_SPECIFIER_VIDEOINFO ), // GUID
+        KS_AnalogVideo_None,                            // AnalogVideoStandard
+        DSIGNAL_X, DSIGNAL_Y, // InputSize, (the inherent size of the incoming signal
+                        //             with every digitized pixel unique)
+        DSIGNAL_X, DSIGNAL_Y, // MinCroppingSize, smallest rcSrc cropping rect allowed
+        DSIGNAL_X, DSIGNAL_Y, // MaxCroppingSize, largest  rcSrc cropping rect allowed
+        8,              // CropGranularityX, granularity of cropping size
+        1,              // CropGranularityY
+        8,              // CropAlignX, alignment of cropping rect 
+        1,              // CropAlignY;
+        DPREVIEW_X, DPREVIEW_Y, // MinOutputSize, smallest bitmap stream can produce
+        DPREVIEW_X, DPREVIEW_Y, // MaxOutputSize, largest  bitmap stream can produce
+        8,              // OutputGranularityX, granularity of output bitmap size
+        1,              // OutputGranularityY;
+        0,              // StretchTapsX  (0 no stretch, 1 pix dup, 2 interp...)
+        0,              // StretchTapsY
+        2,              // ShrinkTapsX 
+        2,              // ShrinkTapsY 
+        333667,         // MinFrameInterval, 100 nS units
+        640000000,      // MaxFrameInterval, 100 nS units
+        8 * 4 * 30 * DPREVIEW_X * DPREVIEW_Y, // MinBitsPerSecond;
+        8 * 4 * 30 * DPREVIEW_X * DPREVIEW_Y // MaxBitsPerSecond;
+    }, 
+        
+    //
+    // KS_VIDEOINFOHEADER (default format)
+    //
+    {
+        0,0,0,0,                            // RECT  rcSource; 
+        0,0,0,0,                            // RECT  rcTarget; 
+        DPREVIEW_X * DPREVIEW_Y * 4 * 8 * 30, // DWORD dwBitRate;
+        0L,                                 // DWORD dwBitErrorRate; 
+        333667,                             // REFERENCE_TIME  AvgTimePerFrame;   
+        sizeof (KS_BITMAPINFOHEADER),       // DWORD biSize;
+        DPREVIEW_X,                         // LONG  biWidth;
+        DPREVIEW_Y,                         // LONG  biHeight;
+        1,                                  // WORD  biPlanes;
+        32,                                 // WORD  biBitCount;
+        KS_BI_RGB,                          // DWORD biCompression;
+        DPREVIEW_X * DPREVIEW_Y * 4,        // DWORD biSizeImage;
+        0,                                  // LONG  biXPelsPerMeter;
+        0,                                  // LONG  biYPelsPerMeter;
+        0,                                  // DWORD biClrUsed;
+        0                                   // DWORD biClrImportant;
+    }
+}; 
+
+//
+// FormatRGB24Bpp_PreviewSmall:
+//
+// The RGB24 preview format at a quarter of the capture width and
+// height.
+//
+const 
+KS_DATARANGE_VIDEO 
+FormatRGB24Bpp_PreviewSmall = {
+
+    //
+    // KSDATARANGE
+    //
+    {   
+        sizeof (KS_DATARANGE_VIDEO),                // FormatSize
+        0,                                          // Flags
+        DPREVIEWS_X * DPREVIEWS_Y * 3,              // SampleSize
+        0,                                          // Reserved
+
+        STATICGUIDOF (KSDATAFORMAT_TYPE_VIDEO),     // aka. MEDIATYPE_Video
+        0xe436eb7d, 0x524f, 0x11ce, 0x9f, 0x53, 0x00, 0x20, 
+            0xaf, 0x0b, 0xa7, 0x70,                 // aka. MEDIASUBTYPE_RGB24,
+        STATICGUIDOF (KSDATAFORMAT_SPECIFIER_VIDEOINFO) // aka. FORMAT_VideoInfo
+    },
+
+    TRUE,               // BOOL,  bFixedSizeSamples (all samples same size?)
+    FALSE,              // BOOL,  bTemporalCompression (all I frames?)
+    0,                  // Reserved (was StreamDescriptionFlags)
+    0,                  // Reserved (was MemoryAllocationFlags   
+                        //           (KS_VIDEO_ALLOC_*))
+    //
+    // _KS_VIDEO_STREAM_CONFIG_CAPS  
+    //
+    {
+        STATICGUIDOF( KSDATAFORMAT_SPECIFIER_VIDEOINFO ), // GUID
+        KS_AnalogVideo_None,                            // AnalogVideoStandard
+        DSIGNAL_X, DSIGNAL_Y, // InputSize, (the inherent size of the incoming signal
+                        //             with every digitized pixel unique)
+        DSIGNAL_X, DSIGNAL_Y, // MinCroppingSize, smallest rcSrc cropping rect allowed
+        DSIGNAL_X, DSIGNAL_Y, // MaxCroppingSize, largest  rcSrc cropping rect allowed
+        8,              // CropGranularityX, granularity of cropping size
+        1,              // CropGranularityY
+        8,              // CropAlignX, alignment of cropping rect 
+        1,              // CropAlignY;
+        DPREVIEWS_X, DPREVIEWS_Y, // MinOutputSize, smallest bitmap stream can produce
+        DPREVIEWS_X, DPREVIEWS_Y, // MaxOutputSize, largest  bitmap stream can produce
+        8,              // OutputGranularityX, granularity of output bitmap size
+        1,              // OutputGranularityY;
+        0,              // StretchTapsX  (0 no stretch, 1 pix dup, 2 interp...)
+        0,              // StretchTapsY
+        2,              // ShrinkTapsX 
+        2,              // ShrinkTapsY 
+        333667,         // MinFrameInterval, 100 nS units
+        640000000,      // MaxFrameInterval, 100 nS units
+        8 * 3 * 30 * DPREVIEWS_X * DPREVIEWS_Y, // MinBitsPerSecond;
+        8 * 3 * 30 * DPREVIEWS_X * DPREVIEWS_Y // MaxBitsPerSecond;
+    }, 
+        
+    //
+    // KS_VIDEOINFOHEADER (default format)
+    //
+    {
+        0,0,0,0,                            // RECT  rcSource; 
+        0,0,0,0,                            // RECT  rcTarget; 
+        DPREVIEWS_X * DPREVIEWS_Y * 3 * 8 * 30, // DWORD dwBitRate;
+        0L,                                 // DWORD dwBitErrorRate; 
+        333667,                             // REFERENCE_TIME  AvgTimePerFrame;   
+        sizeof (KS_BITMAPINFOHEADER),       // DWORD biSize;
+        DPREVIEWS_X,                        // LONG  biWidth;
+        DPREVIEWS_Y,                        // LONG  biHeight;
+        1,                                  // WORD  biPlanes;
+        24,                                 // WORD  biBitCount;
+        KS_BI_RGB,                          // DWORD biCompression;
+        DPREVIEWS_X * DPREVIEWS_Y * 3,      // DWORD biSizeImage;
+        0,                                  // LONG  biXPelsPerMeter;
+        0,                                  // LONG  biYPelsPerMeter;
+        0,                                  // DWORD biClrUsed;
+        0                                   // DWORD biClrImportant;
+    }
+}; 
+
+//
+// FormatRGB32Bpp_PreviewSmall:
+//
+// The RGB32 preview format at a quarter of the capture width and
+// height.
+//
+const 
+KS_DATARANGE_VIDEO 
+FormatRGB32Bpp_PreviewSmall = {
+
+    //
+    // KSDATARANGE
+    //
+    {   
+        sizeof (KS_DATARANGE_VIDEO),                // FormatSize
+        0,                                          // Flags
+        DPREVIEWS_X * DPREVIEWS_Y * 4,              // SampleSize
+        0,                                          // Reserved
+
+        STATICGUIDOF (KSDATAFORMAT_TYPE_VIDEO),     // aka. MEDIATYPE_Video
+        0xe436eb7e, 0x524f, 0x11ce, 0x9f, 0x53, 0x00, 0x20, 
+            0xaf, 0x0b, 0xa7, 0x70,                 // aka. MEDIASUBTYPE_RGB32,
+        STATICGUIDOF (KSDATAFORMAT_SPECIFIER_VIDEOINFO) // aka. FORMAT_VideoInfo
+    },
+
+    TRUE,               // BOOL,  bFixedSizeSamples (all samples same size?)
+    FALSE,              // BOOL,  bTemporalCompression (all I frames?)
+    0,                  // Reserved (was StreamDescriptionFlags)
+    0,                  // Reserved (was MemoryAllocationFlags   
+                        //           (KS_VIDEO_ALLOC_*))
+    //
+    // _KS_VIDEO_STREAM_CONFIG_CAPS  
+    //
+    {
+        STATICGUIDOF( KSDATAFORMAT_SPECIFIER_VIDEOINFO ), // GUID
+        KS_AnalogVideo_None,                            // AnalogVideoStandard
+        DSIGNAL_X, DSIGNAL_Y, // InputSize, (the inherent size of the incoming signal
+                        //             with every digitized pixel unique)
+        DSIGNAL_X, DSIGNAL_Y, // MinCroppingSize, smallest rcSrc cropping rect allowed
+        DSIGNAL_X, DSIGNAL_Y, // MaxCroppingSize, largest  rcSrc cropping rect allowed
+        8,              // CropGranularityX, granularity of cropping size
+        1,              // CropGranularityY
+        8,              // CropAlignX, alignment of cropping rect 
+        1,              // CropAlignY;
+        DPREVIEWS_X, DPREVIEWS_Y, // MinOutputSize, smallest bitmap stream can produce
+        DPREVIEWS_X, DPREVIEWS_Y, // MaxOutputSize, largest  bitmap stream can produce
+        8,              // OutputGranularityX, granularity of output bitmap size
+        1,              // OutputGranularityY;
+        0,              // StretchTapsX  (0 no stretch, 1 pix dup, 2 interp...)
+        0,              // StretchTapsY
+        2,              // ShrinkTapsX 
+        2,              // ShrinkTapsY 
+        333667,         // MinFrameInterval, 100 nS units
+        640000000,      // MaxFrameInterval, 100 nS units
+        8 * 4 * 30 * DPREVIEWS_X * DPREVIEWS_Y, // MinBitsPerSecond;
+        8 * 4 * 30 * DPREVIEWS_X * DPREVIEWS_Y // MaxBitsPerSecond;
+    }, 
+        
+    //
+    // KS_VIDEOINFOHEADER (default format)
+    //
+    {
+        0,0,0,0,                            // RECT  rcSource; 
+        0,0,0,0,                            // RECT  rcTarget; 
+        DPREVIEWS_X * DPREVIEWS_Y * 4 * 8 * 30, // DWORD dwBitRate;
+        0L,                                 // DWORD dwBitErrorRate; 
+        333667,                             // REFERENCE_TIME  AvgTimePerFrame;   
+        sizeof (KS_BITMAPINFOHEADER),       // DWORD biSize;
+        DPREVIEWS_X,                        // LONG  biWidth;
+        DPREVIEWS_Y,                        // LONG  biHeight;
+        1,                                  // WORD  biPlanes;
+        32,                                 // WORD  biBitCount;
+        KS_BI_RGB,                          // DWORD biCompression;
+        DPREVIEWS_X * DPREVIEWS_Y * 4,      // DWORD biSizeImage;
+        0,                                  // LONG  biXPelsPerMeter;
+        0,                                  // LONG  biYPelsPerMeter;
+        0,                                  // DWORD biClrUsed;
+        0                                   // DWORD biClrImportant;
+    }
+}; 
+
+//
+// PreviewPinDataRanges:
+//
+// This is the list of data ranges supported on the preview pin: RGB24 and
+// RGB32 at half and a quarter of the capture size.
+//
+const
+PKSDATARANGE
+PreviewPinDataRanges [PREVIEW_PIN_DATA_RANGE_COUNT] = {
+    (PKSDATARANGE) &FormatRGB24Bpp_Preview,
+    (PKSDATARANGE) &FormatRGB32Bpp_Preview,
+    (PKSDATARANGE) &FormatRGB24Bpp_PreviewSmall,
+    (PKSDATARANGE) &FormatRGB32Bpp_PreviewSmall
+    };
+
+//
+// PreviewPinDispatch:
+//
+// This is the dispatch table for the preview pin.
+//
+const
+KSPIN_DISPATCH
+PreviewPinDispatch = {
+    CPreviewPin::DispatchCreate,            // Pin Create
+    NULL,                                   // Pin Close
+    CPreviewPin::DispatchProcess,           // Pin Process
+    NULL,                                   // Pin Reset
+    CPreviewPin::DispatchSetFormat,         // Pin Set Data Format
+    CPreviewPin::DispatchSetState,          // Pin Set Device State
+    NULL,                                   // Pin Connect
+    NULL,                                   // Pin Disconnect
+    NULL,                                   // Clock Dispatch
+    NULL                                    // Allocator Dispatch
+};
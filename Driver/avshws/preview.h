@@ -0,0 +1,234 @@
+/**************************************************************************
+
+    AVStream Simulated Hardware Sample
+
+    File:
+
+        preview.h
+
+    Abstract:
+
+        This file contains header for the preview pin on the capture filter.
+        The preview pin streams the injected frames at a smaller size than
+        the capture pin, scaled down in the driver (see scale.h), so that a
+        viewfinder doesn't have to take and shrink full size frames.  It is
+        paced by the capture pin's ticks and fills each buffer from the
+        newest injected frame; the frame is scaled once per preview size
+        and shared by all the preview pins of that size.
+
+    History:
+
+        created 10/18/2026
+
+**************************************************************************/
+
+//
+// CPreviewPin:
+//
+// The preview pin class.
+//
+class CPreviewPin {
+
+private:
+
+    //
+    // The AVStream pin we're associated with.
+    //
+    PKSPIN m_Pin;
+
+    //
+    // Pointer to the internal device object for our capture device.
+    //
+    CCaptureDevice *m_Device;
+
+    //
+    // The clock we've been assigned, if any, to time stamp frames with.
+    //
+    PIKSREFERENCECLOCK m_Clock;
+
+    //
+    // The connection format: the AVSHWS_PIXEL_FORMAT, size and frame
+    // period.
+    //
+    ULONG m_PixelFormat;
+    ULONG m_Width;
+    ULONG m_Height;
+    LONGLONG m_TimePerFrame;
+
+    //
+    // Set by Tick, taken by Process.  Ticks that come before processing
+    // got to the last one are folded into it.
+    //
+    volatile LONG m_TickPending;
+
+    //
+    // The timestamp of the last frame, the number of frames delivered and
+    // the number of ticks without a buffer to fill, since the pin was
+    // stopped.
+    //
+    LONGLONG m_PresentationTime;
+    LONGLONG m_FrameNumber;
+    LONGLONG m_DropCount;
+
+    //
+    // CaptureFormat():
+    //
+    // Take the pixel format, size and frame period out of the connection
+    // format.
+    //
+    void
+    CaptureFormat (
+        );
+
+    //
+    // SetState():
+    //
+    // The state transition handler for the preview pin.  Gets and releases
+    // the clock and has the pin ticked while it runs.
+    //
+    NTSTATUS
+    SetState (
+        IN KSSTATE ToState,
+        IN KSSTATE FromState
+        );
+
+    //
+    // Process():
+    //
+    // The processing dispatch for the preview pin: fill the buffer at the
+    // leading edge if there was a tick.
+    //
+    NTSTATUS
+    Process (
+        );
+
+    //
+    // StampFrame():
+    //
+    // Set the duration, timestamp and frame info of a filled buffer.
+    // Context holds the capture instant of the frame in it.
+    //
+    void
+    StampFrame (
+        IN PKSSTREAM_HEADER StreamHeader,
+        IN PSTREAM_POINTER_CONTEXT Context
+        );
+
+    //
+    // Cleanup():
+    //
+    // The free callback from the bagged item (CPreviewPin).
+    //
+    static
+    void
+    Cleanup (
+        IN CPreviewPin *Pin
+        )
+    {
+        delete Pin;
+    }
+
+public:
+
+    //
+    // CPreviewPin():
+    //
+    // The preview pin's constructor.  Only non-0, non-NULL fields are
+    // initialized.
+    //
+    CPreviewPin (
+        IN PKSPIN Pin
+        );
+
+    //
+    // ~CPreviewPin():
+    //
+    // The preview pin's destructor.
+    //
+    ~CPreviewPin (
+        )
+    {
+    }
+
+    //
+    // Tick():
+    //
+    // Called by the device at every capture tick while the pin runs, at
+    // dispatch level.  Kicks processing to fill the next buffer.
+    //
+    void
+    Tick (
+        );
+
+    /*************************************************
+
+        Dispatch Routines
+
+    *************************************************/
+
+    //
+    // DispatchCreate():
+    //
+    // This is the creation dispatch for the preview pin.  It creates the
+    // CPreviewPin object and bags it with the AVStream pin.
+    //
+    static
+    NTSTATUS
+    DispatchCreate (
+        IN PKSPIN Pin,
+        IN PIRP Irp
+        );
+
+    //
+    // DispatchSetState():
+    //
+    // The set device state dispatch for the pin.  Bridges to SetState()
+    // in the context of the CPreviewPin.
+    //
+    static
+    NTSTATUS
+    DispatchSetState (
+        IN PKSPIN Pin,
+        IN KSSTATE ToState,
+        IN KSSTATE FromState
+        )
+    {
+        return
+            (reinterpret_cast <CPreviewPin *> (Pin -> Context)) ->
+                SetState (ToState, FromState);
+    }
+
+    //
+    // DispatchSetFormat():
+    //
+    // The set data format dispatch for the pin.  The format is validated
+    // against the preview ranges as the capture pin validates its own.
+    //
+    static
+    NTSTATUS
+    DispatchSetFormat (
+        IN PKSPIN Pin,
+        IN PKSDATAFORMAT OldFormat OPTIONAL,
+        IN PKSMULTIPLE_ITEM OldAttributeList OPTIONAL,
+        IN const KSDATARANGE *DataRange,
+        IN const KSATTRIBUTE_LIST *AttributeRange OPTIONAL
+        );
+
+    //
+    // DispatchProcess():
+    //
+    // The processing dispatch for the preview pin.  Bridges to Process()
+    // in the context of the CPreviewPin.
+    //
+    static
+    NTSTATUS
+    DispatchProcess (
+        IN PKSPIN Pin
+        )
+    {
+        return
+            (reinterpret_cast <CPreviewPin *> (Pin -> Context)) ->
+                Process ();
+    }
+
+};
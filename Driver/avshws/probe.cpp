@@ -0,0 +1,178 @@
+/**************************************************************************
+
+    AVStream Simulated Hardware Sample
+
+    File:
+
+        probe.cpp
+
+    Abstract:
+
+        Latency probe stamping.  See probe.h.
+
+        The stamp is small and rendered into frames in nonpaged memory.
+        This entire file is in locked segments.  It builds on the host
+        through portable.h (see Tests/LatencyProbeTest).
+
+    History:
+
+        created 10/18/2026
+
+**************************************************************************/
+
+#include "portable.h"
+
+/**************************************************************************
+
+    LOCKED CODE
+
+**************************************************************************/
+
+#ifdef ALLOC_PRAGMA
+#pragma code_seg()
+#endif // ALLOC_PRAGMA
+
+
+//
+// ProbeCrc16():
+//
+// CRC-16/CCITT-FALSE over Length bytes.
+//
+static
+USHORT
+ProbeCrc16 (
+    IN const UCHAR *Data,
+    IN ULONG Length
+    )
+{
+    USHORT Crc = 0xFFFF;
+
+    for (ULONG i = 0; i < Length; i++) {
+
+        Crc ^= (USHORT)(Data [i] << 8);
+
+        for (ULONG Bit = 0; Bit < 8; Bit++) {
+            Crc = (Crc & 0x8000) ?
+                (USHORT)((Crc << 1) ^ 0x1021) :
+                (USHORT)(Crc << 1);
+        }
+
+    }
+
+    return Crc;
+}
+
+/*************************************************/
+
+
+void
+ProbeStamp (
+    IN PUCHAR TopLeft,
+    IN LONG Stride,
+    IN ULONG BytesPerPixel,
+    IN const PROBE_CODE *Code
+    )
+
+/*++
+
+Routine Description:
+
+    Render a probe code.  Each row of cells is rendered once as runs of
+    equal cells filled with a single memset, then replicated down the
+    remaining pixel rows of the cell.
+
+Arguments:
+
+    TopLeft -
+        The top left pixel of the image as displayed
+
+    Stride -
+        Signed byte distance between displayed rows
+
+    BytesPerPixel -
+        3 for RGB24, 4 for RGB32, 2 for the P010 luma plane
+
+    Code -
+        The payload to render
+
+Return Value:
+
+    None
+
+--*/
+
+{
+
+    //
+    // Serialize the payload most significant byte first, followed by its
+    // CRC.  This is the order the bits are laid out in.
+    //
+    UCHAR Payload [14];
+
+    for (ULONG i = 0; i < 4; i++) {
+        Payload [i] = (UCHAR)(Code -> FrameId >> (24 - 8 * i));
+    }
+
+    for (ULONG i = 0; i < 8; i++) {
+        Payload [4 + i] = (UCHAR)((ULONGLONG)Code -> Timestamp >> (56 - 8 * i));
+    }
+
+    USHORT Crc = ProbeCrc16 (Payload, 12);
+    Payload [12] = (UCHAR)(Crc >> 8);
+    Payload [13] = (UCHAR)Crc;
+
+    ULONG CellBytes = PROBE_CELL_SIZE * BytesPerPixel;
+
+    for (ULONG Row = 0; Row < PROBE_CODE_ROWS; Row++) {
+
+        PUCHAR Line = TopLeft + (LONG)(Row * PROBE_CELL_SIZE) * Stride;
+        ULONG Column = 0;
+
+        while (Column < PROBE_CODE_COLUMNS) {
+
+            BOOLEAN White = FALSE;
+            ULONG RunStart = Column;
+
+            //
+            // Find the run of cells of the same color starting here.
+            //
+            do {
+
+                BOOLEAN CellWhite;
+
+                if (Row == 0) {
+                    CellWhite = (Column & 1) == 0;
+                } else {
+                    ULONG Bit = (Row - 1) * PROBE_CODE_COLUMNS + Column;
+                    CellWhite = (Payload [Bit >> 3] & (0x80 >> (Bit & 7))) != 0;
+                }
+
+                if (Column == RunStart) {
+                    White = CellWhite;
+                } else if (CellWhite != White) {
+                    break;
+                }
+
+                Column++;
+
+            } while (Column < PROBE_CODE_COLUMNS);
+
+            RtlFillMemory (
+                Line + RunStart * CellBytes,
+                (Column - RunStart) * CellBytes,
+                White ? 0xFF : 0x00
+                );
+
+        }
+
+        for (ULONG y = 1; y < PROBE_CELL_SIZE; y++) {
+            RtlCopyMemory (
+                Line + (LONG)y * Stride,
+                Line,
+                PROBE_CODE_COLUMNS * CellBytes
+                );
+        }
+
+    }
+
+}
@@ -0,0 +1,75 @@
+/**************************************************************************
+
+    AVStream Simulated Hardware Sample
+
+    File:
+
+        probe.h
+
+    Abstract:
+
+        Latency probe.  When enabled, every injected frame is stamped in
+        its top left corner with a block code carrying a frame ID and the
+        inject time.  A consumer decodes the code from the delivered
+        buffer (see LatencyProbe.h in the driver interface library) to
+        measure inject to consumer latency and to detect repeated and
+        dropped frames.
+
+        The code is a grid of PROBE_CODE_COLUMNS x PROBE_CODE_ROWS square
+        cells of PROBE_CELL_SIZE pixels, each either black or white:
+
+            row 0      sync: white, black, white, black, ...
+            rows 1-7   FrameId (32 bits), Timestamp (64 bits) and a
+                       CRC-16/CCITT of both (16 bits), most significant
+                       bit first, row by row
+
+        Only full black and white are used and the cells are large, so the
+        code survives RGB to YUV conversion and chroma subsampling.  The
+        code must not be scaled or blended (do not use FrcModeBlend while
+        probing).
+
+        Like frc.h, nothing in here touches the kernel.
+
+    History:
+
+        created 10/18/2026
+
+**************************************************************************/
+
+#define PROBE_CELL_SIZE 8
+#define PROBE_CODE_COLUMNS 16
+#define PROBE_CODE_ROWS 8
+
+#define PROBE_CODE_WIDTH (PROBE_CELL_SIZE * PROBE_CODE_COLUMNS)
+#define PROBE_CODE_HEIGHT (PROBE_CELL_SIZE * PROBE_CODE_ROWS)
+
+//
+// PROBE_CODE:
+//
+// The payload of a probe code.  Timestamp is in 100ns units of the
+// performance counter.
+//
+typedef struct _PROBE_CODE {
+
+    ULONG FrameId;
+    LONGLONG Timestamp;
+
+} PROBE_CODE, *PPROBE_CODE;
+
+//
+// ProbeStamp():
+//
+// Render Code into an 8 bit per component RGB image (RGB24 or RGB32) or
+// the luma plane of P010, whose cells come out as full scale 16 bit samples.
+// TopLeft points at the top left pixel of the image as displayed and Stride
+// is the signed distance in bytes from one displayed row to the next (it
+// is negative for bottom-up DIBs).  The image must be at least
+// PROBE_CODE_WIDTH x PROBE_CODE_HEIGHT.
+//
+void
+ProbeStamp (
+    IN PUCHAR TopLeft,
+    IN LONG Stride,
+    IN ULONG BytesPerPixel,
+    IN const PROBE_CODE *Code
+    );
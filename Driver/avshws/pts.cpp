@@ -0,0 +1,202 @@
+/**************************************************************************
+
+    AVStream Simulated Hardware Sample
+
+    File:
+
+        pts.cpp
+
+    Abstract:
+
+        Schedule derived presentation timestamps.  See pts.h.
+
+        This entire file is called at DPC and must be in locked segments.
+
+    History:
+
+        created 10/18/2026
+
+**************************************************************************/
+
+#include "portable.h"
+
+/**************************************************************************
+
+    LOCKED CODE
+
+**************************************************************************/
+
+#ifdef ALLOC_PRAGMA
+#pragma code_seg()
+#endif // ALLOC_PRAGMA
+
+
+void
+PtsReset (
+    OUT PPTS_SCHEDULE Schedule,
+    IN LONGLONG TimePerFrame
+    )
+
+/*++
+
+Routine Description:
+
+    Start a schedule.  It is anchored by the first frame stamped, which
+    must come with a clock reading.
+
+Arguments:
+
+    Schedule -
+        The schedule
+
+    TimePerFrame -
+        The frame period in clock units
+
+Return Value:
+
+    None
+
+--*/
+
+{
+
+    RtlZeroMemory (Schedule, sizeof (PTS_SCHEDULE));
+    Schedule -> TimePerFrame = TimePerFrame;
+
+}
+
+/*************************************************/
+
+
+BOOLEAN
+PtsNeedsClock (
+    IN PPTS_SCHEDULE Schedule
+    )
+
+/*++
+
+Routine Description:
+
+    Tell whether the next frame stamped uses a clock reading.
+
+Arguments:
+
+    Schedule -
+        The schedule
+
+Return Value:
+
+    TRUE if the schedule isn't anchored yet or a check is due
+
+--*/
+
+{
+
+    return !Schedule -> Anchored ||
+        Schedule -> SinceCheck >= PTS_CHECK_FRAMES;
+
+}
+
+/*************************************************/
+
+
+LONGLONG
+PtsStamp (
+    IN OUT PPTS_SCHEDULE Schedule,
+    IN ULONG Tick,
+    IN BOOLEAN ClockValid,
+    IN LONGLONG ClockTime
+    )
+
+/*++
+
+Routine Description:
+
+    Stamp the frame filled at Tick from the schedule, first anchoring the
+    schedule or slewing it toward the clock if a reading is given and
+    needed.
+
+Arguments:
+
+    Schedule -
+        The schedule
+
+    Tick -
+        The tick that filled the frame.  Ticks may be skipped (dropped
+        frames) but don't go back.
+
+    ClockValid -
+        Whether ClockTime holds a reading
+
+    ClockTime -
+        The clock's time for the frame
+
+Return Value:
+
+    The timestamp, strictly after the previous one
+
+--*/
+
+{
+
+    LONGLONG Period = Schedule -> TimePerFrame;
+
+    if (ClockValid && PtsNeedsClock (Schedule)) {
+
+        if (!Schedule -> Anchored) {
+
+            Schedule -> Anchored = TRUE;
+            Schedule -> AnchorTime = ClockTime;
+            Schedule -> AnchorTick = Tick;
+
+        } else {
+
+            LONGLONG Scheduled = Schedule -> AnchorTime +
+                (LONGLONG)(LONG)(Tick - Schedule -> AnchorTick) * Period;
+
+            LONGLONG Error = ClockTime - Scheduled;
+
+            if (Error > PTS_RESYNC_FRAMES * Period ||
+                Error < -PTS_RESYNC_FRAMES * Period) {
+
+                Schedule -> AnchorTime = ClockTime;
+                Schedule -> AnchorTick = Tick;
+
+            } else {
+
+                LONGLONG Step = Error / PTS_SLEW_DIVISOR;
+                LONGLONG Limit = Period / PTS_SLEW_LIMIT;
+
+                if (Step > Limit) {
+                    Step = Limit;
+                } else if (Step < -Limit) {
+                    Step = -Limit;
+                }
+
+                Schedule -> AnchorTime += Step;
+
+            }
+
+        }
+
+        Schedule -> SinceCheck = 0;
+
+    }
+
+    //
+    // Without any reading yet, count from zero.
+    //
+    LONGLONG Time = Schedule -> AnchorTime +
+        (LONGLONG)(LONG)(Tick - Schedule -> AnchorTick) * Period;
+
+    if (Schedule -> Stamped && Time <= Schedule -> LastTime) {
+        Time = Schedule -> LastTime + 1;
+    }
+
+    Schedule -> Stamped = TRUE;
+    Schedule -> LastTime = Time;
+    Schedule -> SinceCheck++;
+
+    return Time;
+
+}
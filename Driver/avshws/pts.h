@@ -0,0 +1,130 @@
+/**************************************************************************
+
+    AVStream Simulated Hardware Sample
+
+    File:
+
+        pts.h
+
+    Abstract:
+
+        Schedule derived presentation timestamps.  A frame filled at tick N
+        is stamped with anchor + (N - anchor tick) * frame period instead of
+        the clock reading at its completion, so the timestamps are exactly a
+        frame period apart whatever the DPC latency.  The anchor ties the
+        schedule to the graph clock when the stream starts running.
+
+        The ticks are timed by the system clock and the graph clock may run
+        at a slightly different rate, so every PTS_CHECK_FRAMES frames the
+        schedule is compared with a clock reading and the anchor is slewed
+        by part of the error, never more than a fraction of a frame period
+        at once.  This bounds the drift without a visible step.  An error
+        over PTS_RESYNC_FRAMES frame periods (the clock jumped) re-anchors
+        outright.
+
+        Nothing in here touches the kernel or reads a clock: the caller
+        passes the readings in.  This keeps the anchoring logic usable
+        outside of the driver, against recorded or simulated clock traces
+        (see Tests/PtsTest).
+
+    History:
+
+        created 10/18/2026
+
+**************************************************************************/
+
+//
+// PTS_CHECK_FRAMES:
+//
+// How many frames are stamped from the schedule between clock readings.
+//
+#define PTS_CHECK_FRAMES 30
+
+//
+// PTS_SLEW_DIVISOR:
+//
+// The part of the error to the clock corrected by one check.
+//
+#define PTS_SLEW_DIVISOR 4
+
+//
+// PTS_SLEW_LIMIT:
+//
+// One check moves the anchor by at most the frame period divided by this,
+// which keeps consecutive timestamps within 1/8 of a period of even.
+// Together with PTS_CHECK_FRAMES this lets the schedule follow a clock
+// whose rate differs from the ticks' by up to 1 / (8 * 30), about 0.4%.
+//
+#define PTS_SLEW_LIMIT 8
+
+//
+// PTS_RESYNC_FRAMES:
+//
+// An error to the clock beyond this many frame periods re-anchors the
+// schedule at once.
+//
+#define PTS_RESYNC_FRAMES 2
+
+//
+// PTS_SCHEDULE:
+//
+// The state of a schedule.  Times are in the units of the clock, ticks are
+// the hardware's interrupt count.
+//
+typedef struct _PTS_SCHEDULE {
+
+    LONGLONG TimePerFrame;
+
+    BOOLEAN Anchored;
+    LONGLONG AnchorTime;
+    ULONG AnchorTick;
+
+    //
+    // Frames stamped since the last clock reading was applied.
+    //
+    ULONG SinceCheck;
+
+    //
+    // The last timestamp handed out.  The schedule never goes back.
+    //
+    BOOLEAN Stamped;
+    LONGLONG LastTime;
+
+} PTS_SCHEDULE, *PPTS_SCHEDULE;
+
+//
+// PtsReset():
+//
+// Start a schedule with the given frame period.  The next frame stamped
+// anchors it.
+//
+void
+PtsReset (
+    OUT PPTS_SCHEDULE Schedule,
+    IN LONGLONG TimePerFrame
+    );
+
+//
+// PtsNeedsClock():
+//
+// Whether the next frame stamped needs a clock reading: to anchor the
+// schedule or for the periodic check.
+//
+BOOLEAN
+PtsNeedsClock (
+    IN PPTS_SCHEDULE Schedule
+    );
+
+//
+// PtsStamp():
+//
+// The timestamp of the frame filled at Tick.  If ClockValid, ClockTime is
+// the clock's time for that frame; it is used if PtsNeedsClock.
+//
+LONGLONG
+PtsStamp (
+    IN OUT PPTS_SCHEDULE Schedule,
+    IN ULONG Tick,
+    IN BOOLEAN ClockValid,
+    IN LONGLONG ClockTime
+    );
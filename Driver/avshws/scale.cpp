@@ -0,0 +1,318 @@
+/**************************************************************************
+
+    AVStream Simulated Hardware Sample
+
+    File:
+
+        scale.cpp
+
+    Abstract:
+
+        Downscaling of staged frames.  See scale.h.
+
+        Scaling runs in the preview pin's processing and touches only the
+        frame buffers handed in.  This entire file is in locked segments.
+
+    History:
+
+        created 10/18/2026
+
+**************************************************************************/
+
+#include "portable.h"
+
+/**************************************************************************
+
+    LOCKED CODE
+
+**************************************************************************/
+
+#ifdef ALLOC_PRAGMA
+#pragma code_seg()
+#endif // ALLOC_PRAGMA
+
+
+template <typename SAMPLE, ULONG Components>
+void
+ScalePlane (
+    IN const UCHAR *Source,
+    IN ULONG InputStride,
+    IN ULONG InputWidth,
+    IN ULONG InputHeight,
+    OUT PUCHAR Destination,
+    IN ULONG OutputStride,
+    IN ULONG OutputWidth,
+    IN ULONG OutputHeight,
+    IN PULONG Accumulator
+    )
+
+/*++
+
+Routine Description:
+
+    Box filter one plane of Components interleaved samples per pixel.  The
+    input rows of an output row are summed into Accumulator, one sum per
+    output sample, and the sums are divided by the size of their box.
+    Output pixel x covers input columns [x * InputWidth / OutputWidth,
+    (x + 1) * InputWidth / OutputWidth), and likewise for rows.  The box
+    edges are stepped with the quotient and remainder of the ratio rather
+    than divided out for every row.
+
+Arguments:
+
+    Source -
+        The first row of the input plane
+
+    InputStride -
+        The distance in bytes between input rows
+
+    InputWidth -
+        The width of the input plane in pixels
+
+    InputHeight -
+        The height of the input plane in rows
+
+    Destination -
+        The first row of the output plane
+
+    OutputStride -
+        The distance in bytes between output rows
+
+    OutputWidth -
+        The width of the output plane in pixels, at most InputWidth
+
+    OutputHeight -
+        The height of the output plane in rows, at most InputHeight
+
+    Accumulator -
+        OutputWidth * Components ULONGs of scratch
+
+Return Value:
+
+    None
+
+--*/
+
+{
+
+    ULONG StepX = InputWidth / OutputWidth;
+    ULONG ExtraX = InputWidth % OutputWidth;
+    ULONG StepY = InputHeight / OutputHeight;
+    ULONG ExtraY = InputHeight % OutputHeight;
+
+    ULONG Top = 0;
+    ULONG RemainderY = 0;
+
+    for (ULONG y = 0; y < OutputHeight; y++) {
+
+        ULONG Bottom = Top + StepY;
+
+        RemainderY += ExtraY;
+        if (RemainderY >= OutputHeight) {
+            RemainderY -= OutputHeight;
+            Bottom++;
+        }
+
+        RtlZeroMemory (
+            Accumulator,
+            OutputWidth * Components * sizeof (ULONG)
+            );
+
+        for (ULONG Row = Top; Row < Bottom; Row++) {
+
+            const SAMPLE *In = reinterpret_cast <const SAMPLE *> (
+                Source + (SIZE_T)Row * InputStride
+                );
+
+            PULONG Sum = Accumulator;
+            ULONG RemainderX = 0;
+
+            for (ULONG x = 0; x < OutputWidth; x++) {
+
+                ULONG Width = StepX;
+
+                RemainderX += ExtraX;
+                if (RemainderX >= OutputWidth) {
+                    RemainderX -= OutputWidth;
+                    Width++;
+                }
+
+                for (; Width; Width--) {
+                    for (ULONG c = 0; c < Components; c++) {
+                        Sum [c] += In [c];
+                    }
+                    In += Components;
+                }
+
+                Sum += Components;
+
+            }
+
+        }
+
+        SAMPLE *Out = reinterpret_cast <SAMPLE *> (
+            Destination + (SIZE_T)y * OutputStride
+            );
+
+        PULONG Sum = Accumulator;
+        ULONG RemainderX = 0;
+
+        for (ULONG x = 0; x < OutputWidth; x++) {
+
+            ULONG Width = StepX;
+
+            RemainderX += ExtraX;
+            if (RemainderX >= OutputWidth) {
+                RemainderX -= OutputWidth;
+                Width++;
+            }
+
+            ULONG Count = Width * (Bottom - Top);
+
+            for (ULONG c = 0; c < Components; c++) {
+                Out [c] = (SAMPLE)((Sum [c] + (Count >> 1)) / Count);
+            }
+
+            Out += Components;
+            Sum += Components;
+
+        }
+
+        Top = Bottom;
+
+    }
+
+}
+
+/*************************************************/
+
+
+BOOLEAN
+ScaleFrame (
+    IN ULONG Format,
+    IN const UCHAR *Source,
+    IN ULONG InputWidth,
+    IN ULONG InputHeight,
+    OUT PUCHAR Destination,
+    IN ULONG OutputWidth,
+    IN ULONG OutputHeight,
+    IN PULONG Accumulator
+    )
+
+/*++
+
+Routine Description:
+
+    Downscale a frame.  Packed formats are scaled as one plane; NV12 and
+    P010 as a luma plane and a half size plane of interleaved chroma
+    pairs.
+
+Arguments:
+
+    Format -
+        The AVSHWS_PIXEL_FORMAT of both frames
+
+    Source -
+        The input frame
+
+    InputWidth -
+        The width of the input frame
+
+    InputHeight -
+        The height of the input frame
+
+    Destination -
+        The output frame
+
+    OutputWidth -
+        The width of the output frame, at most InputWidth
+
+    OutputHeight -
+        The height of the output frame, at most InputHeight
+
+    Accumulator -
+        SCALE_ACCUMULATOR_COUNT (OutputWidth) ULONGs of scratch
+
+Return Value:
+
+    TRUE if the frame was scaled
+
+--*/
+
+{
+
+    if (OutputWidth == 0 || OutputHeight == 0 ||
+        OutputWidth > InputWidth || OutputHeight > InputHeight ||
+        ConvertFrameSize (Format, InputWidth, InputHeight) == 0 ||
+        ConvertFrameSize (Format, OutputWidth, OutputHeight) == 0) {
+        return FALSE;
+    }
+
+    //
+    // The largest box is one column and one row over the ratio.
+    //
+    if ((ULONGLONG)(InputWidth / OutputWidth + 1) *
+        (InputHeight / OutputHeight + 1) > SCALE_BOX_MAX) {
+        return FALSE;
+    }
+
+    ULONG InputStride = ConvertLineBytes (Format, InputWidth);
+    ULONG OutputStride = ConvertLineBytes (Format, OutputWidth);
+
+    switch (Format) {
+
+        case AvshwsFormatRgb24:
+            ScalePlane <UCHAR, 3> (
+                Source, InputStride, InputWidth, InputHeight,
+                Destination, OutputStride, OutputWidth, OutputHeight,
+                Accumulator
+                );
+            break;
+
+        case AvshwsFormatBgra:
+        case AvshwsFormatRgba:
+            ScalePlane <UCHAR, 4> (
+                Source, InputStride, InputWidth, InputHeight,
+                Destination, OutputStride, OutputWidth, OutputHeight,
+                Accumulator
+                );
+            break;
+
+        case AvshwsFormatNv12:
+            ScalePlane <UCHAR, 1> (
+                Source, InputStride, InputWidth, InputHeight,
+                Destination, OutputStride, OutputWidth, OutputHeight,
+                Accumulator
+                );
+            ScalePlane <UCHAR, 2> (
+                Source + (SIZE_T)InputStride * InputHeight,
+                InputStride, InputWidth / 2, InputHeight / 2,
+                Destination + (SIZE_T)OutputStride * OutputHeight,
+                OutputStride, OutputWidth / 2, OutputHeight / 2,
+                Accumulator
+                );
+            break;
+
+        case AvshwsFormatP010:
+            ScalePlane <USHORT, 1> (
+                Source, InputStride, InputWidth, InputHeight,
+                Destination, OutputStride, OutputWidth, OutputHeight,
+                Accumulator
+                );
+            ScalePlane <USHORT, 2> (
+                Source + (SIZE_T)InputStride * InputHeight,
+                InputStride, InputWidth / 2, InputHeight / 2,
+                Destination + (SIZE_T)OutputStride * OutputHeight,
+                OutputStride, OutputWidth / 2, OutputHeight / 2,
+                Accumulator
+                );
+            break;
+
+        default:
+            return FALSE;
+
+    }
+
+    return TRUE;
+
+}
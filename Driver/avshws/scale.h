@@ -0,0 +1,64 @@
+/**************************************************************************
+
+    AVStream Simulated Hardware Sample
+
+    File:
+
+        scale.h
+
+    Abstract:
+
+        Downscaling of staged frames for the preview pin.  Each output
+        pixel is the rounded average of the box of input pixels it covers
+        (an area, or box, filter), which for the 2x, 3x and 4x ratios of
+        the common preview sizes is exact and for other ratios is within
+        one input pixel of it.  Every input sample is read once, in row
+        order.
+
+        Like frc.h and convert.h, nothing in here touches the kernel: the
+        caller provides the buffers, including the row accumulator.  It is
+        checked against a reference filter and timed on the host (see
+        Tests/ScaleTest).
+
+    History:
+
+        created 10/18/2026
+
+**************************************************************************/
+
+//
+// SCALE_ACCUMULATOR_COUNT:
+//
+// The number of ULONGs of accumulator ScaleFrame needs for an output
+// Width pixels wide.
+//
+#define SCALE_ACCUMULATOR_COUNT(Width) ((Width) * 4)
+
+//
+// SCALE_BOX_MAX:
+//
+// The most input pixels one output pixel may average.  This keeps the 16
+// bit sums of P010 within a ULONG.
+//
+#define SCALE_BOX_MAX 65536
+
+//
+// ScaleFrame():
+//
+// Downscale a tightly packed InputWidth x InputHeight frame in Format to
+// a tightly packed OutputWidth x OutputHeight frame in the same format and
+// row order.  Accumulator holds SCALE_ACCUMULATOR_COUNT (OutputWidth)
+// ULONGs.  Returns FALSE if the format (RGB24, BGRA, RGBA, NV12 and P010
+// are supported) or the sizes can't be scaled.
+//
+BOOLEAN
+ScaleFrame (
+    IN ULONG Format,
+    IN const UCHAR *Source,
+    IN ULONG InputWidth,
+    IN ULONG InputHeight,
+    OUT PUCHAR Destination,
+    IN ULONG OutputWidth,
+    IN ULONG OutputHeight,
+    IN PULONG Accumulator
+    );
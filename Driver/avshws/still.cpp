@@ -0,0 +1,628 @@
+/**************************************************************************
+
+    AVStream Simulated Hardware Sample
+
+    File:
+
+        still.cpp
+
+    Abstract:
+
+        This file contains source for the still pin on the capture filter.
+        See still.h.
+
+    History:
+
+        created 10/18/2026
+
+**************************************************************************/
+
+#include "avshws.h"
+
+/**************************************************************************
+
+    PAGEABLE CODE
+
+**************************************************************************/
+
+#ifdef ALLOC_PRAGMA
+#pragma code_seg("PAGE")
+#endif // ALLOC_PRAGMA
+
+
+CStillPin::
+CStillPin (
+    IN PKSPIN Pin
+    ) :
+    m_Pin (Pin)
+
+/*++
+
+Routine Description:
+
+    Construct a new still pin.
+
+Arguments:
+
+    Pin -
+        The AVStream pin object corresponding to the still pin
+
+Return Value:
+
+    None
+
+--*/
+
+{
+
+    PAGED_CODE();
+
+    PKSDEVICE Device = KsPinGetDevice (Pin);
+
+    m_Device = reinterpret_cast <CCaptureDevice *> (Device -> Context);
+
+}
+
+/*************************************************/
+
+
+NTSTATUS
+CStillPin::
+DispatchCreate (
+    IN PKSPIN Pin,
+    IN PIRP Irp
+    )
+
+/*++
+
+Routine Description:
+
+    Create a new still pin.  This is the creation dispatch for the video
+    still pin.
+
+Arguments:
+
+    Pin -
+        The pin being created
+
+    Irp -
+        The creation Irp
+
+Return Value:
+
+    Success / Failure
+
+--*/
+
+{
+
+    PAGED_CODE();
+
+    NTSTATUS Status = STATUS_SUCCESS;
+
+    CStillPin *StillPin = new (NonPagedPoolNx, 'niPS') CStillPin (Pin);
+
+    if (!StillPin) {
+
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+
+    } else {
+
+        Status = KsAddItemToObjectBag (
+            Pin -> Bag,
+            reinterpret_cast <PVOID> (StillPin),
+            reinterpret_cast <PFNKSFREE> (CStillPin::Cleanup)
+            );
+
+        if (!NT_SUCCESS (Status)) {
+            delete StillPin;
+        } else {
+            Pin -> Context = reinterpret_cast <PVOID> (StillPin);
+        }
+
+    }
+
+    //
+    // As on the capture pin, the framing is only known now that there is
+    // a connection format: one frame of biSizeImage.
+    //
+    if (NT_SUCCESS (Status)) {
+
+        StillPin -> CaptureFormat ();
+
+        Status = KsEdit (
+            Pin,
+            &Pin -> Descriptor,
+            AVSHWS_POOLTAG);
+
+        if (NT_SUCCESS (Status)) {
+
+            Status = KsEdit (
+                Pin,
+                &Pin -> Descriptor -> AllocatorFraming,
+                AVSHWS_POOLTAG);
+
+            if (NT_SUCCESS (Status)) {
+
+                PKSALLOCATOR_FRAMING_EX Framing =
+                    const_cast <PKSALLOCATOR_FRAMING_EX> (
+                        Pin -> Descriptor -> AllocatorFraming
+                        );
+
+                ULONG ImageSize = (reinterpret_cast
+                    <PKS_DATAFORMAT_VIDEOINFOHEADER> (
+                        Pin -> ConnectionFormat
+                        )) -> VideoInfoHeader.bmiHeader.biSizeImage;
+
+                Framing -> FramingItem [0].Frames = 2;
+
+                Framing -> FramingItem [0].PhysicalRange.MinFrameSize =
+                    Framing -> FramingItem [0].PhysicalRange.MaxFrameSize =
+                    Framing -> FramingItem [0].FramingRange.Range.MinFrameSize =
+                    Framing -> FramingItem [0].FramingRange.Range.MaxFrameSize =
+                    ImageSize;
+
+                Framing -> FramingItem [0].PhysicalRange.Stepping =
+                    Framing -> FramingItem [0].FramingRange.Range.Stepping =
+                    0;
+
+            }
+
+        }
+
+    }
+
+    if (NT_SUCCESS (Status)) {
+        //
+        // Stills carry the same extended header (KS_FRAME_INFO) as the
+        // video packets.
+        //
+        Pin -> StreamHeaderSize = sizeof (KSSTREAM_HEADER) +
+            sizeof (KS_FRAME_INFO);
+    }
+
+    return Status;
+
+}
+
+/*************************************************/
+
+
+void
+CStillPin::
+CaptureFormat (
+    )
+
+/*++
+
+Routine Description:
+
+    Take what the still copy is checked against out of the connection
+    format.  The format was validated by DispatchSetFormat.
+
+Arguments:
+
+    None
+
+Return Value:
+
+    None
+
+--*/
+
+{
+
+    PAGED_CODE();
+
+    PKS_VIDEOINFOHEADER VideoInfoHeader =
+        &((reinterpret_cast <PKS_DATAFORMAT_VIDEOINFOHEADER>
+            (m_Pin -> ConnectionFormat)) ->
+            VideoInfoHeader);
+
+    //
+    // The formats the synthesizers produce (see AcquireHardwareResources).
+    //
+    if (VideoInfoHeader -> bmiHeader.biCompression == FOURCC_P010) {
+        m_PixelFormat = AvshwsFormatP010;
+    } else if (VideoInfoHeader -> bmiHeader.biCompression == FOURCC_YUY2) {
+        m_PixelFormat = AvshwsFormatYuy2;
+    } else if (VideoInfoHeader -> bmiHeader.biBitCount == 32) {
+        m_PixelFormat = AvshwsFormatBgra;
+    } else {
+        m_PixelFormat = AvshwsFormatRgb24;
+    }
+
+    m_Width = (ULONG)VideoInfoHeader -> bmiHeader.biWidth;
+    m_Height = (ULONG)abs (VideoInfoHeader -> bmiHeader.biHeight);
+    m_TimePerFrame = VideoInfoHeader -> AvgTimePerFrame;
+
+}
+
+/*************************************************/
+
+
+NTSTATUS
+CStillPin::
+DispatchSetFormat (
+    IN PKSPIN Pin,
+    IN PKSDATAFORMAT OldFormat OPTIONAL,
+    IN PKSMULTIPLE_ITEM OldAttributeList OPTIONAL,
+    IN const KSDATARANGE *DataRange,
+    IN const KSATTRIBUTE_LIST *AttributeRange OPTIONAL
+    )
+
+/*++
+
+Routine Description:
+
+    This is the set data format dispatch for the still pin.  The still
+    pin has the capture pin's ranges, so the format is validated by the
+    capture pin's handler (as an initial format; it must not touch the
+    pin's context).  A format change is only accepted when stopped.
+
+Arguments:
+
+    Pin -
+        The pin this format is being set on.  The format itself will be in
+        Pin -> ConnectionFormat.
+
+    OldFormat -
+        The previous format used on this pin, NULL for the initial format
+
+    OldAttributeList -
+        The old attribute list for the prior format
+
+    DataRange -
+        The range out of our list of data ranges the format matched
+
+    AttributeRange -
+        The attribute range
+
+Return Value:
+
+    Success / Failure
+
+--*/
+
+{
+
+    PAGED_CODE();
+
+    NTSTATUS Status = CCapturePin::DispatchSetFormat (
+        Pin,
+        NULL,
+        OldAttributeList,
+        DataRange,
+        AttributeRange
+        );
+
+    if (NT_SUCCESS (Status) && OldFormat) {
+
+        if (Pin -> DeviceState == KSSTATE_STOP) {
+            (reinterpret_cast <CStillPin *> (Pin -> Context)) ->
+                CaptureFormat ();
+        } else {
+            Status = STATUS_INVALID_DEVICE_STATE;
+        }
+
+    }
+
+    return Status;
+
+}
+
+/*************************************************/
+
+
+NTSTATUS
+CStillPin::
+SetState (
+    IN KSSTATE ToState,
+    IN KSSTATE FromState
+    )
+
+/*++
+
+Routine Description:
+
+    The state transition handler for the still pin.  The still pin holds
+    no hardware resources; it only needs the clock, which is assigned
+    while stopped.
+
+Arguments:
+
+    ToState -
+        The state we're transitioning to
+
+    FromState -
+        The state we're transitioning away from
+
+Return Value:
+
+    Success / Failure
+
+--*/
+
+{
+
+    PAGED_CODE();
+
+    switch (ToState) {
+
+        case KSSTATE_STOP:
+
+            if (m_Clock) {
+                m_Clock -> Release ();
+                m_Clock = NULL;
+            }
+
+            //
+            // A trigger is for a still of the running stream, not of the
+            // next one.
+            //
+            InterlockedExchange (&m_Triggers, 0);
+
+            m_FrameNumber = 0;
+            break;
+
+        case KSSTATE_ACQUIRE:
+
+            if (FromState == KSSTATE_STOP) {
+
+                if (!NT_SUCCESS (
+                    KsPinGetReferenceClockInterface (
+                        m_Pin,
+                        &m_Clock
+                        )
+                    )) {
+
+                    m_Clock = NULL;
+
+                }
+
+            }
+            break;
+
+    }
+
+    return STATUS_SUCCESS;
+
+}
+
+/*************************************************/
+
+
+void
+CStillPin::
+Trigger (
+    )
+
+/*++
+
+Routine Description:
+
+    Request a still and kick processing to deliver it.  Called from the
+    filter's video control mode handler.
+
+Arguments:
+
+    None
+
+Return Value:
+
+    None
+
+--*/
+
+{
+
+    PAGED_CODE();
+
+    InterlockedIncrement (&m_Triggers);
+
+    KsPinAttemptProcessing (m_Pin, TRUE);
+
+}
+
+/*************************************************/
+
+
+NTSTATUS
+CStillPin::
+Process (
+    )
+
+/*++
+
+Routine Description:
+
+    Serve pending triggers.  Each trigger takes the buffer at the leading
+    edge, which the hardware simulation fills straight from the newest
+    injected frame, and advancing the leading edge completes it.  A
+    trigger there is no frame for (the capture pin isn't streaming this
+    format and size, or nothing was injected yet) is dropped rather than
+    served by a later frame.
+
+Arguments:
+
+    None
+
+Return Value:
+
+    STATUS_PENDING if there is no trigger to serve, so that processing
+    waits for the next one
+
+--*/
+
+{
+
+    PAGED_CODE();
+
+    NTSTATUS Status = STATUS_SUCCESS;
+
+    if (m_Triggers == 0) {
+        return STATUS_PENDING;
+    }
+
+    PKSSTREAM_POINTER Leading = KsPinGetLeadingEdgeStreamPointer (
+        m_Pin,
+        KSSTREAM_POINTER_STATE_LOCKED
+        );
+
+    while (Leading && m_Triggers > 0) {
+
+        if (NULL == Leading -> StreamHeader -> Data) {
+            Status = KsStreamPointerAdvance (Leading);
+        } else {
+
+            STREAM_POINTER_CONTEXT Context;
+
+            InterlockedDecrement (&m_Triggers);
+
+            if (m_Device -> DeliverStill (
+                    Leading -> StreamHeader,
+                    m_PixelFormat,
+                    m_Width,
+                    m_Height,
+                    &Context
+                    )) {
+
+                StampStill (Leading -> StreamHeader, &Context);
+
+                Status = KsStreamPointerAdvance (Leading);
+
+            }
+
+        }
+
+        //
+        // If we run off the end of the queue, Status will be
+        // STATUS_DEVICE_NOT_READY and the leading edge is no longer locked.
+        //
+        if (!NT_SUCCESS (Status)) {
+            Leading = NULL;
+        }
+
+    }
+
+    if (Leading) {
+        KsStreamPointerUnlock (Leading, FALSE);
+    }
+
+    return STATUS_SUCCESS;
+
+}
+
+/*************************************************/
+
+
+void
+CStillPin::
+StampStill (
+    IN PKSSTREAM_HEADER StreamHeader,
+    IN PSTREAM_POINTER_CONTEXT Context
+    )
+
+/*++
+
+Routine Description:
+
+    Set the duration, timestamp and frame info of a still.  With a clock,
+    the still is stamped with the capture instant of its frame if the
+    producer stamped it, else with the time it is delivered.
+
+Arguments:
+
+    StreamHeader -
+        The stream header of the filled buffer
+
+    Context -
+        The capture instant of the frame in the buffer
+
+Return Value:
+
+    None
+
+--*/
+
+{
+
+    PAGED_CODE();
+
+    StreamHeader -> Duration = m_TimePerFrame;
+
+    StreamHeader -> PresentationTime.Numerator =
+        StreamHeader -> PresentationTime.Denominator = 1;
+
+    if (m_Clock) {
+
+        LONGLONG ClockTime = m_Clock -> GetTime ();
+
+        if (Context -> ProducerTimeValid) {
+
+            LONGLONG Age = QueryPerformanceTime () - Context -> ProducerTime;
+
+            if (Age > 0) {
+                ClockTime -= Age;
+            }
+
+        }
+
+        if (m_FrameNumber && ClockTime <= m_PresentationTime) {
+            ClockTime = m_PresentationTime + 1;
+        }
+
+        m_PresentationTime = ClockTime;
+
+        StreamHeader -> PresentationTime.Time = ClockTime;
+
+        StreamHeader -> OptionsFlags =
+            KSSTREAM_HEADER_OPTIONSF_TIMEVALID |
+            KSSTREAM_HEADER_OPTIONSF_DURATIONVALID;
+
+    } else {
+        StreamHeader -> PresentationTime.Time = 0;
+    }
+
+    m_FrameNumber++;
+
+    if (StreamHeader -> Size >= sizeof (KSSTREAM_HEADER) +
+        sizeof (KS_FRAME_INFO)) {
+
+        PKS_FRAME_INFO FrameInfo = reinterpret_cast <PKS_FRAME_INFO> (
+            StreamHeader + 1
+            );
+
+        FrameInfo -> ExtendedHeaderSize = sizeof (KS_FRAME_INFO);
+        FrameInfo -> dwFrameFlags       = KS_VIDEO_FLAG_FRAME;
+        FrameInfo -> PictureNumber      = (LONGLONG)m_FrameNumber;
+        FrameInfo -> DropCount          = 0;
+    }
+
+}
+
+/**************************************************************************
+
+    DISPATCH AND DESCRIPTOR LAYOUT
+
+**************************************************************************/
+
+//
+// StillPinDispatch:
+//
+// This is the dispatch table for the still pin.
+//
+const
+KSPIN_DISPATCH
+StillPinDispatch = {
+    CStillPin::DispatchCreate,              // Pin Create
+    NULL,                                   // Pin Close
+    CStillPin::DispatchProcess,             // Pin Process
+    NULL,                                   // Pin Reset
+    CStillPin::DispatchSetFormat,           // Pin Set Data Format
+    CStillPin::DispatchSetState,            // Pin Set Device State
+    NULL,                                   // Pin Connect
+    NULL,                                   // Pin Disconnect
+    NULL,                                   // Clock Dispatch
+    NULL                                    // Allocator Dispatch
+};
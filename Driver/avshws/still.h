@@ -0,0 +1,231 @@
+/**************************************************************************
+
+    AVStream Simulated Hardware Sample
+
+    File:
+
+        still.h
+
+    Abstract:
+
+        This file contains header for the still pin on the capture filter.
+        The still pin delivers one frame per trigger (the video control
+        trigger, KS_VideoControlFlag_Trigger) copied from the newest
+        injected frame, alongside the video capture pin.  It holds no
+        hardware resources and has no part in the ticks, so the capture
+        pin's pacing is not affected by stills.
+
+    History:
+
+        created 10/18/2026
+
+**************************************************************************/
+
+//
+// CStillPin:
+//
+// The still pin class.
+//
+class CStillPin {
+
+private:
+
+    //
+    // The AVStream pin we're associated with.
+    //
+    PKSPIN m_Pin;
+
+    //
+    // Pointer to the internal device object for our capture device.
+    //
+    CCaptureDevice *m_Device;
+
+    //
+    // The clock we've been assigned, if any, to time stamp stills with.
+    //
+    PIKSREFERENCECLOCK m_Clock;
+
+    //
+    // The connection format: the AVSHWS_PIXEL_FORMAT, size and frame
+    // period.  Stills are only delivered while the capture pin streams the
+    // same format and size.
+    //
+    ULONG m_PixelFormat;
+    ULONG m_Width;
+    ULONG m_Height;
+    LONGLONG m_TimePerFrame;
+
+    //
+    // Triggers not yet served.  Bumped by Trigger, taken by Process.
+    //
+    volatile LONG m_Triggers;
+
+    //
+    // The timestamp of the last still and the number of stills delivered
+    // since the pin was stopped.
+    //
+    LONGLONG m_PresentationTime;
+    LONGLONG m_FrameNumber;
+
+    //
+    // CaptureFormat():
+    //
+    // Take the pixel format, size and frame period out of the connection
+    // format.
+    //
+    void
+    CaptureFormat (
+        );
+
+    //
+    // SetState():
+    //
+    // The state transition handler for the still pin.  Gets and releases
+    // the clock and forgets triggers on stop.
+    //
+    NTSTATUS
+    SetState (
+        IN KSSTATE ToState,
+        IN KSSTATE FromState
+        );
+
+    //
+    // Process():
+    //
+    // The processing dispatch for the still pin: serve pending triggers
+    // with the buffers at the leading edge.
+    //
+    NTSTATUS
+    Process (
+        );
+
+    //
+    // StampStill():
+    //
+    // Set the duration, timestamp and frame info of a filled still buffer.
+    // Context holds the capture instant of the frame in it.
+    //
+    void
+    StampStill (
+        IN PKSSTREAM_HEADER StreamHeader,
+        IN PSTREAM_POINTER_CONTEXT Context
+        );
+
+    //
+    // Cleanup():
+    //
+    // The free callback from the bagged item (CStillPin).
+    //
+    static
+    void
+    Cleanup (
+        IN CStillPin *Pin
+        )
+    {
+        delete Pin;
+    }
+
+public:
+
+    //
+    // CStillPin():
+    //
+    // The still pin's constructor.  Only non-0, non-NULL fields are
+    // initialized.
+    //
+    CStillPin (
+        IN PKSPIN Pin
+        );
+
+    //
+    // ~CStillPin():
+    //
+    // The still pin's destructor.
+    //
+    ~CStillPin (
+        )
+    {
+    }
+
+    //
+    // Trigger():
+    //
+    // Request a still.  It is delivered in the next buffer at the leading
+    // edge once the pin runs.
+    //
+    void
+    Trigger (
+        );
+
+    /*************************************************
+
+        Dispatch Routines
+
+    *************************************************/
+
+    //
+    // DispatchCreate():
+    //
+    // This is the creation dispatch for the still pin.  It creates the
+    // CStillPin object and bags it with the AVStream pin.
+    //
+    static
+    NTSTATUS
+    DispatchCreate (
+        IN PKSPIN Pin,
+        IN PIRP Irp
+        );
+
+    //
+    // DispatchSetState():
+    //
+    // The set device state dispatch for the pin.  Bridges to SetState()
+    // in the context of the CStillPin.
+    //
+    static
+    NTSTATUS
+    DispatchSetState (
+        IN PKSPIN Pin,
+        IN KSSTATE ToState,
+        IN KSSTATE FromState
+        )
+    {
+        return
+            (reinterpret_cast <CStillPin *> (Pin -> Context)) ->
+                SetState (ToState, FromState);
+    }
+
+    //
+    // DispatchSetFormat():
+    //
+    // The set data format dispatch for the pin.  The format is validated
+    // as for the capture pin, which has the same ranges.
+    //
+    static
+    NTSTATUS
+    DispatchSetFormat (
+        IN PKSPIN Pin,
+        IN PKSDATAFORMAT OldFormat OPTIONAL,
+        IN PKSMULTIPLE_ITEM OldAttributeList OPTIONAL,
+        IN const KSDATARANGE *DataRange,
+        IN const KSATTRIBUTE_LIST *AttributeRange OPTIONAL
+        );
+
+    //
+    // DispatchProcess():
+    //
+    // The processing dispatch for the still pin.  Bridges to Process() in
+    // the context of the CStillPin.
+    //
+    static
+    NTSTATUS
+    DispatchProcess (
+        IN PKSPIN Pin
+        )
+    {
+        return
+            (reinterpret_cast <CStillPin *> (Pin -> Context)) ->
+                Process ();
+    }
+
+};
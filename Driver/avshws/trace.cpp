@@ -0,0 +1,253 @@
+/**************************************************************************
+
+    AVStream Simulated Hardware Sample
+
+    File:
+
+        trace.cpp
+
+    Abstract:
+
+        The event trace.  See trace.h.
+
+    History:
+
+        created 10/18/2026
+
+**************************************************************************/
+
+#include "avshws.h"
+
+C_ASSERT ((TRACE_RING_DEPTH & (TRACE_RING_DEPTH - 1)) == 0);
+C_ASSERT (sizeof (AVSHWS_TRACE_RECORD) == 24);
+
+/**************************************************************************
+
+    PAGEABLE CODE
+
+**************************************************************************/
+
+#ifdef ALLOC_PRAGMA
+#pragma code_seg("PAGE")
+#endif // ALLOC_PRAGMA
+
+
+NTSTATUS
+CEventTrace::
+Enable (
+    IN BOOLEAN Enable
+    )
+
+/*++
+
+Routine Description:
+
+    Turn recording on or off.  The rings are allocated the first time
+    recording is turned on and emptied every time it is.
+
+Arguments:
+
+    Enable -
+        Whether to record events
+
+Return Value:
+
+    Success / Failure
+
+--*/
+
+{
+
+    PAGED_CODE();
+
+    if (!Enable) {
+        m_Enabled = FALSE;
+        return STATUS_SUCCESS;
+    }
+
+    if (!m_Rings) {
+
+        ULONG Processors = KeQueryMaximumProcessorCountEx (ALL_PROCESSOR_GROUPS);
+
+        PTRACE_RING Rings = reinterpret_cast <PTRACE_RING> (
+            ExAllocatePoolWithTag (
+                NonPagedPoolNx,
+                Processors * sizeof (TRACE_RING),
+                AVSHWS_POOLTAG
+                )
+            );
+
+        if (!Rings) {
+            return STATUS_INSUFFICIENT_RESOURCES;
+        }
+
+        RtlZeroMemory (Rings, Processors * sizeof (TRACE_RING));
+
+        //
+        // Two enables may race; the loser frees its rings.
+        //
+        if (InterlockedCompareExchangePointer (
+                reinterpret_cast <PVOID volatile *> (&m_Rings),
+                Rings,
+                NULL
+                ) != NULL) {
+            ExFreePool (Rings);
+        } else {
+            m_Processors = Processors;
+        }
+
+    }
+
+    if (!m_Enabled) {
+
+        for (ULONG i = 0; i < m_Processors; i++) {
+            InterlockedExchange (&m_Rings [i].Next, 0);
+        }
+
+        m_Enabled = TRUE;
+
+    }
+
+    return STATUS_SUCCESS;
+
+}
+
+/*************************************************/
+
+
+ULONG
+CEventTrace::
+Dump (
+    OUT PAVSHWS_TRACE_DUMP Dump,
+    IN ULONG Length
+    )
+
+/*++
+
+Routine Description:
+
+    Copy the rings out, oldest record first for each processor.  Records
+    of different processors are not merged; the timestamps order them.
+    A record being written while the dump is taken may be torn, so dump
+    after turning recording off for an exact trace.
+
+Arguments:
+
+    Dump -
+        Receives the header followed by the records
+
+    Length -
+        The size of Dump in bytes, at least sizeof (AVSHWS_TRACE_DUMP)
+
+Return Value:
+
+    The number of bytes written
+
+--*/
+
+{
+
+    PAGED_CODE();
+
+    NT_ASSERT (Length >= sizeof (AVSHWS_TRACE_DUMP));
+
+    ULONG Room = (Length - sizeof (AVSHWS_TRACE_DUMP)) /
+        sizeof (AVSHWS_TRACE_RECORD);
+
+    PAVSHWS_TRACE_RECORD Out = reinterpret_cast <PAVSHWS_TRACE_RECORD> (
+        Dump + 1
+        );
+
+    Dump -> Size = sizeof (AVSHWS_TRACE_DUMP);
+    Dump -> Enabled = m_Enabled;
+    Dump -> Processors = m_Processors;
+    Dump -> RecordsAvailable = 0;
+    Dump -> RecordCount = 0;
+
+    for (ULONG i = 0; i < m_Processors; i++) {
+
+        ULONG Next = (ULONG)m_Rings [i].Next;
+        ULONG Count = Next < TRACE_RING_DEPTH ? Next : TRACE_RING_DEPTH;
+
+        Dump -> RecordsAvailable += Count;
+
+        for (ULONG n = Next - Count; n != Next && Dump -> RecordCount < Room; n++) {
+            Out [Dump -> RecordCount++] =
+                m_Rings [i].Records [n & (TRACE_RING_DEPTH - 1)];
+        }
+
+    }
+
+    return sizeof (AVSHWS_TRACE_DUMP) +
+        Dump -> RecordCount * sizeof (AVSHWS_TRACE_RECORD);
+
+}
+
+/**************************************************************************
+
+    LOCKED CODE
+
+**************************************************************************/
+
+#ifdef ALLOC_PRAGMA
+#pragma code_seg()
+#endif // ALLOC_PRAGMA
+
+
+void
+CEventTrace::
+Write (
+    IN ULONG Event,
+    IN ULONG Generation,
+    IN ULONG Arg1,
+    IN ULONG Arg2
+    )
+
+/*++
+
+Routine Description:
+
+    Append a record to the ring of the current processor.  The slot is
+    reserved with an interlocked increment, so a record interrupted by
+    another on the same processor (a DPC preempting SetData), or written
+    after the thread moved to another processor, never shares its slot.
+
+Arguments:
+
+    Event -
+        The AVSHWS_TRACE_EVENT
+
+    Generation -
+        The injected frame the event is about, zero if none
+
+    Arg1, Arg2 -
+        Event specific, see AVSHWS_TRACE_EVENT
+
+Return Value:
+
+    None
+
+--*/
+
+{
+
+    ULONG Processor = KeGetCurrentProcessorNumberEx (NULL);
+
+    if (Processor >= m_Processors) {
+        return;
+    }
+
+    PTRACE_RING Ring = &m_Rings [Processor];
+    ULONG Slot = ((ULONG)InterlockedIncrement (&Ring -> Next) - 1) &
+        (TRACE_RING_DEPTH - 1);
+
+    PAVSHWS_TRACE_RECORD Record = &Ring -> Records [Slot];
+
+    Record -> Timestamp = QueryPerformanceTime ();
+    Record -> Event = (USHORT)Event;
+    Record -> Processor = (USHORT)Processor;
+    Record -> Generation = Generation;
+    Record -> Arg1 = Arg1;
+    Record -> Arg2 = Arg2;
+
+}
@@ -0,0 +1,166 @@
+/**************************************************************************
+
+    AVStream Simulated Hardware Sample
+
+    File:
+
+        trace.h
+
+    Abstract:
+
+        The event trace.  The frame path records fixed size binary events
+        (see AVSHWS_TRACE_RECORD) into one ring per processor: SetData
+        entry and exit, the simulated interrupt, scatter / gather program,
+        fill and completion, and clone deletion.  Together they give the
+        timeline of every injected frame through the driver.
+
+        Tracing is always compiled in.  While it is off, recording an event
+        costs one test of a flag.  While it is on, a record takes an
+        interlocked increment on the ring of the current processor and no
+        lock, so it may be written at any IRQL.  The rings are dumped through
+        KSPROPERTY_CUSTOMCONTROL_TRACE.
+
+    History:
+
+        created 10/18/2026
+
+**************************************************************************/
+
+//
+// TRACE_RING_DEPTH:
+//
+// The number of records kept per processor.  Must be a power of two.
+//
+#define TRACE_RING_DEPTH 2048
+
+//
+// TRACE_RING:
+//
+// The records of one processor.  Next counts the records ever reserved;
+// record N is in slot N % TRACE_RING_DEPTH.
+//
+typedef struct _TRACE_RING {
+
+    volatile LONG Next;
+    AVSHWS_TRACE_RECORD Records [TRACE_RING_DEPTH];
+
+} TRACE_RING, *PTRACE_RING;
+
+/*************************************************
+
+    CEventTrace
+
+    Enable and Dump must be called at PASSIVE_LEVEL; Record may be called
+    at any IRQL up to DISPATCH_LEVEL.
+
+*************************************************/
+
+class CEventTrace {
+
+private:
+
+    //
+    // Whether events are recorded.
+    //
+    volatile BOOLEAN m_Enabled;
+
+    //
+    // One ring per possible processor, allocated when tracing is first
+    // enabled and kept until the trace is destroyed, so that a record
+    // racing with a disable never touches freed memory.
+    //
+    ULONG m_Processors;
+    PTRACE_RING m_Rings;
+
+    //
+    // Write():
+    //
+    // Append a record to the ring of the current processor.
+    //
+    void
+    Write (
+        IN ULONG Event,
+        IN ULONG Generation,
+        IN ULONG Arg1,
+        IN ULONG Arg2
+        );
+
+public:
+
+    //
+    // CEventTrace():
+    //
+    // Construct a disabled trace.
+    //
+    CEventTrace (
+        ) :
+        m_Enabled (FALSE),
+        m_Processors (0),
+        m_Rings (NULL)
+    {
+    }
+
+    //
+    // ~CEventTrace():
+    //
+    // Free the rings.
+    //
+    ~CEventTrace (
+        )
+    {
+        if (m_Rings) {
+            ExFreePool (m_Rings);
+        }
+    }
+
+    //
+    // Enable():
+    //
+    // Turn recording on, starting with empty rings, or off.  The records
+    // are kept when recording is turned off, so the trace can be dumped
+    // without being overwritten.
+    //
+    NTSTATUS
+    Enable (
+        IN BOOLEAN Enable
+        );
+
+    BOOLEAN
+    IsEnabled (
+        )
+    {
+        return m_Enabled;
+    }
+
+    //
+    // Record():
+    //
+    // Record an event (an AVSHWS_TRACE_EVENT) about the injected frame
+    // Generation (zero if none) if tracing is on.
+    //
+    void
+    Record (
+        IN ULONG Event,
+        IN ULONG Generation,
+        IN ULONG Arg1,
+        IN ULONG Arg2
+        )
+    {
+        if (m_Enabled) {
+            Write (Event, Generation, Arg1, Arg2);
+        }
+    }
+
+    //
+    // Dump():
+    //
+    // Copy the header and as many records as fit into Length bytes at
+    // Dump.  Returns the number of bytes written.
+    //
+    ULONG
+    Dump (
+        OUT PAVSHWS_TRACE_DUMP Dump,
+        IN ULONG Length
+        );
+
+};
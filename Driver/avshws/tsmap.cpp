@@ -0,0 +1,159 @@
+/**************************************************************************
+
+    AVStream Simulated Hardware Sample
+
+    File:
+
+        tsmap.cpp
+
+    Abstract:
+
+        Mapping of producer capture timestamps.  See tsmap.h.
+
+        This entire file is called at DPC and must be in locked segments.
+
+    History:
+
+        created 10/18/2026
+
+**************************************************************************/
+
+#include "portable.h"
+
+/**************************************************************************
+
+    LOCKED CODE
+
+**************************************************************************/
+
+#ifdef ALLOC_PRAGMA
+#pragma code_seg()
+#endif // ALLOC_PRAGMA
+
+
+LONGLONG
+TsMapProducerTime (
+    IN LONGLONG ClockTime,
+    IN LONGLONG PerformanceTime,
+    IN LONGLONG ProducerTime
+    )
+
+/*++
+
+Routine Description:
+
+    Translate a producer's capture instant into the clock domain.
+
+Arguments:
+
+    ClockTime -
+        A reading of the graph clock
+
+    PerformanceTime -
+        A reading of the performance counter, in 100ns units, taken with
+        ClockTime
+
+    ProducerTime -
+        The capture instant of the frame on the performance counter
+
+Return Value:
+
+    The capture instant on the graph clock
+
+--*/
+
+{
+
+    LONGLONG Age = PerformanceTime - ProducerTime;
+
+    return Age > 0 ? ClockTime - Age : ClockTime;
+
+}
+
+/*************************************************/
+
+
+LONGLONG
+TsBatchTime (
+    IN LONGLONG ClockTime,
+    IN ULONG Count,
+    IN ULONG Index,
+    IN LONGLONG Period
+    )
+
+/*++
+
+Routine Description:
+
+    Place a buffer of a batch on the frame schedule.
+
+Arguments:
+
+    ClockTime -
+        The reading of the graph clock for the batch
+
+    Count -
+        The number of buffers in the batch
+
+    Index -
+        The position of the buffer in the batch, oldest first
+
+    Period -
+        The frame period, in 100ns units
+
+Return Value:
+
+    The time of the buffer on the graph clock
+
+--*/
+
+{
+
+    NT_ASSERT (Index < Count);
+
+    return ClockTime - (LONGLONG)(Count - 1 - Index) * Period;
+
+}
+
+/*************************************************/
+
+
+LONGLONG
+TsKeepMonotonic (
+    IN BOOLEAN First,
+    IN LONGLONG Previous,
+    IN LONGLONG Time
+    )
+
+/*++
+
+Routine Description:
+
+    Keep a stream's timestamps strictly increasing.
+
+Arguments:
+
+    First -
+        TRUE for the first timestamp of the stream
+
+    Previous -
+        The previous timestamp of the stream
+
+    Time -
+        The timestamp wanted
+
+Return Value:
+
+    The timestamp to use
+
+--*/
+
+{
+
+    if (!First && Time <= Previous) {
+        return Previous + 1;
+    }
+
+    return Time;
+
+}
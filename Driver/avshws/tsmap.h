@@ -0,0 +1,71 @@
+/**************************************************************************
+
+    AVStream Simulated Hardware Sample
+
+    File:
+
+        tsmap.h
+
+    Abstract:
+
+        Mapping of producer capture timestamps into the graph clock domain.
+        A producer stamps a frame with the performance counter when it
+        captures it; the buffer carrying the frame completes later, after
+        queueing and DPC latency.  The graph clock and the performance
+        counter are read together when the buffer completes, so the age of
+        the frame on the performance counter is taken off the clock reading
+        and the latency drops out of the timestamp.
+
+        Nothing in here touches the kernel or reads a clock: the caller
+        passes the readings in.
+
+    History:
+
+        created 10/18/2026
+
+**************************************************************************/
+
+//
+// TsMapProducerTime():
+//
+// The clock time at which a frame stamped ProducerTime was captured, given
+// ClockTime and PerformanceTime read together.  A stamp ahead of
+// PerformanceTime maps to ClockTime: a frame can't be captured after it
+// is delivered.
+//
+LONGLONG
+TsMapProducerTime (
+    IN LONGLONG ClockTime,
+    IN LONGLONG PerformanceTime,
+    IN LONGLONG ProducerTime
+    );
+
+//
+// TsBatchTime():
+//
+// The time of buffer Index (oldest first) of a batch of Count completed
+// together at ClockTime, with the buffers filled Period apart and the
+// newest just before ClockTime was read.  A DPC that runs late catches up
+// with such a batch, and the clock is read once for all of it.
+//
+LONGLONG
+TsBatchTime (
+    IN LONGLONG ClockTime,
+    IN ULONG Count,
+    IN ULONG Index,
+    IN LONGLONG Period
+    );
+
+//
+// TsKeepMonotonic():
+//
+// Time, or just after Previous if Time isn't later, so that a stream's
+// timestamps strictly increase even if the producer's go back or a frame
+// is delivered twice.  First means there is no previous timestamp.
+//
+LONGLONG
+TsKeepMonotonic (
+    IN BOOLEAN First,
+    IN LONGLONG Previous,
+    IN LONGLONG Time
+    );
@@ -0,0 +1,110 @@
+/**************************************************************************
+
+    AVStream Simulated Hardware Sample
+
+    File:
+
+        watchdog.cpp
+
+    Abstract:
+
+        The producer stall watchdog.  See watchdog.h.
+
+        This entire file is called at DPC and must be in locked segments.
+
+    History:
+
+        created 10/18/2026
+
+**************************************************************************/
+
+#include "portable.h"
+
+/**************************************************************************
+
+    LOCKED CODE
+
+**************************************************************************/
+
+#ifdef ALLOC_PRAGMA
+#pragma code_seg()
+#endif // ALLOC_PRAGMA
+
+
+void
+CStallWatchdog::
+Start (
+    IN LONGLONG Now
+    )
+
+/*++
+
+Routine Description:
+
+    Reset the watchdog for a stream started at Now.
+
+Arguments:
+
+    Now -
+        The start time, in 100ns units
+
+Return Value:
+
+    None
+
+--*/
+
+{
+
+    m_LastInjectTime = Now;
+    m_NoSignal = FALSE;
+    m_Switches = 0;
+
+}
+
+/*************************************************/
+
+
+BOOLEAN
+CStallWatchdog::
+Check (
+    IN LONGLONG Now,
+    IN BOOLEAN SlateReady
+    )
+
+/*++
+
+Routine Description:
+
+    Decide whether the tick at Now delivers the slate: the timeout is set,
+    there is a slate and more than the timeout has passed since the last
+    frame.  A frame injected after Now was read counts as on time.
+
+Arguments:
+
+    Now -
+        The tick time, in 100ns units
+
+    SlateReady -
+        Whether there is a slate for the stream
+
+Return Value:
+
+    TRUE if the slate is delivered
+
+--*/
+
+{
+
+    BOOLEAN NoSignal = SlateReady && m_Timeout != 0 &&
+        Now - m_LastInjectTime > (LONGLONG)m_Timeout * 10000;
+
+    if (NoSignal && !m_NoSignal) {
+        InterlockedIncrement (&m_Switches);
+    }
+
+    m_NoSignal = NoSignal;
+
+    return NoSignal;
+
+}
@@ -0,0 +1,131 @@
+/**************************************************************************
+
+    AVStream Simulated Hardware Sample
+
+    File:
+
+        watchdog.h
+
+    Abstract:
+
+        The producer stall watchdog.  Once no frame has been injected for
+        the timeout, the producer is taken to be gone and each tick
+        delivers the no signal slate instead of the synthesis buffer, until
+        the producer injects again.  Switches to the slate are counted for
+        AVSHWS_STATISTICS.
+
+        The watchdog only compares times it is given, so it runs on a fake
+        clock on the host (see Tests/WatchdogTest).
+
+    History:
+
+        created 10/18/2026
+
+**************************************************************************/
+
+/*************************************************
+
+    CStallWatchdog
+
+    Inject and Check are serialized by the caller (the hardware simulation
+    calls both under its frame lock).  The state may be read from anywhere.
+
+*************************************************/
+
+class CStallWatchdog {
+
+private:
+
+    //
+    // The timeout in milliseconds, zero to never show the slate.
+    //
+    ULONG m_Timeout;
+
+    //
+    // The time of the last injected frame, or of the start if none was
+    // injected since.  In 100ns units.
+    //
+    LONGLONG m_LastInjectTime;
+
+    //
+    // Whether the last Check chose the slate, and how many times since
+    // Start it switched to it.
+    //
+    BOOLEAN m_NoSignal;
+    volatile LONG m_Switches;
+
+public:
+
+    //
+    // SetTimeout() / GetTimeout():
+    //
+    // The time without an injected frame after which the slate is shown,
+    // in milliseconds, or zero to never show it.
+    //
+    void
+    SetTimeout (
+        IN ULONG Timeout
+        )
+    {
+        m_Timeout = Timeout;
+    }
+
+    ULONG
+    GetTimeout (
+        )
+    {
+        return m_Timeout;
+    }
+
+    //
+    // Start():
+    //
+    // Reset for a stream started at Now.  The producer gets the timeout
+    // from the start for its first frame.
+    //
+    void
+    Start (
+        IN LONGLONG Now
+        );
+
+    //
+    // Inject():
+    //
+    // Note a frame injected at Time.
+    //
+    void
+    Inject (
+        IN LONGLONG Time
+        )
+    {
+        m_LastInjectTime = Time;
+    }
+
+    //
+    // Check():
+    //
+    // Decide for the tick at Now whether the slate is delivered.  SlateReady
+    // is whether there is a slate for the stream; without one the stream
+    // keeps repeating its last frame.  Returns TRUE for the slate.
+    //
+    BOOLEAN
+    Check (
+        IN LONGLONG Now,
+        IN BOOLEAN SlateReady
+        );
+
+    BOOLEAN
+    IsNoSignal (
+        )
+    {
+        return m_NoSignal;
+    }
+
+    ULONG
+    GetSwitches (
+        )
+    {
+        return (ULONG)m_Switches;
+    }
+
+};
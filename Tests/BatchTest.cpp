@@ -0,0 +1,191 @@
+//
+// Catch-up bursts of mapped buffer completions, the way
+// CCapturePin::CompleteMappings finishes them.  A DPC that runs late
+// completes 1 to 16 buffers at once; each is stamped and its stream header
+// and KS_FRAME_INFO finished.  Two ways are compared:
+//
+//     per buffer, reading the clock, the performance counter and the drop
+//     count for each one (how buffers used to be completed)
+//     batched, reading them once and placing the buffers on the frame
+//     schedule (tsmap.h)
+//
+// The batched stamps must be exactly a frame period apart and end at the
+// clock reading, however large the burst, and strictly increase across
+// bursts.  The per buffer stamps bunch up at the time of the DPC.
+//
+// The kernel's clock reads go through the clock's interface and the
+// performance counter; here a read is the host's monotonic clock called
+// through a pointer, so that it isn't optimized away.
+//
+
+#include "portable.h"
+
+#include <vector>
+
+#include "Test.h"
+
+#define FRAME_PERIOD 333667
+#define BURSTS 20000
+#define MAX_BURST 16
+
+// The part of a stream header and its KS_FRAME_INFO a completion fills in.
+struct Header
+{
+	LONGLONG presentationTime;
+	LONGLONG duration;
+	ULONG numerator;
+	ULONG denominator;
+	ULONG optionsFlags;
+	LONGLONG pictureNumber;
+	LONGLONG dropCount;
+	ULONG extendedFlags;
+};
+
+static LONGLONG HostClock()
+{
+	return (LONGLONG)(TestSeconds() * 1e7);
+}
+
+static LONGLONG (*volatile g_ReadClock)() = HostClock;
+static volatile LONG g_DropCount = 0;
+
+struct Stream
+{
+	LONGLONG frameNumber;
+	LONGLONG previous;
+
+	Stream() : frameNumber(0), previous(0)
+	{
+	}
+
+	void Finish(Header& header, LONGLONG time, LONGLONG dropCount)
+	{
+		header.presentationTime = TsKeepMonotonic(frameNumber == 0, previous, time);
+		header.duration = FRAME_PERIOD;
+		header.numerator = header.denominator = 1;
+		header.optionsFlags = 0x200;
+		header.pictureNumber = ++frameNumber;
+		header.dropCount = dropCount;
+		header.extendedFlags = 0;
+
+		previous = header.presentationTime;
+	}
+
+	// Reads the clock, the performance counter and the drop count for each
+	// buffer.
+	void PerBuffer(Header* headers, ULONG count)
+	{
+		for (ULONG i = 0; i < count; i++)
+		{
+			LONGLONG clockTime = g_ReadClock();
+			LONGLONG performanceTime = g_ReadClock();
+
+			(void)performanceTime;
+			Finish(headers[i], clockTime, g_DropCount);
+		}
+	}
+
+	// Reads them once for the burst.
+	void Batched(Header* headers, ULONG count, LONGLONG clockTime)
+	{
+		LONGLONG performanceTime = g_ReadClock();
+		LONGLONG dropCount = g_DropCount;
+
+		(void)performanceTime;
+
+		for (ULONG i = 0; i < count; i++)
+		{
+			Finish(headers[i], TsBatchTime(clockTime, count, i, FRAME_PERIOD), dropCount);
+		}
+	}
+};
+
+static void TestSchedule()
+{
+	Stream stream;
+	Header headers[MAX_BURST];
+	LONGLONG clock = 1000000000LL;
+	LONGLONG last = 0;
+
+	// A stream completing in bursts of every size, each DPC on time for its
+	// newest buffer.
+	for (ULONG count = 1; count <= MAX_BURST; count++)
+	{
+		clock += count * FRAME_PERIOD;
+		stream.Batched(headers, count, clock);
+
+		CHECK(headers[count - 1].presentationTime == clock);
+		CHECK(headers[0].presentationTime > last);
+
+		for (ULONG i = 1; i < count; i++)
+		{
+			CHECK(headers[i].presentationTime - headers[i - 1].presentationTime == FRAME_PERIOD);
+		}
+
+		last = headers[count - 1].presentationTime;
+	}
+
+	CHECK(stream.frameNumber == MAX_BURST * (MAX_BURST + 1) / 2);
+
+	// A burst completed early, with its oldest buffer placed before the
+	// last one stamped, still increases.
+	stream.Batched(headers, 4, last + FRAME_PERIOD);
+	CHECK(headers[0].presentationTime == last + 1);
+	CHECK(headers[3].presentationTime == last + FRAME_PERIOD);
+
+	CHECK(TsBatchTime(5000, 1, 0, FRAME_PERIOD) == 5000);
+	CHECK(TsBatchTime(5000, 3, 0, 100) == 4800);
+}
+
+static void Benchmark()
+{
+	std::vector<Header> headers(MAX_BURST);
+
+	printf("burst   per buffer   batched   (ns per burst)  stamp spread per buffer\n");
+
+	for (ULONG count = 1; count <= MAX_BURST; count++)
+	{
+		Stream perBuffer;
+		Stream batched;
+
+		double start = TestSeconds();
+
+		for (int i = 0; i < BURSTS; i++)
+		{
+			perBuffer.PerBuffer(headers.data(), count);
+		}
+
+		double perBufferTime = TestSeconds() - start;
+
+		LONGLONG spread = headers[count - 1].presentationTime - headers[0].presentationTime;
+
+		start = TestSeconds();
+
+		// The bursts of a real stream are at least their frame periods
+		// apart; here they are back to back, so the clock is moved on.
+		for (int i = 0; i < BURSTS; i++)
+		{
+			batched.Batched(headers.data(), count, g_ReadClock() + (LONGLONG)i * MAX_BURST * FRAME_PERIOD);
+		}
+
+		double batchedTime = TestSeconds() - start;
+
+		// A burst of catch-up frames covers count - 1 frame periods; read
+		// per buffer it covers the time it takes to complete them.
+		CHECK(headers[count - 1].presentationTime - headers[0].presentationTime == (LONGLONG)(count - 1) * FRAME_PERIOD);
+
+		printf("%5lu   %10.1f   %7.1f                   %6.1f us\n",
+			(unsigned long)count,
+			perBufferTime / BURSTS * 1e9,
+			batchedTime / BURSTS * 1e9,
+			spread / 10.0);
+	}
+}
+
+int main()
+{
+	TestSchedule();
+	Benchmark();
+
+	return TestResult();
+}
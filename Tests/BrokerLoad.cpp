@@ -0,0 +1,212 @@
+//
+// The frame broker under load: cameras with BrokerStubSink sinks, each
+// with a feed, and layers spread over them, every producer a thread of
+// this process publishing full frames over its own connection at the
+// cameras' rate.  The feeds' frames are checked whole as they reach the
+// cameras (the layers are transparent, so they are composited without
+// changing the feed), and the broker's rate and the latency from publish
+// to camera are measured.
+//
+//     BrokerLoad [producers [cameras [seconds [width height [fps]]]]]
+//
+// The defaults are the 32 producer benchmark: 16 cameras of 1280x720 at
+// 30 fps with a feed and a layer each, for 10 seconds.  ctest runs it
+// smaller and shorter.
+//
+
+#include "Broker.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "Test.h"
+
+static uint32_t g_Width = 1280;
+static uint32_t g_Height = 720;
+static uint32_t g_FramesPerSecond = 30;
+static std::atomic<bool> g_Stop(false);
+
+// Timestamps are publish times, in 100ns units of the test clock.
+static int64_t Now()
+{
+	return (int64_t)(TestSeconds() * 1e7);
+}
+
+//
+// A camera which checks its feed's frames are whole (every pixel byte the
+// low byte of the frame's number, kept in Flags) and records the latency.
+//
+class LoadSink : public BrokerStubSink
+{
+public:
+	uint32_t torn;
+	std::vector<int64_t> latencies;
+
+	LoadSink() : BrokerStubSink(g_Width * g_Height * 4), torn(0)
+	{
+	}
+
+	bool SetFrame(BROKER_FRAME* frame, uint32_t bufferSize)
+	{
+		uint32_t number = frame->Flags;
+
+		if (!BrokerStubSink::SetFrame(frame, bufferSize))
+		{
+			return false;
+		}
+
+		latencies.push_back(Now() - GetTimestamp());
+
+		const uint8_t* pixels = GetPixels();
+		for (uint32_t i = 0; i < GetFrameSize(); i += 61)
+		{
+			if (pixels[i] != (uint8_t)number)
+			{
+				torn++;
+				break;
+			}
+		}
+
+		return true;
+	}
+};
+
+static void Produce(BrokerClient* client, uint32_t role)
+{
+	auto period = std::chrono::microseconds(1000000 / g_FramesPerSecond);
+	auto due = std::chrono::steady_clock::now();
+	uint32_t number = 0;
+
+	while (!g_Stop)
+	{
+		BROKER_FRAME* frame = client->GetBuffer();
+
+		number++;
+
+		frame->Size = sizeof(BROKER_FRAME);
+		frame->Flags = number;
+		frame->MetadataLength = 0;
+		frame->Format = BROKER_FORMAT_BGRA;
+		memset(frame + 1, role == BROKER_ROLE_FEED ? (uint8_t)number : 0, (size_t)g_Width * g_Height * 4);
+		frame->Timestamp = Now();
+
+		client->Publish();
+
+		due += period;
+		std::this_thread::sleep_until(due);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t producerCount = argc > 1 ? atoi(argv[1]) : 32;
+	uint32_t cameraCount = argc > 2 ? atoi(argv[2]) : 16;
+	double seconds = argc > 3 ? atof(argv[3]) : 10;
+
+	if (argc > 5)
+	{
+		g_Width = atoi(argv[4]);
+		g_Height = atoi(argv[5]);
+	}
+
+	if (argc > 6)
+	{
+		g_FramesPerSecond = atoi(argv[6]);
+	}
+
+	if (cameraCount == 0 || cameraCount > BROKER_MAX_CAMERAS ||
+		producerCount < cameraCount || producerCount > cameraCount * (1 + BROKER_MAX_LAYERS) ||
+		g_FramesPerSecond == 0 || (uint64_t)g_Width * g_Height * 4 > BROKER_MAX_BUFFER_SIZE - sizeof(BROKER_FRAME))
+	{
+		fprintf(stderr, "usage: BrokerLoad [producers [cameras [seconds [width height [fps]]]]]\n");
+		return 2;
+	}
+
+	std::vector<LoadSink> sinks(cameraCount);
+	std::vector<BrokerSink*> sinkList;
+	for (LoadSink& sink : sinks)
+	{
+		sinkList.push_back(&sink);
+	}
+
+	FrameBroker broker;
+	CHECK(broker.Start(sinkList.data(), cameraCount, g_Width, g_Height, g_FramesPerSecond));
+
+	//
+	// A feed on each camera, then the layers round the cameras.
+	//
+	uint32_t bufferSize = sizeof(BROKER_FRAME) + g_Width * g_Height * 4;
+	std::vector<BrokerClient> clients(producerCount);
+	std::vector<std::thread> threads;
+
+	for (uint32_t index = 0; index < producerCount; index++)
+	{
+		uint32_t role = index < cameraCount ? BROKER_ROLE_FEED : BROKER_ROLE_LAYER;
+
+		CHECK(clients[index].Connect(index % cameraCount, role, bufferSize));
+		threads.push_back(std::thread(Produce, &clients[index], role));
+	}
+
+	std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+
+	BROKER_STATISTICS statistics;
+	broker.GetStatistics(&statistics);
+
+	g_Stop = true;
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+
+	broker.Stop();
+
+	//
+	// The camera rates are counted over the run, latencies over all the
+	// frames forwarded.
+	//
+	std::vector<int64_t> latencies;
+	uint32_t torn = 0;
+	double slowest = 1e9;
+
+	for (LoadSink& sink : sinks)
+	{
+		latencies.insert(latencies.end(), sink.latencies.begin(), sink.latencies.end());
+		torn += sink.torn;
+		slowest = std::min(slowest, sink.GetFramesSet() / seconds);
+	}
+
+	std::sort(latencies.begin(), latencies.end());
+
+	CHECK(statistics.Producers == producerCount);
+	CHECK(statistics.FramesRejected == 0);
+	CHECK(torn == 0);
+	CHECK(!latencies.empty());
+
+	if (!latencies.empty())
+	{
+		double mean = 0;
+		for (int64_t latency : latencies)
+		{
+			mean += latency;
+		}
+		mean /= latencies.size();
+
+		printf("%u producers on %u cameras of %ux%u at %u fps for %.1f s\n",
+			producerCount, cameraCount, g_Width, g_Height, g_FramesPerSecond, seconds);
+		printf("published %u, replaced %u, forwarded %u, rejected %u\n",
+			statistics.FramesPublished, statistics.FramesReplaced, statistics.FramesForwarded, statistics.FramesRejected);
+		printf("slowest camera %.1f fps; latency mean %.2f ms, 99%% %.2f ms, max %.2f ms\n",
+			slowest,
+			mean / 1e4,
+			latencies[latencies.size() * 99 / 100] / 1e4,
+			latencies.back() / 1e4);
+	}
+
+	return TestResult();
+}
@@ -0,0 +1,453 @@
+//
+// The frame broker (Broker.h) with BrokerStubSink cameras, its producers
+// connected over the channel in this process.  Producers are assigned
+// their cameras or refused as BROKER_CONNECT says; a producer publishing
+// faster than the camera has its frames replaced, and every frame the
+// camera gets is whole and newer than the last; a layer is composited over
+// the feed; and a producer that writes an index out of range into its
+// section header gets nothing forwarded and doesn't get the camera's front
+// buffer back.  Redactions set on the broker are applied to every feed
+// frame, whatever its format, before the layers; frames of a format it
+// can't redact aren't forwarded.
+//
+// See BrokerLoad for the broker under load.
+//
+
+#include "Broker.h"
+
+#include <inttypes.h>
+#include <string.h>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "Test.h"
+
+#define WIDTH 64
+#define HEIGHT 36
+#define FRAMES_PER_SECOND 100
+#define FRAME_SIZE (WIDTH * HEIGHT * 4)
+#define BUFFER_SIZE (sizeof(BROKER_FRAME) + FRAME_SIZE)
+
+//
+// Checks each frame as it is set: every byte of a frame is the low byte of
+// its timestamp, and the timestamps increase.
+//
+class CheckingSink : public BrokerStubSink
+{
+public:
+	bool checkPixels;
+	int64_t last;
+	uint32_t torn;
+	uint32_t outOfOrder;
+
+	CheckingSink() : BrokerStubSink(FRAME_SIZE), checkPixels(true), last(0), torn(0), outOfOrder(0)
+	{
+	}
+
+	bool SetFrame(BROKER_FRAME* frame, uint32_t bufferSize)
+	{
+		if (!BrokerStubSink::SetFrame(frame, bufferSize))
+		{
+			return false;
+		}
+
+		if (GetTimestamp() <= last)
+		{
+			outOfOrder++;
+		}
+
+		last = GetTimestamp();
+
+		if (checkPixels)
+		{
+			for (uint32_t i = 0; i < FRAME_SIZE; i++)
+			{
+				if (GetPixels()[i] != (uint8_t)last)
+				{
+					torn++;
+					break;
+				}
+			}
+		}
+
+		return true;
+	}
+};
+
+static void Publish(BrokerClient& client, int64_t timestamp)
+{
+	BROKER_FRAME* frame = client.GetBuffer();
+
+	frame->Size = sizeof(BROKER_FRAME);
+	frame->Flags = 0;
+	frame->Timestamp = timestamp;
+	frame->MetadataLength = 0;
+	frame->Format = BROKER_FORMAT_BGRA;
+	memset(frame + 1, (uint8_t)timestamp, FRAME_SIZE);
+
+	client.Publish();
+}
+
+// Waits up to a second for the sink to get another frame.
+static bool WaitFrame(BrokerStubSink& sink, uint32_t framesSet)
+{
+	for (int i = 0; i < 1000 && sink.GetFramesSet() == framesSet; i++)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	return sink.GetFramesSet() != framesSet;
+}
+
+static void WaitPeriods(int periods)
+{
+	std::this_thread::sleep_for(std::chrono::milliseconds(periods * 1000 / FRAMES_PER_SECOND));
+}
+
+static void TestConnect()
+{
+	CheckingSink sinks[2];
+	BrokerSink* sinkList[2] = { &sinks[0], &sinks[1] };
+	FrameBroker broker;
+
+	CHECK(broker.Start(sinkList, 2, WIDTH, HEIGHT, FRAMES_PER_SECOND));
+
+	// A second broker can't have the channel.
+	FrameBroker second;
+	CHECK(!second.Start(sinkList, 2, WIDTH, HEIGHT, FRAMES_PER_SECOND));
+
+	// Any camera: the first without a feed.
+	BrokerClient feeds[3];
+	CHECK(feeds[0].Connect(-1, BROKER_ROLE_FEED, BUFFER_SIZE));
+	CHECK(feeds[0].GetCamera() == 0);
+	CHECK(feeds[1].Connect(-1, BROKER_ROLE_FEED, BUFFER_SIZE));
+	CHECK(feeds[1].GetCamera() == 1);
+
+	// No camera left, or the camera asked for has a feed.
+	CHECK(!feeds[2].Connect(-1, BROKER_ROLE_FEED, BUFFER_SIZE));
+	CHECK(!feeds[2].Connect(0, BROKER_ROLE_FEED, BUFFER_SIZE));
+
+	// A layer on any camera goes on the first with a feed, and must hold a
+	// full frame.
+	BrokerClient layer;
+	CHECK(!layer.Connect(-1, BROKER_ROLE_LAYER, BUFFER_SIZE - 1));
+	CHECK(layer.Connect(-1, BROKER_ROLE_LAYER, BUFFER_SIZE));
+	CHECK(layer.GetCamera() == 0);
+
+	// No such camera, or buffers too small for a frame header.
+	BrokerClient refused;
+	CHECK(!refused.Connect(2, BROKER_ROLE_FEED, BUFFER_SIZE));
+	CHECK(!refused.Connect(0, BROKER_ROLE_LAYER + 1, BUFFER_SIZE));
+	CHECK(!refused.Connect(0, BROKER_ROLE_FEED, sizeof(BROKER_FRAME) - 1));
+
+	BROKER_STATISTICS statistics;
+	broker.GetStatistics(&statistics);
+	CHECK(statistics.Cameras == 2);
+	CHECK(statistics.Producers == 3);
+
+	// A disconnected feed frees its camera.
+	feeds[0].Disconnect();
+	layer.Disconnect();
+	for (int i = 0; i < 1000 && !feeds[2].Connect(0, BROKER_ROLE_FEED, BUFFER_SIZE); i++)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	CHECK(feeds[2].GetCamera() == 0);
+
+	broker.Stop();
+}
+
+static void TestForwarding()
+{
+	CheckingSink sink;
+	BrokerSink* sinkList[1] = { &sink };
+	FrameBroker broker;
+
+	CHECK(broker.Start(sinkList, 1, WIDTH, HEIGHT, FRAMES_PER_SECOND));
+
+	BrokerClient client;
+	CHECK(client.Connect(0, BROKER_ROLE_FEED, BUFFER_SIZE));
+
+	// About five frames per camera frame period.
+	int64_t timestamp = 0;
+	auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(500);
+
+	while (std::chrono::steady_clock::now() < end)
+	{
+		Publish(client, ++timestamp);
+		std::this_thread::sleep_for(std::chrono::microseconds(2000));
+	}
+
+	WaitPeriods(3);
+
+	BROKER_STATISTICS statistics;
+	broker.GetStatistics(&statistics);
+	broker.Stop();
+
+	// Each frame was either forwarded or replaced by a newer one, the last
+	// forwarded.
+	CHECK(statistics.FramesPublished == timestamp);
+	CHECK(statistics.FramesReplaced > 0);
+	CHECK(statistics.FramesForwarded + statistics.FramesReplaced == statistics.FramesPublished);
+	CHECK(statistics.FramesRejected == 0);
+	CHECK(sink.GetFramesSet() == statistics.FramesForwarded);
+	CHECK(sink.GetTimestamp() == timestamp);
+	CHECK(sink.torn == 0);
+	CHECK(sink.outOfOrder == 0);
+
+	printf("%" PRId64 " frames published, %u forwarded, %u replaced\n",
+		timestamp, statistics.FramesForwarded, statistics.FramesReplaced);
+}
+
+static void TestLayer()
+{
+	CheckingSink sink;
+	BrokerSink* sinkList[1] = { &sink };
+	FrameBroker broker;
+
+	sink.checkPixels = false;
+	CHECK(broker.Start(sinkList, 1, WIDTH, HEIGHT, FRAMES_PER_SECOND));
+
+	BrokerClient feed;
+	BrokerClient layer;
+	CHECK(feed.Connect(0, BROKER_ROLE_FEED, BUFFER_SIZE));
+	CHECK(layer.Connect(0, BROKER_ROLE_LAYER, BUFFER_SIZE));
+
+	// The left half opaque, the right half transparent.
+	BROKER_FRAME* image = layer.GetBuffer();
+	uint8_t* pixels = (uint8_t*)(image + 1);
+
+	for (uint32_t y = 0; y < HEIGHT; y++)
+	{
+		for (uint32_t x = 0; x < WIDTH; x++)
+		{
+			static const uint8_t opaque[4] = { 10, 20, 30, 255 };
+			static const uint8_t transparent[4] = { 0, 0, 0, 0 };
+
+			memcpy(pixels + (y * WIDTH + x) * 4, x < WIDTH / 2 ? opaque : transparent, 4);
+		}
+	}
+
+	layer.Publish();
+	WaitPeriods(3);
+
+	uint32_t framesSet = sink.GetFramesSet();
+	Publish(feed, 0x40);
+	CHECK(WaitFrame(sink, framesSet));
+
+	bool composited = true;
+	for (uint32_t y = 0; y < HEIGHT; y++)
+	{
+		for (uint32_t x = 0; x < WIDTH; x++)
+		{
+			const uint8_t* pixel = sink.GetPixels() + (y * WIDTH + x) * 4;
+			bool left = x < WIDTH / 2;
+
+			composited = composited &&
+				pixel[0] == (left ? 10 : 0x40) &&
+				pixel[1] == (left ? 20 : 0x40) &&
+				pixel[2] == (left ? 30 : 0x40) &&
+				pixel[3] == (left ? 255 : 0x40);
+		}
+	}
+
+	CHECK(composited);
+
+	broker.Stop();
+}
+
+static void TestBadIndex()
+{
+	CheckingSink sink;
+	BrokerSink* sinkList[1] = { &sink };
+	FrameBroker broker;
+
+	CHECK(broker.Start(sinkList, 1, WIDTH, HEIGHT, FRAMES_PER_SECOND));
+
+	BrokerClient client;
+	CHECK(client.Connect(0, BROKER_ROLE_FEED, BUFFER_SIZE));
+
+	uint32_t framesSet = sink.GetFramesSet();
+	Publish(client, 1);
+	CHECK(WaitFrame(sink, framesSet));
+
+	//
+	// The producer writes over the header.  The broker must leave the
+	// middle buffer as it is: swapping its front buffer in would hand the
+	// producer the buffer the camera has.
+	//
+	BROKER_SECTION_HEADER* header = client.GetHeader();
+	uint32_t middle = header->Middle.load();
+
+	CHECK((middle & BROKER_FRESH) == 0);
+
+	framesSet = sink.GetFramesSet();
+	header->Middle.store(BROKER_INDEX_MASK | BROKER_FRESH);
+	WaitPeriods(5);
+
+	CHECK(header->Middle.load() == (BROKER_INDEX_MASK | BROKER_FRESH));
+	CHECK(sink.GetFramesSet() == framesSet);
+
+	// Put back, the producer's frames come through again.
+	header->Middle.store(middle);
+
+	for (int64_t timestamp = 2; timestamp < 10; timestamp++)
+	{
+		framesSet = sink.GetFramesSet();
+		Publish(client, timestamp);
+		CHECK(WaitFrame(sink, framesSet));
+		CHECK(sink.GetTimestamp() == timestamp);
+	}
+
+	broker.Stop();
+
+	CHECK(sink.torn == 0);
+	CHECK(sink.outOfOrder == 0);
+}
+
+//
+// Publishes a random frame of format and waits for the camera to get it.
+// The frame as published is left in published.
+//
+static bool PublishRandom(BrokerClient& client, BrokerStubSink& sink, uint32_t format, uint32_t frameSize, std::vector<uint8_t>& published)
+{
+	BROKER_FRAME* frame = client.GetBuffer();
+
+	published.resize(frameSize);
+	for (uint8_t& byte : published)
+	{
+		byte = (uint8_t)TestRandom();
+	}
+
+	frame->Size = sizeof(BROKER_FRAME);
+	frame->Flags = 0;
+	frame->Timestamp = 0;
+	frame->MetadataLength = 0;
+	frame->Format = format;
+	memcpy(frame + 1, published.data(), frameSize);
+
+	uint32_t framesSet = sink.GetFramesSet();
+	client.Publish();
+
+	return WaitFrame(sink, framesSet);
+}
+
+static void TestRedaction()
+{
+	CheckingSink sink;
+	BrokerSink* sinkList[1] = { &sink };
+	FrameBroker broker;
+
+	sink.checkPixels = false;
+
+	//
+	// Set before Start, as the driver interface sets them; a block and a
+	// blur, one of them clipped.
+	//
+	Redactor redactor;
+	redactor.SetSize(WIDTH, HEIGHT);
+	CHECK(redactor.AddRegion(4, 6, 20, 12, REDACTION_PIXELATE, 4) != 0);
+	CHECK(redactor.AddRegion(40, 20, 40, 40, REDACTION_BLUR, 3) != 0);
+	broker.SetRedactions(redactor);
+
+	CHECK(broker.Start(sinkList, 1, WIDTH, HEIGHT, FRAMES_PER_SECOND));
+
+	BrokerClient client;
+	CHECK(client.Connect(0, BROKER_ROLE_FEED, BUFFER_SIZE));
+
+	//
+	// The camera gets each frame as the redactor leaves it, laid out as the
+	// driver interface lays out the frames it redacts.
+	//
+	struct Expected
+	{
+		uint32_t format;
+		uint32_t frameSize;
+	};
+
+	static const Expected formats[] =
+	{
+		{ BROKER_FORMAT_BGRA, WIDTH * HEIGHT * 4 },
+		{ BROKER_FORMAT_RGB24, WIDTH * HEIGHT * 3 },
+		{ BROKER_FORMAT_NV12, WIDTH * HEIGHT * 3 / 2 },
+		{ BROKER_FORMAT_I420, WIDTH * HEIGHT * 3 / 2 },
+		{ BROKER_FORMAT_YUY2, WIDTH * HEIGHT * 2 },
+		{ BROKER_FORMAT_P010, WIDTH * HEIGHT * 3 },
+	};
+
+	std::vector<uint8_t> published;
+
+	for (const Expected& expected : formats)
+	{
+		CHECK(PublishRandom(client, sink, expected.format, expected.frameSize, published));
+
+		uint8_t* frame = published.data();
+
+		switch (expected.format)
+		{
+		case BROKER_FORMAT_BGRA:
+			redactor.Apply(frame, WIDTH * 4, 1, 4, 0, 0);
+			break;
+
+		case BROKER_FORMAT_RGB24:
+			redactor.Apply(frame, WIDTH * 3, 1, 3, 0, 0);
+			break;
+
+		case BROKER_FORMAT_NV12:
+			redactor.Apply(frame, WIDTH, 1, 1, 0, 0);
+			redactor.Apply(frame + WIDTH * HEIGHT, WIDTH, 1, 2, 1, 1);
+			break;
+
+		case BROKER_FORMAT_I420:
+			redactor.Apply(frame, WIDTH, 1, 1, 0, 0);
+			redactor.Apply(frame + WIDTH * HEIGHT, WIDTH / 2, 1, 1, 1, 1);
+			redactor.Apply(frame + WIDTH * HEIGHT + (WIDTH / 2) * (HEIGHT / 2), WIDTH / 2, 1, 1, 1, 1);
+			break;
+
+		case BROKER_FORMAT_YUY2:
+			redactor.Apply(frame, WIDTH * 2, 1, 4, 1, 0);
+			break;
+
+		case BROKER_FORMAT_P010:
+			redactor.Apply(frame, WIDTH * 2, 2, 1, 0, 0);
+			redactor.Apply(frame + WIDTH * 2 * HEIGHT, WIDTH * 2, 2, 2, 1, 1);
+			break;
+		}
+
+		CHECK(sink.GetFormat() == expected.format);
+		CHECK(memcmp(sink.GetPixels(), published.data(), expected.frameSize) == 0);
+	}
+
+	//
+	// A format the broker doesn't know can't be redacted, so it isn't
+	// forwarded; cleared, frames come through as they are.
+	//
+	BROKER_STATISTICS statistics;
+	uint32_t framesSet = sink.GetFramesSet();
+
+	CHECK(!PublishRandom(client, sink, BROKER_FORMAT_P010 + 1, FRAME_SIZE, published));
+	broker.GetStatistics(&statistics);
+	CHECK(statistics.FramesRejected == 1);
+	CHECK(sink.GetFramesSet() == framesSet);
+
+	redactor.ClearRegions();
+	broker.SetRedactions(redactor);
+
+	CHECK(PublishRandom(client, sink, BROKER_FORMAT_BGRA, FRAME_SIZE, published));
+	CHECK(memcmp(sink.GetPixels(), published.data(), FRAME_SIZE) == 0);
+
+	broker.Stop();
+}
+
+int main()
+{
+	TestConnect();
+	TestForwarding();
+	TestLayer();
+	TestBadIndex();
+	TestRedaction();
+
+	return TestResult();
+}
@@ -0,0 +1,489 @@
+//
+// Chroma keying (ChromaKey.h) of the YUV frames the driver interface
+// keys: NV12, I420, YUY2 and P010, laid out as CopyFrame packs them.
+// Frames with chroma around the key are keyed over a random background
+// image and every sample is compared with a reference computed in double
+// precision from the definition; the key color is replaced by the
+// background, colors far from it are kept, spill suppression leaves luma
+// alone, and a disabled key changes nothing.  Then the cost of keying a
+// 720p and a 1080p frame in each format, RGB24 and BGRA included.
+//
+
+#include "ChromaKey.h"
+
+#include <math.h>
+
+#include <vector>
+
+#include "Test.h"
+
+#define KEY_COLOR 0x00B140
+#define TOLERANCE 40
+#define SOFTNESS 30
+
+enum Format
+{
+	Nv12,
+	I420,
+	Yuy2,
+	P010,
+	FormatCount
+};
+
+static const char* g_FormatNames[FormatCount] = { "NV12", "I420", "YUY2", "P010" };
+
+// Where a tightly packed frame keeps its samples; offsets and strides in
+// bytes, steps in samples.
+struct Layout
+{
+	size_t size;
+	size_t luma;
+	int32_t lumaStride;
+	uint32_t lumaStep;
+	size_t cb;
+	size_t cr;
+	int32_t chromaStride;
+	uint32_t chromaStep;
+	uint32_t chromaRows;
+	uint32_t sampleBytes;
+};
+
+static Layout GetLayout(Format format, uint32_t width, uint32_t height)
+{
+	size_t pixels = (size_t)width * height;
+
+	switch (format)
+	{
+	case Nv12:
+		return { pixels * 3 / 2, 0, (int32_t)width, 1, pixels, pixels + 1, (int32_t)width, 2, 2, 1 };
+
+	case I420:
+		return { pixels * 3 / 2, 0, (int32_t)width, 1, pixels, pixels + pixels / 4, (int32_t)width / 2, 1, 2, 1 };
+
+	case Yuy2:
+		return { pixels * 2, 0, (int32_t)width * 2, 2, 1, 3, (int32_t)width * 2, 4, 1, 1 };
+
+	default:
+		return { pixels * 3, 0, (int32_t)width * 2, 1, pixels * 2, pixels * 2 + 2, (int32_t)width * 2, 2, 2, 2 };
+	}
+}
+
+static void Apply(ChromaKey& key, std::vector<uint8_t>& frame, const Layout& layout)
+{
+	key.ApplyYuv(
+		frame.data() + layout.luma, layout.lumaStride, layout.lumaStep,
+		frame.data() + layout.cb, frame.data() + layout.cr, layout.chromaStride, layout.chromaStep,
+		layout.chromaRows, layout.sampleBytes);
+}
+
+// Samples in 8 bit units, P010 divided by 4.
+static double Load(const uint8_t* sample, const Layout& layout)
+{
+	return layout.sampleBytes == 2 ? *(const uint16_t*)sample / 256.0 : *sample;
+}
+
+static void Store(uint8_t* sample, const Layout& layout, double value)
+{
+	if (layout.sampleBytes == 2)
+	{
+		*(uint16_t*)sample = (uint16_t)((int)floor(fmin(fmax(value * 4, 0), 1023) + 0.5) << 6);
+	}
+	else
+	{
+		*sample = (uint8_t)floor(fmin(fmax(value, 0), 255) + 0.5);
+	}
+}
+
+// The sample's distance from the reference, in its own units.
+static double Error(const uint8_t* sample, const uint8_t* reference, const Layout& layout)
+{
+	return fabs(Load(sample, layout) - Load(reference, layout)) * (layout.sampleBytes == 2 ? 4 : 1);
+}
+
+static uint8_t* LumaAt(uint8_t* frame, const Layout& layout, uint32_t x, uint32_t y)
+{
+	return frame + layout.luma + (size_t)y * layout.lumaStride + (size_t)x * layout.lumaStep * layout.sampleBytes;
+}
+
+static uint8_t* ChromaAt(uint8_t* frame, size_t plane, const Layout& layout, uint32_t x, uint32_t y)
+{
+	return frame + plane + (size_t)y * layout.chromaStride + (size_t)x * layout.chromaStep * layout.sampleBytes;
+}
+
+// Full range BT.601 chroma of an RGB color, as the key is defined.
+static void FullChroma(double r, double g, double b, double* cb, double* cr)
+{
+	*cb = -0.168736 * r - 0.331264 * g + 0.5 * b;
+	*cr = 0.5 * r - 0.418688 * g - 0.081312 * b;
+}
+
+//
+// A frame with random luma, and chroma within 60 (limited range units) of
+// the key's in every other block of 8 x 4 chroma samples, like a screen
+// around a subject, random elsewhere.
+//
+static std::vector<uint8_t> MakeFrame(Format format, uint32_t width, uint32_t height)
+{
+	Layout layout = GetLayout(format, width, height);
+	std::vector<uint8_t> frame(layout.size);
+	double keyCb;
+	double keyCr;
+
+	FullChroma((KEY_COLOR >> 16) & 0xFF, (KEY_COLOR >> 8) & 0xFF, KEY_COLOR & 0xFF, &keyCb, &keyCr);
+
+	for (uint32_t y = 0; y < height; y++)
+	{
+		for (uint32_t x = 0; x < width; x++)
+		{
+			Store(LumaAt(frame.data(), layout, x, y), layout, 16 + TestRandom() % 220 + (TestRandom() % 4) / 4.0);
+		}
+	}
+
+	for (uint32_t y = 0; y < height / layout.chromaRows; y++)
+	{
+		for (uint32_t x = 0; x < width / 2; x++)
+		{
+			double cb = 16 + TestRandom() % 225;
+			double cr = 16 + TestRandom() % 225;
+
+			if ((x / 8 + y / 4) % 2)
+			{
+				cb = 128 + keyCb * 224 / 255 + (int)(TestRandom() % 121) - 60;
+				cr = 128 + keyCr * 224 / 255 + (int)(TestRandom() % 121) - 60;
+			}
+
+			Store(ChromaAt(frame.data(), layout.cb, layout, x, y), layout, cb + (TestRandom() % 4) / 4.0);
+			Store(ChromaAt(frame.data(), layout.cr, layout, x, y), layout, cr + (TestRandom() % 4) / 4.0);
+		}
+	}
+
+	return frame;
+}
+
+//
+// The reference: chroma converted to full range, alpha ramping from the
+// tolerance over the softness, spill removed along the key's chroma, and
+// each sample blended with the limited range background (luma per pixel,
+// chroma averaged over the pixels sharing the sample).
+//
+static std::vector<uint8_t> Reference(Format format, const std::vector<uint8_t>& input, uint32_t width, uint32_t height, const std::vector<uint8_t>& background, uint32_t spill)
+{
+	Layout layout = GetLayout(format, width, height);
+	std::vector<uint8_t> frame(input);
+	double keyCb;
+	double keyCr;
+
+	FullChroma((KEY_COLOR >> 16) & 0xFF, (KEY_COLOR >> 8) & 0xFF, KEY_COLOR & 0xFF, &keyCb, &keyCr);
+
+	double length = sqrt(keyCb * keyCb + keyCr * keyCr);
+	double directionCb = keyCb / length;
+	double directionCr = keyCr / length;
+
+	for (uint32_t y = 0; y < height / layout.chromaRows; y++)
+	{
+		for (uint32_t x = 0; x < width / 2; x++)
+		{
+			uint8_t* cbSample = ChromaAt(frame.data(), layout.cb, layout, x, y);
+			uint8_t* crSample = ChromaAt(frame.data(), layout.cr, layout, x, y);
+			double cb = (Load(cbSample, layout) - 128) * 255 / 224;
+			double cr = (Load(crSample, layout) - 128) * 255 / 224;
+
+			double distance = sqrt((cb - keyCb) * (cb - keyCb) + (cr - keyCr) * (cr - keyCr));
+			double alpha = fmin(fmax((distance - TOLERANCE) / SOFTNESS, 0), 1);
+			double removed = fmax(cb * directionCb + cr * directionCr, 0) * spill / 255;
+
+			cb = 128 + (cb - removed * directionCb) * 224 / 255;
+			cr = 128 + (cr - removed * directionCr) * 224 / 255;
+
+			double backgroundR = 0;
+			double backgroundG = 0;
+			double backgroundB = 0;
+
+			for (uint32_t row = y * layout.chromaRows; row < (y + 1) * layout.chromaRows; row++)
+			{
+				for (uint32_t column = 2 * x; column < 2 * x + 2; column++)
+				{
+					const uint8_t* pixel = background.data() + ((size_t)row * width + column) * 4;
+					double luma = 16 + (0.299 * pixel[2] + 0.587 * pixel[1] + 0.114 * pixel[0]) * 219 / 255;
+					uint8_t* sample = LumaAt(frame.data(), layout, column, row);
+
+					Store(sample, layout, luma + alpha * (Load(sample, layout) - luma));
+
+					backgroundR += pixel[2];
+					backgroundG += pixel[1];
+					backgroundB += pixel[0];
+				}
+			}
+
+			double count = 2.0 * layout.chromaRows;
+			double backgroundCb;
+			double backgroundCr;
+
+			FullChroma(backgroundR / count, backgroundG / count, backgroundB / count, &backgroundCb, &backgroundCr);
+			backgroundCb = 128 + backgroundCb * 224 / 255;
+			backgroundCr = 128 + backgroundCr * 224 / 255;
+
+			Store(cbSample, layout, backgroundCb + alpha * (cb - backgroundCb));
+			Store(crSample, layout, backgroundCr + alpha * (cr - backgroundCr));
+		}
+	}
+
+	return frame;
+}
+
+static std::vector<uint8_t> RandomImage(uint32_t width, uint32_t height)
+{
+	std::vector<uint8_t> image((size_t)width * height * 4);
+
+	for (uint8_t& byte : image)
+	{
+		byte = (uint8_t)TestRandom();
+	}
+
+	return image;
+}
+
+static void TestReference()
+{
+	const uint32_t width = 64;
+	const uint32_t height = 36;
+	std::vector<uint8_t> background = RandomImage(width, height);
+
+	for (int format = 0; format < FormatCount; format++)
+	{
+		for (uint32_t spill : { 0u, 128u, 255u })
+		{
+			ChromaKey key;
+			key.SetSize(width, height);
+			CHECK(key.SetBackgroundImage(background.data(), width * 4, width, height));
+			CHECK(key.SetKey(KEY_COLOR, TOLERANCE, SOFTNESS, spill));
+
+			Layout layout = GetLayout((Format)format, width, height);
+			std::vector<uint8_t> input = MakeFrame((Format)format, width, height);
+			std::vector<uint8_t> expected = Reference((Format)format, input, width, height, background, spill);
+			std::vector<uint8_t> frame(input);
+
+			Apply(key, frame, layout);
+
+			//
+			// Within a unit of the sample everywhere, float against double;
+			// the same almost everywhere.
+			//
+			uint32_t samples = 0;
+			uint32_t differ = 0;
+			double worst = 0;
+
+			for (size_t i = 0; i < frame.size(); i += layout.sampleBytes)
+			{
+				double error = Error(frame.data() + i, expected.data() + i, layout);
+
+				worst = fmax(worst, error);
+				differ += error != 0;
+				samples++;
+			}
+
+			CHECK(worst <= 1);
+			CHECK(differ * 100 < samples);
+
+			// Luma is only changed where the key isn't all foreground:
+			// something was keyed, and something was kept.
+			uint32_t keyed = 0;
+
+			for (uint32_t y = 0; y < height; y++)
+			{
+				for (uint32_t x = 0; x < width; x++)
+				{
+					keyed += Error(LumaAt(frame.data(), layout, x, y), LumaAt(input.data(), layout, x, y), layout) != 0;
+				}
+			}
+
+			CHECK(keyed > width * height / 8);
+			CHECK(keyed < width * height);
+		}
+	}
+}
+
+static void TestColors()
+{
+	//
+	// A frame of the key color with a gray square and a greenish one: the
+	// key color becomes the background color, gray is kept, and the greenish
+	// square keeps its luma with spill suppression but loses chroma toward
+	// the key.
+	//
+	const uint32_t width = 32;
+	const uint32_t height = 16;
+	const uint32_t background = 0x2050C0;
+
+	double keyCb;
+	double keyCr;
+	FullChroma((KEY_COLOR >> 16) & 0xFF, (KEY_COLOR >> 8) & 0xFF, KEY_COLOR & 0xFF, &keyCb, &keyCr);
+
+	double backgroundCb;
+	double backgroundCr;
+	FullChroma(0x20, 0x50, 0xC0, &backgroundCb, &backgroundCr);
+	double backgroundY = 16 + (0.299 * 0x20 + 0.587 * 0x50 + 0.114 * 0xC0) * 219 / 255;
+
+	for (int format = 0; format < FormatCount; format++)
+	{
+		Layout layout = GetLayout((Format)format, width, height);
+		std::vector<uint8_t> frame(layout.size);
+
+		// The key color's luma, and its chroma far enough out that the
+		// greenish square is keyed only partly.
+		for (uint32_t y = 0; y < height; y++)
+		{
+			for (uint32_t x = 0; x < width; x++)
+			{
+				bool gray = x < 8 && y < 8;
+				bool greenish = x >= 16 && x < 24 && y < 8;
+
+				Store(LumaAt(frame.data(), layout, x, y), layout, gray ? 128 : greenish ? 100 : 120);
+			}
+		}
+
+		for (uint32_t y = 0; y < height / layout.chromaRows; y++)
+		{
+			for (uint32_t x = 0; x < width / 2; x++)
+			{
+				uint32_t row = y * layout.chromaRows;
+				bool gray = x < 4 && row < 8;
+				bool greenish = x >= 8 && x < 12 && row < 8;
+				double scale = gray ? 0 : greenish ? 0.1 : 1;
+
+				Store(ChromaAt(frame.data(), layout.cb, layout, x, y), layout, 128 + scale * keyCb * 224 / 255);
+				Store(ChromaAt(frame.data(), layout.cr, layout, x, y), layout, 128 + scale * keyCr * 224 / 255);
+			}
+		}
+
+		ChromaKey key;
+		key.SetSize(width, height);
+		key.SetBackgroundColor(background);
+
+		// Disabled, nothing changes.
+		std::vector<uint8_t> keyed(frame);
+		Apply(key, keyed, layout);
+		CHECK(keyed == frame);
+
+		CHECK(key.SetKey(KEY_COLOR, TOLERANCE, SOFTNESS, 255));
+		Apply(key, keyed, layout);
+
+		uint32_t chromaX[3] = { 2, 10, 14 };
+		uint32_t lumaX[3] = { 4, 20, 28 };
+
+		for (int square = 0; square < 3; square++)
+		{
+			double luma = Load(LumaAt(keyed.data(), layout, lumaX[square], 2), layout);
+			double cb = Load(ChromaAt(keyed.data(), layout.cb, layout, chromaX[square], 2 / layout.chromaRows), layout);
+			double cr = Load(ChromaAt(keyed.data(), layout.cr, layout, chromaX[square], 2 / layout.chromaRows), layout);
+			double tolerance = layout.sampleBytes == 2 ? 0.25 : 1;
+
+			if (square == 0)
+			{
+				CHECK(fabs(luma - 128) <= tolerance);
+				CHECK(fabs(cb - 128) <= tolerance);
+				CHECK(fabs(cr - 128) <= tolerance);
+			}
+			else if (square == 1)
+			{
+				// A tenth of the key's chroma is past the tolerance and
+				// softness, so it is all foreground; the chroma along the
+				// key is all removed as spill.
+				CHECK(fabs(luma - 100) <= tolerance);
+				CHECK(fabs(cb - 128) <= tolerance);
+				CHECK(fabs(cr - 128) <= tolerance);
+			}
+			else
+			{
+				CHECK(fabs(luma - backgroundY) <= tolerance);
+				CHECK(fabs(cb - (128 + backgroundCb * 224 / 255)) <= tolerance);
+				CHECK(fabs(cr - (128 + backgroundCr * 224 / 255)) <= tolerance);
+			}
+		}
+	}
+}
+
+static void Benchmark()
+{
+	struct Size
+	{
+		const char* name;
+		uint32_t width;
+		uint32_t height;
+	};
+
+	static const Size sizes[] =
+	{
+		{ "720p", 1280, 720 },
+		{ "1080p", 1920, 1080 },
+	};
+
+	printf("size    format   ms/frame   Mpixel/s\n");
+
+	for (const Size& size : sizes)
+	{
+		ChromaKey key;
+		key.SetSize(size.width, size.height);
+		CHECK(key.SetBackgroundImage(RandomImage(size.width, size.height).data(), size.width * 4, size.width, size.height));
+		CHECK(key.SetKey(KEY_COLOR, TOLERANCE, SOFTNESS, 128));
+
+		const int iterations = 20;
+
+		for (int format = -2; format < FormatCount; format++)
+		{
+			std::vector<uint8_t> frame;
+			Layout layout = {};
+
+			if (format < 0)
+			{
+				frame = RandomImage(size.width, size.height);
+			}
+			else
+			{
+				layout = GetLayout((Format)format, size.width, size.height);
+				frame = MakeFrame((Format)format, size.width, size.height);
+			}
+
+			// The first pass converts the background for the format.
+			double start = 0;
+
+			for (int i = -1; i < iterations; i++)
+			{
+				if (i == 0)
+				{
+					start = TestSeconds();
+				}
+
+				if (format == -2)
+				{
+					key.Apply(frame.data(), size.width * 3, 3);
+				}
+				else if (format == -1)
+				{
+					key.Apply(frame.data(), size.width * 4, 4);
+				}
+				else
+				{
+					Apply(key, frame, layout);
+				}
+			}
+
+			double seconds = (TestSeconds() - start) / iterations;
+
+			printf("%-7s %-6s %9.3f %10.1f\n",
+				size.name,
+				format == -2 ? "RGB24" : format == -1 ? "BGRA" : g_FormatNames[format],
+				seconds * 1e3,
+				size.width * size.height / seconds / 1e6);
+		}
+	}
+}
+
+int main()
+{
+	TestReference();
+	TestColors();
+	Benchmark();
+
+	return TestResult();
+}
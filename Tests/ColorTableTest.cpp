@@ -0,0 +1,327 @@
+//
+// The synthesizer color tables generated from pixel format traits
+// (pixfmt.h, image.h) against the hand-written tables they replaced.  The
+// tables are compared at compile time: RGB24 must match exactly and YUY2
+// everywhere except the three values the old table had off by one from
+// BT.601.  Then the synthesizers' pixel paths (both PutPixel forms and
+// FillSpan, from every starting column, in both orientations) against the
+// old synthesizers' code, reproduced here with the corrected table.
+//
+
+#include "portable.h"
+
+#include <vector>
+
+#include "Test.h"
+
+//
+// The tables as they were hand-written in image.cpp.  RGB24 is blue,
+// green, red; YUV is U, Y, V.
+//
+constexpr UCHAR g_OldRgb24[MAX_COLOR][3] =
+{
+	{0, 0, 0},          // BLACK
+	{255, 255, 255},    // WHITE
+	{0, 255, 255},      // YELLOW
+	{255, 255, 0},      // CYAN
+	{0, 255, 0},        // GREEN
+	{255, 0, 255},      // MAGENTA
+	{0, 0, 255},        // RED
+	{255, 0, 0},        // BLUE
+	{128, 128, 128}     // GREY
+};
+
+constexpr UCHAR g_OldYuv[MAX_COLOR][3] =
+{
+	{128, 16, 128},     // BLACK
+	{128, 235, 128},    // WHITE
+	{16, 211, 146},     // YELLOW
+	{166, 170, 16},     // CYAN
+	{54, 145, 34},      // GREEN
+	{202, 106, 222},    // MAGENTA
+	{90, 81, 240},      // RED
+	{240, 41, 109},     // BLUE
+	{128, 125, 128},    // GREY
+};
+
+// The old YUV table with BT.601 rounding: yellow Y, blue V, grey Y.
+struct CorrectedYuv
+{
+	UCHAR Values[MAX_COLOR][3];
+
+	constexpr CorrectedYuv() : Values()
+	{
+		for (ULONG color = 0; color < MAX_COLOR; color++)
+		{
+			for (ULONG i = 0; i < 3; i++)
+			{
+				Values[color][i] = g_OldYuv[color][i];
+			}
+		}
+
+		Values[YELLOW][1] = 210;
+		Values[BLUE][2] = 110;
+		Values[GREY][1] = 126;
+	}
+};
+
+constexpr CorrectedYuv g_Yuv;
+
+constexpr bool Rgb24Matches()
+{
+	constexpr COLOR_TABLE<RGB24_FORMAT> table;
+
+	for (ULONG color = 0; color < MAX_COLOR; color++)
+	{
+		for (ULONG i = 0; i < 3; i++)
+		{
+			if (table.Macropixel[color][i] != g_OldRgb24[color][i])
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+// YUY2 macropixels are Y, U, Y, V.
+constexpr bool YuvMatches(const UCHAR (&reference)[MAX_COLOR][3])
+{
+	constexpr COLOR_TABLE<YUY2_FORMAT> table;
+
+	for (ULONG color = 0; color < MAX_COLOR; color++)
+	{
+		if (table.Macropixel[color][0] != reference[color][1] ||
+			table.Macropixel[color][1] != reference[color][0] ||
+			table.Macropixel[color][2] != reference[color][1] ||
+			table.Macropixel[color][3] != reference[color][2])
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// How many of the generated YUY2 values differ from the old table.
+constexpr ULONG YuvDifferences()
+{
+	constexpr COLOR_TABLE<YUY2_FORMAT> table;
+	ULONG differences = 0;
+
+	for (ULONG color = 0; color < MAX_COLOR; color++)
+	{
+		differences += table.Macropixel[color][0] != g_OldYuv[color][1];
+		differences += table.Macropixel[color][1] != g_OldYuv[color][0];
+		differences += table.Macropixel[color][3] != g_OldYuv[color][2];
+	}
+
+	return differences;
+}
+
+static_assert(Rgb24Matches(), "generated RGB24 table differs from the old one");
+static_assert(YuvMatches(g_Yuv.Values), "generated YUY2 table differs from the old one beyond the BT.601 corrections");
+static_assert(YuvDifferences() == 3, "generated YUY2 table differs from the old one in other than three values");
+
+// RGB32 is RGB24 with opaque alpha.
+constexpr bool Rgb32Matches()
+{
+	constexpr COLOR_TABLE<RGB32_FORMAT> table;
+
+	for (ULONG color = 0; color < MAX_COLOR; color++)
+	{
+		for (ULONG i = 0; i < 3; i++)
+		{
+			if (table.Macropixel[color][i] != g_OldRgb24[color][i])
+			{
+				return false;
+			}
+		}
+
+		if (table.Macropixel[color][3] != 255)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static_assert(Rgb32Matches(), "generated RGB32 table isn't RGB24 with opaque alpha");
+
+#define WIDTH 38
+#define HEIGHT 5
+
+//
+// The old synthesizers' pixel code, on a buffer of WIDTH x HEIGHT.
+//
+struct OldRgb24
+{
+	std::vector<UCHAR> buffer;
+	PUCHAR cursor;
+	bool flip;
+
+	OldRgb24(bool flip) : buffer(WIDTH * HEIGHT * 3, 0xCD), cursor(NULL), flip(flip)
+	{
+	}
+
+	PUCHAR GetImageLocation(ULONG x, ULONG y)
+	{
+		ULONG line = flip ? HEIGHT - 1 - y : y;
+		return cursor = buffer.data() + 3 * (x + line * WIDTH);
+	}
+
+	void PutPixel(PUCHAR* location, COLOR color)
+	{
+		if (color != TRANSPARENT)
+		{
+			*(*location)++ = g_OldRgb24[color][0];
+			*(*location)++ = g_OldRgb24[color][1];
+			*(*location)++ = g_OldRgb24[color][2];
+		}
+		else
+		{
+			*location += 3;
+		}
+	}
+
+	void PutPixel(COLOR color)
+	{
+		PutPixel(&cursor, color);
+	}
+};
+
+struct OldYuv
+{
+	std::vector<UCHAR> buffer;
+	PUCHAR cursor;
+	bool parity;
+
+	OldYuv(bool) : buffer(WIDTH * HEIGHT * 2, 0xCD), cursor(NULL), parity(false)
+	{
+	}
+
+	PUCHAR GetImageLocation(ULONG x, ULONG y)
+	{
+		cursor = buffer.data() + ((x + y * WIDTH) << 1);
+		if ((parity = (x & 1) != 0))
+		{
+			cursor++;
+		}
+
+		return cursor;
+	}
+
+	void PutPixel(PUCHAR* location, COLOR color, bool odd)
+	{
+		if (color != TRANSPARENT)
+		{
+			if (odd)
+			{
+				*(*location)++ = g_Yuv.Values[color][2];
+			}
+			else
+			{
+				*(*location)++ = g_Yuv.Values[color][1];
+				*(*location)++ = g_Yuv.Values[color][0];
+				*(*location)++ = g_Yuv.Values[color][1];
+			}
+		}
+		else
+		{
+			*location += odd ? 1 : 3;
+		}
+	}
+
+	void PutPixel(PUCHAR* location, COLOR color)
+	{
+		PutPixel(location, color, ((*location - buffer.data()) & 2) != 0);
+	}
+
+	void PutPixel(COLOR color)
+	{
+		PutPixel(&cursor, color, parity);
+		parity = !parity;
+	}
+};
+
+static COLOR RandomColor()
+{
+	ULONG color = TestRandom() % (MAX_COLOR + 1);
+	return color == MAX_COLOR ? TRANSPARENT : (COLOR)color;
+}
+
+//
+// Draws the same random spans through the old code and the synthesizer,
+// starting at every column of every line, and compares the images.
+//
+template <class Old, class Synthesizer>
+static void CompareDrawing(Synthesizer& synthesizer, bool flip)
+{
+	Old old(flip);
+	std::vector<UCHAR> buffer(old.buffer);
+
+	synthesizer.SetBuffer(buffer.data());
+
+	for (ULONG y = 0; y < HEIGHT; y++)
+	{
+		for (ULONG x = 0; x < WIDTH; x++)
+		{
+			ULONG count = 1 + TestRandom() % (WIDTH - x);
+
+			// Through the default cursor.
+			old.GetImageLocation(x, y);
+			synthesizer.GetImageLocation(x, y);
+
+			for (ULONG i = 0; i < count; i++)
+			{
+				COLOR color = RandomColor();
+				old.PutPixel(color);
+				synthesizer.PutPixel(color);
+			}
+
+			CHECK(buffer == old.buffer);
+
+			// Through a location.
+			PUCHAR oldLocation = old.GetImageLocation(x, y);
+			PUCHAR location = synthesizer.GetImageLocation(x, y);
+
+			for (ULONG i = 0; i < count; i++)
+			{
+				COLOR color = RandomColor();
+				old.PutPixel(&oldLocation, color);
+				synthesizer.PutPixel(&location, color);
+			}
+
+			CHECK(location - buffer.data() == oldLocation - old.buffer.data());
+			CHECK(buffer == old.buffer);
+
+			// A span of one color.
+			COLOR color = (COLOR)(TestRandom() % MAX_COLOR);
+
+			old.GetImageLocation(x, y);
+			for (ULONG i = 0; i < count; i++)
+			{
+				old.PutPixel(color);
+			}
+
+			synthesizer.FillSpan(synthesizer.GetImageLocation(x, y), x, count, color);
+
+			CHECK(buffer == old.buffer);
+		}
+	}
+}
+
+int main()
+{
+	CRGB24Synthesizer topDown(FALSE, WIDTH, HEIGHT);
+	CRGB24Synthesizer bottomUp(TRUE, WIDTH, HEIGHT);
+	CYUVSynthesizer yuv(WIDTH, HEIGHT);
+
+	CompareDrawing<OldRgb24>(topDown, false);
+	CompareDrawing<OldRgb24>(bottomUp, true);
+	CompareDrawing<OldYuv>(yuv, false);
+
+	return TestResult();
+}
@@ -0,0 +1,446 @@
+//
+// Pixel format conversion of injected frames (convert.h).  A test image of
+// random 2x2 blocks (so 4:2:0 and 4:2:2 chroma lose nothing) is encoded in
+// every input format and converted to every output format; each output
+// pixel is decoded and compared with the image, through BT.601 for the YUV
+// formats.  Same-format conversions must be exact copies and bottom-up
+// output the rows reversed.  P010 frames must be sized as the capture
+// pin's intersect handler sizes them.  Then the throughput of every pair
+// at 1080p.
+//
+
+#include "portable.h"
+
+#include <vector>
+
+#include "Test.h"
+
+#define WIDTH 64
+#define HEIGHT 32
+
+static const char* const g_FormatNames[AvshwsFormatCount] =
+{
+	"RGB24", "BGRA", "RGBA", "NV12", "I420", "YUY2", "RGB48", "RGBA64", "P010"
+};
+
+// The output formats the capture pin can negotiate, and NV12 staging.
+static const ULONG g_OutputFormats[] =
+{
+	AvshwsFormatRgb24, AvshwsFormatBgra, AvshwsFormatYuy2, AvshwsFormatNv12, AvshwsFormatP010
+};
+
+struct Image
+{
+	std::vector<PIXEL_RGB> pixels;
+
+	Image() : pixels(WIDTH * HEIGHT)
+	{
+		for (ULONG y = 0; y < HEIGHT; y += 2)
+		{
+			for (ULONG x = 0; x < WIDTH; x += 2)
+			{
+				PIXEL_RGB color = { (UCHAR)TestRandom(), (UCHAR)TestRandom(), (UCHAR)TestRandom() };
+
+				// Include the extremes.
+				if ((x + y) % 16 == 0)
+				{
+					color.Red = color.Green = color.Blue = (x & 2) ? 255 : 0;
+				}
+
+				At(x, y) = At(x + 1, y) = At(x, y + 1) = At(x + 1, y + 1) = color;
+			}
+		}
+	}
+
+	PIXEL_RGB& At(ULONG x, ULONG y)
+	{
+		return pixels[y * WIDTH + x];
+	}
+};
+
+static void Put16(PUCHAR bytes, USHORT value)
+{
+	bytes[0] = (UCHAR)value;
+	bytes[1] = (UCHAR)(value >> 8);
+}
+
+static USHORT Get16(const UCHAR* bytes)
+{
+	return (USHORT)(bytes[0] | bytes[1] << 8);
+}
+
+// The image in Format, tightly packed and top-down.
+static std::vector<UCHAR> Encode(Image& image, ULONG format)
+{
+	std::vector<UCHAR> frame(ConvertFrameSize(format, WIDTH, HEIGHT));
+	PUCHAR data = frame.data();
+	const ULONG pixels = WIDTH * HEIGHT;
+
+	for (ULONG y = 0; y < HEIGHT; y++)
+	{
+		for (ULONG x = 0; x < WIDTH; x++)
+		{
+			PIXEL_RGB color = image.At(x, y);
+			ULONG i = y * WIDTH + x;
+			ULONG chroma = (y / 2) * (WIDTH / 2) + x / 2;
+
+			switch (format)
+			{
+			case AvshwsFormatRgb24:
+				RGB24_FORMAT::Pack(color, data + i * 3);
+				break;
+
+			case AvshwsFormatBgra:
+				RGB32_FORMAT::Pack(color, data + i * 4);
+				break;
+
+			case AvshwsFormatRgba:
+				data[i * 4 + 0] = color.Red;
+				data[i * 4 + 1] = color.Green;
+				data[i * 4 + 2] = color.Blue;
+				data[i * 4 + 3] = 255;
+				break;
+
+			case AvshwsFormatNv12:
+				data[i] = (UCHAR)BT601::Y(color);
+				data[pixels + chroma * 2] = (UCHAR)BT601::Cb(color);
+				data[pixels + chroma * 2 + 1] = (UCHAR)BT601::Cr(color);
+				break;
+
+			case AvshwsFormatI420:
+				data[i] = (UCHAR)BT601::Y(color);
+				data[pixels + chroma] = (UCHAR)BT601::Cb(color);
+				data[pixels + pixels / 4 + chroma] = (UCHAR)BT601::Cr(color);
+				break;
+
+			case AvshwsFormatYuy2:
+				data[i * 2] = (UCHAR)BT601::Y(color);
+				data[i * 2 + 1] = (UCHAR)((x & 1) ? BT601::Cr(color) : BT601::Cb(color));
+				break;
+
+			case AvshwsFormatRgb48:
+				Put16(data + i * 6, color.Red * 257);
+				Put16(data + i * 6 + 2, color.Green * 257);
+				Put16(data + i * 6 + 4, color.Blue * 257);
+				break;
+
+			case AvshwsFormatRgba64:
+				Put16(data + i * 8, color.Red * 257);
+				Put16(data + i * 8 + 2, color.Green * 257);
+				Put16(data + i * 8 + 4, color.Blue * 257);
+				Put16(data + i * 8 + 6, 65535);
+				break;
+
+			case AvshwsFormatP010:
+				Put16(data + i * 2, BT601::Y(color, 10) << 6);
+				Put16(data + pixels * 2 + chroma * 4, BT601::Cb(color, 10) << 6);
+				Put16(data + pixels * 2 + chroma * 4 + 2, BT601::Cr(color, 10) << 6);
+				break;
+			}
+		}
+	}
+
+	return frame;
+}
+
+static LONG Difference(LONG a, LONG b)
+{
+	return a > b ? a - b : b - a;
+}
+
+//
+// The largest difference between an output frame and the image, in the
+// output's own units: RGB components for RGB, Y, Cb and Cr for YUV (10 bit
+// for P010).
+//
+static LONG Compare(Image& image, ULONG format, const UCHAR* data)
+{
+	const ULONG pixels = WIDTH * HEIGHT;
+	LONG worst = 0;
+
+	for (ULONG y = 0; y < HEIGHT; y++)
+	{
+		for (ULONG x = 0; x < WIDTH; x++)
+		{
+			PIXEL_RGB color = image.At(x, y);
+			ULONG i = y * WIDTH + x;
+			ULONG chroma = (y / 2) * (WIDTH / 2) + x / 2;
+			LONG actual[3];
+			LONG expected[3];
+
+			switch (format)
+			{
+			case AvshwsFormatRgb24:
+			case AvshwsFormatBgra:
+			{
+				const UCHAR* pixel = data + i * (format == AvshwsFormatRgb24 ? 3 : 4);
+
+				actual[0] = pixel[2];
+				actual[1] = pixel[1];
+				actual[2] = pixel[0];
+				expected[0] = color.Red;
+				expected[1] = color.Green;
+				expected[2] = color.Blue;
+
+				if (format == AvshwsFormatBgra && pixel[3] != 255)
+				{
+					worst = 1000;
+				}
+
+				break;
+			}
+
+			case AvshwsFormatYuy2:
+				actual[0] = data[i * 2];
+				actual[1] = data[(i & ~1) * 2 + 1];
+				actual[2] = data[(i & ~1) * 2 + 3];
+				expected[0] = BT601::Y(color);
+				expected[1] = BT601::Cb(color);
+				expected[2] = BT601::Cr(color);
+				break;
+
+			case AvshwsFormatNv12:
+				actual[0] = data[i];
+				actual[1] = data[pixels + chroma * 2];
+				actual[2] = data[pixels + chroma * 2 + 1];
+				expected[0] = BT601::Y(color);
+				expected[1] = BT601::Cb(color);
+				expected[2] = BT601::Cr(color);
+				break;
+
+			case AvshwsFormatP010:
+				actual[0] = Get16(data + i * 2) >> 6;
+				actual[1] = Get16(data + pixels * 2 + chroma * 4) >> 6;
+				actual[2] = Get16(data + pixels * 2 + chroma * 4 + 2) >> 6;
+				expected[0] = BT601::Y(color, 10);
+				expected[1] = BT601::Cb(color, 10);
+				expected[2] = BT601::Cr(color, 10);
+
+				// The low bits are zero.
+				if (Get16(data + i * 2) & 0x3F)
+				{
+					worst = 1000;
+				}
+
+				break;
+
+			default:
+				return 1000;
+			}
+
+			for (int c = 0; c < 3; c++)
+			{
+				LONG difference = Difference(actual[c], expected[c]);
+				worst = difference > worst ? difference : worst;
+			}
+		}
+	}
+
+	return worst;
+}
+
+static bool IsYuv(ULONG format)
+{
+	return format == AvshwsFormatNv12 || format == AvshwsFormatI420 ||
+		format == AvshwsFormatYuy2 || format == AvshwsFormatP010;
+}
+
+//
+// The error allowed converting Input to Output.  Going through YCbCr
+// quantizes: decoding limited range 8 bit YCbCr to RGB is off by up to 2,
+// and P010 in or out rounds 10 bits to 8 or 8 to 10 (4 units of 10 bits).
+//
+static LONG Tolerance(ULONG input, ULONG output)
+{
+	if (output == AvshwsFormatP010)
+	{
+		return input == AvshwsFormatP010 ? 0 : 4;
+	}
+
+	if (IsYuv(input) && !IsYuv(output))
+	{
+		return 2;
+	}
+
+	return input == AvshwsFormatP010 ? 1 : (IsYuv(input) == IsYuv(output) ? 0 : 1);
+}
+
+static void TestAccuracy(Image& image)
+{
+	for (ULONG input = 0; input < AvshwsFormatCount; input++)
+	{
+		std::vector<UCHAR> source = Encode(image, input);
+
+		for (ULONG output : g_OutputFormats)
+		{
+			ULONG size = ConvertFrameSize(output, WIDTH, HEIGHT);
+			std::vector<UCHAR> destination(size, 0xCD);
+
+			if (!ConvertFrame(input, source.data(), output, destination.data(), ConvertLineBytes(output, WIDTH), WIDTH, HEIGHT))
+			{
+				// YUY2 output is synthesized only; injected frames are
+				// never converted to it.
+				CHECK(output == AvshwsFormatYuy2);
+				continue;
+			}
+
+			LONG worst = Compare(image, output, destination.data());
+
+			printf("%-6s -> %-6s worst error %ld\n", g_FormatNames[input], g_FormatNames[output], (long)worst);
+			CHECK(worst <= Tolerance(input, output));
+
+			// Same format: a copy.
+			if (input == output)
+			{
+				CHECK(destination == source);
+			}
+		}
+	}
+}
+
+static void TestBottomUp(Image& image)
+{
+	ULONG rowBytes = WIDTH * 3;
+
+	for (ULONG input = 0; input < AvshwsFormatCount; input++)
+	{
+		std::vector<UCHAR> source = Encode(image, input);
+		std::vector<UCHAR> topDown(rowBytes * HEIGHT);
+		std::vector<UCHAR> bottomUp(rowBytes * HEIGHT);
+
+		CHECK(ConvertFrame(input, source.data(), AvshwsFormatRgb24, topDown.data(), rowBytes, WIDTH, HEIGHT));
+		CHECK(ConvertFrame(input, source.data(), AvshwsFormatRgb24, bottomUp.data() + rowBytes * (HEIGHT - 1), -(LONG)rowBytes, WIDTH, HEIGHT));
+
+		for (ULONG y = 0; y < HEIGHT; y++)
+		{
+			CHECK(memcmp(topDown.data() + y * rowBytes, bottomUp.data() + (HEIGHT - 1 - y) * rowBytes, rowBytes) == 0);
+		}
+	}
+}
+
+static void TestInvalid()
+{
+	UCHAR frame[16] = {};
+
+	// Odd sizes of subsampled formats, unknown formats.
+	CHECK(ConvertFrameSize(AvshwsFormatNv12, 3, 2) == 0);
+	CHECK(ConvertFrameSize(AvshwsFormatYuy2, 3, 2) == 0);
+	CHECK(ConvertFrameSize(AvshwsFormatCount, 2, 2) == 0);
+	CHECK(!ConvertFrame(AvshwsFormatNv12, frame, AvshwsFormatRgb24, frame, 9, 3, 2));
+	CHECK(!ConvertFrame(AvshwsFormatCount, frame, AvshwsFormatRgb24, frame, 6, 2, 2));
+	CHECK(!ConvertFrame(AvshwsFormatRgb24, frame, AvshwsFormatCount, frame, 6, 2, 2));
+}
+
+//
+// IntersectHandler sizes P010 with ConvertFrameSize rather than KS_DIBSIZE
+// and refuses sizes it returns 0 for; SetFormat then takes the size to be
+// at least biBitCount (24) / 8 bytes per pixel.  The size must be the luma
+// plane and the interleaved chroma plane at half height, both 2 bytes a
+// sample, with no row padding.
+//
+static void TestP010Size()
+{
+	static const ULONG sizes[][2] =
+	{
+		{ 2, 2 }, { 320, 240 }, { 1280, 720 }, { 1366, 768 }, { 1920, 1080 }, { 3840, 2160 }, { 7680, 4320 },
+	};
+
+	for (const ULONG* size : sizes)
+	{
+		ULONG width = size[0];
+		ULONG height = size[1];
+		ULONG frameSize = ConvertFrameSize(AvshwsFormatP010, width, height);
+		ULONG lineBytes = ConvertLineBytes(AvshwsFormatP010, width);
+
+		CHECK(lineBytes == width * 2);
+		CHECK(frameSize == lineBytes * height + lineBytes * (height / 2));
+		CHECK(frameSize == width * height * 24 / 8);
+
+		// KS_DIBSIZE would pad 24 bpp rows to DWORDs.
+		if (width % 4 != 0)
+		{
+			CHECK(frameSize < (width * 24 + 31) / 32 * 4 * height);
+		}
+	}
+
+	// 4:2:0 needs an even width and height, and the size must fit a ULONG.
+	CHECK(ConvertFrameSize(AvshwsFormatP010, 1921, 1080) == 0);
+	CHECK(ConvertFrameSize(AvshwsFormatP010, 1920, 1081) == 0);
+	CHECK(ConvertFrameSize(AvshwsFormatP010, 65536, 32768) == 0);
+}
+
+static void TestFillBlack()
+{
+	for (ULONG format : g_OutputFormats)
+	{
+		Image black;
+
+		for (PIXEL_RGB& pixel : black.pixels)
+		{
+			pixel.Red = pixel.Green = pixel.Blue = 0;
+		}
+
+		std::vector<UCHAR> frame(ConvertFrameSize(format, WIDTH, HEIGHT), 0xCD);
+
+		ConvertFillBlack(format, frame.data(), WIDTH, HEIGHT);
+		CHECK(Compare(black, format, frame.data()) == 0);
+	}
+}
+
+static void Benchmark(ULONG width, ULONG height)
+{
+	printf("\n%lux%lu, ms/frame (input MB/s)\n", (unsigned long)width, (unsigned long)height);
+
+	for (ULONG input = 0; input < AvshwsFormatCount; input++)
+	{
+		std::vector<UCHAR> source(ConvertFrameSize(input, width, height));
+
+		for (UCHAR& byte : source)
+		{
+			byte = (UCHAR)TestRandom();
+		}
+
+		printf("%-6s ->", g_FormatNames[input]);
+
+		for (ULONG output : g_OutputFormats)
+		{
+			std::vector<UCHAR> destination(ConvertFrameSize(output, width, height));
+			LONG stride = (LONG)ConvertLineBytes(output, width);
+
+			if (!ConvertFrame(input, source.data(), output, destination.data(), stride, width, height))
+			{
+				continue;
+			}
+
+			const int iterations = 20;
+			double start = TestSeconds();
+
+			for (int i = 0; i < iterations; i++)
+			{
+				ConvertFrame(input, source.data(), output, destination.data(), stride, width, height);
+			}
+
+			double seconds = (TestSeconds() - start) / iterations;
+
+			printf("  %s %6.3f (%5.0f)", g_FormatNames[output], seconds * 1e3, source.size() / seconds / 1e6);
+		}
+
+		printf("\n");
+	}
+}
+
+int main()
+{
+	Image image;
+
+	TestAccuracy(image);
+	TestBottomUp(image);
+	TestInvalid();
+	TestP010Size();
+	TestFillBlack();
+
+	Benchmark(1920, 1080);
+	Benchmark(3840, 2160);
+
+	return TestResult();
+}
@@ -0,0 +1,347 @@
+//
+// The output delay line (delay.h) on a fake clock.  A producer injects
+// frames into the ring the way CHardwareSimulation::SetData does, and
+// ticks take the due ones the way ReleaseDelayedFrames does.  Each frame
+// must come out once, in order, at the first tick at least the applied
+// delay after its capture, and no waiting frame may be overwritten (an
+// overrun, counted as superseded).
+//
+// The ring is sized for the inject rate, which may be faster than the
+// ticks: a 60 fps producer delayed 150 ms into a 29.97 fps stream used to
+// get a ring sized at the stream's rate that held only 100 ms, so every
+// frame was overwritten before it was due and the output froze.  Such a
+// ring now gets a shorter delay instead.  Then the ring's memory for the
+// common frame sizes against the budget.
+//
+
+#include "portable.h"
+
+#include <inttypes.h>
+
+#include <vector>
+
+#include "Test.h"
+
+#define OUTPUT_PERIOD 333667
+#define MS 10000
+
+// 100ns units per second.
+#define SECOND 10000000LL
+
+static UCHAR g_Buffers[DELAY_RING_DEPTH][16];
+
+struct Result
+{
+	ULONG injected;
+	ULONG released;
+	ULONG overruns;
+	ULONG outOfOrder;
+	ULONG ticks;
+
+	// The shortest and longest time frames waited, less the delay applied
+	// when they were released.
+	LONGLONG earliest;
+	LONGLONG latest;
+};
+
+struct Stream
+{
+	CDelayLine line;
+	LONGLONG now;
+	LONGLONG nextTick;
+	LONGLONG nextInject;
+	LONGLONG lastReleased;
+
+	Stream(ULONG depth, LONGLONG delay, LONGLONG inputPeriod) : line(), now(0), nextTick(OUTPUT_PERIOD), nextInject(12345), lastReleased(-1)
+	{
+		for (ULONG slot = 0; slot < DELAY_RING_DEPTH; slot++)
+		{
+			line.SetBuffer(slot, slot < depth ? g_Buffers[slot] : NULL);
+		}
+
+		line.Reset(depth, delay, inputPeriod, OUTPUT_PERIOD);
+	}
+
+	//
+	// Runs the clock for Duration with a producer injecting every Period,
+	// up to Jitter late, and returns what happened to the frames.  Frames
+	// which arrive in the first Settle are not counted.
+	//
+	Result Run(LONGLONG duration, LONGLONG period, LONGLONG jitter = 0, LONGLONG settle = 0)
+	{
+		Result result = { 0, 0, 0, 0, 0, SECOND, -SECOND };
+		LONGLONG end = now + duration;
+		LONGLONG counted = now + settle;
+
+		while (now < end)
+		{
+			LONGLONG inject = nextInject + (jitter ? TestRandom() % jitter : 0);
+
+			if (inject < nextTick)
+			{
+				now = inject;
+				nextInject += period;
+
+				BOOLEAN overrun;
+				ULONG slot = line.AcquireWriteSlot(&overrun);
+
+				CHECK(slot != DELAY_RING_DEPTH);
+				line.Publish(slot, now, NULL);
+
+				if (now >= counted)
+				{
+					result.injected++;
+					result.overruns += overrun ? 1 : 0;
+				}
+
+				continue;
+			}
+
+			now = nextTick;
+			nextTick += OUTPUT_PERIOD;
+			result.ticks++;
+
+			line.Slew(OUTPUT_PERIOD / DELAY_SLEW_DIVISOR);
+
+			for (;;)
+			{
+				ULONG slot = line.TakeDue(now);
+
+				if (slot == DELAY_RING_DEPTH)
+				{
+					break;
+				}
+
+				LONGLONG time = line.GetTime(slot);
+
+				if (time >= counted)
+				{
+					LONGLONG late = now - time - line.GetDelay();
+
+					result.released++;
+					result.outOfOrder += time <= lastReleased ? 1 : 0;
+					result.earliest = late < result.earliest ? late : result.earliest;
+					result.latest = late > result.latest ? late : result.latest;
+				}
+
+				lastReleased = time;
+				line.Release(slot);
+			}
+		}
+
+		return result;
+	}
+};
+
+// A stream sized for Delay the way AllocateDelayRing sizes it, with
+// memory for every slot.
+static ULONG Depth(LONGLONG delay)
+{
+	return CDelayLine::DepthFor(delay, DELAY_INPUT_PERIOD_MIN, OUTPUT_PERIOD, DELAY_RING_DEPTH);
+}
+
+static void TestFastProducer()
+{
+	//
+	// 60 fps into 29.97 fps, 150 ms: the ring is sized for 60 fps, every
+	// frame waits out exactly the delay to the tick and none is lost.
+	//
+	LONGLONG delay = 150 * MS;
+	Stream stream(Depth(delay), delay, DELAY_INPUT_PERIOD_MIN);
+
+	// 12 frames waiting out 150 ms and the tick, one written, one spare.
+	CHECK(stream.line.GetDepth() == 14);
+	CHECK(CDelayLine::SpanFor(13, DELAY_INPUT_PERIOD_MIN, OUTPUT_PERIOD) >= delay);
+
+	Result result = stream.Run(60 * SECOND, 166667, 0, SECOND);
+
+	CHECK(result.overruns == 0);
+	CHECK(result.outOfOrder == 0);
+	CHECK(result.released + 10 >= result.injected);
+	CHECK(result.earliest >= 0);
+	CHECK(result.latest < OUTPUT_PERIOD);
+	CHECK(stream.line.GetDelay() == delay);
+	CHECK(stream.line.GetInputPeriod() >= 166666 && stream.line.GetInputPeriod() <= 166667);
+
+	printf("60 fps, 150 ms, %2lu slots: %lu of %lu frames released, %lu overruns, %.1f to %.1f ms past the delay\n",
+		(unsigned long)stream.line.GetDepth(), (unsigned long)result.released, (unsigned long)result.injected,
+		(unsigned long)result.overruns, result.earliest / 1e4, result.latest / 1e4);
+
+	//
+	// A ring sized at the stream's rate, as it used to be (150 ms over the
+	// output period, rounded up, plus two): its 7 slots hold 100 ms of
+	// 60 fps frames.  Once the inject period is measured the delay is cut
+	// to what the ring holds and the frames flow again.
+	//
+	ULONG oldDepth = 7;
+	Stream old(oldDepth, delay, OUTPUT_PERIOD);
+	LONGLONG span = CDelayLine::SpanFor(oldDepth, 166667, OUTPUT_PERIOD);
+
+	CHECK(span < delay);
+
+	result = old.Run(60 * SECOND, 166667, 0, SECOND);
+
+	CHECK(result.overruns == 0);
+	CHECK(result.released + 10 >= result.injected);
+	CHECK(old.line.GetDelay() <= span && old.line.GetDelay() >= span - 1);
+
+	printf("60 fps, 150 ms, %2lu slots sized for 29.97 fps: delay cut to %.1f ms, %lu of %lu frames released, %lu overruns\n",
+		(unsigned long)oldDepth, old.line.GetDelay() / 1e4, (unsigned long)result.released,
+		(unsigned long)result.injected, (unsigned long)result.overruns);
+}
+
+static void TestRates()
+{
+	//
+	// Producers at 24 to 60 fps, on time or up to 4 ms late, with delays up
+	// to 1 s: no overruns, and every frame within an output period after
+	// its delay.
+	//
+	static const LONGLONG periods[] = { 416667, 400000, 333333, 200000, 166667 };
+	static const LONGLONG delays[] = { 33 * MS, 150 * MS, 500 * MS, 1000 * MS };
+
+	for (LONGLONG period : periods)
+	{
+		for (LONGLONG delay : delays)
+		{
+			for (LONGLONG jitter = 0; jitter <= 4 * MS; jitter += 4 * MS)
+			{
+				Stream stream(Depth(delay), delay, DELAY_INPUT_PERIOD_MIN);
+				Result result = stream.Run(20 * SECOND, period, jitter, 2 * SECOND);
+
+				CHECK(result.overruns == 0);
+				CHECK(result.outOfOrder == 0);
+				CHECK(result.earliest >= 0);
+				CHECK(result.latest < OUTPUT_PERIOD);
+				CHECK(stream.line.GetDelay() == delay);
+			}
+		}
+	}
+}
+
+static void TestSlew()
+{
+	//
+	// A delay changed while streaming is reached a slew step per tick,
+	// without losing or reordering frames: 150 ms to 300 ms and back.
+	//
+	LONGLONG delay = 300 * MS;
+	Stream stream(Depth(delay), 150 * MS, DELAY_INPUT_PERIOD_MIN);
+
+	stream.Run(5 * SECOND, 166667);
+
+	stream.line.SetTargetDelay(delay);
+
+	LONGLONG previous = stream.line.GetDelay();
+	ULONG ticks = 0;
+
+	while (stream.line.GetDelay() != delay)
+	{
+		Result result = stream.Run(OUTPUT_PERIOD, 166667);
+
+		LONGLONG step = stream.line.GetDelay() - previous;
+
+		CHECK(step >= 0 && step <= result.ticks * (OUTPUT_PERIOD / DELAY_SLEW_DIVISOR));
+		CHECK(result.overruns == 0);
+		CHECK(result.outOfOrder == 0);
+
+		previous = stream.line.GetDelay();
+		ticks += result.ticks;
+	}
+
+	CHECK(ticks == (150 * MS + OUTPUT_PERIOD / DELAY_SLEW_DIVISOR - 1) / (OUTPUT_PERIOD / DELAY_SLEW_DIVISOR));
+
+	stream.line.SetTargetDelay(150 * MS);
+
+	Result result = stream.Run(5 * SECOND, 166667);
+
+	CHECK(result.overruns == 0);
+	CHECK(result.outOfOrder == 0);
+	CHECK(stream.line.GetDelay() == 150 * MS);
+
+	// A delay past the ring is limited to its span.
+	stream.line.SetTargetDelay(2000 * MS);
+	stream.Run(20 * SECOND, 166667);
+
+	CHECK(stream.line.GetDelay() == CDelayLine::SpanFor(stream.line.GetDepth(), stream.line.GetInputPeriod(), OUTPUT_PERIOD));
+}
+
+static void TestSizing()
+{
+	// No delay, or memory for fewer than three frames: no ring.
+	CHECK(CDelayLine::DepthFor(0, DELAY_INPUT_PERIOD_MIN, OUTPUT_PERIOD, 100) == 0);
+	CHECK(CDelayLine::DepthFor(150 * MS, DELAY_INPUT_PERIOD_MIN, OUTPUT_PERIOD, 2) == 0);
+
+	// Never more than DELAY_RING_DEPTH.
+	CHECK(CDelayLine::DepthFor(2000 * MS, DELAY_INPUT_PERIOD_MIN, OUTPUT_PERIOD, 1000) == DELAY_RING_DEPTH);
+
+	// The depth covers the delay with a slot to spare, and no more.
+	for (LONGLONG delay = MS; delay <= 800 * MS; delay += 7 * MS)
+	{
+		ULONG depth = Depth(delay);
+
+		CHECK(CDelayLine::SpanFor(depth - 1, DELAY_INPUT_PERIOD_MIN, OUTPUT_PERIOD) >= delay);
+		CHECK(CDelayLine::SpanFor(depth - 2, DELAY_INPUT_PERIOD_MIN, OUTPUT_PERIOD) < delay);
+	}
+}
+
+static void TestMemory()
+{
+	//
+	// The memory the ring takes for 150 ms and the longest delay, against
+	// the default budget, as AllocateDelayRing sizes it.
+	//
+	struct Size
+	{
+		const char* name;
+		ULONG width;
+		ULONG height;
+	};
+
+	static const Size sizes[] =
+	{
+		{ "720p", 1280, 720 },
+		{ "1080p", 1920, 1080 },
+		{ "4K", 3840, 2160 },
+	};
+
+	static const LONGLONG delays[] = { 150 * MS, AVSHWS_OUTPUT_DELAY_MAX * (LONGLONG)MS };
+
+	ULONGLONG budget = (ULONGLONG)AVSHWS_OUTPUT_DELAY_BUDGET_DEFAULT * 1024;
+
+	printf("size   staging  delay    slots   memory    longest delay at 60 fps\n");
+
+	for (const Size& size : sizes)
+	{
+		for (ULONG format : { (ULONG)AvshwsFormatRgb24, (ULONG)AvshwsFormatNv12 })
+		{
+			ULONG frameSize = ConvertFrameSize(format, size.width, size.height);
+			ULONG budgetFrames = (ULONG)(budget / frameSize);
+
+			for (LONGLONG delay : delays)
+			{
+				ULONG depth = CDelayLine::DepthFor(delay, DELAY_INPUT_PERIOD_MIN, OUTPUT_PERIOD, budgetFrames);
+				ULONGLONG memory = (ULONGLONG)depth * frameSize;
+				LONGLONG span = CDelayLine::SpanFor(depth, DELAY_INPUT_PERIOD_MIN, OUTPUT_PERIOD);
+
+				CHECK(memory <= budget);
+				CHECK(depth == 0 || span >= delay || depth == budgetFrames || depth == DELAY_RING_DEPTH);
+
+				printf("%-6s %-7s %5" PRId64 " ms %5" PRIu32 " %7.1f MB %8.1f ms\n",
+					size.name, format == AvshwsFormatNv12 ? "NV12" : "RGB24", delay / MS,
+					depth, memory / 1048576.0, span / 1e4);
+			}
+		}
+	}
+}
+
+int main()
+{
+	TestFastProducer();
+	TestRates();
+	TestSlew();
+	TestSizing();
+	TestMemory();
+
+	return TestResult();
+}
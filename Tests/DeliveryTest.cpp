@@ -0,0 +1,231 @@
+//
+// RGB32 against RGB24 output end to end: a producer frame in each input
+// format taken as the driver takes it, from SetData to the consumer's
+// buffer.  It is converted into the output format as SetData stages it
+// (a bottom-up DIB), copied or blended into the synthesis buffer as a
+// tick selects it, and copied row by row into the consumer's buffer as
+// WriteFrame does.  Consumers which render 32 bpp expand RGB24 to RGB32
+// themselves, so that is counted too.  The 32 bpp image a consumer ends
+// up with must be the same either way, alpha aside (RGB32 passes a BGRA
+// producer's alpha through); then the cost of each step and in total at
+// 720p and 1080p.
+//
+
+#include "portable.h"
+
+#include <vector>
+
+#include "Test.h"
+
+static const ULONG g_Inputs[] =
+{
+	AvshwsFormatBgra, AvshwsFormatRgb24, AvshwsFormatNv12, AvshwsFormatI420, AvshwsFormatYuy2
+};
+
+static const char* FormatName(ULONG format)
+{
+	switch (format)
+	{
+	case AvshwsFormatRgb24: return "RGB24";
+	case AvshwsFormatBgra: return "RGB32";
+	case AvshwsFormatNv12: return "NV12";
+	case AvshwsFormatI420: return "I420";
+	case AvshwsFormatYuy2: return "YUY2";
+	}
+
+	return "?";
+}
+
+//
+// The buffers of one stream: the producer's frame, the frame history and
+// the synthesis buffer in the output format, the consumer's buffer and
+// the 32 bpp image the consumer renders.
+//
+struct Stream
+{
+	ULONG input;
+	ULONG output;
+	ULONG width;
+	ULONG height;
+	ULONG lineBytes;
+	std::vector<UCHAR> producer;
+	std::vector<UCHAR> history[2];
+	std::vector<UCHAR> synthesis;
+	std::vector<UCHAR> consumer;
+	std::vector<UCHAR> rendered;
+
+	Stream(ULONG input, ULONG output, ULONG width, ULONG height)
+		: input(input), output(output), width(width), height(height),
+		lineBytes(ConvertLineBytes(output, width)),
+		producer(ConvertFrameSize(input, width, height)),
+		synthesis(ConvertFrameSize(output, width, height)),
+		consumer(synthesis.size()),
+		rendered(ConvertFrameSize(AvshwsFormatBgra, width, height))
+	{
+		for (UCHAR& byte : producer)
+		{
+			byte = (UCHAR)TestRandom();
+		}
+
+		history[0].resize(synthesis.size());
+		history[1].resize(synthesis.size());
+	}
+
+	// SetData: into the output format, bottom-up as GetStagingLayout has it.
+	bool Store(ULONG slot)
+	{
+		return ConvertFrame(
+			input,
+			producer.data(),
+			output,
+			history[slot].data() + (size_t)lineBytes * (height - 1),
+			-(LONG)lineBytes,
+			width,
+			height) != FALSE;
+	}
+
+	// ConvertFrameRate: the frame as it is, or half way between two.
+	void Select(ULONG weight)
+	{
+		if (weight)
+		{
+			FrcBlend(synthesis.data(), history[0].data(), history[1].data(), (ULONG)synthesis.size(), weight);
+		}
+		else
+		{
+			memcpy(synthesis.data(), history[0].data(), synthesis.size());
+		}
+	}
+
+	// WriteFrame: staged in the output format, so copied row by row.
+	void Write()
+	{
+		for (ULONG y = 0; y < height; y++)
+		{
+			memcpy(consumer.data() + (size_t)lineBytes * y, synthesis.data() + (size_t)lineBytes * y, lineBytes);
+		}
+	}
+
+	// The consumer: 32 bpp as it is, RGB24 expanded row for row.
+	void Render()
+	{
+		if (output == AvshwsFormatBgra)
+		{
+			return;
+		}
+
+		ConvertFrame(AvshwsFormatRgb24, consumer.data(), AvshwsFormatBgra, rendered.data(), (LONG)width * 4, width, height);
+	}
+
+	const std::vector<UCHAR>& Image()
+	{
+		return output == AvshwsFormatBgra ? consumer : rendered;
+	}
+};
+
+// The same color in every pixel of two 32 bpp images.
+static bool SameColor(const std::vector<UCHAR>& a, const std::vector<UCHAR>& b)
+{
+	for (size_t i = 0; i < a.size(); i += 4)
+	{
+		if (memcmp(&a[i], &b[i], 3) != 0)
+		{
+			return false;
+		}
+	}
+
+	return a.size() == b.size();
+}
+
+static void TestSameImage()
+{
+	const ULONG width = 96;
+	const ULONG height = 54;
+
+	for (ULONG input : g_Inputs)
+	{
+		Stream rgb24(input, AvshwsFormatRgb24, width, height);
+		Stream rgb32(input, AvshwsFormatBgra, width, height);
+
+		rgb32.producer = rgb24.producer;
+
+		for (ULONG weight = 0; weight < FRC_BLEND_ONE; weight += FRC_BLEND_ONE / 2)
+		{
+			for (Stream* stream : { &rgb24, &rgb32 })
+			{
+				CHECK(stream->Store(0));
+				CHECK(stream->Store(1));
+				stream->Select(weight);
+				stream->Write();
+				stream->Render();
+			}
+
+			bool same = SameColor(rgb24.Image(), rgb32.Image());
+
+			if (!same)
+			{
+				fprintf(stderr, "%s input: RGB24 and RGB32 output differ\n", FormatName(input));
+			}
+
+			CHECK(same);
+		}
+	}
+}
+
+static void Benchmark(ULONG width, ULONG height)
+{
+	const int iterations = 20;
+
+	for (ULONG input : g_Inputs)
+	{
+		for (ULONG output : { (ULONG)AvshwsFormatRgb24, (ULONG)AvshwsFormatBgra })
+		{
+			Stream stream(input, output, width, height);
+			double seconds[4] = {};
+
+			stream.Store(1);
+
+			for (int i = 0; i < iterations; i++)
+			{
+				double start = TestSeconds();
+				stream.Store(0);
+				double stored = TestSeconds();
+				stream.Select(i % 2 ? FRC_BLEND_ONE / 2 : 0);
+				double selected = TestSeconds();
+				stream.Write();
+				double written = TestSeconds();
+				stream.Render();
+				double rendered = TestSeconds();
+
+				seconds[0] += stored - start;
+				seconds[1] += selected - stored;
+				seconds[2] += written - selected;
+				seconds[3] += rendered - written;
+			}
+
+			double total = 0;
+
+			for (double& step : seconds)
+			{
+				step /= iterations;
+				total += step;
+			}
+
+			printf("%4lux%-4lu %-5s %-6s %7.3f %7.3f %7.3f %8.3f %7.3f\n",
+				(unsigned long)width, (unsigned long)height, FormatName(input), FormatName(output),
+				seconds[0] * 1e3, seconds[1] * 1e3, seconds[2] * 1e3, seconds[3] * 1e3, total * 1e3);
+		}
+	}
+}
+
+int main()
+{
+	TestSameImage();
+
+	printf("size      input output  store  tick   write   render  total ms\n");
+
+	Benchmark(1280, 720);
+	Benchmark(1920, 1080);
+
+	return TestResult();
+}
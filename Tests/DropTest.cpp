@@ -0,0 +1,281 @@
+//
+// Drop accounting (drops.h): a stream ticked the way the hardware
+// simulation does in mapped capture mode, with each failure mode injected
+// in turn (no buffer queued, buffers too small for a frame, producer
+// stalled, frames superseded, no slot free), checking that exactly the
+// right counter moves.  Then the counters under concurrent updates.
+//
+
+#include "portable.h"
+
+#include <thread>
+#include <vector>
+
+#include "Test.h"
+
+#define FRAME_SIZE 1000
+
+struct Pipeline
+{
+	UCHAR buffers[FRC_HISTORY_DEPTH][16];
+	CFrameHistory history;
+	CDropCounters drops;
+	ULONG queued;
+	LONGLONG now;
+
+	Pipeline() : queued(0), now(0)
+	{
+		for (ULONG slot = 0; slot < FRC_HISTORY_DEPTH; slot++)
+		{
+			history.SetBuffer(slot, buffers[slot]);
+		}
+
+		history.Reset();
+		drops.Reset();
+	}
+
+	// SetData: store a frame in the history.
+	void Inject()
+	{
+		BOOLEAN superseded;
+		ULONG slot = history.AcquireWriteSlot(&superseded);
+
+		drops.Store(superseded, slot != FRC_HISTORY_DEPTH);
+
+		if (slot != FRC_HISTORY_DEPTH)
+		{
+			history.Publish(slot, now, NULL);
+		}
+	}
+
+	// The consumer queues a buffer of some size.
+	void Queue(ULONG bytes)
+	{
+		queued += bytes;
+	}
+
+	// The interrupt: select a frame and fill it into the queued buffers
+	// if they take a whole frame.
+	void Tick()
+	{
+		FRC_SELECTION selection;
+
+		drops.Tick(history.GetSequence());
+
+		if (history.Select(FrcModeLatest, now, &selection))
+		{
+			history.Release(&selection);
+		}
+
+		BOOLEAN filled = queued >= FRAME_SIZE;
+		BOOLEAN buffersQueued = queued != 0;
+
+		if (filled)
+		{
+			queued -= FRAME_SIZE;
+		}
+
+		drops.Fill(filled, buffersQueued);
+
+		now += 333667;
+	}
+
+	// A healthy tick: a frame in, a buffer queued and filled.
+	void Healthy()
+	{
+		Inject();
+		Queue(FRAME_SIZE);
+		Tick();
+	}
+
+	bool Counts(LONG delivered, LONG noBuffer, LONG partial, LONG stalled, LONG superseded)
+	{
+		return drops.GetFramesDelivered() == delivered &&
+			drops.GetCount(DropNoBuffer) == noBuffer &&
+			drops.GetCount(DropPartialMapping) == partial &&
+			drops.GetCount(DropProducerStalled) == stalled &&
+			drops.GetCount(DropSuperseded) == superseded;
+	}
+};
+
+static void TestHealthy()
+{
+	Pipeline pipeline;
+
+	for (int i = 0; i < 100; i++)
+	{
+		pipeline.Healthy();
+	}
+
+	CHECK(pipeline.Counts(100, 0, 0, 0, 0));
+	CHECK(pipeline.drops.GetDropCount() == 0);
+}
+
+static void TestConsumerStarved()
+{
+	Pipeline pipeline;
+
+	pipeline.Healthy();
+
+	// The consumer stops queueing buffers for 5 ticks.
+	for (int i = 0; i < 5; i++)
+	{
+		pipeline.Inject();
+		pipeline.Tick();
+	}
+
+	pipeline.Healthy();
+
+	CHECK(pipeline.Counts(2, 5, 0, 0, 0));
+	CHECK(pipeline.drops.GetDropCount() == 5);
+}
+
+static void TestPartialMapping()
+{
+	Pipeline pipeline;
+
+	pipeline.Healthy();
+
+	// Buffers covering half a frame: two ticks lose their frame, then the
+	// queue covers one.
+	pipeline.Inject();
+	pipeline.Queue(FRAME_SIZE / 2);
+	pipeline.Tick();
+	pipeline.Inject();
+	pipeline.Tick();
+	pipeline.Inject();
+	pipeline.Queue(FRAME_SIZE / 2);
+	pipeline.Tick();
+
+	CHECK(pipeline.Counts(2, 0, 2, 0, 0));
+	CHECK(pipeline.drops.GetDropCount() == 2);
+}
+
+static void TestProducerStalled()
+{
+	Pipeline pipeline;
+
+	// Ticks before the first frame aren't stalls.
+	pipeline.Queue(FRAME_SIZE);
+	pipeline.Tick();
+
+	pipeline.Healthy();
+
+	// The producer stops for 7 ticks; the output repeats its last frame.
+	for (int i = 0; i < 7; i++)
+	{
+		pipeline.Queue(FRAME_SIZE);
+		pipeline.Tick();
+	}
+
+	pipeline.Healthy();
+
+	CHECK(pipeline.Counts(10, 0, 0, 7, 0));
+
+	// Stalls aren't frames the consumer missed.
+	CHECK(pipeline.drops.GetDropCount() == 0);
+}
+
+static void TestSuperseded()
+{
+	Pipeline pipeline;
+
+	pipeline.Healthy();
+
+	// The producer runs at three times the output rate: two of every three
+	// frames are replaced before a tick outputs them.
+	for (int i = 0; i < 10; i++)
+	{
+		pipeline.Inject();
+		pipeline.Inject();
+		pipeline.Inject();
+		pipeline.Queue(FRAME_SIZE);
+		pipeline.Tick();
+	}
+
+	// A frame is counted when it is overwritten, so the last two are
+	// counted once the history turns over.
+	CHECK(pipeline.Counts(11, 0, 0, 0, 18));
+
+	for (ULONG i = 0; i < FRC_HISTORY_DEPTH; i++)
+	{
+		pipeline.Healthy();
+	}
+
+	CHECK(pipeline.Counts(11 + FRC_HISTORY_DEPTH, 0, 0, 0, 20));
+	CHECK(pipeline.drops.GetDropCount() == 0);
+}
+
+static void TestNoSlot()
+{
+	Pipeline pipeline;
+	BOOLEAN superseded;
+	FRC_SELECTION selection;
+
+	pipeline.Healthy();
+	pipeline.Healthy();
+
+	// Two frames held for a blend and the third being written: the next
+	// frame has nowhere to go.
+	CHECK(pipeline.history.Select(FrcModeBlend, pipeline.now - 500000, &selection));
+	CHECK(selection.Weight != 0);
+
+	ULONG slot = pipeline.history.AcquireWriteSlot(&superseded);
+	CHECK(slot != FRC_HISTORY_DEPTH);
+
+	pipeline.Inject();
+
+	pipeline.history.Abandon(slot);
+	pipeline.history.Release(&selection);
+
+	CHECK(pipeline.Counts(2, 0, 0, 0, 1));
+}
+
+static void TestConcurrent()
+{
+	CDropCounters drops;
+	std::vector<std::thread> threads;
+
+	drops.Reset();
+
+	for (int t = 0; t < 4; t++)
+	{
+		threads.emplace_back([&drops, t]
+		{
+			for (int i = 0; i < 100000; i++)
+			{
+				drops.Fill(i % 4 == 0, t % 2 == 0);
+				drops.Store(i % 8 == 0, TRUE);
+			}
+		});
+	}
+
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+
+	CHECK(drops.GetFramesDelivered() == 4 * 25000);
+	CHECK(drops.GetCount(DropNoBuffer) == 2 * 75000);
+	CHECK(drops.GetCount(DropPartialMapping) == 2 * 75000);
+	CHECK(drops.GetCount(DropSuperseded) == 4 * 12500);
+
+	AVSHWS_STATISTICS statistics;
+	drops.GetStatistics(&statistics);
+
+	CHECK(statistics.FramesDelivered == 100000);
+	CHECK(statistics.DropNoBuffer + statistics.DropPartialMapping == 300000);
+}
+
+int main()
+{
+	TestHealthy();
+	TestConsumerStarved();
+	TestPartialMapping();
+	TestProducerStalled();
+	TestSuperseded();
+	TestNoSlot();
+	TestConcurrent();
+
+	return TestResult();
+}
@@ -0,0 +1,151 @@
+//
+// Time to the first valid frame of a stream, on a fake clock.  A stream
+// is started at a random phase of a 30, 15 or 5 fps producer, with the
+// ticks selecting the newest injected frame from the frame history (frc.h).
+// Three ways of starting are compared:
+//
+//     black, first tick a period after RUN (how streams used to start)
+//     black, first tick at RUN
+//     the held frame (the last frame injected, or the slate) staged at
+//     Start and delivered by the first tick at RUN
+//
+// A frame is valid once it is a picture rather than the black a stream
+// starts with.  The held frame is in the synthesis buffer before RUN, so
+// the first tick delivers it whatever the producer does; only the time to
+// stage it is measured, a conversion timed here at 1080p and 4K.
+//
+
+#include "portable.h"
+
+#include <vector>
+
+#include "Test.h"
+
+#define OUTPUT_PERIOD 333667
+#define STARTS 10000
+
+struct Result
+{
+	double mean;
+	double worst;
+};
+
+//
+// The time from RUN to the first tick delivering a picture, in 100ns units.
+// The producer injects its first frame after this stream started at Phase.
+//
+static LONGLONG FirstValid(LONGLONG producerPeriod, LONGLONG phase, bool immediate)
+{
+	static UCHAR buffers[FRC_HISTORY_DEPTH][16];
+	CFrameHistory history;
+
+	for (ULONG slot = 0; slot < FRC_HISTORY_DEPTH; slot++)
+	{
+		history.SetBuffer(slot, buffers[slot]);
+	}
+
+	history.Reset();
+
+	LONGLONG nextInject = phase;
+	LONGLONG tick = immediate ? 0 : OUTPUT_PERIOD;
+
+	for (;;)
+	{
+		// The producer's frames up to this tick.
+		for (; nextInject <= tick; nextInject += producerPeriod)
+		{
+			BOOLEAN superseded;
+			history.Publish(history.AcquireWriteSlot(&superseded), nextInject, NULL);
+		}
+
+		FRC_SELECTION selection;
+		bool selected = history.Select(FrcModeLatest, tick, &selection) != FALSE;
+
+		if (selected)
+		{
+			history.Release(&selection);
+		}
+
+		if (selected)
+		{
+			return tick;
+		}
+
+		tick += OUTPUT_PERIOD;
+	}
+}
+
+// Over the same STARTS random phases for each way of starting.
+static Result Measure(LONGLONG producerPeriod, bool immediate)
+{
+	Result result = { 0, 0 };
+	unsigned int random = 0x2545F491;
+
+	for (int i = 0; i < STARTS; i++)
+	{
+		random ^= random << 13;
+		random ^= random >> 17;
+		random ^= random << 5;
+
+		LONGLONG phase = random % producerPeriod;
+		double ms = FirstValid(producerPeriod, phase, immediate) / 1e4;
+
+		result.mean += ms;
+		result.worst = ms > result.worst ? ms : result.worst;
+	}
+
+	result.mean /= STARTS;
+
+	return result;
+}
+
+// The time to stage a held BGRA frame into an RGB24 synthesis buffer.
+static double StagingMs(ULONG width, ULONG height)
+{
+	std::vector<UCHAR> held(ConvertFrameSize(AvshwsFormatBgra, width, height), 0x80);
+	std::vector<UCHAR> synthesis(ConvertFrameSize(AvshwsFormatRgb24, width, height));
+	const int iterations = 10;
+
+	double start = TestSeconds();
+
+	for (int i = 0; i < iterations; i++)
+	{
+		CHECK(ConvertFrame(AvshwsFormatBgra, held.data(), AvshwsFormatRgb24, synthesis.data(), (LONG)ConvertLineBytes(AvshwsFormatRgb24, width), width, height));
+	}
+
+	return (TestSeconds() - start) / iterations * 1e3;
+}
+
+int main()
+{
+	static const LONGLONG producerPeriods[] = { 333333, 666667, 2000000 };
+
+	double staging1080 = StagingMs(1920, 1080);
+	double staging4K = StagingMs(3840, 2160);
+
+	printf("first valid frame after RUN             mean      worst\n");
+
+	for (LONGLONG producerPeriod : producerPeriods)
+	{
+		Result late = Measure(producerPeriod, false);
+		Result immediate = Measure(producerPeriod, true);
+
+		// Without a held frame the first picture waits for the producer's
+		// first frame and the tick after it; a tick at RUN saves a period
+		// only if the producer's frame comes before the second tick.
+		CHECK(late.mean >= OUTPUT_PERIOD / 1e4);
+		CHECK(late.worst <= (producerPeriod + 2 * OUTPUT_PERIOD) / 1e4);
+		CHECK(immediate.mean <= late.mean);
+		CHECK(immediate.worst <= (producerPeriod + OUTPUT_PERIOD) / 1e4);
+
+		ULONG fps = (ULONG)((10000000 + producerPeriod / 2) / producerPeriod);
+
+		printf("%2lu fps black, first tick a period on  %6.2f ms %6.2f ms\n", (unsigned long)fps, late.mean, late.worst);
+		printf("%2lu fps black, first tick at RUN       %6.2f ms %6.2f ms\n", (unsigned long)fps, immediate.mean, immediate.worst);
+	}
+
+	printf("held frame, 1080p                      %6.2f ms %6.2f ms\n", staging1080, staging1080);
+	printf("held frame, 4K                         %6.2f ms %6.2f ms\n", staging4K, staging4K);
+
+	return TestResult();
+}
@@ -0,0 +1,393 @@
+//
+// Frame rate conversion (frc.h): producers at 24, 25, 50 and 60 fps into
+// the 29.97 fps stream, ticked the way CHardwareSimulation::ConvertFrameRate
+// does.  The error of a tick is the shown frame's timestamp less the output
+// time.  Nearest must stay within half an input period; blend must hit the
+// output time whenever a frame on either side of it is there, which needs
+// input faster than the output.  Then the blend kernels against the
+// formula, P010 frames blended as a tick blends them, and the kernels'
+// throughput.
+//
+
+#include "portable.h"
+
+#include <math.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "Test.h"
+
+#define OUTPUT_PERIOD 333667
+
+static const char* modeNames[] = { "latest", "nearest", "blend" };
+
+struct Judder
+{
+	double mean;
+	double absolute;
+	double deviation;
+	LONGLONG worst;
+	int exact;
+	int ticks;
+};
+
+//
+// Runs 10 s of a producer injecting every inputPeriod into a three slot
+// history, with an output tick every OUTPUT_PERIOD selecting the frame
+// for a frame period before the tick.
+//
+static Judder Convert(LONGLONG inputPeriod, FRC_MODE mode)
+{
+	static UCHAR buffers[FRC_HISTORY_DEPTH][16];
+
+	CFrameHistory history;
+
+	for (ULONG slot = 0; slot < FRC_HISTORY_DEPTH; slot++)
+	{
+		history.SetBuffer(slot, buffers[slot]);
+	}
+	history.Reset();
+
+	std::vector<LONGLONG> errors;
+	Judder judder = {};
+	LONGLONG nextInput = 0;
+
+	// Start the ticks off the input phase.
+	for (LONGLONG tick = OUTPUT_PERIOD + 12345; tick < 100000000; tick += OUTPUT_PERIOD)
+	{
+		for (; nextInput <= tick; nextInput += inputPeriod)
+		{
+			BOOLEAN superseded;
+			ULONG slot = history.AcquireWriteSlot(&superseded);
+
+			CHECK(slot != FRC_HISTORY_DEPTH);
+			history.Publish(slot, nextInput, NULL);
+		}
+
+		LONGLONG outputTime = tick - OUTPUT_PERIOD;
+		FRC_SELECTION selection;
+
+		if (!history.Select(mode, outputTime, &selection))
+		{
+			continue;
+		}
+
+		history.Release(&selection);
+
+		// Let the history fill before measuring.
+		if (tick < 10 * OUTPUT_PERIOD)
+		{
+			continue;
+		}
+
+		LONGLONG error = selection.Time - outputTime;
+
+		errors.push_back(error);
+		judder.worst = std::max(judder.worst, error < 0 ? -error : error);
+		judder.exact += error == 0;
+	}
+
+	double sum = 0;
+	double absolute = 0;
+	double squares = 0;
+
+	for (LONGLONG error : errors)
+	{
+		sum += (double)error;
+		absolute += (double)(error < 0 ? -error : error);
+	}
+	judder.mean = sum / errors.size();
+	judder.absolute = absolute / errors.size();
+
+	for (LONGLONG error : errors)
+	{
+		squares += ((double)error - judder.mean) * ((double)error - judder.mean);
+	}
+	judder.deviation = sqrt(squares / errors.size());
+	judder.ticks = (int)errors.size();
+
+	return judder;
+}
+
+static void TestJudder()
+{
+	static const LONGLONG inputPeriods[] = { 416667, 400000, 200000, 166667 };
+
+	for (LONGLONG inputPeriod : inputPeriods)
+	{
+		Judder judders[FrcModeMax];
+
+		for (int mode = 0; mode < FrcModeMax; mode++)
+		{
+			judders[mode] = Convert(inputPeriod, (FRC_MODE)mode);
+
+			printf("%5.2f fps %-7s: error mean %8.1f us, mean absolute %7.1f us, deviation %7.1f us, worst %7.1f us, exact %3d%%\n",
+				1e7 / inputPeriod, modeNames[mode],
+				judders[mode].mean / 10, judders[mode].absolute / 10, judders[mode].deviation / 10,
+				judders[mode].worst / 10.0, judders[mode].exact * 100 / judders[mode].ticks);
+		}
+
+		// Nearest is never more than half an input period off, and closer
+		// on average than the latest frame.
+		CHECK(judders[FrcModeNearest].worst <= inputPeriod / 2 + 1);
+		CHECK(judders[FrcModeNearest].absolute < judders[FrcModeLatest].absolute);
+
+		// Blend is never worse than nearest.  With input faster than the
+		// output there is always a frame after the output time, and blend
+		// shows the output time itself, or a frame within 1/512 of an input
+		// period where the weight rounds to one of the two.
+		CHECK(judders[FrcModeBlend].worst <= judders[FrcModeNearest].worst);
+		CHECK(judders[FrcModeBlend].absolute < judders[FrcModeNearest].absolute);
+
+		if (inputPeriod < OUTPUT_PERIOD)
+		{
+			CHECK(judders[FrcModeBlend].worst <= inputPeriod / (2 * FRC_BLEND_ONE) + 1);
+		}
+	}
+}
+
+static void TestSelection()
+{
+	static UCHAR buffers[FRC_HISTORY_DEPTH][16];
+
+	CFrameHistory history;
+	FRC_SELECTION selection;
+	BOOLEAN superseded;
+
+	for (ULONG slot = 0; slot < FRC_HISTORY_DEPTH; slot++)
+	{
+		history.SetBuffer(slot, buffers[slot]);
+	}
+	history.Reset();
+
+	CHECK(!history.Select(FrcModeLatest, 0, &selection));
+
+	history.Publish(history.AcquireWriteSlot(&superseded), 1000, NULL);
+	history.Publish(history.AcquireWriteSlot(&superseded), 2000, NULL);
+	history.Publish(history.AcquireWriteSlot(&superseded), 3000, NULL);
+
+	CHECK(history.Select(FrcModeLatest, 0, &selection));
+	CHECK(selection.Time == 3000);
+	history.Release(&selection);
+
+	CHECK(history.Select(FrcModeNearest, 1600, &selection));
+	CHECK(selection.Time == 2000);
+	history.Release(&selection);
+
+	// A quarter of the way from 1000 to 2000.
+	CHECK(history.Select(FrcModeBlend, 1250, &selection));
+	CHECK(selection.Weight == FRC_BLEND_ONE / 4);
+	CHECK(selection.Time == 1250);
+
+	// The blended frames are held: the writer gets the third slot, which
+	// was selected before, and then nothing.
+	ULONG slot = history.AcquireWriteSlot(&superseded);
+
+	CHECK(slot != FRC_HISTORY_DEPTH && !superseded);
+	CHECK(history.AcquireWriteSlot(&superseded) == FRC_HISTORY_DEPTH);
+
+	history.Publish(slot, 4000, NULL);
+	history.Release(&selection);
+
+	// 1000 and 2000 were output; 4000 never was, so overwriting it counts
+	// as superseded.
+	history.Publish(history.AcquireWriteSlot(&superseded), 5000, NULL);
+	CHECK(!superseded);
+	history.Publish(history.AcquireWriteSlot(&superseded), 6000, NULL);
+	CHECK(!superseded);
+	history.AcquireWriteSlot(&superseded);
+	CHECK(superseded);
+}
+
+static void TestBlend()
+{
+	std::vector<UCHAR> earlier(4099);
+	std::vector<UCHAR> later(earlier.size());
+	std::vector<UCHAR> blended(earlier.size());
+	std::vector<USHORT> earlier16(earlier.size());
+	std::vector<USHORT> later16(earlier.size());
+	std::vector<USHORT> blended16(earlier.size());
+
+	for (size_t i = 0; i < earlier.size(); i++)
+	{
+		earlier[i] = (UCHAR)TestRandom();
+		later[i] = (UCHAR)TestRandom();
+		earlier16[i] = (USHORT)(TestRandom() & 0xFFC0);
+		later16[i] = (USHORT)(TestRandom() & 0xFFC0);
+	}
+
+	// The ends of the range too.
+	earlier[0] = 255;
+	later[0] = 255;
+	earlier16[0] = 0xFFFF;
+	later16[0] = 0xFFFF;
+
+	int mismatches = 0;
+
+	for (ULONG weight = 0; weight <= FRC_BLEND_ONE; weight++)
+	{
+		FrcBlend(blended.data(), earlier.data(), later.data(), (ULONG)blended.size(), weight);
+		FrcBlend16(blended16.data(), earlier16.data(), later16.data(), (ULONG)blended16.size(), weight);
+
+		for (size_t i = 0; i < blended.size(); i++)
+		{
+			ULONG expected = (earlier[i] * (FRC_BLEND_ONE - weight) + later[i] * weight + FRC_BLEND_ONE / 2) >> 8;
+			ULONG expected16 = (earlier16[i] * (FRC_BLEND_ONE - weight) + later16[i] * weight + FRC_BLEND_ONE / 2) >> 8;
+
+			mismatches += blended[i] != expected;
+			mismatches += blended16[i] != expected16;
+		}
+	}
+
+	CHECK(mismatches == 0);
+}
+
+//
+// A P010 history blended the way ConvertFrameRate does it: FrcBlend16 over
+// the whole staged frame, luma and chroma plane, as 16 bit samples.  Each
+// sample must be the blend of its 10 bit sources rounded to within one
+// step, and an unblended end must come through exactly.
+//
+static void TestBlendP010()
+{
+	// Not a multiple of the 8 samples the vector loop takes.
+	const ULONG width = 38;
+	const ULONG height = 22;
+
+	std::vector<UCHAR> image(width * height * 4);
+	std::vector<UCHAR> earlier(ConvertFrameSize(AvshwsFormatP010, width, height));
+	std::vector<UCHAR> later(earlier.size());
+	std::vector<UCHAR> blended(earlier.size());
+
+	for (std::vector<UCHAR>* frame : { &earlier, &later })
+	{
+		for (UCHAR& byte : image)
+		{
+			byte = (UCHAR)TestRandom();
+		}
+
+		CHECK(ConvertFrame(AvshwsFormatBgra, image.data(), AvshwsFormatP010, frame->data(), width * 2, width, height));
+	}
+
+	ULONG count = (ULONG)blended.size() / sizeof(USHORT);
+	int mismatches = 0;
+
+	for (ULONG weight = 0; weight <= FRC_BLEND_ONE; weight += 8)
+	{
+		FrcBlend16((PUSHORT)blended.data(), (const USHORT*)earlier.data(), (const USHORT*)later.data(), count, weight);
+
+		for (ULONG i = 0; i < count; i++)
+		{
+			LONG a = ((const USHORT*)earlier.data())[i] >> 6;
+			LONG b = ((const USHORT*)later.data())[i] >> 6;
+			LONG c = ((const USHORT*)blended.data())[i] >> 6;
+			double expected = (a * (double)(FRC_BLEND_ONE - weight) + b * (double)weight) / FRC_BLEND_ONE;
+
+			mismatches += fabs(c - expected) > 1;
+		}
+
+		if (weight == 0)
+		{
+			CHECK(blended == earlier);
+		}
+
+		if (weight == FRC_BLEND_ONE)
+		{
+			CHECK(blended == later);
+		}
+	}
+
+	CHECK(mismatches == 0);
+}
+
+static void BenchmarkBlend(const char* name, ULONG width, ULONG height, ULONG bytesPerPixel)
+{
+	ULONG length = width * height * bytesPerPixel;
+	std::vector<UCHAR> earlier(length, 10);
+	std::vector<UCHAR> later(length, 200);
+	std::vector<UCHAR> blended(length);
+
+	const int iterations = 50;
+	double start = TestSeconds();
+
+	for (int i = 0; i < iterations; i++)
+	{
+		FrcBlend(blended.data(), earlier.data(), later.data(), length, 1 + i);
+	}
+
+	double seconds = (TestSeconds() - start) / iterations;
+
+	printf("blend %-14s %7.3f ms/frame, %6.2f GB/s\n", name, seconds * 1e3, length / seconds / 1e9);
+}
+
+static void BenchmarkBlend16(const char* name, ULONG width, ULONG height)
+{
+	ULONG count = width * height * 3 / 2;
+	std::vector<USHORT> earlier(count, 1000);
+	std::vector<USHORT> later(count, 60000);
+	std::vector<USHORT> blended(count);
+
+	const int iterations = 50;
+	double start = TestSeconds();
+
+	for (int i = 0; i < iterations; i++)
+	{
+		FrcBlend16(blended.data(), earlier.data(), later.data(), count, 1 + i);
+	}
+
+	double seconds = (TestSeconds() - start) / iterations;
+
+	printf("blend %-14s %7.3f ms/frame, %6.2f GB/s\n", name, seconds * 1e3, count * 2 / seconds / 1e9);
+}
+
+static void BenchmarkSelect()
+{
+	static UCHAR buffers[FRC_HISTORY_DEPTH][16];
+
+	CFrameHistory history;
+
+	for (ULONG slot = 0; slot < FRC_HISTORY_DEPTH; slot++)
+	{
+		history.SetBuffer(slot, buffers[slot]);
+	}
+	history.Reset();
+
+	const int iterations = 1000000;
+	LONGLONG time = 0;
+	double start = TestSeconds();
+
+	for (int i = 0; i < iterations; i++)
+	{
+		BOOLEAN superseded;
+		FRC_SELECTION selection;
+
+		history.Publish(history.AcquireWriteSlot(&superseded), time, NULL);
+		time += 166667;
+
+		if (history.Select(FrcModeBlend, time - 250000, &selection))
+		{
+			history.Release(&selection);
+		}
+	}
+
+	double seconds = TestSeconds() - start;
+
+	printf("publish and blend select: %.1f ns\n", seconds / iterations * 1e9);
+}
+
+int main()
+{
+	TestSelection();
+	TestJudder();
+	TestBlend();
+	TestBlendP010();
+
+	BenchmarkSelect();
+	BenchmarkBlend("RGB24 720p", 1280, 720, 3);
+	BenchmarkBlend("RGB32 1080p", 1920, 1080, 4);
+	BenchmarkBlend("NV12 2160p", 3840, 2160 * 3 / 2, 1);
+	BenchmarkBlend16("P010 1080p", 1920, 1080);
+
+	return TestResult();
+}
@@ -0,0 +1,406 @@
+//
+// The latency probe: codes stamped by the driver (probe.h) into frames
+// staged as RGB24, RGB32, P010 and NV12, delivered as the capture pin
+// delivers them (copied, or converted from NV12 staging; RGB bottom-up)
+// and decoded by the driver interface (LatencyProbe.h).  Every frame ID
+// and timestamp, extremes included, must come back exactly, a repeated
+// or skipped frame must show in the decoded IDs, and frames without a
+// code, with a corrupt one or too small must be refused.  Then the
+// latency from stamp to decoded in each path at 720p and 1080p, as
+// percentiles, and the cost of stamping and decoding alone.
+//
+
+#include "portable.h"
+#include "LatencyProbe.h"
+
+#include <inttypes.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "Test.h"
+
+#define WIDTH 320
+#define HEIGHT 180
+
+struct Path
+{
+	ULONG staging;
+	ULONG output;
+};
+
+// Native staging delivers the staged frame as it is; NV12 staging
+// converts it to the output format.
+static const Path g_Paths[] =
+{
+	{ AvshwsFormatRgb24, AvshwsFormatRgb24 },
+	{ AvshwsFormatBgra, AvshwsFormatBgra },
+	{ AvshwsFormatP010, AvshwsFormatP010 },
+	{ AvshwsFormatNv12, AvshwsFormatRgb24 },
+	{ AvshwsFormatNv12, AvshwsFormatBgra },
+	{ AvshwsFormatNv12, AvshwsFormatNv12 },
+	{ AvshwsFormatNv12, AvshwsFormatP010 },
+};
+
+static const char* FormatName(ULONG format)
+{
+	switch (format)
+	{
+	case AvshwsFormatRgb24: return "RGB24";
+	case AvshwsFormatBgra: return "RGB32";
+	case AvshwsFormatNv12: return "NV12";
+	case AvshwsFormatP010: return "P010";
+	}
+
+	return "?";
+}
+
+// RGB is a bottom-up DIB, YUV top-down, as the driver lays them out.
+static bool BottomUp(ULONG format)
+{
+	return format == AvshwsFormatRgb24 || format == AvshwsFormatBgra;
+}
+
+static uint32_t ProbeFormat(ULONG format)
+{
+	switch (format)
+	{
+	case AvshwsFormatRgb24: return PROBE_FORMAT_RGB24;
+	case AvshwsFormatBgra: return PROBE_FORMAT_RGB32;
+	case AvshwsFormatP010: return PROBE_FORMAT_Y16;
+	}
+
+	return PROBE_FORMAT_Y8;
+}
+
+//
+// The frames of one path: the producer's BGRA frame, the staged frame
+// and the delivered one.
+//
+struct Pipeline
+{
+	Path path;
+	ULONG width;
+	ULONG height;
+	std::vector<UCHAR> source;
+	std::vector<UCHAR> staged;
+	std::vector<UCHAR> delivered;
+
+	Pipeline(const Path& path, ULONG width, ULONG height)
+		: path(path), width(width), height(height),
+		source((size_t)width * height * 4),
+		staged(ConvertFrameSize(path.staging, width, height)),
+		delivered(ConvertFrameSize(path.output, width, height))
+	{
+		for (UCHAR& byte : source)
+		{
+			byte = (UCHAR)TestRandom();
+		}
+	}
+
+	// The displayed top row and the signed stride of a frame in format.
+	void Layout(std::vector<UCHAR>& frame, ULONG format, PUCHAR* topRow, LONG* stride)
+	{
+		ULONG lineBytes = ConvertLineBytes(format, width);
+
+		*topRow = frame.data();
+		*stride = (LONG)lineBytes;
+
+		if (BottomUp(format))
+		{
+			*topRow += (size_t)lineBytes * (height - 1);
+			*stride = -*stride;
+		}
+	}
+
+	// As SetData: convert into the staging format, then stamp.
+	void Inject(ULONG frameId, LONGLONG timestamp)
+	{
+		PUCHAR topRow;
+		LONG stride;
+		Layout(staged, path.staging, &topRow, &stride);
+
+		CHECK(ConvertFrame(AvshwsFormatBgra, source.data(), path.staging, topRow, stride, width, height));
+
+		PROBE_CODE code = { frameId, timestamp };
+		ProbeStamp(topRow, stride, ConvertLineBytes(path.staging, 1), &code);
+	}
+
+	// As WriteFrame: a copy, or a conversion from NV12 staging.
+	void Deliver()
+	{
+		if (path.staging == path.output)
+		{
+			memcpy(delivered.data(), staged.data(), staged.size());
+			return;
+		}
+
+		PUCHAR topRow;
+		LONG stride;
+		Layout(delivered, path.output, &topRow, &stride);
+
+		CHECK(ConvertFrame(path.staging, staged.data(), path.output, topRow, stride, width, height));
+	}
+
+	bool Decode(uint32_t* frameId, int64_t* timestamp)
+	{
+		return DecodeLatencyProbe(
+			delivered.data(),
+			(int32_t)ConvertLineBytes(path.output, width),
+			width,
+			height,
+			ProbeFormat(path.output),
+			BottomUp(path.output),
+			frameId,
+			timestamp);
+	}
+};
+
+static void TestRoundTrip()
+{
+	struct Code
+	{
+		ULONG frameId;
+		LONGLONG timestamp;
+	};
+
+	static const Code codes[] =
+	{
+		{ 0, 0 },
+		{ 1, 333667 },
+		{ 0xFFFFFFFF, INT64_MAX },
+		{ 0x80000001, INT64_MIN },
+		{ 0x12345678, -1 },
+		{ 0xA5A5A5A5, 0x5A5A5A5A5A5A5A5ALL },
+	};
+
+	for (const Path& path : g_Paths)
+	{
+		Pipeline pipeline(path, WIDTH, HEIGHT);
+
+		for (const Code& code : codes)
+		{
+			uint32_t frameId = ~code.frameId;
+			int64_t timestamp = ~code.timestamp;
+
+			pipeline.Inject(code.frameId, code.timestamp);
+			pipeline.Deliver();
+
+			bool decoded = pipeline.Decode(&frameId, &timestamp);
+
+			if (!decoded || frameId != code.frameId || timestamp != code.timestamp)
+			{
+				fprintf(stderr, "%s staged, %s delivered: frame %08x not decoded\n",
+					FormatName(path.staging), FormatName(path.output), code.frameId);
+			}
+
+			CHECK(decoded);
+			CHECK(frameId == code.frameId);
+			CHECK(timestamp == code.timestamp);
+		}
+
+		// The smallest frame that holds the code.
+		Pipeline smallest(path, PROBE_CODE_WIDTH, PROBE_CODE_HEIGHT);
+		uint32_t frameId = 0;
+		int64_t timestamp = 0;
+
+		smallest.Inject(77, 88);
+		smallest.Deliver();
+
+		CHECK(smallest.Decode(&frameId, &timestamp));
+		CHECK(frameId == 77 && timestamp == 88);
+	}
+}
+
+//
+// A consumer spots repeated and skipped frames from the decoded IDs: here
+// a 24 fps producer read at 30 fps repeats a frame in five, and a 60 fps
+// one read at 30 fps has every other frame skipped.
+//
+static void TestRepeatsAndSkips()
+{
+	struct Rate
+	{
+		ULONG producerFps;
+		ULONG repeats;
+		ULONG skips;
+	};
+
+	static const Rate rates[] =
+	{
+		{ 24, 6, 0 },
+		{ 30, 0, 0 },
+		{ 60, 0, 30 },
+	};
+
+	Pipeline pipeline({ AvshwsFormatNv12, AvshwsFormatBgra }, WIDTH, HEIGHT);
+
+	for (const Rate& rate : rates)
+	{
+		ULONG repeats = 0;
+		ULONG skips = 0;
+		uint32_t last = 0;
+
+		// One second at 30 fps: the newest frame the producer had at each tick.
+		for (ULONG tick = 1; tick <= 31; tick++)
+		{
+			ULONG newest = tick * rate.producerFps / 30;
+			uint32_t frameId = 0;
+			int64_t timestamp = 0;
+
+			pipeline.Inject(newest, (LONGLONG)newest * 10000000 / rate.producerFps);
+			pipeline.Deliver();
+
+			CHECK(pipeline.Decode(&frameId, &timestamp));
+			CHECK(frameId == newest);
+
+			if (tick > 1)
+			{
+				repeats += frameId == last;
+				skips += frameId > last + 1 ? frameId - last - 1 : 0;
+			}
+
+			last = frameId;
+		}
+
+		CHECK(repeats == rate.repeats);
+		CHECK(skips == rate.skips);
+	}
+}
+
+static void TestRefused()
+{
+	Pipeline pipeline({ AvshwsFormatBgra, AvshwsFormatBgra }, WIDTH, HEIGHT);
+	uint32_t frameId;
+	int64_t timestamp;
+
+	// No code: the producer's frame as it is.
+	pipeline.Inject(1, 2);
+	memcpy(pipeline.delivered.data(), pipeline.source.data(), pipeline.delivered.size());
+	CHECK(!pipeline.Decode(&frameId, &timestamp));
+
+	// A flat frame has no sync row.
+	memset(pipeline.delivered.data(), 0x80, pipeline.delivered.size());
+	CHECK(!pipeline.Decode(&frameId, &timestamp));
+
+	// One payload cell flipped fails the CRC.
+	pipeline.Deliver();
+	CHECK(pipeline.Decode(&frameId, &timestamp));
+
+	PUCHAR topRow;
+	LONG stride;
+	pipeline.Layout(pipeline.delivered, AvshwsFormatBgra, &topRow, &stride);
+
+	for (ULONG y = PROBE_CELL_SIZE * 2; y < PROBE_CELL_SIZE * 3; y++)
+	{
+		for (ULONG x = PROBE_CELL_SIZE * 5; x < PROBE_CELL_SIZE * 6; x++)
+		{
+			for (ULONG c = 0; c < 3; c++)
+			{
+				topRow[(ptrdiff_t)y * stride + x * 4 + c] ^= 0xFF;
+			}
+		}
+	}
+
+	CHECK(!pipeline.Decode(&frameId, &timestamp));
+
+	// Too small for a code, or an unknown layout.
+	pipeline.Deliver();
+	CHECK(!DecodeLatencyProbe(pipeline.delivered.data(), WIDTH * 4, PROBE_CODE_WIDTH - 1, HEIGHT, PROBE_FORMAT_RGB32, false, &frameId, &timestamp));
+	CHECK(!DecodeLatencyProbe(pipeline.delivered.data(), WIDTH * 4, WIDTH, PROBE_CODE_HEIGHT - 1, PROBE_FORMAT_RGB32, false, &frameId, &timestamp));
+	CHECK(!DecodeLatencyProbe(pipeline.delivered.data(), WIDTH * 4, WIDTH, HEIGHT, PROBE_FORMAT_Y16 + 1, false, &frameId, &timestamp));
+	CHECK(!DecodeLatencyProbe(NULL, WIDTH * 4, WIDTH, HEIGHT, PROBE_FORMAT_RGB32, false, &frameId, &timestamp));
+}
+
+// 100ns units, as the performance counter the driver stamps.
+static LONGLONG Now()
+{
+	return (LONGLONG)(TestSeconds() * 1e7);
+}
+
+static double Percentile(const std::vector<LONGLONG>& sorted, double fraction)
+{
+	return sorted[std::min(sorted.size() - 1, (size_t)(sorted.size() * fraction))] / 10.0;
+}
+
+//
+// Each frame is stamped with the time it is injected and decoded once it
+// is delivered; the latency is the time between, on this machine's work
+// alone (the driver's wait for the next tick comes on top).
+//
+static void Benchmark()
+{
+	struct Size
+	{
+		const char* name;
+		ULONG width;
+		ULONG height;
+	};
+
+	static const Size sizes[] =
+	{
+		{ "720p", 1280, 720 },
+		{ "1080p", 1920, 1080 },
+	};
+
+	const int frames = 200;
+
+	printf("size   staged  delivered  latency us: p50      p90      p99      max   stamp us  decode us\n");
+
+	for (const Size& size : sizes)
+	{
+		for (const Path& path : g_Paths)
+		{
+			Pipeline pipeline(path, size.width, size.height);
+			std::vector<LONGLONG> latencies;
+			double stampSeconds = 0;
+			double decodeSeconds = 0;
+
+			for (int frame = 1; frame <= frames; frame++)
+			{
+				PUCHAR topRow;
+				LONG stride;
+				pipeline.Layout(pipeline.staged, path.staging, &topRow, &stride);
+
+				LONGLONG injected = Now();
+
+				CHECK(ConvertFrame(AvshwsFormatBgra, pipeline.source.data(), path.staging, topRow, stride, size.width, size.height));
+
+				double stampStart = TestSeconds();
+				PROBE_CODE code = { (ULONG)frame, injected };
+				ProbeStamp(topRow, stride, ConvertLineBytes(path.staging, 1), &code);
+				stampSeconds += TestSeconds() - stampStart;
+
+				pipeline.Deliver();
+
+				uint32_t frameId = 0;
+				int64_t timestamp = 0;
+
+				double decodeStart = TestSeconds();
+				bool decoded = pipeline.Decode(&frameId, &timestamp);
+				decodeSeconds += TestSeconds() - decodeStart;
+
+				CHECK(decoded && frameId == (uint32_t)frame && timestamp == injected);
+
+				latencies.push_back(Now() - timestamp);
+			}
+
+			std::sort(latencies.begin(), latencies.end());
+
+			printf("%-6s %-7s %-9s %18.1f %8.1f %8.1f %8.1f %10.2f %10.2f\n",
+				size.name, FormatName(path.staging), FormatName(path.output),
+				Percentile(latencies, 0.5), Percentile(latencies, 0.9), Percentile(latencies, 0.99), latencies.back() / 10.0,
+				stampSeconds * 1e6 / frames, decodeSeconds * 1e6 / frames);
+		}
+	}
+}
+
+int main()
+{
+	TestRoundTrip();
+	TestRepeatsAndSkips();
+	TestRefused();
+	Benchmark();
+
+	return TestResult();
+}
@@ -0,0 +1,251 @@
+//
+// The text overlay of the image synthesizers (image.h).  Opaque and
+// transparent overlays in every format the synthesizers draw, at scales 1
+// to 4, must match the overlay as the old bit by bit renderer defined it
+// (border, glyph rows repeated Scaling times, a separator column after
+// each character), drawn pixel by pixel through PutPixel: a run of clock
+// strings redrawn through the cache, changed colors and lengths, centered
+// overlays, overlays clipped at the right and bottom edges, strings longer
+// than the cache and characters above 127.  Then the cost of a 20
+// character timecode redrawn every frame at scales 1 to 4, opaque and
+// transparent, against drawing it pixel by pixel.
+//
+
+#include "portable.h"
+
+#include <stdio.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Test.h"
+
+#define WIDTH 320
+#define HEIGHT 120
+
+struct Synthesizer
+{
+	const char* name;
+	ULONG format;
+	BOOLEAN flipVertical;
+};
+
+static const Synthesizer g_Synthesizers[] =
+{
+	{ "RGB24", AvshwsFormatRgb24, FALSE },
+	{ "RGB24 bottom-up", AvshwsFormatRgb24, TRUE },
+	{ "RGB32 bottom-up", AvshwsFormatBgra, TRUE },
+	{ "YUY2", AvshwsFormatYuy2, FALSE },
+	{ "P010", AvshwsFormatP010, FALSE },
+};
+
+static std::unique_ptr<CImageSynthesizer> CreateSynthesizer(const Synthesizer& synthesizer, ULONG width, ULONG height)
+{
+	switch (synthesizer.format)
+	{
+	case AvshwsFormatRgb24:
+		return std::unique_ptr<CImageSynthesizer>(new CRGB24Synthesizer(synthesizer.flipVertical, width, height));
+
+	case AvshwsFormatBgra:
+		return std::unique_ptr<CImageSynthesizer>(new CRGB32Synthesizer(synthesizer.flipVertical, width, height));
+
+	case AvshwsFormatYuy2:
+		return std::unique_ptr<CImageSynthesizer>(new CYUVSynthesizer(width, height));
+	}
+
+	return std::unique_ptr<CImageSynthesizer>(new CP010Synthesizer(width, height));
+}
+
+//
+// The overlay as the old renderer defined it, drawn one PutPixel at a time
+// onto Synth.  Only Scaling, the text and the colors are taken from the
+// caller; the size, centering and clipping are worked out here.
+//
+static void ReferenceOverlay(CImageSynthesizer& synth, ULONG width, ULONG height, ULONG locX, ULONG locY, ULONG scaling, const char* text, COLOR bgColor, COLOR fgColor)
+{
+	ULONG length = (ULONG)strlen(text);
+	ULONG cellWidth = scaling * 8 + 1;
+	ULONG lenX = length * cellWidth + 1;
+	ULONG lenY = scaling * 8 + 2;
+
+	if (locX == POSITION_CENTER)
+	{
+		locX = lenX >= width ? 0 : width / 2 - lenX / 2;
+	}
+
+	if (locY == POSITION_CENTER)
+	{
+		locY = lenY >= height ? 0 : height / 2 - lenY / 2;
+	}
+
+	for (ULONG y = 0; y < lenY && locY + y < height; y++)
+	{
+		for (ULONG x = 0; x < lenX && locX + x < width; x++)
+		{
+			COLOR color = bgColor;
+
+			if (y != 0 && y != lenY - 1 && x != 0)
+			{
+				ULONG character = (x - 1) / cellWidth;
+				ULONG column = (x - 1) % cellWidth;
+
+				if (column < scaling * 8 &&
+					(g_FontData[(UCHAR)text[character]][(y - 1) / scaling] & (0x80 >> (column / scaling))) != 0)
+				{
+					color = fgColor;
+				}
+			}
+
+			PUCHAR location = synth.GetImageLocation(locX + x, locY + y);
+			synth.PutPixel(&location, color);
+		}
+	}
+}
+
+struct Overlay
+{
+	ULONG locX;
+	ULONG locY;
+	std::string text;
+	COLOR bgColor;
+	COLOR fgColor;
+};
+
+static void TestOverlays()
+{
+	// Each overlay is drawn over the ones before it, so the cache is
+	// updated from the previous string where it can be.
+	const std::string longText(TEXT_CACHE_MAX_LENGTH + 6, 'W');
+
+	const Overlay overlays[] =
+	{
+		{ 0, 0, "00:00:00:00 00000000", BLACK, WHITE },
+		{ 0, 0, "00:00:00:01 00000001", BLACK, WHITE },
+		{ 0, 0, "00:00:00:02 00000002", BLACK, WHITE },
+		{ 0, 0, "00:00:01:00 00000030", BLACK, WHITE },
+		{ 0, 0, "00:00:01:00 00000030", BLUE, YELLOW },
+		{ 0, 0, "00:00:01:00 0000003", BLUE, YELLOW },
+		{ 0, 0, "00:00:01:00 00000031", BLUE, YELLOW },
+		{ 13, 5, "00:00:01:00 00000031", GREY, RED },
+		{ 13, 5, "00:00:01:01 00000032", GREY, RED },
+		{ 7, 3, "Transparent", TRANSPARENT, GREEN },
+		{ 7, 3, "Transparent!", TRANSPARENT, MAGENTA },
+		{ POSITION_CENTER, POSITION_CENTER, "Centered", CYAN, BLACK },
+		{ POSITION_CENTER, POSITION_CENTER, "Centered, too wide for the frame at every scale", CYAN, BLACK },
+		{ WIDTH - 31, HEIGHT - 5, "Clipped", WHITE, BLUE },
+		{ WIDTH - 31, HEIGHT - 5, "Clipped", TRANSPARENT, BLUE },
+		{ WIDTH, HEIGHT, "Outside", WHITE, BLUE },
+		{ 1, 40, longText, RED, WHITE },
+		{ 1, 40, "\x01\x7F\x80\xB0\xDB\xFE\xFF", BLACK, WHITE },
+		{ 1, 40, "\x01\x7F\x80\xB1\xDB\xFE\xFF", BLACK, WHITE },
+		{ 2, 60, "", BLACK, WHITE },
+	};
+
+	for (const Synthesizer& synthesizer : g_Synthesizers)
+	{
+		for (ULONG scaling = 1; scaling <= 4; scaling++)
+		{
+			std::unique_ptr<CImageSynthesizer> synth = CreateSynthesizer(synthesizer, WIDTH, HEIGHT);
+			std::unique_ptr<CImageSynthesizer> reference = CreateSynthesizer(synthesizer, WIDTH, HEIGHT);
+
+			std::vector<UCHAR> image(ConvertFrameSize(synthesizer.format, WIDTH, HEIGHT));
+
+			for (UCHAR& byte : image)
+			{
+				byte = (UCHAR)TestRandom();
+			}
+
+			std::vector<UCHAR> expected = image;
+
+			synth->SetBuffer(image.data());
+			reference->SetBuffer(expected.data());
+
+			for (const Overlay& overlay : overlays)
+			{
+				std::string text = overlay.text;
+
+				synth->OverlayText(overlay.locX, overlay.locY, scaling, &text[0], overlay.bgColor, overlay.fgColor);
+				ReferenceOverlay(*reference, WIDTH, HEIGHT, overlay.locX, overlay.locY, scaling, text.c_str(), overlay.bgColor, overlay.fgColor);
+
+				if (image != expected)
+				{
+					fprintf(stderr, "%s, scale %u: \"%s\" at %u, %u differs\n",
+						synthesizer.name, scaling, text.c_str(), overlay.locX, overlay.locY);
+				}
+
+				CHECK(image == expected);
+
+				// Start the next one from the right image whatever happened.
+				image = expected;
+			}
+		}
+	}
+}
+
+//
+// A timecode and a frame count, 20 characters, redrawn each frame at the
+// top left of a 1080p frame.
+//
+static void Benchmark()
+{
+	const ULONG width = 1920;
+	const ULONG height = 1080;
+	const int frames = 2000;
+
+	static const Synthesizer synthesizers[] =
+	{
+		{ "RGB24", AvshwsFormatRgb24, TRUE },
+		{ "RGB32", AvshwsFormatBgra, TRUE },
+		{ "YUY2", AvshwsFormatYuy2, FALSE },
+		{ "P010", AvshwsFormatP010, FALSE },
+	};
+
+	printf("format  scale  opaque us  transparent us  pixel by pixel us\n");
+
+	for (const Synthesizer& synthesizer : synthesizers)
+	{
+		std::unique_ptr<CImageSynthesizer> synth = CreateSynthesizer(synthesizer, width, height);
+		std::vector<UCHAR> image(ConvertFrameSize(synthesizer.format, width, height));
+		synth->SetBuffer(image.data());
+
+		for (ULONG scaling = 1; scaling <= 4; scaling++)
+		{
+			double seconds[3];
+
+			for (int mode = 0; mode < 3; mode++)
+			{
+				double start = TestSeconds();
+
+				for (int frame = 0; frame < frames; frame++)
+				{
+					char text[32];
+					snprintf(text, sizeof(text), "%02d:%02d:%02d:%02d %08d",
+						frame / 108000, frame / 1800 % 60, frame / 30 % 60, frame % 30, frame);
+
+					if (mode == 2)
+					{
+						ReferenceOverlay(*synth, width, height, 10, 10, scaling, text, BLACK, WHITE);
+					}
+					else
+					{
+						synth->OverlayText(10, 10, scaling, text, mode == 0 ? BLACK : TRANSPARENT, WHITE);
+					}
+				}
+
+				seconds[mode] = (TestSeconds() - start) / frames;
+			}
+
+			printf("%-7s %5u %10.2f %15.2f %18.2f\n",
+				synthesizer.name, scaling, seconds[0] * 1e6, seconds[1] * 1e6, seconds[2] * 1e6);
+		}
+	}
+}
+
+int main()
+{
+	TestOverlays();
+	Benchmark();
+
+	return TestResult();
+}
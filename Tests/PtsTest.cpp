@@ -0,0 +1,317 @@
+//
+// Schedule derived presentation timestamps (pts.h) against simulated graph
+// clocks: the ticks come every frame period on the system clock, the graph
+// clock runs off it by some parts per million, jumps, or is read with DPC
+// latency.  Each frame is stamped the way CCapturePin::StampFrame does it,
+// with a clock reading only when the schedule asks for one.  The stamps
+// must strictly increase, stay within 1/8 of a period of even while the
+// schedule slews, follow the clock within a bound, and re-anchor on the
+// clock after a jump.
+//
+
+#include "portable.h"
+
+#include <inttypes.h>
+
+#include <vector>
+
+#include "Test.h"
+
+#define FRAME_PERIOD 333667
+#define SLEW_STEP (FRAME_PERIOD / PTS_SLEW_LIMIT)
+
+struct GraphClock
+{
+	LONGLONG offset;
+
+	// Parts per million the graph clock runs fast.
+	LONGLONG drift;
+
+	// The most latency a reading can carry, in 100ns units.
+	ULONG latency;
+
+	// The graph clock's time of tick N.
+	LONGLONG At(ULONG tick) const
+	{
+		LONGLONG system = (LONGLONG)tick * FRAME_PERIOD;
+
+		return offset + system + system * drift / 1000000;
+	}
+
+	LONGLONG Read(ULONG tick) const
+	{
+		return At(tick) + (latency ? TestRandom() % latency : 0);
+	}
+};
+
+struct Stream
+{
+	PTS_SCHEDULE schedule;
+	std::vector<LONGLONG> stamps;
+	std::vector<LONGLONG> errors;
+	ULONG readings;
+
+	Stream() : readings(0)
+	{
+		PtsReset(&schedule, FRAME_PERIOD);
+	}
+
+	void Stamp(const GraphClock& clock, ULONG tick)
+	{
+		BOOLEAN clockValid = PtsNeedsClock(&schedule);
+
+		if (clockValid)
+		{
+			readings++;
+		}
+
+		LONGLONG time = PtsStamp(&schedule, tick, clockValid, clockValid ? clock.Read(tick) : 0);
+
+		stamps.push_back(time);
+		errors.push_back(time - clock.At(tick));
+	}
+
+	void Run(const GraphClock& clock, ULONG first, ULONG count)
+	{
+		for (ULONG tick = first; tick < first + count; tick++)
+		{
+			Stamp(clock, tick);
+		}
+	}
+};
+
+static bool StrictlyIncreasing(const std::vector<LONGLONG>& times)
+{
+	for (size_t i = 1; i < times.size(); i++)
+	{
+		if (times[i] <= times[i - 1])
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// The largest difference of an interval from Period, from stamp First on.
+static LONGLONG Unevenness(const std::vector<LONGLONG>& times, size_t first = 1, LONGLONG period = FRAME_PERIOD)
+{
+	LONGLONG worst = 0;
+
+	for (size_t i = first < 1 ? 1 : first; i < times.size(); i++)
+	{
+		LONGLONG error = times[i] - times[i - 1] - period;
+
+		worst = error < 0 && -error > worst ? -error : error > worst ? error : worst;
+	}
+
+	return worst;
+}
+
+// The largest error to the clock, from stamp First on.
+static LONGLONG WorstError(const std::vector<LONGLONG>& errors, size_t first = 0)
+{
+	LONGLONG worst = 0;
+
+	for (size_t i = first; i < errors.size(); i++)
+	{
+		LONGLONG error = errors[i] < 0 ? -errors[i] : errors[i];
+
+		worst = error > worst ? error : worst;
+	}
+
+	return worst;
+}
+
+static void TestInStep()
+{
+	// A clock in step with the ticks: exactly even, exactly on the clock,
+	// one reading per PTS_CHECK_FRAMES frames.
+	GraphClock clock = { 123456789, 0, 0 };
+	Stream stream;
+
+	stream.Run(clock, 0, 3000);
+
+	CHECK(StrictlyIncreasing(stream.stamps));
+	CHECK(Unevenness(stream.stamps) == 0);
+	CHECK(WorstError(stream.errors) == 0);
+	CHECK(stream.stamps[0] == clock.At(0));
+	CHECK(stream.readings == 3000 / PTS_CHECK_FRAMES);
+}
+
+static void TestDrift()
+{
+	//
+	// Clocks off the ticks by up to 0.4%: the schedule slews to follow
+	// them, each check by at most an eighth of a period, and the error to
+	// the clock settles at about PTS_SLEW_DIVISOR checks' worth of drift.
+	//
+	static const LONGLONG drifts[] = { 100, -100, 1000, -1000, 3000, -3000 };
+
+	printf("drift        uneven   settled error   (us)\n");
+
+	for (LONGLONG drift : drifts)
+	{
+		GraphClock clock = { 5000, drift, 0 };
+		Stream stream;
+
+		stream.Run(clock, 0, 30000);
+
+		LONGLONG rate = drift < 0 ? -drift : drift;
+		LONGLONG settled = PTS_SLEW_DIVISOR * PTS_CHECK_FRAMES * FRAME_PERIOD * rate / 1000000;
+		LONGLONG error = WorstError(stream.errors, 10000);
+
+		CHECK(StrictlyIncreasing(stream.stamps));
+		CHECK(Unevenness(stream.stamps) <= SLEW_STEP);
+		CHECK(error <= settled + PTS_CHECK_FRAMES * FRAME_PERIOD * rate / 1000000 + PTS_SLEW_DIVISOR);
+
+		printf("%5" PRId64 " ppm   %7.1f   %7.1f\n", drift, Unevenness(stream.stamps) / 10.0, error / 10.0);
+	}
+
+	//
+	// 1% is more than the slew can follow: the error grows until it is
+	// over PTS_RESYNC_FRAMES periods and the schedule re-anchors, so it
+	// stays bounded, and the stamps still increase.
+	//
+	GraphClock fast = { 0, 10000, 0 };
+	Stream stream;
+
+	stream.Run(fast, 0, 30000);
+
+	CHECK(StrictlyIncreasing(stream.stamps));
+	CHECK(WorstError(stream.errors) <= PTS_RESYNC_FRAMES * FRAME_PERIOD + PTS_CHECK_FRAMES * FRAME_PERIOD / 100 + 1);
+}
+
+static void TestLatency()
+{
+	//
+	// Readings up to 5 ms late: a reading moves the schedule by at most an
+	// eighth of a period, and the stamps stay within that of the clock
+	// plus the latency.
+	//
+	GraphClock clock = { 77777, 0, 50000 };
+	Stream stream;
+
+	stream.Run(clock, 0, 30000);
+
+	CHECK(StrictlyIncreasing(stream.stamps));
+	CHECK(Unevenness(stream.stamps) <= SLEW_STEP);
+	CHECK(WorstError(stream.errors) <= 50000);
+
+	printf("5 ms latency: uneven %.1f us, worst error %.1f us\n",
+		Unevenness(stream.stamps) / 10.0, WorstError(stream.errors) / 10.0);
+}
+
+static void TestJumps()
+{
+	GraphClock clock = { 1000000000LL, 0, 0 };
+	Stream stream;
+
+	stream.Run(clock, 0, 300);
+
+	//
+	// A jump of a frame period is within PTS_RESYNC_FRAMES: slewed away
+	// an eighth of a period per check, then by a quarter of what is left,
+	// with no step.
+	//
+	clock.offset += FRAME_PERIOD;
+	size_t start = stream.stamps.size();
+
+	stream.Run(clock, 300, PTS_CHECK_FRAMES * 60);
+
+	CHECK(Unevenness(stream.stamps, start) <= SLEW_STEP);
+	CHECK(WorstError(stream.errors, stream.errors.size() - PTS_CHECK_FRAMES) < PTS_SLEW_DIVISOR);
+
+	//
+	// A jump forward of a second re-anchors at the next reading: that
+	// frame is stamped with it, and the schedule carries on from there.
+	//
+	clock.offset += 10000000;
+	ULONG tick = 300 + PTS_CHECK_FRAMES * 60;
+	start = stream.stamps.size();
+
+	stream.Run(clock, tick, 3 * PTS_CHECK_FRAMES);
+
+	size_t anchored = start;
+
+	while (anchored < stream.errors.size() && stream.errors[anchored] != 0)
+	{
+		anchored++;
+	}
+
+	CHECK(anchored < start + PTS_CHECK_FRAMES);
+	CHECK(WorstError(stream.errors, anchored) == 0);
+	CHECK(Unevenness(stream.stamps, anchored + 1) == 0);
+
+	//
+	// A jump back of a second re-anchors too.  The stamps don't go back
+	// with it: they creep on until the schedule catches up with the last
+	// one handed out, then are back on the clock.
+	//
+	tick += 3 * PTS_CHECK_FRAMES;
+	clock.offset -= 10000000;
+	start = stream.stamps.size();
+
+	stream.Run(clock, tick, 3 * PTS_CHECK_FRAMES);
+
+	CHECK(StrictlyIncreasing(stream.stamps));
+	CHECK(stream.errors.back() == 0);
+	CHECK(WorstError(stream.errors, start + PTS_CHECK_FRAMES + 10000000 / FRAME_PERIOD + 1) == 0);
+}
+
+static void TestAnchoring()
+{
+	//
+	// The first frame with a reading anchors the schedule; skipped ticks
+	// (dropped frames) leave whole periods out.
+	//
+	PTS_SCHEDULE schedule;
+
+	PtsReset(&schedule, FRAME_PERIOD);
+	CHECK(PtsNeedsClock(&schedule));
+
+	// Without any reading yet, counted from tick zero at time zero.
+	CHECK(PtsStamp(&schedule, 5, FALSE, 0) == 5 * FRAME_PERIOD);
+	CHECK(PtsNeedsClock(&schedule));
+
+	CHECK(PtsStamp(&schedule, 6, TRUE, 9000000) == 9000000);
+	CHECK(!PtsNeedsClock(&schedule));
+	CHECK(PtsStamp(&schedule, 7, FALSE, 0) == 9000000 + FRAME_PERIOD);
+	CHECK(PtsStamp(&schedule, 10, FALSE, 0) == 9000000 + 4 * FRAME_PERIOD);
+
+	// A reading it didn't ask for is ignored.
+	CHECK(PtsStamp(&schedule, 11, TRUE, 1) == 9000000 + 5 * FRAME_PERIOD);
+
+	// A check is due PTS_CHECK_FRAMES frames after the last reading,
+	// however many ticks they were filled at.
+	ULONG tick = 12;
+	ULONG frames = 4;
+
+	for (; !PtsNeedsClock(&schedule); tick++, frames++)
+	{
+		PtsStamp(&schedule, tick, FALSE, 0);
+	}
+
+	CHECK(frames == PTS_CHECK_FRAMES);
+
+	// A reading slightly late moves the anchor by a quarter of the error.
+	LONGLONG scheduled = 9000000 + (LONGLONG)(tick - 6) * FRAME_PERIOD;
+	CHECK(PtsStamp(&schedule, tick, TRUE, scheduled + 4000) == scheduled + 1000);
+
+	// A new stream (the pin going through RUN again) anchors afresh, even
+	// behind the old one.
+	PtsReset(&schedule, FRAME_PERIOD);
+	CHECK(PtsStamp(&schedule, 0, TRUE, 50) == 50);
+	CHECK(PtsStamp(&schedule, 1, FALSE, 0) == 50 + FRAME_PERIOD);
+}
+
+int main()
+{
+	TestInStep();
+	TestDrift();
+	TestLatency();
+	TestJumps();
+	TestAnchoring();
+
+	return TestResult();
+}
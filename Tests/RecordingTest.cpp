@@ -0,0 +1,317 @@
+//
+// The recording container (Recording.h): frames written through the
+// background writer read back bit-exact with their index; the index is
+// ordered and aligned; and a recording cut short at any point, never
+// closed or with a corrupt index is refused rather than read out of
+// bounds.
+//
+
+#include "Recording.h"
+
+#include <string.h>
+
+#include <vector>
+
+#include "Test.h"
+
+#define RECORDING_PATH "RecordingTest.vrec"
+#define DAMAGED_PATH "RecordingTest.damaged.vrec"
+#define FRAMES 100
+#define LARGEST_FRAME 5000
+
+struct Frame
+{
+	std::vector<uint8_t> data;
+	int64_t timestamp;
+	uint32_t format;
+	uint32_t width;
+	uint32_t height;
+};
+
+static std::vector<Frame> MakeFrames()
+{
+	std::vector<Frame> frames(FRAMES);
+	int64_t timestamp = 123456789;
+
+	for (uint32_t i = 0; i < FRAMES; i++)
+	{
+		// Sizes which are rarely a multiple of the alignment.
+		frames[i].data.resize(1 + TestRandom() % LARGEST_FRAME);
+		for (uint8_t& byte : frames[i].data)
+		{
+			byte = (uint8_t)TestRandom();
+		}
+
+		timestamp += 333667 + TestRandom() % 1000;
+		frames[i].timestamp = timestamp;
+		frames[i].format = 1 + i % RECORDING_FORMAT_P010;
+		frames[i].width = 16 + i;
+		frames[i].height = 9 + i;
+	}
+
+	return frames;
+}
+
+static bool Record(const char* path, const std::vector<Frame>& frames)
+{
+	RecordingWriter writer;
+
+	// Enough buffers that nothing is dropped however slow the writer is.
+	if (!writer.Open(path, LARGEST_FRAME, FRAMES))
+	{
+		return false;
+	}
+
+	for (const Frame& frame : frames)
+	{
+		if (!writer.Submit(frame.data.data(), (uint32_t)frame.data.size(), frame.timestamp, frame.format, frame.width, frame.height))
+		{
+			return false;
+		}
+	}
+
+	return writer.GetDroppedFrames() == 0 && writer.Close();
+}
+
+static std::vector<uint8_t> ReadFile(const char* path)
+{
+	std::vector<uint8_t> contents;
+	FILE* file = fopen(path, "rb");
+
+	if (file != NULL)
+	{
+		uint8_t buffer[4096];
+		size_t read;
+
+		while ((read = fread(buffer, 1, sizeof(buffer), file)) != 0)
+		{
+			contents.insert(contents.end(), buffer, buffer + read);
+		}
+
+		fclose(file);
+	}
+
+	return contents;
+}
+
+static void WriteFile(const char* path, const uint8_t* data, size_t size)
+{
+	FILE* file = fopen(path, "wb");
+
+	CHECK(file != NULL);
+	if (file != NULL)
+	{
+		CHECK(size == 0 || fwrite(data, size, 1, file) == 1);
+		fclose(file);
+	}
+}
+
+static bool Opens(const uint8_t* data, size_t size)
+{
+	RecordingReader reader;
+
+	WriteFile(DAMAGED_PATH, data, size);
+
+	return reader.Open(DAMAGED_PATH);
+}
+
+static void TestRoundTrip(const std::vector<Frame>& frames)
+{
+	RecordingReader reader;
+
+	CHECK(reader.Open(RECORDING_PATH));
+	CHECK(reader.GetFrameCount() == FRAMES);
+
+	for (uint32_t i = 0; i < reader.GetFrameCount(); i++)
+	{
+		const RECORDING_INDEX_ENTRY* entry = reader.GetEntry(i);
+
+		CHECK(entry->Timestamp == frames[i].timestamp);
+		CHECK(entry->Size == frames[i].data.size());
+		CHECK(entry->Format == frames[i].format);
+		CHECK(entry->Width == frames[i].width);
+		CHECK(entry->Height == frames[i].height);
+		CHECK(memcmp(reader.GetFrame(i), frames[i].data.data(), entry->Size) == 0);
+	}
+
+	// Opening again replaces the mapping.
+	CHECK(reader.Open(RECORDING_PATH));
+	CHECK(reader.GetFrameCount() == FRAMES);
+
+	reader.Close();
+	CHECK(reader.GetFrameCount() == 0);
+}
+
+static void TestIndex()
+{
+	RecordingReader reader;
+
+	CHECK(reader.Open(RECORDING_PATH));
+
+	std::vector<uint8_t> contents = ReadFile(RECORDING_PATH);
+	const RECORDING_FILE_HEADER* header = (const RECORDING_FILE_HEADER*)contents.data();
+
+	CHECK(contents.size() >= sizeof(RECORDING_FILE_HEADER));
+	CHECK(header->Magic == RECORDING_MAGIC);
+	CHECK(header->Version == RECORDING_VERSION);
+	CHECK(header->FrameCount == FRAMES);
+
+	// The index is the last thing in the file.
+	CHECK(header->IndexOffset % RECORDING_ALIGNMENT == 0);
+	CHECK(header->IndexOffset + FRAMES * sizeof(RECORDING_INDEX_ENTRY) == contents.size());
+
+	// Payloads are aligned, in order and don't overlap.
+	uint64_t end = sizeof(RECORDING_FILE_HEADER);
+
+	for (uint32_t i = 0; i < reader.GetFrameCount(); i++)
+	{
+		const RECORDING_INDEX_ENTRY* entry = reader.GetEntry(i);
+
+		CHECK(entry->Offset % RECORDING_ALIGNMENT == 0);
+		CHECK(entry->Offset >= end);
+		CHECK(entry->Offset - end < RECORDING_ALIGNMENT);
+
+		end = entry->Offset + entry->Size;
+	}
+
+	CHECK(end <= header->IndexOffset);
+
+	// Prefetch clamps its range.
+	reader.Prefetch(0, FRAMES);
+	reader.Prefetch(FRAMES - 1, 1000);
+	reader.Prefetch(FRAMES, 1);
+	reader.Prefetch(0, 0);
+}
+
+static void TestDropped()
+{
+	RecordingWriter writer;
+	uint8_t frame[64] = {};
+
+	CHECK(writer.Open(RECORDING_PATH, sizeof(frame), 2));
+
+	// Larger than the buffers.
+	CHECK(!writer.Submit(frame, sizeof(frame) + 1, 0, RECORDING_FORMAT_BGRA, 4, 4));
+	CHECK(writer.Submit(frame, sizeof(frame), 1, RECORDING_FORMAT_BGRA, 4, 4));
+	CHECK(writer.GetDroppedFrames() == 1);
+	CHECK(writer.Close());
+
+	// Closed.
+	CHECK(!writer.Submit(frame, sizeof(frame), 2, RECORDING_FORMAT_BGRA, 4, 4));
+
+	RecordingReader reader;
+
+	CHECK(reader.Open(RECORDING_PATH));
+	CHECK(reader.GetFrameCount() == 1);
+	CHECK(reader.GetEntry(0)->Timestamp == 1);
+}
+
+static void TestEmpty()
+{
+	RecordingWriter writer;
+	RecordingReader reader;
+
+	CHECK(writer.Open(RECORDING_PATH, 64, 1));
+	CHECK(writer.Close());
+
+	CHECK(reader.Open(RECORDING_PATH));
+	CHECK(reader.GetFrameCount() == 0);
+}
+
+static void TestTruncated(const std::vector<uint8_t>& contents)
+{
+	// Cut anywhere, the index loses entries or the header points past the
+	// end: every cut is refused.  Every length through the header and the
+	// index, and a sample of the payloads.
+	const RECORDING_FILE_HEADER* header = (const RECORDING_FILE_HEADER*)contents.data();
+	size_t refused = 0;
+	size_t tried = 0;
+
+	for (size_t size = 0; size < contents.size(); size++)
+	{
+		if (size > sizeof(RECORDING_FILE_HEADER) && size < header->IndexOffset && size % 97 != 0)
+		{
+			continue;
+		}
+
+		tried++;
+		refused += !Opens(contents.data(), size);
+	}
+
+	CHECK(refused == tried);
+	CHECK(Opens(contents.data(), contents.size()));
+}
+
+static void TestCorrupt(const std::vector<uint8_t>& contents)
+{
+	std::vector<uint8_t> damaged;
+	RECORDING_FILE_HEADER* header;
+	RECORDING_INDEX_ENTRY* index;
+
+	// Never closed: the header still has no index.
+	damaged = contents;
+	header = (RECORDING_FILE_HEADER*)damaged.data();
+	header->FrameCount = 0;
+	header->IndexOffset = 0;
+	CHECK(!Opens(damaged.data(), damaged.size()));
+
+	damaged = contents;
+	header = (RECORDING_FILE_HEADER*)damaged.data();
+	header->Magic ^= 1;
+	CHECK(!Opens(damaged.data(), damaged.size()));
+
+	damaged = contents;
+	header = (RECORDING_FILE_HEADER*)damaged.data();
+	header->Version++;
+	CHECK(!Opens(damaged.data(), damaged.size()));
+
+	// More frames than the index holds.
+	damaged = contents;
+	header = (RECORDING_FILE_HEADER*)damaged.data();
+	header->FrameCount++;
+	CHECK(!Opens(damaged.data(), damaged.size()));
+
+	// A frame running into the index, or starting past it.
+	damaged = contents;
+	header = (RECORDING_FILE_HEADER*)damaged.data();
+	index = (RECORDING_INDEX_ENTRY*)(damaged.data() + header->IndexOffset);
+	index[FRAMES - 1].Size = (uint32_t)(header->IndexOffset - index[FRAMES - 1].Offset + 1);
+	CHECK(!Opens(damaged.data(), damaged.size()));
+
+	damaged = contents;
+	header = (RECORDING_FILE_HEADER*)damaged.data();
+	index = (RECORDING_INDEX_ENTRY*)(damaged.data() + header->IndexOffset);
+	index[FRAMES / 2].Offset = ~(uint64_t)0;
+	index[FRAMES / 2].Size = 2;
+	CHECK(!Opens(damaged.data(), damaged.size()));
+
+	// A frame ending exactly at the index is fine.
+	damaged = contents;
+	header = (RECORDING_FILE_HEADER*)damaged.data();
+	index = (RECORDING_INDEX_ENTRY*)(damaged.data() + header->IndexOffset);
+	index[FRAMES - 1].Size = (uint32_t)(header->IndexOffset - index[FRAMES - 1].Offset);
+	CHECK(Opens(damaged.data(), damaged.size()));
+}
+
+int main()
+{
+	std::vector<Frame> frames = MakeFrames();
+
+	CHECK(Record(RECORDING_PATH, frames));
+
+	TestRoundTrip(frames);
+	TestIndex();
+
+	std::vector<uint8_t> contents = ReadFile(RECORDING_PATH);
+
+	TestTruncated(contents);
+	TestCorrupt(contents);
+
+	TestDropped();
+	TestEmpty();
+
+	remove(RECORDING_PATH);
+	remove(DAMAGED_PATH);
+
+	return TestResult();
+}
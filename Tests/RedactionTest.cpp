@@ -0,0 +1,516 @@
+//
+// Privacy redaction (Redaction.h).  Random planes of 8 and 16 bit samples,
+// 1 to 4 components and every subsampling the formats use are pixelated
+// and blurred in overlapping, clipped and one pixel wide rectangles, and
+// every sample is compared with a reference computed straight from the
+// block averages and the box sums (rounded as the kernels round); samples
+// outside the rectangles and the padding past each row must not change.
+// Rectangles and planes the redactor can't take are refused.  Then the
+// cost per rectangle of pixelating and blurring 4K frames, by rectangle
+// size, in BGRA, NV12 and P010.
+//
+
+#include "Redaction.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "Test.h"
+
+#define WIDTH 70
+#define HEIGHT 46
+#define PADDING 16
+
+struct Layout
+{
+	const char* name;
+	uint32_t bytesPerSample;
+	uint32_t components;
+	uint32_t shiftX;
+	uint32_t shiftY;
+};
+
+// The planes of the formats the driver interface redacts.
+static const Layout g_Layouts[] =
+{
+	{ "luma", 1, 1, 0, 0 },
+	{ "RGB24", 1, 3, 0, 0 },
+	{ "BGRA", 1, 4, 0, 0 },
+	{ "NV12 chroma", 1, 2, 1, 1 },
+	{ "I420 chroma", 1, 1, 1, 1 },
+	{ "YUY2", 1, 4, 1, 0 },
+	{ "P010 luma", 2, 1, 0, 0 },
+	{ "P010 chroma", 2, 2, 1, 1 },
+	{ "RGB48", 2, 3, 0, 0 },
+	{ "RGBA64", 2, 4, 0, 0 },
+};
+
+struct Rectangle
+{
+	int x;
+	int y;
+	uint32_t width;
+	uint32_t height;
+};
+
+// Overlapping, clipped on every side and one pixel wide.
+static const Rectangle g_Rectangles[] =
+{
+	{ -5, -3, 30, 20 },
+	{ 20, 10, 37, 29 },
+	{ 60, 40, 50, 50 },
+	{ 33, 0, 1, HEIGHT },
+	{ 0, 45, WIDTH, 1 },
+};
+
+struct Plane
+{
+	std::vector<uint8_t> bytes;
+	uint32_t width;
+	uint32_t height;
+	uint32_t stride;
+	uint32_t components;
+	uint32_t bytesPerSample;
+
+	uint32_t Get(uint32_t x, uint32_t y, uint32_t c) const
+	{
+		const uint8_t* at = bytes.data() + (size_t)y * stride + ((size_t)x * components + c) * bytesPerSample;
+
+		return bytesPerSample == 2 ? *(const uint16_t*)at : *at;
+	}
+
+	void Set(uint32_t x, uint32_t y, uint32_t c, uint32_t value)
+	{
+		uint8_t* at = bytes.data() + (size_t)y * stride + ((size_t)x * components + c) * bytesPerSample;
+
+		if (bytesPerSample == 2)
+		{
+			*(uint16_t*)at = (uint16_t)value;
+		}
+		else
+		{
+			*at = (uint8_t)value;
+		}
+	}
+};
+
+static Plane RandomPlane(const Layout& layout, uint32_t width, uint32_t height, uint32_t padding)
+{
+	Plane plane;
+
+	plane.width = width >> layout.shiftX;
+	plane.height = height >> layout.shiftY;
+	plane.components = layout.components;
+	plane.bytesPerSample = layout.bytesPerSample;
+	plane.stride = plane.width * layout.components * layout.bytesPerSample + padding;
+	plane.bytes.resize((size_t)plane.stride * plane.height);
+
+	for (uint8_t& byte : plane.bytes)
+	{
+		byte = (uint8_t)TestRandom();
+	}
+
+	return plane;
+}
+
+//
+// A rectangle of the frame on a subsampled plane: clipped to the frame,
+// scaled down and rounded outwards, as Redaction.h says.
+//
+static bool PlaneRectangle(const Rectangle& rectangle, const Layout& layout, const Plane& plane, uint32_t* left, uint32_t* top, uint32_t* right, uint32_t* bottom)
+{
+	int64_t frameLeft = std::max<int64_t>(rectangle.x, 0);
+	int64_t frameTop = std::max<int64_t>(rectangle.y, 0);
+	int64_t frameRight = std::min<int64_t>((int64_t)rectangle.x + rectangle.width, WIDTH);
+	int64_t frameBottom = std::min<int64_t>((int64_t)rectangle.y + rectangle.height, HEIGHT);
+
+	if (frameLeft >= frameRight || frameTop >= frameBottom)
+	{
+		return false;
+	}
+
+	*left = (uint32_t)frameLeft >> layout.shiftX;
+	*top = (uint32_t)frameTop >> layout.shiftY;
+	*right = std::min((uint32_t)(frameRight + (1 << layout.shiftX) - 1) >> layout.shiftX, plane.width);
+	*bottom = std::min((uint32_t)(frameBottom + (1 << layout.shiftY) - 1) >> layout.shiftY, plane.height);
+
+	return *left < *right && *top < *bottom;
+}
+
+// Each block, counted from the rectangle's top left, its rounded average.
+static void ReferencePixelate(Plane& plane, uint32_t left, uint32_t top, uint32_t right, uint32_t bottom, uint32_t blockWidth, uint32_t blockHeight)
+{
+	for (uint32_t blockTop = top; blockTop < bottom; blockTop += blockHeight)
+	{
+		uint32_t blockBottom = std::min(blockTop + blockHeight, bottom);
+
+		for (uint32_t blockLeft = left; blockLeft < right; blockLeft += blockWidth)
+		{
+			uint32_t blockRight = std::min(blockLeft + blockWidth, right);
+			uint64_t cells = (uint64_t)(blockRight - blockLeft) * (blockBottom - blockTop);
+
+			for (uint32_t c = 0; c < plane.components; c++)
+			{
+				uint64_t total = 0;
+
+				for (uint32_t y = blockTop; y < blockBottom; y++)
+				{
+					for (uint32_t x = blockLeft; x < blockRight; x++)
+					{
+						total += plane.Get(x, y, c);
+					}
+				}
+
+				for (uint32_t y = blockTop; y < blockBottom; y++)
+				{
+					for (uint32_t x = blockLeft; x < blockRight; x++)
+					{
+						plane.Set(x, y, c, (uint32_t)((total + cells / 2) / cells));
+					}
+				}
+			}
+		}
+	}
+}
+
+static uint32_t Round(uint32_t sum, float inverse)
+{
+	return (uint32_t)(int32_t)((float)(int32_t)sum * inverse + 0.5f);
+}
+
+//
+// The box sums of each pass taken in full, samples beyond the rectangle
+// repeating its edge, each pass rounded to a sample.
+//
+static void ReferenceBlur(Plane& plane, uint32_t left, uint32_t top, uint32_t right, uint32_t bottom, uint32_t radiusX, uint32_t radiusY)
+{
+	uint32_t columns = right - left;
+	uint32_t rows = bottom - top;
+	float inverseX = 1.0f / (2 * radiusX + 1);
+	float inverseY = 1.0f / (2 * radiusY + 1);
+	std::vector<uint32_t> horizontal((size_t)columns * rows * plane.components);
+
+	auto at = [&](uint32_t x, uint32_t y, uint32_t c) -> uint32_t&
+	{
+		return horizontal[((size_t)(y - top) * columns + (x - left)) * plane.components + c];
+	};
+
+	for (uint32_t y = top; y < bottom; y++)
+	{
+		for (uint32_t x = left; x < right; x++)
+		{
+			for (uint32_t c = 0; c < plane.components; c++)
+			{
+				uint32_t sum = 0;
+
+				for (int64_t k = -(int64_t)radiusX; k <= (int64_t)radiusX; k++)
+				{
+					sum += plane.Get((uint32_t)std::min<int64_t>(std::max<int64_t>(x + k, left), right - 1), y, c);
+				}
+
+				at(x, y, c) = Round(sum, inverseX);
+			}
+		}
+	}
+
+	for (uint32_t y = top; y < bottom; y++)
+	{
+		for (uint32_t x = left; x < right; x++)
+		{
+			for (uint32_t c = 0; c < plane.components; c++)
+			{
+				uint32_t sum = 0;
+
+				for (int64_t k = -(int64_t)radiusY; k <= (int64_t)radiusY; k++)
+				{
+					sum += at(x, (uint32_t)std::min<int64_t>(std::max<int64_t>(y + k, top), bottom - 1), c);
+				}
+
+				plane.Set(x, y, c, Round(sum, inverseY));
+			}
+		}
+	}
+}
+
+//
+// Redacts a random plane of each layout with the rectangles, one mode and
+// size for all, and counts the samples, padding included, which differ
+// from the reference.
+//
+static uint32_t Mismatches(const Layout& layout, uint32_t mode, uint32_t size)
+{
+	Redactor redactor;
+	redactor.SetSize(WIDTH, HEIGHT);
+
+	for (const Rectangle& rectangle : g_Rectangles)
+	{
+		CHECK(redactor.AddRegion(rectangle.x, rectangle.y, rectangle.width, rectangle.height, mode, size) != 0);
+	}
+
+	Plane plane = RandomPlane(layout, WIDTH, HEIGHT, PADDING);
+	Plane expected = plane;
+
+	CHECK(redactor.Apply(plane.bytes.data(), (int32_t)plane.stride, layout.bytesPerSample, layout.components, layout.shiftX, layout.shiftY));
+
+	uint32_t sizeX = std::max(size >> layout.shiftX, 1u);
+	uint32_t sizeY = std::max(size >> layout.shiftY, 1u);
+
+	for (const Rectangle& rectangle : g_Rectangles)
+	{
+		uint32_t left, top, right, bottom;
+
+		if (!PlaneRectangle(rectangle, layout, expected, &left, &top, &right, &bottom))
+		{
+			continue;
+		}
+
+		if (mode == REDACTION_PIXELATE)
+		{
+			ReferencePixelate(expected, left, top, right, bottom, sizeX, sizeY);
+		}
+		else
+		{
+			ReferenceBlur(expected, left, top, right, bottom, sizeX, sizeY);
+		}
+	}
+
+	uint32_t mismatches = 0;
+
+	for (size_t i = 0; i < plane.bytes.size(); i++)
+	{
+		if (plane.bytes[i] != expected.bytes[i])
+		{
+			mismatches++;
+		}
+	}
+
+	return mismatches;
+}
+
+static void TestPixelate()
+{
+	static const uint32_t blockSizes[] = { 2, 3, 7, 16, REDACTION_BLOCK_MAX };
+
+	for (const Layout& layout : g_Layouts)
+	{
+		for (uint32_t size : blockSizes)
+		{
+			uint32_t mismatches = Mismatches(layout, REDACTION_PIXELATE, size);
+
+			if (mismatches != 0)
+			{
+				fprintf(stderr, "%s pixelated by %u: %u bytes differ\n", layout.name, size, mismatches);
+			}
+
+			CHECK(mismatches == 0);
+		}
+	}
+}
+
+static void TestBlur()
+{
+	static const uint32_t radii[] = { 1, 2, 5, 17, REDACTION_RADIUS_MAX };
+
+	for (const Layout& layout : g_Layouts)
+	{
+		for (uint32_t size : radii)
+		{
+			uint32_t mismatches = Mismatches(layout, REDACTION_BLUR, size);
+
+			if (mismatches != 0)
+			{
+				fprintf(stderr, "%s blurred by %u: %u bytes differ\n", layout.name, size, mismatches);
+			}
+
+			CHECK(mismatches == 0);
+		}
+	}
+}
+
+// A flat rectangle stays flat, and only the rectangle changes.
+static void TestFlat()
+{
+	Redactor redactor;
+	redactor.SetSize(WIDTH, HEIGHT);
+
+	std::vector<uint8_t> frame((size_t)WIDTH * HEIGHT * 4, 0x40);
+
+	for (uint32_t y = 10; y < 20; y++)
+	{
+		memset(frame.data() + ((size_t)y * WIDTH + 10) * 4, 0x80, 10 * 4);
+	}
+
+	CHECK(redactor.AddRegion(10, 10, 10, 10, REDACTION_BLUR, 3) != 0);
+	CHECK(redactor.AddRegion(12, 12, 6, 6, REDACTION_PIXELATE, 4) != 0);
+	CHECK(redactor.Apply(frame.data(), WIDTH * 4, 1, 4, 0, 0));
+
+	bool kept = true;
+
+	for (uint32_t y = 0; y < HEIGHT; y++)
+	{
+		for (uint32_t x = 0; x < WIDTH; x++)
+		{
+			bool inside = x >= 10 && x < 20 && y >= 10 && y < 20;
+
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				kept = kept && frame[((size_t)y * WIDTH + x) * 4 + c] == (inside ? 0x80 : 0x40);
+			}
+		}
+	}
+
+	CHECK(kept);
+}
+
+static void TestRefused()
+{
+	Redactor redactor;
+	redactor.SetSize(WIDTH, HEIGHT);
+
+	CHECK(redactor.IsEmpty());
+
+	// Sizes out of range, unknown modes and rectangles off the frame.
+	CHECK(redactor.AddRegion(0, 0, 10, 10, REDACTION_PIXELATE, 1) == 0);
+	CHECK(redactor.AddRegion(0, 0, 10, 10, REDACTION_PIXELATE, REDACTION_BLOCK_MAX + 1) == 0);
+	CHECK(redactor.AddRegion(0, 0, 10, 10, REDACTION_BLUR, 0) == 0);
+	CHECK(redactor.AddRegion(0, 0, 10, 10, REDACTION_BLUR, REDACTION_RADIUS_MAX + 1) == 0);
+	CHECK(redactor.AddRegion(0, 0, 10, 10, REDACTION_BLUR + 1, 4) == 0);
+	CHECK(redactor.AddRegion(WIDTH, 0, 10, 10, REDACTION_BLUR, 4) == 0);
+	CHECK(redactor.AddRegion(-10, 0, 10, 10, REDACTION_BLUR, 4) == 0);
+	CHECK(redactor.AddRegion(0, 0, 0, 10, REDACTION_BLUR, 4) == 0);
+	CHECK(redactor.IsEmpty());
+
+	// Up to REDACTION_MAX_REGIONS, removed by id.
+	std::vector<int> ids;
+	for (int i = 0; i < REDACTION_MAX_REGIONS; i++)
+	{
+		ids.push_back(redactor.AddRegion(i, i, 4, 4, REDACTION_BLUR, 1));
+		CHECK(ids.back() != 0);
+	}
+
+	CHECK(redactor.AddRegion(0, 0, 4, 4, REDACTION_BLUR, 1) == 0);
+	CHECK(redactor.RemoveRegion(ids[3]));
+	CHECK(!redactor.RemoveRegion(ids[3]));
+	CHECK(redactor.AddRegion(0, 0, 4, 4, REDACTION_BLUR, 1) != 0);
+
+	// Planes of samples or subsampling no format has.
+	std::vector<uint8_t> frame((size_t)WIDTH * HEIGHT * 8);
+	CHECK(!redactor.Apply(frame.data(), WIDTH * 8, 1, 5, 0, 0));
+	CHECK(!redactor.Apply(frame.data(), WIDTH * 8, 4, 1, 0, 0));
+	CHECK(!redactor.Apply(frame.data(), WIDTH, 1, 1, 2, 0));
+
+	// A new size drops the rectangles.
+	redactor.SetSize(WIDTH * 2, HEIGHT);
+	CHECK(redactor.IsEmpty());
+	CHECK(redactor.GetWidth() == WIDTH * 2);
+	CHECK(redactor.GetHeight() == HEIGHT);
+}
+
+//
+// A 4K frame in BGRA, NV12 and P010, its planes laid out as the driver
+// interface packs them.
+//
+struct Format
+{
+	const char* name;
+	std::vector<Layout> planes;
+};
+
+static void Benchmark()
+{
+	const uint32_t width = 3840;
+	const uint32_t height = 2160;
+
+	static const Format formats[] =
+	{
+		{ "BGRA", { { "", 1, 4, 0, 0 } } },
+		{ "NV12", { { "", 1, 1, 0, 0 }, { "", 1, 2, 1, 1 } } },
+		{ "P010", { { "", 2, 1, 0, 0 }, { "", 2, 2, 1, 1 } } },
+	};
+
+	struct Size
+	{
+		const char* name;
+		uint32_t width;
+		uint32_t height;
+	};
+
+	static const Size sizes[] =
+	{
+		{ "64x64", 64, 64 },
+		{ "256x256", 256, 256 },
+		{ "1024x1024", 1024, 1024 },
+		{ "3840x2160", width, height },
+	};
+
+	struct Mode
+	{
+		const char* name;
+		uint32_t mode;
+		uint32_t size;
+	};
+
+	static const Mode modes[] =
+	{
+		{ "pixelate 16", REDACTION_PIXELATE, 16 },
+		{ "blur 8", REDACTION_BLUR, 8 },
+		{ "blur 64", REDACTION_BLUR, 64 },
+	};
+
+	printf("4K rectangle  mode         format  ms/rectangle  ns/pixel\n");
+
+	for (const Size& size : sizes)
+	{
+		for (const Mode& mode : modes)
+		{
+			for (const Format& format : formats)
+			{
+				std::vector<Plane> planes;
+				for (const Layout& layout : format.planes)
+				{
+					planes.push_back(RandomPlane(layout, width, height, 0));
+				}
+
+				Redactor redactor;
+				redactor.SetSize(width, height);
+				CHECK(redactor.AddRegion((width - size.width) / 2, (height - size.height) / 2, size.width, size.height, mode.mode, mode.size) != 0);
+
+				// At least a few frames, and about a tenth of a second.
+				int iterations = 0;
+				double start = TestSeconds();
+				double seconds;
+
+				do
+				{
+					for (size_t p = 0; p < planes.size(); p++)
+					{
+						const Layout& layout = format.planes[p];
+
+						redactor.Apply(planes[p].bytes.data(), (int32_t)planes[p].stride, layout.bytesPerSample, layout.components, layout.shiftX, layout.shiftY);
+					}
+
+					iterations++;
+					seconds = TestSeconds() - start;
+				} while (iterations < 3 || seconds < 0.1);
+
+				seconds /= iterations;
+
+				printf("%-13s %-12s %-7s %12.3f %9.2f\n",
+					size.name, mode.name, format.name, seconds * 1e3, seconds * 1e9 / ((double)size.width * size.height));
+			}
+		}
+	}
+}
+
+int main()
+{
+	TestPixelate();
+	TestBlur();
+	TestFlat();
+	TestRefused();
+	Benchmark();
+
+	return TestResult();
+}
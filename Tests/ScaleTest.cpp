@@ -0,0 +1,274 @@
+//
+// Downscaling for the preview pin (scale.h).  Random frames in every
+// format the scaler takes are scaled at exact and uneven ratios and each
+// output sample is compared with a reference box filter computed straight
+// from the box edges; a flat frame must stay flat and sizes the scaler
+// can't handle must be refused.  Then the cost of the preview downscales
+// 4K to 720p and 1080p to 360p, in each format.
+//
+
+#include "portable.h"
+
+#include <math.h>
+
+#include <vector>
+
+#include "Test.h"
+
+struct Plane
+{
+	ULONG offset;
+	ULONG stride;
+	ULONG width;
+	ULONG height;
+	ULONG components;
+	ULONG sampleBytes;
+};
+
+static const ULONG g_Formats[] =
+{
+	AvshwsFormatRgb24, AvshwsFormatBgra, AvshwsFormatRgba, AvshwsFormatNv12, AvshwsFormatP010
+};
+
+static const char* FormatName(ULONG format)
+{
+	switch (format)
+	{
+	case AvshwsFormatRgb24: return "RGB24";
+	case AvshwsFormatBgra: return "BGRA";
+	case AvshwsFormatRgba: return "RGBA";
+	case AvshwsFormatNv12: return "NV12";
+	case AvshwsFormatP010: return "P010";
+	}
+
+	return "?";
+}
+
+// The planes of a tightly packed frame, as scale.h lays them out.
+static std::vector<Plane> Planes(ULONG format, ULONG width, ULONG height)
+{
+	ULONG stride = ConvertLineBytes(format, width);
+	std::vector<Plane> planes;
+
+	switch (format)
+	{
+	case AvshwsFormatRgb24:
+		planes.push_back({ 0, stride, width, height, 3, 1 });
+		break;
+
+	case AvshwsFormatBgra:
+	case AvshwsFormatRgba:
+		planes.push_back({ 0, stride, width, height, 4, 1 });
+		break;
+
+	case AvshwsFormatNv12:
+		planes.push_back({ 0, stride, width, height, 1, 1 });
+		planes.push_back({ stride * height, stride, width / 2, height / 2, 2, 1 });
+		break;
+
+	case AvshwsFormatP010:
+		planes.push_back({ 0, stride, width, height, 1, 2 });
+		planes.push_back({ stride * height, stride, width / 2, height / 2, 2, 2 });
+		break;
+	}
+
+	return planes;
+}
+
+static ULONG Sample(const UCHAR* frame, const Plane& plane, ULONG x, ULONG y, ULONG c)
+{
+	const UCHAR* at = frame + plane.offset + (SIZE_T)y * plane.stride + ((SIZE_T)x * plane.components + c) * plane.sampleBytes;
+
+	return plane.sampleBytes == 2 ? *(const USHORT*)at : *at;
+}
+
+static std::vector<UCHAR> RandomFrame(ULONG format, ULONG width, ULONG height)
+{
+	std::vector<UCHAR> frame(ConvertFrameSize(format, width, height));
+
+	if (format == AvshwsFormatP010)
+	{
+		// 10 bit samples in the high bits.
+		for (size_t i = 0; i < frame.size() / 2; i++)
+		{
+			((USHORT*)frame.data())[i] = (USHORT)((TestRandom() & 0x3FF) << 6);
+		}
+	}
+	else
+	{
+		for (UCHAR& byte : frame)
+		{
+			byte = (UCHAR)TestRandom();
+		}
+	}
+
+	return frame;
+}
+
+//
+// Counts the output samples which differ from the rounded average of the
+// input box [x * InputWidth / OutputWidth, (x + 1) * InputWidth /
+// OutputWidth) by rows likewise.
+//
+static ULONG Mismatches(ULONG format, const std::vector<UCHAR>& input, ULONG inputWidth, ULONG inputHeight, const std::vector<UCHAR>& output, ULONG outputWidth, ULONG outputHeight)
+{
+	std::vector<Plane> inPlanes = Planes(format, inputWidth, inputHeight);
+	std::vector<Plane> outPlanes = Planes(format, outputWidth, outputHeight);
+	ULONG mismatches = 0;
+
+	for (size_t p = 0; p < inPlanes.size(); p++)
+	{
+		const Plane& in = inPlanes[p];
+		const Plane& out = outPlanes[p];
+
+		for (ULONG y = 0; y < out.height; y++)
+		{
+			ULONG top = (ULONG)((ULONGLONG)y * in.height / out.height);
+			ULONG bottom = (ULONG)((ULONGLONG)(y + 1) * in.height / out.height);
+
+			for (ULONG x = 0; x < out.width; x++)
+			{
+				ULONG left = (ULONG)((ULONGLONG)x * in.width / out.width);
+				ULONG right = (ULONG)((ULONGLONG)(x + 1) * in.width / out.width);
+
+				for (ULONG c = 0; c < out.components; c++)
+				{
+					double sum = 0;
+
+					for (ULONG row = top; row < bottom; row++)
+					{
+						for (ULONG column = left; column < right; column++)
+						{
+							sum += Sample(input.data(), in, column, row, c);
+						}
+					}
+
+					ULONG expected = (ULONG)floor(sum / ((right - left) * (bottom - top)) + 0.5);
+
+					if (Sample(output.data(), out, x, y, c) != expected)
+					{
+						mismatches++;
+					}
+				}
+			}
+		}
+	}
+
+	return mismatches;
+}
+
+static void TestAccuracy()
+{
+	struct Ratio
+	{
+		ULONG inputWidth;
+		ULONG inputHeight;
+		ULONG outputWidth;
+		ULONG outputHeight;
+	};
+
+	static const Ratio ratios[] =
+	{
+		{ 96, 54, 32, 18 },   // 3x, as 4K to 720p and 1080p to 360p
+		{ 64, 36, 32, 18 },   // 2x
+		{ 64, 48, 16, 12 },   // 4x
+		{ 96, 54, 64, 36 },   // 1.5x, as 1080p to 720p
+		{ 70, 46, 22, 14 },   // uneven both ways
+		{ 40, 20, 40, 20 },   // 1x, a copy
+	};
+
+	for (ULONG format : g_Formats)
+	{
+		for (const Ratio& ratio : ratios)
+		{
+			std::vector<UCHAR> input = RandomFrame(format, ratio.inputWidth, ratio.inputHeight);
+			std::vector<UCHAR> output(ConvertFrameSize(format, ratio.outputWidth, ratio.outputHeight), 0xCD);
+			std::vector<ULONG> accumulator(SCALE_ACCUMULATOR_COUNT(ratio.outputWidth));
+
+			CHECK(ScaleFrame(format, input.data(), ratio.inputWidth, ratio.inputHeight, output.data(), ratio.outputWidth, ratio.outputHeight, accumulator.data()));
+			CHECK(Mismatches(format, input, ratio.inputWidth, ratio.inputHeight, output, ratio.outputWidth, ratio.outputHeight) == 0);
+
+			if (ratio.inputWidth == ratio.outputWidth)
+			{
+				CHECK(input == output);
+			}
+		}
+
+		// A flat frame stays flat.
+		std::vector<UCHAR> flat(ConvertFrameSize(format, 90, 60), 0x40);
+		std::vector<UCHAR> output(ConvertFrameSize(format, 26, 18));
+		std::vector<ULONG> accumulator(SCALE_ACCUMULATOR_COUNT(26));
+
+		CHECK(ScaleFrame(format, flat.data(), 90, 60, output.data(), 26, 18, accumulator.data()));
+
+		for (UCHAR byte : output)
+		{
+			CHECK(byte == 0x40);
+		}
+	}
+}
+
+static void TestRefused()
+{
+	std::vector<UCHAR> input(ConvertFrameSize(AvshwsFormatBgra, 64, 64));
+	std::vector<UCHAR> output(ConvertFrameSize(AvshwsFormatBgra, 128, 128));
+	std::vector<ULONG> accumulator(SCALE_ACCUMULATOR_COUNT(128));
+
+	// Upscaling, empty output, odd 4:2:0 sizes and unsupported formats.
+	CHECK(!ScaleFrame(AvshwsFormatBgra, input.data(), 64, 64, output.data(), 128, 32, accumulator.data()));
+	CHECK(!ScaleFrame(AvshwsFormatBgra, input.data(), 64, 64, output.data(), 0, 32, accumulator.data()));
+	CHECK(!ScaleFrame(AvshwsFormatNv12, input.data(), 64, 64, output.data(), 31, 31, accumulator.data()));
+	CHECK(!ScaleFrame(AvshwsFormatYuy2, input.data(), 64, 64, output.data(), 32, 32, accumulator.data()));
+	CHECK(!ScaleFrame(AvshwsFormatI420, input.data(), 64, 64, output.data(), 32, 32, accumulator.data()));
+}
+
+static void Benchmark()
+{
+	struct Downscale
+	{
+		const char* name;
+		ULONG inputWidth;
+		ULONG inputHeight;
+		ULONG outputWidth;
+		ULONG outputHeight;
+	};
+
+	static const Downscale downscales[] =
+	{
+		{ "4K to 720p", 3840, 2160, 1280, 720 },
+		{ "1080p to 360p", 1920, 1080, 640, 360 },
+	};
+
+	printf("downscale       format   ms/frame   input GB/s\n");
+
+	for (const Downscale& downscale : downscales)
+	{
+		for (ULONG format : g_Formats)
+		{
+			std::vector<UCHAR> input = RandomFrame(format, downscale.inputWidth, downscale.inputHeight);
+			std::vector<UCHAR> output(ConvertFrameSize(format, downscale.outputWidth, downscale.outputHeight));
+			std::vector<ULONG> accumulator(SCALE_ACCUMULATOR_COUNT(downscale.outputWidth));
+			const int iterations = 20;
+
+			double start = TestSeconds();
+
+			for (int i = 0; i < iterations; i++)
+			{
+				CHECK(ScaleFrame(format, input.data(), downscale.inputWidth, downscale.inputHeight, output.data(), downscale.outputWidth, downscale.outputHeight, accumulator.data()));
+			}
+
+			double seconds = (TestSeconds() - start) / iterations;
+
+			printf("%-15s %-6s %9.3f %10.2f\n", downscale.name, FormatName(format), seconds * 1e3, input.size() / seconds / 1e9);
+		}
+	}
+}
+
+int main()
+{
+	TestAccuracy();
+	TestRefused();
+	Benchmark();
+
+	return TestResult();
+}
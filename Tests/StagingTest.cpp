@@ -0,0 +1,200 @@
+//
+// Frame staging (AVSHWS_STAGING): what NV12 staging saves and what it
+// costs.  For each output format and size, the memory a stream's frame
+// buffers take (FRAME_POOL_DEPTH staged frames) and the time to store an
+// injected BGRA frame and to deliver it, staged natively and as NV12.
+// Also checks that the savings are as documented and that a frame staged
+// as NV12 is delivered with no more error than NV12 itself has, a P010
+// producer's frame included.
+//
+
+#include "portable.h"
+
+#include <vector>
+
+#include "Test.h"
+
+static const ULONG g_OutputFormats[] = { AvshwsFormatRgb24, AvshwsFormatBgra, AvshwsFormatP010 };
+static const char* const g_OutputNames[] = { "RGB24", "RGB32", "P010" };
+
+static ULONG StagingFormat(ULONG output, ULONG staging)
+{
+	return staging == AvshwsStagingNv12 ? (ULONG)AvshwsFormatNv12 : output;
+}
+
+// The average time of one conversion.
+static double TimeConversion(ULONG input, const std::vector<UCHAR>& source, ULONG output, std::vector<UCHAR>& destination, ULONG width, ULONG height)
+{
+	LONG stride = (LONG)ConvertLineBytes(output, width);
+	const int iterations = 20;
+
+	CHECK(ConvertFrame(input, source.data(), output, destination.data(), stride, width, height));
+
+	double start = TestSeconds();
+
+	for (int i = 0; i < iterations; i++)
+	{
+		ConvertFrame(input, source.data(), output, destination.data(), stride, width, height);
+	}
+
+	return (TestSeconds() - start) / iterations;
+}
+
+static void TestFootprint()
+{
+	// NV12 is half of RGB24 and P010 and 3/8 of RGB32.
+	for (ULONG width = 2; width <= 64; width += 2)
+	{
+		ULONG height = width + 2;
+		ULONG nv12 = ConvertFrameSize(AvshwsFormatNv12, width, height);
+
+		CHECK(nv12 * 2 == ConvertFrameSize(AvshwsFormatRgb24, width, height));
+		CHECK(nv12 * 2 == ConvertFrameSize(AvshwsFormatP010, width, height));
+		CHECK(nv12 * 8 == ConvertFrameSize(AvshwsFormatBgra, width, height) * 3);
+	}
+}
+
+static void TestDelivery()
+{
+	const ULONG width = 64;
+	const ULONG height = 32;
+
+	// 2x2 blocks of one color, which 4:2:0 keeps exactly.
+	std::vector<UCHAR> source(width * height * 4);
+
+	for (ULONG y = 0; y < height; y += 2)
+	{
+		for (ULONG x = 0; x < width; x += 2)
+		{
+			UCHAR color[4] = { (UCHAR)TestRandom(), (UCHAR)TestRandom(), (UCHAR)TestRandom(), 255 };
+
+			for (ULONG i = 0; i < 4; i++)
+			{
+				memcpy(&source[((y + i / 2) * width + x + i % 2) * 4], color, 4);
+			}
+		}
+	}
+
+	for (ULONG output : g_OutputFormats)
+	{
+		std::vector<UCHAR> direct(ConvertFrameSize(output, width, height));
+		std::vector<UCHAR> staged(ConvertFrameSize(AvshwsFormatNv12, width, height));
+		std::vector<UCHAR> delivered(direct.size());
+		LONG stride = (LONG)ConvertLineBytes(output, width);
+
+		CHECK(ConvertFrame(AvshwsFormatBgra, source.data(), output, direct.data(), stride, width, height));
+		CHECK(ConvertFrame(AvshwsFormatBgra, source.data(), AvshwsFormatNv12, staged.data(), width, width, height));
+		CHECK(ConvertFrame(AvshwsFormatNv12, staged.data(), output, delivered.data(), stride, width, height));
+
+		// Through NV12, 8 bit limited range: up to 2 off in 8 bit RGB, up
+		// to 4 in 10 bit YUV.
+		LONG worst = 0;
+
+		if (output == AvshwsFormatP010)
+		{
+			for (size_t i = 0; i < direct.size(); i += 2)
+			{
+				LONG a = (direct[i] | direct[i + 1] << 8) >> 6;
+				LONG b = (delivered[i] | delivered[i + 1] << 8) >> 6;
+				worst = a - b > worst ? a - b : (b - a > worst ? b - a : worst);
+			}
+
+			CHECK(worst <= 4);
+		}
+		else
+		{
+			for (size_t i = 0; i < direct.size(); i++)
+			{
+				LONG a = direct[i];
+				LONG b = delivered[i];
+				worst = a - b > worst ? a - b : (b - a > worst ? b - a : worst);
+			}
+
+			CHECK(worst <= 2);
+		}
+	}
+}
+
+//
+// A P010 producer on a P010 stream staged as NV12: narrowed to 8 bits on
+// the way in and widened again as WriteFrame delivers it, top-down.  Each
+// 10 bit sample, luma and chroma, may be off by the rounding to 8 bits.
+//
+static void TestP010Input()
+{
+	const ULONG width = 64;
+	const ULONG height = 32;
+	const ULONG lineBytes = ConvertLineBytes(AvshwsFormatP010, width);
+
+	std::vector<UCHAR> source(ConvertFrameSize(AvshwsFormatP010, width, height));
+	std::vector<UCHAR> staged(ConvertFrameSize(AvshwsFormatNv12, width, height));
+	std::vector<UCHAR> delivered(source.size());
+
+	// Limited range 10 bit samples in the high bits.
+	for (size_t i = 0; i < source.size(); i += 2)
+	{
+		USHORT sample = (USHORT)((64 + TestRandom() % (940 - 64 + 1)) << 6);
+		source[i] = (UCHAR)sample;
+		source[i + 1] = (UCHAR)(sample >> 8);
+	}
+
+	CHECK(ConvertFrame(AvshwsFormatP010, source.data(), AvshwsFormatNv12, staged.data(), width, width, height));
+	CHECK(ConvertFrame(AvshwsFormatNv12, staged.data(), AvshwsFormatP010, delivered.data(), lineBytes, width, height));
+
+	LONG worst = 0;
+
+	for (size_t i = 0; i < source.size(); i += 2)
+	{
+		LONG a = (source[i] | source[i + 1] << 8) >> 6;
+		LONG b = (delivered[i] | delivered[i + 1] << 8) >> 6;
+		worst = a - b > worst ? a - b : (b - a > worst ? b - a : worst);
+	}
+
+	CHECK(worst <= 2);
+}
+
+static void Benchmark(ULONG width, ULONG height)
+{
+	std::vector<UCHAR> input(ConvertFrameSize(AvshwsFormatBgra, width, height));
+
+	for (UCHAR& byte : input)
+	{
+		byte = (UCHAR)TestRandom();
+	}
+
+	for (ULONG i = 0; i < sizeof(g_OutputFormats) / sizeof(g_OutputFormats[0]); i++)
+	{
+		ULONG output = g_OutputFormats[i];
+
+		for (ULONG staging = AvshwsStagingNative; staging < AvshwsStagingCount; staging++)
+		{
+			ULONG format = StagingFormat(output, staging);
+			ULONG size = ConvertFrameSize(format, width, height);
+			std::vector<UCHAR> stagedFrame(size);
+			std::vector<UCHAR> deliveredFrame(ConvertFrameSize(output, width, height));
+
+			double store = TimeConversion(AvshwsFormatBgra, input, format, stagedFrame, width, height);
+			double deliver = TimeConversion(format, stagedFrame, output, deliveredFrame, width, height);
+
+			printf("%4lux%-4lu %-5s %-6s %7.1f MB %7.3f ms %7.3f ms\n",
+				(unsigned long)width, (unsigned long)height, g_OutputNames[i],
+				staging == AvshwsStagingNv12 ? "NV12" : "native",
+				(double)size * FRAME_POOL_DEPTH / (1024 * 1024), store * 1e3, deliver * 1e3);
+		}
+	}
+}
+
+int main()
+{
+	TestFootprint();
+	TestDelivery();
+	TestP010Input();
+
+	printf("size      output staged  buffers    store    deliver\n");
+
+	Benchmark(1280, 720);
+	Benchmark(1920, 1080);
+	Benchmark(3840, 2160);
+
+	return TestResult();
+}
@@ -0,0 +1,193 @@
+//
+// Stream restarts with the frame buffer pool (framepool.h): the work
+// CHardwareSimulation::Start does before the first frame can be delivered
+// (take FRAME_POOL_DEPTH staged frame buffers, stage the first frame) and
+// the first delivery, timed cold (the pool allocates) and warm (the pool
+// hands back the previous run's buffers).  This is the time to first frame
+// reported in AVSHWS_STATISTICS less the wait for the consumer's buffers.
+// A mute / unmute loop, format switches and memory pressure check when
+// the pool allocates and when it frees its buffers.
+//
+// This is the driver's own CFramePool, over the kernel stand-ins of
+// portable.h: its trim timer never fires, so the tests call Trim as the
+// timer's DPC would.
+//
+
+#include "portable.h"
+
+#include <vector>
+
+#include "Test.h"
+
+struct Mode
+{
+	const char* name;
+	ULONG width;
+	ULONG height;
+};
+
+static const Mode g_Modes[] =
+{
+	{ "720p", 1280, 720 },
+	{ "1080p", 1920, 1080 },
+	{ "4K", 3840, 2160 },
+};
+
+//
+// Starts a stream of RGB24 at Mode, delivering the held frame if there is
+// one, and returns the time to its first frame in seconds.
+//
+static double Start(CFramePool& pool, const Mode& mode, const std::vector<UCHAR>* held, std::vector<UCHAR>& consumer, PUCHAR* buffers)
+{
+	ULONG size = ConvertFrameSize(AvshwsFormatRgb24, mode.width, mode.height);
+	LONG stride = (LONG)ConvertLineBytes(AvshwsFormatRgb24, mode.width);
+
+	consumer.resize(size);
+
+	double start = TestSeconds();
+
+	CHECK(NT_SUCCESS(pool.Acquire(size, buffers)));
+
+	PUCHAR synthesis = buffers[0];
+
+	if (held)
+	{
+		CHECK(ConvertFrame(AvshwsFormatBgra, held->data(), AvshwsFormatRgb24, synthesis, stride, mode.width, mode.height));
+	}
+	else
+	{
+		ConvertFillBlack(AvshwsFormatRgb24, synthesis, mode.width, mode.height);
+	}
+
+	// The first tick.
+	CHECK(ConvertFrame(AvshwsFormatRgb24, synthesis, AvshwsFormatRgb24, consumer.data(), stride, mode.width, mode.height));
+
+	return TestSeconds() - start;
+}
+
+// Starts and stops a stream.
+static void Run(CFramePool& pool, const Mode& mode, PUCHAR* buffers)
+{
+	std::vector<UCHAR> consumer;
+
+	Start(pool, mode, NULL, consumer, buffers);
+	pool.Release();
+}
+
+static bool SameBuffers(const PUCHAR* a, const PUCHAR* b)
+{
+	return memcmp(a, b, sizeof(PUCHAR) * FRAME_POOL_DEPTH) == 0;
+}
+
+static void TestReuse()
+{
+	CFramePool pool;
+	PUCHAR first[FRAME_POOL_DEPTH];
+	PUCHAR buffers[FRAME_POOL_DEPTH];
+
+	Run(pool, g_Modes[2], first);
+	CHECK(pool.GetAllocations() == 1);
+
+	// Mute / unmute and switches to smaller formats reuse the buffers, the
+	// trim check with memory to spare too.
+	for (int i = 0; i < 10; i++)
+	{
+		Run(pool, g_Modes[i % 3], buffers);
+		CHECK(SameBuffers(buffers, first));
+
+		pool.Trim(FALSE);
+	}
+
+	CHECK(pool.GetAllocations() == 1);
+
+	// Memory runs low while the pool is idle: the trim check frees the
+	// buffers and the next start allocates.
+	HostSetLowMemory(TRUE);
+	pool.Trim(FALSE);
+	HostSetLowMemory(FALSE);
+
+	Run(pool, g_Modes[0], buffers);
+	CHECK(pool.GetAllocations() == 2);
+
+	// A larger format replaces them.
+	Run(pool, g_Modes[1], buffers);
+	CHECK(pool.GetAllocations() == 3);
+
+	// A running stream keeps its buffers whatever the memory pressure.
+	std::vector<UCHAR> consumer;
+	Start(pool, g_Modes[1], NULL, consumer, first);
+
+	HostSetLowMemory(TRUE);
+	pool.Trim(FALSE);
+	pool.Trim(TRUE);
+	HostSetLowMemory(FALSE);
+
+	pool.Release();
+
+	Run(pool, g_Modes[1], buffers);
+	CHECK(SameBuffers(buffers, first));
+	CHECK(pool.GetAllocations() == 3);
+
+	// A stream stopping while memory is low frees them at once.
+	Start(pool, g_Modes[1], NULL, consumer, buffers);
+
+	HostSetLowMemory(TRUE);
+	pool.Release();
+	HostSetLowMemory(FALSE);
+
+	Run(pool, g_Modes[1], buffers);
+	CHECK(pool.GetAllocations() == 4);
+
+	// Trimmed on demand.
+	pool.Trim(TRUE);
+	Run(pool, g_Modes[0], buffers);
+	CHECK(pool.GetAllocations() == 5);
+}
+
+static void Benchmark()
+{
+	printf("mode   first frame   cold      warm (mean of 20 restarts)\n");
+
+	for (const Mode& mode : g_Modes)
+	{
+		std::vector<UCHAR> held(ConvertFrameSize(AvshwsFormatBgra, mode.width, mode.height));
+		std::vector<UCHAR> consumer;
+
+		for (UCHAR& byte : held)
+		{
+			byte = (UCHAR)TestRandom();
+		}
+
+		for (int withHeld = 0; withHeld < 2; withHeld++)
+		{
+			CFramePool pool;
+			PUCHAR buffers[FRAME_POOL_DEPTH];
+			const std::vector<UCHAR>* frame = withHeld ? &held : NULL;
+
+			double cold = Start(pool, mode, frame, consumer, buffers);
+			double warm = 0;
+
+			pool.Release();
+
+			for (int i = 0; i < 20; i++)
+			{
+				warm += Start(pool, mode, frame, consumer, buffers);
+				pool.Release();
+			}
+
+			warm /= 20;
+
+			printf("%-6s %-12s %7.3f ms %7.3f ms\n", mode.name, withHeld ? "held frame" : "black", cold * 1e3, warm * 1e3);
+
+			CHECK(pool.GetAllocations() == 1);
+		}
+	}
+}
+
+int main()
+{
+	TestReuse();
+	Benchmark();
+
+	return TestResult();
+}
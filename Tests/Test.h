@@ -0,0 +1,54 @@
+#pragma once
+
+//
+// The little the tests need: checks that count failures, and a clock for
+// the benchmarks.  A test returns TestResult() from main, so ctest fails it
+// if any check failed.  The helpers are inline, so a test needn't use
+// them all.
+//
+
+#include <stdio.h>
+
+#include <chrono>
+
+static int testFailures = 0;
+
+#define CHECK(condition) \
+	do \
+	{ \
+		if (!(condition)) \
+		{ \
+			fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+			testFailures++; \
+		} \
+	} while (0)
+
+static inline int TestResult()
+{
+	if (testFailures)
+	{
+		fprintf(stderr, "%d checks failed\n", testFailures);
+		return 1;
+	}
+
+	printf("All checks passed\n");
+	return 0;
+}
+
+// Seconds on a monotonic clock.
+static inline double TestSeconds()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// A deterministic generator for simulated delays and test data.
+static inline unsigned int TestRandom()
+{
+	static unsigned int state = 0x12345678;
+
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+
+	return state;
+}
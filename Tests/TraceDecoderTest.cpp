@@ -0,0 +1,289 @@
+//
+// The event trace decoder (UserLand/TraceDecoder).  A synthetic dump, laid
+// out as DumpTrace writes it (the AVSHWS_TRACE_DUMP header, then each
+// processor's records, oldest first), of a 30 fps producer injecting on one
+// processor while the ticks fill and release buffers on another: a frame
+// published before the trace started, ticks late by up to 3 ms, dropped
+// ticks whose frame is never delivered, frames delivered twice, dropped
+// injects and frames taken by the delay line.  Written to a file and read
+// back, it must decode into exactly the stage durations, tick intervals and
+// counts it was made with; dumps cut short, with a wrong header size or
+// missing are refused.  Then the cost of decoding a minute of trace.
+//
+
+#include "TraceDecode.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include "Test.h"
+
+#define DUMP_PATH "TraceDecoderTest.bin"
+
+// A 29.97 fps tick in 100ns units.
+#define TICK_PERIOD 333667
+
+//
+// A dump and the summary it must decode into.
+//
+struct SyntheticTrace
+{
+	std::vector<AVSHWS_TRACE_RECORD> processors[2];
+	TraceSummary expected;
+	int64_t first = 0;
+	int64_t last = 0;
+
+	void Add(USHORT processor, int64_t timestamp, AVSHWS_TRACE_EVENT event, ULONG generation, ULONG arg1, ULONG arg2)
+	{
+		AVSHWS_TRACE_RECORD record = {};
+		record.Timestamp = timestamp;
+		record.Event = (USHORT)event;
+		record.Processor = processor;
+		record.Generation = generation;
+		record.Arg1 = arg1;
+		record.Arg2 = arg2;
+
+		processors[processor].push_back(record);
+
+		if (first == 0 || timestamp < first)
+		{
+			first = timestamp;
+		}
+
+		if (timestamp > last)
+		{
+			last = timestamp;
+		}
+	}
+
+	std::vector<AVSHWS_TRACE_RECORD> Records() const
+	{
+		std::vector<AVSHWS_TRACE_RECORD> records = processors[0];
+		records.insert(records.end(), processors[1].begin(), processors[1].end());
+		return records;
+	}
+};
+
+//
+// Frame g is injected 5 ms before tick g, spends 1 to 3 ms in SetData and
+// is written to a buffer at the tick, which the consumer releases 40 ms
+// later.  Frame 1 was published before the trace started and is only seen
+// being delivered.
+//
+static SyntheticTrace MakeTrace(ULONG frames)
+{
+	const ULONG size = 1920 * 1080 * 3;
+	const int64_t start = 10000000;
+
+	SyntheticTrace trace;
+	int64_t lastTick = 0;
+
+	for (ULONG g = 1; g <= frames; g++)
+	{
+		int64_t tick = start + (int64_t)g * TICK_PERIOD + (g % 7 == 3 ? 30000 : 0);
+		int64_t enter = start + (int64_t)g * TICK_PERIOD - 50000;
+		ULONG setData = 10000 + (g % 3) * 10000;
+		bool dropped = g % 10 == 5;
+		bool twice = g % 10 == 8;
+
+		if (g > 1)
+		{
+			trace.Add(0, enter, AvshwsTraceSetDataEnter, 0, AvshwsFormatRgb24, size);
+			trace.Add(0, enter + setData, AvshwsTraceSetDataExit, g, setData, 0);
+			trace.expected.SetData.push_back(setData);
+		}
+
+		// A second producer whose frames are dropped or delayed.
+		if (g % 4 == 0)
+		{
+			trace.Add(0, enter + 40000, AvshwsTraceSetDataEnter, 0, AvshwsFormatNv12, size / 2);
+			trace.Add(0, enter + 41000, AvshwsTraceSetDataExit, 0, 1000, g % 8 == 0);
+			trace.expected.DroppedInjects += g % 8 != 0;
+		}
+
+		trace.Add(1, tick, AvshwsTraceDpc, 0, g, size);
+		trace.expected.Ticks++;
+
+		if (lastTick != 0)
+		{
+			trace.expected.TickIntervals.push_back(tick - lastTick);
+		}
+
+		lastTick = tick;
+
+		if (dropped)
+		{
+			trace.Add(1, tick + 500, AvshwsTraceSgFill, 0, 0, 0);
+			trace.expected.DroppedTicks++;
+			trace.expected.NeverDelivered++;
+			continue;
+		}
+
+		ULONG buffers = twice ? 2 : 1;
+
+		trace.Add(1, tick + 1000, AvshwsTraceSgFill, g, size, buffers);
+		trace.Add(1, tick + 1500, AvshwsTraceSgComplete, 0, buffers, 0);
+
+		for (ULONG i = 0; i < buffers; i++)
+		{
+			trace.Add(1, tick + 400000 + i * 1000, AvshwsTraceCloneDelete, g, g, size);
+		}
+
+		if (g > 1)
+		{
+			trace.expected.Queued.push_back(tick + 1000 - (enter + setData));
+			trace.expected.Released.push_back(400000 - 1000);
+			trace.expected.Total.push_back(tick + 400000 - enter);
+		}
+	}
+
+	// A buffer queued and flushed at stop; it held nothing.
+	int64_t stop = trace.last + 1000;
+
+	trace.Add(1, stop, AvshwsTraceSgProgram, 0, size, size);
+	trace.Add(1, stop, AvshwsTraceCloneDelete, frames, frames + 1, 0);
+
+	trace.expected.Origin = trace.first;
+	trace.expected.Duration = trace.last - trace.first;
+
+	return trace;
+}
+
+static bool WriteDump(const std::vector<AVSHWS_TRACE_RECORD>& records, ULONG headerSize, size_t cut)
+{
+	AVSHWS_TRACE_DUMP header = {};
+	header.Size = headerSize;
+	header.Enabled = 0;
+	header.Processors = 2;
+	header.RecordsAvailable = (ULONG)records.size();
+	header.RecordCount = (ULONG)records.size();
+
+	std::vector<UCHAR> dump(sizeof(header) + records.size() * sizeof(AVSHWS_TRACE_RECORD));
+	memcpy(dump.data(), &header, sizeof(header));
+	memcpy(dump.data() + sizeof(header), records.data(), records.size() * sizeof(AVSHWS_TRACE_RECORD));
+
+	FILE* file = fopen(DUMP_PATH, "wb");
+	if (file == NULL)
+	{
+		return false;
+	}
+
+	size_t length = dump.size() - cut;
+	bool ok = fwrite(dump.data(), 1, length, file) == length;
+	fclose(file);
+
+	return ok;
+}
+
+static void TestDecode()
+{
+	SyntheticTrace trace = MakeTrace(300);
+	std::vector<AVSHWS_TRACE_RECORD> written = trace.Records();
+
+	CHECK(WriteDump(written, sizeof(AVSHWS_TRACE_DUMP), 0));
+
+	AVSHWS_TRACE_DUMP header;
+	std::vector<AVSHWS_TRACE_RECORD> records;
+
+	CHECK(ReadTraceDump(DUMP_PATH, &header, &records));
+	CHECK(header.Processors == 2);
+	CHECK(header.RecordCount == written.size());
+	CHECK(records.size() == written.size());
+	CHECK(memcmp(records.data(), written.data(), written.size() * sizeof(AVSHWS_TRACE_RECORD)) == 0);
+
+	TraceSummary summary;
+	DecodeTrace(records, &summary);
+
+	const TraceSummary& expected = trace.expected;
+
+	CHECK(summary.SetData == expected.SetData);
+	CHECK(summary.Queued == expected.Queued);
+	CHECK(summary.Released == expected.Released);
+	CHECK(summary.Total == expected.Total);
+	CHECK(summary.TickIntervals == expected.TickIntervals);
+	CHECK(summary.Origin == expected.Origin);
+	CHECK(summary.Duration == expected.Duration);
+	CHECK(summary.Ticks == expected.Ticks);
+	CHECK(summary.DroppedTicks == expected.DroppedTicks);
+	CHECK(summary.DroppedInjects == expected.DroppedInjects);
+	CHECK(summary.NeverDelivered == expected.NeverDelivered);
+
+	// The frame published before the trace is only seen delivered.
+	CHECK(summary.Frames[1].Publish == 0);
+	CHECK(summary.Frames[1].Fills == 1);
+
+	// Counted once per buffer released, the flushed buffer not at all.
+	CHECK(summary.Frames[8].Releases == 2);
+	CHECK(summary.Frames[9].Releases == 1);
+	CHECK(summary.Frames[300].Releases == 1);
+	CHECK(summary.Frames[5].FirstFill == 0);
+
+	printf("%zu records: %zu frames, %u ticks (%u dropped), %u injects dropped\n",
+		records.size(), summary.SetData.size(), summary.Ticks, summary.DroppedTicks, summary.DroppedInjects);
+}
+
+static void TestRefused()
+{
+	std::vector<AVSHWS_TRACE_RECORD> records = MakeTrace(20).Records();
+	AVSHWS_TRACE_DUMP header;
+	std::vector<AVSHWS_TRACE_RECORD> read;
+
+	CHECK(WriteDump(records, sizeof(AVSHWS_TRACE_DUMP), 1));
+	CHECK(!ReadTraceDump(DUMP_PATH, &header, &read));
+
+	CHECK(WriteDump(records, sizeof(AVSHWS_TRACE_DUMP), records.size() * sizeof(AVSHWS_TRACE_RECORD) + 1));
+	CHECK(!ReadTraceDump(DUMP_PATH, &header, &read));
+
+	CHECK(WriteDump(records, sizeof(AVSHWS_TRACE_DUMP) + 4, 0));
+	CHECK(!ReadTraceDump(DUMP_PATH, &header, &read));
+
+	// A dump of a trace that was never on is just the header.
+	CHECK(WriteDump(std::vector<AVSHWS_TRACE_RECORD>(), sizeof(AVSHWS_TRACE_DUMP), 0));
+	CHECK(ReadTraceDump(DUMP_PATH, &header, &read));
+	CHECK(read.empty());
+
+	TraceSummary summary;
+	DecodeTrace(read, &summary);
+	CHECK(summary.Frames.empty() && summary.Ticks == 0 && summary.Duration == 0);
+
+	remove(DUMP_PATH);
+	CHECK(!ReadTraceDump(DUMP_PATH, &header, &read));
+}
+
+//
+// A minute of trace at 29.97 fps, about 7 records a frame.
+//
+static void Benchmark()
+{
+	SyntheticTrace trace = MakeTrace(1800);
+	std::vector<AVSHWS_TRACE_RECORD> records = trace.Records();
+	const int iterations = 20;
+
+	double seconds = 0;
+
+	for (int i = 0; i < iterations; i++)
+	{
+		std::vector<AVSHWS_TRACE_RECORD> copy = records;
+		TraceSummary summary;
+
+		double start = TestSeconds();
+		DecodeTrace(copy, &summary);
+		seconds += TestSeconds() - start;
+	}
+
+	seconds /= iterations;
+
+	printf("decode %zu records (1 minute): %.3f ms, %.1f ns per record\n",
+		records.size(), seconds * 1e3, seconds * 1e9 / records.size());
+}
+
+int main()
+{
+	TestDecode();
+	TestRefused();
+	Benchmark();
+
+	return TestResult();
+}
@@ -0,0 +1,182 @@
+//
+// The producer stall watchdog (watchdog.h) on a fake clock.  A 30 fps
+// producer injects with jitter and stalls, ticks at 29.97 fps check the
+// watchdog, and the test checks when the stream switches to the slate and
+// back, and how many switches are counted.
+//
+
+#include "portable.h"
+
+#include "Test.h"
+
+#define TICK_PERIOD 333667
+#define PRODUCER_PERIOD 333333
+#define TIMEOUT 500
+
+// 100ns units per millisecond.
+#define MS 10000
+
+struct Stream
+{
+	CStallWatchdog watchdog;
+	LONGLONG now;
+	LONGLONG nextTick;
+	LONGLONG nextInject;
+	bool producing;
+	BOOLEAN slateReady;
+
+	// The first tick at which the slate was shown, -1 if not yet.
+	LONGLONG switchedAt;
+
+	Stream(ULONG timeout) : now(1000000000), producing(true), slateReady(TRUE), switchedAt(-1)
+	{
+		watchdog.SetTimeout(timeout);
+		watchdog.Start(now);
+		nextTick = now + TICK_PERIOD;
+		nextInject = now + TestRandom() % PRODUCER_PERIOD;
+	}
+
+	// Runs the clock for Duration, injecting every Period (with up to
+	// Jitter late) while producing.
+	void Run(LONGLONG duration, LONGLONG period = PRODUCER_PERIOD, LONGLONG jitter = 0)
+	{
+		LONGLONG end = now + duration;
+
+		while (now < end)
+		{
+			if (producing && nextInject <= nextTick)
+			{
+				now = nextInject;
+				watchdog.Inject(now);
+				nextInject += period;
+				if (jitter)
+				{
+					nextInject += TestRandom() % jitter;
+				}
+			}
+			else
+			{
+				now = nextTick;
+				if (watchdog.Check(now, slateReady) && switchedAt < 0)
+				{
+					switchedAt = now;
+				}
+				nextTick += TICK_PERIOD;
+			}
+		}
+	}
+
+	// The producer stops, or comes back now.
+	void SetProducing(bool on)
+	{
+		producing = on;
+		nextInject = now;
+	}
+};
+
+static void TestHealthy()
+{
+	Stream stream(TIMEOUT);
+
+	// Jitter of up to 300 ms on top of the period never leaves a 500 ms gap.
+	stream.Run(60 * 1000 * MS, PRODUCER_PERIOD, 300 * MS);
+
+	CHECK(!stream.watchdog.IsNoSignal());
+	CHECK(stream.watchdog.GetSwitches() == 0);
+}
+
+static void TestStall()
+{
+	Stream stream(TIMEOUT);
+
+	stream.Run(1000 * MS);
+
+	// The producer dies: the slate comes at the first tick past the
+	// timeout.
+	LONGLONG lastInject = stream.nextInject - PRODUCER_PERIOD;
+	stream.SetProducing(false);
+	stream.Run(2000 * MS);
+
+	CHECK(stream.watchdog.IsNoSignal());
+	CHECK(stream.watchdog.GetSwitches() == 1);
+	CHECK(stream.switchedAt > lastInject + TIMEOUT * MS);
+	CHECK(stream.switchedAt <= lastInject + TIMEOUT * MS + TICK_PERIOD);
+
+	// It stays on the slate without counting again.
+	stream.Run(10000 * MS);
+	CHECK(stream.watchdog.GetSwitches() == 1);
+
+	// Back at the first tick after the producer's next frame.
+	stream.SetProducing(true);
+	stream.Run(TICK_PERIOD);
+	CHECK(!stream.watchdog.IsNoSignal());
+
+	// A second stall is a second switch.
+	stream.SetProducing(false);
+	stream.Run(2000 * MS);
+	CHECK(stream.watchdog.IsNoSignal());
+	CHECK(stream.watchdog.GetSwitches() == 2);
+}
+
+static void TestNeverStarted()
+{
+	// The producer gets the timeout from the start for its first frame.
+	Stream stream(TIMEOUT);
+	LONGLONG start = stream.now;
+
+	stream.SetProducing(false);
+	stream.Run(1000 * MS);
+
+	CHECK(stream.watchdog.GetSwitches() == 1);
+	CHECK(stream.switchedAt > start + TIMEOUT * MS);
+	CHECK(stream.switchedAt <= start + TIMEOUT * MS + TICK_PERIOD);
+
+	// A new stream starts over.
+	stream.watchdog.Start(stream.now);
+	CHECK(!stream.watchdog.IsNoSignal());
+	CHECK(stream.watchdog.GetSwitches() == 0);
+}
+
+static void TestDisabled()
+{
+	// No timeout, or no slate: the last frame repeats forever.
+	Stream off(0);
+	off.SetProducing(false);
+	off.Run(10000 * MS);
+	CHECK(off.watchdog.GetSwitches() == 0);
+
+	Stream noSlate(TIMEOUT);
+	noSlate.slateReady = FALSE;
+	noSlate.SetProducing(false);
+	noSlate.Run(10000 * MS);
+	CHECK(noSlate.watchdog.GetSwitches() == 0);
+}
+
+static void TestBoundary()
+{
+	CStallWatchdog watchdog;
+
+	watchdog.SetTimeout(TIMEOUT);
+	watchdog.Start(0);
+	watchdog.Inject(1000);
+
+	// Exactly the timeout is still on time; a frame stamped after the tick
+	// read its clock is on time too.
+	CHECK(!watchdog.Check(1000 + TIMEOUT * MS, TRUE));
+	CHECK(watchdog.Check(1000 + TIMEOUT * MS + 1, TRUE));
+
+	watchdog.Inject(2000000000);
+	CHECK(!watchdog.Check(1999999999, TRUE));
+	CHECK(watchdog.GetSwitches() == 1);
+}
+
+int main()
+{
+	TestHealthy();
+	TestStall();
+	TestNeverStarted();
+	TestDisabled();
+	TestBoundary();
+
+	return TestResult();
+}
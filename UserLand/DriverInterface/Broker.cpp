@@ -0,0 +1,1279 @@
+#include "Broker.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <new>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+#endif
+
+//
+// The section header is shared between processes, which only works for
+// atomics that don't fall back to a lock.
+//
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "32 bit atomics must be lock free");
+
+static uint64_t AlignOffset(uint64_t offset)
+{
+	return (offset + BROKER_ALIGNMENT - 1) & ~(uint64_t)(BROKER_ALIGNMENT - 1);
+}
+
+#ifdef _WIN32
+static HANDLE CreateChannel(bool first)
+{
+	return CreateNamedPipeA(
+		BROKER_CHANNEL_NAME,
+		PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED | (first ? FILE_FLAG_FIRST_PIPE_INSTANCE : 0),
+		PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+		PIPE_UNLIMITED_INSTANCES,
+		sizeof(BROKER_CONNECTED),
+		sizeof(BROKER_CONNECT),
+		0,
+		NULL);
+}
+
+//
+// Waits for an overlapped operation on a channel to complete.  If the stop
+// event is set first the operation is cancelled.
+//
+static bool WaitChannel(HANDLE channel, OVERLAPPED* overlapped, HANDLE stopEvent, DWORD* transferred)
+{
+	HANDLE events[2] = { overlapped->hEvent, stopEvent };
+
+	if (WaitForMultipleObjects(2, events, FALSE, INFINITE) != WAIT_OBJECT_0)
+	{
+		CancelIoEx(channel, overlapped);
+		GetOverlappedResult(channel, overlapped, transferred, TRUE);
+		return false;
+	}
+
+	return GetOverlappedResult(channel, overlapped, transferred, FALSE) != 0;
+}
+#endif
+
+//
+// Blocking transfers on the producer's end of the channel.
+//
+#ifdef _WIN32
+static bool SendAll(HANDLE channel, const void* data, uint32_t size)
+{
+	DWORD written = 0;
+	return WriteFile(channel, data, size, &written, NULL) && written == size;
+}
+
+static bool ReceiveAll(HANDLE channel, void* data, uint32_t size)
+{
+	uint8_t* bytes = (uint8_t*)data;
+
+	while (size != 0)
+	{
+		DWORD received = 0;
+		if (!ReadFile(channel, bytes, size, &received, NULL) || received == 0)
+		{
+			return false;
+		}
+
+		bytes += received;
+		size -= received;
+	}
+
+	return true;
+}
+#else
+static bool SendAll(int channel, const void* data, uint32_t size)
+{
+	const uint8_t* bytes = (const uint8_t*)data;
+
+	while (size != 0)
+	{
+		ssize_t sent = send(channel, bytes, size, MSG_NOSIGNAL);
+		if (sent < 0 && errno == EINTR)
+		{
+			continue;
+		}
+
+		if (sent <= 0)
+		{
+			return false;
+		}
+
+		bytes += sent;
+		size -= (uint32_t)sent;
+	}
+
+	return true;
+}
+
+static bool ReceiveAll(int channel, void* data, uint32_t size)
+{
+	uint8_t* bytes = (uint8_t*)data;
+
+	while (size != 0)
+	{
+		ssize_t received = recv(channel, bytes, size, 0);
+		if (received < 0 && errno == EINTR)
+		{
+			continue;
+		}
+
+		if (received <= 0)
+		{
+			return false;
+		}
+
+		bytes += received;
+		size -= (uint32_t)received;
+	}
+
+	return true;
+}
+
+static bool SetChannelAddress(sockaddr_un* address)
+{
+	memset(address, 0, sizeof(*address));
+	address->sun_family = AF_UNIX;
+
+	return snprintf(address->sun_path, sizeof(address->sun_path), "%s", BROKER_CHANNEL_NAME) < (int)sizeof(address->sun_path);
+}
+#endif
+
+/*
+	BrokerSection
+*/
+
+BrokerSection::BrokerSection()
+	:
+#ifdef _WIN32
+	mappingHandle(NULL),
+#endif
+	view(NULL), viewSize(0), bufferSize(0), bufferStride(0), owner(false)
+{
+	name[0] = '\0';
+}
+
+BrokerSection::~BrokerSection()
+{
+	Close();
+}
+
+uint64_t BrokerSection::GetSectionSize(uint32_t bufferSize)
+{
+	return AlignOffset(sizeof(BROKER_SECTION_HEADER)) + AlignOffset(bufferSize) * BROKER_BUFFER_COUNT;
+}
+
+bool BrokerSection::Create(const char* sectionName, uint32_t sectionBufferSize, uint32_t role)
+{
+	Close();
+
+	uint64_t size = GetSectionSize(sectionBufferSize);
+
+	if (snprintf(name, sizeof(name), "%s", sectionName) >= (int)sizeof(name))
+	{
+		name[0] = '\0';
+		return false;
+	}
+
+#ifdef _WIN32
+	HANDLE mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)(size >> 32), (DWORD)size, name);
+	if (mapping == NULL)
+	{
+		return false;
+	}
+
+	if (GetLastError() == ERROR_ALREADY_EXISTS)
+	{
+		CloseHandle(mapping);
+		return false;
+	}
+
+	mappingHandle = mapping;
+
+	view = (uint8_t*)MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, (SIZE_T)size);
+#else
+	int descriptor = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+	if (descriptor < 0)
+	{
+		return false;
+	}
+
+	owner = true;
+
+	void* mapped = MAP_FAILED;
+	if (ftruncate(descriptor, (off_t)size) == 0)
+	{
+		mapped = mmap(NULL, (size_t)size, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+	}
+
+	close(descriptor);
+
+	view = (mapped != MAP_FAILED) ? (uint8_t*)mapped : NULL;
+#endif
+
+	if (view == NULL)
+	{
+		Close();
+		return false;
+	}
+
+	owner = true;
+	viewSize = size;
+	bufferSize = sectionBufferSize;
+	bufferStride = (uint32_t)AlignOffset(sectionBufferSize);
+
+	//
+	// Buffer 0 starts as the producer's back buffer, 1 as the middle one
+	// and 2 as the broker's front buffer.
+	//
+	BROKER_SECTION_HEADER* header = new (view) BROKER_SECTION_HEADER();
+	header->Size = sizeof(BROKER_SECTION_HEADER);
+	header->BufferSize = bufferSize;
+	header->BufferStride = bufferStride;
+	header->Role = role;
+	header->Middle.store(1);
+	header->Published.store(0);
+	header->Replaced.store(0);
+
+	return true;
+}
+
+bool BrokerSection::Open(const char* sectionName, uint64_t size)
+{
+	Close();
+
+	if (size < GetSectionSize(0) || size > GetSectionSize(BROKER_MAX_BUFFER_SIZE))
+	{
+		return false;
+	}
+
+#ifdef _WIN32
+	HANDLE mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, sectionName);
+	if (mapping == NULL)
+	{
+		return false;
+	}
+
+	mappingHandle = mapping;
+
+	view = (uint8_t*)MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, (SIZE_T)size);
+#else
+	int descriptor = shm_open(sectionName, O_RDWR, 0);
+	if (descriptor < 0)
+	{
+		return false;
+	}
+
+	void* mapped = MAP_FAILED;
+	struct stat status;
+	if (fstat(descriptor, &status) == 0 && (uint64_t)status.st_size >= size)
+	{
+		mapped = mmap(NULL, (size_t)size, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+	}
+
+	close(descriptor);
+
+	view = (mapped != MAP_FAILED) ? (uint8_t*)mapped : NULL;
+#endif
+
+	if (view == NULL)
+	{
+		Close();
+		return false;
+	}
+
+	viewSize = size;
+
+	BROKER_SECTION_HEADER* header = GetHeader();
+	if (header->Size != sizeof(BROKER_SECTION_HEADER) ||
+		header->BufferStride != AlignOffset(header->BufferSize) ||
+		GetSectionSize(header->BufferSize) > size)
+	{
+		Close();
+		return false;
+	}
+
+	bufferSize = header->BufferSize;
+	bufferStride = header->BufferStride;
+
+	return true;
+}
+
+void BrokerSection::Close()
+{
+#ifdef _WIN32
+	if (view != NULL)
+	{
+		UnmapViewOfFile(view);
+	}
+
+	if (mappingHandle != NULL)
+	{
+		CloseHandle(mappingHandle);
+		mappingHandle = NULL;
+	}
+#else
+	if (view != NULL)
+	{
+		munmap(view, (size_t)viewSize);
+	}
+
+	if (owner)
+	{
+		shm_unlink(name);
+	}
+#endif
+
+	view = NULL;
+	viewSize = 0;
+	bufferSize = 0;
+	bufferStride = 0;
+	owner = false;
+}
+
+BROKER_FRAME* BrokerSection::GetBuffer(uint32_t index)
+{
+	return (BROKER_FRAME*)(view + AlignOffset(sizeof(BROKER_SECTION_HEADER)) + (uint64_t)bufferStride * index);
+}
+
+/*
+	BrokerStubSink
+*/
+
+BrokerStubSink::BrokerStubSink(uint32_t frameSize)
+	: pixels(frameSize), framesSet(0), timestamp(0), format(0)
+{
+}
+
+bool BrokerStubSink::SetFrame(BROKER_FRAME* frame, uint32_t bufferSize)
+{
+	if (sizeof(BROKER_FRAME) + pixels.size() > bufferSize)
+	{
+		return false;
+	}
+
+	timestamp = frame->Timestamp;
+	format = frame->Format;
+	memcpy(pixels.data(), frame + 1, pixels.size());
+
+	framesSet++;
+
+	return true;
+}
+
+/*
+	FrameBroker
+*/
+
+FrameBroker::FrameBroker()
+	: width(0), height(0), framePeriod(0), nextId(1), stopping(false),
+#ifdef _WIN32
+	listenChannel(NULL), stopEvent(NULL)
+#else
+	listenChannel(-1)
+#endif
+{
+#ifndef _WIN32
+	stopPipe[0] = -1;
+	stopPipe[1] = -1;
+#endif
+}
+
+FrameBroker::~FrameBroker()
+{
+	Stop();
+}
+
+bool FrameBroker::Start(BrokerSink** sinks, uint32_t cameraCount, uint32_t frameWidth, uint32_t frameHeight, uint32_t framesPerSecond)
+{
+	if (!cameras.empty() || cameraCount == 0 || cameraCount > BROKER_MAX_CAMERAS || framesPerSecond == 0)
+	{
+		return false;
+	}
+
+	width = frameWidth;
+	height = frameHeight;
+	framePeriod = 10000000 / framesPerSecond;
+	stopping = false;
+
+	//
+	// Claim the channel.  This fails if another broker has it.
+	//
+#ifdef _WIN32
+	stopEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+	listenChannel = CreateChannel(true);
+
+	if (stopEvent == NULL || listenChannel == INVALID_HANDLE_VALUE)
+	{
+		listenChannel = NULL;
+		Stop();
+		return false;
+	}
+#else
+	sockaddr_un address;
+	if (!SetChannelAddress(&address) || pipe(stopPipe) != 0)
+	{
+		Stop();
+		return false;
+	}
+
+	//
+	// A socket left behind by a broker that died is replaced, one that
+	// still answers is not.
+	//
+	int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+	bool answered = probe >= 0 && connect(probe, (sockaddr*)&address, sizeof(address)) == 0;
+
+	if (probe >= 0)
+	{
+		close(probe);
+	}
+
+	listenChannel = answered ? -1 : socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listenChannel < 0)
+	{
+		Stop();
+		return false;
+	}
+
+	unlink(address.sun_path);
+
+	if (bind(listenChannel, (sockaddr*)&address, sizeof(address)) != 0 ||
+		listen(listenChannel, SOMAXCONN) != 0)
+	{
+		Stop();
+		return false;
+	}
+#endif
+
+	for (uint32_t index = 0; index < cameraCount; index++)
+	{
+		Camera* camera = new Camera();
+		camera->sink = sinks[index];
+		camera->feed = NULL;
+		camera->framesForwarded = 0;
+		camera->framesRejected = 0;
+		camera->compositor.SetSize(width, height);
+
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			camera->redactor = redactions;
+		}
+
+		cameras.push_back(std::unique_ptr<Camera>(camera));
+	}
+
+	for (auto& camera : cameras)
+	{
+		camera->thread = std::thread(&FrameBroker::CameraThread, this, camera.get());
+	}
+
+	listenThread = std::thread(&FrameBroker::ListenThread, this);
+
+	return true;
+}
+
+void FrameBroker::Stop()
+{
+	stopping = true;
+
+#ifdef _WIN32
+	if (stopEvent != NULL)
+	{
+		SetEvent(stopEvent);
+	}
+#else
+	if (stopPipe[1] >= 0)
+	{
+		ssize_t written = write(stopPipe[1], "", 1);
+		(void)written;
+	}
+#endif
+
+	if (listenThread.joinable())
+	{
+		listenThread.join();
+	}
+
+	//
+	// The connections see the stop too and disconnect their producers.
+	//
+	ReapConnections(true);
+
+	for (auto& camera : cameras)
+	{
+		if (camera->thread.joinable())
+		{
+			camera->thread.join();
+		}
+	}
+
+	cameras.clear();
+
+#ifdef _WIN32
+	if (listenChannel != NULL)
+	{
+		CloseHandle(listenChannel);
+		listenChannel = NULL;
+	}
+
+	if (stopEvent != NULL)
+	{
+		CloseHandle(stopEvent);
+		stopEvent = NULL;
+	}
+#else
+	if (listenChannel >= 0)
+	{
+		close(listenChannel);
+		listenChannel = -1;
+
+		sockaddr_un address;
+		if (SetChannelAddress(&address))
+		{
+			unlink(address.sun_path);
+		}
+	}
+
+	for (int end = 0; end < 2; end++)
+	{
+		if (stopPipe[end] >= 0)
+		{
+			close(stopPipe[end]);
+			stopPipe[end] = -1;
+		}
+	}
+#endif
+}
+
+void FrameBroker::SetRedactions(const Redactor& newRedactions)
+{
+	std::lock_guard<std::mutex> guard(lock);
+
+	redactions = newRedactions;
+
+	for (auto& camera : cameras)
+	{
+		std::lock_guard<std::mutex> cameraGuard(camera->lock);
+		camera->redactor = redactions;
+	}
+}
+
+void FrameBroker::GetStatistics(BROKER_STATISTICS* statistics)
+{
+	memset(statistics, 0, sizeof(BROKER_STATISTICS));
+	statistics->Size = sizeof(BROKER_STATISTICS);
+	statistics->Cameras = (uint32_t)cameras.size();
+
+	for (auto& camera : cameras)
+	{
+		std::lock_guard<std::mutex> guard(camera->lock);
+
+		statistics->FramesForwarded += camera->framesForwarded;
+		statistics->FramesRejected += camera->framesRejected;
+
+		std::vector<Producer*> producers(camera->layers);
+		if (camera->feed != NULL)
+		{
+			producers.push_back(camera->feed);
+		}
+
+		for (Producer* producer : producers)
+		{
+			statistics->Producers++;
+			statistics->FramesPublished += producer->section.GetHeader()->Published.load();
+			statistics->FramesReplaced += producer->section.GetHeader()->Replaced.load();
+		}
+	}
+}
+
+void FrameBroker::ListenThread()
+{
+	while (!stopping)
+	{
+#ifdef _WIN32
+		HANDLE channel = (HANDLE)listenChannel;
+
+		OVERLAPPED overlapped = {};
+		overlapped.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+		if (overlapped.hEvent == NULL)
+		{
+			break;
+		}
+
+		DWORD transferred = 0;
+		bool connected = ConnectNamedPipe(channel, &overlapped) != 0;
+		if (!connected)
+		{
+			DWORD error = GetLastError();
+			connected = error == ERROR_PIPE_CONNECTED ||
+				(error == ERROR_IO_PENDING && WaitChannel(channel, &overlapped, (HANDLE)stopEvent, &transferred));
+		}
+
+		CloseHandle(overlapped.hEvent);
+
+		if (!connected)
+		{
+			DisconnectNamedPipe(channel);
+			continue;
+		}
+
+		//
+		// The connected instance goes to the connection; a new one listens.
+		//
+		HANDLE next = CreateChannel(false);
+		listenChannel = (next != INVALID_HANDLE_VALUE) ? next : NULL;
+#else
+		pollfd events[2] = { { listenChannel, POLLIN, 0 }, { stopPipe[0], POLLIN, 0 } };
+		if (poll(events, 2, -1) < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			break;
+		}
+
+		if (events[1].revents != 0)
+		{
+			break;
+		}
+
+		int channel = accept(listenChannel, NULL, NULL);
+		if (channel < 0)
+		{
+			continue;
+		}
+#endif
+
+		ReapConnections(false);
+
+		Connection* connection = new Connection();
+		connection->channel = channel;
+		connection->done = false;
+
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			connections.push_back(std::unique_ptr<Connection>(connection));
+		}
+
+		connection->thread = std::thread(&FrameBroker::ConnectionThread, this, connection);
+
+#ifdef _WIN32
+		if (listenChannel == NULL)
+		{
+			break;
+		}
+#endif
+	}
+}
+
+void FrameBroker::ReapConnections(bool all)
+{
+	std::vector<std::unique_ptr<Connection>> finished;
+
+	{
+		std::lock_guard<std::mutex> guard(lock);
+
+		for (auto entry = connections.begin(); entry != connections.end();)
+		{
+			if (all || (*entry)->done)
+			{
+				finished.push_back(std::move(*entry));
+				entry = connections.erase(entry);
+			}
+			else
+			{
+				++entry;
+			}
+		}
+	}
+
+	for (auto& connection : finished)
+	{
+		connection->thread.join();
+		CloseChannel(connection.get());
+	}
+}
+
+void FrameBroker::ConnectionThread(Connection* connection)
+{
+	BROKER_CONNECT request;
+	BROKER_CONNECTED reply;
+
+	memset(&reply, 0, sizeof(reply));
+	reply.Size = sizeof(reply);
+	reply.Camera = -1;
+
+	if (ReadChannel(connection, &request, sizeof(request)))
+	{
+		Producer* producer = Attach(request, &reply);
+
+		if (WriteChannel(connection, &reply, sizeof(reply)) && producer != NULL)
+		{
+			//
+			// Producers don't send anything else; the read ends when the
+			// producer disconnects or the broker stops.
+			//
+			uint8_t discard;
+			while (ReadChannel(connection, &discard, 1))
+			{
+			}
+		}
+
+		if (producer != NULL)
+		{
+			Detach(reply.Camera, producer);
+		}
+	}
+
+	connection->done = true;
+}
+
+FrameBroker::Producer* FrameBroker::Attach(const BROKER_CONNECT& request, BROKER_CONNECTED* reply)
+{
+	if (request.Size != sizeof(BROKER_CONNECT) ||
+		request.Version != BROKER_VERSION ||
+		request.Role > BROKER_ROLE_LAYER ||
+		request.BufferSize < sizeof(BROKER_FRAME) ||
+		request.BufferSize > BROKER_MAX_BUFFER_SIZE ||
+		request.Camera < -1 ||
+		request.Camera >= (int32_t)cameras.size())
+	{
+		return NULL;
+	}
+
+	//
+	// A layer's buffers must hold a full frame BGRA image.
+	//
+	if (request.Role == BROKER_ROLE_LAYER &&
+		request.BufferSize - sizeof(BROKER_FRAME) < (uint64_t)width * height * 4)
+	{
+		return NULL;
+	}
+
+	Producer* producer = new Producer();
+	producer->id = nextId++;
+	producer->role = request.Role;
+	producer->front = 2;
+	producer->layer = 0;
+
+	char name[BROKER_SECTION_NAME_LENGTH];
+#ifdef _WIN32
+	snprintf(name, sizeof(name), "Local\\VirtualCameraBroker.%lu.%u", (unsigned long)GetCurrentProcessId(), producer->id);
+#else
+	snprintf(name, sizeof(name), "/VirtualCameraBroker.%d.%u", (int)getpid(), producer->id);
+#endif
+
+	if (!producer->section.Create(name, request.BufferSize, request.Role))
+	{
+		delete producer;
+		return NULL;
+	}
+
+	for (uint32_t index = 0; index < cameras.size(); index++)
+	{
+		if (request.Camera >= 0 && (uint32_t)request.Camera != index)
+		{
+			continue;
+		}
+
+		Camera* camera = cameras[index].get();
+		std::lock_guard<std::mutex> guard(camera->lock);
+
+		if (request.Role == BROKER_ROLE_FEED)
+		{
+			if (camera->feed != NULL)
+			{
+				continue;
+			}
+
+			camera->feed = producer;
+		}
+		else
+		{
+			if (camera->layers.size() >= BROKER_MAX_LAYERS || (request.Camera < 0 && camera->feed == NULL))
+			{
+				continue;
+			}
+
+			producer->layer = camera->compositor.AddLayer();
+			camera->layers.push_back(producer);
+		}
+
+		reply->Status = 1;
+		reply->Camera = (int32_t)index;
+		reply->ProducerId = producer->id;
+		reply->SectionSize = producer->section.GetSize();
+		snprintf(reply->SectionName, sizeof(reply->SectionName), "%s", name);
+
+		return producer;
+	}
+
+	delete producer;
+	return NULL;
+}
+
+void FrameBroker::Detach(int cameraIndex, Producer* producer)
+{
+	Camera* camera = cameras[cameraIndex].get();
+
+	{
+		std::lock_guard<std::mutex> guard(camera->lock);
+
+		if (camera->feed == producer)
+		{
+			camera->feed = NULL;
+		}
+		else
+		{
+			camera->layers.erase(std::remove(camera->layers.begin(), camera->layers.end(), producer), camera->layers.end());
+			camera->compositor.RemoveLayer(producer->layer);
+		}
+	}
+
+	delete producer;
+}
+
+//
+// Swaps the front buffer with the middle one if the producer published a
+// frame since the last time.
+//
+bool FrameBroker::TakeFrame(Producer* producer)
+{
+	BROKER_SECTION_HEADER* header = producer->section.GetHeader();
+	uint32_t middle = header->Middle.load();
+
+	do
+	{
+		if ((middle & BROKER_FRESH) == 0)
+		{
+			return false;
+		}
+
+		//
+		// Only a producer that wrote over the header gets an index out of
+		// range.  The middle buffer is left as it is, so the front one is
+		// never handed to the producer while the camera still has it.
+		//
+		if ((middle & BROKER_INDEX_MASK) >= BROKER_BUFFER_COUNT)
+		{
+			return false;
+		}
+
+		// A publish in between changes the middle buffer: check it again.
+	} while (!header->Middle.compare_exchange_weak(middle, producer->front));
+
+	producer->front = middle & BROKER_INDEX_MASK;
+
+	return true;
+}
+
+//
+// The bytes a tightly packed frame takes, or 0 for a format the broker
+// doesn't know.
+//
+static uint64_t GetFrameSize(uint32_t format, uint32_t width, uint32_t height)
+{
+	uint64_t pixels = (uint64_t)width * height;
+
+	switch (format)
+	{
+	case BROKER_FORMAT_RGB24:
+		return pixels * 3;
+
+	case BROKER_FORMAT_BGRA:
+	case BROKER_FORMAT_RGBA:
+		return pixels * 4;
+
+	case BROKER_FORMAT_NV12:
+		return pixels + (uint64_t)width * (height / 2);
+
+	case BROKER_FORMAT_I420:
+		return pixels + (uint64_t)(width / 2) * (height / 2) * 2;
+
+	case BROKER_FORMAT_YUY2:
+		return pixels * 2;
+
+	case BROKER_FORMAT_RGB48:
+		return pixels * 6;
+
+	case BROKER_FORMAT_RGBA64:
+		return pixels * 8;
+
+	case BROKER_FORMAT_P010:
+		return (pixels + (uint64_t)width * (height / 2)) * 2;
+	}
+
+	return 0;
+}
+
+//
+// Redacts each plane of a feed frame of width x height, laid out as the
+// driver interface lays out the frames it redacts.  Fails if the frame
+// isn't one the redactor can take.
+//
+static bool RedactFrame(Redactor& redactor, uint8_t* frame, uint32_t format, uint64_t pixelBytes, uint32_t width, uint32_t height)
+{
+	uint64_t frameSize = GetFrameSize(format, width, height);
+
+	if (frameSize == 0 || frameSize > pixelBytes ||
+		redactor.GetWidth() != width || redactor.GetHeight() != height)
+	{
+		return false;
+	}
+
+	switch (format)
+	{
+	case BROKER_FORMAT_RGB24:
+		return redactor.Apply(frame, width * 3, 1, 3, 0, 0);
+
+	case BROKER_FORMAT_BGRA:
+	case BROKER_FORMAT_RGBA:
+		return redactor.Apply(frame, width * 4, 1, 4, 0, 0);
+
+	case BROKER_FORMAT_NV12:
+		return redactor.Apply(frame, width, 1, 1, 0, 0) &&
+			redactor.Apply(frame + width * height, width, 1, 2, 1, 1);
+
+	case BROKER_FORMAT_I420:
+		return redactor.Apply(frame, width, 1, 1, 0, 0) &&
+			redactor.Apply(frame + width * height, width / 2, 1, 1, 1, 1) &&
+			redactor.Apply(frame + width * height + (width / 2) * (height / 2), width / 2, 1, 1, 1, 1);
+
+	case BROKER_FORMAT_YUY2:
+		return redactor.Apply(frame, width * 2, 1, 4, 1, 0);
+
+	case BROKER_FORMAT_RGB48:
+		return redactor.Apply(frame, width * 6, 2, 3, 0, 0);
+
+	case BROKER_FORMAT_RGBA64:
+		return redactor.Apply(frame, width * 8, 2, 4, 0, 0);
+
+	case BROKER_FORMAT_P010:
+		return redactor.Apply(frame, width * 2, 2, 1, 0, 0) &&
+			redactor.Apply(frame + width * 2 * height, width * 2, 2, 2, 1, 1);
+	}
+
+	return false;
+}
+
+void FrameBroker::CameraThread(Camera* camera)
+{
+	typedef std::chrono::steady_clock clock;
+
+	std::chrono::microseconds period(framePeriod / 10);
+	clock::time_point due = clock::now();
+
+	while (!stopping)
+	{
+		//
+		// After a stall, start over rather than catch up on the periods
+		// missed.
+		//
+		due += period;
+		if (clock::now() - due > period)
+		{
+			due = clock::now();
+		}
+
+		std::this_thread::sleep_until(due);
+
+		std::lock_guard<std::mutex> guard(camera->lock);
+
+		for (Producer* layer : camera->layers)
+		{
+			if (TakeFrame(layer))
+			{
+				camera->compositor.SetLayerImage(
+					layer->layer,
+					(const uint8_t*)(layer->section.GetBuffer(layer->front) + 1),
+					(int32_t)(width * 4),
+					width,
+					height,
+					false);
+			}
+		}
+
+		Producer* feed = camera->feed;
+		if (feed == NULL || !TakeFrame(feed))
+		{
+			continue;
+		}
+
+		BROKER_FRAME* frame = feed->section.GetBuffer(feed->front);
+		uint64_t pixelBytes = feed->section.GetBufferSize() - sizeof(BROKER_FRAME);
+		uint32_t format = frame->Format;
+
+		//
+		// Redacted first, as the driver interface does, so the layers go
+		// over the redacted frame.  The camera never gets a frame that
+		// should have been redacted and wasn't.
+		//
+		if (!camera->redactor.IsEmpty() &&
+			!RedactFrame(camera->redactor, (uint8_t*)(frame + 1), format, pixelBytes, width, height))
+		{
+			camera->framesRejected++;
+			continue;
+		}
+
+		if (!camera->compositor.IsEmpty())
+		{
+			if (format == BROKER_FORMAT_RGB24 && pixelBytes >= (uint64_t)width * height * 3)
+			{
+				camera->compositor.Apply((uint8_t*)(frame + 1), (int32_t)(width * 3), 3);
+			}
+			else if (format == BROKER_FORMAT_BGRA && pixelBytes >= (uint64_t)width * height * 4)
+			{
+				camera->compositor.Apply((uint8_t*)(frame + 1), (int32_t)(width * 4), 4);
+			}
+		}
+
+		if (camera->sink->SetFrame(frame, feed->section.GetBufferSize()))
+		{
+			camera->framesForwarded++;
+		}
+		else
+		{
+			camera->framesRejected++;
+		}
+	}
+}
+
+bool FrameBroker::ReadChannel(Connection* connection, void* data, uint32_t size)
+{
+	uint8_t* bytes = (uint8_t*)data;
+
+#ifdef _WIN32
+	HANDLE channel = (HANDLE)connection->channel;
+
+	OVERLAPPED overlapped = {};
+	overlapped.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+	if (overlapped.hEvent == NULL)
+	{
+		return false;
+	}
+
+	bool result = true;
+
+	while (result && size != 0)
+	{
+		DWORD received = 0;
+
+		ResetEvent(overlapped.hEvent);
+		result = (ReadFile(channel, bytes, size, NULL, &overlapped) || GetLastError() == ERROR_IO_PENDING) &&
+			WaitChannel(channel, &overlapped, (HANDLE)stopEvent, &received) &&
+			received != 0;
+
+		bytes += received;
+		size -= received;
+	}
+
+	CloseHandle(overlapped.hEvent);
+
+	return result;
+#else
+	while (size != 0)
+	{
+		pollfd events[2] = { { connection->channel, POLLIN, 0 }, { stopPipe[0], POLLIN, 0 } };
+		if (poll(events, 2, -1) < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			return false;
+		}
+
+		if (events[1].revents != 0)
+		{
+			return false;
+		}
+
+		ssize_t received = recv(connection->channel, bytes, size, MSG_DONTWAIT);
+		if (received < 0 && (errno == EINTR || errno == EAGAIN))
+		{
+			continue;
+		}
+
+		if (received <= 0)
+		{
+			return false;
+		}
+
+		bytes += received;
+		size -= (uint32_t)received;
+	}
+
+	return true;
+#endif
+}
+
+bool FrameBroker::WriteChannel(Connection* connection, const void* data, uint32_t size)
+{
+#ifdef _WIN32
+	HANDLE channel = (HANDLE)connection->channel;
+
+	OVERLAPPED overlapped = {};
+	overlapped.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+	if (overlapped.hEvent == NULL)
+	{
+		return false;
+	}
+
+	DWORD written = 0;
+	bool result = (WriteFile(channel, data, size, NULL, &overlapped) || GetLastError() == ERROR_IO_PENDING) &&
+		WaitChannel(channel, &overlapped, (HANDLE)stopEvent, &written) &&
+		written == size;
+
+	CloseHandle(overlapped.hEvent);
+
+	return result;
+#else
+	return SendAll(connection->channel, data, size);
+#endif
+}
+
+void FrameBroker::CloseChannel(Connection* connection)
+{
+#ifdef _WIN32
+	DisconnectNamedPipe((HANDLE)connection->channel);
+	CloseHandle((HANDLE)connection->channel);
+#else
+	close(connection->channel);
+#endif
+}
+
+/*
+	BrokerClient
+*/
+
+BrokerClient::BrokerClient()
+	:
+#ifdef _WIN32
+	channel(NULL),
+#else
+	channel(-1),
+#endif
+	back(0), camera(-1)
+{
+}
+
+BrokerClient::~BrokerClient()
+{
+	Disconnect();
+}
+
+bool BrokerClient::Connect(int cameraIndex, uint32_t role, uint32_t bufferSize)
+{
+	Disconnect();
+
+#ifdef _WIN32
+	HANDLE handle = CreateFileA(BROKER_CHANNEL_NAME, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+	if (handle == INVALID_HANDLE_VALUE && GetLastError() == ERROR_PIPE_BUSY && WaitNamedPipeA(BROKER_CHANNEL_NAME, 1000))
+	{
+		handle = CreateFileA(BROKER_CHANNEL_NAME, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+	}
+
+	if (handle == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	channel = handle;
+#else
+	sockaddr_un address;
+	if (!SetChannelAddress(&address))
+	{
+		return false;
+	}
+
+	channel = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (channel < 0)
+	{
+		return false;
+	}
+
+	if (connect(channel, (sockaddr*)&address, sizeof(address)) != 0)
+	{
+		Disconnect();
+		return false;
+	}
+#endif
+
+	BROKER_CONNECT request = { sizeof(BROKER_CONNECT), BROKER_VERSION, cameraIndex, role, bufferSize };
+	BROKER_CONNECTED reply;
+
+	if (!SendAll(channel, &request, sizeof(request)) ||
+		!ReceiveAll(channel, &reply, sizeof(reply)) ||
+		reply.Size != sizeof(BROKER_CONNECTED) ||
+		reply.Status == 0)
+	{
+		Disconnect();
+		return false;
+	}
+
+	reply.SectionName[BROKER_SECTION_NAME_LENGTH - 1] = '\0';
+
+	if (!section.Open(reply.SectionName, reply.SectionSize) || section.GetBufferSize() < bufferSize)
+	{
+		Disconnect();
+		return false;
+	}
+
+	back = 0;
+	camera = reply.Camera;
+
+	return true;
+}
+
+void BrokerClient::Disconnect()
+{
+	section.Close();
+
+#ifdef _WIN32
+	if (channel != NULL)
+	{
+		CloseHandle(channel);
+		channel = NULL;
+	}
+#else
+	if (channel >= 0)
+	{
+		close(channel);
+		channel = -1;
+	}
+#endif
+
+	camera = -1;
+}
+
+void BrokerClient::Publish()
+{
+	BROKER_SECTION_HEADER* header = section.GetHeader();
+
+	uint32_t middle = header->Middle.exchange(back | BROKER_FRESH);
+
+	header->Published++;
+	if (middle & BROKER_FRESH)
+	{
+		header->Replaced++;
+	}
+
+	back = middle & BROKER_INDEX_MASK;
+}
@@ -0,0 +1,383 @@
+#pragma once
+
+//
+// Local frame broker.
+//
+// One broker process owns the virtual cameras and any number of producer
+// processes feed them through it, instead of each producer opening a
+// camera of its own.  A producer connects over a local channel (a named
+// pipe on Windows, a Unix domain socket elsewhere) and is assigned a
+// camera, either as its feed or as a compositing layer over the feed.  It
+// gets a shared memory section of BROKER_BUFFER_COUNT frame buffers, and
+// frames change hands through the section without being copied: the
+// producer writes its back buffer and swaps it with the middle one, the
+// broker swaps the middle one with its front buffer and hands that to the
+// camera.  A producer publishing faster than the camera's rate replaces
+// the middle buffer, so each camera gets the newest frame once per frame
+// period.  The producer closes the channel to disconnect; a producer that
+// dies is disconnected the same way.
+//
+// Like Recording.h this only depends on the C++ standard library and the
+// OS APIs.  The cameras are BrokerSink implementations, so the broker can
+// run without the driver (or on another OS) with BrokerStubSink cameras
+// for load testing, see Tests/BrokerLoad.
+//
+
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Compositor.h"
+#include "Redaction.h"
+
+#define BROKER_VERSION 1
+
+#ifdef _WIN32
+#define BROKER_CHANNEL_NAME "\\\\.\\pipe\\VirtualCameraBroker"
+#else
+#define BROKER_CHANNEL_NAME "/tmp/VirtualCameraBroker"
+#endif
+
+#define BROKER_MAX_CAMERAS 16
+#define BROKER_MAX_LAYERS 8
+#define BROKER_MAX_BUFFER_SIZE (64 * 1024 * 1024)
+#define BROKER_SECTION_NAME_LENGTH 64
+#define BROKER_ALIGNMENT 64
+
+//
+// The back, middle and front buffer.  The middle buffer's index is kept in
+// the section header with BROKER_FRESH set while the producer has
+// published it and the broker hasn't taken it yet.
+//
+#define BROKER_BUFFER_COUNT 3
+#define BROKER_INDEX_MASK 0x3
+#define BROKER_FRESH 0x4
+
+//
+// Producer roles.  A camera has at most one feed and BROKER_MAX_LAYERS
+// layers.  Layers are full frame BGRA images, alpha not pre-multiplied,
+// composited over the feed's RGB24 and BGRA frames.
+//
+#define BROKER_ROLE_FEED 0
+#define BROKER_ROLE_LAYER 1
+
+//
+// The pixel formats of feed frames, the PIXEL_FORMAT_* values of Device.h,
+// tightly packed as the driver takes them.  Every format is redacted;
+// layers are composited over RGB24 and BGRA frames only.
+//
+#define BROKER_FORMAT_RGB24 0
+#define BROKER_FORMAT_BGRA 1
+#define BROKER_FORMAT_RGBA 2
+#define BROKER_FORMAT_NV12 3
+#define BROKER_FORMAT_I420 4
+#define BROKER_FORMAT_YUY2 5
+#define BROKER_FORMAT_RGB48 6
+#define BROKER_FORMAT_RGBA64 7
+#define BROKER_FORMAT_P010 8
+
+#pragma pack(push, 8)
+
+//
+// The header each frame buffer starts with.  Must match FRAME_HEADER in
+// Device.h, so a buffer can be handed to the driver as it is.
+//
+typedef struct _BROKER_FRAME {
+	uint32_t Size;
+	uint32_t Flags;
+	int64_t Timestamp;
+	uint32_t MetadataLength;
+	uint8_t Metadata[64];
+	uint32_t Format;
+} BROKER_FRAME;
+
+//
+// Sent by the producer after connecting.  Camera is the index of the
+// camera to use, or -1 for any: the first without a feed for a feed, the
+// first with one for a layer.  BufferSize is the size of the largest frame
+// the producer will publish, frame header included.
+//
+typedef struct _BROKER_CONNECT {
+	uint32_t Size;
+	uint32_t Version;
+	int32_t Camera;
+	uint32_t Role;
+	uint32_t BufferSize;
+} BROKER_CONNECT;
+
+//
+// The broker's reply.  Status is zero if the producer was refused.
+//
+typedef struct _BROKER_CONNECTED {
+	uint32_t Size;
+	uint32_t Status;
+	int32_t Camera;
+	uint32_t ProducerId;
+	uint64_t SectionSize;
+	char SectionName[BROKER_SECTION_NAME_LENGTH];
+} BROKER_CONNECTED;
+
+//
+// The start of a producer's section.  The buffers follow at
+// BROKER_ALIGNMENT, BufferStride bytes apart.  The counters are kept by
+// the producer.
+//
+typedef struct _BROKER_SECTION_HEADER {
+	uint32_t Size;
+	uint32_t BufferSize;
+	uint32_t BufferStride;
+	uint32_t Role;
+	std::atomic<uint32_t> Middle;
+	std::atomic<uint32_t> Published;
+	std::atomic<uint32_t> Replaced;
+} BROKER_SECTION_HEADER;
+
+typedef struct _BROKER_STATISTICS {
+	uint32_t Size;
+	uint32_t Cameras;
+	uint32_t Producers;
+	uint32_t FramesPublished;
+	uint32_t FramesReplaced;
+	uint32_t FramesForwarded;
+	uint32_t FramesRejected;
+} BROKER_STATISTICS;
+
+#pragma pack(pop)
+
+//
+// BrokerSection:
+//
+// A shared memory section of a producer: a BROKER_SECTION_HEADER and the
+// frame buffers.  The broker creates it, the producer opens it by name.
+//
+class BrokerSection
+{
+private:
+#ifdef _WIN32
+	void* mappingHandle;
+#endif
+	uint8_t* view;
+	uint64_t viewSize;
+	uint32_t bufferSize;
+	uint32_t bufferStride;
+	bool owner;
+	char name[BROKER_SECTION_NAME_LENGTH];
+
+public:
+	BrokerSection();
+	~BrokerSection();
+
+	// Creates and initializes a section for buffers of bufferSize bytes.
+	bool Create(const char* name, uint32_t bufferSize, uint32_t role);
+
+	// Opens a section created by the broker and validates its header.
+	bool Open(const char* name, uint64_t size);
+	void Close();
+
+	static uint64_t GetSectionSize(uint32_t bufferSize);
+
+	uint64_t GetSize() { return viewSize; }
+	uint32_t GetBufferSize() { return bufferSize; }
+	BROKER_SECTION_HEADER* GetHeader() { return (BROKER_SECTION_HEADER*)view; }
+
+	// The layout is kept outside the section, so a producer writing over
+	// the header can't move the buffers.
+	BROKER_FRAME* GetBuffer(uint32_t index);
+};
+
+//
+// BrokerSink:
+//
+// A camera as the broker sees it.
+//
+class BrokerSink
+{
+public:
+	virtual ~BrokerSink() {}
+
+	// Hands a frame to the camera: a buffer of bufferSize bytes starting
+	// with a BROKER_FRAME.  The producer may still be writing the header,
+	// so the sink reads it once and checks the frame fits the buffer.
+	// Returns false if the camera refused the frame.
+	virtual bool SetFrame(BROKER_FRAME* frame, uint32_t bufferSize) = 0;
+};
+
+//
+// BrokerStubSink:
+//
+// A camera without a driver, to run the broker on its own for load
+// testing.  It checks each frame as the driver's sink does and copies the
+// pixels out, as the driver copies them into a capture buffer.
+//
+class BrokerStubSink : public BrokerSink
+{
+private:
+	std::vector<uint8_t> pixels;
+	std::atomic<uint32_t> framesSet;
+	int64_t timestamp;
+	uint32_t format;
+
+public:
+	// frameSize is the size of a frame's pixels, header excluded.
+	BrokerStubSink(uint32_t frameSize);
+
+	bool SetFrame(BROKER_FRAME* frame, uint32_t bufferSize);
+
+	uint32_t GetFramesSet() { return framesSet.load(); }
+
+	// The last frame set.  Only valid while the broker is stopped, or from
+	// a subclass's SetFrame.
+	const uint8_t* GetPixels() { return pixels.data(); }
+	uint32_t GetFrameSize() { return (uint32_t)pixels.size(); }
+	int64_t GetTimestamp() { return timestamp; }
+	uint32_t GetFormat() { return format; }
+};
+
+//
+// FrameBroker:
+//
+// The broker side.  Start listens for producers and starts a pacing
+// thread per camera.
+//
+class FrameBroker
+{
+private:
+	struct Producer
+	{
+		uint32_t id;
+		uint32_t role;
+		BrokerSection section;
+		uint32_t front;
+		int layer;
+	};
+
+	struct Camera
+	{
+		BrokerSink* sink;
+		std::mutex lock;
+		Producer* feed;
+		std::vector<Producer*> layers;
+		Redactor redactor;
+		Compositor compositor;
+		std::thread thread;
+		uint32_t framesForwarded;
+		uint32_t framesRejected;
+	};
+
+	struct Connection
+	{
+#ifdef _WIN32
+		void* channel;
+#else
+		int channel;
+#endif
+		std::thread thread;
+		std::atomic<bool> done;
+	};
+
+	std::vector<std::unique_ptr<Camera>> cameras;
+	uint32_t width;
+	uint32_t height;
+	int64_t framePeriod;
+
+	std::mutex lock;
+	std::vector<std::unique_ptr<Connection>> connections;
+
+	// The redactions each camera starts with.  Guarded by lock.
+	Redactor redactions;
+
+	std::atomic<uint32_t> nextId;
+	std::atomic<bool> stopping;
+	std::thread listenThread;
+
+#ifdef _WIN32
+	void* listenChannel;
+	void* stopEvent;
+#else
+	int listenChannel;
+	int stopPipe[2];
+#endif
+
+	void ListenThread();
+	void ConnectionThread(Connection* connection);
+	void CameraThread(Camera* camera);
+
+	Producer* Attach(const BROKER_CONNECT& request, BROKER_CONNECTED* reply);
+	void Detach(int cameraIndex, Producer* producer);
+	void ReapConnections(bool all);
+
+	bool ReadChannel(Connection* connection, void* data, uint32_t size);
+	bool WriteChannel(Connection* connection, const void* data, uint32_t size);
+	void CloseChannel(Connection* connection);
+
+	static bool TakeFrame(Producer* producer);
+
+public:
+	FrameBroker();
+	~FrameBroker();
+
+	// Starts brokering for cameraCount cameras of width x height, paced at
+	// framesPerSecond.  Fails if another broker is running.
+	bool Start(BrokerSink** sinks, uint32_t cameraCount, uint32_t width, uint32_t height, uint32_t framesPerSecond);
+
+	// Disconnects all producers and stops.
+	void Stop();
+
+	//
+	// Sets the rectangles redacted in every feed frame, before the layers
+	// are composited over it, as the driver interface redacts the frames
+	// it injects.  redactions is copied, and can be set before Start.  A
+	// frame which can't be redacted (of an unknown format, larger than its
+	// buffer or not the size redactions was set to) isn't forwarded.
+	// Like compositing this is done in the shared buffer, so it holds for
+	// producers which leave the broker's buffer alone.
+	//
+	void SetRedactions(const Redactor& redactions);
+
+	void GetStatistics(BROKER_STATISTICS* statistics);
+};
+
+//
+// BrokerClient:
+//
+// The producer side.
+//
+class BrokerClient
+{
+private:
+#ifdef _WIN32
+	void* channel;
+#else
+	int channel;
+#endif
+	BrokerSection section;
+	uint32_t back;
+	int camera;
+
+public:
+	BrokerClient();
+	~BrokerClient();
+
+	// Connects to the broker, see BROKER_CONNECT.
+	bool Connect(int camera, uint32_t role, uint32_t bufferSize);
+	void Disconnect();
+
+	bool IsConnected() { return section.GetHeader() != NULL; }
+	int GetCamera() { return camera; }
+
+	// The section header, with the producer's counters.
+	BROKER_SECTION_HEADER* GetHeader() { return section.GetHeader(); }
+	uint32_t GetBufferSize() { return section.GetBufferSize(); }
+
+	// The buffer to write the next frame into, header and pixels.  It
+	// belongs to the producer until Publish.
+	BROKER_FRAME* GetBuffer() { return section.GetBuffer(back); }
+
+	// Hands the buffer to the broker and takes another.  An earlier frame
+	// the broker hasn't taken yet is replaced.
+	void Publish();
+};
@@ -0,0 +1,709 @@
+#include "ChromaKey.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CHROMAKEY_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define CHROMAKEY_TARGET_AVX2
+#else
+#define CHROMAKEY_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+//
+// BT.601 full range RGB to chroma.
+//
+#define CB_R -0.168736f
+#define CB_G -0.331264f
+#define CB_B 0.5f
+#define CR_R 0.5f
+#define CR_G -0.418688f
+#define CR_B -0.081312f
+
+//
+// The chroma to RGB coefficients, for spill suppression.
+//
+#define R_CR 1.402f
+#define G_CB -0.344136f
+#define G_CR -0.714136f
+#define B_CB 1.772f
+
+//
+// BT.601 limited range, as the driver's YUV formats: luma 16 to 235 for 0
+// to 1, chroma 128 +- 112 for +- 0.5, in 8 bit units.
+//
+#define LUMA_BLACK 16.0f
+#define LUMA_RANGE (219.0f / 255.0f)
+#define CHROMA_ZERO 128.0f
+#define CHROMA_TO_FULL (255.0f / 224.0f)
+#define FULL_TO_CHROMA (224.0f / 255.0f)
+
+//
+// Softness zero keys hard, over 1/1024 of a chroma unit.
+//
+#define HARD_KEY_INVERSE_SOFTNESS 1024.0f
+
+/*
+	Span kernels
+*/
+
+static inline float Clamp(float x, float low, float high)
+{
+	return std::min(std::max(x, low), high);
+}
+
+//
+// The operations and their order match KeyOctet, so both give the same
+// bits.
+//
+static inline void KeyPixel(uint8_t* pixel, const uint8_t* background, const CHROMA_KEY_PARAMETERS* parameters)
+{
+	float b = pixel[0];
+	float g = pixel[1];
+	float r = pixel[2];
+
+	float cb = r * CB_R + g * CB_G + b * CB_B;
+	float cr = r * CR_R + g * CR_G + b * CR_B;
+
+	float distanceCb = cb - parameters->KeyCb;
+	float distanceCr = cr - parameters->KeyCr;
+	float distance = sqrtf(distanceCb * distanceCb + distanceCr * distanceCr);
+
+	float alpha = Clamp((distance - parameters->Tolerance) * parameters->InverseSoftness, 0.0f, 1.0f);
+	float spill = std::max(cb * parameters->DirectionCb + cr * parameters->DirectionCr, 0.0f);
+
+	b = Clamp(b + spill * parameters->SpillB, 0.0f, 255.0f);
+	g = Clamp(g + spill * parameters->SpillG, 0.0f, 255.0f);
+	r = Clamp(r + spill * parameters->SpillR, 0.0f, 255.0f);
+
+	float backgroundB = background[0];
+	float backgroundG = background[1];
+	float backgroundR = background[2];
+
+	pixel[0] = (uint8_t)(int32_t)(backgroundB + alpha * (b - backgroundB) + 0.5f);
+	pixel[1] = (uint8_t)(int32_t)(backgroundG + alpha * (g - backgroundG) + 0.5f);
+	pixel[2] = (uint8_t)(int32_t)(backgroundR + alpha * (r - backgroundR) + 0.5f);
+}
+
+static void ChromaKeySpanPortable(uint8_t* destination, const uint8_t* background, uint32_t pixels, uint32_t bytesPerPixel, const CHROMA_KEY_PARAMETERS* parameters)
+{
+	for (uint32_t i = 0; i < pixels; i++, destination += bytesPerPixel, background += 4)
+	{
+		KeyPixel(destination, background, parameters);
+	}
+}
+
+//
+// YCbCr samples in 8 bit units: 8 bit samples as they are, P010's 10 bit
+// samples (in the high bits of 16) divided by 4.
+//
+static inline float LoadSample(const uint8_t* sample)
+{
+	return *sample;
+}
+
+static inline float LoadSample(const uint16_t* sample)
+{
+	return *sample * (1.0f / 256.0f);
+}
+
+static inline void StoreSample(uint8_t* sample, float value)
+{
+	*sample = (uint8_t)(int32_t)(Clamp(value, 0.0f, 255.0f) + 0.5f);
+}
+
+static inline void StoreSample(uint16_t* sample, float value)
+{
+	*sample = (uint16_t)((int32_t)(Clamp(value * 4.0f, 0.0f, 1023.0f) + 0.5f) << 6);
+}
+
+//
+// The operations and their order match KeyChromaOctet, so both give the
+// same bits.  Spill is removed from the chroma alone, which leaves luma as
+// it is.
+//
+static inline void KeyChroma(float* cb, float* cr, float* alpha, float backgroundCb, float backgroundCr, const CHROMA_KEY_PARAMETERS* parameters)
+{
+	float chromaCb = (*cb - CHROMA_ZERO) * CHROMA_TO_FULL;
+	float chromaCr = (*cr - CHROMA_ZERO) * CHROMA_TO_FULL;
+
+	float distanceCb = chromaCb - parameters->KeyCb;
+	float distanceCr = chromaCr - parameters->KeyCr;
+	float distance = sqrtf(distanceCb * distanceCb + distanceCr * distanceCr);
+
+	float a = Clamp((distance - parameters->Tolerance) * parameters->InverseSoftness, 0.0f, 1.0f);
+	float spill = std::max(chromaCb * parameters->DirectionCb + chromaCr * parameters->DirectionCr, 0.0f) * parameters->SpillChroma;
+
+	chromaCb = CHROMA_ZERO + (chromaCb - spill * parameters->DirectionCb) * FULL_TO_CHROMA;
+	chromaCr = CHROMA_ZERO + (chromaCr - spill * parameters->DirectionCr) * FULL_TO_CHROMA;
+
+	*cb = backgroundCb + a * (chromaCb - backgroundCb);
+	*cr = backgroundCr + a * (chromaCr - backgroundCr);
+	*alpha = a;
+}
+
+static void ChromaKeySpanChromaPortable(float* cb, float* cr, float* alpha, const float* backgroundCb, const float* backgroundCr, uint32_t count, const CHROMA_KEY_PARAMETERS* parameters)
+{
+	for (uint32_t i = 0; i < count; i++)
+	{
+		KeyChroma(cb + i, cr + i, alpha + i, backgroundCb[i], backgroundCr[i], parameters);
+	}
+}
+
+#ifdef CHROMAKEY_X86
+
+static bool HasAvx2()
+{
+	static const bool supported = []
+	{
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+		{
+			return false;
+		}
+
+		//
+		// AVX needs OS support for the YMM state, besides the CPU's.
+		//
+		__cpuid(info, 1);
+		if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0 ||
+			(_xgetbv(0) & 6) != 6)
+		{
+			return false;
+		}
+
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") != 0;
+#endif
+	}();
+
+	return supported;
+}
+
+struct ChromaKeyAvx2
+{
+	__m256 keyCb;
+	__m256 keyCr;
+	__m256 tolerance;
+	__m256 inverseSoftness;
+	__m256 directionCb;
+	__m256 directionCr;
+	__m256 spillR;
+	__m256 spillG;
+	__m256 spillB;
+};
+
+CHROMAKEY_TARGET_AVX2
+static inline void LoadParameters(ChromaKeyAvx2* key, const CHROMA_KEY_PARAMETERS* parameters)
+{
+	key->keyCb = _mm256_set1_ps(parameters->KeyCb);
+	key->keyCr = _mm256_set1_ps(parameters->KeyCr);
+	key->tolerance = _mm256_set1_ps(parameters->Tolerance);
+	key->inverseSoftness = _mm256_set1_ps(parameters->InverseSoftness);
+	key->directionCb = _mm256_set1_ps(parameters->DirectionCb);
+	key->directionCr = _mm256_set1_ps(parameters->DirectionCr);
+	key->spillR = _mm256_set1_ps(parameters->SpillR);
+	key->spillG = _mm256_set1_ps(parameters->SpillG);
+	key->spillB = _mm256_set1_ps(parameters->SpillB);
+}
+
+//
+// Keys 8 BGRA pixels over 8 BGRA background pixels, one pixel per 32 bit
+// lane.  The alpha byte of the pixels is kept.
+//
+CHROMAKEY_TARGET_AVX2
+static inline __m256i KeyOctet(__m256i pixels, __m256i background, const ChromaKeyAvx2& key)
+{
+	const __m256i mask = _mm256_set1_epi32(0xFF);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 full = _mm256_set1_ps(255.0f);
+	const __m256 half = _mm256_set1_ps(0.5f);
+
+	__m256 b = _mm256_cvtepi32_ps(_mm256_and_si256(pixels, mask));
+	__m256 g = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(pixels, 8), mask));
+	__m256 r = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(pixels, 16), mask));
+
+	__m256 cb = _mm256_add_ps(_mm256_add_ps(
+		_mm256_mul_ps(r, _mm256_set1_ps(CB_R)), _mm256_mul_ps(g, _mm256_set1_ps(CB_G))), _mm256_mul_ps(b, _mm256_set1_ps(CB_B)));
+	__m256 cr = _mm256_add_ps(_mm256_add_ps(
+		_mm256_mul_ps(r, _mm256_set1_ps(CR_R)), _mm256_mul_ps(g, _mm256_set1_ps(CR_G))), _mm256_mul_ps(b, _mm256_set1_ps(CR_B)));
+
+	__m256 distanceCb = _mm256_sub_ps(cb, key.keyCb);
+	__m256 distanceCr = _mm256_sub_ps(cr, key.keyCr);
+	__m256 distance = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(distanceCb, distanceCb), _mm256_mul_ps(distanceCr, distanceCr)));
+
+	__m256 alpha = _mm256_min_ps(_mm256_max_ps(
+		_mm256_mul_ps(_mm256_sub_ps(distance, key.tolerance), key.inverseSoftness), zero), one);
+	__m256 spill = _mm256_max_ps(
+		_mm256_add_ps(_mm256_mul_ps(cb, key.directionCb), _mm256_mul_ps(cr, key.directionCr)), zero);
+
+	b = _mm256_min_ps(_mm256_max_ps(_mm256_add_ps(b, _mm256_mul_ps(spill, key.spillB)), zero), full);
+	g = _mm256_min_ps(_mm256_max_ps(_mm256_add_ps(g, _mm256_mul_ps(spill, key.spillG)), zero), full);
+	r = _mm256_min_ps(_mm256_max_ps(_mm256_add_ps(r, _mm256_mul_ps(spill, key.spillR)), zero), full);
+
+	__m256 backgroundB = _mm256_cvtepi32_ps(_mm256_and_si256(background, mask));
+	__m256 backgroundG = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(background, 8), mask));
+	__m256 backgroundR = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(background, 16), mask));
+
+	b = _mm256_add_ps(_mm256_add_ps(backgroundB, _mm256_mul_ps(alpha, _mm256_sub_ps(b, backgroundB))), half);
+	g = _mm256_add_ps(_mm256_add_ps(backgroundG, _mm256_mul_ps(alpha, _mm256_sub_ps(g, backgroundG))), half);
+	r = _mm256_add_ps(_mm256_add_ps(backgroundR, _mm256_mul_ps(alpha, _mm256_sub_ps(r, backgroundR))), half);
+
+	__m256i result = _mm256_or_si256(_mm256_cvttps_epi32(b), _mm256_slli_epi32(_mm256_cvttps_epi32(g), 8));
+	result = _mm256_or_si256(result, _mm256_slli_epi32(_mm256_cvttps_epi32(r), 16));
+
+	return _mm256_or_si256(result, _mm256_andnot_si256(_mm256_set1_epi32(0x00FFFFFF), pixels));
+}
+
+CHROMAKEY_TARGET_AVX2
+static void ChromaKeySpanBgraAvx2(uint8_t* destination, const uint8_t* background, uint32_t pixels, const CHROMA_KEY_PARAMETERS* parameters)
+{
+	ChromaKeyAvx2 key;
+	LoadParameters(&key, parameters);
+
+	uint32_t i = 0;
+
+	for (; i + 8 <= pixels; i += 8)
+	{
+		__m256i p = _mm256_loadu_si256((const __m256i*)(destination + i * 4));
+		__m256i b = _mm256_loadu_si256((const __m256i*)(background + i * 4));
+
+		_mm256_storeu_si256((__m256i*)(destination + i * 4), KeyOctet(p, b, key));
+	}
+
+	ChromaKeySpanPortable(destination + i * 4, background + i * 4, pixels - i, 4, parameters);
+}
+
+CHROMAKEY_TARGET_AVX2
+static void ChromaKeySpanRgb24Avx2(uint8_t* destination, const uint8_t* background, uint32_t pixels, const CHROMA_KEY_PARAMETERS* parameters)
+{
+	const __m256i expand = _mm256_setr_epi8(
+		0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+		0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+	const __m256i compact = _mm256_setr_epi8(
+		0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+		0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+	ChromaKeyAvx2 key;
+	LoadParameters(&key, parameters);
+
+	uint32_t i = 0;
+
+	//
+	// Each half is loaded as 16 bytes for its 12, so stop while the second
+	// half's load still ends within the span.
+	//
+	for (; i + 8 + 2 <= pixels; i += 8)
+	{
+		uint8_t* target = destination + i * 3;
+
+		__m256i p = _mm256_inserti128_si256(_mm256_castsi128_si256(
+			_mm_loadu_si128((const __m128i*)target)), _mm_loadu_si128((const __m128i*)(target + 12)), 1);
+		__m256i b = _mm256_loadu_si256((const __m256i*)(background + i * 4));
+
+		__m256i r = _mm256_shuffle_epi8(KeyOctet(_mm256_shuffle_epi8(p, expand), b, key), compact);
+
+		__m128i low = _mm256_castsi256_si128(r);
+		__m128i high = _mm256_extracti128_si256(r, 1);
+		int32_t tail;
+
+		_mm_storel_epi64((__m128i*)target, low);
+		tail = _mm_cvtsi128_si32(_mm_srli_si128(low, 8));
+		memcpy(target + 8, &tail, sizeof(tail));
+
+		_mm_storel_epi64((__m128i*)(target + 12), high);
+		tail = _mm_cvtsi128_si32(_mm_srli_si128(high, 8));
+		memcpy(target + 20, &tail, sizeof(tail));
+	}
+
+	ChromaKeySpanPortable(destination + i * 3, background + i * 4, pixels - i, 3, parameters);
+}
+
+CHROMAKEY_TARGET_AVX2
+static void ChromaKeySpanChromaAvx2(float* cb, float* cr, float* alpha, const float* backgroundCb, const float* backgroundCr, uint32_t count, const CHROMA_KEY_PARAMETERS* parameters)
+{
+	ChromaKeyAvx2 key;
+	LoadParameters(&key, parameters);
+
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 chromaZero = _mm256_set1_ps(CHROMA_ZERO);
+	const __m256 toFull = _mm256_set1_ps(CHROMA_TO_FULL);
+	const __m256 toChroma = _mm256_set1_ps(FULL_TO_CHROMA);
+	const __m256 spillChroma = _mm256_set1_ps(parameters->SpillChroma);
+
+	uint32_t i = 0;
+
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 chromaCb = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(cb + i), chromaZero), toFull);
+		__m256 chromaCr = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(cr + i), chromaZero), toFull);
+
+		__m256 distanceCb = _mm256_sub_ps(chromaCb, key.keyCb);
+		__m256 distanceCr = _mm256_sub_ps(chromaCr, key.keyCr);
+		__m256 distance = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(distanceCb, distanceCb), _mm256_mul_ps(distanceCr, distanceCr)));
+
+		__m256 a = _mm256_min_ps(_mm256_max_ps(
+			_mm256_mul_ps(_mm256_sub_ps(distance, key.tolerance), key.inverseSoftness), zero), one);
+		__m256 spill = _mm256_mul_ps(_mm256_max_ps(
+			_mm256_add_ps(_mm256_mul_ps(chromaCb, key.directionCb), _mm256_mul_ps(chromaCr, key.directionCr)), zero), spillChroma);
+
+		chromaCb = _mm256_add_ps(chromaZero, _mm256_mul_ps(_mm256_sub_ps(chromaCb, _mm256_mul_ps(spill, key.directionCb)), toChroma));
+		chromaCr = _mm256_add_ps(chromaZero, _mm256_mul_ps(_mm256_sub_ps(chromaCr, _mm256_mul_ps(spill, key.directionCr)), toChroma));
+
+		__m256 backgroundB = _mm256_loadu_ps(backgroundCb + i);
+		__m256 backgroundR = _mm256_loadu_ps(backgroundCr + i);
+
+		_mm256_storeu_ps(cb + i, _mm256_add_ps(backgroundB, _mm256_mul_ps(a, _mm256_sub_ps(chromaCb, backgroundB))));
+		_mm256_storeu_ps(cr + i, _mm256_add_ps(backgroundR, _mm256_mul_ps(a, _mm256_sub_ps(chromaCr, backgroundR))));
+		_mm256_storeu_ps(alpha + i, a);
+	}
+
+	ChromaKeySpanChromaPortable(cb + i, cr + i, alpha + i, backgroundCb + i, backgroundCr + i, count - i, parameters);
+}
+
+#endif // CHROMAKEY_X86
+
+void ChromaKeySpanBgra(uint8_t* destination, const uint8_t* background, uint32_t pixels, const CHROMA_KEY_PARAMETERS* parameters)
+{
+#ifdef CHROMAKEY_X86
+	if (HasAvx2())
+	{
+		ChromaKeySpanBgraAvx2(destination, background, pixels, parameters);
+		return;
+	}
+#endif
+
+	ChromaKeySpanPortable(destination, background, pixels, 4, parameters);
+}
+
+void ChromaKeySpanRgb24(uint8_t* destination, const uint8_t* background, uint32_t pixels, const CHROMA_KEY_PARAMETERS* parameters)
+{
+#ifdef CHROMAKEY_X86
+	if (HasAvx2())
+	{
+		ChromaKeySpanRgb24Avx2(destination, background, pixels, parameters);
+		return;
+	}
+#endif
+
+	ChromaKeySpanPortable(destination, background, pixels, 3, parameters);
+}
+
+void ChromaKeySpanChroma(float* cb, float* cr, float* alpha, const float* backgroundCb, const float* backgroundCr, uint32_t count, const CHROMA_KEY_PARAMETERS* parameters)
+{
+#ifdef CHROMAKEY_X86
+	if (HasAvx2())
+	{
+		ChromaKeySpanChromaAvx2(cb, cr, alpha, backgroundCb, backgroundCr, count, parameters);
+		return;
+	}
+#endif
+
+	ChromaKeySpanChromaPortable(cb, cr, alpha, backgroundCb, backgroundCr, count, parameters);
+}
+
+//
+// A row of YCbCr chroma to and from the kernel's 8 bit units, and the
+// luma samples sharing each chroma sample blended by its alpha: the two of
+// a row, or of a row pair for 4:2:0 (luma1 NULL for 4:2:2).
+//
+template <typename Sample>
+static void LoadChroma(float* cb, float* cr, const Sample* cbSamples, const Sample* crSamples, uint32_t step, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++)
+	{
+		cb[i] = LoadSample(cbSamples + i * step);
+		cr[i] = LoadSample(crSamples + i * step);
+	}
+}
+
+template <typename Sample>
+static void StoreKeyedRow(
+	Sample* luma0, Sample* luma1, uint32_t lumaStep,
+	Sample* cbSamples, Sample* crSamples, uint32_t chromaStep,
+	const float* cb, const float* cr, const float* alpha, uint32_t count,
+	const float* backgroundY0, const float* backgroundY1)
+{
+	for (uint32_t i = 0; i < count; i++)
+	{
+		StoreSample(cbSamples + i * chromaStep, cb[i]);
+		StoreSample(crSamples + i * chromaStep, cr[i]);
+
+		//
+		// Most of a frame is all foreground, whose luma is kept.
+		//
+		if (alpha[i] == 1.0f)
+		{
+			continue;
+		}
+
+		for (uint32_t x = 2 * i; x < 2 * i + 2; x++)
+		{
+			Sample* y = luma0 + x * lumaStep;
+			StoreSample(y, backgroundY0[x] + alpha[i] * (LoadSample(y) - backgroundY0[x]));
+
+			if (luma1 != NULL)
+			{
+				y = luma1 + x * lumaStep;
+				StoreSample(y, backgroundY1[x] + alpha[i] * (LoadSample(y) - backgroundY1[x]));
+			}
+		}
+	}
+}
+
+/*
+	ChromaKey
+*/
+
+ChromaKey::ChromaKey()
+	: width(0), height(0), enabled(false), backgroundColor(0), backgroundChromaRows(0)
+{
+	memset(&parameters, 0, sizeof(parameters));
+}
+
+void ChromaKey::FillBackground()
+{
+	background.resize((size_t)width * height * 4);
+	backgroundChromaRows = 0;
+
+	uint8_t pixel[4] =
+	{
+		(uint8_t)backgroundColor,
+		(uint8_t)(backgroundColor >> 8),
+		(uint8_t)(backgroundColor >> 16),
+		255
+	};
+
+	for (size_t i = 0; i < background.size(); i += 4)
+	{
+		memcpy(background.data() + i, pixel, sizeof(pixel));
+	}
+}
+
+void ChromaKey::SetSize(uint32_t width, uint32_t height)
+{
+	if (width == this->width && height == this->height)
+	{
+		return;
+	}
+
+	this->width = width;
+	this->height = height;
+
+	FillBackground();
+}
+
+bool ChromaKey::SetKey(uint32_t color, uint32_t tolerance, uint32_t softness, uint32_t spill)
+{
+	if (color > 0xFFFFFF || tolerance > 255 || softness > 255 || spill > 255)
+	{
+		return false;
+	}
+
+	float r = (float)((color >> 16) & 0xFF);
+	float g = (float)((color >> 8) & 0xFF);
+	float b = (float)(color & 0xFF);
+
+	parameters.KeyCb = r * CB_R + g * CB_G + b * CB_B;
+	parameters.KeyCr = r * CR_R + g * CR_G + b * CR_B;
+	parameters.Tolerance = (float)tolerance;
+	parameters.InverseSoftness = (softness != 0) ? 1.0f / softness : HARD_KEY_INVERSE_SOFTNESS;
+
+	//
+	// Spill is the pixel's chroma along the key's, of which the part
+	// spill / 255 is subtracted; the RGB change is that chroma change
+	// converted back, which leaves luma alone.  A gray key has no chroma
+	// to remove.
+	//
+	float length = sqrtf(parameters.KeyCb * parameters.KeyCb + parameters.KeyCr * parameters.KeyCr);
+
+	if (spill != 0 && length >= 1.0f)
+	{
+		float strength = spill / 255.0f;
+
+		parameters.DirectionCb = parameters.KeyCb / length;
+		parameters.DirectionCr = parameters.KeyCr / length;
+		parameters.SpillR = -strength * R_CR * parameters.DirectionCr;
+		parameters.SpillG = -strength * (G_CB * parameters.DirectionCb + G_CR * parameters.DirectionCr);
+		parameters.SpillB = -strength * B_CB * parameters.DirectionCb;
+		parameters.SpillChroma = strength;
+	}
+	else
+	{
+		parameters.DirectionCb = parameters.DirectionCr = 0.0f;
+		parameters.SpillR = parameters.SpillG = parameters.SpillB = 0.0f;
+		parameters.SpillChroma = 0.0f;
+	}
+
+	enabled = true;
+
+	return true;
+}
+
+void ChromaKey::Disable()
+{
+	enabled = false;
+}
+
+void ChromaKey::SetBackgroundColor(uint32_t color)
+{
+	backgroundColor = color;
+
+	FillBackground();
+}
+
+bool ChromaKey::SetBackgroundImage(const uint8_t* data, int32_t stride, uint32_t width, uint32_t height)
+{
+	if (data == NULL || width != this->width || height != this->height)
+	{
+		return false;
+	}
+
+	for (uint32_t y = 0; y < height; y++)
+	{
+		memcpy(background.data() + (size_t)y * width * 4, data + (int64_t)stride * y, (size_t)width * 4);
+	}
+
+	backgroundChromaRows = 0;
+
+	return true;
+}
+
+void ChromaKey::ConvertBackground(uint32_t chromaRows)
+{
+	uint32_t chromaWidth = width / 2;
+	uint32_t chromaHeight = height / chromaRows;
+
+	backgroundY.resize((size_t)width * height);
+	backgroundCb.resize((size_t)chromaWidth * chromaHeight);
+	backgroundCr.resize((size_t)chromaWidth * chromaHeight);
+
+	for (size_t i = 0; i < backgroundY.size(); i++)
+	{
+		const uint8_t* pixel = background.data() + i * 4;
+
+		backgroundY[i] = LUMA_BLACK + LUMA_RANGE * (pixel[2] * 0.299f + pixel[1] * 0.587f + pixel[0] * 0.114f);
+	}
+
+	for (uint32_t y = 0; y < chromaHeight; y++)
+	{
+		for (uint32_t x = 0; x < chromaWidth; x++)
+		{
+			float b = 0.0f;
+			float g = 0.0f;
+			float r = 0.0f;
+
+			for (uint32_t row = y * chromaRows; row < (y + 1) * chromaRows; row++)
+			{
+				const uint8_t* pixel = background.data() + ((size_t)row * width + 2 * x) * 4;
+
+				b += pixel[0] + pixel[4];
+				g += pixel[1] + pixel[5];
+				r += pixel[2] + pixel[6];
+			}
+
+			float scale = 1.0f / (2 * chromaRows);
+			size_t index = (size_t)y * chromaWidth + x;
+
+			b *= scale;
+			g *= scale;
+			r *= scale;
+
+			backgroundCb[index] = CHROMA_ZERO + FULL_TO_CHROMA * (r * CB_R + g * CB_G + b * CB_B);
+			backgroundCr[index] = CHROMA_ZERO + FULL_TO_CHROMA * (r * CR_R + g * CR_G + b * CR_B);
+		}
+	}
+
+	backgroundChromaRows = chromaRows;
+}
+
+void ChromaKey::Apply(uint8_t* frame, int32_t stride, uint32_t bytesPerPixel)
+{
+	if (!enabled)
+	{
+		return;
+	}
+
+	void (*keySpan)(uint8_t*, const uint8_t*, uint32_t, const CHROMA_KEY_PARAMETERS*) =
+		(bytesPerPixel == 4) ? ChromaKeySpanBgra : ChromaKeySpanRgb24;
+
+	for (uint32_t y = 0; y < height; y++)
+	{
+		keySpan(
+			frame + (int64_t)stride * y,
+			background.data() + (size_t)y * width * 4,
+			width,
+			&parameters);
+	}
+}
+
+void ChromaKey::ApplyYuv(
+	uint8_t* luma, int32_t lumaStride, uint32_t lumaStep,
+	uint8_t* cb, uint8_t* cr, int32_t chromaStride, uint32_t chromaStep,
+	uint32_t chromaRows, uint32_t sampleBytes)
+{
+	if (!enabled || (chromaRows != 1 && chromaRows != 2))
+	{
+		return;
+	}
+
+	if (backgroundChromaRows != chromaRows)
+	{
+		ConvertBackground(chromaRows);
+	}
+
+	uint32_t chromaWidth = width / 2;
+
+	rowCb.resize(chromaWidth);
+	rowCr.resize(chromaWidth);
+	rowAlpha.resize(chromaWidth);
+
+	for (uint32_t y = 0; y < height / chromaRows; y++)
+	{
+		uint8_t* row0 = luma + (int64_t)lumaStride * y * chromaRows;
+		uint8_t* row1 = (chromaRows == 2) ? row0 + lumaStride : NULL;
+		uint8_t* rowCbSamples = cb + (int64_t)chromaStride * y;
+		uint8_t* rowCrSamples = cr + (int64_t)chromaStride * y;
+		const float* backgroundY0 = backgroundY.data() + (size_t)y * chromaRows * width;
+		const float* backgroundY1 = backgroundY0 + width;
+		const float* rowBackgroundCb = backgroundCb.data() + (size_t)y * chromaWidth;
+		const float* rowBackgroundCr = backgroundCr.data() + (size_t)y * chromaWidth;
+
+		if (sampleBytes == 2)
+		{
+			LoadChroma<uint16_t>(rowCb.data(), rowCr.data(), (const uint16_t*)rowCbSamples, (const uint16_t*)rowCrSamples, chromaStep, chromaWidth);
+		}
+		else
+		{
+			LoadChroma<uint8_t>(rowCb.data(), rowCr.data(), rowCbSamples, rowCrSamples, chromaStep, chromaWidth);
+		}
+
+		ChromaKeySpanChroma(rowCb.data(), rowCr.data(), rowAlpha.data(), rowBackgroundCb, rowBackgroundCr, chromaWidth, &parameters);
+
+		if (sampleBytes == 2)
+		{
+			StoreKeyedRow<uint16_t>(
+				(uint16_t*)row0, (uint16_t*)row1, lumaStep, (uint16_t*)rowCbSamples, (uint16_t*)rowCrSamples, chromaStep,
+				rowCb.data(), rowCr.data(), rowAlpha.data(), chromaWidth, backgroundY0, backgroundY1);
+		}
+		else
+		{
+			StoreKeyedRow<uint8_t>(
+				row0, row1, lumaStep, rowCbSamples, rowCrSamples, chromaStep,
+				rowCb.data(), rowCr.data(), rowAlpha.data(), chromaWidth, backgroundY0, backgroundY1);
+		}
+	}
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+//
+// Chroma key.
+//
+// Replaces the pixels of a frame close to a key color (a green or blue
+// screen) with a background image or color.  Keying is done in the CbCr
+// plane of BT.601 YCbCr: a pixel's alpha ramps from 0 (background) to 1
+// (foreground) as the distance of its chroma from the key's goes from the
+// tolerance to the tolerance plus the softness, so lighting changes over
+// the screen, which mostly change luma, don't matter.  Spill suppression
+// removes part of the key's chroma from the foreground (the green fringe
+// on hair and edges) without changing its luma.
+//
+// YCbCr frames (BT.601 limited range, like the driver's YUV formats) are
+// keyed on their chroma samples as they are, without converting them to
+// RGB: each chroma sample's alpha applies to the luma samples sharing it,
+// so 4:2:0 frames key a quarter of the samples RGB frames do.
+//
+// The span kernels at the bottom don't allocate and don't depend on the
+// standard library.  An AVX2 version is picked at run time on x86 and
+// x64; it is bit exact with the portable version.
+//
+
+#include <stdint.h>
+
+#include <vector>
+
+//
+// The key as the span kernels use it, see ChromaKey::SetKey.  Chroma is in
+// 8 bit units, -127.5 to 127.5.
+//
+typedef struct _CHROMA_KEY_PARAMETERS {
+	float KeyCb;
+	float KeyCr;
+	float Tolerance;
+	float InverseSoftness;
+
+	// The unit vector of the key's chroma, and the change of R, G and B
+	// per unit of a pixel's chroma along it.  Zero without spill
+	// suppression.
+	float DirectionCb;
+	float DirectionCr;
+	float SpillR;
+	float SpillG;
+	float SpillB;
+
+	// The part of a pixel's chroma along the key's removed, for YCbCr
+	// pixels.
+	float SpillChroma;
+} CHROMA_KEY_PARAMETERS;
+
+class ChromaKey
+{
+private:
+	uint32_t width;
+	uint32_t height;
+	bool enabled;
+	CHROMA_KEY_PARAMETERS parameters;
+
+	// width * height BGRA; the image or the color.
+	std::vector<uint8_t> background;
+	uint32_t backgroundColor;
+
+	//
+	// The background in YCbCr, in 8 bit units: luma per pixel, chroma
+	// averaged over the pixels sharing a chroma sample.  Converted when
+	// first needed, for chroma shared by backgroundChromaRows rows; 0 if
+	// not converted.
+	//
+	std::vector<float> backgroundY;
+	std::vector<float> backgroundCb;
+	std::vector<float> backgroundCr;
+	uint32_t backgroundChromaRows;
+
+	// A row of chroma samples and their alpha, for the span kernel.
+	std::vector<float> rowCb;
+	std::vector<float> rowCr;
+	std::vector<float> rowAlpha;
+
+	void FillBackground();
+	void ConvertBackground(uint32_t chromaRows);
+
+public:
+	ChromaKey();
+
+	// Sets the frame size.  A background image is dropped for the color.
+	void SetSize(uint32_t width, uint32_t height);
+
+	// Turns keying on.  color is 0xRRGGBB.  tolerance and softness are
+	// chroma distances, 0 to 255; spill is the part of the key's chroma
+	// removed from the foreground, 0 (none) to 255 (all).
+	bool SetKey(uint32_t color, uint32_t tolerance, uint32_t softness, uint32_t spill);
+	void Disable();
+	bool IsEnabled() { return enabled; }
+
+	// Replaces the keyed out pixels with a color, 0xRRGGBB.
+	void SetBackgroundColor(uint32_t color);
+
+	// Replaces the keyed out pixels with a BGRA image of the frame size.
+	// Its alpha is ignored.
+	bool SetBackgroundImage(const uint8_t* data, int32_t stride, uint32_t width, uint32_t height);
+
+	// Keys a top-down frame of the size set with SetSize.  bytesPerPixel is
+	// 3 for RGB24 (BGR in memory) or 4 for BGRA, whose alpha is kept.
+	void Apply(uint8_t* frame, int32_t stride, uint32_t bytesPerPixel);
+
+	//
+	// Keys a top-down YCbCr frame of the size set with SetSize, whose width
+	// and height must be even.  Chroma is subsampled by 2 horizontally and
+	// by chromaRows (2 for 4:2:0, 1 for 4:2:2) vertically.  Strides are in
+	// bytes; lumaStep and chromaStep are the samples between a row's luma
+	// and chroma samples (1 and 2 for NV12 and P010, 1 and 1 for I420, 2
+	// and 4 for YUY2).  Samples are 8 bit, or 16 bit with 10 significant
+	// high bits (P010) if sampleBytes is 2.
+	//
+	void ApplyYuv(
+		uint8_t* luma, int32_t lumaStride, uint32_t lumaStep,
+		uint8_t* cb, uint8_t* cr, int32_t chromaStride, uint32_t chromaStep,
+		uint32_t chromaRows, uint32_t sampleBytes);
+};
+
+//
+// Span kernels.  background is BGRA.
+//
+
+// Keys BGRA pixels.
+void ChromaKeySpanBgra(uint8_t* destination, const uint8_t* background, uint32_t pixels, const CHROMA_KEY_PARAMETERS* parameters);
+
+// Keys BGR (RGB24) pixels.
+void ChromaKeySpanRgb24(uint8_t* destination, const uint8_t* background, uint32_t pixels, const CHROMA_KEY_PARAMETERS* parameters);
+
+// Keys YCbCr chroma samples, Cb and Cr in 8 bit units of limited range:
+// each is replaced with the keyed chroma blended over the background's,
+// and its alpha returned.
+void ChromaKeySpanChroma(float* cb, float* cr, float* alpha, const float* backgroundCb, const float* backgroundCr, uint32_t count, const CHROMA_KEY_PARAMETERS* parameters);
@@ -0,0 +1,537 @@
+#include "Compositor.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define COMPOSITOR_X86
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define COMPOSITOR_TARGET_SSE2
+#define COMPOSITOR_TARGET_SSSE3
+#else
+#include <cpuid.h>
+#define COMPOSITOR_TARGET_SSE2 __attribute__((target("sse2")))
+#define COMPOSITOR_TARGET_SSSE3 __attribute__((target("ssse3")))
+#endif
+#endif
+
+/*
+	Span kernels
+*/
+
+//
+// x / 255 rounded to nearest, exact for x <= 255 * 255.
+//
+static inline uint32_t Div255(uint32_t x)
+{
+	x += 128;
+	return (x + (x >> 8)) >> 8;
+}
+
+//
+// a + b clamped to 255.  Only matters for images which aren't properly
+// pre-multiplied.
+//
+static inline uint8_t AddSaturate(uint32_t a, uint32_t b)
+{
+	return (uint8_t)std::min<uint32_t>(a + b, 255);
+}
+
+static void CompositeSpanBgraPortable(uint8_t* destination, const uint8_t* source, uint32_t pixels)
+{
+	for (uint32_t i = 0; i < pixels; i++, destination += 4, source += 4)
+	{
+		uint32_t inverse = 255 - source[3];
+
+		if (inverse == 255)
+		{
+			continue;
+		}
+
+		destination[0] = AddSaturate(source[0], Div255(destination[0] * inverse));
+		destination[1] = AddSaturate(source[1], Div255(destination[1] * inverse));
+		destination[2] = AddSaturate(source[2], Div255(destination[2] * inverse));
+		destination[3] = AddSaturate(source[3], Div255(destination[3] * inverse));
+	}
+}
+
+static void CompositeSpanRgb24Portable(uint8_t* destination, const uint8_t* source, uint32_t pixels)
+{
+	for (uint32_t i = 0; i < pixels; i++, destination += 3, source += 4)
+	{
+		uint32_t inverse = 255 - source[3];
+
+		if (inverse == 255)
+		{
+			continue;
+		}
+
+		destination[0] = AddSaturate(source[0], Div255(destination[0] * inverse));
+		destination[1] = AddSaturate(source[1], Div255(destination[1] * inverse));
+		destination[2] = AddSaturate(source[2], Div255(destination[2] * inverse));
+	}
+}
+
+#ifdef COMPOSITOR_X86
+
+static bool HasSsse3()
+{
+	static const bool supported = []
+	{
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 1);
+		return (info[2] & (1 << 9)) != 0;
+#else
+		unsigned int eax, ebx, ecx, edx;
+		return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_SSSE3) != 0;
+#endif
+	}();
+
+	return supported;
+}
+
+static bool HasSse2()
+{
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	return true;
+#else
+	static const bool supported = []
+	{
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 1);
+		return (info[3] & (1 << 26)) != 0;
+#else
+		unsigned int eax, ebx, ecx, edx;
+		return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (edx & bit_SSE2) != 0;
+#endif
+	}();
+
+	return supported;
+#endif
+}
+
+//
+// Blends 4 pre-multiplied BGRA pixels over 4 pixels of the same layout.
+// The destination alpha may be garbage; it only affects its own lane.
+//
+COMPOSITOR_TARGET_SSE2
+static inline __m128i CompositeQuad(__m128i destination, __m128i source)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i full = _mm_set1_epi16(255);
+	const __m128i round = _mm_set1_epi16(128);
+
+	__m128i sourceLow = _mm_unpacklo_epi8(source, zero);
+	__m128i sourceHigh = _mm_unpackhi_epi8(source, zero);
+
+	__m128i inverseLow = _mm_sub_epi16(full,
+		_mm_shufflehi_epi16(_mm_shufflelo_epi16(sourceLow, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3)));
+	__m128i inverseHigh = _mm_sub_epi16(full,
+		_mm_shufflehi_epi16(_mm_shufflelo_epi16(sourceHigh, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3)));
+
+	__m128i low = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(destination, zero), inverseLow), round);
+	__m128i high = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(destination, zero), inverseHigh), round);
+
+	low = _mm_srli_epi16(_mm_add_epi16(low, _mm_srli_epi16(low, 8)), 8);
+	high = _mm_srli_epi16(_mm_add_epi16(high, _mm_srli_epi16(high, 8)), 8);
+
+	return _mm_adds_epu8(source, _mm_packus_epi16(low, high));
+}
+
+COMPOSITOR_TARGET_SSE2
+static void CompositeSpanBgraSse2(uint8_t* destination, const uint8_t* source, uint32_t pixels)
+{
+	uint32_t i = 0;
+
+	for (; i + 4 <= pixels; i += 4)
+	{
+		__m128i s = _mm_loadu_si128((const __m128i*)(source + i * 4));
+
+		//
+		// Skip fully transparent quads; most of a typical overlay canvas.
+		//
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(s, _mm_setzero_si128())) == 0xFFFF)
+		{
+			continue;
+		}
+
+		__m128i d = _mm_loadu_si128((const __m128i*)(destination + i * 4));
+		_mm_storeu_si128((__m128i*)(destination + i * 4), CompositeQuad(d, s));
+	}
+
+	CompositeSpanBgraPortable(destination + i * 4, source + i * 4, pixels - i);
+}
+
+COMPOSITOR_TARGET_SSSE3
+static void CompositeSpanRgb24Ssse3(uint8_t* destination, const uint8_t* source, uint32_t pixels)
+{
+	const __m128i expand = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+	const __m128i compact = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+	uint32_t i = 0;
+
+	for (; i + 4 <= pixels; i += 4)
+	{
+		__m128i s = _mm_loadu_si128((const __m128i*)(source + i * 4));
+
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(s, _mm_setzero_si128())) == 0xFFFF)
+		{
+			continue;
+		}
+
+		//
+		// Load exactly the 12 bytes of the 4 destination pixels so the last
+		// quad of a row never reads past it.
+		//
+		uint8_t* target = destination + i * 3;
+		int32_t tail;
+		memcpy(&tail, target + 8, sizeof(tail));
+
+		__m128i d = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)target), _mm_cvtsi32_si128(tail));
+		__m128i r = _mm_shuffle_epi8(CompositeQuad(_mm_shuffle_epi8(d, expand), s), compact);
+
+		_mm_storel_epi64((__m128i*)target, r);
+		tail = _mm_cvtsi128_si32(_mm_srli_si128(r, 8));
+		memcpy(target + 8, &tail, sizeof(tail));
+	}
+
+	CompositeSpanRgb24Portable(destination + i * 3, source + i * 4, pixels - i);
+}
+
+#endif // COMPOSITOR_X86
+
+void CompositeSpanBgra(uint8_t* destination, const uint8_t* source, uint32_t pixels)
+{
+#ifdef COMPOSITOR_X86
+	if (HasSse2())
+	{
+		CompositeSpanBgraSse2(destination, source, pixels);
+		return;
+	}
+#endif
+
+	CompositeSpanBgraPortable(destination, source, pixels);
+}
+
+void CompositeSpanRgb24(uint8_t* destination, const uint8_t* source, uint32_t pixels)
+{
+#ifdef COMPOSITOR_X86
+	if (HasSsse3())
+	{
+		CompositeSpanRgb24Ssse3(destination, source, pixels);
+		return;
+	}
+#endif
+
+	CompositeSpanRgb24Portable(destination, source, pixels);
+}
+
+/*
+	Compositor
+*/
+
+Compositor::Compositor()
+	: width(0), height(0), nextId(1)
+{
+	dirty.left = dirty.top = dirty.right = dirty.bottom = 0;
+}
+
+Compositor::Layer* Compositor::FindLayer(int id)
+{
+	for (Layer& layer : layers)
+	{
+		if (layer.id == id)
+		{
+			return &layer;
+		}
+	}
+
+	return NULL;
+}
+
+Compositor::Rect Compositor::GetLayerRect(const Layer& layer)
+{
+	Rect rect;
+	rect.left = layer.x;
+	rect.top = layer.y;
+	rect.right = layer.x + (int)layer.width;
+	rect.bottom = layer.y + (int)layer.height;
+	return rect;
+}
+
+void Compositor::Invalidate(const Rect& rect)
+{
+	if (rect.left >= rect.right || rect.top >= rect.bottom)
+	{
+		return;
+	}
+
+	if (dirty.left >= dirty.right || dirty.top >= dirty.bottom)
+	{
+		dirty = rect;
+		return;
+	}
+
+	dirty.left = std::min(dirty.left, rect.left);
+	dirty.top = std::min(dirty.top, rect.top);
+	dirty.right = std::max(dirty.right, rect.right);
+	dirty.bottom = std::max(dirty.bottom, rect.bottom);
+}
+
+void Compositor::SortLayers()
+{
+	std::stable_sort(layers.begin(), layers.end(), [](const Layer& a, const Layer& b)
+	{
+		return a.zOrder < b.zOrder;
+	});
+}
+
+void Compositor::SetSize(uint32_t width, uint32_t height)
+{
+	if (width == this->width && height == this->height)
+	{
+		return;
+	}
+
+	this->width = width;
+	this->height = height;
+
+	canvas.assign((size_t)width * height * 4, 0);
+	coverageLeft.assign(height, 0);
+	coverageRight.assign(height, 0);
+
+	Rect all = { 0, 0, (int)width, (int)height };
+	Invalidate(all);
+}
+
+int Compositor::AddLayer()
+{
+	Layer layer;
+	layer.id = nextId++;
+	layer.x = 0;
+	layer.y = 0;
+	layer.width = 0;
+	layer.height = 0;
+	layer.zOrder = layers.empty() ? 0 : layers.back().zOrder + 1;
+	layer.visible = true;
+
+	layers.push_back(layer);
+
+	return layer.id;
+}
+
+bool Compositor::RemoveLayer(int id)
+{
+	for (size_t i = 0; i < layers.size(); i++)
+	{
+		if (layers[i].id == id)
+		{
+			Invalidate(GetLayerRect(layers[i]));
+			layers.erase(layers.begin() + i);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool Compositor::SetLayerImage(int id, const uint8_t* data, int32_t stride, uint32_t width, uint32_t height, bool premultiplied)
+{
+	Layer* layer = FindLayer(id);
+	if (layer == NULL || (data == NULL && width != 0 && height != 0))
+	{
+		return false;
+	}
+
+	Invalidate(GetLayerRect(*layer));
+
+	layer->width = width;
+	layer->height = height;
+	layer->pixels.resize((size_t)width * height * 4);
+
+	for (uint32_t y = 0; y < height; y++)
+	{
+		const uint8_t* sourceRow = data + (int64_t)stride * y;
+		uint8_t* targetRow = layer->pixels.data() + (size_t)y * width * 4;
+
+		if (premultiplied)
+		{
+			memcpy(targetRow, sourceRow, (size_t)width * 4);
+			continue;
+		}
+
+		for (uint32_t x = 0; x < width; x++)
+		{
+			uint32_t alpha = sourceRow[x * 4 + 3];
+
+			targetRow[x * 4 + 0] = (uint8_t)Div255(sourceRow[x * 4 + 0] * alpha);
+			targetRow[x * 4 + 1] = (uint8_t)Div255(sourceRow[x * 4 + 1] * alpha);
+			targetRow[x * 4 + 2] = (uint8_t)Div255(sourceRow[x * 4 + 2] * alpha);
+			targetRow[x * 4 + 3] = (uint8_t)alpha;
+		}
+	}
+
+	Invalidate(GetLayerRect(*layer));
+
+	return true;
+}
+
+bool Compositor::SetLayerPosition(int id, int x, int y)
+{
+	Layer* layer = FindLayer(id);
+	if (layer == NULL)
+	{
+		return false;
+	}
+
+	if (layer->x != x || layer->y != y)
+	{
+		Invalidate(GetLayerRect(*layer));
+		layer->x = x;
+		layer->y = y;
+		Invalidate(GetLayerRect(*layer));
+	}
+
+	return true;
+}
+
+bool Compositor::SetLayerZOrder(int id, int zOrder)
+{
+	Layer* layer = FindLayer(id);
+	if (layer == NULL)
+	{
+		return false;
+	}
+
+	if (layer->zOrder != zOrder)
+	{
+		layer->zOrder = zOrder;
+		Invalidate(GetLayerRect(*layer));
+		SortLayers();
+	}
+
+	return true;
+}
+
+bool Compositor::SetLayerVisible(int id, bool visible)
+{
+	Layer* layer = FindLayer(id);
+	if (layer == NULL)
+	{
+		return false;
+	}
+
+	if (layer->visible != visible)
+	{
+		layer->visible = visible;
+		Invalidate(GetLayerRect(*layer));
+	}
+
+	return true;
+}
+
+bool Compositor::IsEmpty()
+{
+	for (const Layer& layer : layers)
+	{
+		if (layer.visible && layer.width != 0 && layer.height != 0)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+//
+// Rebuilds the dirty part of the canvas from the layers.
+//
+void Compositor::Flatten()
+{
+	Rect area;
+	area.left = std::max(dirty.left, 0);
+	area.top = std::max(dirty.top, 0);
+	area.right = std::min(dirty.right, (int)width);
+	area.bottom = std::min(dirty.bottom, (int)height);
+
+	dirty.left = dirty.top = dirty.right = dirty.bottom = 0;
+
+	if (area.left >= area.right || area.top >= area.bottom)
+	{
+		return;
+	}
+
+	for (int y = area.top; y < area.bottom; y++)
+	{
+		memset(canvas.data() + ((size_t)y * width + area.left) * 4, 0, (size_t)(area.right - area.left) * 4);
+
+		coverageLeft[y] = width;
+		coverageRight[y] = 0;
+	}
+
+	for (const Layer& layer : layers)
+	{
+		if (!layer.visible)
+		{
+			continue;
+		}
+
+		Rect rect = GetLayerRect(layer);
+
+		int top = std::max(rect.top, area.top);
+		int bottom = std::min(rect.bottom, area.bottom);
+		int left = std::max(rect.left, area.left);
+		int right = std::min(rect.right, area.right);
+
+		//
+		// Coverage is tracked for the whole layer row, not just the dirty
+		// part of it, since the rows are recomputed from scratch.
+		//
+		uint32_t coveredLeft = (uint32_t)std::max(rect.left, 0);
+		uint32_t coveredRight = (uint32_t)std::max(std::min(rect.right, (int)width), 0);
+
+		for (int y = top; y < bottom; y++)
+		{
+			if (left < right)
+			{
+				CompositeSpanBgra(
+					canvas.data() + ((size_t)y * width + left) * 4,
+					layer.pixels.data() + ((size_t)(y - rect.top) * layer.width + (left - rect.left)) * 4,
+					(uint32_t)(right - left));
+			}
+
+			if (coveredLeft < coveredRight)
+			{
+				coverageLeft[y] = std::min(coverageLeft[y], coveredLeft);
+				coverageRight[y] = std::max(coverageRight[y], coveredRight);
+			}
+		}
+	}
+}
+
+void Compositor::Apply(uint8_t* frame, int32_t stride, uint32_t bytesPerPixel)
+{
+	Flatten();
+
+	void (*compositeSpan)(uint8_t*, const uint8_t*, uint32_t) =
+		(bytesPerPixel == 4) ? CompositeSpanBgra : CompositeSpanRgb24;
+
+	for (uint32_t y = 0; y < height; y++)
+	{
+		if (coverageRight[y] <= coverageLeft[y])
+		{
+			continue;
+		}
+
+		compositeSpan(
+			frame + (int64_t)stride * y + coverageLeft[y] * bytesPerPixel,
+			canvas.data() + ((size_t)y * width + coverageLeft[y]) * 4,
+			coverageRight[y] - coverageLeft[y]);
+	}
+}
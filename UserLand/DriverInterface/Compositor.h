@@ -0,0 +1,102 @@
+#pragma once
+
+//
+// Layer compositor.
+//
+// Layers are BGRA images with pre-multiplied alpha (the memory layout of
+// GDI+ PixelFormat32bppPArgb) placed at a position and z-order over the
+// frame.  The visible layers are flattened into one pre-multiplied canvas
+// which is only rebuilt where a layer changed, so compositing a frame is a
+// single blend of the canvas over the rows and columns layers cover,
+// whatever the number of layers.
+//
+// The span kernels at the bottom don't allocate and don't depend on the
+// standard library.  SSE2 and SSSE3 versions are picked at run time on x86
+// and x64; other targets use the portable versions.
+//
+
+#include <stdint.h>
+
+#include <vector>
+
+class Compositor
+{
+private:
+	struct Layer
+	{
+		int id;
+		int x;
+		int y;
+		uint32_t width;
+		uint32_t height;
+		int zOrder;
+		bool visible;
+		std::vector<uint8_t> pixels;
+	};
+
+	struct Rect
+	{
+		int left;
+		int top;
+		int right;
+		int bottom;
+	};
+
+	uint32_t width;
+	uint32_t height;
+
+	// Sorted by z-order, bottom first.
+	std::vector<Layer> layers;
+	int nextId;
+
+	// The flattened layers, width * height pre-multiplied BGRA.
+	std::vector<uint8_t> canvas;
+
+	// Per canvas row, the columns [left, right) any visible layer covers.
+	std::vector<uint32_t> coverageLeft;
+	std::vector<uint32_t> coverageRight;
+
+	// The canvas area which must be rebuilt before the next Apply.
+	Rect dirty;
+
+	Layer* FindLayer(int id);
+	Rect GetLayerRect(const Layer& layer);
+	void Invalidate(const Rect& rect);
+	void SortLayers();
+	void Flatten();
+
+public:
+	Compositor();
+
+	// Sets the frame size.  Layers are kept.
+	void SetSize(uint32_t width, uint32_t height);
+
+	// Adds an empty, visible layer on top and returns its id.
+	int AddLayer();
+	bool RemoveLayer(int id);
+
+	// Replaces the image of a layer.  data is BGRA; if premultiplied is
+	// false the color is multiplied by alpha on the way in.
+	bool SetLayerImage(int id, const uint8_t* data, int32_t stride, uint32_t width, uint32_t height, bool premultiplied);
+	bool SetLayerPosition(int id, int x, int y);
+	bool SetLayerZOrder(int id, int zOrder);
+	bool SetLayerVisible(int id, bool visible);
+
+	// True if there is nothing to composite.
+	bool IsEmpty();
+
+	// Composites the layers over a top-down frame of the size set with
+	// SetSize.  bytesPerPixel is 3 for RGB24 (BGR in memory) or 4 for BGRA.
+	void Apply(uint8_t* frame, int32_t stride, uint32_t bytesPerPixel);
+};
+
+//
+// Span kernels.  All pixels are pre-multiplied; "over" is
+// dst = src + dst * (255 - src alpha) / 255 with exact rounding.
+//
+
+// BGRA over BGRA.
+void CompositeSpanBgra(uint8_t* destination, const uint8_t* source, uint32_t pixels);
+
+// BGRA over BGR (RGB24).
+void CompositeSpanRgb24(uint8_t* destination, const uint8_t* source, uint32_t pixels);
@@ -50,5 +50,130 @@ int Device::SetData(PVOID dataPointer, ULONG dataLength)
 
 	HRESULT hr = propertySet->Set(GUID_PROP_CLASS, PROP_DATA_ID, NULL, 0, dataPointer, dataLength);
 
+	return SUCCEEDED(hr);
+}
+
+int Device::SetFrame(PFRAME_HEADER frame, ULONG dataLength)
+{
+	if (dataLength == 0 || dataLength > MAX_FRAME_SIZE)
+	{
+		return -1;
+	}
+
+	HRESULT hr = propertySet->Set(GUID_PROP_CLASS, PROP_FRAME_ID, NULL, 0, frame, sizeof(FRAME_HEADER) + dataLength);
+
+	return SUCCEEDED(hr);
+}
+
+int Device::SetFrcMode(ULONG mode)
+{
+	if (mode > FRC_MODE_BLEND)
+	{
+		return -1;
+	}
+
+	HRESULT hr = propertySet->Set(GUID_PROP_CLASS, PROP_FRC_MODE_ID, NULL, 0, &mode, sizeof(mode));
+
+	return SUCCEEDED(hr);
+}
+
+int Device::GetStatistics(PSTATISTICS statistics)
+{
+	DWORD returned = 0;
+
+	HRESULT hr = propertySet->Get(GUID_PROP_CLASS, PROP_STATISTICS_ID, NULL, 0, statistics, sizeof(STATISTICS), &returned);
+
+	return SUCCEEDED(hr) && returned == sizeof(STATISTICS);
+}
+
+int Device::SetLatencyProbe(ULONG enable)
+{
+	HRESULT hr = propertySet->Set(GUID_PROP_CLASS, PROP_LATENCY_PROBE_ID, NULL, 0, &enable, sizeof(enable));
+
+	return SUCCEEDED(hr);
+}
+
+int Device::SetStaging(ULONG mode)
+{
+	if (mode > STAGING_NV12)
+	{
+		return -1;
+	}
+
+	HRESULT hr = propertySet->Set(GUID_PROP_CLASS, PROP_STAGING_ID, NULL, 0, &mode, sizeof(mode));
+
+	return SUCCEEDED(hr);
+}
+
+int Device::SetSlate(PSLATE_HEADER slate, ULONG dataLength)
+{
+	HRESULT hr = propertySet->Set(GUID_PROP_CLASS, PROP_SLATE_ID, NULL, 0, slate, sizeof(SLATE_HEADER) + dataLength);
+
+	return SUCCEEDED(hr);
+}
+
+int Device::SetNoSignalTimeout(ULONG timeout)
+{
+	HRESULT hr = propertySet->Set(GUID_PROP_CLASS, PROP_NO_SIGNAL_TIMEOUT_ID, NULL, 0, &timeout, sizeof(timeout));
+
+	return SUCCEEDED(hr);
+}
+
+int Device::SetTrace(ULONG enable)
+{
+	HRESULT hr = propertySet->Set(GUID_PROP_CLASS, PROP_TRACE_ID, NULL, 0, &enable, sizeof(enable));
+
+	return SUCCEEDED(hr);
+}
+
+int Device::GetTrace(PTRACE_DUMP dump, ULONG length, PULONG returned)
+{
+	DWORD bytes = 0;
+
+	HRESULT hr = propertySet->Get(GUID_PROP_CLASS, PROP_TRACE_ID, NULL, 0, dump, length, &bytes);
+
+	*returned = bytes;
+
+	return SUCCEEDED(hr) && bytes >= sizeof(TRACE_DUMP);
+}
+
+int Device::SetCaptureMode(ULONG mode)
+{
+	if (mode > CAPTURE_COPY)
+	{
+		return -1;
+	}
+
+	HRESULT hr = propertySet->Set(GUID_PROP_CLASS, PROP_CAPTURE_MODE_ID, NULL, 0, &mode, sizeof(mode));
+
+	return SUCCEEDED(hr);
+}
+
+int Device::SetTimestampMode(ULONG mode)
+{
+	if (mode > TIMESTAMP_SCHEDULE)
+	{
+		return -1;
+	}
+
+	HRESULT hr = propertySet->Set(GUID_PROP_CLASS, PROP_TIMESTAMP_MODE_ID, NULL, 0, &mode, sizeof(mode));
+
+	return SUCCEEDED(hr);
+}
+
+int Device::SetOutputDelay(ULONG delay, ULONG budget)
+{
+	if (delay > OUTPUT_DELAY_MAX)
+	{
+		return -1;
+	}
+
+	OUTPUT_DELAY outputDelay = {};
+	outputDelay.Size = sizeof(OUTPUT_DELAY);
+	outputDelay.Delay = delay;
+	outputDelay.MemoryBudget = budget;
+
+	HRESULT hr = propertySet->Set(GUID_PROP_CLASS, PROP_OUTPUT_DELAY_ID, NULL, 0, &outputDelay, sizeof(outputDelay));
+
 	return SUCCEEDED(hr);
 }
\ No newline at end of file
@@ -4,10 +4,140 @@
 
 #define PROP_GUID 0xcb043957, 0x7b35, 0x456e, 0x9b, 0x61, 0x55, 0x13, 0x93, 0xf, 0x4d, 0x8e
 #define PROP_DATA_ID 0
+#define PROP_FRAME_ID 1
+#define PROP_FRC_MODE_ID 2
+#define PROP_STATISTICS_ID 3
+#define PROP_LATENCY_PROBE_ID 4
+#define PROP_STAGING_ID 5
+#define PROP_SLATE_ID 6
+#define PROP_NO_SIGNAL_TIMEOUT_ID 7
+#define PROP_TRACE_ID 8
+#define PROP_CAPTURE_MODE_ID 9
+#define PROP_TIMESTAMP_MODE_ID 10
+#define PROP_OUTPUT_DELAY_ID 11
 
 #define WIDTH 1280
 #define HEIGHT 720
 
+//
+// Must match AVSHWS_PIXEL_FORMAT in the driver's customprops.h.
+//
+#define PIXEL_FORMAT_RGB24 0
+#define PIXEL_FORMAT_BGRA 1
+#define PIXEL_FORMAT_RGBA 2
+#define PIXEL_FORMAT_NV12 3
+#define PIXEL_FORMAT_I420 4
+#define PIXEL_FORMAT_YUY2 5
+#define PIXEL_FORMAT_RGB48 6
+#define PIXEL_FORMAT_RGBA64 7
+#define PIXEL_FORMAT_P010 8
+#define PIXEL_FORMAT_COUNT 9
+
+// The largest frame, in a 64 bit per pixel format.
+#define MAX_FRAME_SIZE (WIDTH * HEIGHT * 8)
+
+//
+// Must match AVSHWS_FRAME_HEADER in the driver's customprops.h.
+//
+#define FRAME_METADATA_MAX 64
+#define FRAME_FLAG_TIMESTAMP_VALID 0x00000001
+
+//
+// Must match FRC_MODE in the driver's frc.h.
+//
+#define FRC_MODE_LATEST 0
+#define FRC_MODE_NEAREST 1
+#define FRC_MODE_BLEND 2
+
+//
+// Must match AVSHWS_STAGING in the driver's customprops.h.
+//
+#define STAGING_NATIVE 0
+#define STAGING_NV12 1
+
+//
+// Must match AVSHWS_CAPTURE_MODE in the driver's customprops.h.
+//
+#define CAPTURE_MAPPED 0
+#define CAPTURE_COPY 1
+
+//
+// Must match AVSHWS_TIMESTAMP_MODE in the driver's customprops.h.
+//
+#define TIMESTAMP_CLOCK 0
+#define TIMESTAMP_SCHEDULE 1
+
+typedef struct _FRAME_HEADER {
+	ULONG Size;
+	ULONG Flags;
+	LONGLONG Timestamp;
+	ULONG MetadataLength;
+	UCHAR Metadata[FRAME_METADATA_MAX];
+	ULONG Format;
+} FRAME_HEADER, *PFRAME_HEADER;
+
+//
+// Must match AVSHWS_SLATE_HEADER in the driver's customprops.h.
+//
+typedef struct _SLATE_HEADER {
+	ULONG Size;
+	ULONG Format;
+	ULONG Width;
+	ULONG Height;
+} SLATE_HEADER, *PSLATE_HEADER;
+
+//
+// Must match AVSHWS_STATISTICS in the driver's customprops.h.
+//
+typedef struct _STATISTICS {
+	ULONG Size;
+	ULONG FramesDelivered;
+	ULONG DropNoBuffer;
+	ULONG DropPartialMapping;
+	ULONG ProducerStalled;
+	ULONG FramesSuperseded;
+	ULONG StartTime;
+	ULONG TimeToFirstFrame;
+	ULONG FrameBufferAllocations;
+	ULONG NoSignalSwitches;
+	ULONG NoSignal;
+} STATISTICS, *PSTATISTICS;
+
+//
+// Must match AVSHWS_TRACE_RECORD and AVSHWS_TRACE_DUMP in the driver's
+// customprops.h.  A trace dump is a TRACE_DUMP followed by RecordCount
+// records.
+//
+typedef struct _TRACE_RECORD {
+	LONGLONG Timestamp;
+	USHORT Event;
+	USHORT Processor;
+	ULONG Generation;
+	ULONG Arg1;
+	ULONG Arg2;
+} TRACE_RECORD, *PTRACE_RECORD;
+
+typedef struct _TRACE_DUMP {
+	ULONG Size;
+	ULONG Enabled;
+	ULONG Processors;
+	ULONG RecordsAvailable;
+	ULONG RecordCount;
+} TRACE_DUMP, *PTRACE_DUMP;
+
+//
+// Must match AVSHWS_OUTPUT_DELAY in the driver's customprops.h.
+//
+#define OUTPUT_DELAY_MAX 2000
+
+typedef struct _OUTPUT_DELAY {
+	ULONG Size;
+	ULONG Delay;
+	ULONG MemoryBudget;
+	ULONG CurrentDelay;
+	ULONG Depth;
+} OUTPUT_DELAY, *POUTPUT_DELAY;
+
 class Device
 {
 private:
@@ -20,5 +150,51 @@ public:
 	int Init();
 
 	int SetData(PVOID dataPointer, ULONG dataLength);
+
+	// Sets a frame which is prefixed by a FRAME_HEADER.  The frame is in the
+	// header's Format.
+	int SetFrame(PFRAME_HEADER frame, ULONG dataLength);
+
+	// Selects how injected frames are converted to the output frame rate.
+	int SetFrcMode(ULONG mode);
+
+	// Reads the frame delivery and drop counters.
+	int GetStatistics(PSTATISTICS statistics);
+
+	// Turns latency probe stamping of injected frames on or off.
+	int SetLatencyProbe(ULONG enable);
+
+	// Selects how injected frames are stored in the driver.  Takes effect
+	// at the next stream start.
+	int SetStaging(ULONG mode);
+
+	// Sets the image a stream starts with when there is no earlier frame,
+	// prefixed by a SLATE_HEADER.  A header of zero size clears it.
+	int SetSlate(PSLATE_HEADER slate, ULONG dataLength);
+
+	// Sets the time without an injected frame, in milliseconds, after which
+	// the driver shows a "no signal" slate.  Zero turns it off.
+	int SetNoSignalTimeout(ULONG timeout);
+
+	// Selects how the driver gets frames into the consumer's buffers.
+	// Takes effect at the next stream start.
+	int SetCaptureMode(ULONG mode);
+
+	// Selects how the driver timestamps delivered frames.  Takes effect
+	// when the stream next starts running.
+	int SetTimestampMode(ULONG mode);
+
+	// Delays the frames by delay milliseconds, holding them in a ring of at
+	// most budget kilobytes (zero: the driver's default).  The ring is sized
+	// at the next stream start; a running stream moves smoothly to the new
+	// delay as far as its ring allows.
+	int SetOutputDelay(ULONG delay, ULONG budget);
+
+	// Turns the driver's event trace on (clearing it) or off.
+	int SetTrace(ULONG enable);
+
+	// Reads the event trace into a buffer of length bytes: a TRACE_DUMP
+	// followed by as many records as fit.  returned receives the bytes read.
+	int GetTrace(PTRACE_DUMP dump, ULONG length, PULONG returned);
 };
 
@@ -1,6 +1,15 @@
 #include "Common.h"
 #include "DeviceEnumeration.h"
 #include "Device.h"
+#include "Recording.h"
+#include "LatencyProbe.h"
+#include "Compositor.h"
+#include "ChromaKey.h"
+#include "Redaction.h"
+#include "Broker.h"
+
+#include <atomic>
+#include <chrono>
 
 #define NUM_MAX_PATHS 16
 static string cachedPaths[NUM_MAX_PATHS];
@@ -8,9 +17,76 @@ static int numDevices;
 
 static Device* activeDevice = NULL;
 
-#define TEMPORARY_BUFFER_SIZE (WIDTH * HEIGHT * 3)
+#define TEMPORARY_BUFFER_SIZE MAX_FRAME_SIZE
 static PVOID temporaryBuffer = NULL;
 
+//
+// The temporary buffer is prefixed by a frame header so that stamped frames
+// can be handed to the driver in a single property call.
+//
+static PFRAME_HEADER frameHeader = NULL;
+
+//
+// Serializes use of the temporary buffer and the active device between the
+// producer calls and the replay thread.
+//
+static std::mutex injectLock;
+
+//
+// Overlay layers composited over every frame passed to SetBuffer /
+// SetBufferEx.  Guarded by injectLock.
+//
+static Compositor compositor;
+
+//
+// Chroma key applied to every frame passed to SetBuffer / SetBufferEx,
+// before the layers are composited.  Guarded by injectLock.
+//
+static ChromaKey chromaKey;
+
+//
+// Rectangles pixelated or blurred in every frame passed to SetBuffer /
+// SetBufferEx, first thing after it is copied, and in every frame the
+// broker forwards (it keeps its own copy).  Guarded by injectLock.
+//
+static Redactor redactor;
+
+//
+// Frames passed to SetBuffer / SetBufferEx are also written to this
+// recording while it is open.
+//
+#define RECORDING_BUFFER_COUNT 8
+static std::mutex recorderLock;
+static RecordingWriter* recorder = NULL;
+
+//
+// Replay of a recording through the inject path.  Frames are prefetched
+// RECORDING_PREFETCH_FRAMES ahead of the one being sent.
+//
+#define RECORDING_PREFETCH_FRAMES 16
+static std::thread replayThread;
+static std::mutex replayLock;
+static std::condition_variable replayWake;
+static bool replayStopping = false;
+static std::atomic<bool> replayRunning(false);
+
+//
+// The frame broker, which feeds every camera from producer processes, and
+// this process's connection to a broker when it is a producer.  Guarded by
+// brokerLock.
+//
+static std::mutex brokerLock;
+static FrameBroker* broker = NULL;
+static std::vector<BrokerSink*> brokerSinks;
+static BrokerClient* brokerClient = NULL;
+
+EXPORT LONGLONG GetTimestamp();
+EXPORT int SetBufferFormat(PVOID data, DWORD stride, DWORD width, DWORD height, DWORD format, LONGLONG timestamp, PVOID metadata, DWORD metadataLength);
+EXPORT int StopRecording();
+EXPORT int StopReplay();
+EXPORT int StopBroker();
+EXPORT int DisconnectBroker();
+
 EXPORT int Init()
 {
 	HRESULT hr = CoInitializeEx(NULL, COINIT_MULTITHREADED);
@@ -24,23 +100,37 @@ EXPORT int Init()
 		return 0;
 	}
 
-	temporaryBuffer = malloc(TEMPORARY_BUFFER_SIZE);
-	if (temporaryBuffer == NULL)
+	frameHeader = (PFRAME_HEADER)malloc(sizeof(FRAME_HEADER) + TEMPORARY_BUFFER_SIZE);
+	if (frameHeader == NULL)
 	{
 		return 0;
 	}
 
+	temporaryBuffer = frameHeader + 1;
+
+	compositor.SetSize(WIDTH, HEIGHT);
+	chromaKey.SetSize(WIDTH, HEIGHT);
+	redactor.SetSize(WIDTH, HEIGHT);
+
 	return 1;
 }
 
 EXPORT int Free()
 {
+	StopReplay();
+	StopRecording();
+	StopBroker();
+	DisconnectBroker();
+
 	if (activeDevice != NULL) 
 	{
 		delete activeDevice;
+		activeDevice = NULL;
 	}
 
-	free(temporaryBuffer);
+	free(frameHeader);
+	frameHeader = NULL;
+	temporaryBuffer = NULL;
 
 	CoUninitialize(); 
 
@@ -65,6 +155,10 @@ EXPORT int GetDevicePath(int index, char* str, int maxLen)
 
 EXPORT void DestroyDevice()
 {
+	StopReplay();
+
+	std::lock_guard<std::mutex> guard(injectLock);
+
 	if (activeDevice != NULL)
 	{
 		delete activeDevice;
@@ -76,6 +170,8 @@ EXPORT int SetDevice(char* str, int strLen)
 {
 	DestroyDevice();
 
+	std::lock_guard<std::mutex> guard(injectLock);
+
 	IBaseFilter* filter = NULL;
 	if (!GetFilter(string(str), &filter) || filter == NULL)
 	{
@@ -94,8 +190,251 @@ EXPORT int SetDevice(char* str, int strLen)
 	return 1;
 }
 
+//
+// The recording payload format of each PIXEL_FORMAT_*.
+//
+static const uint32_t recordingFormats[PIXEL_FORMAT_COUNT] =
+{
+	RECORDING_FORMAT_RGB24,
+	RECORDING_FORMAT_BGRA,
+	RECORDING_FORMAT_RGBA,
+	RECORDING_FORMAT_NV12,
+	RECORDING_FORMAT_I420,
+	RECORDING_FORMAT_YUY2,
+	RECORDING_FORMAT_RGB48,
+	RECORDING_FORMAT_RGBA64,
+	RECORDING_FORMAT_P010
+};
+
+//
+// Returns the size of a tightly packed frame in a PIXEL_FORMAT_*.
+//
+static DWORD GetFrameSize(DWORD format)
+{
+	switch (format)
+	{
+	case PIXEL_FORMAT_RGB24:
+		return WIDTH * HEIGHT * 3;
+	case PIXEL_FORMAT_BGRA:
+	case PIXEL_FORMAT_RGBA:
+		return WIDTH * HEIGHT * 4;
+	case PIXEL_FORMAT_NV12:
+	case PIXEL_FORMAT_I420:
+		return WIDTH * HEIGHT * 3 / 2;
+	case PIXEL_FORMAT_YUY2:
+		return WIDTH * HEIGHT * 2;
+	case PIXEL_FORMAT_RGB48:
+		return WIDTH * HEIGHT * 6;
+	case PIXEL_FORMAT_RGBA64:
+		return WIDTH * HEIGHT * 8;
+	case PIXEL_FORMAT_P010:
+		return WIDTH * HEIGHT * 3;
+	default:
+		return 0;
+	}
+}
+
+static_assert(sizeof(FRAME_HEADER) == sizeof(BROKER_FRAME), "BROKER_FRAME must match FRAME_HEADER");
+
+//
+// A camera fed by the broker.  Frames are handed to the driver straight
+// from the producer's shared buffer.
+//
+class DeviceSink : public BrokerSink
+{
+private:
+	Device* device;
+
+public:
+	DeviceSink(Device* device) : device(device) {}
+	~DeviceSink() { delete device; }
+
+	bool SetFrame(BROKER_FRAME* frame, uint32_t bufferSize)
+	{
+		DWORD format = frame->Format;
+		if (format >= PIXEL_FORMAT_COUNT ||
+			sizeof(FRAME_HEADER) + GetFrameSize(format) > bufferSize)
+		{
+			return false;
+		}
+
+		return device->SetFrame((PFRAME_HEADER)frame, GetFrameSize(format)) > 0;
+	}
+};
+
+static void RecordFrame(LONGLONG timestamp, DWORD format)
+{
+	std::lock_guard<std::mutex> guard(recorderLock);
+
+	if (recorder != NULL)
+	{
+		recorder->Submit(temporaryBuffer, GetFrameSize(format), timestamp > 0 ? timestamp : GetTimestamp(), recordingFormats[format], WIDTH, HEIGHT);
+	}
+}
+
+static PUCHAR CopyPlane(PUCHAR target, PUCHAR source, DWORD stride, DWORD rowBytes, DWORD rows)
+{
+	for (DWORD y = 0; y < rows; y++)
+	{
+		memcpy(target, source + (size_t)stride * y, rowBytes);
+		target += rowBytes;
+	}
+
+	return target;
+}
+
+//
+// Redacts each plane of the frame in the temporary buffer.  YUY2 is
+// redacted in pairs of pixels.
+//
+static void RedactFrame(DWORD format)
+{
+	uint8_t* frame = (uint8_t*)temporaryBuffer;
+
+	switch (format)
+	{
+	case PIXEL_FORMAT_RGB24:
+		redactor.Apply(frame, WIDTH * 3, 1, 3, 0, 0);
+		break;
+
+	case PIXEL_FORMAT_BGRA:
+	case PIXEL_FORMAT_RGBA:
+		redactor.Apply(frame, WIDTH * 4, 1, 4, 0, 0);
+		break;
+
+	case PIXEL_FORMAT_NV12:
+		redactor.Apply(frame, WIDTH, 1, 1, 0, 0);
+		redactor.Apply(frame + WIDTH * HEIGHT, WIDTH, 1, 2, 1, 1);
+		break;
+
+	case PIXEL_FORMAT_I420:
+		redactor.Apply(frame, WIDTH, 1, 1, 0, 0);
+		redactor.Apply(frame + WIDTH * HEIGHT, WIDTH / 2, 1, 1, 1, 1);
+		redactor.Apply(frame + WIDTH * HEIGHT + (WIDTH / 2) * (HEIGHT / 2), WIDTH / 2, 1, 1, 1, 1);
+		break;
+
+	case PIXEL_FORMAT_YUY2:
+		redactor.Apply(frame, WIDTH * 2, 1, 4, 1, 0);
+		break;
+
+	case PIXEL_FORMAT_RGB48:
+		redactor.Apply(frame, WIDTH * 6, 2, 3, 0, 0);
+		break;
+
+	case PIXEL_FORMAT_RGBA64:
+		redactor.Apply(frame, WIDTH * 8, 2, 4, 0, 0);
+		break;
+
+	case PIXEL_FORMAT_P010:
+		redactor.Apply(frame, WIDTH * 2, 2, 1, 0, 0);
+		redactor.Apply(frame + WIDTH * 2 * HEIGHT, WIDTH * 2, 2, 2, 1, 1);
+		break;
+	}
+}
+
+//
+// Keys the frame in the temporary buffer.  YUV frames are keyed on their
+// chroma as they are.  RGBA, RGB48 and RGBA64 frames aren't keyed.
+//
+static void KeyFrame(DWORD format)
+{
+	uint8_t* frame = (uint8_t*)temporaryBuffer;
+
+	switch (format)
+	{
+	case PIXEL_FORMAT_RGB24:
+		chromaKey.Apply(frame, WIDTH * 3, 3);
+		break;
+
+	case PIXEL_FORMAT_BGRA:
+		chromaKey.Apply(frame, WIDTH * 4, 4);
+		break;
+
+	case PIXEL_FORMAT_NV12:
+		chromaKey.ApplyYuv(frame, WIDTH, 1, frame + WIDTH * HEIGHT, frame + WIDTH * HEIGHT + 1, WIDTH, 2, 2, 1);
+		break;
+
+	case PIXEL_FORMAT_I420:
+		chromaKey.ApplyYuv(frame, WIDTH, 1,
+			frame + WIDTH * HEIGHT,
+			frame + WIDTH * HEIGHT + (WIDTH / 2) * (HEIGHT / 2),
+			WIDTH / 2, 1, 2, 1);
+		break;
+
+	case PIXEL_FORMAT_YUY2:
+		chromaKey.ApplyYuv(frame, WIDTH * 2, 2, frame + 1, frame + 3, WIDTH * 2, 4, 1, 1);
+		break;
+
+	case PIXEL_FORMAT_P010:
+		chromaKey.ApplyYuv(frame, WIDTH * 2, 1, frame + WIDTH * 2 * HEIGHT, frame + WIDTH * 2 * HEIGHT + 2, WIDTH * 2, 2, 2, 2);
+		break;
+	}
+}
+
+//
+// Copies a frame into the temporary buffer, tightly packed, redacts it,
+// keys it and composites the overlay layers over it.  The chroma planes of NV12 and I420 follow
+// the luma plane, with the same stride for NV12 and P010 and half of it for
+// I420.
+// Only RGB24 and BGRA frames have layers composited over them.
+//
+static void CopyFrame(PVOID data, DWORD stride, DWORD height, DWORD format)
+{
+	PUCHAR source = (PUCHAR)data;
+	PUCHAR target = (PUCHAR)temporaryBuffer;
+
+	switch (format)
+	{
+	case PIXEL_FORMAT_NV12:
+		target = CopyPlane(target, source, stride, WIDTH, height);
+		CopyPlane(target, source + (size_t)stride * height, stride, WIDTH, height / 2);
+		break;
+
+	case PIXEL_FORMAT_I420:
+		target = CopyPlane(target, source, stride, WIDTH, height);
+		source += (size_t)stride * height;
+		target = CopyPlane(target, source, stride / 2, WIDTH / 2, height / 2);
+		source += (size_t)(stride / 2) * (height / 2);
+		CopyPlane(target, source, stride / 2, WIDTH / 2, height / 2);
+		break;
+
+	case PIXEL_FORMAT_P010:
+		target = CopyPlane(target, source, stride, WIDTH * 2, height);
+		CopyPlane(target, source + (size_t)stride * height, stride, WIDTH * 2, height / 2);
+		break;
+
+	default:
+		CopyPlane(target, source, stride, GetFrameSize(format) / HEIGHT, height);
+		break;
+	}
+
+	if (!redactor.IsEmpty())
+	{
+		RedactFrame(format);
+	}
+
+	if (chromaKey.IsEnabled())
+	{
+		KeyFrame(format);
+	}
+
+	if (!compositor.IsEmpty())
+	{
+		if (format == PIXEL_FORMAT_RGB24)
+		{
+			compositor.Apply((uint8_t*)temporaryBuffer, WIDTH * 3, 3);
+		}
+		else if (format == PIXEL_FORMAT_BGRA)
+		{
+			compositor.Apply((uint8_t*)temporaryBuffer, WIDTH * 4, 4);
+		}
+	}
+}
+
 EXPORT int SetBuffer(PVOID data, DWORD stride, DWORD width, DWORD height)
 {
+	std::lock_guard<std::mutex> guard(injectLock);
+
 	if (activeDevice == NULL) 
 	{
 		return -1;
@@ -106,18 +445,954 @@ EXPORT int SetBuffer(PVOID data, DWORD stride, DWORD width, DWORD height)
 		return -1;
 	}
 
-	memset(temporaryBuffer, 0x00, TEMPORARY_BUFFER_SIZE);
+	CopyFrame(data, stride, height, PIXEL_FORMAT_RGB24);
+	RecordFrame(0, PIXEL_FORMAT_RGB24);
+
+	activeDevice->SetData(temporaryBuffer, GetFrameSize(PIXEL_FORMAT_RGB24));
+
+	return 1;
+}
+
+EXPORT LONGLONG GetTimestamp()
+{
+	LARGE_INTEGER frequency;
+	LARGE_INTEGER counter;
+
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+
+	return (counter.QuadPart / frequency.QuadPart) * 10000000 +
+		((counter.QuadPart % frequency.QuadPart) * 10000000) / frequency.QuadPart;
+}
+
+//
+// SetBufferEx:
+//
+// Like SetBuffer, but also passes the producer's capture timestamp (100ns
+// units of the performance counter, see GetTimestamp; 0 if unknown) and an
+// optional per-frame metadata block of up to FRAME_METADATA_MAX bytes.
+//
+EXPORT int SetBufferEx(PVOID data, DWORD stride, DWORD width, DWORD height, LONGLONG timestamp, PVOID metadata, DWORD metadataLength)
+{
+	return SetBufferFormat(data, stride, width, height, PIXEL_FORMAT_RGB24, timestamp, metadata, metadataLength);
+}
+
+//
+// SetBufferFormat:
+//
+// Like SetBufferEx, for a frame in any PIXEL_FORMAT_*.  The driver converts
+// it to the camera's output format, so producers can pass what they have:
+// GDI+ 32bpp ARGB bitmaps as PIXEL_FORMAT_BGRA, decoder output as NV12,
+// I420 or P010, high bit depth renders as RGB48 or RGBA64.  stride is the
+// stride of the (luma) plane; see CopyFrame for the chroma planes.
+//
+EXPORT int SetBufferFormat(PVOID data, DWORD stride, DWORD width, DWORD height, DWORD format, LONGLONG timestamp, PVOID metadata, DWORD metadataLength)
+{
+	std::lock_guard<std::mutex> guard(injectLock);
+
+	if (activeDevice == NULL)
+	{
+		return -1;
+	}
+
+	if (width != WIDTH || height != HEIGHT || format >= PIXEL_FORMAT_COUNT)
+	{
+		return -1;
+	}
+
+	if (metadataLength > FRAME_METADATA_MAX || (metadataLength != 0 && metadata == NULL))
+	{
+		return -1;
+	}
+
+	CopyFrame(data, stride, height, format);
+	RecordFrame(timestamp, format);
+
+	memset(frameHeader, 0x00, sizeof(FRAME_HEADER));
+	frameHeader->Size = sizeof(FRAME_HEADER);
+	frameHeader->Format = format;
+
+	if (timestamp > 0)
+	{
+		frameHeader->Flags |= FRAME_FLAG_TIMESTAMP_VALID;
+		frameHeader->Timestamp = timestamp;
+	}
+
+	if (metadataLength != 0)
+	{
+		memcpy(frameHeader->Metadata, metadata, metadataLength);
+		frameHeader->MetadataLength = metadataLength;
+	}
+
+	activeDevice->SetFrame(frameHeader, GetFrameSize(format));
+
+	return 1;
+}
+
+//
+// SetFrameRateConversion:
+//
+// Selects how frames injected at the producer's rate are converted to the
+// camera's output rate: FRC_MODE_LATEST, FRC_MODE_NEAREST (by timestamp) or
+// FRC_MODE_BLEND (weighted average of the two frames around the output time).
+//
+EXPORT int SetFrameRateConversion(DWORD mode)
+{
+	if (activeDevice == NULL)
+	{
+		return -1;
+	}
+
+	return activeDevice->SetFrcMode(mode);
+}
 
-	PUCHAR inputData = (PUCHAR)data;
-	PUCHAR buffer = (PUCHAR)temporaryBuffer;
-	for (ULONG y = 0; y < height; y++)
+//
+// SetStaging:
+//
+// Selects how the driver stores injected frames: STAGING_NATIVE keeps them
+// in the negotiated format, STAGING_NV12 keeps them as NV12 (half the size
+// of RGB24 or P010, 3/8 of RGB32) and expands them as each frame is
+// delivered.  Takes effect when the camera next starts streaming.
+//
+EXPORT int SetStaging(DWORD mode)
+{
+	if (activeDevice == NULL)
 	{
-		PUCHAR sourceLine = inputData + stride * y;
-		PUCHAR targetLine = buffer + ((WIDTH * 3) * y);
-		memcpy(targetLine, sourceLine, WIDTH * 3);
+		return -1;
 	}
 
-	activeDevice->SetData(temporaryBuffer, TEMPORARY_BUFFER_SIZE);
+	return activeDevice->SetStaging(mode);
+}
+
+//
+// SetSlate:
+//
+// Sets the image the camera shows when it starts streaming and no frame has
+// been injected yet, in any PIXEL_FORMAT_* (see SetBufferFormat).  Without a
+// slate the camera starts with the last frame it showed, or injected since,
+// and is only black if there is neither.  Pass NULL data to clear the slate.
+//
+EXPORT int SetSlate(PVOID data, DWORD stride, DWORD width, DWORD height, DWORD format)
+{
+	std::lock_guard<std::mutex> guard(injectLock);
+
+	if (activeDevice == NULL)
+	{
+		return -1;
+	}
+
+	SLATE_HEADER header = { sizeof(SLATE_HEADER), 0, 0, 0 };
+
+	if (data == NULL)
+	{
+		return activeDevice->SetSlate(&header, 0);
+	}
+
+	if (width != WIDTH || height != HEIGHT || format >= PIXEL_FORMAT_COUNT)
+	{
+		return -1;
+	}
+
+	CopyFrame(data, stride, height, format);
+
+	header.Format = format;
+	header.Width = width;
+	header.Height = height;
+
+	std::vector<uint8_t> slate(sizeof(SLATE_HEADER) + GetFrameSize(format));
+	memcpy(slate.data(), &header, sizeof(SLATE_HEADER));
+	memcpy(slate.data() + sizeof(SLATE_HEADER), temporaryBuffer, GetFrameSize(format));
+
+	return activeDevice->SetSlate((PSLATE_HEADER)slate.data(), GetFrameSize(format));
+}
+
+//
+// SetNoSignalTimeout:
+//
+// Sets how long, in milliseconds, the camera waits for a new frame before it
+// assumes the producer is gone and shows a "no signal" slate until frames
+// arrive again.  Zero (the default) keeps showing the last frame.  Turning
+// it on takes effect when the camera next starts streaming.
+//
+EXPORT int SetNoSignalTimeout(DWORD timeout)
+{
+	if (activeDevice == NULL)
+	{
+		return -1;
+	}
+
+	return activeDevice->SetNoSignalTimeout(timeout);
+}
+
+//
+// SetCaptureMode:
+//
+// Selects how the driver gets frames into the buffers of the application
+// using the camera: CAPTURE_MAPPED programs each buffer into the simulated
+// scatter / gather hardware, CAPTURE_COPY copies the frame of each tick into
+// the next buffer with less bookkeeping per frame.  Takes effect when the
+// camera next starts streaming.
+//
+EXPORT int SetCaptureMode(DWORD mode)
+{
+	if (activeDevice == NULL)
+	{
+		return -1;
+	}
+
+	return activeDevice->SetCaptureMode(mode);
+}
+
+//
+// SetTimestampMode:
+//
+// Selects how the driver timestamps frames: TIMESTAMP_CLOCK uses the
+// timestamp passed with the frame (SetBufferEx) or the time the frame is
+// delivered, TIMESTAMP_SCHEDULE spaces frames exactly one frame period apart
+// from the moment the camera starts running, following the graph clock with
+// small corrections.  Takes effect when the camera next starts running.
+//
+EXPORT int SetTimestampMode(DWORD mode)
+{
+	if (activeDevice == NULL)
+	{
+		return -1;
+	}
+
+	return activeDevice->SetTimestampMode(mode);
+}
+
+//
+// SetOutputDelay:
+//
+// Delays the camera's frames, and their timestamps, by delay milliseconds
+// (at most 2000), for instance to line video up with audio that arrives
+// later.  The driver holds the frames in memory, at most budgetKb kilobytes
+// of it (zero: 64 MB); a delay the budget can't hold is shortened.  The
+// memory is set aside when the camera starts streaming, so a delay set
+// before then can be changed later within it, smoothly and without dropped
+// frames.
+//
+EXPORT int SetOutputDelay(DWORD delay, DWORD budgetKb)
+{
+	if (activeDevice == NULL)
+	{
+		return -1;
+	}
+
+	return activeDevice->SetOutputDelay(delay, budgetKb);
+}
+
+//
+// SetTrace:
+//
+// Turns the driver's event trace of the frame path on or off.  Turning it on
+// clears the trace.  Turn it off before DumpTrace to get a consistent dump.
+//
+EXPORT int SetTrace(DWORD enable)
+{
+	if (activeDevice == NULL)
+	{
+		return -1;
+	}
+
+	return activeDevice->SetTrace(enable);
+}
+
+//
+// DumpTrace:
+//
+// Writes the driver's event trace to a file: the TRACE_DUMP header followed
+// by the records, as the driver returned them.  TraceDecoder turns a dump
+// into per-frame timelines and stage latencies.
+//
+EXPORT int DumpTrace(const char* path)
+{
+	if (activeDevice == NULL || path == NULL)
+	{
+		return -1;
+	}
+
+	TRACE_DUMP header = {};
+	ULONG returned = 0;
+
+	if (!activeDevice->GetTrace(&header, sizeof(header), &returned))
+	{
+		return 0;
+	}
+
+	std::vector<uint8_t> dump(sizeof(TRACE_DUMP) + header.RecordsAvailable * sizeof(TRACE_RECORD));
+
+	if (!activeDevice->GetTrace((PTRACE_DUMP)dump.data(), (ULONG)dump.size(), &returned))
+	{
+		return 0;
+	}
+
+	FILE* file = NULL;
+	if (fopen_s(&file, path, "wb") != 0)
+	{
+		return 0;
+	}
+
+	size_t written = fwrite(dump.data(), 1, returned, file);
+	fclose(file);
+
+	return written == returned;
+}
+
+//
+// GetStatistics:
+//
+// Reads the driver's frame counters into a STATISTICS structure: frames
+// delivered, output frames lost to consumer starvation (no buffer / too
+// little buffer queued), ticks the producer stalled on, injected frames
+// superseded before they were output, how long the stream took to start
+// and to deliver its first frame, and whether it switched to "no signal".
+//
+EXPORT int GetStatistics(PSTATISTICS statistics)
+{
+	if (activeDevice == NULL || statistics == NULL)
+	{
+		return -1;
+	}
+
+	return activeDevice->GetStatistics(statistics);
+}
+
+//
+// StartRecording:
+//
+// Starts writing every frame passed to SetBuffer / SetBufferEx /
+// SetBufferFormat to a
+// recording (see Recording.h).  Frames are written by a background thread;
+// if it falls behind, frames are left out of the recording rather than
+// slowing down the producer.
+//
+EXPORT int StartRecording(const char* path)
+{
+	std::lock_guard<std::mutex> guard(recorderLock);
+
+	if (recorder != NULL || path == NULL)
+	{
+		return -1;
+	}
+
+	recorder = new RecordingWriter();
+	if (!recorder->Open(path, TEMPORARY_BUFFER_SIZE, RECORDING_BUFFER_COUNT))
+	{
+		delete recorder;
+		recorder = NULL;
+
+		return 0;
+	}
 
 	return 1;
-}
\ No newline at end of file
+}
+
+//
+// StopRecording:
+//
+// Writes the remaining frames and the index and closes the recording.
+//
+EXPORT int StopRecording()
+{
+	RecordingWriter* closing;
+
+	{
+		std::lock_guard<std::mutex> guard(recorderLock);
+
+		closing = recorder;
+		recorder = NULL;
+	}
+
+	if (closing == NULL)
+	{
+		return -1;
+	}
+
+	int result = closing->Close() ? 1 : 0;
+	delete closing;
+
+	return result;
+}
+
+static void ReplayFrames(RecordingReader* reader, double speed, bool loop)
+{
+	typedef std::chrono::steady_clock clock;
+
+	reader->Prefetch(0, RECORDING_PREFETCH_FRAMES);
+
+	do
+	{
+		clock::time_point start = clock::now();
+		LONGLONG firstTimestamp = reader->GetEntry(0)->Timestamp;
+
+		for (uint32_t frame = 0; frame < reader->GetFrameCount(); frame++)
+		{
+			//
+			// Keep the OS reading ahead of us; wrap around when looping.
+			//
+			if (frame % (RECORDING_PREFETCH_FRAMES / 2) == 0)
+			{
+				reader->Prefetch(frame + RECORDING_PREFETCH_FRAMES / 2, RECORDING_PREFETCH_FRAMES);
+
+				if (loop && frame + RECORDING_PREFETCH_FRAMES >= reader->GetFrameCount())
+				{
+					reader->Prefetch(0, RECORDING_PREFETCH_FRAMES);
+				}
+			}
+
+			const RECORDING_INDEX_ENTRY* entry = reader->GetEntry(frame);
+
+			//
+			// Wait until the frame is due at the original (scaled) pacing.
+			// A speed of zero sends frames as fast as the device takes them.
+			//
+			{
+				std::unique_lock<std::mutex> guard(replayLock);
+
+				if (speed > 0)
+				{
+					LONGLONG offset = (LONGLONG)((entry->Timestamp - firstTimestamp) / speed);
+					clock::time_point due = start + std::chrono::microseconds(offset / 10);
+
+					replayWake.wait_until(guard, due, [] { return replayStopping; });
+				}
+
+				if (replayStopping)
+				{
+					return;
+				}
+			}
+
+			DWORD format = 0;
+			while (format < PIXEL_FORMAT_COUNT && recordingFormats[format] != entry->Format)
+			{
+				format++;
+			}
+
+			if (format == PIXEL_FORMAT_COUNT || entry->Width != WIDTH ||
+				entry->Height != HEIGHT || entry->Size != GetFrameSize(format))
+			{
+				continue;
+			}
+
+			//
+			// Send through the same path as SetBufferEx.  The original
+			// timestamps are in the past, so frames are stamped when sent.
+			//
+			std::lock_guard<std::mutex> guard(injectLock);
+
+			if (activeDevice == NULL)
+			{
+				return;
+			}
+
+			memcpy(temporaryBuffer, reader->GetFrame(frame), entry->Size);
+
+			memset(frameHeader, 0x00, sizeof(FRAME_HEADER));
+			frameHeader->Size = sizeof(FRAME_HEADER);
+			frameHeader->Format = format;
+			frameHeader->Flags = FRAME_FLAG_TIMESTAMP_VALID;
+			frameHeader->Timestamp = GetTimestamp();
+
+			activeDevice->SetFrame(frameHeader, entry->Size);
+		}
+	} while (loop);
+}
+
+//
+// StartReplay:
+//
+// Maps a recording and sends its frames to the active device from a
+// background thread.  speed scales the original pacing (1.0 = as
+// recorded, 2.0 = twice as fast, 0 = as fast as possible).  If loop is
+// non-zero the recording repeats until StopReplay is called.
+//
+EXPORT int StartReplay(const char* path, double speed, int loop)
+{
+	if (activeDevice == NULL || path == NULL || speed < 0)
+	{
+		return -1;
+	}
+
+	StopReplay();
+
+	RecordingReader* reader = new RecordingReader();
+	if (!reader->Open(path) || reader->GetFrameCount() == 0)
+	{
+		delete reader;
+
+		return 0;
+	}
+
+	replayStopping = false;
+	replayRunning = true;
+
+	replayThread = std::thread([reader, speed, loop]
+	{
+		ReplayFrames(reader, speed, loop != 0);
+
+		delete reader;
+		replayRunning = false;
+	});
+
+	return 1;
+}
+
+//
+// StopReplay:
+//
+// Stops a replay started with StartReplay and waits for it to finish.
+//
+EXPORT int StopReplay()
+{
+	if (!replayThread.joinable())
+	{
+		return -1;
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(replayLock);
+		replayStopping = true;
+	}
+
+	replayWake.notify_all();
+	replayThread.join();
+
+	return 1;
+}
+
+//
+// IsReplaying:
+//
+// Returns 1 while a replay is sending frames.
+//
+EXPORT int IsReplaying()
+{
+	return replayRunning ? 1 : 0;
+}
+
+//
+// SetLatencyProbe:
+//
+// Turns latency probe stamping on or off.  While on, the driver stamps
+// every injected frame with a frame ID and its inject time; consumers
+// recover them with DecodeProbe.
+//
+EXPORT int SetLatencyProbe(int enable)
+{
+	std::lock_guard<std::mutex> guard(injectLock);
+
+	if (activeDevice == NULL)
+	{
+		return -1;
+	}
+
+	return activeDevice->SetLatencyProbe(enable ? 1 : 0);
+}
+
+//
+// DecodeProbe:
+//
+// Recovers the frame ID and inject time (GetTimestamp domain) from a
+// delivered buffer.  format is one of the PROBE_FORMAT values; bottomUp is
+// set for bottom-up RGB.  Returns 1 if a valid code was found.
+//
+EXPORT int DecodeProbe(PVOID data, int stride, DWORD width, DWORD height, DWORD format, int bottomUp, DWORD* frameId, LONGLONG* timestamp)
+{
+	uint32_t id;
+	int64_t time;
+
+	if (frameId == NULL || timestamp == NULL ||
+		!DecodeLatencyProbe((const uint8_t*)data, stride, width, height, format, bottomUp != 0, &id, &time))
+	{
+		return 0;
+	}
+
+	*frameId = id;
+	*timestamp = time;
+
+	return 1;
+}
+
+//
+// Layers:
+//
+// Overlays (logos, lower thirds, picture-in-picture) composited natively
+// over every frame passed to SetBuffer / SetBufferEx.  Images are BGRA,
+// pre-multiplied or not; layers with a higher z-order are drawn on top.
+// Only the parts of the overlay that changed are re-blended.
+//
+EXPORT int AddLayer()
+{
+	std::lock_guard<std::mutex> guard(injectLock);
+
+	return compositor.AddLayer();
+}
+
+EXPORT int RemoveLayer(int layer)
+{
+	std::lock_guard<std::mutex> guard(injectLock);
+
+	return compositor.RemoveLayer(layer) ? 1 : 0;
+}
+
+EXPORT int SetLayerImage(int layer, PVOID data, int stride, DWORD width, DWORD height, int premultiplied)
+{
+	std::lock_guard<std::mutex> guard(injectLock);
+
+	return compositor.SetLayerImage(layer, (const uint8_t*)data, stride, width, height, premultiplied != 0) ? 1 : 0;
+}
+
+EXPORT int SetLayerPosition(int layer, int x, int y)
+{
+	std::lock_guard<std::mutex> guard(injectLock);
+
+	return compositor.SetLayerPosition(layer, x, y) ? 1 : 0;
+}
+
+EXPORT int SetLayerZOrder(int layer, int zOrder)
+{
+	std::lock_guard<std::mutex> guard(injectLock);
+
+	return compositor.SetLayerZOrder(layer, zOrder) ? 1 : 0;
+}
+
+EXPORT int SetLayerVisible(int layer, int visible)
+{
+	std::lock_guard<std::mutex> guard(injectLock);
+
+	return compositor.SetLayerVisible(layer, visible != 0) ? 1 : 0;
+}
+
+//
+// Chroma key:
+//
+// Replaces a green (or blue, or any color) screen behind the subject of
+// every RGB24, BGRA, NV12, I420, YUY2 or P010 frame passed to SetBuffer /
+// SetBufferEx / SetBufferFormat with a background color or image,
+// natively and with AVX2 where available (YUV frames are keyed on their
+// chroma, natively).  color is 0xRRGGBB.  tolerance and softness are
+// distances in the CbCr plane, 0 to 255: pixels within tolerance of the
+// key color are replaced and the next softness units are blended.  spill,
+// 0 to 255, is how much of the key color's tint is removed from the
+// subject's edges.
+//
+EXPORT int SetChromaKey(int enable, DWORD color, DWORD tolerance, DWORD softness, DWORD spill)
+{
+	std::lock_guard<std::mutex> guard(injectLock);
+
+	if (!enable)
+	{
+		chromaKey.Disable();
+		return 1;
+	}
+
+	return chromaKey.SetKey(color, tolerance, softness, spill) ? 1 : 0;
+}
+
+EXPORT int SetChromaKeyBackgroundColor(DWORD color)
+{
+	std::lock_guard<std::mutex> guard(injectLock);
+
+	chromaKey.SetBackgroundColor(color);
+
+	return 1;
+}
+
+//
+// The background image is BGRA of the frame size (WIDTH x HEIGHT).
+//
+EXPORT int SetChromaKeyBackgroundImage(PVOID data, int stride, DWORD width, DWORD height)
+{
+	std::lock_guard<std::mutex> guard(injectLock);
+
+	return chromaKey.SetBackgroundImage((const uint8_t*)data, stride, width, height) ? 1 : 0;
+}
+
+//
+// Gives the broker, if one is running, the redactions as they are now.
+// brokerLock is taken before injectLock, as StartBroker takes them.
+//
+static void UpdateBrokerRedactions()
+{
+	std::lock_guard<std::mutex> guard(brokerLock);
+
+	if (broker == NULL)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> injectGuard(injectLock);
+
+	broker->SetRedactions(redactor);
+}
+
+//
+// Redaction:
+//
+// Pixelates (REDACTION_PIXELATE, size is the block size) or blurs
+// (REDACTION_BLUR, size is the radius) fixed rectangles of every frame
+// passed to SetBuffer / SetBufferEx / SetBufferFormat, whatever its
+// format, before it is handed to the driver, and of every frame the
+// broker forwards to a camera.  AddRedaction returns the rectangle's id,
+// or 0 if it was refused.
+//
+EXPORT int AddRedaction(int x, int y, DWORD width, DWORD height, DWORD mode, DWORD size)
+{
+	int id;
+
+	{
+		std::lock_guard<std::mutex> guard(injectLock);
+
+		id = redactor.AddRegion(x, y, width, height, mode, size);
+	}
+
+	UpdateBrokerRedactions();
+
+	return id;
+}
+
+EXPORT int RemoveRedaction(int id)
+{
+	bool removed;
+
+	{
+		std::lock_guard<std::mutex> guard(injectLock);
+
+		removed = redactor.RemoveRegion(id);
+	}
+
+	UpdateBrokerRedactions();
+
+	return removed ? 1 : 0;
+}
+
+EXPORT int ClearRedactions()
+{
+	{
+		std::lock_guard<std::mutex> guard(injectLock);
+
+		redactor.ClearRegions();
+	}
+
+	UpdateBrokerRedactions();
+
+	return 1;
+}
+
+//
+// StartBroker:
+//
+// Opens every camera and feeds them from producer processes connecting
+// with ConnectBroker (see Broker.h), each camera paced at framesPerSecond.
+// The producers' frames are redacted as injected frames are (see
+// AddRedaction).  Only one broker runs at a time.  The active device is
+// left alone; a process should either broker or inject frames itself.
+//
+EXPORT int StartBroker(DWORD framesPerSecond)
+{
+	std::lock_guard<std::mutex> guard(brokerLock);
+
+	if (broker != NULL || framesPerSecond == 0 || numDevices <= 0)
+	{
+		return -1;
+	}
+
+	bool opened = true;
+
+	for (int index = 0; opened && index < numDevices && index < BROKER_MAX_CAMERAS; index++)
+	{
+		IBaseFilter* filter = NULL;
+		Device* device = NULL;
+
+		if (GetFilter(cachedPaths[index], &filter) && filter != NULL)
+		{
+			device = new Device(filter);
+			if (!device->Init())
+			{
+				delete device;
+				device = NULL;
+			}
+		}
+
+		if (device == NULL)
+		{
+			opened = false;
+			continue;
+		}
+
+		brokerSinks.push_back(new DeviceSink(device));
+	}
+
+	broker = new FrameBroker();
+
+	{
+		std::lock_guard<std::mutex> injectGuard(injectLock);
+
+		broker->SetRedactions(redactor);
+	}
+
+	if (!opened ||
+		!broker->Start(brokerSinks.data(), (uint32_t)brokerSinks.size(), WIDTH, HEIGHT, framesPerSecond))
+	{
+		delete broker;
+		broker = NULL;
+
+		for (BrokerSink* sink : brokerSinks)
+		{
+			delete sink;
+		}
+		brokerSinks.clear();
+
+		return 0;
+	}
+
+	return 1;
+}
+
+//
+// StopBroker:
+//
+// Disconnects the producers and closes the cameras.
+//
+EXPORT int StopBroker()
+{
+	std::lock_guard<std::mutex> guard(brokerLock);
+
+	if (broker == NULL)
+	{
+		return -1;
+	}
+
+	broker->Stop();
+	delete broker;
+	broker = NULL;
+
+	for (BrokerSink* sink : brokerSinks)
+	{
+		delete sink;
+	}
+	brokerSinks.clear();
+
+	return 1;
+}
+
+//
+// GetBrokerStatistics:
+//
+// Returns the broker's cameras, connected producers and frame counters.
+//
+EXPORT int GetBrokerStatistics(BROKER_STATISTICS* statistics)
+{
+	std::lock_guard<std::mutex> guard(brokerLock);
+
+	if (broker == NULL || statistics == NULL)
+	{
+		return -1;
+	}
+
+	broker->GetStatistics(statistics);
+
+	return 1;
+}
+
+//
+// ConnectBroker:
+//
+// Connects this process to the running broker as a producer of frames in
+// a PIXEL_FORMAT_*.  role is BROKER_ROLE_FEED or BROKER_ROLE_LAYER (whose
+// frames are BGRA); camera is the camera index, or -1 for any.  Returns
+// the camera assigned, or -1.
+//
+EXPORT int ConnectBroker(int camera, DWORD role, DWORD format)
+{
+	std::lock_guard<std::mutex> guard(brokerLock);
+
+	if (brokerClient != NULL || format >= PIXEL_FORMAT_COUNT ||
+		(role == BROKER_ROLE_LAYER && format != PIXEL_FORMAT_BGRA))
+	{
+		return -1;
+	}
+
+	brokerClient = new BrokerClient();
+	if (!brokerClient->Connect(camera, role, sizeof(FRAME_HEADER) + GetFrameSize(format)))
+	{
+		delete brokerClient;
+		brokerClient = NULL;
+
+		return -1;
+	}
+
+	return brokerClient->GetCamera();
+}
+
+//
+// GetBrokerBuffer:
+//
+// Returns the buffer to write the next frame into: a tightly packed frame
+// of WIDTH x HEIGHT in the format passed to ConnectBroker.  It changes
+// with every PublishBrokerBuffer.
+//
+EXPORT PVOID GetBrokerBuffer()
+{
+	std::lock_guard<std::mutex> guard(brokerLock);
+
+	if (brokerClient == NULL)
+	{
+		return NULL;
+	}
+
+	return (PFRAME_HEADER)brokerClient->GetBuffer() + 1;
+}
+
+//
+// PublishBrokerBuffer:
+//
+// Hands the frame written to the buffer from GetBrokerBuffer to the
+// broker.  timestamp is in the GetTimestamp domain, or 0 for none.
+//
+EXPORT int PublishBrokerBuffer(DWORD format, LONGLONG timestamp)
+{
+	std::lock_guard<std::mutex> guard(brokerLock);
+
+	if (brokerClient == NULL || format >= PIXEL_FORMAT_COUNT ||
+		sizeof(FRAME_HEADER) + GetFrameSize(format) > brokerClient->GetBufferSize())
+	{
+		return -1;
+	}
+
+	PFRAME_HEADER header = (PFRAME_HEADER)brokerClient->GetBuffer();
+
+	header->Size = sizeof(FRAME_HEADER);
+	header->Flags = (timestamp > 0) ? FRAME_FLAG_TIMESTAMP_VALID : 0;
+	header->Timestamp = timestamp;
+	header->MetadataLength = 0;
+	header->Format = format;
+
+	brokerClient->Publish();
+
+	return 1;
+}
+
+//
+// DisconnectBroker:
+//
+// Disconnects this process from the broker.
+//
+EXPORT int DisconnectBroker()
+{
+	std::lock_guard<std::mutex> guard(brokerLock);
+
+	if (brokerClient == NULL)
+	{
+		return -1;
+	}
+
+	brokerClient->Disconnect();
+	delete brokerClient;
+	brokerClient = NULL;
+
+	return 1;
+}
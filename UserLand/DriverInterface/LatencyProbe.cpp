@@ -0,0 +1,153 @@
+#include "LatencyProbe.h"
+
+//
+// The cells are sampled over their inner half so that blur from scaling
+// filters or chroma subsampling at the cell edges doesn't matter.
+//
+#define PROBE_SAMPLE_INSET (PROBE_CELL_SIZE / 4)
+#define PROBE_SAMPLE_SIZE (PROBE_CELL_SIZE / 2)
+
+//
+// The minimum difference between the white and black sync cells.  Limited
+// range YUV (16-235) is well above it.
+//
+#define PROBE_MIN_CONTRAST 96
+
+static uint16_t ProbeCrc16(const uint8_t* data, uint32_t length)
+{
+	uint16_t crc = 0xFFFF;
+
+	for (uint32_t i = 0; i < length; i++)
+	{
+		crc ^= (uint16_t)(data[i] << 8);
+
+		for (int bit = 0; bit < 8; bit++)
+		{
+			crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+		}
+	}
+
+	return crc;
+}
+
+static uint32_t SampleLuma(const uint8_t* row, uint32_t x, uint32_t format)
+{
+	const uint8_t* pixel;
+
+	switch (format)
+	{
+	case PROBE_FORMAT_RGB24:
+		pixel = row + x * 3;
+		return (pixel[0] * 29 + pixel[1] * 150 + pixel[2] * 77) >> 8;
+
+	case PROBE_FORMAT_RGB32:
+		pixel = row + x * 4;
+		return (pixel[0] * 29 + pixel[1] * 150 + pixel[2] * 77) >> 8;
+
+	case PROBE_FORMAT_YUY2:
+		return row[x * 2];
+
+	case PROBE_FORMAT_UYVY:
+		return row[x * 2 + 1];
+
+	case PROBE_FORMAT_Y16:
+		return row[x * 2 + 1];
+
+	default:
+		return row[x];
+	}
+}
+
+//
+// The mean luma of the sampled area of a cell.
+//
+static uint32_t SampleCell(const uint8_t* topLeft, int64_t rowStep, uint32_t column, uint32_t row, uint32_t format)
+{
+	uint32_t sum = 0;
+
+	for (uint32_t y = 0; y < PROBE_SAMPLE_SIZE; y++)
+	{
+		const uint8_t* line = topLeft + (int64_t)(row * PROBE_CELL_SIZE + PROBE_SAMPLE_INSET + y) * rowStep;
+
+		for (uint32_t x = 0; x < PROBE_SAMPLE_SIZE; x++)
+		{
+			sum += SampleLuma(line, column * PROBE_CELL_SIZE + PROBE_SAMPLE_INSET + x, format);
+		}
+	}
+
+	return sum / (PROBE_SAMPLE_SIZE * PROBE_SAMPLE_SIZE);
+}
+
+bool DecodeLatencyProbe(const uint8_t* data, int32_t stride, uint32_t width, uint32_t height, uint32_t format, bool bottomUp, uint32_t* frameId, int64_t* timestamp)
+{
+	if (data == 0 || width < PROBE_CODE_WIDTH || height < PROBE_CODE_HEIGHT || format > PROBE_FORMAT_Y16)
+	{
+		return false;
+	}
+
+	const uint8_t* topLeft = bottomUp ? data + (int64_t)stride * (height - 1) : data;
+	int64_t rowStep = bottomUp ? -(int64_t)stride : stride;
+
+	//
+	// The sync row gives the white and black levels; the threshold is
+	// halfway between the darkest white and the brightest black cell.
+	//
+	uint32_t whiteMin = 255;
+	uint32_t blackMax = 0;
+
+	for (uint32_t column = 0; column < PROBE_CODE_COLUMNS; column++)
+	{
+		uint32_t luma = SampleCell(topLeft, rowStep, column, 0, format);
+
+		if ((column & 1) == 0)
+		{
+			whiteMin = (luma < whiteMin) ? luma : whiteMin;
+		}
+		else
+		{
+			blackMax = (luma > blackMax) ? luma : blackMax;
+		}
+	}
+
+	if (whiteMin < blackMax + PROBE_MIN_CONTRAST)
+	{
+		return false;
+	}
+
+	uint32_t threshold = (whiteMin + blackMax) / 2;
+	uint8_t payload[14] = {};
+
+	for (uint32_t bit = 0; bit < sizeof(payload) * 8; bit++)
+	{
+		uint32_t row = 1 + bit / PROBE_CODE_COLUMNS;
+		uint32_t column = bit % PROBE_CODE_COLUMNS;
+
+		if (SampleCell(topLeft, rowStep, column, row, format) > threshold)
+		{
+			payload[bit >> 3] |= (uint8_t)(0x80 >> (bit & 7));
+		}
+	}
+
+	if (ProbeCrc16(payload, 12) != (uint16_t)((payload[12] << 8) | payload[13]))
+	{
+		return false;
+	}
+
+	uint32_t id = 0;
+	uint64_t time = 0;
+
+	for (int i = 0; i < 4; i++)
+	{
+		id = (id << 8) | payload[i];
+	}
+
+	for (int i = 0; i < 8; i++)
+	{
+		time = (time << 8) | payload[4 + i];
+	}
+
+	*frameId = id;
+	*timestamp = (int64_t)time;
+
+	return true;
+}
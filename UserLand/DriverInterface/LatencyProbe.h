@@ -0,0 +1,44 @@
+#pragma once
+
+//
+// Latency probe decoding.
+//
+// With the latency probe enabled, the driver stamps every injected frame
+// with a block code holding a frame ID and the inject time (see probe.h in
+// the driver for the layout).  DecodeLatencyProbe recovers both from a
+// delivered buffer, so a consumer can compute inject to consumer latency
+// (GetTimestamp() - timestamp) and spot repeated or skipped frame IDs.
+//
+// Only depends on the C++ standard library.
+//
+
+#include <stdint.h>
+
+//
+// Must match probe.h in the driver.
+//
+#define PROBE_CELL_SIZE 8
+#define PROBE_CODE_COLUMNS 16
+#define PROBE_CODE_ROWS 8
+
+#define PROBE_CODE_WIDTH (PROBE_CELL_SIZE * PROBE_CODE_COLUMNS)
+#define PROBE_CODE_HEIGHT (PROBE_CELL_SIZE * PROBE_CODE_ROWS)
+
+//
+// Layouts of the delivered buffer.  For planar YUV formats (NV12, I420)
+// pass the luma plane as PROBE_FORMAT_Y8, and for P010 as PROBE_FORMAT_Y16.
+//
+#define PROBE_FORMAT_RGB24 0
+#define PROBE_FORMAT_RGB32 1
+#define PROBE_FORMAT_YUY2 2
+#define PROBE_FORMAT_UYVY 3
+#define PROBE_FORMAT_Y8 4
+#define PROBE_FORMAT_Y16 5
+
+//
+// Decodes the probe code in the top left corner of the displayed image.
+// data points at the first row in memory and stride is its length in
+// bytes; bottomUp is set for bottom-up DIBs (positive biHeight RGB).
+// Returns false if there is no valid code.
+//
+bool DecodeLatencyProbe(const uint8_t* data, int32_t stride, uint32_t width, uint32_t height, uint32_t format, bool bottomUp, uint32_t* frameId, int64_t* timestamp);
@@ -0,0 +1,452 @@
+#include "Recording.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static uint64_t AlignOffset(uint64_t offset)
+{
+	return (offset + RECORDING_ALIGNMENT - 1) & ~(uint64_t)(RECORDING_ALIGNMENT - 1);
+}
+
+static FILE* CreateRecordingFile(const char* path)
+{
+#ifdef _WIN32
+	FILE* file = NULL;
+	if (fopen_s(&file, path, "wb") != 0)
+	{
+		return NULL;
+	}
+	return file;
+#else
+	return fopen(path, "wb");
+#endif
+}
+
+/*
+	RecordingWriter
+*/
+
+RecordingWriter::RecordingWriter()
+	: file(NULL), fileOffset(0), bufferSize(0), stopping(false), failed(false), droppedFrames(0)
+{
+}
+
+RecordingWriter::~RecordingWriter()
+{
+	Close();
+}
+
+bool RecordingWriter::Open(const char* path, uint32_t bufferSize, uint32_t bufferCount)
+{
+	if (file != NULL || bufferSize == 0 || bufferCount == 0)
+	{
+		return false;
+	}
+
+	file = CreateRecordingFile(path);
+	if (file == NULL)
+	{
+		return false;
+	}
+
+	//
+	// The header is rewritten with the frame count and index offset on
+	// close.  A recording which was never closed has a zero index offset.
+	//
+	RECORDING_FILE_HEADER header = {};
+	header.Magic = RECORDING_MAGIC;
+	header.Version = RECORDING_VERSION;
+
+	if (fwrite(&header, sizeof(header), 1, file) != 1)
+	{
+		fclose(file);
+		file = NULL;
+		return false;
+	}
+
+	fileOffset = sizeof(header);
+	index.clear();
+	stopping = false;
+	failed = false;
+	droppedFrames = 0;
+
+	this->bufferSize = bufferSize;
+	for (uint32_t i = 0; i < bufferCount; i++)
+	{
+		uint8_t* buffer = (uint8_t*)malloc(bufferSize);
+		if (buffer != NULL)
+		{
+			freeBuffers.push_back(buffer);
+		}
+	}
+
+	thread = std::thread(&RecordingWriter::WriterThread, this);
+
+	return true;
+}
+
+bool RecordingWriter::Submit(const void* data, uint32_t size, int64_t timestamp, uint32_t format, uint32_t width, uint32_t height)
+{
+	uint8_t* buffer;
+
+	{
+		std::lock_guard<std::mutex> guard(lock);
+
+		if (file == NULL || stopping || size > bufferSize || freeBuffers.empty())
+		{
+			droppedFrames++;
+			return false;
+		}
+
+		buffer = freeBuffers.back();
+		freeBuffers.pop_back();
+	}
+
+	memcpy(buffer, data, size);
+
+	PendingFrame frame;
+	frame.entry.Timestamp = timestamp;
+	frame.entry.Offset = 0;
+	frame.entry.Size = size;
+	frame.entry.Format = format;
+	frame.entry.Width = width;
+	frame.entry.Height = height;
+	frame.data = buffer;
+
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		pending.push_back(frame);
+	}
+
+	wake.notify_one();
+
+	return true;
+}
+
+bool RecordingWriter::WriteFrame(PendingFrame& frame)
+{
+	static const uint8_t padding[RECORDING_ALIGNMENT] = {};
+
+	uint64_t offset = AlignOffset(fileOffset);
+	if (offset != fileOffset)
+	{
+		if (fwrite(padding, (size_t)(offset - fileOffset), 1, file) != 1)
+		{
+			return false;
+		}
+	}
+
+	if (fwrite(frame.data, frame.entry.Size, 1, file) != 1)
+	{
+		return false;
+	}
+
+	frame.entry.Offset = offset;
+	fileOffset = offset + frame.entry.Size;
+
+	index.push_back(frame.entry);
+
+	return true;
+}
+
+void RecordingWriter::WriterThread()
+{
+	std::unique_lock<std::mutex> guard(lock);
+
+	for (;;)
+	{
+		wake.wait(guard, [this] { return stopping || !pending.empty(); });
+
+		if (pending.empty())
+		{
+			break;
+		}
+
+		PendingFrame frame = pending.front();
+		pending.pop_front();
+
+		//
+		// Only the writer thread touches the file and the index, so the I/O
+		// happens without holding the lock.
+		//
+		guard.unlock();
+
+		bool written = !failed && WriteFrame(frame);
+
+		guard.lock();
+
+		if (!written)
+		{
+			failed = true;
+		}
+
+		freeBuffers.push_back(frame.data);
+	}
+}
+
+bool RecordingWriter::Close()
+{
+	if (file == NULL)
+	{
+		return false;
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stopping = true;
+	}
+
+	wake.notify_one();
+	thread.join();
+
+	bool succeeded = !failed;
+
+	RECORDING_FILE_HEADER header = {};
+	header.Magic = RECORDING_MAGIC;
+	header.Version = RECORDING_VERSION;
+	header.FrameCount = (uint32_t)index.size();
+	header.IndexOffset = AlignOffset(fileOffset);
+
+	if (succeeded && header.IndexOffset != fileOffset)
+	{
+		static const uint8_t padding[RECORDING_ALIGNMENT] = {};
+		succeeded = fwrite(padding, (size_t)(header.IndexOffset - fileOffset), 1, file) == 1;
+	}
+
+	if (succeeded && !index.empty())
+	{
+		succeeded = fwrite(index.data(), sizeof(RECORDING_INDEX_ENTRY), index.size(), file) == index.size();
+	}
+
+	if (succeeded)
+	{
+		succeeded = fseek(file, 0, SEEK_SET) == 0 &&
+			fwrite(&header, sizeof(header), 1, file) == 1;
+	}
+
+	if (fclose(file) != 0)
+	{
+		succeeded = false;
+	}
+
+	file = NULL;
+
+	for (uint8_t* buffer : freeBuffers)
+	{
+		free(buffer);
+	}
+
+	freeBuffers.clear();
+	index.clear();
+
+	return succeeded;
+}
+
+uint32_t RecordingWriter::GetDroppedFrames()
+{
+	std::lock_guard<std::mutex> guard(lock);
+	return droppedFrames;
+}
+
+/*
+	RecordingReader
+*/
+
+RecordingReader::RecordingReader()
+	:
+#ifdef _WIN32
+	fileHandle(NULL), mappingHandle(NULL),
+#else
+	fileDescriptor(-1),
+#endif
+	view(NULL), viewSize(0), index(NULL), frameCount(0)
+{
+}
+
+RecordingReader::~RecordingReader()
+{
+	Close();
+}
+
+bool RecordingReader::Open(const char* path)
+{
+	Close();
+
+#ifdef _WIN32
+	HANDLE handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (handle == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	fileHandle = handle;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(handle, &size) || size.QuadPart == 0)
+	{
+		Close();
+		return false;
+	}
+
+	viewSize = (uint64_t)size.QuadPart;
+
+	mappingHandle = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mappingHandle == NULL)
+	{
+		Close();
+		return false;
+	}
+
+	view = (const uint8_t*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	if (view == NULL)
+	{
+		Close();
+		return false;
+	}
+#else
+	fileDescriptor = open(path, O_RDONLY);
+	if (fileDescriptor < 0)
+	{
+		return false;
+	}
+
+	struct stat status;
+	if (fstat(fileDescriptor, &status) != 0 || status.st_size == 0)
+	{
+		Close();
+		return false;
+	}
+
+	viewSize = (uint64_t)status.st_size;
+
+	void* mapping = mmap(NULL, (size_t)viewSize, PROT_READ, MAP_SHARED, fileDescriptor, 0);
+	if (mapping == MAP_FAILED)
+	{
+		Close();
+		return false;
+	}
+
+	view = (const uint8_t*)mapping;
+#endif
+
+	//
+	// Validate everything up front so the accessors don't have to.
+	//
+	if (viewSize < sizeof(RECORDING_FILE_HEADER))
+	{
+		Close();
+		return false;
+	}
+
+	const RECORDING_FILE_HEADER* header = (const RECORDING_FILE_HEADER*)view;
+
+	if (header->Magic != RECORDING_MAGIC || header->Version != RECORDING_VERSION ||
+		header->IndexOffset < sizeof(RECORDING_FILE_HEADER) ||
+		header->IndexOffset > viewSize ||
+		(viewSize - header->IndexOffset) / sizeof(RECORDING_INDEX_ENTRY) < header->FrameCount)
+	{
+		Close();
+		return false;
+	}
+
+	index = (const RECORDING_INDEX_ENTRY*)(view + header->IndexOffset);
+
+	for (uint32_t frame = 0; frame < header->FrameCount; frame++)
+	{
+		if (index[frame].Offset > header->IndexOffset ||
+			header->IndexOffset - index[frame].Offset < index[frame].Size)
+		{
+			Close();
+			return false;
+		}
+	}
+
+	frameCount = header->FrameCount;
+
+	return true;
+}
+
+void RecordingReader::Close()
+{
+#ifdef _WIN32
+	if (view != NULL)
+	{
+		UnmapViewOfFile(view);
+	}
+
+	if (mappingHandle != NULL)
+	{
+		CloseHandle(mappingHandle);
+		mappingHandle = NULL;
+	}
+
+	if (fileHandle != NULL)
+	{
+		CloseHandle(fileHandle);
+		fileHandle = NULL;
+	}
+#else
+	if (view != NULL)
+	{
+		munmap((void*)view, (size_t)viewSize);
+	}
+
+	if (fileDescriptor >= 0)
+	{
+		close(fileDescriptor);
+		fileDescriptor = -1;
+	}
+#endif
+
+	view = NULL;
+	viewSize = 0;
+	index = NULL;
+	frameCount = 0;
+}
+
+void RecordingReader::Prefetch(uint32_t first, uint32_t count)
+{
+	if (first >= frameCount)
+	{
+		return;
+	}
+
+	if (count > frameCount - first)
+	{
+		count = frameCount - first;
+	}
+
+	if (count == 0)
+	{
+		return;
+	}
+
+	//
+	// Frames are stored in order, so the range is contiguous in the file.
+	//
+	uint64_t start = index[first].Offset;
+	uint64_t end = index[first + count - 1].Offset + index[first + count - 1].Size;
+
+#ifdef _WIN32
+	WIN32_MEMORY_RANGE_ENTRY range;
+	range.VirtualAddress = (PVOID)(view + start);
+	range.NumberOfBytes = (SIZE_T)(end - start);
+
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+	long pageSize = sysconf(_SC_PAGESIZE);
+	uint64_t alignedStart = start & ~(uint64_t)(pageSize - 1);
+
+	madvise((void*)(view + alignedStart), (size_t)(end - alignedStart), MADV_WILLNEED);
+#endif
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+//
+// Frame recording container.
+//
+// A recording is a file header, the frame payloads back to back (each
+// aligned to RECORDING_ALIGNMENT) and an index of every frame at the end.
+// The index is written when the recording is closed; the header points at
+// it.  All fields are little endian.
+//
+// This file and Recording.cpp only depend on the C++ standard library and
+// the OS file mapping APIs so the container can be used outside of the
+// DriverInterface DLL.
+//
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define RECORDING_MAGIC 0x43455256 // "VREC"
+#define RECORDING_VERSION 1
+#define RECORDING_ALIGNMENT 64
+
+//
+// Payload formats.
+//
+#define RECORDING_FORMAT_RGB24 1
+#define RECORDING_FORMAT_BGRA 2
+#define RECORDING_FORMAT_RGBA 3
+#define RECORDING_FORMAT_NV12 4
+#define RECORDING_FORMAT_I420 5
+#define RECORDING_FORMAT_YUY2 6
+#define RECORDING_FORMAT_RGB48 7
+#define RECORDING_FORMAT_RGBA64 8
+#define RECORDING_FORMAT_P010 9
+
+#pragma pack(push, 8)
+
+typedef struct _RECORDING_FILE_HEADER {
+	uint32_t Magic;
+	uint32_t Version;
+	uint32_t FrameCount;
+	uint32_t Reserved;
+	uint64_t IndexOffset;
+} RECORDING_FILE_HEADER;
+
+typedef struct _RECORDING_INDEX_ENTRY {
+	int64_t Timestamp;
+	uint64_t Offset;
+	uint32_t Size;
+	uint32_t Format;
+	uint32_t Width;
+	uint32_t Height;
+} RECORDING_INDEX_ENTRY;
+
+#pragma pack(pop)
+
+//
+// RecordingWriter:
+//
+// Appends frames to a recording from a background thread.  Submit copies
+// the frame into one of a fixed number of buffers and returns; if all of
+// them are waiting to be written the frame is dropped rather than stalling
+// the producer.
+//
+class RecordingWriter
+{
+private:
+	struct PendingFrame
+	{
+		RECORDING_INDEX_ENTRY entry;
+		uint8_t* data;
+	};
+
+	FILE* file;
+	uint64_t fileOffset;
+	std::vector<RECORDING_INDEX_ENTRY> index;
+
+	uint32_t bufferSize;
+	std::vector<uint8_t*> freeBuffers;
+	std::deque<PendingFrame> pending;
+
+	std::mutex lock;
+	std::condition_variable wake;
+	std::thread thread;
+	bool stopping;
+	bool failed;
+	uint32_t droppedFrames;
+
+	void WriterThread();
+	bool WriteFrame(PendingFrame& frame);
+
+public:
+	RecordingWriter();
+	~RecordingWriter();
+
+	// Creates the file.  bufferSize is the largest frame which will be
+	// submitted, bufferCount how many frames may be queued.
+	bool Open(const char* path, uint32_t bufferSize, uint32_t bufferCount);
+
+	// Queues a frame for writing.  Returns false if it was dropped.
+	bool Submit(const void* data, uint32_t size, int64_t timestamp, uint32_t format, uint32_t width, uint32_t height);
+
+	// Writes the queued frames and the index.  Returns false if any write
+	// failed.
+	bool Close();
+
+	uint32_t GetDroppedFrames();
+};
+
+//
+// RecordingReader:
+//
+// Maps a recording into memory and gives direct access to the frames.
+//
+class RecordingReader
+{
+private:
+#ifdef _WIN32
+	void* fileHandle;
+	void* mappingHandle;
+#else
+	int fileDescriptor;
+#endif
+	const uint8_t* view;
+	uint64_t viewSize;
+
+	const RECORDING_INDEX_ENTRY* index;
+	uint32_t frameCount;
+
+public:
+	RecordingReader();
+	~RecordingReader();
+
+	// Maps the file and validates the header and index.
+	bool Open(const char* path);
+	void Close();
+
+	uint32_t GetFrameCount() { return frameCount; }
+	const RECORDING_INDEX_ENTRY* GetEntry(uint32_t frame) { return &index[frame]; }
+	const uint8_t* GetFrame(uint32_t frame) { return view + index[frame].Offset; }
+
+	// Asks the OS to start reading frames [first, first + count) in so that
+	// touching them later does not block on I/O.
+	void Prefetch(uint32_t first, uint32_t count);
+};
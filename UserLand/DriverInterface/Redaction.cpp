@@ -0,0 +1,679 @@
+#include "Redaction.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define REDACTION_X86
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define REDACTION_TARGET_SSE2
+#else
+#include <cpuid.h>
+#define REDACTION_TARGET_SSE2 __attribute__((target("sse2")))
+#endif
+#endif
+
+/*
+	Row kernels
+*/
+
+template <typename SAMPLE>
+static void AccumulateRowPortable(uint32_t* sums, const SAMPLE* row, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++)
+	{
+		sums[i] += row[i];
+	}
+}
+
+//
+// The sums stay below 2^24, so they convert to float exactly and the
+// SSE2 versions round the same.
+//
+template <typename SAMPLE>
+static void SlideRowPortable(SAMPLE* destination, uint32_t* sums, const SAMPLE* add, const SAMPLE* subtract, uint32_t count, float inverse)
+{
+	for (uint32_t i = 0; i < count; i++)
+	{
+		destination[i] = (SAMPLE)(int32_t)((float)(int32_t)sums[i] * inverse + 0.5f);
+		sums[i] += add[i];
+		sums[i] -= subtract[i];
+	}
+}
+
+template <typename SAMPLE>
+static void SlideQuadsPortable(SAMPLE* destination, uint32_t* sums, const SAMPLE* add, const SAMPLE* subtract, uint32_t pixels, float inverse)
+{
+	for (uint32_t i = 0; i < pixels; i++, destination += 4, add += 4, subtract += 4)
+	{
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			destination[c] = (SAMPLE)(int32_t)((float)(int32_t)sums[c] * inverse + 0.5f);
+			sums[c] += add[c];
+			sums[c] -= subtract[c];
+		}
+	}
+}
+
+#ifdef REDACTION_X86
+
+static bool HasSse2()
+{
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	return true;
+#else
+	static const bool supported = []
+	{
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 1);
+		return (info[3] & (1 << 26)) != 0;
+#else
+		unsigned int eax, ebx, ecx, edx;
+		return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (edx & bit_SSE2) != 0;
+#endif
+	}();
+
+	return supported;
+#endif
+}
+
+//
+// Adds 8 16 bit values to 8 sums.
+//
+REDACTION_TARGET_SSE2
+static inline void AccumulateOctet(uint32_t* sums, __m128i values)
+{
+	const __m128i zero = _mm_setzero_si128();
+
+	__m128i low = _mm_loadu_si128((const __m128i*)sums);
+	__m128i high = _mm_loadu_si128((const __m128i*)(sums + 4));
+
+	_mm_storeu_si128((__m128i*)sums, _mm_add_epi32(low, _mm_unpacklo_epi16(values, zero)));
+	_mm_storeu_si128((__m128i*)(sums + 4), _mm_add_epi32(high, _mm_unpackhi_epi16(values, zero)));
+}
+
+//
+// Returns 8 sums times inverse, rounded, as 32 bit values, and adds the
+// 16 bit add values less the subtract values to the sums.
+//
+REDACTION_TARGET_SSE2
+static inline void SlideOctet(uint32_t* sums, __m128i add, __m128i subtract, __m128 inverse, __m128i* low, __m128i* high)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128 half = _mm_set1_ps(0.5f);
+
+	__m128i sumsLow = _mm_loadu_si128((const __m128i*)sums);
+	__m128i sumsHigh = _mm_loadu_si128((const __m128i*)(sums + 4));
+
+	*low = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(sumsLow), inverse), half));
+	*high = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(sumsHigh), inverse), half));
+
+	sumsLow = _mm_sub_epi32(_mm_add_epi32(sumsLow, _mm_unpacklo_epi16(add, zero)), _mm_unpacklo_epi16(subtract, zero));
+	sumsHigh = _mm_sub_epi32(_mm_add_epi32(sumsHigh, _mm_unpackhi_epi16(add, zero)), _mm_unpackhi_epi16(subtract, zero));
+
+	_mm_storeu_si128((__m128i*)sums, sumsLow);
+	_mm_storeu_si128((__m128i*)(sums + 4), sumsHigh);
+}
+
+REDACTION_TARGET_SSE2
+static void AccumulateRowSse2(uint32_t* sums, const uint8_t* row, uint32_t count)
+{
+	const __m128i zero = _mm_setzero_si128();
+
+	uint32_t i = 0;
+
+	for (; i + 16 <= count; i += 16)
+	{
+		__m128i values = _mm_loadu_si128((const __m128i*)(row + i));
+
+		AccumulateOctet(sums + i, _mm_unpacklo_epi8(values, zero));
+		AccumulateOctet(sums + i + 8, _mm_unpackhi_epi8(values, zero));
+	}
+
+	AccumulateRowPortable(sums + i, row + i, count - i);
+}
+
+REDACTION_TARGET_SSE2
+static void AccumulateRowSse2(uint32_t* sums, const uint16_t* row, uint32_t count)
+{
+	uint32_t i = 0;
+
+	for (; i + 8 <= count; i += 8)
+	{
+		AccumulateOctet(sums + i, _mm_loadu_si128((const __m128i*)(row + i)));
+	}
+
+	AccumulateRowPortable(sums + i, row + i, count - i);
+}
+
+REDACTION_TARGET_SSE2
+static void SlideRowSse2(uint8_t* destination, uint32_t* sums, const uint8_t* add, const uint8_t* subtract, uint32_t count, float inverse)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128 scale = _mm_set1_ps(inverse);
+
+	uint32_t i = 0;
+
+	for (; i + 16 <= count; i += 16)
+	{
+		__m128i added = _mm_loadu_si128((const __m128i*)(add + i));
+		__m128i subtracted = _mm_loadu_si128((const __m128i*)(subtract + i));
+		__m128i a, b, c, d;
+
+		SlideOctet(sums + i, _mm_unpacklo_epi8(added, zero), _mm_unpacklo_epi8(subtracted, zero), scale, &a, &b);
+		SlideOctet(sums + i + 8, _mm_unpackhi_epi8(added, zero), _mm_unpackhi_epi8(subtracted, zero), scale, &c, &d);
+
+		_mm_storeu_si128((__m128i*)(destination + i),
+			_mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d)));
+	}
+
+	SlideRowPortable(destination + i, sums + i, add + i, subtract + i, count - i, inverse);
+}
+
+REDACTION_TARGET_SSE2
+static void SlideRowSse2(uint16_t* destination, uint32_t* sums, const uint16_t* add, const uint16_t* subtract, uint32_t count, float inverse)
+{
+	const __m128 scale = _mm_set1_ps(inverse);
+	const __m128i bias = _mm_set1_epi32(32768);
+	const __m128i sign = _mm_set1_epi16((short)0x8000);
+
+	uint32_t i = 0;
+
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i a, b;
+
+		SlideOctet(sums + i,
+			_mm_loadu_si128((const __m128i*)(add + i)), _mm_loadu_si128((const __m128i*)(subtract + i)), scale, &a, &b);
+
+		//
+		// SSE2 only packs to signed 16 bits, so pack around the middle of
+		// the unsigned range.
+		//
+		__m128i packed = _mm_packs_epi32(_mm_sub_epi32(a, bias), _mm_sub_epi32(b, bias));
+		_mm_storeu_si128((__m128i*)(destination + i), _mm_xor_si128(packed, sign));
+	}
+
+	SlideRowPortable(destination + i, sums + i, add + i, subtract + i, count - i, inverse);
+}
+
+//
+// The sums of a quad stay in a register along the row.
+//
+REDACTION_TARGET_SSE2
+static void SlideQuadsSse2(uint8_t* destination, uint32_t* sums, const uint8_t* add, const uint8_t* subtract, uint32_t pixels, float inverse)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128 scale = _mm_set1_ps(inverse);
+	const __m128 half = _mm_set1_ps(0.5f);
+
+	__m128i s = _mm_loadu_si128((const __m128i*)sums);
+
+	for (uint32_t i = 0; i < pixels; i++)
+	{
+		__m128i value = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(s), scale), half));
+		int32_t packed = _mm_cvtsi128_si32(_mm_packus_epi16(_mm_packs_epi32(value, value), zero));
+		int32_t added;
+		int32_t subtracted;
+
+		memcpy(destination + i * 4, &packed, sizeof(packed));
+		memcpy(&added, add + i * 4, sizeof(added));
+		memcpy(&subtracted, subtract + i * 4, sizeof(subtracted));
+
+		s = _mm_add_epi32(s, _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(added), zero), zero));
+		s = _mm_sub_epi32(s, _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(subtracted), zero), zero));
+	}
+
+	_mm_storeu_si128((__m128i*)sums, s);
+}
+
+REDACTION_TARGET_SSE2
+static void SlideQuadsSse2(uint16_t* destination, uint32_t* sums, const uint16_t* add, const uint16_t* subtract, uint32_t pixels, float inverse)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128 scale = _mm_set1_ps(inverse);
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128i bias = _mm_set1_epi32(32768);
+	const __m128i sign = _mm_set1_epi16((short)0x8000);
+
+	__m128i s = _mm_loadu_si128((const __m128i*)sums);
+
+	for (uint32_t i = 0; i < pixels; i++)
+	{
+		__m128i value = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(s), scale), half));
+		value = _mm_xor_si128(_mm_packs_epi32(_mm_sub_epi32(value, bias), zero), sign);
+
+		_mm_storel_epi64((__m128i*)(destination + i * 4), value);
+
+		s = _mm_add_epi32(s, _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)(add + i * 4)), zero));
+		s = _mm_sub_epi32(s, _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)(subtract + i * 4)), zero));
+	}
+
+	_mm_storeu_si128((__m128i*)sums, s);
+}
+
+#endif // REDACTION_X86
+
+void AccumulateRow(uint32_t* sums, const uint8_t* row, uint32_t count)
+{
+#ifdef REDACTION_X86
+	if (HasSse2())
+	{
+		AccumulateRowSse2(sums, row, count);
+		return;
+	}
+#endif
+
+	AccumulateRowPortable(sums, row, count);
+}
+
+void AccumulateRow(uint32_t* sums, const uint16_t* row, uint32_t count)
+{
+#ifdef REDACTION_X86
+	if (HasSse2())
+	{
+		AccumulateRowSse2(sums, row, count);
+		return;
+	}
+#endif
+
+	AccumulateRowPortable(sums, row, count);
+}
+
+void SlideRow(uint8_t* destination, uint32_t* sums, const uint8_t* add, const uint8_t* subtract, uint32_t count, float inverse)
+{
+#ifdef REDACTION_X86
+	if (HasSse2())
+	{
+		SlideRowSse2(destination, sums, add, subtract, count, inverse);
+		return;
+	}
+#endif
+
+	SlideRowPortable(destination, sums, add, subtract, count, inverse);
+}
+
+void SlideRow(uint16_t* destination, uint32_t* sums, const uint16_t* add, const uint16_t* subtract, uint32_t count, float inverse)
+{
+#ifdef REDACTION_X86
+	if (HasSse2())
+	{
+		SlideRowSse2(destination, sums, add, subtract, count, inverse);
+		return;
+	}
+#endif
+
+	SlideRowPortable(destination, sums, add, subtract, count, inverse);
+}
+
+void SlideQuads(uint8_t* destination, uint32_t* sums, const uint8_t* add, const uint8_t* subtract, uint32_t pixels, float inverse)
+{
+#ifdef REDACTION_X86
+	if (HasSse2())
+	{
+		SlideQuadsSse2(destination, sums, add, subtract, pixels, inverse);
+		return;
+	}
+#endif
+
+	SlideQuadsPortable(destination, sums, add, subtract, pixels, inverse);
+}
+
+void SlideQuads(uint16_t* destination, uint32_t* sums, const uint16_t* add, const uint16_t* subtract, uint32_t pixels, float inverse)
+{
+#ifdef REDACTION_X86
+	if (HasSse2())
+	{
+		SlideQuadsSse2(destination, sums, add, subtract, pixels, inverse);
+		return;
+	}
+#endif
+
+	SlideQuadsPortable(destination, sums, add, subtract, pixels, inverse);
+}
+
+/*
+	Redactor
+*/
+
+Redactor::Redactor()
+	: width(0), height(0), nextId(1)
+{
+}
+
+void Redactor::SetSize(uint32_t width, uint32_t height)
+{
+	if (width == this->width && height == this->height)
+	{
+		return;
+	}
+
+	this->width = width;
+	this->height = height;
+
+	regions.clear();
+}
+
+int Redactor::AddRegion(int x, int y, uint32_t width, uint32_t height, uint32_t mode, uint32_t size)
+{
+	if (regions.size() >= REDACTION_MAX_REGIONS)
+	{
+		return 0;
+	}
+
+	if ((mode == REDACTION_PIXELATE && (size < 2 || size > REDACTION_BLOCK_MAX)) ||
+		(mode == REDACTION_BLUR && (size < 1 || size > REDACTION_RADIUS_MAX)) ||
+		mode > REDACTION_BLUR)
+	{
+		return 0;
+	}
+
+	Region region;
+	region.mode = mode;
+	region.size = size;
+	region.left = (uint32_t)std::max<int64_t>(x, 0);
+	region.top = (uint32_t)std::max<int64_t>(y, 0);
+	region.right = (uint32_t)std::max<int64_t>(std::min<int64_t>((int64_t)x + width, this->width), 0);
+	region.bottom = (uint32_t)std::max<int64_t>(std::min<int64_t>((int64_t)y + height, this->height), 0);
+
+	if (region.left >= region.right || region.top >= region.bottom)
+	{
+		return 0;
+	}
+
+	region.id = nextId++;
+	regions.push_back(region);
+
+	return region.id;
+}
+
+bool Redactor::RemoveRegion(int id)
+{
+	for (size_t i = 0; i < regions.size(); i++)
+	{
+		if (regions[i].id == id)
+		{
+			regions.erase(regions.begin() + i);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void Redactor::ClearRegions()
+{
+	regions.clear();
+}
+
+//
+// Replaces each blockWidth x blockHeight block of the rectangle, counted
+// from its top left corner, with its rounded average.  The column sums of
+// a band of blocks are taken once, the band's row is built once and copied
+// to each of its rows.
+//
+template <typename SAMPLE, uint32_t Components>
+void Redactor::Pixelate(uint8_t* plane, int32_t stride, uint32_t left, uint32_t top, uint32_t right, uint32_t bottom, uint32_t blockWidth, uint32_t blockHeight)
+{
+	uint32_t columns = right - left;
+	uint32_t count = columns * Components;
+
+	sums.resize(count);
+	row.resize(count * sizeof(SAMPLE));
+
+	SAMPLE* pixelated = (SAMPLE*)row.data();
+
+	for (uint32_t band = top; band < bottom; band += blockHeight)
+	{
+		uint32_t bandBottom = std::min(band + blockHeight, bottom);
+
+		memset(sums.data(), 0, count * sizeof(uint32_t));
+
+		for (uint32_t y = band; y < bandBottom; y++)
+		{
+			AccumulateRow(sums.data(), (const SAMPLE*)(plane + (int64_t)stride * y) + left * Components, count);
+		}
+
+		for (uint32_t x = 0; x < columns; x += blockWidth)
+		{
+			uint32_t blockRight = std::min(x + blockWidth, columns);
+			uint64_t cells = (uint64_t)(blockRight - x) * (bandBottom - band);
+
+			for (uint32_t c = 0; c < Components; c++)
+			{
+				uint64_t total = 0;
+
+				for (uint32_t column = x; column < blockRight; column++)
+				{
+					total += sums[column * Components + c];
+				}
+
+				SAMPLE average = (SAMPLE)((total + cells / 2) / cells);
+
+				for (uint32_t column = x; column < blockRight; column++)
+				{
+					pixelated[column * Components + c] = average;
+				}
+			}
+		}
+
+		for (uint32_t y = band; y < bandBottom; y++)
+		{
+			memcpy((SAMPLE*)(plane + (int64_t)stride * y) + left * Components, pixelated, count * sizeof(SAMPLE));
+		}
+	}
+}
+
+//
+// Box blurs the rectangle: each row is blurred horizontally into a ring of
+// 2 * radiusY + 2 rows as the vertical pass reaches it, and the vertical
+// pass slides a window of column sums down the ring, writing each row back
+// once its horizontal input has been taken.  Samples beyond the
+// rectangle's edges repeat the edge.
+//
+template <typename SAMPLE, uint32_t Components>
+void Redactor::Blur(uint8_t* plane, int32_t stride, uint32_t left, uint32_t top, uint32_t right, uint32_t bottom, uint32_t radiusX, uint32_t radiusY)
+{
+	uint32_t columns = right - left;
+	uint32_t count = columns * Components;
+	uint32_t ringRows = 2 * radiusY + 2;
+
+	sums.resize(count);
+	rows.resize((size_t)ringRows * count * sizeof(SAMPLE));
+
+	float inverseX = 1.0f / (2 * radiusX + 1);
+	float inverseY = 1.0f / (2 * radiusY + 1);
+
+	auto ringRow = [&](uint32_t y) -> SAMPLE*
+	{
+		return (SAMPLE*)rows.data() + (size_t)((y - top) % ringRows) * count;
+	};
+
+	//
+	// The window is clamped to the row only near its ends; in between the
+	// components of a pixel are slid together without bounds checks.
+	//
+	auto blurRow = [&](uint32_t y)
+	{
+		const SAMPLE* input = (const SAMPLE*)(plane + (int64_t)stride * y) + left * Components;
+		SAMPLE* output = ringRow(y);
+		uint32_t sum[Components];
+
+		for (uint32_t c = 0; c < Components; c++)
+		{
+			sum[c] = (radiusX + 1) * input[c];
+
+			for (uint32_t k = 1; k <= radiusX; k++)
+			{
+				sum[c] += input[std::min(k, columns - 1) * Components + c];
+			}
+		}
+
+		uint32_t middleLeft = std::min(radiusX, columns);
+		uint32_t middleRight = (columns > radiusX + 1) ? std::max(columns - radiusX - 1, middleLeft) : middleLeft;
+		uint32_t x = 0;
+
+		for (; x < middleLeft; x++)
+		{
+			for (uint32_t c = 0; c < Components; c++)
+			{
+				output[x * Components + c] = (SAMPLE)(int32_t)((float)(int32_t)sum[c] * inverseX + 0.5f);
+				sum[c] += input[std::min(x + radiusX + 1, columns - 1) * Components + c];
+				sum[c] -= input[c];
+			}
+		}
+
+		if (x < middleRight && Components == 4)
+		{
+			SlideQuads(
+				output + x * Components,
+				sum,
+				input + (x + radiusX + 1) * Components,
+				input + (x - radiusX) * Components,
+				middleRight - x,
+				inverseX);
+
+			x = middleRight;
+		}
+		else if (x < middleRight)
+		{
+			const SAMPLE* entering = input + (x + radiusX + 1) * Components;
+			const SAMPLE* leaving = input + (x - radiusX) * Components;
+
+			for (; x < middleRight; x++, entering += Components, leaving += Components)
+			{
+				for (uint32_t c = 0; c < Components; c++)
+				{
+					output[x * Components + c] = (SAMPLE)(int32_t)((float)(int32_t)sum[c] * inverseX + 0.5f);
+					sum[c] += entering[c];
+					sum[c] -= leaving[c];
+				}
+			}
+		}
+
+		for (; x < columns; x++)
+		{
+			for (uint32_t c = 0; c < Components; c++)
+			{
+				output[x * Components + c] = (SAMPLE)(int32_t)((float)(int32_t)sum[c] * inverseX + 0.5f);
+				sum[c] += input[(columns - 1) * Components + c];
+				sum[c] -= input[(x > radiusX ? x - radiusX : 0) * Components + c];
+			}
+		}
+	};
+
+	for (uint32_t y = top; y <= std::min(top + radiusY, bottom - 1); y++)
+	{
+		blurRow(y);
+	}
+
+	memset(sums.data(), 0, count * sizeof(uint32_t));
+
+	for (uint32_t k = 0; k <= radiusY; k++)
+	{
+		AccumulateRow(sums.data(), ringRow(top), count);
+	}
+
+	for (uint32_t k = 1; k <= radiusY; k++)
+	{
+		AccumulateRow(sums.data(), ringRow(std::min(top + k, bottom - 1)), count);
+	}
+
+	for (uint32_t y = top; y < bottom; y++)
+	{
+		uint32_t next = y + radiusY + 1;
+
+		//
+		// The slot of the row entering the window is the one of the row
+		// which left it the step before.
+		//
+		if (next < bottom)
+		{
+			blurRow(next);
+		}
+
+		SlideRow(
+			(SAMPLE*)(plane + (int64_t)stride * y) + left * Components,
+			sums.data(),
+			ringRow(std::min(next, bottom - 1)),
+			ringRow(y >= top + radiusY ? y - radiusY : top),
+			count,
+			inverseY);
+	}
+}
+
+template <typename SAMPLE, uint32_t Components>
+void Redactor::ApplyPlane(uint8_t* plane, int32_t stride, uint32_t shiftX, uint32_t shiftY)
+{
+	uint32_t planeWidth = width >> shiftX;
+	uint32_t planeHeight = height >> shiftY;
+
+	for (const Region& region : regions)
+	{
+		uint32_t left = region.left >> shiftX;
+		uint32_t top = region.top >> shiftY;
+		uint32_t right = std::min((region.right + (1 << shiftX) - 1) >> shiftX, planeWidth);
+		uint32_t bottom = std::min((region.bottom + (1 << shiftY) - 1) >> shiftY, planeHeight);
+
+		if (left >= right || top >= bottom)
+		{
+			continue;
+		}
+
+		uint32_t sizeX = std::max(region.size >> shiftX, 1u);
+		uint32_t sizeY = std::max(region.size >> shiftY, 1u);
+
+		if (region.mode == REDACTION_PIXELATE)
+		{
+			Pixelate<SAMPLE, Components>(plane, stride, left, top, right, bottom, sizeX, sizeY);
+		}
+		else
+		{
+			Blur<SAMPLE, Components>(plane, stride, left, top, right, bottom, sizeX, sizeY);
+		}
+	}
+}
+
+bool Redactor::Apply(uint8_t* plane, int32_t stride, uint32_t bytesPerSample, uint32_t components, uint32_t shiftX, uint32_t shiftY)
+{
+	if (shiftX > 1 || shiftY > 1)
+	{
+		return false;
+	}
+
+	switch (bytesPerSample * 8 + components)
+	{
+	case 8 + 1:
+		ApplyPlane<uint8_t, 1>(plane, stride, shiftX, shiftY);
+		break;
+	case 8 + 2:
+		ApplyPlane<uint8_t, 2>(plane, stride, shiftX, shiftY);
+		break;
+	case 8 + 3:
+		ApplyPlane<uint8_t, 3>(plane, stride, shiftX, shiftY);
+		break;
+	case 8 + 4:
+		ApplyPlane<uint8_t, 4>(plane, stride, shiftX, shiftY);
+		break;
+	case 16 + 1:
+		ApplyPlane<uint16_t, 1>(plane, stride, shiftX, shiftY);
+		break;
+	case 16 + 2:
+		ApplyPlane<uint16_t, 2>(plane, stride, shiftX, shiftY);
+		break;
+	case 16 + 3:
+		ApplyPlane<uint16_t, 3>(plane, stride, shiftX, shiftY);
+		break;
+	case 16 + 4:
+		ApplyPlane<uint16_t, 4>(plane, stride, shiftX, shiftY);
+		break;
+	default:
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+//
+// Privacy redaction.
+//
+// Rectangles of the frame (whiteboards, badges, screens) are pixelated or
+// blurred before the frame leaves the process.  Pixelation replaces each
+// block of the rectangle with its average; blurring is a separable box
+// blur, each pass a running sum, so both cost the same per pixel whatever
+// the block size or radius.  Pixels outside a rectangle are neither
+// changed nor read: the blur repeats the rectangle's edge instead.
+//
+// Redaction works on one plane at a time, of 8 or 16 bit samples and 1 to
+// 4 interleaved components, so every frame format can be redacted before
+// the driver converts it; subsampled planes take the rectangles scaled
+// down and rounded outwards.  Only the rows rectangles cover are touched.
+// The scratch rows are kept between frames.
+//
+// The row kernels use SSE2 on x86 and x64; other targets use the portable
+// versions, which give the same results.
+//
+
+#include <stdint.h>
+
+#include <vector>
+
+#define REDACTION_PIXELATE 0
+#define REDACTION_BLUR 1
+
+#define REDACTION_MAX_REGIONS 16
+#define REDACTION_BLOCK_MAX 256
+#define REDACTION_RADIUS_MAX 64
+
+class Redactor
+{
+private:
+	struct Region
+	{
+		int id;
+		uint32_t mode;
+		uint32_t size;
+
+		// Clipped to the frame.
+		uint32_t left;
+		uint32_t top;
+		uint32_t right;
+		uint32_t bottom;
+	};
+
+	uint32_t width;
+	uint32_t height;
+
+	std::vector<Region> regions;
+	int nextId;
+
+	// Column sums, the blur's ring of horizontally blurred rows and a
+	// pixelated row.
+	std::vector<uint32_t> sums;
+	std::vector<uint8_t> rows;
+	std::vector<uint8_t> row;
+
+	template <typename SAMPLE, uint32_t Components>
+	void Pixelate(uint8_t* plane, int32_t stride, uint32_t left, uint32_t top, uint32_t right, uint32_t bottom, uint32_t blockWidth, uint32_t blockHeight);
+
+	template <typename SAMPLE, uint32_t Components>
+	void Blur(uint8_t* plane, int32_t stride, uint32_t left, uint32_t top, uint32_t right, uint32_t bottom, uint32_t radiusX, uint32_t radiusY);
+
+	template <typename SAMPLE, uint32_t Components>
+	void ApplyPlane(uint8_t* plane, int32_t stride, uint32_t shiftX, uint32_t shiftY);
+
+public:
+	Redactor();
+
+	// Sets the frame size.  Regions are dropped.
+	void SetSize(uint32_t width, uint32_t height);
+
+	// Adds a rectangle and returns its id, or 0 if the rectangle doesn't
+	// overlap the frame, too many are set or size is out of range.  size
+	// is the block size for REDACTION_PIXELATE (2 to REDACTION_BLOCK_MAX)
+	// or the radius for REDACTION_BLUR (1 to REDACTION_RADIUS_MAX).
+	int AddRegion(int x, int y, uint32_t width, uint32_t height, uint32_t mode, uint32_t size);
+	bool RemoveRegion(int id);
+	void ClearRegions();
+
+	bool IsEmpty() { return regions.empty(); }
+	uint32_t GetWidth() { return width; }
+	uint32_t GetHeight() { return height; }
+
+	// Redacts a plane of the frame set with SetSize, subsampled by
+	// 1 << shiftX horizontally and 1 << shiftY vertically.
+	// bytesPerSample is 1 or 2; a sample of the plane is components
+	// interleaved values (YUY2 is 4 components, shifted by 1).
+	bool Apply(uint8_t* plane, int32_t stride, uint32_t bytesPerSample, uint32_t components, uint32_t shiftX, uint32_t shiftY);
+};
+
+//
+// Row kernels, over count values.
+//
+
+// sums[i] += row[i]
+void AccumulateRow(uint32_t* sums, const uint8_t* row, uint32_t count);
+void AccumulateRow(uint32_t* sums, const uint16_t* row, uint32_t count);
+
+// destination[i] = sums[i] * inverse rounded, then
+// sums[i] += add[i] - subtract[i]
+void SlideRow(uint8_t* destination, uint32_t* sums, const uint8_t* add, const uint8_t* subtract, uint32_t count, float inverse);
+void SlideRow(uint16_t* destination, uint32_t* sums, const uint16_t* add, const uint16_t* subtract, uint32_t count, float inverse);
+
+// SlideRow along a row of 4 component pixels, with one sum per component:
+// destination[4i + c] = sums[c] * inverse rounded, then
+// sums[c] += add[4i + c] - subtract[4i + c]
+void SlideQuads(uint8_t* destination, uint32_t* sums, const uint8_t* add, const uint8_t* subtract, uint32_t pixels, float inverse);
+void SlideQuads(uint16_t* destination, uint32_t* sums, const uint16_t* add, const uint16_t* subtract, uint32_t pixels, float inverse);
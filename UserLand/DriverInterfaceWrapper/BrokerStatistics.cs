@@ -0,0 +1,38 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Runtime.InteropServices;
+using System.Text;
+using System.Threading.Tasks;
+
+namespace DriverInterfaceWrapper
+{
+    /// <summary>
+    /// Counters of the frame broker since it was started. Producers' counters are
+    /// only included while they are connected.
+    /// Must match BROKER_STATISTICS in DriverInterface's Broker.h.
+    /// </summary>
+    [StructLayout(LayoutKind.Sequential)]
+    public struct BrokerStatistics
+    {
+        public uint Size;
+
+        /// <summary>Cameras fed by the broker.</summary>
+        public uint Cameras;
+
+        /// <summary>Connected producers, feeds and layers.</summary>
+        public uint Producers;
+
+        /// <summary>Frames published by the connected producers.</summary>
+        public uint FramesPublished;
+
+        /// <summary>Frames replaced by a newer one before the broker took them.</summary>
+        public uint FramesReplaced;
+
+        /// <summary>Frames handed to the cameras.</summary>
+        public uint FramesForwarded;
+
+        /// <summary>Frames the cameras refused.</summary>
+        public uint FramesRejected;
+    }
+}
@@ -6,6 +6,66 @@ using System.Threading.Tasks;
 
 namespace DriverInterfaceWrapper
 {
+    public enum FrameRateConversion
+    {
+        Latest = 0,
+        Nearest = 1,
+        Blend = 2
+    }
+
+    public enum FrameStaging
+    {
+        Native = 0,
+        Nv12 = 1
+    }
+
+    public enum CaptureMode
+    {
+        Mapped = 0,
+        Copy = 1
+    }
+
+    public enum TimestampMode
+    {
+        Clock = 0,
+        Schedule = 1
+    }
+
+    public enum FrameFormat
+    {
+        Rgb24 = 0,
+        Bgra = 1,
+        Rgba = 2,
+        Nv12 = 3,
+        I420 = 4,
+        Yuy2 = 5,
+        Rgb48 = 6,
+        Rgba64 = 7,
+        P010 = 8
+    }
+
+    public enum ProbeFormat
+    {
+        Rgb24 = 0,
+        Rgb32 = 1,
+        Yuy2 = 2,
+        Uyvy = 3,
+        Y8 = 4,
+        Y16 = 5
+    }
+
+    public enum RedactionMode
+    {
+        Pixelate = 0,
+        Blur = 1
+    }
+
+    public enum BrokerRole
+    {
+        Feed = 0,
+        Layer = 1
+    }
+
     public class DriverInterface
     {
         public const int Width = 1280;
@@ -48,5 +108,311 @@ namespace DriverInterfaceWrapper
         {
             return (Native.SetBuffer(data, stride, width, height) > 0); 
         }
+
+        public const int MaxMetadataLength = 64;
+
+        /// <summary>
+        /// Returns the current time in the timestamp domain expected by SetData (100ns units of the performance counter).
+        /// </summary>
+        public static long GetTimestamp()
+        {
+            return Native.GetTimestamp();
+        }
+
+        public static bool SetData(IntPtr data, int stride, int width, int height, long timestamp, byte[] metadata = null)
+        {
+            int metadataLength = (metadata != null) ? metadata.Length : 0;
+
+            return (Native.SetBufferEx(data, stride, width, height, timestamp, metadata, metadataLength) > 0);
+        }
+
+        /// <summary>
+        /// Sends a frame in any FrameFormat; the driver converts it.  A GDI+
+        /// 32bpp bitmap can be passed as FrameFormat.Bgra without a copy.
+        /// For Nv12 and I420 the chroma planes follow the luma plane.
+        /// </summary>
+        public static bool SetData(IntPtr data, int stride, int width, int height, FrameFormat format, long timestamp = 0, byte[] metadata = null)
+        {
+            int metadataLength = (metadata != null) ? metadata.Length : 0;
+            return (Native.SetBufferFormat(data, stride, width, height, (int)format, timestamp, metadata, metadataLength) > 0);
+        }
+
+        /// <summary>
+        /// Selects how frames set at the producer's rate are converted to the camera's output rate.
+        /// Latest is the default. Nearest and Blend use the timestamps passed to SetData (or the arrival time if none)
+        /// and delay the output by one frame period.
+        /// </summary>
+        public static bool SetFrameRateConversion(FrameRateConversion mode)
+        {
+            return (Native.SetFrameRateConversion((int)mode) > 0);
+        }
+
+        /// <summary>
+        /// Selects how the driver stores frames. Nv12 saves memory at the cost of a conversion per delivered frame.
+        /// Takes effect the next time the camera starts streaming.
+        /// </summary>
+        public static bool SetStaging(FrameStaging mode)
+        {
+            return (Native.SetStaging((int)mode) > 0);
+        }
+
+        /// <summary>
+        /// Sets the image the camera starts streaming with when no frame has been set since it last ran.
+        /// Without a slate it starts with the last frame it showed, or black if there is none.
+        /// </summary>
+        public static bool SetSlate(IntPtr data, int stride, int width, int height, FrameFormat format)
+        {
+            return (Native.SetSlate(data, stride, width, height, (int)format) > 0);
+        }
+
+        /// <summary>
+        /// Clears the slate set with SetSlate.
+        /// </summary>
+        public static bool ClearSlate()
+        {
+            return (Native.SetSlate(IntPtr.Zero, 0, 0, 0, 0) > 0);
+        }
+
+        /// <summary>
+        /// Shows a "no signal" slate once no frame has been set for the timeout, in milliseconds, until frames are set again.
+        /// Zero turns it off. Turning it on takes effect the next time the camera starts streaming.
+        /// </summary>
+        public static bool SetNoSignalTimeout(int timeout)
+        {
+            return (Native.SetNoSignalTimeout(timeout) > 0);
+        }
+
+        /// <summary>
+        /// Selects how the driver gets frames into the buffers of the application using the camera.
+        /// Copy has less bookkeeping per frame. Takes effect the next time the camera starts streaming.
+        /// </summary>
+        public static bool SetCaptureMode(CaptureMode mode)
+        {
+            return (Native.SetCaptureMode((int)mode) > 0);
+        }
+
+        /// <summary>
+        /// Selects how the driver timestamps frames. Schedule spaces them exactly one frame period apart and ignores
+        /// the timestamps passed with the frames. Takes effect the next time the camera starts running.
+        /// </summary>
+        public static bool SetTimestampMode(TimestampMode mode)
+        {
+            return (Native.SetTimestampMode((int)mode) > 0);
+        }
+
+        /// <summary>
+        /// Delays the frames and their timestamps by up to 2000 milliseconds, holding them in at most budgetKb kilobytes
+        /// (zero: 64 MB). The memory is set aside when the camera starts streaming; changes within it are applied smoothly.
+        /// </summary>
+        public static bool SetOutputDelay(int delay, int budgetKb = 0)
+        {
+            return (Native.SetOutputDelay(delay, budgetKb) > 0);
+        }
+
+        /// <summary>
+        /// Turns the driver's event trace of the frame path on (clearing it) or off.
+        /// </summary>
+        public static bool SetTrace(bool enable)
+        {
+            return (Native.SetTrace(enable ? 1 : 0) > 0);
+        }
+
+        /// <summary>
+        /// Writes the driver's event trace to a file for TraceDecoder. Turn the trace off first for a consistent dump.
+        /// </summary>
+        public static bool DumpTrace(string path)
+        {
+            return (Native.DumpTrace(path) > 0);
+        }
+
+        /// <summary>
+        /// Reads the driver's frame delivery and drop counters for the selected device.
+        /// </summary>
+        public static bool GetStatistics(out FrameStatistics statistics)
+        {
+            return (Native.GetStatistics(out statistics) > 0);
+        }
+
+        /// <summary>
+        /// Starts recording every frame passed to SetData to a file which can be replayed with StartReplay.
+        /// </summary>
+        public static bool StartRecording(string path)
+        {
+            return (Native.StartRecording(path) > 0);
+        }
+
+        public static bool StopRecording()
+        {
+            return (Native.StopRecording() > 0);
+        }
+
+        /// <summary>
+        /// Sends the frames of a recording to the selected device from a background thread.
+        /// A speed of 1 keeps the recorded pacing, 0 sends frames as fast as possible.
+        /// </summary>
+        public static bool StartReplay(string path, double speed = 1.0, bool loop = false)
+        {
+            return (Native.StartReplay(path, speed, loop ? 1 : 0) > 0);
+        }
+
+        public static void StopReplay()
+        {
+            Native.StopReplay();
+        }
+
+        public static bool IsReplaying
+        {
+            get { return (Native.IsReplaying() != 0); }
+        }
+
+        /// <summary>
+        /// Makes the driver stamp every frame set from now on with a frame ID and its inject time.
+        /// </summary>
+        public static bool SetLatencyProbe(bool enable)
+        {
+            return (Native.SetLatencyProbe(enable ? 1 : 0) > 0);
+        }
+
+        /// <summary>
+        /// Recovers the frame ID and inject time from a buffer delivered by the camera.
+        /// The latency of the frame is GetTimestamp() - timestamp.  For NV12 / I420 pass the luma plane as Y8.
+        /// </summary>
+        public static bool DecodeProbe(IntPtr data, int stride, int width, int height, ProbeFormat format, bool bottomUp, out uint frameId, out long timestamp)
+        {
+            return (Native.DecodeProbe(data, stride, width, height, (int)format, bottomUp ? 1 : 0, out frameId, out timestamp) > 0);
+        }
+
+        /// <summary>
+        /// Adds an overlay layer on top of the existing ones.  Layers are composited over every frame passed to SetData.
+        /// </summary>
+        public static int AddLayer()
+        {
+            return Native.AddLayer();
+        }
+
+        public static bool RemoveLayer(int layer)
+        {
+            return (Native.RemoveLayer(layer) > 0);
+        }
+
+        /// <summary>
+        /// Sets the image of a layer.  data is 32 bpp BGRA (PixelFormat32bppPArgb if premultiplied, PixelFormat32bppArgb otherwise).
+        /// </summary>
+        public static bool SetLayerImage(int layer, IntPtr data, int stride, int width, int height, bool premultiplied)
+        {
+            return (Native.SetLayerImage(layer, data, stride, width, height, premultiplied ? 1 : 0) > 0);
+        }
+
+        public static bool SetLayerPosition(int layer, int x, int y)
+        {
+            return (Native.SetLayerPosition(layer, x, y) > 0);
+        }
+
+        public static bool SetLayerZOrder(int layer, int zOrder)
+        {
+            return (Native.SetLayerZOrder(layer, zOrder) > 0);
+        }
+
+        public static bool SetLayerVisible(int layer, bool visible)
+        {
+            return (Native.SetLayerVisible(layer, visible ? 1 : 0) > 0);
+        }
+
+        /// <summary>
+        /// Replaces the pixels of Rgb24, Bgra, Nv12, I420, Yuy2 and P010 frames close to color (0xRRGGBB) with the chroma key background.
+        /// tolerance and softness are chroma distances (0-255): pixels within tolerance are replaced, the next softness
+        /// units blended. spill (0-255) removes the key color's tint from the subject's edges.
+        /// </summary>
+        public static bool SetChromaKey(int color, int tolerance, int softness, int spill = 0)
+        {
+            return (Native.SetChromaKey(1, color, tolerance, softness, spill) > 0);
+        }
+
+        public static bool DisableChromaKey()
+        {
+            return (Native.SetChromaKey(0, 0, 0, 0, 0) > 0);
+        }
+
+        public static bool SetChromaKeyBackground(int color)
+        {
+            return (Native.SetChromaKeyBackgroundColor(color) > 0);
+        }
+
+        /// <summary>
+        /// Sets a Bgra image of Width x Height (e.g. a locked 32bpp GDI+ bitmap) as the chroma key background.
+        /// </summary>
+        public static bool SetChromaKeyBackground(IntPtr data, int stride, int width, int height)
+        {
+            return (Native.SetChromaKeyBackgroundImage(data, stride, width, height) > 0);
+        }
+
+        /// <summary>
+        /// Pixelates (size is the block size, 2-256) or blurs (size is the radius, 1-64) a rectangle of every frame
+        /// passed to SetData, in any format, before it reaches the driver, and of every frame the broker forwards.
+        /// Returns the rectangle's id, or 0 if it was refused.
+        /// </summary>
+        public static int AddRedaction(int x, int y, int width, int height, RedactionMode mode, int size)
+        {
+            return Native.AddRedaction(x, y, width, height, (int)mode, size);
+        }
+
+        public static bool RemoveRedaction(int id)
+        {
+            return (Native.RemoveRedaction(id) > 0);
+        }
+
+        public static bool ClearRedactions()
+        {
+            return (Native.ClearRedactions() > 0);
+        }
+
+        /// <summary>
+        /// Opens every camera and feeds them from producer processes which connect with ConnectBroker,
+        /// each camera at framesPerSecond. Only one broker can run at a time.
+        /// </summary>
+        public static bool StartBroker(int framesPerSecond = 30)
+        {
+            return (Native.StartBroker(framesPerSecond) > 0);
+        }
+
+        public static bool StopBroker()
+        {
+            return (Native.StopBroker() > 0);
+        }
+
+        public static bool GetBrokerStatistics(out BrokerStatistics statistics)
+        {
+            return (Native.GetBrokerStatistics(out statistics) > 0);
+        }
+
+        /// <summary>
+        /// Connects to the running broker as the feed of a camera, or as a layer composited over it (Bgra only).
+        /// camera is -1 for any. Returns the camera assigned, or -1.
+        /// </summary>
+        public static int ConnectBroker(int camera, BrokerRole role, FrameFormat format)
+        {
+            return Native.ConnectBroker(camera, (int)role, (int)format);
+        }
+
+        /// <summary>
+        /// The buffer to write the next tightly packed Width x Height frame into. It changes with every PublishBrokerBuffer.
+        /// </summary>
+        public static IntPtr GetBrokerBuffer()
+        {
+            return Native.GetBrokerBuffer();
+        }
+
+        /// <summary>
+        /// Hands the frame written to GetBrokerBuffer to the broker, replacing an earlier one it has not taken yet.
+        /// </summary>
+        public static bool PublishBrokerBuffer(FrameFormat format, long timestamp = 0)
+        {
+            return (Native.PublishBrokerBuffer((int)format, timestamp) > 0);
+        }
+
+        public static bool DisconnectBroker()
+        {
+            return (Native.DisconnectBroker() > 0);
+        }
     }
 }
@@ -0,0 +1,50 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Runtime.InteropServices;
+using System.Text;
+using System.Threading.Tasks;
+
+namespace DriverInterfaceWrapper
+{
+    /// <summary>
+    /// Frame counters of the driver since the stream was last started.
+    /// FrameBufferAllocations counts since the device started.
+    /// Must match AVSHWS_STATISTICS in the driver's customprops.h.
+    /// </summary>
+    [StructLayout(LayoutKind.Sequential)]
+    public struct FrameStatistics
+    {
+        public uint Size;
+
+        /// <summary>Frames written to a consumer buffer.</summary>
+        public uint FramesDelivered;
+
+        /// <summary>Output frames lost because the consumer had no buffer queued.</summary>
+        public uint DropNoBuffer;
+
+        /// <summary>Output frames lost because the queued buffers did not cover a whole frame.</summary>
+        public uint DropPartialMapping;
+
+        /// <summary>Output frames which repeated the previous one because no new frame was set.</summary>
+        public uint ProducerStalled;
+
+        /// <summary>Frames set which were replaced before they were ever output.</summary>
+        public uint FramesSuperseded;
+
+        /// <summary>Time the driver took to start the stream, in 100ns units.</summary>
+        public uint StartTime;
+
+        /// <summary>Time from the start of the stream to the first delivered frame, in 100ns units. Zero until then.</summary>
+        public uint TimeToFirstFrame;
+
+        /// <summary>Stream starts, since the device started, which had to allocate frame buffers rather than reuse them.</summary>
+        public uint FrameBufferAllocations;
+
+        /// <summary>Times the stream switched to the "no signal" slate because no frame was set for the timeout.</summary>
+        public uint NoSignalSwitches;
+
+        /// <summary>Nonzero while the "no signal" slate is shown.</summary>
+        public uint NoSignal;
+    }
+}
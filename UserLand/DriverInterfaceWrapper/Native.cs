@@ -30,6 +30,123 @@ namespace DriverInterfaceWrapper
         [DllImport("DriverInterface.dll", CallingConvention = CallingConvention.Cdecl)]
         public static extern int SetBuffer(IntPtr data, int stride, int width, int height);
 
+        [DllImport("DriverInterface.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern long GetTimestamp();
+
+        [DllImport("DriverInterface.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern int SetBufferEx(IntPtr data, int stride, int width, int height, long timestamp, byte[] metadata, int metadataLength);
+
+        [DllImport("DriverInterface.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern int SetBufferFormat(IntPtr data, int stride, int width, int height, int format, long timestamp, byte[] metadata, int metadataLength);
+
+        [DllImport("DriverInterface.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern int SetFrameRateConversion(int mode);
+
+        [DllImport("DriverInterface.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern int SetStaging(int mode);
+
+        [DllImport("DriverInterface.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern int SetSlate(IntPtr data, int stride, int width, int height, int format);
+
+        [DllImport("DriverInterface.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern int SetNoSignalTimeout(int timeout);
+
+        [DllImport("DriverInterface.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern int SetTrace(int enable);
+
+        [DllImport("DriverInterface.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern int SetCaptureMode(int mode);
+
+        [DllImport("DriverInterface.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern int SetTimestampMode(int mode);
+
+        [DllImport("DriverInterface.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern int SetOutputDelay(int delay, int budgetKb);
+
+        [DllImport("DriverInterface.dll", CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        public static extern int DumpTrace(string path);
+
+        [DllImport("DriverInterface.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern int GetStatistics(out FrameStatistics statistics);
+
+        [DllImport("DriverInterface.dll", CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        public static extern int StartRecording(string path);
+
+        [DllImport("DriverInterface.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern int StopRecording();
+
+        [DllImport("DriverInterface.dll", CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        public static extern int StartReplay(string path, double speed, int loop);
+
+        [DllImport("DriverInterface.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern int StopReplay();
+
+        [DllImport("DriverInterface.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern int IsReplaying();
+
+        [DllImport("DriverInterface.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern int SetLatencyProbe(int enable);
+
+        [DllImport("DriverInterface.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern int DecodeProbe(IntPtr data, int stride, int width, int height, int format, int bottomUp, out uint frameId, out long timestamp);
+
+        [DllImport("DriverInterface.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern int AddLayer();
+
+        [DllImport("DriverInterface.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern int RemoveLayer(int layer);
+
+        [DllImport("DriverInterface.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern int SetLayerImage(int layer, IntPtr data, int stride, int width, int height, int premultiplied);
+
+        [DllImport("DriverInterface.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern int SetLayerPosition(int layer, int x, int y);
+
+        [DllImport("DriverInterface.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern int SetLayerZOrder(int layer, int zOrder);
+
+        [DllImport("DriverInterface.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern int SetLayerVisible(int layer, int visible);
+
+        [DllImport("DriverInterface.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern int SetChromaKey(int enable, int color, int tolerance, int softness, int spill);
+
+        [DllImport("DriverInterface.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern int SetChromaKeyBackgroundColor(int color);
+
+        [DllImport("DriverInterface.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern int SetChromaKeyBackgroundImage(IntPtr data, int stride, int width, int height);
+
+        [DllImport("DriverInterface.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern int AddRedaction(int x, int y, int width, int height, int mode, int size);
+
+        [DllImport("DriverInterface.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern int RemoveRedaction(int id);
+
+        [DllImport("DriverInterface.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern int ClearRedactions();
+
+        [DllImport("DriverInterface.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern int StartBroker(int framesPerSecond);
+
+        [DllImport("DriverInterface.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern int StopBroker();
+
+        [DllImport("DriverInterface.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern int GetBrokerStatistics(out BrokerStatistics statistics);
+
+        [DllImport("DriverInterface.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern int ConnectBroker(int camera, int role, int format);
+
+        [DllImport("DriverInterface.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern IntPtr GetBrokerBuffer();
+
+        [DllImport("DriverInterface.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern int PublishBrokerBuffer(int format, long timestamp);
+
+        [DllImport("DriverInterface.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern int DisconnectBroker();
+
         public static string GetDevicePath(int index)
         {
             StringBuilder buffer = new StringBuilder(256);
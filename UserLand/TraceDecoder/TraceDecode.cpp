@@ -0,0 +1,134 @@
+#include "TraceDecode.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+
+bool ReadTraceDump(const char* path, AVSHWS_TRACE_DUMP* header, std::vector<AVSHWS_TRACE_RECORD>* records)
+{
+	FILE* file = fopen(path, "rb");
+	if (file == NULL)
+	{
+		return false;
+	}
+
+	bool ok = fread(header, sizeof(*header), 1, file) == 1 && header->Size == sizeof(AVSHWS_TRACE_DUMP);
+
+	if (ok)
+	{
+		records->resize(header->RecordCount);
+		ok = header->RecordCount == 0 ||
+			fread(records->data(), sizeof(AVSHWS_TRACE_RECORD), header->RecordCount, file) == header->RecordCount;
+	}
+
+	fclose(file);
+
+	return ok;
+}
+
+void DecodeTrace(std::vector<AVSHWS_TRACE_RECORD>& records, TraceSummary* summary)
+{
+	//
+	// Each processor's records are in order; merge them by time.
+	//
+	std::stable_sort(records.begin(), records.end(), [](const AVSHWS_TRACE_RECORD& a, const AVSHWS_TRACE_RECORD& b)
+	{
+		return a.Timestamp < b.Timestamp;
+	});
+
+	int64_t lastTick = 0;
+
+	for (const AVSHWS_TRACE_RECORD& record : records)
+	{
+		switch (record.Event)
+		{
+		case AvshwsTraceSetDataExit:
+			if (record.Generation == 0)
+			{
+				//
+				// Arg2 marks a frame queued in the output delay line, which
+				// is published later without a record of its own.
+				//
+				if (record.Arg2 == 0)
+				{
+					summary->DroppedInjects++;
+				}
+				break;
+			}
+			summary->Frames[record.Generation].Enter = record.Timestamp - record.Arg1;
+			summary->Frames[record.Generation].Publish = record.Timestamp;
+			break;
+
+		case AvshwsTraceDpc:
+			if (lastTick != 0)
+			{
+				summary->TickIntervals.push_back(record.Timestamp - lastTick);
+			}
+			lastTick = record.Timestamp;
+			summary->Ticks++;
+			break;
+
+		case AvshwsTraceSgFill:
+			if (record.Arg1 == 0)
+			{
+				summary->DroppedTicks++;
+			}
+			else if (record.Generation != 0)
+			{
+				FrameTimeline& frame = summary->Frames[record.Generation];
+				if (frame.Fills++ == 0)
+				{
+					frame.FirstFill = record.Timestamp;
+				}
+			}
+			break;
+
+		case AvshwsTraceCloneDelete:
+			if (record.Generation != 0 && record.Arg2 != 0)
+			{
+				FrameTimeline& frame = summary->Frames[record.Generation];
+				if (frame.Releases++ == 0)
+				{
+					frame.FirstRelease = record.Timestamp;
+				}
+			}
+			break;
+		}
+	}
+
+	if (!records.empty())
+	{
+		summary->Origin = records.front().Timestamp;
+		summary->Duration = records.back().Timestamp - summary->Origin;
+	}
+
+	for (const auto& entry : summary->Frames)
+	{
+		const FrameTimeline& frame = entry.second;
+
+		if (frame.Publish == 0)
+		{
+			//
+			// Published before the trace started.
+			//
+			continue;
+		}
+
+		summary->SetData.push_back(frame.Publish - frame.Enter);
+
+		if (frame.FirstFill != 0)
+		{
+			summary->Queued.push_back(frame.FirstFill - frame.Publish);
+		}
+		else
+		{
+			summary->NeverDelivered++;
+		}
+
+		if (frame.FirstFill != 0 && frame.FirstRelease != 0)
+		{
+			summary->Released.push_back(frame.FirstRelease - frame.FirstFill);
+			summary->Total.push_back(frame.FirstRelease - frame.Enter);
+		}
+	}
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+//
+// Event trace decoding.
+//
+// Reads a dump written by DumpTrace (the driver's AVSHWS_TRACE_DUMP header
+// followed by its records) and turns its records into per-frame timelines
+// and the durations of each stage.  The layouts are the driver's own, from
+// customprops.h through portable.h, so build with AVSHWS_HOST defined and
+// Driver/avshws on the include path.  All fields are little endian.
+//
+// The stages of a frame (identified by the sequence number it was published
+// with) are:
+//
+//     setdata  - SetData entry to publication in the frame history
+//     queued   - publication to the first tick that wrote it to a buffer
+//     released - that tick to the release of the first buffer holding it
+//     total    - SetData entry to that release
+//
+// Ticks are also checked for jitter (the interval between simulated
+// interrupts) and counted as dropped when no buffer could take the frame.
+//
+
+#include "portable.h"
+
+#include <map>
+#include <vector>
+
+//
+// What happened to one injected frame.  Times are in 100ns units, zero if
+// the event wasn't seen.
+//
+struct FrameTimeline
+{
+	int64_t Enter = 0;
+	int64_t Publish = 0;
+	int64_t FirstFill = 0;
+	int64_t FirstRelease = 0;
+	uint32_t Fills = 0;
+	uint32_t Releases = 0;
+};
+
+//
+// A decoded trace.  Frames published before the trace started have no
+// Publish time and are left out of the stages.  Durations are in 100ns
+// units.
+//
+struct TraceSummary
+{
+	std::map<uint32_t, FrameTimeline> Frames;
+	std::vector<int64_t> SetData;
+	std::vector<int64_t> Queued;
+	std::vector<int64_t> Released;
+	std::vector<int64_t> Total;
+	std::vector<int64_t> TickIntervals;
+	int64_t Origin = 0;
+	int64_t Duration = 0;
+	uint32_t Ticks = 0;
+	uint32_t DroppedTicks = 0;
+	uint32_t DroppedInjects = 0;
+	uint32_t NeverDelivered = 0;
+};
+
+bool ReadTraceDump(const char* path, AVSHWS_TRACE_DUMP* header, std::vector<AVSHWS_TRACE_RECORD>* records);
+
+// Merges the processors' records by time, then decodes them.
+void DecodeTrace(std::vector<AVSHWS_TRACE_RECORD>& records, TraceSummary* summary);
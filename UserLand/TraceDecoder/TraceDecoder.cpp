@@ -0,0 +1,110 @@
+//
+// Event trace decoder.
+//
+// Turns a dump written by DumpTrace (the driver's AVSHWS_TRACE_DUMP header
+// followed by its records) into per-frame timelines and stage latency
+// percentiles (see TraceDecode.h).  Only depends on the C++ standard
+// library and the driver's customprops.h, so a dump taken on the capture
+// machine can be decoded anywhere.  The host build (see the top level
+// CMakeLists.txt) builds it, or by hand:
+//
+//     g++ -O2 -std=c++11 -DAVSHWS_HOST -I../../Driver/avshws -o TraceDecoder TraceDecoder.cpp TraceDecode.cpp
+//     ./TraceDecoder trace.bin [-t]
+//
+// -t also prints the timeline of every injected frame.
+//
+
+#include "TraceDecode.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+//
+// Prints the count, 50th, 90th and 99th percentile and maximum of a set of
+// durations in 100ns units, in milliseconds.
+//
+static void PrintPercentiles(const char* name, std::vector<int64_t> values)
+{
+	if (values.empty())
+	{
+		printf("%-10s       -\n", name);
+		return;
+	}
+
+	std::sort(values.begin(), values.end());
+
+	auto at = [&values](double fraction)
+	{
+		size_t index = (size_t)(fraction * (values.size() - 1) + 0.5);
+		return values[index] / 10000.0;
+	};
+
+	printf("%-10s %7zu %9.3f %9.3f %9.3f %9.3f\n", name, values.size(), at(0.5), at(0.9), at(0.99), values.back() / 10000.0);
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage: %s <trace dump> [-t]\n", argv[0]);
+		return 2;
+	}
+
+	bool printTimelines = argc > 2 && strcmp(argv[2], "-t") == 0;
+
+	AVSHWS_TRACE_DUMP header;
+	std::vector<AVSHWS_TRACE_RECORD> records;
+
+	if (!ReadTraceDump(argv[1], &header, &records))
+	{
+		fprintf(stderr, "%s: not a trace dump\n", argv[1]);
+		return 1;
+	}
+
+	TraceSummary summary;
+	DecodeTrace(records, &summary);
+
+	if (printTimelines)
+	{
+		printf("%10s %14s %10s %10s %10s %6s\n", "frame", "enter (ms)", "publish", "filled", "released", "ticks");
+
+		for (const auto& entry : summary.Frames)
+		{
+			const FrameTimeline& frame = entry.second;
+
+			if (frame.Publish == 0)
+			{
+				continue;
+			}
+
+			printf("%10u %14.3f %10.3f %10.3f %10.3f %6u\n",
+				entry.first,
+				(frame.Enter - summary.Origin) / 10000.0,
+				(frame.Publish - frame.Enter) / 10000.0,
+				frame.FirstFill ? (frame.FirstFill - frame.Enter) / 10000.0 : -1.0,
+				frame.FirstRelease ? (frame.FirstRelease - frame.Enter) / 10000.0 : -1.0,
+				frame.Fills);
+		}
+	}
+
+	printf("%u records from %u processors (%u available), %.3f ms\n",
+		header.RecordCount,
+		header.Processors,
+		header.RecordsAvailable,
+		summary.Duration / 10000.0);
+
+	printf("%zu frames published, %u never delivered, %u injects dropped, %u ticks, %u ticks dropped\n\n",
+		summary.SetData.size(), summary.NeverDelivered, summary.DroppedInjects, summary.Ticks, summary.DroppedTicks);
+
+	printf("%-10s %7s %9s %9s %9s %9s\n", "stage (ms)", "count", "p50", "p90", "p99", "max");
+	PrintPercentiles("setdata", summary.SetData);
+	PrintPercentiles("queued", summary.Queued);
+	PrintPercentiles("released", summary.Released);
+	PrintPercentiles("total", summary.Total);
+	PrintPercentiles("tick", summary.TickIntervals);
+
+	return 0;
+}
@@ -0,0 +1,68 @@
+﻿using DriverInterfaceWrapper;
+using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Threading;
+using System.Threading.Tasks;
+
+namespace UserDriverBroker
+{
+    /// <summary>
+    /// Runs the frame broker, which feeds every virtual camera from producer processes
+    /// connecting with DriverInterface.ConnectBroker, until Ctrl+C.
+    ///
+    /// Usage: UserDriverBroker [frames per second]
+    /// </summary>
+    static class Program
+    {
+        [MTAThread]
+        static int Main(string[] args)
+        {
+            int framesPerSecond = (args.Length > 0) ? int.Parse(args[0]) : 30;
+
+            if (!DriverInterface.Init())
+            {
+                Console.WriteLine("Unable to init DriverInterface!");
+
+                return 1;
+            }
+
+            try
+            {
+                if (!DriverInterface.StartBroker(framesPerSecond))
+                {
+                    Console.WriteLine("Unable to start the broker; is another one running?");
+
+                    return 1;
+                }
+
+                ManualResetEvent stop = new ManualResetEvent(false);
+
+                Console.CancelKeyPress += (sender, e) =>
+                {
+                    e.Cancel = true;
+                    stop.Set();
+                };
+
+                while (!stop.WaitOne(1000))
+                {
+                    BrokerStatistics statistics;
+                    if (DriverInterface.GetBrokerStatistics(out statistics))
+                    {
+                        Console.WriteLine("cameras {0}, producers {1}, published {2}, replaced {3}, forwarded {4}, rejected {5}",
+                            statistics.Cameras, statistics.Producers, statistics.FramesPublished,
+                            statistics.FramesReplaced, statistics.FramesForwarded, statistics.FramesRejected);
+                    }
+                }
+
+                DriverInterface.StopBroker();
+            }
+            finally
+            {
+                DriverInterface.Free();
+            }
+
+            return 0;
+        }
+    }
+}
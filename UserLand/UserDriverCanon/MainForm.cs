@@ -128,8 +128,8 @@ namespace UserDriverCanon
                     videoBuffer = rawInput;
                 }
 
-                BitmapData imageLock = videoBuffer.LockBits(new Rectangle(0, 0, videoBuffer.Width, videoBuffer.Height), ImageLockMode.ReadOnly, PixelFormat.Format24bppRgb);
-                DriverInterface.SetData(imageLock.Scan0, imageLock.Stride, imageLock.Width, imageLock.Height);
+                BitmapData imageLock = videoBuffer.LockBits(new Rectangle(0, 0, videoBuffer.Width, videoBuffer.Height), ImageLockMode.ReadOnly, PixelFormat.Format32bppArgb);
+                DriverInterface.SetData(imageLock.Scan0, imageLock.Stride, imageLock.Width, imageLock.Height, FrameFormat.Bgra);
                 videoBuffer.UnlockBits(imageLock);
 
                 if (videoBuffer != rawInput)
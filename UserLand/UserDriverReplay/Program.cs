@@ -0,0 +1,89 @@
+﻿using DriverInterfaceWrapper;
+using System;
+using System.Collections.Generic;
+using System.Globalization;
+using System.Linq;
+using System.Threading;
+using System.Threading.Tasks;
+
+namespace UserDriverReplay
+{
+    /// <summary>
+    /// Replays a recording made with DriverInterface.StartRecording into a virtual camera for load testing.
+    ///
+    /// Usage: UserDriverReplay recording [speed] [loop] [device index]
+    /// </summary>
+    static class Program
+    {
+        [MTAThread]
+        static int Main(string[] args)
+        {
+            if (args.Length < 1)
+            {
+                Console.WriteLine("Usage: UserDriverReplay recording [speed (1 = recorded pacing, 0 = unpaced)] [loop] [device index]");
+
+                return 1;
+            }
+
+            string path = args[0];
+            double speed = (args.Length > 1) ? double.Parse(args[1], CultureInfo.InvariantCulture) : 1.0;
+            bool loop = (args.Length > 2) && (args[2] == "loop" || args[2] == "1");
+            int deviceIndex = (args.Length > 3) ? int.Parse(args[3]) : 0;
+
+            if (!DriverInterface.Init())
+            {
+                Console.WriteLine("Unable to init DriverInterface!");
+
+                return 1;
+            }
+
+            try
+            {
+                DeviceInfo[] devices = DriverInterface.GetDevices();
+
+                if (deviceIndex < 0 || deviceIndex >= devices.Length || !DriverInterface.SelectDevice(devices[deviceIndex].Path))
+                {
+                    Console.WriteLine("Unable to select device " + deviceIndex);
+
+                    return 1;
+                }
+
+                if (!DriverInterface.StartReplay(path, speed, loop))
+                {
+                    Console.WriteLine("Unable to replay " + path);
+
+                    return 1;
+                }
+
+                Console.CancelKeyPress += (sender, e) =>
+                {
+                    e.Cancel = true;
+                    DriverInterface.StopReplay();
+                };
+
+                while (DriverInterface.IsReplaying)
+                {
+                    Thread.Sleep(1000);
+
+                    FrameStatistics statistics;
+                    if (DriverInterface.GetStatistics(out statistics))
+                    {
+                        Console.WriteLine("delivered {0}, no buffer {1}, partial {2}, stalled {3}, superseded {4}, first frame {5:F1} ms, no signal {6}",
+                            statistics.FramesDelivered, statistics.DropNoBuffer, statistics.DropPartialMapping,
+                            statistics.ProducerStalled, statistics.FramesSuperseded, statistics.TimeToFirstFrame / 10000.0,
+                            statistics.NoSignalSwitches);
+                    }
+                }
+
+                DriverInterface.StopReplay();
+                DriverInterface.DestroyDevice();
+            }
+            finally
+            {
+                DriverInterface.Free();
+            }
+
+            return 0;
+        }
+    }
+}
@@ -94,9 +94,9 @@ namespace UserDriverStaticImage
                 picView.Image = (Bitmap)videoBuffer.Clone();
 
                 Stopwatch sw = new Stopwatch();
-                BitmapData imageLock = videoBuffer.LockBits(new Rectangle(0, 0, videoBuffer.Width, videoBuffer.Height), ImageLockMode.ReadOnly, PixelFormat.Format24bppRgb);
+                BitmapData imageLock = videoBuffer.LockBits(new Rectangle(0, 0, videoBuffer.Width, videoBuffer.Height), ImageLockMode.ReadOnly, PixelFormat.Format32bppArgb);
                 sw.Start();
-                DriverInterface.SetData(imageLock.Scan0, imageLock.Stride, imageLock.Width, imageLock.Height);
+                DriverInterface.SetData(imageLock.Scan0, imageLock.Stride, imageLock.Width, imageLock.Height, FrameFormat.Bgra);
                 sw.Stop();
                 videoBuffer.UnlockBits(imageLock);
 